@@ -0,0 +1,190 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    calls.ck
+
+Abstract:
+
+    This module benchmarks method calls: monomorphic call sites, call sites
+    that see several receiver classes, and super calls.
+
+Author:
+
+    agent 16-Oct-2026
+
+Environment:
+
+    Chalk
+
+--*/
+
+//
+// -------------------------------------------------------------------- Imports
+//
+
+//
+// -------------------------------------------------------------------- Classes
+//
+
+class Counter {
+    var Count;
+
+    function __init() {
+        Count = 0;
+        return this;
+    }
+
+    function increment(amount) {
+        Count += amount;
+        return Count;
+    }
+
+    function value() {
+        return Count;
+    }
+}
+
+class DoubleCounter is Counter {
+    function increment(amount) {
+        return super.increment(amount * 2);
+    }
+}
+
+class Square {
+    function area(size) {
+        return size * size;
+    }
+}
+
+class Triangle {
+    function area(size) {
+        return size * size / 2;
+    }
+}
+
+class Line {
+    function area(size) {
+        return 0;
+    }
+}
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+function
+monomorphicCalls (
+    iterations
+    )
+
+/*++
+
+Routine Description:
+
+    This routine calls the same method on the same class repeatedly.
+
+Arguments:
+
+    iterations - Supplies the number of calls to make.
+
+Return Value:
+
+    Returns the final counter value.
+
+--*/
+
+{
+
+    var counter = Counter();
+    var index;
+
+    for (index = 0; index < iterations; index += 1) {
+        counter.increment(1);
+    }
+
+    return counter.value();
+}
+
+function
+polymorphicCalls (
+    iterations
+    )
+
+/*++
+
+Routine Description:
+
+    This routine calls a method from a single call site on objects of three
+    different classes in turn.
+
+Arguments:
+
+    iterations - Supplies the number of calls to make.
+
+Return Value:
+
+    Returns the sum of the areas.
+
+--*/
+
+{
+
+    var index;
+    var shapes = [Square(), Triangle(), Line()];
+    var total = 0;
+
+    for (index = 0; index < iterations; index += 1) {
+        total += shapes[index % 3].area(4);
+    }
+
+    return total;
+}
+
+function
+superCalls (
+    iterations
+    )
+
+/*++
+
+Routine Description:
+
+    This routine calls an overridden method that calls its superclass.
+
+Arguments:
+
+    iterations - Supplies the number of calls to make.
+
+Return Value:
+
+    Returns the final counter value.
+
+--*/
+
+{
+
+    var counter = DoubleCounter();
+    var index;
+
+    for (index = 0; index < iterations; index += 1) {
+        counter.increment(1);
+    }
+
+    return counter.value();
+}
+
+//
+// Run the benchmarks.
+//
+
+Core.print("monomorphic: %d" % [monomorphicCalls(2000000)]);
+Core.print("polymorphic: %d" % [polymorphicCalls(2000000)]);
+Core.print("super: %d" % [superCalls(2000000)]);
@@ -0,0 +1,129 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    containers.ck
+
+Abstract:
+
+    This module benchmarks the common dictionary and list operations: append,
+    index, iteration, and keyed insertion and lookup.
+
+Author:
+
+    agent 16-Oct-2026
+
+Environment:
+
+    Chalk
+
+--*/
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+function
+listOperations (
+    iterations
+    )
+
+/*++
+
+Routine Description:
+
+    This routine builds a list, then reads it back both by index and by
+    iterating over it.
+
+Arguments:
+
+    iterations - Supplies the number of elements to put in the list.
+
+Return Value:
+
+    Returns the sum of all the values read.
+
+--*/
+
+{
+
+    var element;
+    var index;
+    var list = [];
+    var total = 0;
+
+    for (index = 0; index < iterations; index += 1) {
+        list.append(index);
+    }
+
+    for (index = 0; index < list.length(); index += 1) {
+        total += list[index];
+    }
+
+    for (element in list) {
+        total += element;
+    }
+
+    return total;
+}
+
+function
+dictOperations (
+    iterations
+    )
+
+/*++
+
+Routine Description:
+
+    This routine fills a dictionary with string keys, then looks each key
+    up again.
+
+Arguments:
+
+    iterations - Supplies the number of keys to put in the dictionary.
+
+Return Value:
+
+    Returns the sum of all the values read.
+
+--*/
+
+{
+
+    var dict = {};
+    var index;
+    var keys = [];
+    var total = 0;
+
+    for (index = 0; index < iterations; index += 1) {
+        keys.append("key%d" % [index]);
+    }
+
+    for (index = 0; index < iterations; index += 1) {
+        dict[keys[index]] = index;
+    }
+
+    for (index = 0; index < iterations; index += 1) {
+        total += dict[keys[index]];
+        if (dict.containsKey(keys[index]) == false) {
+            total = -1;
+        }
+    }
+
+    return total;
+}
+
+//
+// Run the benchmarks.
+//
+
+Core.print("list: %d" % [listOperations(200000)]);
+Core.print("dict: %d" % [dictOperations(100000)]);
@@ -0,0 +1,134 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    fields.ck
+
+Abstract:
+
+    This module benchmarks reading and writing object fields, both from
+    within methods and through accessor methods.
+
+Author:
+
+    agent 16-Oct-2026
+
+Environment:
+
+    Chalk
+
+--*/
+
+//
+// -------------------------------------------------------------------- Classes
+//
+
+class Point {
+    var X;
+    var Y;
+
+    function __init(x, y) {
+        X = x;
+        Y = y;
+        return this;
+    }
+
+    function x() {
+        return X;
+    }
+
+    function y() {
+        return Y;
+    }
+
+    function move(dx, dy) {
+        X += dx;
+        Y += dy;
+        return;
+    }
+}
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+function
+fieldWrites (
+    iterations
+    )
+
+/*++
+
+Routine Description:
+
+    This routine updates the fields of an object from inside a method.
+
+Arguments:
+
+    iterations - Supplies the number of updates to make.
+
+Return Value:
+
+    Returns the sum of the final coordinates.
+
+--*/
+
+{
+
+    var index;
+    var point = Point(0, 0);
+
+    for (index = 0; index < iterations; index += 1) {
+        point.move(1, 2);
+    }
+
+    return point.x() + point.y();
+}
+
+function
+fieldReads (
+    iterations
+    )
+
+/*++
+
+Routine Description:
+
+    This routine reads the fields of an object through accessor methods.
+
+Arguments:
+
+    iterations - Supplies the number of reads to make.
+
+Return Value:
+
+    Returns the sum of all the values read.
+
+--*/
+
+{
+
+    var index;
+    var point = Point(3, 4);
+    var total = 0;
+
+    for (index = 0; index < iterations; index += 1) {
+        total += point.x() * point.y();
+    }
+
+    return total;
+}
+
+//
+// Run the benchmarks.
+//
+
+Core.print("field writes: %d" % [fieldWrites(2000000)]);
+Core.print("field reads: %d" % [fieldReads(2000000)]);
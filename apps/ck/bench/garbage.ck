@@ -0,0 +1,222 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    garbage.ck
+
+Abstract:
+
+    This module benchmarks the garbage collector by churning through short
+    lived objects while a large set of long lived objects stays reachable.
+
+Author:
+
+    agent 16-Oct-2026
+
+Environment:
+
+    Chalk
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+from app import gcStats;
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+class Node {
+    var value;
+    var next;
+
+    function
+    __init (
+        value,
+        next
+        )
+
+    /*++
+
+    Routine Description:
+
+        This routine initializes a new node.
+
+    Arguments:
+
+        value - Supplies the value to store in the node.
+
+        next - Supplies the next node in the chain.
+
+    Return Value:
+
+        Returns the node.
+
+    --*/
+
+    {
+
+        this.value = value;
+        this.next = next;
+        return this;
+    }
+
+    function
+    setValue (
+        value
+        )
+
+    /*++
+
+    Routine Description:
+
+        This routine replaces the value stored in the node.
+
+    Arguments:
+
+        value - Supplies the new value.
+
+    Return Value:
+
+        None.
+
+    --*/
+
+    {
+
+        this.value = value;
+        return;
+    }
+}
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+function
+buildLiveSet (
+    count
+    )
+
+/*++
+
+Routine Description:
+
+    This routine builds a long lived set of objects that survives the whole
+    benchmark.
+
+Arguments:
+
+    count - Supplies the number of entries to create.
+
+Return Value:
+
+    Returns a list of nodes, each with a string and a small list.
+
+--*/
+
+{
+
+    var index;
+    var live = [];
+
+    for (index = 0; index < count; index += 1) {
+        live.append(Node("live%d" % [index], [index, index + 1]));
+    }
+
+    return live;
+}
+
+function
+churn (
+    live,
+    iterations
+    )
+
+/*++
+
+Routine Description:
+
+    This routine allocates lots of short lived objects, occasionally storing
+    one into the long lived set.
+
+Arguments:
+
+    live - Supplies the long lived set.
+
+    iterations - Supplies the number of iterations to run.
+
+Return Value:
+
+    Returns a checksum of the work done.
+
+--*/
+
+{
+
+    var index;
+    var node;
+    var total = 0;
+
+    for (index = 0; index < iterations; index += 1) {
+        node = Node("temp%d" % [index], null);
+        node = Node([index, node], node);
+        total += node.value[0] % 7;
+        if ((index % 64) == 0) {
+            live[index % live.length()].setValue("kept%d" % [index]);
+        }
+    }
+
+    return total;
+}
+
+function
+printStatistics (
+    )
+
+/*++
+
+Routine Description:
+
+    This routine prints the garbage collector statistics.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    var stats = gcStats();
+
+    Core.print("collections: %d minor, %d full" %
+               [stats["minorCollections"], stats["fullCollections"]]);
+
+    Core.print("collection time: %dus minor, %dus full, %dus max pause" %
+               [stats["minorTime"], stats["fullTime"], stats["maxPause"]]);
+
+    return;
+}
+
+//
+// Run the benchmarks.
+//
+
+var live = buildLiveSet(100000);
+Core.print("churn: %d" % [churn(live, 500000)]);
+printStatistics();
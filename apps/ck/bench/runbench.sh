@@ -0,0 +1,35 @@
+#!/bin/sh
+## Copyright (c) 2026 Minoca Corp.
+##
+##    This file is licensed under the terms of the GNU General Public License
+##    version 3. Alternative licensing terms are available. Contact
+##    info@minocacorp.com for details. See the LICENSE file at the root of this
+##    project for complete licensing information.
+##
+## Script Name:
+##
+##     runbench.sh
+##
+## Abstract:
+##
+##    This script runs the Chalk interpreter microbenchmarks and reports how
+##     long each one took. Pass the absolute path to the chalk binary to
+##     measure, which defaults to the one in the path.
+##
+## Author:
+##
+##     agent 16-Oct-2026
+##
+## Environment:
+##
+##     Build
+##
+
+set -e
+
+CHALK=${1:-chalk}
+cd `dirname $0`
+for bench in calls fields containers garbage; do
+    echo "$bench:"
+    time $CHALK $bench.ck
+done
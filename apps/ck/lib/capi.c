@@ -1624,6 +1624,7 @@ Return Value:
         List->Elements.Data[Index] = Value;
     }
 
+    CkpWriteBarrier(Vm, &(List->Header));
     Fiber->StackTop -= 1;
     return;
 }
@@ -1981,6 +1982,7 @@ Return Value:
                                   Name,
                                   NameSize);
 
+    CkpWriteBarrier(Vm, &(Class->Module->Header));
     if (Symbol < 0) {
         goto BindMethodEnd;
     }
@@ -2742,6 +2744,12 @@ Return Value:
 
     Instance = CK_AS_INSTANCE(Value);
     FieldIndex += Frame->Closure->Class->SuperFieldCount;
+
+    //
+    // The caller may write to the field, so remember the instance.
+    //
+
+    CkpWriteBarrier(Vm, &(Instance->Header));
     return &(Instance->Fields[FieldIndex]);
 }
 
@@ -49,7 +49,7 @@ Module Name:
 // Define the current freeze file format version.
 //
 
-#define CK_FREEZE_VERSION 1
+#define CK_FREEZE_VERSION 2
 
 //
 // ------------------------------------------------------ Data Type Definitions
@@ -104,6 +104,13 @@ CkpFreezeBuffer (
     PVOID Buffer
     );
 
+VOID
+CkpFreezeCallSites (
+    PCK_VM Vm,
+    PCK_BYTE_ARRAY String,
+    PCK_CALL_SITE_ARRAY CallSites
+    );
+
 VOID
 CkpFreezeFunction (
     PCK_VM Vm,
@@ -165,6 +172,7 @@ BOOL
 CkpThawList (
     PCK_VM Vm,
     PCK_MODULE Module,
+    PCK_OBJECT Owner,
     PCSTR *Contents,
     PUINTN Size,
     PCK_VALUE_ARRAY List
@@ -185,6 +193,15 @@ CkpThawBuffer (
     PCK_BYTE_ARRAY Buffer
     );
 
+BOOL
+CkpThawCallSites (
+    PCK_VM Vm,
+    PCK_MODULE Module,
+    PCSTR *Contents,
+    PUINTN Size,
+    PCK_CALL_SITE_ARRAY CallSites
+    );
+
 //
 // -------------------------------------------------------------------- Globals
 //
@@ -470,10 +487,13 @@ Return Value:
                                     &Size,
                                     &(Module->Closure));
 
+            CkpWriteBarrier(Vm, &(Module->Header));
+
         } else if ((NameSize == 4) &&
                    (CkCompareMemory(Name, "Path", 4) == 0)) {
 
             Module->Path = CkpThawString(Vm, &Contents, &Size);
+            CkpWriteBarrier(Vm, &(Module->Header));
 
         } else if ((NameSize == 17) &&
                    (CkCompareMemory(Name, "CoreVariableCount", 17) == 0)) {
@@ -803,6 +823,56 @@ Return Value:
     return;
 }
 
+VOID
+CkpFreezeCallSites (
+    PCK_VM Vm,
+    PCK_BYTE_ARRAY String,
+    PCK_CALL_SITE_ARRAY CallSites
+    )
+
+/*++
+
+Routine Description:
+
+    This routine prints a function's call sites to the given module freeze
+    string in progress. Only the method symbols are saved, as a buffer of two
+    byte values in the same byte order as the bytecode. The caches start out
+    empty when thawed.
+
+Arguments:
+
+    Vm - Supplies a pointer to the virtual machine.
+
+    String - Supplies a pointer to the output in progress.
+
+    CallSites - Supplies a pointer to the call sites to add.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    UCHAR Bytes[2];
+    UINTN Index;
+    CK_SYMBOL_INDEX Symbol;
+
+    CkpFreezeAdd(Vm, String, "b", 1);
+    CkpFreezeRawInteger(Vm, String, CallSites->Count * sizeof(Bytes));
+    CkpFreezeAdd(Vm, String, "\"", 1);
+    for (Index = 0; Index < CallSites->Count; Index += 1) {
+        Symbol = CallSites->Data[Index].Symbol;
+        Bytes[0] = (UCHAR)(Symbol >> 8);
+        Bytes[1] = (UCHAR)Symbol;
+        CkpFreezeAdd(Vm, String, Bytes, sizeof(Bytes));
+    }
+
+    CkpFreezeAdd(Vm, String, "\"", 1);
+    return;
+}
+
 VOID
 CkpFreezeFunction (
     PCK_VM Vm,
@@ -847,6 +917,8 @@ Return Value:
     CkpFreezeInteger(Vm, String, Function->UpvalueCount);
     CkpFreezeAdd(Vm, String, "\nArity: ", 8);
     CkpFreezeInteger(Vm, String, Function->Arity);
+    CkpFreezeAdd(Vm, String, "\nCallSites: ", 12);
+    CkpFreezeCallSites(Vm, String, &(Function->CallSites));
     CkpFreezeAdd(Vm, String, "\nName: ", 7);
     CkpFreezeString(Vm, String, Function->Debug.Name);
     CkpFreezeAdd(Vm, String, "\nFirstLine: ", 12);
@@ -1184,6 +1256,7 @@ Return Value:
         return FALSE;
     }
 
+    CkpWriteBarrier(Vm, &(Module->Header));
     CkpPopRoot(Vm);
     Result = TRUE;
     *Contents += 2;
@@ -1202,6 +1275,7 @@ Return Value:
 
             Result = CkpThawList(Vm,
                                  Module,
+                                 &(Function->Header),
                                  Contents,
                                  Size,
                                  &(Function->Constants));
@@ -1224,10 +1298,20 @@ Return Value:
             Result = CkpThawInteger(Contents, Size, &Integer);
             Function->Arity = Integer;
 
+        } else if ((NameSize == 9) &&
+                   (CkCompareMemory(Name, "CallSites", 9) == 0)) {
+
+            Result = CkpThawCallSites(Vm,
+                                      Module,
+                                      Contents,
+                                      Size,
+                                      &(Function->CallSites));
+
         } else if ((NameSize == 4) &&
                    (CkCompareMemory(Name, "Name", 4) == 0)) {
 
             Function->Debug.Name = CkpThawString(Vm, Contents, Size);
+            CkpWriteBarrier(Vm, &(Function->Header));
             if (Function->Debug.Name == NULL) {
                 Result = FALSE;
             }
@@ -1375,7 +1459,13 @@ Return Value:
     CK_VALUE Value;
 
     StartIndex = Table->List.Count;
-    if (!CkpThawList(Vm, Module, Contents, Size, &(Table->List))) {
+    if (!CkpThawList(Vm,
+                     Module,
+                     &(Module->Header),
+                     Contents,
+                     Size,
+                     &(Table->List))) {
+
         return FALSE;
     }
 
@@ -1400,6 +1490,7 @@ BOOL
 CkpThawList (
     PCK_VM Vm,
     PCK_MODULE Module,
+    PCK_OBJECT Owner,
     PCSTR *Contents,
     PUINTN Size,
     PCK_VALUE_ARRAY List
@@ -1417,6 +1508,9 @@ Routine Description:
 
     Module - Supplies a pointer to the module being thawed.
 
+    Owner - Supplies a pointer to the object that contains the list. The
+        garbage collector is told about each value stored into it.
+
     Contents - Supplies a pointer that on input points to the element to read.
         This is updated on output.
 
@@ -1472,6 +1566,7 @@ Return Value:
         //
 
         CkpArrayAppend(Vm, List, Value);
+        CkpWriteBarrier(Vm, Owner);
         if (Index != Count - 1) {
             if ((*Size <= 2) || (**Contents != ',')) {
                 return FALSE;
@@ -1637,3 +1732,74 @@ Return Value:
     return TRUE;
 }
 
+BOOL
+CkpThawCallSites (
+    PCK_VM Vm,
+    PCK_MODULE Module,
+    PCSTR *Contents,
+    PUINTN Size,
+    PCK_CALL_SITE_ARRAY CallSites
+    )
+
+/*++
+
+Routine Description:
+
+    This routine thaws the call sites of a function.
+
+Arguments:
+
+    Vm - Supplies a pointer to the virtual machine.
+
+    Module - Supplies a pointer to the module being thawed, whose strings
+        have already been thawed.
+
+    Contents - Supplies a pointer that on input points to the element to read.
+        This is updated on output.
+
+    Size - Supplies a pointer to the remaining size, not including a null
+        terminator which may not exist.
+
+    CallSites - Supplies a pointer to the call site array to fill in.
+
+Return Value:
+
+    TRUE on success.
+
+    FALSE on failure.
+
+--*/
+
+{
+
+    CK_BYTE_ARRAY Buffer;
+    UINTN Index;
+    BOOL Result;
+    CK_CALL_SITE Site;
+
+    CkpInitializeArray(&Buffer);
+    Result = CkpThawBuffer(Vm, Contents, Size, &Buffer);
+    if ((Result == FALSE) || ((Buffer.Count % 2) != 0)) {
+        Result = FALSE;
+        goto ThawCallSitesEnd;
+    }
+
+    CkZero(&Site, sizeof(CK_CALL_SITE));
+    for (Index = 0; Index < Buffer.Count; Index += 2) {
+        Site.Symbol = CK_READ16(Buffer.Data + Index);
+        if (Site.Symbol >= Module->Strings.List.Count) {
+            Result = FALSE;
+            break;
+        }
+
+        if (CkpArrayAppend(Vm, CallSites, Site) != CkSuccess) {
+            Result = FALSE;
+            break;
+        }
+    }
+
+ThawCallSitesEnd:
+    CkpClearArray(Vm, &Buffer);
+    return Result;
+}
+
@@ -57,6 +57,13 @@ Module Name:
 
 #define CK_MAX_CONSTANTS 0x10000
 
+//
+// Define the maximum number of method call sites in a single function, which
+// is similarly limited by the 2 byte operand of the call ops.
+//
+
+#define CK_MAX_CALL_SITES 0x10000
+
 //
 // Define the maximum jump distance. This limitation also exists in the
 // bytecode because of the argument size to the jump ops.
@@ -642,13 +642,15 @@ Return Value:
 
 {
 
+    CK_SYMBOL_INDEX Site;
     CK_SYMBOL_INDEX Symbol;
 
     CK_ASSERT((Op == CkOpCall0) || (Op == CkOpSuperCall0));
 
     Symbol = CkpGetSignatureSymbol(Compiler, Signature);
+    Site = CkpAddCallSite(Compiler, Symbol);
     if (Signature->Arity <= 8) {
-        CkpEmitShortOp(Compiler, Op + Signature->Arity, Symbol);
+        CkpEmitShortOp(Compiler, Op + Signature->Arity, Site);
 
     } else {
         if (Op == CkOpCall0) {
@@ -665,7 +667,7 @@ Return Value:
 
         Compiler->StackSlots -= Signature->Arity;
         CkpEmitByteOp(Compiler, Op, Signature->Arity);
-        CkpEmitShort(Compiler, Symbol);
+        CkpEmitShort(Compiler, Site);
     }
 
     return;
@@ -704,15 +706,18 @@ Return Value:
 
 {
 
+    CK_SYMBOL_INDEX Site;
     CK_SYMBOL_INDEX Symbol;
 
     //
-    // Get the method number in the giant table of all method signatures.
+    // Get the method number in the giant table of all method signatures, and
+    // create a call site for it.
     //
 
     Symbol = CkpGetMethodSymbol(Compiler, Name, Length);
+    Site = CkpAddCallSite(Compiler, Symbol);
     if (ArgumentCount <= 8) {
-        CkpEmitShortOp(Compiler, CkOpCall0 + ArgumentCount, Symbol);
+        CkpEmitShortOp(Compiler, CkOpCall0 + ArgumentCount, Site);
 
     } else {
         if (ArgumentCount >= MAX_UCHAR) {
@@ -721,7 +726,7 @@ Return Value:
         }
 
         CkpEmitByteOp(Compiler, CkOpCall, ArgumentCount);
-        CkpEmitShort(Compiler, Symbol);
+        CkpEmitShort(Compiler, Site);
 
         //
         // Manually track the stack usage since the instruction itself doesn't
@@ -753,6 +753,31 @@ Return Value:
 
 --*/
 
+CK_SYMBOL_INDEX
+CkpAddCallSite (
+    PCK_COMPILER Compiler,
+    CK_SYMBOL_INDEX Symbol
+    );
+
+/*++
+
+Routine Description:
+
+    This routine adds a new method call site to the current function.
+
+Arguments:
+
+    Compiler - Supplies a pointer to the compiler.
+
+    Symbol - Supplies the symbol of the method signature being called.
+
+Return Value:
+
+    Returns the index of the call site, which is the operand of the call
+    instruction.
+
+--*/
+
 PCK_CLASS_COMPILER
 CkpGetClassCompiler (
     PCK_COMPILER Compiler
@@ -250,6 +250,55 @@ Return Value:
     return Symbol;
 }
 
+CK_SYMBOL_INDEX
+CkpAddCallSite (
+    PCK_COMPILER Compiler,
+    CK_SYMBOL_INDEX Symbol
+    )
+
+/*++
+
+Routine Description:
+
+    This routine adds a new method call site to the current function.
+
+Arguments:
+
+    Compiler - Supplies a pointer to the compiler.
+
+    Symbol - Supplies the symbol of the method signature being called.
+
+Return Value:
+
+    Returns the index of the call site, which is the operand of the call
+    instruction.
+
+--*/
+
+{
+
+    CK_CALL_SITE Site;
+    CK_ERROR_TYPE Status;
+
+    if (Compiler->Function->CallSites.Count >= CK_MAX_CALL_SITES) {
+        CkpCompileError(Compiler, NULL, "Too many method calls");
+        return 0;
+    }
+
+    CkZero(&Site, sizeof(CK_CALL_SITE));
+    Site.Symbol = Symbol;
+    Status = CkpArrayAppend(Compiler->Parser->Vm,
+                            &(Compiler->Function->CallSites),
+                            Site);
+
+    if (Status != CkSuccess) {
+        CkpCompileError(Compiler, NULL, "Allocation failure");
+        return 0;
+    }
+
+    return Compiler->Function->CallSites.Count - 1;
+}
+
 PCK_CLASS_COMPILER
 CkpGetClassCompiler (
     PCK_COMPILER Compiler
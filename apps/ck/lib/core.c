@@ -302,7 +302,9 @@ Return Value:
     PCK_BUILTIN_CLASSES Classes;
     PCK_MODULE CoreModule;
     CK_ERROR_TYPE Error;
+    UINTN Index;
     PCK_OBJECT Object;
+    PCK_OBJECT ObjectLists[2];
     PCK_CLASS ObjectMeta;
     UINTN Size;
     CK_VALUE Value;
@@ -332,6 +334,7 @@ Return Value:
     }
 
     Classes->Object->Super = Classes->Object;
+    CkpWriteBarrier(Vm, &(Classes->Object->Header));
     CkpCoreAddPrimitives(Vm, Classes->Object, CkObjectPrimitives);
 
     //
@@ -359,6 +362,9 @@ Return Value:
     Classes->Object->Header.Class = ObjectMeta;
     ObjectMeta->Header.Class = Classes->Class;
     Classes->Class->Header.Class = Classes->Class;
+    CkpWriteBarrier(Vm, &(Classes->Object->Header));
+    CkpWriteBarrier(Vm, &(ObjectMeta->Header));
+    CkpWriteBarrier(Vm, &(Classes->Class->Header));
     CkpBindSuperclass(Vm, ObjectMeta, Classes->Class);
 
     //
@@ -425,25 +431,32 @@ Return Value:
 
     //
     // Patch up any of the core objects that may have been created before their
-    // associated classes existed.
+    // associated classes existed. Some of them may have already been through
+    // a garbage collection, so look at both the young and old objects. The
+    // collector doesn't follow the class pointer of these types, so there's
+    // no need for a write barrier.
     //
 
-    Object = Vm->FirstObject;
-    while (Object != NULL) {
-        if (Object->Type == CkObjectString) {
-            Object->Class = Classes->String;
+    ObjectLists[0] = Vm->FirstObject;
+    ObjectLists[1] = Vm->FirstOldObject;
+    for (Index = 0; Index < 2; Index += 1) {
+        Object = ObjectLists[Index];
+        while (Object != NULL) {
+            if (Object->Type == CkObjectString) {
+                Object->Class = Classes->String;
 
-        } else if (Object->Type == CkObjectClosure) {
-            Object->Class = Classes->Function;
+            } else if (Object->Type == CkObjectClosure) {
+                Object->Class = Classes->Function;
 
-        } else if (Object->Type == CkObjectDict) {
-            Object->Class = Classes->Dict;
+            } else if (Object->Type == CkObjectDict) {
+                Object->Class = Classes->Dict;
 
-        } else if (Object->Type == CkObjectFiber) {
-            Object->Class = Classes->Fiber;
-        }
+            } else if (Object->Type == CkObjectFiber) {
+                Object->Class = Classes->Fiber;
+            }
 
-        Object = Object->Next;
+            Object = Object->Next;
+        }
     }
 
     CoreModule->Header.Class = Classes->Module;
@@ -763,6 +776,7 @@ Return Value:
 
     Module = Class->Module;
     Index = CkpStringTableEnsure(Vm, &(Module->Strings), Name, strlen(Name));
+    CkpWriteBarrier(Vm, &(Module->Header));
     if (Index == -1) {
         return;
     }
@@ -1156,6 +1170,7 @@ Return Value:
         }
 
         CK_OBJECT_VALUE(Instance->Fields[0], Dict);
+        CkpWriteBarrier(Vm, &(Instance->Header));
 
     } else {
         Dict = CK_AS_DICT(Instance->Fields[0]);
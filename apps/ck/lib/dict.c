@@ -317,6 +317,7 @@ Return Value:
         Dict->Count += 1;
     }
 
+    CkpWriteBarrier(Vm, &(Dict->Header));
     return;
 }
 
@@ -257,6 +257,7 @@ Return Value:
             }
 
             Vm->Fiber = Fiber;
+            CkpWriteBarrier(Vm, &(Fiber->Header));
             continue;
         }
 
@@ -652,6 +653,7 @@ Return Value:
         }
 
         CK_OBJECT_VALUE(Instance->Fields[0], Dict);
+        CkpWriteBarrier(Vm, &(Instance->Header));
     }
 
     Dict = CK_AS_DICT(Instance->Fields[0]);
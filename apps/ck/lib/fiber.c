@@ -540,6 +540,7 @@ Return Value:
 
         CkpAppendCallFrame(Vm, Fiber, Closure, Fiber->Stack);
         CkpEnsureStack(Vm, Fiber, Closure->U.Block.Function->MaxStack);
+        CkpWriteBarrier(Vm, &(Fiber->Header));
     }
 
     return;
@@ -1000,6 +1001,7 @@ Return Value:
     Vm->Fiber = CurrentFiber->Caller;
     CurrentFiber->Caller = NULL;
     if (Vm->Fiber != NULL) {
+        CkpWriteBarrier(Vm, &(Vm->Fiber->Header));
 
         //
         // If the caller had foreign functions in progress that were added to
@@ -1135,6 +1137,7 @@ Return Value:
     }
 
     Vm->Fiber = Fiber;
+    CkpWriteBarrier(Vm, &(Fiber->Header));
     return;
 }
 
@@ -31,6 +31,7 @@ Module Name:
 //
 
 #include "chalkp.h"
+#include <time.h>
 #include "compiler.h"
 #include "debug.h"
 #include <minoca/lib/status.h>
@@ -42,6 +43,27 @@ Module Name:
 // ---------------------------------------------------------------- Definitions
 //
 
+//
+// Define the initial number of elements in the remembered set.
+//
+
+#define CK_REMEMBERED_SET_INITIAL_CAPACITY 64
+
+//
+// When stressing the garbage collector, run a full collection once every this
+// many collections, and minor collections otherwise.
+//
+
+#define CK_GC_STRESS_FULL_INTERVAL 8
+
+//
+// Define the fraction of the heap that can be allocated before a minor
+// collection is run, expressed as a shift. If this is larger than the
+// configured nursery size, it is used instead.
+//
+
+#define CK_NURSERY_HEAP_SHIFT 3
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -50,6 +72,22 @@ Module Name:
 // ----------------------------------------------- Internal Function Prototypes
 //
 
+VOID
+CkpCollectGarbage (
+    PCK_VM Vm,
+    BOOL Minor
+    );
+
+VOID
+CkpRememberRoots (
+    PCK_VM Vm
+    );
+
+VOID
+CkpForgetRememberedObjects (
+    PCK_VM Vm
+    );
+
 VOID
 CkpKissCompiler (
     PCK_VM Vm,
@@ -74,6 +112,12 @@ CkpDeeplyKiss (
     PCK_OBJECT Head
     );
 
+VOID
+CkpKissComponents (
+    PCK_VM Vm,
+    PCK_OBJECT Object
+    );
+
 VOID
 CkpCollectUnkissedObjects (
     PCK_VM Vm
@@ -192,57 +236,44 @@ Return Value:
 
 {
 
-    UINTN Index;
-    CK_OBJECT KissHead;
+    CkpCollectGarbage(Vm, FALSE);
+    return;
+}
 
-    //
-    // Reset the number of bytes allocated, and have the kiss functions count
-    // their allocations. This avoids the extra work of having to determine
-    // the size of objects being freed. The tradeoff is that the bytes
-    // allocated won't count non-object allocations, so it will be a bit low.
-    //
+CK_API
+VOID
+CkGetGarbageStatistics (
+    PCK_VM Vm,
+    PCK_GARBAGE_STATISTICS Statistics
+    )
 
-    Vm->BytesAllocated = 0;
-    Vm->GarbageRuns += 1;
-    Vm->GarbageFreed = 0;
+/*++
 
-    //
-    // Set up the head of the kiss list. Make it a circle so that the last
-    // object added does not have a non-null pointer.
-    //
+Routine Description:
 
-    KissHead.Type = CkObjectInvalid;
-    KissHead.Next = NULL;
-    KissHead.NextKiss = &KissHead;
-    Vm->KissList = &KissHead;
-    CkpKissObject(Vm, &(Vm->Modules->Header));
-    CkpKissObject(Vm, &(Vm->ModulePath->Header));
-    for (Index = 0; Index < Vm->WorkingObjectCount; Index += 1) {
-        CkpKissObject(Vm, Vm->WorkingObjects[Index]);
-    }
+    This routine returns the garbage collector statistics for the given Chalk
+    instance.
 
-    CkpKissObject(Vm, &(Vm->Fiber->Header));
-    if (Vm->Compiler != NULL) {
-        CkpKissCompiler(Vm, Vm->Compiler);
-    }
+Arguments:
 
-    CkpKissObject(Vm, &(Vm->UnhandledException->Header));
-    CkpDeeplyKiss(Vm, &KissHead);
-    CkpCollectUnkissedObjects(Vm);
+    Vm - Supplies a pointer to the virtual machine.
 
-    //
-    // Determine the next garbage collection time, expressed as an additional
-    // percentage growth. Except rather than using percent 100 exactly, use
-    // 1024 to avoid the divide. It looks nearly the same as percent times 10.
-    //
+    Statistics - Supplies a pointer where the statistics will be returned.
 
-    Vm->NextGarbageCollection = Vm->BytesAllocated *
-                           (1024 + Vm->Configuration.HeapGrowthPercent) / 1024;
+Return Value:
 
-    if (Vm->NextGarbageCollection < Vm->Configuration.MinimumHeapSize) {
-        Vm->NextGarbageCollection = Vm->Configuration.MinimumHeapSize;
-    }
+    None.
+
+--*/
+
+{
 
+    CkCopy(Statistics,
+           &(Vm->GarbageStatistics),
+           sizeof(CK_GARBAGE_STATISTICS));
+
+    Statistics->BytesAllocated = Vm->BytesAllocated;
+    Statistics->NextFullCollection = Vm->NextGarbageCollection;
     return;
 }
 
@@ -311,6 +342,75 @@ Return Value:
     return;
 }
 
+VOID
+CkpRememberObject (
+    PCK_VM Vm,
+    PCK_OBJECT Object
+    )
+
+/*++
+
+Routine Description:
+
+    This routine adds an old object to the remembered set, as it may now point
+    at young objects. Use the write barrier macro rather than calling this
+    directly.
+
+Arguments:
+
+    Vm - Supplies a pointer to the virtual machine.
+
+    Object - Supplies a pointer to the old object that was written to.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    UINTN NewCapacity;
+    PCK_OBJECT *NewSet;
+
+    CK_ASSERT((Object->Flags & CK_OBJECT_OLD) != 0);
+
+    if ((Object->Flags & CK_OBJECT_REMEMBERED) != 0) {
+        return;
+    }
+
+    //
+    // The remembered set is allocated directly rather than through the
+    // collected allocator, since allocating could otherwise kick off a
+    // collection in the middle of a write barrier. If the set cannot grow,
+    // give up on it and do a full collection next time.
+    //
+
+    if (Vm->RememberedCount == Vm->RememberedCapacity) {
+        NewCapacity = Vm->RememberedCapacity * 2;
+        if (NewCapacity == 0) {
+            NewCapacity = CK_REMEMBERED_SET_INITIAL_CAPACITY;
+        }
+
+        NewSet = CkRawReallocate(Vm,
+                                 Vm->RememberedSet,
+                                 NewCapacity * sizeof(PCK_OBJECT));
+
+        if (NewSet == NULL) {
+            Vm->RememberedOverflow = TRUE;
+            return;
+        }
+
+        Vm->RememberedSet = NewSet;
+        Vm->RememberedCapacity = NewCapacity;
+    }
+
+    Object->Flags |= CK_OBJECT_REMEMBERED;
+    Vm->RememberedSet[Vm->RememberedCount] = Object;
+    Vm->RememberedCount += 1;
+    return;
+}
+
 PVOID
 CkpReallocate (
     PCK_VM Vm,
@@ -354,16 +454,35 @@ Return Value:
     //
 
     Vm->BytesAllocated += NewSize - OldSize;
+    if (NewSize > OldSize) {
+        Vm->NurseryBytes += NewSize - OldSize;
+    }
 
     //
-    // Potentially perform garbage collection.
+    // Potentially perform garbage collection. Do a full collection if the
+    // whole heap has grown enough, or just collect the young objects if
+    // enough has been allocated since the last collection.
     //
 
-    if ((NewSize > 0) &&
-        ((Vm->BytesAllocated >= Vm->NextGarbageCollection) ||
-         (CK_VM_FLAG_SET(Vm, CK_CONFIGURATION_GC_STRESS)))) {
+    if (NewSize > 0) {
+        if (Vm->BytesAllocated >= Vm->NextGarbageCollection) {
+            CkpCollectGarbage(Vm, FALSE);
+
+        } else if ((Vm->Configuration.NurserySize != 0) &&
+                   (Vm->NurseryBytes >= Vm->NurseryLimit)) {
+
+            CkpCollectGarbage(Vm, TRUE);
 
-        CkCollectGarbage(Vm);
+        } else if (CK_VM_FLAG_SET(Vm, CK_CONFIGURATION_GC_STRESS)) {
+            if ((Vm->Configuration.NurserySize == 0) ||
+                ((Vm->GarbageRuns % CK_GC_STRESS_FULL_INTERVAL) == 0)) {
+
+                CkpCollectGarbage(Vm, FALSE);
+
+            } else {
+                CkpCollectGarbage(Vm, TRUE);
+            }
+        }
     }
 
     Allocation = CkRawReallocate(Vm, Memory, NewSize);
@@ -391,6 +510,273 @@ Return Value:
 // --------------------------------------------------------- Internal Functions
 //
 
+VOID
+CkpCollectGarbage (
+    PCK_VM Vm,
+    BOOL Minor
+    )
+
+/*++
+
+Routine Description:
+
+    This routine performs garbage collection. Objects start out young, and
+    any that survive a collection become old. A minor collection only
+    traverses and frees young objects, using the remembered set to find old
+    objects that point at young ones. A full collection examines everything.
+
+Arguments:
+
+    Vm - Supplies a pointer to the virtual machine.
+
+    Minor - Supplies a boolean indicating whether to only collect young
+        objects (TRUE) or perform a full collection (FALSE).
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    UINTN Index;
+    CK_OBJECT KissHead;
+    UINTN OldBytes;
+    ULONGLONG Pause;
+    clock_t Start;
+    PCK_GARBAGE_STATISTICS Statistics;
+
+    Start = clock();
+
+    //
+    // Remember the roots before deciding what kind of collection this is,
+    // since adding them may be what overflows the remembered set.
+    //
+
+    if (Minor != FALSE) {
+        CkpRememberRoots(Vm);
+    }
+
+    if (Vm->RememberedOverflow != FALSE) {
+        Minor = FALSE;
+    }
+
+    Vm->MinorCollection = Minor;
+    Vm->GarbageRuns += 1;
+    Vm->GarbageFreed = 0;
+
+    //
+    // Set up the head of the kiss list. Make it a circle so that the last
+    // object added does not have a non-null pointer.
+    //
+
+    KissHead.Type = CkObjectInvalid;
+    KissHead.Flags = 0;
+    KissHead.Next = NULL;
+    KissHead.NextKiss = &KissHead;
+    Vm->KissList = &KissHead;
+
+    //
+    // For a minor collection, the old objects that have been written to since
+    // the last collection act as roots. Roots that are old themselves were
+    // added to the set above, since they're written to without barriers.
+    //
+
+    OldBytes = 0;
+    if (Minor != FALSE) {
+
+        //
+        // The old generation size is whatever the heap was before, minus the
+        // young allocations. Grab it before kissing adds to the count.
+        //
+
+        OldBytes = Vm->BytesAllocated;
+        if (OldBytes > Vm->NurseryBytes) {
+            OldBytes -= Vm->NurseryBytes;
+
+        } else {
+            OldBytes = 0;
+        }
+
+        for (Index = 0; Index < Vm->RememberedCount; Index += 1) {
+            CkpKissComponents(Vm, Vm->RememberedSet[Index]);
+        }
+    }
+
+    //
+    // Reset the number of bytes allocated, and have the kiss functions count
+    // their allocations. This avoids the extra work of having to determine
+    // the size of objects being freed. The tradeoff is that the bytes
+    // allocated won't count non-object allocations, so it will be a bit low.
+    // Minor collections only count the young survivors, and add them to the
+    // old generation.
+    //
+
+    Vm->BytesAllocated = 0;
+    CkpKissObject(Vm, &(Vm->Modules->Header));
+    CkpKissObject(Vm, &(Vm->ModulePath->Header));
+    for (Index = 0; Index < Vm->WorkingObjectCount; Index += 1) {
+        CkpKissObject(Vm, Vm->WorkingObjects[Index]);
+    }
+
+    CkpKissObject(Vm, &(Vm->Fiber->Header));
+    if (Vm->Compiler != NULL) {
+        CkpKissCompiler(Vm, Vm->Compiler);
+    }
+
+    CkpKissObject(Vm, &(Vm->UnhandledException->Header));
+    CkpDeeplyKiss(Vm, &KissHead);
+    Vm->BytesAllocated += OldBytes;
+    CkpForgetRememberedObjects(Vm);
+    CkpCollectUnkissedObjects(Vm);
+    Vm->NurseryBytes = 0;
+    Vm->MinorCollection = FALSE;
+
+    //
+    // Everything that survived is now old. Remember the roots again, since
+    // they'll be written to before the next collection without barriers.
+    //
+
+    CkpRememberRoots(Vm);
+
+    //
+    // Size the nursery relative to the heap, so that the cost of rescanning
+    // the remembered set is spread over a proportional amount of allocation.
+    //
+
+    Vm->NurseryLimit = Vm->BytesAllocated >> CK_NURSERY_HEAP_SHIFT;
+    if (Vm->NurseryLimit < Vm->Configuration.NurserySize) {
+        Vm->NurseryLimit = Vm->Configuration.NurserySize;
+    }
+
+    //
+    // Determine the next full garbage collection time, expressed as an
+    // additional percentage growth. Except rather than using percent 100
+    // exactly, use 1024 to avoid the divide. It looks nearly the same as
+    // percent times 10.
+    //
+
+    Statistics = &(Vm->GarbageStatistics);
+    if (Minor == FALSE) {
+        Vm->RememberedOverflow = FALSE;
+        Vm->NextGarbageCollection = Vm->BytesAllocated *
+                           (1024 + Vm->Configuration.HeapGrowthPercent) / 1024;
+
+        if (Vm->NextGarbageCollection < Vm->Configuration.MinimumHeapSize) {
+            Vm->NextGarbageCollection = Vm->Configuration.MinimumHeapSize;
+        }
+    }
+
+    Pause = ((ULONGLONG)(clock() - Start) * 1000000ULL) / CLOCKS_PER_SEC;
+    if (Minor != FALSE) {
+        Statistics->MinorCollections += 1;
+        Statistics->MinorTime += Pause;
+
+    } else {
+        Statistics->FullCollections += 1;
+        Statistics->FullTime += Pause;
+    }
+
+    Statistics->LastPause = Pause;
+    if (Pause > Statistics->MaxPause) {
+        Statistics->MaxPause = Pause;
+    }
+
+    return;
+}
+
+VOID
+CkpRememberRoots (
+    PCK_VM Vm
+    )
+
+/*++
+
+Routine Description:
+
+    This routine adds any old objects that the VM modifies without write
+    barriers to the remembered set. These are the working objects (which are
+    usually in the middle of being filled in), the current fiber, and the
+    functions and module being compiled.
+
+Arguments:
+
+    Vm - Supplies a pointer to the virtual machine.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PCK_COMPILER Compiler;
+    UINTN Index;
+    PCK_OBJECT Object;
+
+    for (Index = 0; Index < Vm->WorkingObjectCount; Index += 1) {
+        Object = Vm->WorkingObjects[Index];
+        CkpWriteBarrier(Vm, Object);
+    }
+
+    if (Vm->Fiber != NULL) {
+        CkpWriteBarrier(Vm, &(Vm->Fiber->Header));
+    }
+
+    Compiler = Vm->Compiler;
+    if ((Compiler != NULL) && (Compiler->Parser != NULL) &&
+        (Compiler->Parser->Module != NULL)) {
+
+        CkpWriteBarrier(Vm, &(Compiler->Parser->Module->Header));
+    }
+
+    while (Compiler != NULL) {
+        if (Compiler->Function != NULL) {
+            CkpWriteBarrier(Vm, &(Compiler->Function->Header));
+        }
+
+        Compiler = Compiler->Parent;
+    }
+
+    return;
+}
+
+VOID
+CkpForgetRememberedObjects (
+    PCK_VM Vm
+    )
+
+/*++
+
+Routine Description:
+
+    This routine empties the remembered set. This is done during collection,
+    after kissing and before any objects are freed.
+
+Arguments:
+
+    Vm - Supplies a pointer to the virtual machine.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    UINTN Index;
+
+    for (Index = 0; Index < Vm->RememberedCount; Index += 1) {
+        Vm->RememberedSet[Index]->Flags &= ~CK_OBJECT_REMEMBERED;
+    }
+
+    Vm->RememberedCount = 0;
+    return;
+}
+
 VOID
 CkpKissCompiler (
     PCK_VM Vm,
@@ -440,12 +826,16 @@ Return Value:
         //
         // Most things in the compiler are allocated as local variables on the
         // stack. Only count those bytes that are actually dynamically
-        // allocated.
+        // allocated. Minor collections already count these as part of the
+        // old generation.
         //
 
-        Vm->BytesAllocated += (Compiler->LocalCapacity * sizeof(CK_LOCAL)) +
-                              (Compiler->UpvalueCapacity *
-                               sizeof(CK_COMPILER_UPVALUE));
+        if (Vm->MinorCollection == FALSE) {
+            Vm->BytesAllocated +=
+                               (Compiler->LocalCapacity * sizeof(CK_LOCAL)) +
+                               (Compiler->UpvalueCapacity *
+                                sizeof(CK_COMPILER_UPVALUE));
+        }
 
         Compiler = Compiler->Parent;
     }
@@ -518,6 +908,17 @@ Return Value:
 
     if ((Object != NULL) && (Object->NextKiss == NULL)) {
 
+        //
+        // Minor collections leave old objects alone. Any young objects they
+        // point to are found through the remembered set.
+        //
+
+        if ((Vm->MinorCollection != FALSE) &&
+            ((Object->Flags & CK_OBJECT_OLD) != 0)) {
+
+            return;
+        }
+
         //
         // Wire the object in after the end of the list, and make it the new
         // end.
@@ -569,63 +970,94 @@ Return Value:
 
     Object = Head->NextKiss;
     while (Object != Head) {
-        switch (Object->Type) {
-        case CkObjectClass:
-            CkpKissClass(Vm, (PCK_CLASS)Object);
-            break;
+        CkpKissComponents(Vm, Object);
+        Object = Object->NextKiss;
+    }
 
-        case CkObjectClosure:
-            CkpKissClosure(Vm, (PCK_CLOSURE)Object);
-            break;
+    return;
+}
 
-        case CkObjectFiber:
-            CkpKissFiber(Vm, (PCK_FIBER)Object);
-            break;
+VOID
+CkpKissComponents (
+    PCK_VM Vm,
+    PCK_OBJECT Object
+    )
 
-        case CkObjectFunction:
-            CkpKissFunction(Vm, (PCK_FUNCTION)Object);
-            break;
+/*++
 
-        case CkObjectForeign:
-            CkpKissForeignData(Vm, (PCK_FOREIGN_DATA)Object);
-            break;
+Routine Description:
 
-        case CkObjectInstance:
-            CkpKissInstance(Vm, (PCK_INSTANCE)Object);
-            break;
+    This routine kisses everything the given object refers to.
 
-        case CkObjectList:
-            CkpKissList(Vm, (PCK_LIST)Object);
-            break;
+Arguments:
 
-        case CkObjectDict:
-            CkpKissDict(Vm, (PCK_DICT)Object);
-            break;
+    Vm - Supplies a pointer to the virtual machine.
 
-        case CkObjectModule:
-            CkpKissModule(Vm, (PCK_MODULE)Object);
-            break;
+    Object - Supplies a pointer to the object whose components should be
+        kissed.
 
-        case CkObjectRange:
-            CkpKissRange(Vm, (PCK_RANGE)Object);
-            break;
+Return Value:
 
-        case CkObjectString:
-            CkpKissString(Vm, (PCK_STRING)Object);
-            break;
+    None.
 
-        case CkObjectUpvalue:
-            CkpKissUpvalue(Vm, (PCK_UPVALUE)Object);
-            break;
+--*/
 
-        default:
+{
 
-            CK_ASSERT(FALSE);
+    switch (Object->Type) {
+    case CkObjectClass:
+        CkpKissClass(Vm, (PCK_CLASS)Object);
+        break;
 
-            break;
-        }
+    case CkObjectClosure:
+        CkpKissClosure(Vm, (PCK_CLOSURE)Object);
+        break;
 
-        Object = Object->NextKiss;
+    case CkObjectFiber:
+        CkpKissFiber(Vm, (PCK_FIBER)Object);
+        break;
+
+    case CkObjectFunction:
+        CkpKissFunction(Vm, (PCK_FUNCTION)Object);
+        break;
+
+    case CkObjectForeign:
+        CkpKissForeignData(Vm, (PCK_FOREIGN_DATA)Object);
+        break;
+
+    case CkObjectInstance:
+        CkpKissInstance(Vm, (PCK_INSTANCE)Object);
+        break;
+
+    case CkObjectList:
+        CkpKissList(Vm, (PCK_LIST)Object);
+        break;
+
+    case CkObjectDict:
+        CkpKissDict(Vm, (PCK_DICT)Object);
+        break;
+
+    case CkObjectModule:
+        CkpKissModule(Vm, (PCK_MODULE)Object);
+        break;
+
+    case CkObjectRange:
+        CkpKissRange(Vm, (PCK_RANGE)Object);
+        break;
+
+    case CkObjectString:
+        CkpKissString(Vm, (PCK_STRING)Object);
+        break;
+
+    case CkObjectUpvalue:
+        CkpKissUpvalue(Vm, (PCK_UPVALUE)Object);
+        break;
+
+    default:
+
+        CK_ASSERT(FALSE);
+
+        break;
     }
 
     return;
@@ -640,7 +1072,9 @@ CkpCollectUnkissedObjects (
 
 Routine Description:
 
-    This routine garbage collects any objects that have not been kissed.
+    This routine garbage collects any objects that have not been kissed. Young
+    objects that were kissed are promoted to the old generation. Old objects
+    are only examined during a full collection.
 
 Arguments:
 
@@ -656,45 +1090,89 @@ Return Value:
 
     PCK_OBJECT DeadAndAlone;
     ULONG DestroyCount;
+    PCK_OBJECT Next;
     PCK_OBJECT *Object;
+    PCK_OBJECT Young;
+    ULONG PromoteCount;
 
     DestroyCount = 0;
-    Object = &(Vm->FirstObject);
-    while (*Object != NULL) {
+
+    //
+    // Sweep the old objects first, so that the newly promoted objects don't
+    // look unkissed.
+    //
+
+    if (Vm->MinorCollection == FALSE) {
+        Object = &(Vm->FirstOldObject);
+        while (*Object != NULL) {
+
+            CK_ASSERT(((*Object)->Flags & CK_OBJECT_OLD) != 0);
+
+            //
+            // If the object has been kissed, then reset it for next time.
+            //
+
+            if ((*Object)->NextKiss != NULL) {
+                (*Object)->NextKiss = NULL;
+                Object = &((*Object)->Next);
+
+            //
+            // The object was never kissed. No one loves it, and it serves no
+            // purpose.
+            //
+
+            } else {
+                DeadAndAlone = *Object;
+                *Object = DeadAndAlone->Next;
+                CkpDestroyObject(Vm, DeadAndAlone);
+                DestroyCount += 1;
+            }
+        }
+    }
+
+    PromoteCount = 0;
+    Young = Vm->FirstObject;
+    Vm->FirstObject = NULL;
+    while (Young != NULL) {
+        Next = Young->Next;
 
         //
         // Take this opportunity to ensure that all objects have classes.
-        // Tack on a couple of conditions on the end to handle gaps during
-        // early init.
+        // Upvalues are never visible to the script, so they don't have
+        // one. Tack on a couple of conditions on the end to handle gaps
+        // during early init.
         //
 
-        CK_ASSERT(((*Object)->Class != NULL) ||
-                  ((*Object)->Type == CkObjectFunction) ||
+        CK_ASSERT((Young->Class != NULL) ||
+                  (Young->Type == CkObjectFunction) ||
+                  (Young->Type == CkObjectUpvalue) ||
                   (Vm->Class.Class == NULL) ||
                   (Vm->Class.Class->Flags == 0));
 
-        //
-        // If the object has been kissed, then reset it for next time.
-        //
-
-        if ((*Object)->NextKiss != NULL) {
-            (*Object)->NextKiss = NULL;
-            Object = &((*Object)->Next);
+        CK_ASSERT((Young->Flags & CK_OBJECT_OLD) == 0);
 
         //
-        // The object was never kissed. No one loves it, and it serves no
-        // purpose.
+        // Young objects that survived grow up.
         //
 
+        if (Young->NextKiss != NULL) {
+            Young->NextKiss = NULL;
+            Young->Flags |= CK_OBJECT_OLD;
+            Young->Next = Vm->FirstOldObject;
+            Vm->FirstOldObject = Young;
+            PromoteCount += 1;
+
         } else {
-            DeadAndAlone = *Object;
-            *Object = DeadAndAlone->Next;
-            CkpDestroyObject(Vm, DeadAndAlone);
+            CkpDestroyObject(Vm, Young);
             DestroyCount += 1;
         }
+
+        Young = Next;
     }
 
     Vm->GarbageFreed = DestroyCount;
+    Vm->GarbageStatistics.ObjectsFreed += DestroyCount;
+    Vm->GarbageStatistics.ObjectsPromoted += PromoteCount;
     if ((CK_VM_FLAG_SET(Vm, CK_CONFIGURATION_GC_STRESS)) &&
         (DestroyCount != 0)) {
 
@@ -980,6 +1458,8 @@ Return Value:
     CkpKissObject(Vm, &(Function->Debug.Name->Header));
     Vm->BytesAllocated += sizeof(CK_FUNCTION) +
                           (sizeof(UCHAR) * Function->Code.Capacity) +
+                          (sizeof(CK_CALL_SITE) *
+                           Function->CallSites.Capacity) +
                           (sizeof(UCHAR) *
                            Function->Debug.LineProgram.Capacity);
 
@@ -1093,7 +1573,7 @@ Return Value:
     CkpKissObject(Vm, &(Module->Name->Header));
     CkpKissObject(Vm, &(Module->Path->Header));
     CkpKissObject(Vm, &(Module->Closure->Header));
-    Vm->BytesAllocated = sizeof(CK_MODULE);
+    Vm->BytesAllocated += sizeof(CK_MODULE);
     return;
 }
 
@@ -1170,7 +1650,8 @@ CkpKissUpvalue (
 Routine Description:
 
     This routine kisses an upvalue object, preventing its components from being
-    garbage collected.
+    garbage collected. An open upvalue keeps the fiber holding its variable
+    alive, which in turn kisses the variable.
 
 Arguments:
 
@@ -1186,6 +1667,10 @@ Return Value:
 
 {
 
+    if (Upvalue->Fiber != NULL) {
+        CkpKissObject(Vm, &(Upvalue->Fiber->Header));
+    }
+
     CkpKissValue(Vm, Upvalue->Closed);
     Vm->BytesAllocated += sizeof(CK_UPVALUE);
     return;
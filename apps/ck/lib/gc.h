@@ -26,6 +26,27 @@ Module Name:
 // ------------------------------------------------------------------- Includes
 //
 
+//
+// --------------------------------------------------------------------- Macros
+//
+
+//
+// This macro must be invoked after storing a reference into an object (and
+// after any allocations made while filling the object in). If the object is
+// old, it is added to the remembered set so that the next minor collection
+// finds any young objects it now points to.
+//
+
+#define CkpWriteBarrier(_Vm, _Object)                                      \
+    do {                                                                   \
+        if (((_Object)->Flags & (CK_OBJECT_OLD | CK_OBJECT_REMEMBERED)) == \
+            CK_OBJECT_OLD) {                                               \
+                                                                           \
+            CkpRememberObject((_Vm), (_Object));                           \
+        }                                                                  \
+                                                                           \
+    } while (FALSE)
+
 //
 // ---------------------------------------------------------------- Definitions
 //
@@ -89,6 +110,32 @@ Return Value:
 
 --*/
 
+VOID
+CkpRememberObject (
+    PCK_VM Vm,
+    PCK_OBJECT Object
+    );
+
+/*++
+
+Routine Description:
+
+    This routine adds an old object to the remembered set, as it may now point
+    at young objects. Use the write barrier macro rather than calling this
+    directly.
+
+Arguments:
+
+    Vm - Supplies a pointer to the virtual machine.
+
+    Object - Supplies a pointer to the old object that was written to.
+
+Return Value:
+
+    None.
+
+--*/
+
 PVOID
 CkpReallocate (
     PCK_VM Vm,
@@ -289,6 +289,7 @@ Return Value:
     }
 
     List->Elements.Data[Index] = Element;
+    CkpWriteBarrier(Vm, &(List->Header));
     return;
 }
 
@@ -426,6 +427,7 @@ Return Value:
                  Source->Elements.Data,
                  Source->Elements.Count);
 
+    CkpWriteBarrier(Vm, &(Destination->Header));
     return Destination;
 }
 
@@ -938,6 +940,7 @@ Return Value:
     }
 
     List->Elements.Data[Index] = Arguments[2];
+    CkpWriteBarrier(Vm, &(List->Header));
     Arguments[0] = Arguments[2];
     return TRUE;
 }
@@ -429,6 +429,7 @@ Return Value:
         }
 
         Module->Closure = Closure;
+        CkpWriteBarrier(Vm, &(Module->Header));
     }
 
     Module->CompiledVariableCount = Module->VariableNames.List.Count;
@@ -520,6 +521,7 @@ Return Value:
     }
 
     Module->Closure = Closure;
+    CkpWriteBarrier(Vm, &(Module->Header));
     return Module;
 }
 
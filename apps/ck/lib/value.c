@@ -273,6 +273,7 @@ Return Value:
     CkpInitializeObject(Vm, &(Function->Header), CkObjectFunction, NULL);
     CkpInitializeArray(&(Function->Constants));
     CkpInitializeArray(&(Function->Code));
+    CkpInitializeArray(&(Function->CallSites));
     Function->Module = Module;
     Function->MaxStack = StackSize;
     Function->UpvalueCount = 0;
@@ -318,6 +319,7 @@ Return Value:
         Function = (PCK_FUNCTION)Object;
         CkpClearArray(Vm, &(Function->Constants));
         CkpClearArray(Vm, &(Function->Code));
+        CkpClearArray(Vm, &(Function->CallSites));
         CkpClearArray(Vm, &(Function->Debug.LineProgram));
         break;
 
@@ -398,6 +400,7 @@ Return Value:
 {
 
     Object->Type = Type;
+    Object->Flags = 0;
     Object->NextKiss = NULL;
     Object->Class = Class;
     Object->Next = Vm->FirstObject;
@@ -682,6 +685,13 @@ Return Value:
         return NULL;
     }
 
+    //
+    // Method call sites cache classes by address, so give the class a fresh
+    // epoch in case it landed where a since collected class used to be.
+    //
+
+    Vm->MethodEpoch += 1;
+    Class->MethodEpoch = Vm->MethodEpoch;
     return Class;
 }
 
@@ -722,6 +732,8 @@ Return Value:
 
     CK_OBJECT_VALUE(Value, Closure);
     CkpDictSet(Vm, Class->Methods, Signature, Value);
+    Vm->MethodEpoch += 1;
+    Class->MethodEpoch = Vm->MethodEpoch;
 
     //
     // Bind the closure to the class, so that when it's run it knows 1) where
@@ -729,6 +741,7 @@ Return Value:
     //
 
     Closure->Class = Class;
+    CkpWriteBarrier(Vm, &(Closure->Header));
     return;
 }
 
@@ -763,12 +776,15 @@ Return Value:
 
     Class->Super = Super;
     Class->SuperFieldCount = Super->FieldCount;
+    CkpWriteBarrier(Vm, &(Class->Header));
 
     //
     // Copy all the methods in the superclass to this class.
     //
 
     CkpDictCombine(Vm, Class->Methods, Super->Methods);
+    Vm->MethodEpoch += 1;
+    Class->MethodEpoch = Vm->MethodEpoch;
     return;
 }
 
@@ -113,6 +113,30 @@ Module Name:
 #define CK_CLASS_SPECIAL_CREATION 0x00000002
 #define CK_CLASS_FOREIGN 0x00000004
 
+//
+// Define the object garbage collection flags.
+//
+
+//
+// This flag is set once an object has survived a garbage collection. Old
+// objects are not traversed or freed by minor collections.
+//
+
+#define CK_OBJECT_OLD 0x00000001
+
+//
+// This flag is set if an old object is in the remembered set, meaning it may
+// point at young objects.
+//
+
+#define CK_OBJECT_REMEMBERED 0x00000002
+
+//
+// Define the number of classes each method call site remembers.
+//
+
+#define CK_CALL_CACHE_SIZE 4
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -273,11 +297,14 @@ Structure Description:
     Type - Stores the type of the object, which defines the parent type this
         structure is embedded in.
 
+    Flags - Stores a bitfield of garbage collection flags. See CK_OBJECT_*
+        definitions.
+
     NextKiss - Stores a pointer to the next object in the list of kissed
         objects (objects that will not get garbage collected this time).
 
-    Next - Stores a pointer to the next object in the global list of all
-        objects.
+    Next - Stores a pointer to the next object in the list of all young or
+        all old objects.
 
     Class - Stores a pointer to the class this object belongs to.
 
@@ -285,6 +312,7 @@ Structure Description:
 
 struct _CK_OBJECT {
     CK_OBJECT_TYPE Type;
+    ULONG Flags;
     PCK_OBJECT NextKiss;
     PCK_OBJECT Next;
     PCK_CLASS Class;
@@ -363,6 +391,9 @@ Structure Description:
     Next - Stores a pointer to the next open upvalue in the list of all open
         upvalues in the current fiber.
 
+    Fiber - Stores a pointer to the fiber whose stack holds the variable while
+        the upvalue is open, or NULL once the upvalue is closed.
+
 --*/
 
 struct _CK_UPVALUE {
@@ -370,6 +401,7 @@ struct _CK_UPVALUE {
     PCK_VALUE Value;
     CK_VALUE Closed;
     PCK_UPVALUE Next;
+    PCK_FIBER Fiber;
 };
 
 /*++
@@ -462,6 +494,81 @@ typedef struct _CK_FUNCTION_DEBUG {
 
 /*++
 
+Structure Description:
+
+    This structure defines an entry in a method call site's inline cache.
+
+Members:
+
+    Class - Stores a pointer to the receiver class this entry applies to.
+
+    Closure - Stores a pointer to the method the class resolved to.
+
+    Epoch - Stores the class's method epoch when the entry was filled. If the
+        class's epoch has since changed, the entry is stale.
+
+--*/
+
+typedef struct _CK_CALL_CACHE_ENTRY {
+    PCK_CLASS Class;
+    struct _CK_CLOSURE *Closure;
+    UINTN Epoch;
+} CK_CALL_CACHE_ENTRY, *PCK_CALL_CACHE_ENTRY;
+
+/*++
+
+Structure Description:
+
+    This structure defines a method call site within a function. Call
+    instructions refer to their call site, which holds the method signature
+    and caches the methods the site recently dispatched to, so that repeated
+    calls on the same classes skip the method dictionary lookup.
+
+Members:
+
+    Symbol - Stores the index of the method signature in the module's string
+        table.
+
+    Count - Stores the number of valid entries in the cache.
+
+    Next - Stores the index of the entry to replace once the cache is full.
+
+    Entries - Stores the cached class to method translations.
+
+--*/
+
+typedef struct _CK_CALL_SITE {
+    CK_SYMBOL_INDEX Symbol;
+    USHORT Count;
+    USHORT Next;
+    CK_CALL_CACHE_ENTRY Entries[CK_CALL_CACHE_SIZE];
+} CK_CALL_SITE, *PCK_CALL_SITE;
+
+/*++
+
+Structure Description:
+
+    This structure defines an array of method call sites.
+
+Members:
+
+    Data - Stores a pointer to the array itself.
+
+    Count - Stores the number of elements currently in the array.
+
+    Capacity - Stores the maximum size of the array before it must be
+        reallocated.
+
+--*/
+
+typedef struct _CK_CALL_SITE_ARRAY {
+    PCK_CALL_SITE Data;
+    UINTN Count;
+    UINTN Capacity;
+} CK_CALL_SITE_ARRAY, *PCK_CALL_SITE_ARRAY;
+
+/*++
+
 Structure Description:
 
     This structure defines a function object.
@@ -476,6 +583,9 @@ Structure Description:
 
     Module - Stores a pointer to the module the function resides in.
 
+    CallSites - Stores the method call sites in the function. Call
+        instructions encode an index into this array.
+
     MaxStack - Stores the number of stack slots used by the function.
 
     UpvalueCount - Stores the number of upvalues closed over by the function.
@@ -492,6 +602,7 @@ typedef struct _CK_FUNCTION {
     CK_BYTE_ARRAY Code;
     CK_VALUE_ARRAY Constants;
     PCK_MODULE Module;
+    CK_CALL_SITE_ARRAY CallSites;
     CK_SYMBOL_INDEX MaxStack;
     CK_SYMBOL_INDEX UpvalueCount;
     CK_ARITY Arity;
@@ -691,6 +802,11 @@ Structure Description:
     Flags - Stores flags describing special behaviors of this class. See
         CK_CLASS_* definitions.
 
+    MethodEpoch - Stores a value that is unique to the current state of this
+        class's methods. It changes whenever a method is bound, so call site
+        caches can tell when their entries for this class are stale. A new
+        class never reuses the epoch of a collected class at the same address.
+
 --*/
 
 struct _CK_CLASS {
@@ -702,6 +818,7 @@ struct _CK_CLASS {
     PCK_STRING Name;
     PCK_MODULE Module;
     ULONG Flags;
+    UINTN MethodEpoch;
 };
 
 /*++
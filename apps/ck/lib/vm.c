@@ -295,6 +295,7 @@ CkpCaptureUpvalue (
 
 VOID
 CkpCloseUpvalues (
+    PCK_VM Vm,
     PCK_FIBER Fiber,
     PCK_VALUE Last
     );
@@ -400,6 +401,8 @@ Return Value:
     }
 
     Vm->NextGarbageCollection = Vm->Configuration.InitialHeapSize;
+    Vm->NurseryLimit = Vm->Configuration.NurserySize;
+    Vm->MethodEpoch = 1;
     Vm->Modules = CkpDictCreate(Vm);
     if (Vm->Modules == NULL) {
         Status = CkErrorNoMemory;
@@ -466,6 +469,18 @@ Return Value:
     }
 
     Vm->FirstObject = NULL;
+    Object = Vm->FirstOldObject;
+    while (Object != NULL) {
+        Next = Object->Next;
+        CkpDestroyObject(Vm, Object);
+        Object = Next;
+    }
+
+    Vm->FirstOldObject = NULL;
+    if (Vm->RememberedSet != NULL) {
+        CkRawFree(Vm, Vm->RememberedSet);
+        Vm->RememberedSet = NULL;
+    }
 
     //
     // Null out the reallocate function to catch double frees.
@@ -575,6 +590,7 @@ Return Value:
 
     CK_INT_VALUE(Value, Line);
     Error = CkpArrayAppend(Vm, &(Module->Variables), Value);
+    CkpWriteBarrier(Vm, &(Module->Header));
     if (Error != CkSuccess) {
         return -2;
     }
@@ -662,6 +678,7 @@ Return Value:
         Symbol = -1;
     }
 
+    CkpWriteBarrier(Vm, &(Module->Header));
     if (CK_IS_OBJECT(Value)) {
         CkpPopRoot(Vm);
     }
@@ -725,6 +742,13 @@ Return Value:
             CkpArrayAppend(Vm, &(Module->Variables), Value);
         }
 
+        //
+        // The caller is going to write to the variable, so remember the
+        // module.
+        //
+
+        CkpWriteBarrier(Vm, &(Module->Header));
+
     } else {
         Symbol = CkpStringTableFind(&(Module->VariableNames), Name, NameSize);
     }
@@ -872,6 +896,7 @@ Return Value:
     PCK_FIBER NextFiber;
     USHORT Offset;
     CK_VALUE Receiver;
+    PCK_CALL_SITE Site;
     PCK_VALUE Stack;
     CK_SYMBOL_INDEX Symbol;
     PCK_UPVALUE Upvalue;
@@ -883,6 +908,7 @@ Return Value:
               (Vm->Fiber == Fiber));
 
     Vm->Fiber = Fiber;
+    CkpWriteBarrier(Vm, &(Fiber->Header));
     CKI_LOAD_FRAME();
 
     //
@@ -976,6 +1002,19 @@ Return Value:
 
         Upvalue = Frame->Closure->Upvalues[Local];
         *(Upvalue->Value) = CKI_STACK_TOP();
+
+        //
+        // An open upvalue writes straight into a fiber's stack, which may
+        // not be the current fiber.
+        //
+
+        if (Upvalue->Fiber != NULL) {
+            CkpWriteBarrier(Vm, &(Upvalue->Fiber->Header));
+
+        } else {
+            CkpWriteBarrier(Vm, &(Upvalue->Header));
+        }
+
         CKI_DISPATCH();
 
     CKI_CASE(CkOpLoadModuleVariable):
@@ -992,6 +1031,7 @@ Return Value:
         CK_ASSERT(Symbol < Function->Module->Variables.Count);
 
         Function->Module->Variables.Data[Symbol] = CKI_STACK_TOP();
+        CkpWriteBarrier(Vm, &(Function->Module->Header));
         CKI_DISPATCH();
 
     CKI_CASE(CkOpLoadFieldThis):
@@ -1020,6 +1060,7 @@ Return Value:
         CK_ASSERT(Symbol < Instance->Header.Class->FieldCount);
 
         Instance->Fields[Symbol] = CKI_STACK_TOP();
+        CkpWriteBarrier(Vm, &(Instance->Header));
         CKI_DISPATCH();
 
     CKI_CASE(CkOpLoadField):
@@ -1048,6 +1089,7 @@ Return Value:
         CK_ASSERT(Symbol < Instance->Header.Class->FieldCount);
 
         Instance->Fields[Symbol] = CKI_STACK_TOP();
+        CkpWriteBarrier(Vm, &(Instance->Header));
         CKI_DISPATCH();
 
     CKI_CASE(CkOpPop):
@@ -1067,9 +1109,12 @@ Return Value:
         CKI_READ_SYMBOL(Symbol);
         Arguments = Fiber->StackTop - Arity;
         Class = CkpGetClass(Vm, Arguments[0]);
-        MethodName = Function->Module->Strings.List.Data[Symbol];
+
+        CK_ASSERT(Symbol < Function->CallSites.Count);
+
+        Site = &(Function->CallSites.Data[Symbol]);
         CKI_STORE_FRAME();
-        CkpCallMethod(Vm, Class, MethodName, Arity);
+        CkpCallCachedMethod(Vm, Class, Function->Module, Site, Arity);
         CKI_LOAD_FIBER();
         CKI_DISPATCH();
 
@@ -1079,9 +1124,12 @@ Return Value:
         CKI_READ_SYMBOL(Symbol);
         Arguments = Fiber->StackTop - Arity;
         Class = CkpGetClass(Vm, Arguments[0]);
-        MethodName = Function->Module->Strings.List.Data[Symbol];
+
+        CK_ASSERT(Symbol < Function->CallSites.Count);
+
+        Site = &(Function->CallSites.Data[Symbol]);
         CKI_STORE_FRAME();
-        CkpCallMethod(Vm, Class, MethodName, Arity);
+        CkpCallCachedMethod(Vm, Class, Function->Module, Site, Arity);
         CKI_LOAD_FIBER();
         CKI_DISPATCH();
 
@@ -1098,9 +1146,12 @@ Return Value:
         CKI_READ_SYMBOL(Symbol);
         Arguments = Fiber->StackTop - Arity;
         Class = Frame->Closure->Class->Super;
-        MethodName = Function->Module->Strings.List.Data[Symbol];
+
+        CK_ASSERT(Symbol < Function->CallSites.Count);
+
+        Site = &(Function->CallSites.Data[Symbol]);
         CKI_STORE_FRAME();
-        CkpCallMethod(Vm, Class, MethodName, Arity);
+        CkpCallCachedMethod(Vm, Class, Function->Module, Site, Arity);
         CKI_LOAD_FIBER();
         CKI_DISPATCH();
 
@@ -1110,9 +1161,12 @@ Return Value:
         CKI_READ_SYMBOL(Symbol);
         Arguments = Fiber->StackTop - Arity;
         Class = Frame->Closure->Class->Super;
-        MethodName = Function->Module->Strings.List.Data[Symbol];
+
+        CK_ASSERT(Symbol < Function->CallSites.Count);
+
+        Site = &(Function->CallSites.Data[Symbol]);
         CKI_STORE_FRAME();
-        CkpCallMethod(Vm, Class, MethodName, Arity);
+        CkpCallCachedMethod(Vm, Class, Function->Module, Site, Arity);
         CKI_LOAD_FIBER();
         CKI_DISPATCH();
 
@@ -1191,7 +1245,7 @@ Return Value:
         CKI_DISPATCH();
 
     CKI_CASE(CkOpCloseUpvalue):
-        CkpCloseUpvalues(Fiber, Fiber->StackTop - 1);
+        CkpCloseUpvalues(Vm, Fiber, Fiber->StackTop - 1);
         CKI_DISPATCH();
 
     CKI_CASE(CkOpReturn):
@@ -1202,7 +1256,7 @@ Return Value:
 
         Fiber->FrameCount -= 1;
         Fiber->TryCount = Frame->TryCount;
-        CkpCloseUpvalues(Fiber, Stack);
+        CkpCloseUpvalues(Vm, Fiber, Stack);
 
         //
         // Handle the fiber completing. Either return the value to the C caller,
@@ -1227,6 +1281,7 @@ Return Value:
             Fiber->Caller = NULL;
             Fiber = NextFiber;
             Vm->Fiber = NextFiber;
+            CkpWriteBarrier(Vm, &(NextFiber->Header));
             Vm->ForeignCalls -= NextFiber->ForeignCalls;
 
             CK_ASSERT(Fiber->StackTop > Fiber->Stack);
@@ -1300,6 +1355,8 @@ Return Value:
             }
         }
 
+        CkpWriteBarrier(Vm, &(Closure->Header));
+
         Function = Frame->Closure->U.Block.Function;
         CKI_DISPATCH();
 
@@ -1613,6 +1670,114 @@ Return Value:
     return CkpCallFunction(Vm, Closure, Arity);
 }
 
+BOOL
+CkpCallCachedMethod (
+    PCK_VM Vm,
+    PCK_CLASS Class,
+    PCK_MODULE Module,
+    PCK_CALL_SITE Site,
+    CK_ARITY Arity
+    )
+
+/*++
+
+Routine Description:
+
+    This routine invokes a class instance method from a call site, using the
+    call site's cache to avoid looking the method up when possible.
+
+Arguments:
+
+    Vm - Supplies a pointer to the virtual machine.
+
+    Class - Supplies a pointer to the class that owns the method.
+
+    Module - Supplies a pointer to the module containing the call site, whose
+        string table holds the method signature.
+
+    Site - Supplies a pointer to the call site.
+
+    Arity - Supplies the number of arguments the method was called with in
+        code (plus one for the receiver).
+
+Return Value:
+
+    TRUE if a new frame was pushed onto the stack and needs to be run by the
+    interpreter.
+
+    FALSE if the call completed already (primitive and foreign functions fit
+    this category).
+
+--*/
+
+{
+
+    PCK_CLOSURE Closure;
+    PCK_CALL_CACHE_ENTRY Entry;
+    ULONG Index;
+    CK_VALUE Method;
+    CK_VALUE MethodName;
+    PCK_STRING NameString;
+
+    //
+    // Look for the class in the cache. An entry filled before the class's
+    // methods last changed is stale, and gets refilled below.
+    //
+
+    Entry = NULL;
+    for (Index = 0; Index < Site->Count; Index += 1) {
+        if (Site->Entries[Index].Class == Class) {
+            Entry = &(Site->Entries[Index]);
+            if (Entry->Epoch == Class->MethodEpoch) {
+                return CkpCallFunction(Vm, Entry->Closure, Arity);
+            }
+
+            break;
+        }
+    }
+
+    //
+    // Look up the method the slow way and remember it, refilling the class's
+    // stale entry if it had one. Once the cache is full, replace entries in
+    // turn.
+    //
+
+    CK_ASSERT(Site->Symbol < Module->Strings.List.Count);
+
+    MethodName = Module->Strings.List.Data[Site->Symbol];
+
+    CK_ASSERT(CK_IS_STRING(MethodName));
+
+    Method = CkpDictGet(Class->Methods, MethodName);
+    if (CK_IS_UNDEFINED(Method)) {
+        NameString = CK_AS_STRING(MethodName);
+        CkpRuntimeError(Vm,
+                        "LookupError",
+                        "%s does not implement %s",
+                        Class->Name->Value,
+                        NameString->Value);
+
+        return FALSE;
+    }
+
+    Closure = CK_AS_CLOSURE(Method);
+    if (Entry == NULL) {
+        if (Site->Count < CK_CALL_CACHE_SIZE) {
+            Entry = &(Site->Entries[Site->Count]);
+            Site->Count += 1;
+
+        } else {
+            Entry = &(Site->Entries[Site->Next]);
+            Site->Next = (Site->Next + 1) % CK_CALL_CACHE_SIZE;
+        }
+    }
+
+    Entry->Class = Class;
+    Entry->Closure = Closure;
+    Entry->Epoch = Class->MethodEpoch;
+    return CkpCallFunction(Vm, Closure, Arity);
+}
+
 BOOL
 CkpCallFunction (
     PCK_VM Vm,
@@ -1816,6 +1981,7 @@ Return Value:
     NewUpvalue->Value = Local;
     NewUpvalue->Closed = CkNullValue;
     NewUpvalue->Next = Upvalue;
+    NewUpvalue->Fiber = Fiber;
     if (Previous != NULL) {
         Previous->Next = NewUpvalue;
 
@@ -1828,6 +1994,7 @@ Return Value:
 
 VOID
 CkpCloseUpvalues (
+    PCK_VM Vm,
     PCK_FIBER Fiber,
     PCK_VALUE Last
     )
@@ -1842,6 +2009,8 @@ Routine Description:
 
 Arguments:
 
+    Vm - Supplies a pointer to the virtual machine.
+
     Fiber - Supplies a pointer to the current fiber.
 
     Last - Supplies the soon-to-be new top of the stack.
@@ -1868,6 +2037,8 @@ Return Value:
         Upvalue = Fiber->OpenUpvalues;
         Upvalue->Closed = *(Upvalue->Value);
         Upvalue->Value = &(Upvalue->Closed);
+        Upvalue->Fiber = NULL;
+        CkpWriteBarrier(Vm, &(Upvalue->Header));
         Fiber->OpenUpvalues = Upvalue->Next;
     }
 
@@ -381,16 +381,45 @@ Structure Description:
         memory that has been freed since the last garbage collection.
 
     NextGarbageCollection - Stores the size that the allocated bytes have to
-        get to in order to trigger the next garbage collection.
+        get to in order to trigger the next full garbage collection.
+
+    NurseryBytes - Stores the number of bytes allocated since the last garbage
+        collection.
+
+    NurseryLimit - Stores the number of bytes that can be allocated before a
+        minor collection is run. This is at least the configured nursery size,
+        and grows with the heap so that rescanning large remembered objects
+        doesn't dominate.
 
     GarbageRuns - Stores the number of times the garbage collector has run.
 
     GarbageFreed - Stores the number of objects freed during the most recent
         garbage collection run.
 
-    FirstObject - Stores a pointer to the first object in the massive singly
-        linked list of all living objects. This is the list that the garbage
-        collector traverses.
+    FirstObject - Stores a pointer to the first object in the singly linked
+        list of young objects: those created since the last garbage
+        collection. This is the list that minor collections traverse.
+
+    FirstOldObject - Stores a pointer to the first object in the singly linked
+        list of old objects, which have survived at least one collection. Only
+        full collections free objects on this list.
+
+    RememberedSet - Stores an array of old objects that may point at young
+        objects. Minor collections treat these as roots.
+
+    RememberedCount - Stores the number of objects in the remembered set.
+
+    RememberedCapacity - Stores the number of elements the remembered set
+        array can hold before it must be reallocated.
+
+    RememberedOverflow - Stores a boolean indicating that an old object could
+        not be added to the remembered set, so the next collection must be a
+        full one.
+
+    MinorCollection - Stores a boolean indicating whether the collection in
+        progress is a minor one, in which case old objects are not kissed.
+
+    GarbageStatistics - Stores the garbage collector statistics.
 
     KissList - Stores the tail of the list of objects that have been kissed.
         The list is circular to ensure that the last object has a non-null
@@ -409,6 +438,10 @@ Structure Description:
 
     ModulePath - Stores the list of paths to search when loading a new module.
 
+    MethodEpoch - Stores the most recent method epoch handed out to a class.
+        A class takes a new epoch from this counter when it is created and
+        whenever its methods change.
+
     ForeignCalls - Stores the number of active foreign calls running
         in any fibers that are not the currently running one.
 
@@ -430,15 +463,25 @@ struct _CK_VM {
     PCK_DICT Modules;
     UINTN BytesAllocated;
     UINTN NextGarbageCollection;
+    UINTN NurseryBytes;
+    UINTN NurseryLimit;
     ULONG GarbageRuns;
     ULONG GarbageFreed;
     PCK_OBJECT FirstObject;
+    PCK_OBJECT FirstOldObject;
+    PCK_OBJECT *RememberedSet;
+    UINTN RememberedCount;
+    UINTN RememberedCapacity;
+    BOOL RememberedOverflow;
+    BOOL MinorCollection;
+    CK_GARBAGE_STATISTICS GarbageStatistics;
     PCK_OBJECT KissList;
     PCK_OBJECT WorkingObjects[CK_MAX_WORKING_OBJECTS];
     ULONG WorkingObjectCount;
     PCK_COMPILER Compiler;
     PCK_FIBER Fiber;
     PCK_LIST ModulePath;
+    UINTN MethodEpoch;
     LONG ForeignCalls;
     INT MemoryException;
     PCK_CLOSURE UnhandledException;
@@ -724,6 +767,46 @@ Return Value:
 
 --*/
 
+BOOL
+CkpCallCachedMethod (
+    PCK_VM Vm,
+    PCK_CLASS Class,
+    PCK_MODULE Module,
+    PCK_CALL_SITE Site,
+    CK_ARITY Arity
+    );
+
+/*++
+
+Routine Description:
+
+    This routine invokes a class instance method from a call site, using the
+    call site's cache to avoid looking the method up when possible.
+
+Arguments:
+
+    Vm - Supplies a pointer to the virtual machine.
+
+    Class - Supplies a pointer to the class that owns the method.
+
+    Module - Supplies a pointer to the module containing the call site, whose
+        string table holds the method signature.
+
+    Site - Supplies a pointer to the call site.
+
+    Arity - Supplies the number of arguments the method was called with in
+        code (plus one for the receiver).
+
+Return Value:
+
+    TRUE if a new frame was pushed onto the stack and needs to be run by the
+    interpreter.
+
+    FALSE if the call completed already (primitive and foreign functions fit
+    this category).
+
+--*/
+
 BOOL
 CkpCallFunction (
     PCK_VM Vm,
@@ -52,6 +52,7 @@ Module Name:
 #define CK_INITIAL_HEAP_DEFAULT (1024 * 1024 * 10)
 #define CK_MINIMUM_HEAP_DEFAULT (1024 * 1024)
 #define CK_HEAP_GROWTH_DEFAULT 512
+#define CK_NURSERY_SIZE_DEFAULT (1024 * 256)
 
 //
 // ------------------------------------------------------ Data Type Definitions
@@ -145,7 +146,8 @@ CK_CONFIGURATION CkDefaultConfiguration = {
     CkpDefaultUnhandledException,
     CK_INITIAL_HEAP_DEFAULT,
     CK_MINIMUM_HEAP_DEFAULT,
-    CK_HEAP_GROWTH_DEFAULT
+    CK_HEAP_GROWTH_DEFAULT,
+    CK_NURSERY_SIZE_DEFAULT
 };
 
 //
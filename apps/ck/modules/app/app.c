@@ -52,6 +52,18 @@ CkpAppModuleInit (
     PCK_VM Vm
     );
 
+VOID
+CkpAppGcStats (
+    PCK_VM Vm
+    );
+
+VOID
+CkpAppSetStatistic (
+    PCK_VM Vm,
+    PCSTR Name,
+    ULONGLONG Value
+    );
+
 //
 // -------------------------------------------------------------------- Globals
 //
@@ -70,6 +82,11 @@ PSTR *CkAppArgv;
 
 PCSTR CkAppExecName = "";
 
+CK_VARIABLE_DESCRIPTION CkAppModuleValues[] = {
+    {CkTypeFunction, "gcStats", CkpAppGcStats, 0},
+    {CkTypeInvalid, NULL, NULL, 0}
+};
+
 //
 // ------------------------------------------------------------------ Functions
 //
@@ -151,6 +168,7 @@ Return Value:
 
     CkPushString(Vm, CkAppExecName, strlen(CkAppExecName));
     CkSetVariable(Vm, 0, "execName");
+    CkDeclareVariables(Vm, 0, CkAppModuleValues);
     return;
 }
 
@@ -158,3 +176,88 @@ Return Value:
 // --------------------------------------------------------- Internal Functions
 //
 
+VOID
+CkpAppGcStats (
+    PCK_VM Vm
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns a dictionary describing the work done by the garbage
+    collector so far. Times are in microseconds of processor time.
+
+Arguments:
+
+    Vm - Supplies a pointer to the virtual machine.
+
+Return Value:
+
+    None. The dictionary is returned in the return slot.
+
+--*/
+
+{
+
+    CK_GARBAGE_STATISTICS Statistics;
+
+    if (!CkEnsureStack(Vm, 3)) {
+        return;
+    }
+
+    CkGetGarbageStatistics(Vm, &Statistics);
+    CkPushDict(Vm);
+    CkpAppSetStatistic(Vm, "minorCollections", Statistics.MinorCollections);
+    CkpAppSetStatistic(Vm, "fullCollections", Statistics.FullCollections);
+    CkpAppSetStatistic(Vm, "minorTime", Statistics.MinorTime);
+    CkpAppSetStatistic(Vm, "fullTime", Statistics.FullTime);
+    CkpAppSetStatistic(Vm, "lastPause", Statistics.LastPause);
+    CkpAppSetStatistic(Vm, "maxPause", Statistics.MaxPause);
+    CkpAppSetStatistic(Vm, "objectsFreed", Statistics.ObjectsFreed);
+    CkpAppSetStatistic(Vm, "objectsPromoted", Statistics.ObjectsPromoted);
+    CkpAppSetStatistic(Vm, "bytesAllocated", Statistics.BytesAllocated);
+    CkpAppSetStatistic(Vm,
+                       "nextFullCollection",
+                       Statistics.NextFullCollection);
+
+    CkStackReplace(Vm, 0);
+    return;
+}
+
+VOID
+CkpAppSetStatistic (
+    PCK_VM Vm,
+    PCSTR Name,
+    ULONGLONG Value
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sets an integer value in the dictionary on the top of the
+    stack.
+
+Arguments:
+
+    Vm - Supplies a pointer to the virtual machine.
+
+    Name - Supplies a pointer to the key name.
+
+    Value - Supplies the value to set.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    CkPushInteger(Vm, Value);
+    CkPushString(Vm, Name, strlen(Name));
+    CkDictSet(Vm, -3);
+    return;
+}
+
@@ -0,0 +1,186 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    gcupval.ck
+
+Abstract:
+
+    This module tests that a value stored through an open upvalue into the
+    stack of a suspended fiber survives minor garbage collections.
+
+Author:
+
+    agent 17-Oct-2026
+
+Environment:
+
+    Chalk
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+var setter;
+
+function
+fiberBody (
+    argument
+    )
+
+/*++
+
+Routine Description:
+
+    This routine runs in a fiber. It closes over one of its locals, hands the
+    setter out, and then suspends with the local still live on its stack.
+
+Arguments:
+
+    argument - Supplies an unused argument.
+
+Return Value:
+
+    Returns the value of the local when the fiber is resumed.
+
+--*/
+
+{
+
+    var local = "";
+
+    function
+    set (
+        value
+        )
+
+    /*++
+
+    Routine Description:
+
+        This routine stores into the enclosing fiber's local.
+
+    Arguments:
+
+        value - Supplies the value to store.
+
+    Return Value:
+
+        None.
+
+    --*/
+
+    {
+
+        local = value;
+        return;
+    }
+
+    setter = set;
+    Fiber.yield(null);
+    return local;
+}
+
+function
+churn (
+    )
+
+/*++
+
+Routine Description:
+
+    This routine allocates enough short lived objects to run several minor
+    collections.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    var index;
+    var junk;
+
+    for (index = 0; index < 200000; index += 1) {
+        junk = [index, "junk%d" % [index]];
+    }
+
+    return;
+}
+
+function
+testStoreIntoSuspendedFiber (
+    dropSetter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine ages a fiber into the old generation, stores a young value
+    into its stack through an open upvalue, and makes sure the value is still
+    intact after more collections.
+
+Arguments:
+
+    dropSetter - Supplies a boolean indicating whether to drop the only
+        reference to the closure after the store.
+
+Return Value:
+
+    None. An exception is raised on failure.
+
+--*/
+
+{
+
+    var expected = "abcdef" + "ghijkl";
+    var fiber = Fiber(fiberBody);
+    var result;
+
+    fiber.run(null);
+    churn();
+    setter("abc" + "defghijkl");
+    if (dropSetter) {
+        setter = null;
+    }
+
+    churn();
+    result = fiber.run(null);
+    if (result != expected) {
+        Core.raise(ValueError("Expected %s, got %s" % [expected, result]));
+    }
+
+    return;
+}
+
+//
+// Run the tests.
+//
+
+testStoreIntoSuspendedFiber(false);
+testStoreIntoSuspendedFiber(true);
+Core.print("gcupval: passed");
@@ -0,0 +1,41 @@
+#!/bin/sh
+## Copyright (c) 2026 Minoca Corp.
+##
+##    This file is licensed under the terms of the GNU General Public License
+##    version 3. Alternative licensing terms are available. Contact
+##    info@minocacorp.com for details. See the LICENSE file at the root of this
+##    project for complete licensing information.
+##
+## Script Name:
+##
+##     runtests.sh
+##
+## Abstract:
+##
+##     This script runs the Chalk interpreter regression tests. Each test
+##     raises an exception on failure, which makes the interpreter exit with
+##     a non-zero status. Pass the absolute path to the chalk binary to test,
+##     which defaults to the one in the path.
+##
+## Author:
+##
+##     agent 17-Oct-2026
+##
+## Environment:
+##
+##     Build
+##
+
+set -e
+
+CHALK=${1:-chalk}
+cd `dirname $0`
+FAILED=0
+for test in *.ck; do
+    if ! $CHALK $test; then
+        echo "${test%.ck}: FAILED"
+        FAILED=1
+    fi
+done
+
+exit $FAILED
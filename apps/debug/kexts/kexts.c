@@ -37,6 +37,7 @@ Module Name:
 #include "objects.h"
 #include "threads.h"
 #include "acpiext.h"
+#include "locks.h"
 #include "reslist.h"
 
 #include <assert.h>
@@ -172,6 +173,19 @@ Return Value:
         TotalStatus = Status;
     }
 
+    Extension = "spinlocks";
+    OneLineDescription = "Prints the spin lock contention profile.";
+    Status = DbgRegisterExtension(Context,
+                                  Token,
+                                  Extension,
+                                  OneLineDescription,
+                                  ExtSpinLocks);
+
+    if (Status != 0) {
+        DbgOut("Error: Unable to register %s.\n", Extension);
+        TotalStatus = Status;
+    }
+
     return TotalStatus;
 }
 
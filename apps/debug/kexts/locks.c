@@ -0,0 +1,341 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    locks.c
+
+Abstract:
+
+    This module implements lock related debugger extensions.
+
+Author:
+
+    agent 16-Oct-2026
+
+Environment:
+
+    Debug Client
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <minoca/lib/types.h>
+#include <minoca/lib/status.h>
+#include <minoca/debug/dbgext.h>
+#include "locks.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+#define FREE(_x) free(_x)
+
+#define SPIN_LOCK_PROFILE_NAME "kernel!KeSpinLockProfile"
+#define SPIN_LOCK_PROFILE_COUNT_NAME "kernel!KeSpinLockProfileEntryCount"
+#define SPIN_LOCK_PROFILE_ENABLED_NAME "kernel!KeSpinLockProfilingEnabled"
+#define SPIN_LOCK_PROFILE_DROPPED_NAME "kernel!KeSpinLockProfileDroppedCount"
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+INT
+ExtpReadKernelInteger (
+    PDEBUGGER_CONTEXT Context,
+    PSTR Name,
+    ULONG Size,
+    PULONGLONG Value
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+INT
+ExtSpinLocks (
+    PDEBUGGER_CONTEXT Context,
+    PSTR Command,
+    ULONG ArgumentCount,
+    PSTR *ArgumentValues
+    )
+
+/*++
+
+Routine Description:
+
+    This routine prints the kernel's spin lock contention profile. Only locks
+    that were contended while profiling was on show up.
+
+Arguments:
+
+    Context - Supplies a pointer to the debugger applicaton context, which is
+        an argument to most of the API functions.
+
+    Command - Supplies a pointer to the subcommand string.
+
+    ArgumentCount - Supplies the number of arguments in the ArgumentValues
+        array.
+
+    ArgumentValues - Supplies the values of each argument. This memory will be
+        reused when the function returns, so extensions must not touch this
+        memory after returning from this call.
+
+Return Value:
+
+    0 if the debugger extension command was successful.
+
+    Returns an error code if a failure occurred along the way.
+
+--*/
+
+{
+
+    ULONGLONG ContendedCount;
+    PVOID Data;
+    ULONG DataSize;
+    ULONGLONG DroppedCount;
+    ULONGLONG Enabled;
+    ULONGLONG EntryAddress;
+    PTYPE_SYMBOL EntryType;
+    ULONG Index;
+    ULONGLONG Lock;
+    ULONGLONG MaximumWaiters;
+    ULONGLONG ProfileAddress;
+    ULONGLONG ProfileCount;
+    ULONG Printed;
+    ULONGLONG SpinCount;
+    INT Status;
+
+    Data = NULL;
+    if ((Command != NULL) || (ArgumentCount != 1)) {
+        DbgOut("Usage: !spinlocks\n"
+               "       Prints the spin lock contention profile. Profiling is "
+               "enabled by\n       setting KeSpinLockProfilingEnabled or "
+               "with vmstat --locks.\n");
+
+        return EINVAL;
+    }
+
+    Status = ExtpReadKernelInteger(Context,
+                                   SPIN_LOCK_PROFILE_ENABLED_NAME,
+                                   sizeof(BOOL),
+                                   &Enabled);
+
+    if (Status != 0) {
+        goto ExtSpinLocksEnd;
+    }
+
+    Status = ExtpReadKernelInteger(Context,
+                                   SPIN_LOCK_PROFILE_COUNT_NAME,
+                                   sizeof(ULONG),
+                                   &ProfileCount);
+
+    if (Status != 0) {
+        goto ExtSpinLocksEnd;
+    }
+
+    Status = ExtpReadKernelInteger(Context,
+                                   SPIN_LOCK_PROFILE_DROPPED_NAME,
+                                   sizeof(ULONGLONG),
+                                   &DroppedCount);
+
+    if (Status != 0) {
+        goto ExtSpinLocksEnd;
+    }
+
+    Status = DbgEvaluate(Context, SPIN_LOCK_PROFILE_NAME, &ProfileAddress);
+    if (Status != 0) {
+        DbgOut("Error: Unable to evaluate %s.\n", SPIN_LOCK_PROFILE_NAME);
+        goto ExtSpinLocksEnd;
+    }
+
+    DbgOut("Spin lock profiling is %s, %I64d contentions dropped.\n",
+           (Enabled != FALSE) ? "on" : "off",
+           DroppedCount);
+
+    DbgOut("%-18s %12s %14s %8s\n",
+           "Lock",
+           "Contended",
+           "Spins",
+           "Waiters");
+
+    Printed = 0;
+    EntryAddress = ProfileAddress;
+    for (Index = 0; Index < ProfileCount; Index += 1) {
+        Status = DbgReadTypeByName(Context,
+                                   EntryAddress,
+                                   "SPIN_LOCK_STATISTICS_ENTRY",
+                                   &EntryType,
+                                   &Data,
+                                   &DataSize);
+
+        if (Status != 0) {
+            DbgOut("Error: Could not read profile entry at 0x%I64x.\n",
+                   EntryAddress);
+
+            goto ExtSpinLocksEnd;
+        }
+
+        Status = DbgReadIntegerMember(Context,
+                                      EntryType,
+                                      "Lock",
+                                      EntryAddress,
+                                      Data,
+                                      DataSize,
+                                      &Lock);
+
+        if (Status != 0) {
+            goto ExtSpinLocksEnd;
+        }
+
+        if (Lock != 0) {
+            Status = DbgReadIntegerMember(Context,
+                                          EntryType,
+                                          "ContendedCount",
+                                          EntryAddress,
+                                          Data,
+                                          DataSize,
+                                          &ContendedCount);
+
+            if (Status != 0) {
+                goto ExtSpinLocksEnd;
+            }
+
+            Status = DbgReadIntegerMember(Context,
+                                          EntryType,
+                                          "SpinCount",
+                                          EntryAddress,
+                                          Data,
+                                          DataSize,
+                                          &SpinCount);
+
+            if (Status != 0) {
+                goto ExtSpinLocksEnd;
+            }
+
+            Status = DbgReadIntegerMember(Context,
+                                          EntryType,
+                                          "MaximumWaiters",
+                                          EntryAddress,
+                                          Data,
+                                          DataSize,
+                                          &MaximumWaiters);
+
+            if (Status != 0) {
+                goto ExtSpinLocksEnd;
+            }
+
+            DbgOut("0x%016I64x %12I64d %14I64d %8I64d  ",
+                   Lock,
+                   ContendedCount,
+                   SpinCount,
+                   MaximumWaiters);
+
+            DbgPrintAddressSymbol(Context, Lock);
+            DbgOut("\n");
+            Printed += 1;
+        }
+
+        FREE(Data);
+        Data = NULL;
+        EntryAddress += DataSize;
+    }
+
+    if (Printed == 0) {
+        DbgOut("No contended spin locks recorded.\n");
+    }
+
+    Status = 0;
+
+ExtSpinLocksEnd:
+    if (Data != NULL) {
+        FREE(Data);
+    }
+
+    return Status;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+INT
+ExtpReadKernelInteger (
+    PDEBUGGER_CONTEXT Context,
+    PSTR Name,
+    ULONG Size,
+    PULONGLONG Value
+    )
+
+/*++
+
+Routine Description:
+
+    This routine reads an integer global out of the target.
+
+Arguments:
+
+    Context - Supplies a pointer to the debugger applicaton context.
+
+    Name - Supplies the symbol name of the global to read.
+
+    Size - Supplies the size of the global in bytes.
+
+    Value - Supplies a pointer where the value will be returned on success.
+
+Return Value:
+
+    0 on success.
+
+    Returns an error code on failure.
+
+--*/
+
+{
+
+    ULONGLONG Address;
+    ULONG BytesRead;
+    INT Status;
+
+    *Value = 0;
+    Status = DbgEvaluate(Context, Name, &Address);
+    if (Status != 0) {
+        DbgOut("Error: Unable to evaluate %s.\n", Name);
+        return Status;
+    }
+
+    Status = DbgReadMemory(Context, TRUE, Address, Size, Value, &BytesRead);
+    if ((Status != 0) || (BytesRead != Size)) {
+        DbgOut("Error: Unable to read %s.\n", Name);
+        if (Status == 0) {
+            Status = EINVAL;
+        }
+
+        return Status;
+    }
+
+    return 0;
+}
+
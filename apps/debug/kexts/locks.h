@@ -0,0 +1,80 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    locks.h
+
+Abstract:
+
+    This header contains definitions for lock related debugger extensions.
+
+Author:
+
+    agent 16-Oct-2026
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// -------------------------------------------------------- Function Prototypes
+//
+
+INT
+ExtSpinLocks (
+    PDEBUGGER_CONTEXT Context,
+    PSTR Command,
+    ULONG ArgumentCount,
+    PSTR *ArgumentValues
+    );
+
+/*++
+
+Routine Description:
+
+    This routine prints the kernel's spin lock contention profile. Only locks
+    that were contended while profiling was on show up.
+
+Arguments:
+
+    Context - Supplies a pointer to the debugger applicaton context, which is
+        an argument to most of the API functions.
+
+    Command - Supplies a pointer to the subcommand string.
+
+    ArgumentCount - Supplies the number of arguments in the ArgumentValues
+        array.
+
+    ArgumentValues - Supplies the values of each argument. This memory will be
+        reused when the function returns, so extensions must not touch this
+        memory after returning from this call.
+
+Return Value:
+
+    0 if the debugger extension command was successful.
+
+    Returns an error code if a failure occurred along the way.
+
+--*/
+
@@ -63,6 +63,7 @@ function build() {
         "dirio.c",
         "dynlib.c",
         "env.c",
+        "epoll.c",
         "err.c",
         "errno.c",
         "exec.c",
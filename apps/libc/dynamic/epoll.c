@@ -0,0 +1,377 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    epoll.c
+
+Abstract:
+
+    This module implements the epoll interface, which is built on top of
+    kernel poll sets.
+
+Author:
+
+    agent 16-Oct-2026
+
+Environment:
+
+    User Mode C Library
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include "libcp.h"
+#include <errno.h>
+#include <poll.h>
+#include <sys/epoll.h>
+
+//
+// --------------------------------------------------------------------- Macros
+//
+
+#define ASSERT_EPOLL_FLAGS_EQUIVALENT()                        \
+    ASSERT((EPOLLIN == POLL_EVENT_IN) &&                       \
+           (EPOLLPRI == POLL_EVENT_IN_HIGH_PRIORITY) &&        \
+           (EPOLLOUT == POLL_EVENT_OUT) &&                     \
+           (EPOLLWRBAND == POLL_EVENT_OUT_HIGH_PRIORITY) &&    \
+           (EPOLLERR == POLL_EVENT_ERROR) &&                   \
+           (EPOLLHUP == POLL_EVENT_DISCONNECTED) &&            \
+           (EPOLLET == POLL_SET_EVENT_EDGE_TRIGGERED) &&       \
+           (EPOLLONESHOT == POLL_SET_EVENT_ONE_SHOT))
+
+#define ASSERT_EPOLL_STRUCTURE_EQUIVALENT()                         \
+    ASSERT((sizeof(struct epoll_event) == sizeof(POLL_SET_EVENT)) && \
+           (FIELD_OFFSET(struct epoll_event, data) ==                \
+            FIELD_OFFSET(POLL_SET_EVENT, Data)))
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+LIBC_API
+int
+epoll_create (
+    int Size
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates an epoll instance.
+
+Arguments:
+
+    Size - Supplies a hint of the number of descriptors that will be added.
+        This is ignored, but must be greater than zero.
+
+Return Value:
+
+    Returns a file descriptor for the new epoll instance on success.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
+{
+
+    if (Size <= 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return epoll_create1(0);
+}
+
+LIBC_API
+int
+epoll_create1 (
+    int Flags
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates an epoll instance.
+
+Arguments:
+
+    Flags - Supplies a bitfield of flags. The only valid flag is
+        EPOLL_CLOEXEC.
+
+Return Value:
+
+    Returns a file descriptor for the new epoll instance on success.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
+{
+
+    HANDLE Handle;
+    ULONG OpenFlags;
+    KSTATUS Status;
+
+    if ((Flags & ~EPOLL_CLOEXEC) != 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    OpenFlags = 0;
+    if ((Flags & EPOLL_CLOEXEC) != 0) {
+        OpenFlags |= SYS_OPEN_FLAG_CLOSE_ON_EXECUTE;
+    }
+
+    Status = OsCreatePollSet(OpenFlags, &Handle);
+    if (!KSUCCESS(Status)) {
+        errno = ClConvertKstatusToErrorNumber(Status);
+        return -1;
+    }
+
+    return (int)(UINTN)Handle;
+}
+
+LIBC_API
+int
+epoll_ctl (
+    int EpollDescriptor,
+    int Operation,
+    int Descriptor,
+    struct epoll_event *Event
+    )
+
+/*++
+
+Routine Description:
+
+    This routine adds, modifies, or removes a descriptor in an epoll instance.
+
+Arguments:
+
+    EpollDescriptor - Supplies the epoll instance file descriptor.
+
+    Operation - Supplies the operation to perform. See EPOLL_CTL_*
+        definitions.
+
+    Descriptor - Supplies the file descriptor to operate on.
+
+    Event - Supplies a pointer to the events to watch for and the data to
+        return. This is ignored for EPOLL_CTL_DEL.
+
+Return Value:
+
+    0 on success.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
+{
+
+    POLL_SET_OPERATION PollOperation;
+    KSTATUS Status;
+
+    ASSERT_EPOLL_FLAGS_EQUIVALENT();
+    ASSERT_EPOLL_STRUCTURE_EQUIVALENT();
+
+    switch (Operation) {
+    case EPOLL_CTL_ADD:
+        PollOperation = PollSetOperationAdd;
+        break;
+
+    case EPOLL_CTL_MOD:
+        PollOperation = PollSetOperationModify;
+        break;
+
+    case EPOLL_CTL_DEL:
+        PollOperation = PollSetOperationDelete;
+        Event = NULL;
+        break;
+
+    default:
+        errno = EINVAL;
+        return -1;
+    }
+
+    if ((PollOperation != PollSetOperationDelete) && (Event == NULL)) {
+        errno = EFAULT;
+        return -1;
+    }
+
+    if (EpollDescriptor == Descriptor) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    Status = OsControlPollSet((HANDLE)(UINTN)EpollDescriptor,
+                              PollOperation,
+                              (HANDLE)(UINTN)Descriptor,
+                              (PPOLL_SET_EVENT)Event);
+
+    if (!KSUCCESS(Status)) {
+        if (Status == STATUS_NOT_SUPPORTED) {
+            errno = EPERM;
+
+        } else {
+            errno = ClConvertKstatusToErrorNumber(Status);
+        }
+
+        return -1;
+    }
+
+    return 0;
+}
+
+LIBC_API
+int
+epoll_wait (
+    int EpollDescriptor,
+    struct epoll_event *Events,
+    int EventCount,
+    int Timeout
+    )
+
+/*++
+
+Routine Description:
+
+    This routine waits for descriptors in an epoll instance to become ready.
+
+Arguments:
+
+    EpollDescriptor - Supplies the epoll instance file descriptor.
+
+    Events - Supplies a pointer to an array where the ready events will be
+        returned.
+
+    EventCount - Supplies the number of elements in the events array.
+
+    Timeout - Supplies the amount of time in milliseconds to block before
+        giving up. Supply 0 to not block at all, and supply -1 to wait for an
+        indefinite amount of time.
+
+Return Value:
+
+    Returns the number of events returned, which is 0 on timeout.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
+{
+
+    return epoll_pwait(EpollDescriptor, Events, EventCount, Timeout, NULL);
+}
+
+LIBC_API
+int
+epoll_pwait (
+    int EpollDescriptor,
+    struct epoll_event *Events,
+    int EventCount,
+    int Timeout,
+    const sigset_t *SignalMask
+    )
+
+/*++
+
+Routine Description:
+
+    This routine waits for descriptors in an epoll instance to become ready,
+    atomically setting the signal mask for the duration of the wait.
+
+Arguments:
+
+    EpollDescriptor - Supplies the epoll instance file descriptor.
+
+    Events - Supplies a pointer to an array where the ready events will be
+        returned.
+
+    EventCount - Supplies the number of elements in the events array.
+
+    Timeout - Supplies the amount of time in milliseconds to block before
+        giving up. Supply 0 to not block at all, and supply -1 to wait for an
+        indefinite amount of time.
+
+    SignalMask - Supplies an optional pointer to a signal mask to set for the
+        duration of the wait.
+
+Return Value:
+
+    Returns the number of events returned, which is 0 on timeout.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
+{
+
+    ULONG EventsReturned;
+    KSTATUS Status;
+    ULONG TimeoutInMilliseconds;
+
+    ASSERT_EPOLL_STRUCTURE_EQUIVALENT();
+
+    if (EventCount <= 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (Timeout < 0) {
+        TimeoutInMilliseconds = SYS_WAIT_TIME_INDEFINITE;
+
+    } else {
+        TimeoutInMilliseconds = Timeout;
+    }
+
+    Status = OsWaitForPollSet((HANDLE)(UINTN)EpollDescriptor,
+                              (PSIGNAL_SET)SignalMask,
+                              (PPOLL_SET_EVENT)Events,
+                              EventCount,
+                              TimeoutInMilliseconds,
+                              &EventsReturned);
+
+    if (!KSUCCESS(Status)) {
+        if (Status == STATUS_TIMEOUT) {
+            return 0;
+        }
+
+        errno = ClConvertKstatusToErrorNumber(Status);
+        return -1;
+    }
+
+    return (int)EventsReturned;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
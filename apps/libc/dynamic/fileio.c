@@ -39,6 +39,7 @@ Module Name:
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/sendfile.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <unistd.h>
@@ -635,6 +636,257 @@ Return Value:
     return ReturnValue;
 }
 
+LIBC_API
+int
+posix_fadvise (
+    int FileDescriptor,
+    off_t Offset,
+    off_t Length,
+    int Advice
+    )
+
+/*++
+
+Routine Description:
+
+    This routine advises the system about how the application expects to
+    access a region of an open file, which may be used to improve
+    performance.
+
+Arguments:
+
+    FileDescriptor - Supplies the file descriptor the advice applies to.
+
+    Offset - Supplies the offset of the start of the region.
+
+    Length - Supplies the length of the region in bytes. Zero means the region
+        extends to the end of the file.
+
+    Advice - Supplies the advice. See POSIX_FADV_* definitions.
+
+Return Value:
+
+    0 on success.
+
+    Returns an error number on failure. The errno variable is not set.
+
+--*/
+
+{
+
+    FILE_CONTROL_PARAMETERS_UNION Parameters;
+    KSTATUS Status;
+
+    if ((Offset < 0) || (Length < 0)) {
+        return EINVAL;
+    }
+
+    switch (Advice) {
+    case POSIX_FADV_NORMAL:
+        Parameters.Advice.Advice = IoAdviceNormal;
+        break;
+
+    case POSIX_FADV_SEQUENTIAL:
+        Parameters.Advice.Advice = IoAdviceSequential;
+        break;
+
+    case POSIX_FADV_RANDOM:
+        Parameters.Advice.Advice = IoAdviceRandom;
+        break;
+
+    case POSIX_FADV_WILLNEED:
+        Parameters.Advice.Advice = IoAdviceWillNeed;
+        break;
+
+    case POSIX_FADV_DONTNEED:
+        Parameters.Advice.Advice = IoAdviceDontNeed;
+        break;
+
+    case POSIX_FADV_NOREUSE:
+        Parameters.Advice.Advice = IoAdviceNoReuse;
+        break;
+
+    default:
+        return EINVAL;
+    }
+
+    Parameters.Advice.Offset = Offset;
+    Parameters.Advice.Size = Length;
+    Status = OsFileControl((HANDLE)(UINTN)FileDescriptor,
+                           FileControlCommandSetAdvice,
+                           &Parameters);
+
+    if (!KSUCCESS(Status)) {
+        return ClConvertKstatusToErrorNumber(Status);
+    }
+
+    return 0;
+}
+
+LIBC_API
+ssize_t
+sendfile (
+    int OutputDescriptor,
+    int InputDescriptor,
+    off_t *Offset,
+    size_t Count
+    )
+
+/*++
+
+Routine Description:
+
+    This routine copies data from one file descriptor to another within the
+    kernel. When the input is a regular file and the output is a socket, the
+    file's cached pages are handed to the network stack without being copied.
+
+Arguments:
+
+    OutputDescriptor - Supplies the file descriptor to write to.
+
+    InputDescriptor - Supplies the file descriptor to read from.
+
+    Offset - Supplies an optional pointer to the offset in the input file to
+        start reading from. If supplied, this is advanced by the number of
+        bytes transferred and the file position of the input descriptor is
+        unchanged. If NULL, the data is read from the current file position,
+        which is advanced.
+
+    Count - Supplies the number of bytes to transfer.
+
+Return Value:
+
+    Returns the number of bytes written to the output descriptor, which may be
+    less than the requested count.
+
+    0 if the input is at the end of the file.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
+{
+
+    return splice(InputDescriptor, Offset, OutputDescriptor, NULL, Count, 0);
+}
+
+LIBC_API
+ssize_t
+splice (
+    int InputDescriptor,
+    off_t *InputOffset,
+    int OutputDescriptor,
+    off_t *OutputOffset,
+    size_t Length,
+    unsigned int Flags
+    )
+
+/*++
+
+Routine Description:
+
+    This routine moves data between two file descriptors without copying it
+    through user mode. Unlike some other systems, neither descriptor is
+    required to be a pipe.
+
+Arguments:
+
+    InputDescriptor - Supplies the file descriptor to read from.
+
+    InputOffset - Supplies an optional pointer to the offset to read from. If
+        supplied, this is advanced by the number of bytes moved and the file
+        position of the input descriptor is unchanged. If NULL, the data is
+        read from the current file position, which is advanced.
+
+    OutputDescriptor - Supplies the file descriptor to write to.
+
+    OutputOffset - Supplies an optional pointer to the offset to write to. If
+        supplied, this is advanced by the number of bytes moved. This must be
+        NULL if the output is a socket or pipe.
+
+    Length - Supplies the number of bytes to move.
+
+    Flags - Supplies a bitfield of flags. See SPLICE_F_* definitions.
+
+Return Value:
+
+    Returns the number of bytes moved on success, which may be less than the
+    requested length.
+
+    0 if the input is at the end of the file.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
+{
+
+    UINTN BytesCompleted;
+    IO_OFFSET DestinationOffset;
+    IO_OFFSET SourceOffset;
+    KSTATUS Status;
+
+    if ((Flags & ~SPLICE_F_ALL) != 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    SourceOffset = IO_OFFSET_NONE;
+    if (InputOffset != NULL) {
+        if (*InputOffset < 0) {
+            errno = EINVAL;
+            return -1;
+        }
+
+        SourceOffset = *InputOffset;
+    }
+
+    DestinationOffset = IO_OFFSET_NONE;
+    if (OutputOffset != NULL) {
+        if (*OutputOffset < 0) {
+            errno = EINVAL;
+            return -1;
+        }
+
+        DestinationOffset = *OutputOffset;
+    }
+
+    //
+    // Truncate the length, so that it does not exceed the maximum number of
+    // bytes that can be returned.
+    //
+
+    if (Length > (size_t)SSIZE_MAX) {
+        Length = (size_t)SSIZE_MAX;
+    }
+
+    Status = OsSendFile((HANDLE)(UINTN)OutputDescriptor,
+                        (HANDLE)(UINTN)InputDescriptor,
+                        SourceOffset,
+                        DestinationOffset,
+                        Length,
+                        &BytesCompleted);
+
+    if (Status == STATUS_TIMEOUT) {
+        errno = EAGAIN;
+        return -1;
+
+    } else if (!KSUCCESS(Status)) {
+        errno = ClConvertKstatusToErrorNumber(Status);
+        return -1;
+    }
+
+    if (InputOffset != NULL) {
+        *InputOffset += BytesCompleted;
+    }
+
+    if (OutputOffset != NULL) {
+        *OutputOffset += BytesCompleted;
+    }
+
+    return (ssize_t)BytesCompleted;
+}
+
 LIBC_API
 int
 close (
@@ -3332,71 +3584,33 @@ Return Value:
     return 0;
 }
 
-//
-// --------------------------------------------------------- Internal Functions
-//
-
-int
-ClpOpen (
-    int Directory,
-    const char *Path,
-    int OpenFlags,
-    va_list ArgumentList
+ULONG
+ClpConvertOpenFlags (
+    INT OpenFlags
     )
 
 /*++
 
 Routine Description:
 
-    This routine opens a file and connects it to a file descriptor.
+    This routine converts a set of C library open flags into their system
+    call equivalents.
 
 Arguments:
 
-    Directory - Supplies an optional file descriptor. If the given path
-        is a relative path, the directory referenced by this descriptor will
-        be used as a starting point for path resolution. Supply AT_FDCWD to
-        use the working directory for relative paths. This is normally the
-        expected behavior.
-
-    Path - Supplies a pointer to a null terminated string containing the path
-        of the file to open.
-
     OpenFlags - Supplies a set of flags ORed together. See O_* definitions.
 
-    ArgumentList - Supplies the variadic arguments to the open call.
-
 Return Value:
 
-    Returns a file descriptor on success.
-
-    -1 on failure. The errno variable will be set to indicate the error.
+    Returns the equivalent set of SYS_OPEN_FLAG_* flags.
 
 --*/
 
 {
 
-    mode_t CreateMode;
-    FILE_PERMISSIONS CreatePermissions;
-    HANDLE FileHandle;
     ULONG OsOpenFlags;
-    ULONG PathLength;
-    KSTATUS Status;
-
-    if (Path == NULL) {
-        errno = EINVAL;
-        return -1;
-    }
 
-    PathLength = RtlStringLength((PSTR)Path) + 1;
     OsOpenFlags = 0;
-    CreatePermissions = 0;
-
-    //
-    // This assert stands for not just the openat call, but for all the *at
-    // calls out there that rely on this assumption.
-    //
-
-    assert(INVALID_HANDLE == (HANDLE)AT_FDCWD);
 
     //
     // Set the access mask.
@@ -3485,7 +3699,78 @@ Return Value:
         if ((OpenFlags & O_EXCL) != 0) {
             OsOpenFlags |= SYS_OPEN_FLAG_FAIL_IF_EXISTS;
         }
+    }
+
+    return OsOpenFlags;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+int
+ClpOpen (
+    int Directory,
+    const char *Path,
+    int OpenFlags,
+    va_list ArgumentList
+    )
+
+/*++
+
+Routine Description:
+
+    This routine opens a file and connects it to a file descriptor.
 
+Arguments:
+
+    Directory - Supplies an optional file descriptor. If the given path
+        is a relative path, the directory referenced by this descriptor will
+        be used as a starting point for path resolution. Supply AT_FDCWD to
+        use the working directory for relative paths. This is normally the
+        expected behavior.
+
+    Path - Supplies a pointer to a null terminated string containing the path
+        of the file to open.
+
+    OpenFlags - Supplies a set of flags ORed together. See O_* definitions.
+
+    ArgumentList - Supplies the variadic arguments to the open call.
+
+Return Value:
+
+    Returns a file descriptor on success.
+
+    -1 on failure. The errno variable will be set to indicate the error.
+
+--*/
+
+{
+
+    mode_t CreateMode;
+    FILE_PERMISSIONS CreatePermissions;
+    HANDLE FileHandle;
+    ULONG OsOpenFlags;
+    ULONG PathLength;
+    KSTATUS Status;
+
+    if (Path == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    PathLength = RtlStringLength((PSTR)Path) + 1;
+    CreatePermissions = 0;
+
+    //
+    // This assert stands for not just the openat call, but for all the *at
+    // calls out there that rely on this assumption.
+    //
+
+    assert(INVALID_HANDLE == (HANDLE)AT_FDCWD);
+
+    OsOpenFlags = ClpConvertOpenFlags(OpenFlags);
+    if ((OpenFlags & O_CREAT) != 0) {
         CreateMode = va_arg(ArgumentList, mode_t);
 
         ASSERT_FILE_PERMISSIONS_EQUIVALENT();
@@ -267,6 +267,28 @@ Return Value:
 
 --*/
 
+ULONG
+ClpConvertOpenFlags (
+    INT OpenFlags
+    );
+
+/*++
+
+Routine Description:
+
+    This routine converts a set of C library open flags into their system
+    call equivalents.
+
+Arguments:
+
+    OpenFlags - Supplies a set of flags ORed together. See O_* definitions.
+
+Return Value:
+
+    Returns the equivalent set of SYS_OPEN_FLAG_* flags.
+
+--*/
+
 BOOL
 ClpInitializeTypeConversions (
     VOID
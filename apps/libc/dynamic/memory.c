@@ -341,6 +341,154 @@ Return Value:
     return 0;
 }
 
+LIBC_API
+int
+madvise (
+    void *Address,
+    size_t Length,
+    int Advice
+    )
+
+/*++
+
+Routine Description:
+
+    This routine advises the system about how the application expects to
+    access a region of its address space. For regions mapped from a file,
+    this steers how far ahead of page faults the file is read. For anonymous
+    regions, fault around advice controls whether a fault populates the whole
+    aligned block around it at once.
+
+Arguments:
+
+    Address - Supplies the start of the region. This must be aligned to a page
+        boundary.
+
+    Length - Supplies the size of the region in bytes.
+
+    Advice - Supplies the advice. See MADV_* definitions.
+
+Return Value:
+
+    0 on success.
+
+    -1 on failure. The errno variable will be set to indicate the error.
+
+--*/
+
+{
+
+    IO_ADVICE OsAdvice;
+    int Result;
+    KSTATUS Status;
+
+    //
+    // Dropping pages changes what later reads of anonymous memory return, so
+    // it can't be quietly ignored here the way posix_madvise may.
+    //
+
+    if (Advice == POSIX_MADV_DONTNEED) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    //
+    // Fault around advice is not part of posix_madvise, so handle it here.
+    //
+
+    if ((Advice == MADV_FAULTAROUND) || (Advice == MADV_NOFAULTAROUND)) {
+        OsAdvice = IoAdviceFaultAround;
+        if (Advice == MADV_NOFAULTAROUND) {
+            OsAdvice = IoAdviceNoFaultAround;
+        }
+
+        Status = OsSetMemoryAdvice(Address, Length, OsAdvice);
+        if (!KSUCCESS(Status)) {
+            errno = ClConvertKstatusToErrorNumber(Status);
+            return -1;
+        }
+
+        return 0;
+    }
+
+    Result = posix_madvise(Address, Length, Advice);
+    if (Result != 0) {
+        errno = Result;
+        return -1;
+    }
+
+    return 0;
+}
+
+LIBC_API
+int
+posix_madvise (
+    void *Address,
+    size_t Length,
+    int Advice
+    )
+
+/*++
+
+Routine Description:
+
+    This routine advises the system about how the application expects to
+    access a region of its address space.
+
+Arguments:
+
+    Address - Supplies the start of the region. This must be aligned to a page
+        boundary.
+
+    Length - Supplies the size of the region in bytes.
+
+    Advice - Supplies the advice. See POSIX_MADV_* definitions.
+
+Return Value:
+
+    0 on success.
+
+    Returns an error number on failure. The errno variable is not set.
+
+--*/
+
+{
+
+    IO_ADVICE OsAdvice;
+    KSTATUS Status;
+
+    switch (Advice) {
+    case MADV_NORMAL:
+        OsAdvice = IoAdviceNormal;
+        break;
+
+    case MADV_SEQUENTIAL:
+        OsAdvice = IoAdviceSequential;
+        break;
+
+    case MADV_RANDOM:
+        OsAdvice = IoAdviceRandom;
+        break;
+
+    case MADV_WILLNEED:
+        OsAdvice = IoAdviceWillNeed;
+        break;
+
+    case POSIX_MADV_DONTNEED:
+        return 0;
+
+    default:
+        return EINVAL;
+    }
+
+    Status = OsSetMemoryAdvice(Address, Length, OsAdvice);
+    if (!KSUCCESS(Status)) {
+        return ClConvertKstatusToErrorNumber(Status);
+    }
+
+    return 0;
+}
+
 LIBC_API
 int
 shm_open (
@@ -34,6 +34,7 @@ Module Name:
 #include <stdio.h>
 #include <unistd.h>
 #include <errno.h>
+#include <limits.h>
 
 //
 // ---------------------------------------------------------------- Definitions
@@ -1226,11 +1227,30 @@ Return Value:
 
 {
 
-    //
-    // TODO: Implement nice.
-    //
+    LONG NiceValue;
+    KSTATUS Status;
 
-    return 0;
+    Status = OsSetPriority(PriorityTargetProcess, -1, NULL, &NiceValue);
+    if (!KSUCCESS(Status)) {
+        errno = ClConvertKstatusToErrorNumber(Status);
+        return -1;
+    }
+
+    NiceValue += Increment;
+    if (NiceValue < -NZERO) {
+        NiceValue = -NZERO;
+
+    } else if (NiceValue > NZERO - 1) {
+        NiceValue = NZERO - 1;
+    }
+
+    Status = OsSetPriority(PriorityTargetProcess, -1, &NiceValue, NULL);
+    if (!KSUCCESS(Status)) {
+        errno = ClConvertKstatusToErrorNumber(Status);
+        return -1;
+    }
+
+    return NiceValue;
 }
 
 //
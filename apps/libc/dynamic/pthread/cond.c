@@ -55,6 +55,12 @@ ClpPulseCondition (
     UINTN Count
     );
 
+BOOL
+ClpRequeueConditionWaiters (
+    PPTHREAD_CONDITION Condition,
+    ULONG State
+    );
+
 int
 ClpWaitOnCondition (
     PPTHREAD_CONDITION Condition,
@@ -104,6 +110,11 @@ Return Value:
     PPTHREAD_CONDITION ConditionInternal;
 
     ConditionInternal = (PPTHREAD_CONDITION)Condition;
+
+    ASSERT(sizeof(pthread_cond_t) >= sizeof(PTHREAD_CONDITION));
+
+    ConditionInternal->Waiters = 0;
+    ConditionInternal->Mutex = NULL;
     if (Attribute == NULL) {
         ConditionInternal->State = 0;
         return 0;
@@ -149,6 +160,7 @@ Return Value:
 
     ConditionInternal = (PPTHREAD_CONDITION)Condition;
     ConditionInternal->State = MAX_ULONG;
+    ConditionInternal->Mutex = NULL;
     return 0;
 }
 
@@ -579,6 +591,7 @@ Return Value:
 {
 
     ULONG Operation;
+    ULONG State;
     ULONG ThreadCount;
 
     //
@@ -586,7 +599,23 @@ Return Value:
     // get into the kernel.
     //
 
-    RtlAtomicAdd32(&(Condition->State), 1 << PTHREAD_CONDITION_COUNTER_SHIFT);
+    State = RtlAtomicAdd32(&(Condition->State),
+                           1 << PTHREAD_CONDITION_COUNTER_SHIFT);
+
+    State += 1 << PTHREAD_CONDITION_COUNTER_SHIFT;
+
+    //
+    // For a broadcast, wake only one waiter and move the rest over to the
+    // mutex, so they are released one at a time as the mutex is handed off
+    // instead of all fighting over it at once.
+    //
+
+    if ((Count == MAX_ULONG) &&
+        (ClpRequeueConditionWaiters(Condition, State) != FALSE)) {
+
+        return 0;
+    }
+
     ThreadCount = Count;
     Operation = UserLockWake;
     if ((Condition->State & PTHREAD_CONDITION_SHARED) == 0) {
@@ -597,6 +626,82 @@ Return Value:
     return 0;
 }
 
+BOOL
+ClpRequeueConditionWaiters (
+    PPTHREAD_CONDITION Condition,
+    ULONG State
+    )
+
+/*++
+
+Routine Description:
+
+    This routine wakes one thread blocked on the condition variable and moves
+    the rest over to wait on the mutex they will need to reacquire.
+
+Arguments:
+
+    Condition - Supplies a pointer to the condition variable to wake threads on.
+
+    State - Supplies the value of the condition variable state after the
+        broadcast incremented it.
+
+Return Value:
+
+    TRUE if the waiters were woken or requeued.
+
+    FALSE if the waiters could not be requeued and should all be woken
+    instead.
+
+--*/
+
+{
+
+    KSTATUS KernelStatus;
+    PPTHREAD_MUTEX Mutex;
+    ULONG RequeueCount;
+    ULONG WakeCount;
+
+    //
+    // Shared condition variables never requeue, as the recorded mutex
+    // address may have come from another process's address space. For
+    // private ones, the mutex is only known to be alive while a thread is
+    // waiting with it. A broadcast with no waiters has nothing to move, and
+    // the mutex may have been destroyed since the last wait.
+    //
+
+    if (((State & PTHREAD_CONDITION_SHARED) != 0) ||
+        (Condition->Waiters == 0)) {
+
+        return FALSE;
+    }
+
+    Mutex = Condition->Mutex;
+    if ((Mutex == NULL) || (ClpCanRequeueToMutex(Mutex) == FALSE)) {
+        return FALSE;
+    }
+
+    //
+    // If the state changed again, another signal or broadcast got in, and it
+    // is simplest to just wake everyone.
+    //
+
+    WakeCount = 1;
+    RequeueCount = MAX_ULONG;
+    KernelStatus = OsUserLockRequeue(&(Condition->State),
+                                     USER_LOCK_PRIVATE,
+                                     &WakeCount,
+                                     &(Mutex->State),
+                                     &RequeueCount,
+                                     State);
+
+    if (!KSUCCESS(KernelStatus)) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
 int
 ClpWaitOnCondition (
     PPTHREAD_CONDITION Condition,
@@ -651,15 +756,25 @@ Return Value:
     OldState = Condition->State;
 
     //
-    // Unlock the mutex and perform the wait.
+    // For private condition variables, count this thread as a waiter and
+    // remember the mutex so that a broadcast can move this thread over to it.
     //
 
-    pthread_mutex_unlock(Mutex);
     Operation = UserLockWait;
     if ((OldState & PTHREAD_CONDITION_SHARED) == 0) {
         Operation |= USER_LOCK_PRIVATE;
+        RtlAtomicAdd32(&(Condition->Waiters), 1);
+        if (Condition->Mutex != (PPTHREAD_MUTEX)Mutex) {
+            Condition->Mutex = (PPTHREAD_MUTEX)Mutex;
+        }
     }
 
+    //
+    // Unlock the mutex and perform the wait.
+    //
+
+    pthread_mutex_unlock(Mutex);
+
     //
     // If a signal is delivered, the thread is to continue waiting on the
     // condition after the signal handler completes. Do not take another snap
@@ -690,7 +805,21 @@ Return Value:
 
     } while (KernelStatus == STATUS_INTERRUPTED);
 
-    pthread_mutex_lock(Mutex);
+    if ((OldState & PTHREAD_CONDITION_SHARED) == 0) {
+        RtlAtomicAdd32(&(Condition->Waiters), -1);
+    }
+
+    //
+    // A thread that was woken may have had other waiters moved onto the mutex
+    // behind it, so make sure the mutex release wakes the next one.
+    //
+
+    if (KSUCCESS(KernelStatus)) {
+        ClpAcquireMutexContended((PPTHREAD_MUTEX)Mutex);
+
+    } else {
+        pthread_mutex_lock(Mutex);
+    }
     if (KernelStatus == STATUS_TIMEOUT) {
         return ETIMEDOUT;
     }
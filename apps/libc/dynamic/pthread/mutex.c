@@ -44,6 +44,7 @@ Module Name:
 #define PTHREAD_MUTEX_STATE_COUNTER_MASK 0x0000FFFF
 #define PTHREAD_MUTEX_STATE_COUNTER_MAX 0x0000FFFF
 
+#define PTHREAD_MUTEX_STATE_PRIORITY_INHERIT 0x10000000
 #define PTHREAD_MUTEX_STATE_SHARED 0x20000000
 #define PTHREAD_MUTEX_STATE_RECURSIVE 0x40000000
 #define PTHREAD_MUTEX_STATE_ERRORCHECK 0x80000000
@@ -61,7 +62,8 @@ int
 ClpAcquireMutexWithTimeout (
     PPTHREAD_MUTEX Mutex,
     const struct timespec *AbsoluteTimeout,
-    clockid_t Clock
+    clockid_t Clock,
+    BOOL Contended
     );
 
 int
@@ -69,7 +71,21 @@ ClpAcquireNormalMutex (
     PPTHREAD_MUTEX Mutex,
     ULONG Shared,
     const struct timespec *AbsoluteTimeout,
-    INT Clock
+    INT Clock,
+    BOOL Contended
+    );
+
+int
+ClpAcquirePriorityInheritanceMutex (
+    PPTHREAD_MUTEX Mutex,
+    const struct timespec *AbsoluteTimeout,
+    clockid_t Clock,
+    BOOL TryOnce
+    );
+
+int
+ClpReleasePriorityInheritanceMutex (
+    PPTHREAD_MUTEX Mutex
     );
 
 int
@@ -148,6 +164,10 @@ Return Value:
         State |= PTHREAD_MUTEX_STATE_SHARED;
     }
 
+    if ((Flags & PTHREAD_MUTEX_PRIORITY_INHERIT) != 0) {
+        State |= PTHREAD_MUTEX_STATE_PRIORITY_INHERIT;
+    }
+
     switch (Flags & PTHREAD_MUTEX_TYPE_MASK) {
     case PTHREAD_MUTEX_NORMAL:
         break;
@@ -251,7 +271,7 @@ Return Value:
         }
     }
 
-    return ClpAcquireMutexWithTimeout(MutexInternal, NULL, 0);
+    return ClpAcquireMutexWithTimeout(MutexInternal, NULL, 0, FALSE);
 }
 
 PTHREAD_API
@@ -291,6 +311,10 @@ Return Value:
     UINTN ThreadId;
 
     MutexInternal = (PPTHREAD_MUTEX)Mutex;
+    if ((MutexInternal->State & PTHREAD_MUTEX_STATE_PRIORITY_INHERIT) != 0) {
+        return ClpReleasePriorityInheritanceMutex(MutexInternal);
+    }
+
     MutexType = MutexInternal->State & PTHREAD_MUTEX_STATE_TYPE_MASK;
     Shared = MutexInternal->State & PTHREAD_MUTEX_STATE_SHARED;
 
@@ -384,6 +408,10 @@ Return Value:
     ULONG Unlocked;
 
     MutexInternal = (PPTHREAD_MUTEX)Mutex;
+    if ((MutexInternal->State & PTHREAD_MUTEX_STATE_PRIORITY_INHERIT) != 0) {
+        return ClpAcquirePriorityInheritanceMutex(MutexInternal, NULL, 0, TRUE);
+    }
+
     MutexType = MutexInternal->State & PTHREAD_MUTEX_STATE_TYPE_MASK;
     Shared = MutexInternal->State & PTHREAD_MUTEX_STATE_SHARED;
 
@@ -467,7 +495,8 @@ Return Value:
 
     Status = ClpAcquireMutexWithTimeout((PPTHREAD_MUTEX)Mutex,
                                         AbsoluteTimeout,
-                                        CLOCK_REALTIME);
+                                        CLOCK_REALTIME,
+                                        FALSE);
 
     return Status;
 }
@@ -718,6 +747,180 @@ Return Value:
     return Status;
 }
 
+PTHREAD_API
+int
+pthread_mutexattr_getprotocol (
+    const pthread_mutexattr_t *Attribute,
+    int *Protocol
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the mutex protocol given an attribute that was
+    previously set.
+
+Arguments:
+
+    Attribute - Supplies a pointer to the attribute to get the protocol from.
+
+    Protocol - Supplies a pointer where the protocol will be returned on
+        success. See PTHREAD_PRIO_* definitions.
+
+Return Value:
+
+    0 on success.
+
+    Returns an error number on failure.
+
+--*/
+
+{
+
+    PPTHREAD_MUTEX_ATTRIBUTE MutexAttribute;
+
+    MutexAttribute = (PPTHREAD_MUTEX_ATTRIBUTE)Attribute;
+    *Protocol = PTHREAD_PRIO_NONE;
+    if ((MutexAttribute->Flags & PTHREAD_MUTEX_PRIORITY_INHERIT) != 0) {
+        *Protocol = PTHREAD_PRIO_INHERIT;
+    }
+
+    return 0;
+}
+
+PTHREAD_API
+int
+pthread_mutexattr_setprotocol (
+    pthread_mutexattr_t *Attribute,
+    int Protocol
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sets the mutex protocol in the given mutex attributes object.
+
+Arguments:
+
+    Attribute - Supplies a pointer to the attribute to set the protocol in.
+
+    Protocol - Supplies the protocol to set. See PTHREAD_PRIO_* definitions.
+
+Return Value:
+
+    0 on success.
+
+    ENOTSUP if the protocol is not supported.
+
+    EINVAL if the protocol is not valid.
+
+--*/
+
+{
+
+    PPTHREAD_MUTEX_ATTRIBUTE MutexAttribute;
+    int Status;
+
+    MutexAttribute = (PPTHREAD_MUTEX_ATTRIBUTE)Attribute;
+    Status = 0;
+    switch (Protocol) {
+    case PTHREAD_PRIO_NONE:
+        MutexAttribute->Flags &= ~PTHREAD_MUTEX_PRIORITY_INHERIT;
+        break;
+
+    case PTHREAD_PRIO_INHERIT:
+        MutexAttribute->Flags |= PTHREAD_MUTEX_PRIORITY_INHERIT;
+        break;
+
+    case PTHREAD_PRIO_PROTECT:
+        Status = ENOTSUP;
+        break;
+
+    default:
+        Status = EINVAL;
+        break;
+    }
+
+    return Status;
+}
+
+int
+ClpAcquireMutexContended (
+    PPTHREAD_MUTEX Mutex
+    )
+
+/*++
+
+Routine Description:
+
+    This routine acquires a mutex on behalf of a thread that was just woken
+    from a condition variable. The mutex is marked as having waiters, since
+    other condition variable waiters may have been moved onto it.
+
+Arguments:
+
+    Mutex - Supplies a pointer to the mutex to acquire.
+
+Return Value:
+
+    0 on success.
+
+    Returns an error number on failure.
+
+--*/
+
+{
+
+    return ClpAcquireMutexWithTimeout(Mutex, NULL, 0, TRUE);
+}
+
+BOOL
+ClpCanRequeueToMutex (
+    PPTHREAD_MUTEX Mutex
+    )
+
+/*++
+
+Routine Description:
+
+    This routine determines whether threads waiting on a private condition
+    variable can be moved over to wait directly on the given mutex.
+
+Arguments:
+
+    Mutex - Supplies a pointer to the mutex.
+
+Return Value:
+
+    TRUE if waiters can be moved onto the mutex.
+
+    FALSE if waiters must be woken instead.
+
+--*/
+
+{
+
+    ULONG State;
+
+    //
+    // Priority inheritance mutexes are handed off by the kernel, so plain
+    // waiters cannot be moved onto them. Waiters also cannot be moved from a
+    // private condition variable onto a shared mutex, since those are looked
+    // up differently.
+    //
+
+    State = Mutex->State;
+    if ((State & (PTHREAD_MUTEX_STATE_PRIORITY_INHERIT |
+                  PTHREAD_MUTEX_STATE_SHARED)) != 0) {
+
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
 ULONG
 ClpConvertAbsoluteTimespecToRelativeMilliseconds (
     const struct timespec *AbsoluteTime,
@@ -790,7 +993,8 @@ int
 ClpAcquireMutexWithTimeout (
     PPTHREAD_MUTEX Mutex,
     const struct timespec *AbsoluteTimeout,
-    clockid_t Clock
+    clockid_t Clock,
+    BOOL Contended
     )
 
 /*++
@@ -808,6 +1012,11 @@ Routine Description:
 
     Clock - Supplies the clock to measure the timeout against.
 
+    Contended - Supplies a boolean indicating whether the caller knows there
+        are likely other waiters. If so, the mutex is only ever acquired in
+        the locked with waiters state so that the next waiter is woken on
+        release.
+
 Return Value:
 
     0 on success.
@@ -831,6 +1040,13 @@ Return Value:
     ULONG Unlocked;
 
     OldState = Mutex->State;
+    if ((OldState & PTHREAD_MUTEX_STATE_PRIORITY_INHERIT) != 0) {
+        return ClpAcquirePriorityInheritanceMutex(Mutex,
+                                                  AbsoluteTimeout,
+                                                  Clock,
+                                                  FALSE);
+    }
+
     MutexType = Mutex->State & PTHREAD_MUTEX_STATE_TYPE_MASK;
     Shared = Mutex->State & PTHREAD_MUTEX_STATE_SHARED;
 
@@ -839,7 +1055,11 @@ Return Value:
     //
 
     if (MutexType == 0) {
-        return ClpAcquireNormalMutex(Mutex, Shared, AbsoluteTimeout, Clock);
+        return ClpAcquireNormalMutex(Mutex,
+                                     Shared,
+                                     AbsoluteTimeout,
+                                     Clock,
+                                     Contended);
     }
 
     //
@@ -866,7 +1086,7 @@ Return Value:
     // makes the release operation lightweight.
     //
 
-    if (OldState == Unlocked) {
+    if ((Contended == FALSE) && (OldState == Unlocked)) {
         OldState = RtlAtomicCompareExchange32(&(Mutex->State),
                                               Locked,
                                               Unlocked);
@@ -975,7 +1195,8 @@ ClpAcquireNormalMutex (
     PPTHREAD_MUTEX Mutex,
     ULONG Shared,
     const struct timespec *AbsoluteTimeout,
-    INT Clock
+    INT Clock,
+    BOOL Contended
     )
 
 /*++
@@ -996,6 +1217,10 @@ Routine Description:
 
     Clock - Supplies the clock source.
 
+    Contended - Supplies a boolean indicating whether the caller knows there
+        are likely other waiters, in which case the uncontended attempt is
+        skipped.
+
 Return Value:
 
     0 if the lock was acquired.
@@ -1014,10 +1239,14 @@ Return Value:
     ULONG Unlocked;
 
     //
-    // Give it a quick fast attempt first.
+    // Give it a quick fast attempt first, unless there are known to be other
+    // waiters. Acquiring the mutex without the waiters state would strand
+    // them when it is released.
     //
 
-    if (ClpTryToAcquireNormalMutex(Mutex, Shared) == 0) {
+    if ((Contended == FALSE) &&
+        (ClpTryToAcquireNormalMutex(Mutex, Shared) == 0)) {
+
         return 0;
     }
 
@@ -1077,6 +1306,212 @@ Return Value:
     return 0;
 }
 
+int
+ClpAcquirePriorityInheritanceMutex (
+    PPTHREAD_MUTEX Mutex,
+    const struct timespec *AbsoluteTimeout,
+    clockid_t Clock,
+    BOOL TryOnce
+    )
+
+/*++
+
+Routine Description:
+
+    This routine acquires a priority inheritance mutex. The uncontended case
+    is handled entirely in user mode. Otherwise the kernel queues the thread
+    and lends its priority to the owner until the mutex is handed over.
+
+Arguments:
+
+    Mutex - Supplies a pointer to the mutex to acquire.
+
+    AbsoluteTimeout - Supplies an optional pointer to the deadline in absolute
+        time after which the operation should time out and fail.
+
+    Clock - Supplies the clock to measure the timeout against.
+
+    TryOnce - Supplies a boolean indicating whether to give up rather than
+        block if the mutex is owned by another thread.
+
+Return Value:
+
+    0 on success.
+
+    EBUSY if only a single attempt was requested and the mutex is held.
+
+    EDEADLK if the calling thread already owns a non-recursive mutex.
+
+    Returns an error number on failure.
+
+--*/
+
+{
+
+    KSTATUS KernelStatus;
+    ULONG MutexType;
+    ULONG OldState;
+    ULONG Operation;
+    ULONG ThreadId;
+    ULONG TimeoutInMilliseconds;
+    ULONG Value;
+
+    MutexType = Mutex->State & PTHREAD_MUTEX_STATE_TYPE_MASK;
+    ThreadId = pthread_getthreadid_np();
+    if ((Mutex->PiState & USER_LOCK_PI_OWNER_MASK) == ThreadId) {
+        if (MutexType == PTHREAD_MUTEX_STATE_RECURSIVE) {
+            return ClpMutexIncrementAcquireCount(Mutex);
+        }
+
+        if (TryOnce != FALSE) {
+            return EBUSY;
+        }
+
+        return EDEADLK;
+    }
+
+    OldState = RtlAtomicCompareExchange32(&(Mutex->PiState), ThreadId, 0);
+    if (OldState == 0) {
+        return 0;
+    }
+
+    if (TryOnce != FALSE) {
+        return EBUSY;
+    }
+
+    Operation = UserLockPiLock;
+    if ((Mutex->State & PTHREAD_MUTEX_STATE_SHARED) == 0) {
+        Operation |= USER_LOCK_PRIVATE;
+    }
+
+    while (TRUE) {
+        if (AbsoluteTimeout != NULL) {
+            TimeoutInMilliseconds =
+                           ClpConvertAbsoluteTimespecToRelativeMilliseconds(
+                                                              AbsoluteTimeout,
+                                                              Clock);
+
+            if (TimeoutInMilliseconds == 0) {
+                return ETIMEDOUT;
+            }
+
+        } else {
+            TimeoutInMilliseconds = SYS_WAIT_TIME_INDEFINITE;
+        }
+
+        //
+        // The kernel hands the mutex directly to this thread when the owner
+        // releases it, so success means the mutex is held.
+        //
+
+        Value = 0;
+        KernelStatus = OsUserLock(&(Mutex->PiState),
+                                  Operation,
+                                  &Value,
+                                  TimeoutInMilliseconds);
+
+        if (KSUCCESS(KernelStatus)) {
+            break;
+        }
+
+        if (KernelStatus == STATUS_INTERRUPTED) {
+            continue;
+        }
+
+        if (KernelStatus == STATUS_TIMEOUT) {
+            return ETIMEDOUT;
+        }
+
+        if (KernelStatus == STATUS_DEADLOCK) {
+            return EDEADLK;
+        }
+
+        return ClConvertKstatusToErrorNumber(KernelStatus);
+    }
+
+    return 0;
+}
+
+int
+ClpReleasePriorityInheritanceMutex (
+    PPTHREAD_MUTEX Mutex
+    )
+
+/*++
+
+Routine Description:
+
+    This routine releases a priority inheritance mutex. If there are waiters,
+    the kernel hands the mutex to the first one and drops any priority this
+    thread inherited.
+
+Arguments:
+
+    Mutex - Supplies a pointer to the mutex to release.
+
+Return Value:
+
+    0 on success.
+
+    EPERM if this thread does not own the mutex.
+
+--*/
+
+{
+
+    ULONG Counter;
+    KSTATUS KernelStatus;
+    ULONG OldState;
+    ULONG Operation;
+    ULONG ThreadId;
+    ULONG Value;
+
+    ThreadId = pthread_getthreadid_np();
+    if ((Mutex->PiState & USER_LOCK_PI_OWNER_MASK) != ThreadId) {
+        return EPERM;
+    }
+
+    //
+    // If the counter is non-zero, just decrement it.
+    //
+
+    Counter = (Mutex->State >> PTHREAD_MUTEX_STATE_COUNTER_SHIFT) &
+              PTHREAD_MUTEX_STATE_COUNTER_MASK;
+
+    if (Counter != 0) {
+        RtlAtomicAdd32(&(Mutex->State),
+                       0 - (1 << PTHREAD_MUTEX_STATE_COUNTER_SHIFT));
+
+        return 0;
+    }
+
+    //
+    // If nobody is waiting, the mutex can be released without the kernel.
+    //
+
+    OldState = RtlAtomicCompareExchange32(&(Mutex->PiState), 0, ThreadId);
+    if (OldState == ThreadId) {
+        return 0;
+    }
+
+    Operation = UserLockPiUnlock;
+    if ((Mutex->State & PTHREAD_MUTEX_STATE_SHARED) == 0) {
+        Operation |= USER_LOCK_PRIVATE;
+    }
+
+    Value = 0;
+    KernelStatus = OsUserLock(&(Mutex->PiState), Operation, &Value, 0);
+    if (!KSUCCESS(KernelStatus)) {
+        if (KernelStatus == STATUS_PERMISSION_DENIED) {
+            return EPERM;
+        }
+
+        return ClConvertKstatusToErrorNumber(KernelStatus);
+    }
+
+    return 0;
+}
+
 int
 ClpTryToAcquireNormalMutex (
     PPTHREAD_MUTEX Mutex,
@@ -1042,6 +1042,122 @@ Return Value:
     return 0;
 }
 
+PTHREAD_API
+int
+pthread_getaffinity_np (
+    pthread_t ThreadId,
+    size_t SetSize,
+    cpu_set_t *Set
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the set of processors the given thread is allowed to
+    run on.
+
+Arguments:
+
+    ThreadId - Supplies the thread to query.
+
+    SetSize - Supplies the size of the CPU set buffer in bytes.
+
+    Set - Supplies a pointer where the thread's processor affinity will be
+        returned.
+
+Return Value:
+
+    0 on success.
+
+    Returns an error number on failure.
+
+--*/
+
+{
+
+    KSTATUS Status;
+    PPTHREAD Thread;
+
+    Thread = ClpGetThreadFromId(ThreadId);
+    if ((Thread == NULL) || (Thread->ThreadId == 0)) {
+        return ESRCH;
+    }
+
+    memset(Set, 0, SetSize);
+    Status = OsSetAffinity(PriorityTargetThread,
+                           Thread->ThreadId,
+                           FALSE,
+                           Set,
+                           SetSize);
+
+    if (!KSUCCESS(Status)) {
+        return ClConvertKstatusToErrorNumber(Status);
+    }
+
+    return 0;
+}
+
+PTHREAD_API
+int
+pthread_setaffinity_np (
+    pthread_t ThreadId,
+    size_t SetSize,
+    const cpu_set_t *Set
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sets the set of processors the given thread is allowed to
+    run on. If the thread is currently running on a processor not in the set,
+    it is moved.
+
+Arguments:
+
+    ThreadId - Supplies the thread to modify.
+
+    SetSize - Supplies the size of the CPU set buffer in bytes.
+
+    Set - Supplies a pointer to the new set of allowed processors. At least
+        one online processor must be in the set.
+
+Return Value:
+
+    0 on success.
+
+    EINVAL if the set contains no online processors.
+
+    ESRCH if the thread has exited.
+
+    Returns an error number on other failures.
+
+--*/
+
+{
+
+    KSTATUS Status;
+    PPTHREAD Thread;
+
+    Thread = ClpGetThreadFromId(ThreadId);
+    if ((Thread == NULL) || (Thread->ThreadId == 0)) {
+        return ESRCH;
+    }
+
+    Status = OsSetAffinity(PriorityTargetThread,
+                           Thread->ThreadId,
+                           TRUE,
+                           (PVOID)Set,
+                           SetSize);
+
+    if (!KSUCCESS(Status)) {
+        return ClConvertKstatusToErrorNumber(Status);
+    }
+
+    return 0;
+}
+
 PTHREAD_API
 void
 __pthread_cleanup_push (
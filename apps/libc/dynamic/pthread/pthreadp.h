@@ -45,6 +45,12 @@ Module Name:
 
 #define PTHREAD_MUTEX_SHARED 0x00000010
 
+//
+// This bit is set if the mutex uses the priority inheritance protocol.
+//
+
+#define PTHREAD_MUTEX_PRIORITY_INHERIT 0x00000020
+
 //
 // Define the default stack size for a thread.
 //
@@ -105,6 +111,10 @@ Structure Description:
 
     State - Stores the state of the mutex.
 
+    PiState - Stores the kernel thread ID of the owner of a priority
+        inheritance mutex, and whether or not there are waiters. This is
+        managed jointly with the kernel.
+
     Owner - Stores the owner of the mutex, used when the recursive
         implementation is set.
 
@@ -112,6 +122,7 @@ Structure Description:
 
 typedef struct _PTHREAD_MUTEX {
     ULONG State;
+    ULONG PiState;
     UINTN Owner;
 } PTHREAD_MUTEX, *PPTHREAD_MUTEX;
 
@@ -141,10 +152,21 @@ Structure Description:
 
     State - Stores the state of the condition variable.
 
+    Waiters - Stores the number of threads currently waiting on a private
+        condition variable. The mutex pointer is only valid while this is
+        non-zero.
+
+    Mutex - Stores a pointer to the mutex most recently used to wait on a
+        private condition variable. Broadcasts move waiters over to this mutex
+        rather than waking them all at once. This is never set for shared
+        condition variables, as the address may belong to another process.
+
 --*/
 
 typedef struct _PTHREAD_CONDITION {
     ULONG State;
+    ULONG Waiters;
+    PPTHREAD_MUTEX Mutex;
 } PTHREAD_CONDITION, *PPTHREAD_CONDITION;
 
 /*++
@@ -444,6 +466,58 @@ Return Value:
 
 --*/
 
+int
+ClpAcquireMutexContended (
+    PPTHREAD_MUTEX Mutex
+    );
+
+/*++
+
+Routine Description:
+
+    This routine acquires a mutex on behalf of a thread that was just woken
+    from a condition variable. The mutex is marked as having waiters, since
+    other condition variable waiters may have been moved onto it.
+
+Arguments:
+
+    Mutex - Supplies a pointer to the mutex to acquire.
+
+Return Value:
+
+    0 on success.
+
+    Returns an error number on failure.
+
+--*/
+
+BOOL
+ClpCanRequeueToMutex (
+    PPTHREAD_MUTEX Mutex
+    );
+
+/*++
+
+Routine Description:
+
+    This routine determines whether threads waiting on a condition variable
+    can be moved over to wait directly on the given mutex.
+
+Arguments:
+
+    Mutex - Supplies a pointer to the mutex.
+
+    Shared - Supplies a boolean indicating whether the condition variable is
+        shared between processes.
+
+Return Value:
+
+    TRUE if waiters can be moved onto the mutex.
+
+    FALSE if waiters must be woken instead.
+
+--*/
+
 ULONG
 ClpConvertAbsoluteTimespecToRelativeMilliseconds (
     const struct timespec *AbsoluteTime,
@@ -67,6 +67,14 @@ Module Name:
 // ----------------------------------------------- Internal Function Prototypes
 //
 
+INT
+ClpGetPriorityTarget (
+    int Which,
+    id_t Who,
+    PPRIORITY_TARGET_TYPE TargetType,
+    PLONG TargetId
+    );
+
 //
 // -------------------------------------------------------------------- Globals
 //
@@ -110,11 +118,23 @@ Return Value:
 
 {
 
-    //
-    // TODO: Implement getpriority.
-    //
+    LONG NiceValue;
+    KSTATUS Status;
+    LONG TargetId;
+    PRIORITY_TARGET_TYPE TargetType;
 
-    return 0;
+    if (ClpGetPriorityTarget(Which, Who, &TargetType, &TargetId) != 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    Status = OsSetPriority(TargetType, TargetId, NULL, &NiceValue);
+    if (!KSUCCESS(Status)) {
+        errno = ClConvertKstatusToErrorNumber(Status);
+        return -1;
+    }
+
+    return NiceValue;
 }
 
 LIBC_API
@@ -154,12 +174,35 @@ Return Value:
 
 {
 
+    LONG NiceValue;
+    KSTATUS Status;
+    LONG TargetId;
+    PRIORITY_TARGET_TYPE TargetType;
+
+    if (ClpGetPriorityTarget(Which, Who, &TargetType, &TargetId) != 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
     //
-    // TODO: Implement setpriority.
+    // Values outside the valid range are clipped rather than rejected.
     //
 
-    errno = ENOSYS;
-    return -1;
+    if (Value < -NZERO) {
+        Value = -NZERO;
+
+    } else if (Value > NZERO - 1) {
+        Value = NZERO - 1;
+    }
+
+    NiceValue = Value;
+    Status = OsSetPriority(TargetType, TargetId, &NiceValue, NULL);
+    if (!KSUCCESS(Status)) {
+        errno = ClConvertKstatusToErrorNumber(Status);
+        return -1;
+    }
+
+    return 0;
 }
 
 LIBC_API
@@ -459,3 +502,66 @@ Return Value:
 // --------------------------------------------------------- Internal Functions
 //
 
+INT
+ClpGetPriorityTarget (
+    int Which,
+    id_t Who,
+    PPRIORITY_TARGET_TYPE TargetType,
+    PLONG TargetId
+    )
+
+/*++
+
+Routine Description:
+
+    This routine converts the which and who parameters of the get and set
+    priority functions into a kernel priority target.
+
+Arguments:
+
+    Which - Supplies the PRIO_* type of entity.
+
+    Who - Supplies the identifier of the process, process group, or user. Zero
+        means the caller's.
+
+    TargetType - Supplies a pointer where the kernel target type will be
+        returned.
+
+    TargetId - Supplies a pointer where the kernel target identifier will be
+        returned.
+
+Return Value:
+
+    0 on success.
+
+    -1 if the which parameter is not valid.
+
+--*/
+
+{
+
+    switch (Which) {
+    case PRIO_PROCESS:
+        *TargetType = PriorityTargetProcess;
+        break;
+
+    case PRIO_PGRP:
+        *TargetType = PriorityTargetProcessGroup;
+        break;
+
+    case PRIO_USER:
+        *TargetType = PriorityTargetUser;
+        break;
+
+    default:
+        return -1;
+    }
+
+    *TargetId = Who;
+    if (Who == 0) {
+        *TargetId = -1;
+    }
+
+    return 0;
+}
+
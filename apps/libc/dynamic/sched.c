@@ -32,11 +32,20 @@ Module Name:
 #include "libcp.h"
 #include <sched.h>
 #include <errno.h>
+#include <limits.h>
 
 //
 // ---------------------------------------------------------------- Definitions
 //
 
+//
+// Define the priority range of the time-sharing policy. The priority is the
+// negative of the nice value.
+//
+
+#define SCHED_OTHER_PRIORITY_MIN (-(NZERO - 1))
+#define SCHED_OTHER_PRIORITY_MAX NZERO
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -94,6 +103,439 @@ Return Value:
     return 0;
 }
 
+LIBC_API
+int
+sched_get_priority_min (
+    int Policy
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the minimum scheduling priority for the given policy.
+
+Arguments:
+
+    Policy - Supplies the scheduling policy. See SCHED_* definitions.
+
+Return Value:
+
+    Returns the minimum priority value on success.
+
+    -1 on error, and the errno variable will contain more information.
+
+--*/
+
+{
+
+    if (Policy != SCHED_OTHER) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return SCHED_OTHER_PRIORITY_MIN;
+}
+
+LIBC_API
+int
+sched_get_priority_max (
+    int Policy
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the maximum scheduling priority for the given policy.
+
+Arguments:
+
+    Policy - Supplies the scheduling policy. See SCHED_* definitions.
+
+Return Value:
+
+    Returns the maximum priority value on success.
+
+    -1 on error, and the errno variable will contain more information.
+
+--*/
+
+{
+
+    if (Policy != SCHED_OTHER) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return SCHED_OTHER_PRIORITY_MAX;
+}
+
+LIBC_API
+int
+sched_getparam (
+    pid_t ProcessId,
+    struct sched_param *Parameters
+    )
+
+/*++
+
+Routine Description:
+
+    This routine gets the scheduling parameters of the given process.
+
+Arguments:
+
+    ProcessId - Supplies the ID of the process to query. Supply zero to query
+        the current process.
+
+    Parameters - Supplies a pointer where the scheduling parameters will be
+        returned.
+
+Return Value:
+
+    0 on success.
+
+    -1 on error, and the errno variable will contain more information.
+
+--*/
+
+{
+
+    LONG NiceValue;
+    KSTATUS Status;
+    LONG TargetId;
+
+    if ((ProcessId < 0) || (Parameters == NULL)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    TargetId = ProcessId;
+    if (ProcessId == 0) {
+        TargetId = -1;
+    }
+
+    Status = OsSetPriority(PriorityTargetProcess, TargetId, NULL, &NiceValue);
+    if (!KSUCCESS(Status)) {
+        errno = ClConvertKstatusToErrorNumber(Status);
+        return -1;
+    }
+
+    Parameters->sched_priority = -NiceValue;
+    return 0;
+}
+
+LIBC_API
+int
+sched_setparam (
+    pid_t ProcessId,
+    const struct sched_param *Parameters
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sets the scheduling parameters of the given process.
+
+Arguments:
+
+    ProcessId - Supplies the ID of the process to modify. Supply zero to
+        modify the current process.
+
+    Parameters - Supplies a pointer to the new scheduling parameters.
+
+Return Value:
+
+    0 on success.
+
+    -1 on error, and the errno variable will contain more information.
+
+--*/
+
+{
+
+    LONG NiceValue;
+    KSTATUS Status;
+    LONG TargetId;
+
+    if ((ProcessId < 0) ||
+        (Parameters == NULL) ||
+        (Parameters->sched_priority < SCHED_OTHER_PRIORITY_MIN) ||
+        (Parameters->sched_priority > SCHED_OTHER_PRIORITY_MAX)) {
+
+        errno = EINVAL;
+        return -1;
+    }
+
+    TargetId = ProcessId;
+    if (ProcessId == 0) {
+        TargetId = -1;
+    }
+
+    NiceValue = -Parameters->sched_priority;
+    Status = OsSetPriority(PriorityTargetProcess, TargetId, &NiceValue, NULL);
+    if (!KSUCCESS(Status)) {
+        errno = ClConvertKstatusToErrorNumber(Status);
+        return -1;
+    }
+
+    return 0;
+}
+
+LIBC_API
+int
+sched_getscheduler (
+    pid_t ProcessId
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the scheduling policy of the given process.
+
+Arguments:
+
+    ProcessId - Supplies the ID of the process to query. Supply zero to query
+        the current process.
+
+Return Value:
+
+    Returns the scheduling policy on success. See SCHED_* definitions.
+
+    -1 on error, and the errno variable will contain more information.
+
+--*/
+
+{
+
+    struct sched_param Parameters;
+
+    //
+    // Every process uses the time-sharing policy, so just make sure the
+    // process exists.
+    //
+
+    if (sched_getparam(ProcessId, &Parameters) != 0) {
+        return -1;
+    }
+
+    return SCHED_OTHER;
+}
+
+LIBC_API
+int
+sched_setscheduler (
+    pid_t ProcessId,
+    int Policy,
+    const struct sched_param *Parameters
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sets the scheduling policy and parameters of the given
+    process.
+
+Arguments:
+
+    ProcessId - Supplies the ID of the process to modify. Supply zero to
+        modify the current process.
+
+    Policy - Supplies the new scheduling policy. Only SCHED_OTHER is
+        supported.
+
+    Parameters - Supplies a pointer to the new scheduling parameters.
+
+Return Value:
+
+    Returns the previous scheduling policy on success.
+
+    -1 on error, and the errno variable will contain more information.
+
+--*/
+
+{
+
+    if (Policy != SCHED_OTHER) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (sched_setparam(ProcessId, Parameters) != 0) {
+        return -1;
+    }
+
+    return SCHED_OTHER;
+}
+
+LIBC_API
+int
+sched_getaffinity (
+    pid_t ProcessId,
+    size_t SetSize,
+    cpu_set_t *Set
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the set of processors the threads of the given
+    process are allowed to run on.
+
+Arguments:
+
+    ProcessId - Supplies the ID of the process to query. Supply zero to query
+        the current process.
+
+    SetSize - Supplies the size of the CPU set buffer in bytes.
+
+    Set - Supplies a pointer where the union of the processor affinities of
+        all threads in the process will be returned.
+
+Return Value:
+
+    0 on success.
+
+    -1 on error, and the errno variable will contain more information.
+
+--*/
+
+{
+
+    KSTATUS Status;
+    LONG TargetId;
+
+    TargetId = ProcessId;
+    if (ProcessId == 0) {
+        TargetId = -1;
+    }
+
+    //
+    // The kernel only fills in as many processors as it supports, so clear
+    // out the rest.
+    //
+
+    memset(Set, 0, SetSize);
+    Status = OsSetAffinity(PriorityTargetProcess,
+                           TargetId,
+                           FALSE,
+                           Set,
+                           SetSize);
+
+    if (!KSUCCESS(Status)) {
+        errno = ClConvertKstatusToErrorNumber(Status);
+        return -1;
+    }
+
+    return 0;
+}
+
+LIBC_API
+int
+sched_setaffinity (
+    pid_t ProcessId,
+    size_t SetSize,
+    const cpu_set_t *Set
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sets the set of processors all threads in the given process
+    are allowed to run on.
+
+Arguments:
+
+    ProcessId - Supplies the ID of the process to modify. Supply zero to
+        modify the current process.
+
+    SetSize - Supplies the size of the CPU set buffer in bytes.
+
+    Set - Supplies a pointer to the new set of allowed processors. At least
+        one online processor must be in the set.
+
+Return Value:
+
+    0 on success.
+
+    -1 on error, and the errno variable will contain more information.
+
+--*/
+
+{
+
+    KSTATUS Status;
+    LONG TargetId;
+
+    TargetId = ProcessId;
+    if (ProcessId == 0) {
+        TargetId = -1;
+    }
+
+    Status = OsSetAffinity(PriorityTargetProcess,
+                           TargetId,
+                           TRUE,
+                           (PVOID)Set,
+                           SetSize);
+
+    if (!KSUCCESS(Status)) {
+        errno = ClConvertKstatusToErrorNumber(Status);
+        return -1;
+    }
+
+    return 0;
+}
+
+LIBC_API
+int
+__sched_cpucount (
+    size_t SetSize,
+    const cpu_set_t *Set
+    )
+
+/*++
+
+Routine Description:
+
+    This routine counts the number of processors in the given CPU set. Use
+    the CPU_COUNT macro rather than calling this routine directly.
+
+Arguments:
+
+    SetSize - Supplies the size of the CPU set buffer in bytes.
+
+    Set - Supplies a pointer to the CPU set.
+
+Return Value:
+
+    Returns the number of processors in the set.
+
+--*/
+
+{
+
+    int Count;
+    size_t Index;
+    unsigned long Word;
+
+    Count = 0;
+    for (Index = 0; Index < SetSize / sizeof(unsigned long); Index += 1) {
+        Word = Set->__bits[Index];
+        while (Word != 0) {
+            Word &= Word - 1;
+            Count += 1;
+        }
+    }
+
+    return Count;
+}
+
 //
 // --------------------------------------------------------- Internal Functions
 //
@@ -209,6 +209,16 @@ ClpPosixSpawn (
     BOOL UsePath
     );
 
+INT
+ClpSpawnImage (
+    pid_t *ChildPid,
+    const char *Path,
+    PPOSIX_SPAWN_FILE_ACTION *FileActions,
+    PPOSIX_SPAWN_ATTRIBUTES *Attributes,
+    char *const Arguments[],
+    char *const Environment[]
+    );
+
 INT
 ClpProcessSpawnAttributes (
     PPOSIX_SPAWN_ATTRIBUTES Attributes
@@ -1183,22 +1193,98 @@ Return Value:
 
 {
 
-    volatile int Error;
+    PSTR CombinedPath;
+    INT Error;
+    size_t FileLength;
+    PSTR PathCopy;
+    PSTR PathEntry;
+    size_t PathEntryLength;
+    PSTR PathVariable;
     pid_t Pid;
+    char *Token;
 
     //
-    // TODO: Use vfork when it is implemented.
+    // Try to have the kernel create the child and load the image directly,
+    // which avoids copying this process' address space just to tear it down
+    // again. Search the path here, as execvpe would in the child.
     //
 
+    PathVariable = getenv("PATH");
+    if ((UsePath == FALSE) || (strchr(Path, '/') != NULL) ||
+        (PathVariable == NULL) || (*PathVariable == '\0')) {
+
+        Error = ClpSpawnImage(ChildPid,
+                              Path,
+                              FileActions,
+                              Attributes,
+                              Arguments,
+                              Environment);
+
+    } else {
+        PathCopy = strdup(PathVariable);
+        if (PathCopy == NULL) {
+            return ENOMEM;
+        }
+
+        Error = ENOENT;
+        FileLength = strlen(Path);
+        PathEntry = strtok_r(PathCopy, ":", &Token);
+        while (PathEntry != NULL) {
+            PathEntryLength = strlen(PathEntry);
+            if (PathEntryLength == 0) {
+                PathEntry = ".";
+                PathEntryLength = 1;
+            }
+
+            if (PathEntry[PathEntryLength - 1] == '/') {
+                PathEntryLength -= 1;
+            }
+
+            CombinedPath = malloc(PathEntryLength + FileLength + 2);
+            if (CombinedPath == NULL) {
+                Error = ENOMEM;
+                break;
+            }
+
+            memcpy(CombinedPath, PathEntry, PathEntryLength);
+            CombinedPath[PathEntryLength] = '/';
+            strcpy(CombinedPath + PathEntryLength + 1, Path);
+            if (access(CombinedPath, X_OK) == 0) {
+                Error = ClpSpawnImage(ChildPid,
+                                      CombinedPath,
+                                      FileActions,
+                                      Attributes,
+                                      Arguments,
+                                      Environment);
+
+                free(CombinedPath);
+                break;
+            }
+
+            free(CombinedPath);
+            PathEntry = strtok_r(NULL, ":", &Token);
+        }
+
+        free(PathCopy);
+    }
+
+    //
+    // Images the kernel doesn't know how to load (like shell scripts) need
+    // the interpreter handling in execve, so fall back to forking a child
+    // that execs.
+    //
+
+    if (Error != ENOEXEC) {
+        return Error;
+    }
+
     Error = 0;
     Pid = fork();
     if (Pid == -1) {
         return errno;
 
     //
-    // In the child, process the attributes and execute the image. With vfork,
-    // the values set in error here will be accessible by the parent, since
-    // vfork temporarily shares the memory of the parent.
+    // In the child, process the attributes and execute the image.
     //
 
     } else if (Pid == 0) {
@@ -1239,21 +1325,261 @@ Return Value:
     //
 
     } else {
+        if (ChildPid != NULL) {
+            *ChildPid = Pid;
+        }
+    }
+
+    return Error;
+}
+
+INT
+ClpSpawnImage (
+    pid_t *ChildPid,
+    const char *Path,
+    PPOSIX_SPAWN_FILE_ACTION *FileActions,
+    PPOSIX_SPAWN_ATTRIBUTES *Attributes,
+    char *const Arguments[],
+    char *const Environment[]
+    )
+
+/*++
+
+Routine Description:
+
+    This routine asks the kernel to create a new child process running the
+    given image, performing the file actions and attributes on the way. The
+    calling process is not copied.
+
+Arguments:
+
+    ChildPid - Supplies an optional pointer where the child process ID will be
+        returned on success.
+
+    Path - Supplies a pointer to the complete path of the image to execute.
+
+    FileActions - Supplies an optional pointer to the file actions to execute
+        in the child.
+
+    Attributes - Supplies an optional pointer to the spawn attributes.
+
+    Arguments - Supplies the arguments to pass to the new child.
+
+    Environment - Supplies the environment to pass to the new child.
+
+Return Value:
+
+    0 on success.
+
+    ENOEXEC if the kernel does not recognize the image format. No child is
+    left behind in this case.
+
+    Returns an error number on other failures.
+
+--*/
+
+{
+
+    PSPAWN_FILE_ACTION Action;
+    UINTN ActionCount;
+    PSPAWN_FILE_ACTION Actions;
+    UINTN ArgumentCount;
+    UINTN ArgumentValuesTotalLength;
+    PLIST_ENTRY CurrentEntry;
+    PPOSIX_SPAWN_FILE_ENTRY Entry;
+    UINTN EnvironmentCount;
+    UINTN EnvironmentValuesTotalLength;
+    INT Error;
+    PROCESS_ID Pid;
+    PPROCESS_ENVIRONMENT ProcessEnvironment;
+    SPAWN_ATTRIBUTES SpawnAttributes;
+    PSPAWN_ATTRIBUTES SpawnAttributesPointer;
+    KSTATUS Status;
+
+    Actions = NULL;
+    ProcessEnvironment = NULL;
+    if (Environment == NULL) {
+        Environment = environ;
+    }
+
+    fflush(NULL);
+    ArgumentCount = 0;
+    ArgumentValuesTotalLength = 0;
+    while (Arguments[ArgumentCount] != NULL) {
+        ArgumentValuesTotalLength += strlen(Arguments[ArgumentCount]) + 1;
+        ArgumentCount += 1;
+    }
+
+    EnvironmentCount = 0;
+    EnvironmentValuesTotalLength = 0;
+    if (Environment != NULL) {
+        while (Environment[EnvironmentCount] != NULL) {
+            EnvironmentValuesTotalLength +=
+                                     strlen(Environment[EnvironmentCount]) + 1;
+
+            EnvironmentCount += 1;
+        }
+    }
+
+    ProcessEnvironment = OsCreateEnvironment((PSTR)Path,
+                                             strlen(Path) + 1,
+                                             (PSTR *)Arguments,
+                                             ArgumentValuesTotalLength,
+                                             ArgumentCount,
+                                             (PSTR *)Environment,
+                                             EnvironmentValuesTotalLength,
+                                             EnvironmentCount);
+
+    if (ProcessEnvironment == NULL) {
+        Error = ENOMEM;
+        goto SpawnImageEnd;
+    }
+
+    //
+    // Flatten the file actions list into the array the kernel wants.
+    //
+
+    ActionCount = 0;
+    if (FileActions != NULL) {
+        CurrentEntry = (*FileActions)->EntryList.Next;
+        while (CurrentEntry != &((*FileActions)->EntryList)) {
+            ActionCount += 1;
+            CurrentEntry = CurrentEntry->Next;
+        }
+    }
+
+    if (ActionCount > SPAWN_MAX_FILE_ACTIONS) {
+        Error = E2BIG;
+        goto SpawnImageEnd;
+    }
+
+    if (ActionCount != 0) {
+        Actions = malloc(ActionCount * sizeof(SPAWN_FILE_ACTION));
+        if (Actions == NULL) {
+            Error = ENOMEM;
+            goto SpawnImageEnd;
+        }
+
+        memset(Actions, 0, ActionCount * sizeof(SPAWN_FILE_ACTION));
+        Action = Actions;
+        CurrentEntry = (*FileActions)->EntryList.Next;
+        while (CurrentEntry != &((*FileActions)->EntryList)) {
+            Entry = LIST_VALUE(CurrentEntry, POSIX_SPAWN_FILE_ENTRY, ListEntry);
+            CurrentEntry = CurrentEntry->Next;
+            switch (Entry->Action) {
+            case SpawnActionOpen:
+                Action->Type = SpawnFileActionOpen;
+                Action->Handle = (HANDLE)(UINTN)(Entry->U.Open.Descriptor);
+                Action->Path = Entry->U.Open.Path;
+                Action->PathBufferLength = strlen(Entry->U.Open.Path) + 1;
+                Action->Flags = ClpConvertOpenFlags(Entry->U.Open.OpenFlags);
+                if ((Entry->U.Open.OpenFlags & O_CREAT) != 0) {
+
+                    ASSERT_FILE_PERMISSIONS_EQUIVALENT();
+
+                    Action->CreatePermissions = Entry->U.Open.CreateMode;
+                }
+
+                break;
+
+            case SpawnActionDup2:
+                Action->Type = SpawnFileActionDuplicate;
+                Action->Handle = (HANDLE)(UINTN)(Entry->U.Dup2.Descriptor);
+                Action->NewHandle =
+                                (HANDLE)(UINTN)(Entry->U.Dup2.NewDescriptor);
+
+                break;
+
+            case SpawnActionClose:
+                Action->Type = SpawnFileActionClose;
+                Action->Handle = (HANDLE)(UINTN)(Entry->U.Close.Descriptor);
+                break;
+
+            default:
+
+                assert(FALSE);
+
+                Error = EINVAL;
+                goto SpawnImageEnd;
+            }
+
+            Action += 1;
+        }
+    }
+
+    SpawnAttributesPointer = NULL;
+    if (Attributes != NULL) {
+        memset(&SpawnAttributes, 0, sizeof(SPAWN_ATTRIBUTES));
+        if (((*Attributes)->Flags & POSIX_SPAWN_RESETIDS) != 0) {
+            SpawnAttributes.Flags |= SPAWN_ATTRIBUTE_RESET_IDS;
+        }
+
+        if (((*Attributes)->Flags & POSIX_SPAWN_SETPGROUP) != 0) {
+            SpawnAttributes.Flags |= SPAWN_ATTRIBUTE_SET_PROCESS_GROUP;
+            SpawnAttributes.ProcessGroup = (*Attributes)->ProcessGroup;
+        }
+
+        if (((*Attributes)->Flags & POSIX_SPAWN_SETSIGDEF) != 0) {
+            SpawnAttributes.Flags |= SPAWN_ATTRIBUTE_SET_SIGNAL_DEFAULT;
+            SpawnAttributes.DefaultSignals = (*Attributes)->DefaultMask;
+        }
+
+        //
+        // Don't allow the internal signals used by the C library to become
+        // blocked, as sigprocmask would in the child.
+        //
+
+        if (((*Attributes)->Flags & POSIX_SPAWN_SETSIGMASK) != 0) {
+            SpawnAttributes.Flags |= SPAWN_ATTRIBUTE_SET_SIGNAL_MASK;
+            SpawnAttributes.SignalMask = (*Attributes)->SignalMask;
+            REMOVE_SIGNAL(SpawnAttributes.SignalMask, SIGNAL_PTHREAD);
+            REMOVE_SIGNAL(SpawnAttributes.SignalMask, SIGNAL_SETID);
+        }
+
+        SpawnAttributesPointer = &SpawnAttributes;
+    }
+
+    Pid = -1;
+    Status = OsSpawnProcess(ProcessEnvironment,
+                            Actions,
+                            ActionCount,
+                            SpawnAttributesPointer,
+                            &Pid);
+
+    if (!KSUCCESS(Status)) {
 
         //
-        // If the child had a problem, then with vfork the error variable will
-        // be set, and this routine can return a more detailed status. Reap the
-        // child here.
+        // If the child got far enough to exist, it has already exited. Reap
+        // it so the failure doesn't leave a zombie behind.
         //
 
-        if (Error != 0) {
+        if (Pid > 0) {
             waitpid(Pid, NULL, 0);
+        }
+
+        if (Status == STATUS_UNKNOWN_IMAGE_FORMAT) {
+            Error = ENOEXEC;
 
         } else {
-            if (ChildPid != NULL) {
-                *ChildPid = Pid;
-            }
+            Error = ClConvertKstatusToErrorNumber(Status);
         }
+
+        goto SpawnImageEnd;
+    }
+
+    if (ChildPid != NULL) {
+        *ChildPid = Pid;
+    }
+
+    Error = 0;
+
+SpawnImageEnd:
+    if (Actions != NULL) {
+        free(Actions);
+    }
+
+    if (ProcessEnvironment != NULL) {
+        OsDestroyEnvironment(ProcessEnvironment);
     }
 
     return Error;
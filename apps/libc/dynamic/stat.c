@@ -93,7 +93,8 @@ mode_t ClStatFileTypeConversions[IoObjectTypeCount] = {
     S_IFCHR,
     S_IFCHR,
     S_IFREG,
-    S_IFLNK
+    S_IFLNK,
+    0
 };
 
 //
@@ -1563,7 +1564,7 @@ Return Value:
     // added.
     //
 
-    assert(IoObjectSymbolicLink + 1 == IoObjectTypeCount);
+    assert(IoObjectPollSet + 1 == IoObjectTypeCount);
 
     Stat->st_mode |= ClStatFileTypeConversions[Properties->Type];
 
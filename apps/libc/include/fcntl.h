@@ -333,6 +333,79 @@ extern "C" {
 
 #define AT_REMOVEDIR 0x00000008
 
+//
+// Define the advice values for posix_fadvise.
+//
+
+//
+// The application has no advice to give about its access pattern.
+//
+
+#define POSIX_FADV_NORMAL 0
+
+//
+// The application expects to access the data sequentially, from lower offsets
+// to higher ones.
+//
+
+#define POSIX_FADV_SEQUENTIAL 1
+
+//
+// The application expects to access the data in a random order.
+//
+
+#define POSIX_FADV_RANDOM 2
+
+//
+// The application expects to access the data in the near future.
+//
+
+#define POSIX_FADV_WILLNEED 3
+
+//
+// The application does not expect to access the data in the near future.
+//
+
+#define POSIX_FADV_DONTNEED 4
+
+//
+// The application expects to access the data once and then not reuse it.
+//
+
+#define POSIX_FADV_NOREUSE 5
+
+//
+// Define the flags that can be passed to splice. They are accepted for
+// compatibility, but have no effect on how the data moves.
+//
+
+//
+// Requests that pages be moved rather than copied.
+//
+
+#define SPLICE_F_MOVE 0x00000001
+
+//
+// Requests that the splice not block on the descriptors themselves.
+//
+
+#define SPLICE_F_NONBLOCK 0x00000002
+
+//
+// Indicates that more data will be sent in a subsequent call.
+//
+
+#define SPLICE_F_MORE 0x00000004
+
+//
+// Unused, and only defined for compatibility.
+//
+
+#define SPLICE_F_GIFT 0x00000008
+
+#define SPLICE_F_ALL \
+    (SPLICE_F_MOVE | SPLICE_F_NONBLOCK | SPLICE_F_MORE | SPLICE_F_GIFT)
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -479,6 +552,91 @@ Return Value:
 
 --*/
 
+LIBC_API
+int
+posix_fadvise (
+    int FileDescriptor,
+    off_t Offset,
+    off_t Length,
+    int Advice
+    );
+
+/*++
+
+Routine Description:
+
+    This routine advises the system about how the application expects to
+    access a region of an open file, which may be used to improve
+    performance.
+
+Arguments:
+
+    FileDescriptor - Supplies the file descriptor the advice applies to.
+
+    Offset - Supplies the offset of the start of the region.
+
+    Length - Supplies the length of the region in bytes. Zero means the region
+        extends to the end of the file.
+
+    Advice - Supplies the advice. See POSIX_FADV_* definitions.
+
+Return Value:
+
+    0 on success.
+
+    Returns an error number on failure. The errno variable is not set.
+
+--*/
+
+LIBC_API
+ssize_t
+splice (
+    int InputDescriptor,
+    off_t *InputOffset,
+    int OutputDescriptor,
+    off_t *OutputOffset,
+    size_t Length,
+    unsigned int Flags
+    );
+
+/*++
+
+Routine Description:
+
+    This routine moves data between two file descriptors without copying it
+    through user mode. Unlike some other systems, neither descriptor is
+    required to be a pipe.
+
+Arguments:
+
+    InputDescriptor - Supplies the file descriptor to read from.
+
+    InputOffset - Supplies an optional pointer to the offset to read from. If
+        supplied, this is advanced by the number of bytes moved and the file
+        position of the input descriptor is unchanged. If NULL, the data is
+        read from the current file position, which is advanced.
+
+    OutputDescriptor - Supplies the file descriptor to write to.
+
+    OutputOffset - Supplies an optional pointer to the offset to write to. If
+        supplied, this is advanced by the number of bytes moved. This must be
+        NULL if the output is a socket or pipe.
+
+    Length - Supplies the number of bytes to move.
+
+    Flags - Supplies a bitfield of flags. See SPLICE_F_* definitions.
+
+Return Value:
+
+    Returns the number of bytes moved on success, which may be less than the
+    requested length.
+
+    0 if the input is at the end of the file.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
 #ifdef __cplusplus
 
 }
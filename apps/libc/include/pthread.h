@@ -108,6 +108,27 @@ extern "C" {
 
 #define PTHREAD_MUTEX_DEFAULT PTHREAD_MUTEX_NORMAL
 
+//
+// This mutex protocol value indicates that owning a mutex does not affect the
+// priority of the owning thread.
+//
+
+#define PTHREAD_PRIO_NONE 0
+
+//
+// This mutex protocol value indicates that a thread owning a mutex runs with
+// the priority of the highest priority thread blocked on it.
+//
+
+#define PTHREAD_PRIO_INHERIT 1
+
+//
+// This mutex protocol value indicates that a thread owning a mutex runs at
+// the priority ceiling of the mutex. This protocol is not supported.
+//
+
+#define PTHREAD_PRIO_PROTECT 2
+
 //
 // This value indicates an object such as a mutex is private to the process.
 //
@@ -669,6 +690,64 @@ Return Value:
 
 --*/
 
+PTHREAD_API
+int
+pthread_mutexattr_getprotocol (
+    const pthread_mutexattr_t *Attribute,
+    int *Protocol
+    );
+
+/*++
+
+Routine Description:
+
+    This routine returns the mutex protocol given an attribute that was
+    previously set.
+
+Arguments:
+
+    Attribute - Supplies a pointer to the attribute to get the protocol from.
+
+    Protocol - Supplies a pointer where the protocol will be returned on
+        success. See PTHREAD_PRIO_* definitions.
+
+Return Value:
+
+    0 on success.
+
+    Returns an error number on failure.
+
+--*/
+
+PTHREAD_API
+int
+pthread_mutexattr_setprotocol (
+    pthread_mutexattr_t *Attribute,
+    int Protocol
+    );
+
+/*++
+
+Routine Description:
+
+    This routine sets the mutex protocol in the given mutex attributes object.
+
+Arguments:
+
+    Attribute - Supplies a pointer to the attribute to set the protocol in.
+
+    Protocol - Supplies the protocol to set. See PTHREAD_PRIO_* definitions.
+
+Return Value:
+
+    0 on success.
+
+    ENOTSUP if the protocol is not supported.
+
+    EINVAL if the protocol is not valid.
+
+--*/
+
 PTHREAD_API
 int
 pthread_cond_init (
@@ -1799,6 +1878,75 @@ Return Value:
 
 --*/
 
+PTHREAD_API
+int
+pthread_getaffinity_np (
+    pthread_t ThreadId,
+    size_t SetSize,
+    cpu_set_t *Set
+    );
+
+/*++
+
+Routine Description:
+
+    This routine returns the set of processors the given thread is allowed to
+    run on.
+
+Arguments:
+
+    ThreadId - Supplies the thread to query.
+
+    SetSize - Supplies the size of the CPU set buffer in bytes.
+
+    Set - Supplies a pointer where the thread's processor affinity will be
+        returned.
+
+Return Value:
+
+    0 on success.
+
+    Returns an error number on failure.
+
+--*/
+
+PTHREAD_API
+int
+pthread_setaffinity_np (
+    pthread_t ThreadId,
+    size_t SetSize,
+    const cpu_set_t *Set
+    );
+
+/*++
+
+Routine Description:
+
+    This routine sets the set of processors the given thread is allowed to
+    run on. If the thread is currently running on a processor not in the set,
+    it is moved.
+
+Arguments:
+
+    ThreadId - Supplies the thread to modify.
+
+    SetSize - Supplies the size of the CPU set buffer in bytes.
+
+    Set - Supplies a pointer to the new set of allowed processors. At least
+        one online processor must be in the set.
+
+Return Value:
+
+    0 on success.
+
+    EINVAL if the set contains no online processors.
+
+    ESRCH if the thread has exited.
+
+    Returns an error number on other failures.
+
+--*/
+
 PTHREAD_API
 void
 __pthread_cleanup_push (
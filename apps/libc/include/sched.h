@@ -41,6 +41,98 @@ extern "C" {
 
 #endif
 
+//
+// Define scheduling policies. Only the default time-sharing policy is
+// supported. Its priority is the negative of the nice value, so that larger
+// priorities are more favorable.
+//
+
+#define SCHED_OTHER 0
+#define SCHED_FIFO 1
+#define SCHED_RR 2
+
+//
+// Define the portable name of the scheduling priority member.
+//
+
+#define sched_priority __sched_priority
+
+//
+// Define the number of processors a CPU set can describe.
+//
+
+#define CPU_SETSIZE 1024
+
+//
+// Define the number of bits in each word of a CPU set.
+//
+
+#define __CPU_BITS (8 * sizeof(unsigned long))
+
+//
+// This macro clears all processors from the given CPU set.
+//
+
+#define CPU_ZERO(_Set) CPU_ZERO_S(sizeof(cpu_set_t), (_Set))
+
+//
+// This macro adds the given processor to the CPU set.
+//
+
+#define CPU_SET(_Cpu, _Set) CPU_SET_S((_Cpu), sizeof(cpu_set_t), (_Set))
+
+//
+// This macro removes the given processor from the CPU set.
+//
+
+#define CPU_CLR(_Cpu, _Set) CPU_CLR_S((_Cpu), sizeof(cpu_set_t), (_Set))
+
+//
+// This macro evaluates to non-zero if the given processor is in the CPU set.
+//
+
+#define CPU_ISSET(_Cpu, _Set) CPU_ISSET_S((_Cpu), sizeof(cpu_set_t), (_Set))
+
+//
+// This macro returns the number of processors in the CPU set.
+//
+
+#define CPU_COUNT(_Set) CPU_COUNT_S(sizeof(cpu_set_t), (_Set))
+
+//
+// These macros operate on CPU sets of a given size in bytes.
+//
+
+#define CPU_ZERO_S(_Size, _Set)                                             \
+    do {                                                                    \
+        size_t __Index;                                                     \
+                                                                            \
+        for (__Index = 0;                                                   \
+             __Index < (_Size) / sizeof(unsigned long);                     \
+             __Index += 1) {                                                \
+                                                                            \
+            (_Set)->__bits[__Index] = 0;                                    \
+        }                                                                   \
+                                                                            \
+    } while (0)
+
+#define CPU_SET_S(_Cpu, _Size, _Set)                                        \
+    (((size_t)(_Cpu) < 8 * (_Size)) ?                                       \
+     ((_Set)->__bits[(_Cpu) / __CPU_BITS] |=                                \
+      (1UL << ((_Cpu) % __CPU_BITS))) : 0)
+
+#define CPU_CLR_S(_Cpu, _Size, _Set)                                        \
+    (((size_t)(_Cpu) < 8 * (_Size)) ?                                       \
+     ((_Set)->__bits[(_Cpu) / __CPU_BITS] &=                                \
+      ~(1UL << ((_Cpu) % __CPU_BITS))) : 0)
+
+#define CPU_ISSET_S(_Cpu, _Size, _Set)                                      \
+    (((size_t)(_Cpu) < 8 * (_Size)) ?                                       \
+     (((_Set)->__bits[(_Cpu) / __CPU_BITS] &                                \
+       (1UL << ((_Cpu) % __CPU_BITS))) != 0) : 0)
+
+#define CPU_COUNT_S(_Size, _Set) __sched_cpucount((_Size), (_Set))
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -62,6 +154,24 @@ struct sched_param {
     int __sched_priority;
 };
 
+/*++
+
+Structure Description:
+
+    This structure stores a set of processors, used to describe which
+    processors a thread is allowed to run on. Bit N of the set (bit N % 8 of
+    byte N / 8) represents processor N.
+
+Members:
+
+    __bits - Stores the processor bitmap.
+
+--*/
+
+typedef struct {
+    unsigned long __bits[CPU_SETSIZE / __CPU_BITS];
+} cpu_set_t;
+
 //
 // -------------------------------------------------------------------- Globals
 //
@@ -94,6 +204,261 @@ Return Value:
 
 --*/
 
+LIBC_API
+int
+sched_get_priority_min (
+    int Policy
+    );
+
+/*++
+
+Routine Description:
+
+    This routine returns the minimum scheduling priority for the given policy.
+
+Arguments:
+
+    Policy - Supplies the scheduling policy. See SCHED_* definitions.
+
+Return Value:
+
+    Returns the minimum priority value on success.
+
+    -1 on error, and the errno variable will contain more information.
+
+--*/
+
+LIBC_API
+int
+sched_get_priority_max (
+    int Policy
+    );
+
+/*++
+
+Routine Description:
+
+    This routine returns the maximum scheduling priority for the given policy.
+
+Arguments:
+
+    Policy - Supplies the scheduling policy. See SCHED_* definitions.
+
+Return Value:
+
+    Returns the maximum priority value on success.
+
+    -1 on error, and the errno variable will contain more information.
+
+--*/
+
+LIBC_API
+int
+sched_getparam (
+    pid_t ProcessId,
+    struct sched_param *Parameters
+    );
+
+/*++
+
+Routine Description:
+
+    This routine gets the scheduling parameters of the given process.
+
+Arguments:
+
+    ProcessId - Supplies the ID of the process to query. Supply zero to query
+        the current process.
+
+    Parameters - Supplies a pointer where the scheduling parameters will be
+        returned.
+
+Return Value:
+
+    0 on success.
+
+    -1 on error, and the errno variable will contain more information.
+
+--*/
+
+LIBC_API
+int
+sched_setparam (
+    pid_t ProcessId,
+    const struct sched_param *Parameters
+    );
+
+/*++
+
+Routine Description:
+
+    This routine sets the scheduling parameters of the given process.
+
+Arguments:
+
+    ProcessId - Supplies the ID of the process to modify. Supply zero to
+        modify the current process.
+
+    Parameters - Supplies a pointer to the new scheduling parameters.
+
+Return Value:
+
+    0 on success.
+
+    -1 on error, and the errno variable will contain more information.
+
+--*/
+
+LIBC_API
+int
+sched_getscheduler (
+    pid_t ProcessId
+    );
+
+/*++
+
+Routine Description:
+
+    This routine returns the scheduling policy of the given process.
+
+Arguments:
+
+    ProcessId - Supplies the ID of the process to query. Supply zero to query
+        the current process.
+
+Return Value:
+
+    Returns the scheduling policy on success. See SCHED_* definitions.
+
+    -1 on error, and the errno variable will contain more information.
+
+--*/
+
+LIBC_API
+int
+sched_setscheduler (
+    pid_t ProcessId,
+    int Policy,
+    const struct sched_param *Parameters
+    );
+
+/*++
+
+Routine Description:
+
+    This routine sets the scheduling policy and parameters of the given
+    process.
+
+Arguments:
+
+    ProcessId - Supplies the ID of the process to modify. Supply zero to
+        modify the current process.
+
+    Policy - Supplies the new scheduling policy. Only SCHED_OTHER is
+        supported.
+
+    Parameters - Supplies a pointer to the new scheduling parameters.
+
+Return Value:
+
+    Returns the previous scheduling policy on success.
+
+    -1 on error, and the errno variable will contain more information.
+
+--*/
+
+LIBC_API
+int
+sched_getaffinity (
+    pid_t ProcessId,
+    size_t SetSize,
+    cpu_set_t *Set
+    );
+
+/*++
+
+Routine Description:
+
+    This routine returns the set of processors the threads of the given
+    process are allowed to run on.
+
+Arguments:
+
+    ProcessId - Supplies the ID of the process to query. Supply zero to query
+        the current process.
+
+    SetSize - Supplies the size of the CPU set buffer in bytes.
+
+    Set - Supplies a pointer where the union of the processor affinities of
+        all threads in the process will be returned.
+
+Return Value:
+
+    0 on success.
+
+    -1 on error, and the errno variable will contain more information.
+
+--*/
+
+LIBC_API
+int
+sched_setaffinity (
+    pid_t ProcessId,
+    size_t SetSize,
+    const cpu_set_t *Set
+    );
+
+/*++
+
+Routine Description:
+
+    This routine sets the set of processors all threads in the given process
+    are allowed to run on.
+
+Arguments:
+
+    ProcessId - Supplies the ID of the process to modify. Supply zero to
+        modify the current process.
+
+    SetSize - Supplies the size of the CPU set buffer in bytes.
+
+    Set - Supplies a pointer to the new set of allowed processors. At least
+        one online processor must be in the set.
+
+Return Value:
+
+    0 on success.
+
+    -1 on error, and the errno variable will contain more information.
+
+--*/
+
+LIBC_API
+int
+__sched_cpucount (
+    size_t SetSize,
+    const cpu_set_t *Set
+    );
+
+/*++
+
+Routine Description:
+
+    This routine counts the number of processors in the given CPU set. Use
+    the CPU_COUNT macro rather than calling this routine directly.
+
+Arguments:
+
+    SetSize - Supplies the size of the CPU set buffer in bytes.
+
+    Set - Supplies a pointer to the CPU set.
+
+Return Value:
+
+    Returns the number of processors in the set.
+
+--*/
+
 #ifdef __cplusplus
 
 }
@@ -0,0 +1,318 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    epoll.h
+
+Abstract:
+
+    This header contains definitions for the scalable I/O event notification
+    interface.
+
+Author:
+
+    agent 16-Oct-2026
+
+--*/
+
+#ifndef _SYS_EPOLL_H
+#define _SYS_EPOLL_H
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <libcbase.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+#ifdef __cplusplus
+
+extern "C" {
+
+#endif
+
+//
+// Define the flags that can be passed to epoll_create1.
+//
+
+#define EPOLL_CLOEXEC O_CLOEXEC
+
+//
+// Define the operations that can be passed to epoll_ctl.
+//
+
+#define EPOLL_CTL_ADD 1
+#define EPOLL_CTL_MOD 2
+#define EPOLL_CTL_DEL 3
+
+//
+// Define the event bits. These have the same values as the poll events.
+//
+
+#define EPOLLIN 0x0001
+#define EPOLLRDNORM EPOLLIN
+#define EPOLLPRI 0x0002
+#define EPOLLRDBAND EPOLLPRI
+#define EPOLLOUT 0x0004
+#define EPOLLWRNORM EPOLLOUT
+#define EPOLLWRBAND 0x0008
+
+//
+// These events are always reported, whether or not they were requested.
+//
+
+#define EPOLLERR 0x0010
+#define EPOLLHUP 0x0020
+
+//
+// Set this flag to only report a descriptor when new events arrive on it,
+// rather than for as long as the events remain set.
+//
+
+#define EPOLLET (1U << 31)
+
+//
+// Set this flag to disable a descriptor after it has been reported once. It
+// can be re-armed with EPOLL_CTL_MOD.
+//
+
+#define EPOLLONESHOT (1U << 30)
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+/*++
+
+Structure Description:
+
+    This union defines the user data associated with an epoll descriptor.
+
+Members:
+
+    ptr - Stores a pointer value.
+
+    fd - Stores a file descriptor value.
+
+    u32 - Stores a 32-bit value.
+
+    u64 - Stores a 64-bit value.
+
+--*/
+
+typedef union epoll_data {
+    void *ptr;
+    int fd;
+    uint32_t u32;
+    uint64_t u64;
+} epoll_data_t;
+
+/*++
+
+Structure Description:
+
+    This structure defines an epoll event.
+
+Members:
+
+    events - Stores the mask of events. See EPOLL* definitions.
+
+    data - Stores the user data returned when the descriptor is reported.
+
+--*/
+
+struct epoll_event {
+    uint32_t events;
+    epoll_data_t data;
+};
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// -------------------------------------------------------- Function Prototypes
+//
+
+LIBC_API
+int
+epoll_create (
+    int Size
+    );
+
+/*++
+
+Routine Description:
+
+    This routine creates an epoll instance.
+
+Arguments:
+
+    Size - Supplies a hint of the number of descriptors that will be added.
+        This is ignored, but must be greater than zero.
+
+Return Value:
+
+    Returns a file descriptor for the new epoll instance on success.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
+LIBC_API
+int
+epoll_create1 (
+    int Flags
+    );
+
+/*++
+
+Routine Description:
+
+    This routine creates an epoll instance.
+
+Arguments:
+
+    Flags - Supplies a bitfield of flags. The only valid flag is
+        EPOLL_CLOEXEC.
+
+Return Value:
+
+    Returns a file descriptor for the new epoll instance on success.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
+LIBC_API
+int
+epoll_ctl (
+    int EpollDescriptor,
+    int Operation,
+    int Descriptor,
+    struct epoll_event *Event
+    );
+
+/*++
+
+Routine Description:
+
+    This routine adds, modifies, or removes a descriptor in an epoll instance.
+
+Arguments:
+
+    EpollDescriptor - Supplies the epoll instance file descriptor.
+
+    Operation - Supplies the operation to perform. See EPOLL_CTL_*
+        definitions.
+
+    Descriptor - Supplies the file descriptor to operate on.
+
+    Event - Supplies a pointer to the events to watch for and the data to
+        return. This is ignored for EPOLL_CTL_DEL.
+
+Return Value:
+
+    0 on success.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
+LIBC_API
+int
+epoll_wait (
+    int EpollDescriptor,
+    struct epoll_event *Events,
+    int EventCount,
+    int Timeout
+    );
+
+/*++
+
+Routine Description:
+
+    This routine waits for descriptors in an epoll instance to become ready.
+
+Arguments:
+
+    EpollDescriptor - Supplies the epoll instance file descriptor.
+
+    Events - Supplies a pointer to an array where the ready events will be
+        returned.
+
+    EventCount - Supplies the number of elements in the events array.
+
+    Timeout - Supplies the amount of time in milliseconds to block before
+        giving up. Supply 0 to not block at all, and supply -1 to wait for an
+        indefinite amount of time.
+
+Return Value:
+
+    Returns the number of events returned, which is 0 on timeout.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
+LIBC_API
+int
+epoll_pwait (
+    int EpollDescriptor,
+    struct epoll_event *Events,
+    int EventCount,
+    int Timeout,
+    const sigset_t *SignalMask
+    );
+
+/*++
+
+Routine Description:
+
+    This routine waits for descriptors in an epoll instance to become ready,
+    atomically setting the signal mask for the duration of the wait.
+
+Arguments:
+
+    EpollDescriptor - Supplies the epoll instance file descriptor.
+
+    Events - Supplies a pointer to an array where the ready events will be
+        returned.
+
+    EventCount - Supplies the number of elements in the events array.
+
+    Timeout - Supplies the amount of time in milliseconds to block before
+        giving up. Supply 0 to not block at all, and supply -1 to wait for an
+        indefinite amount of time.
+
+    SignalMask - Supplies an optional pointer to a signal mask to set for the
+        duration of the wait.
+
+Return Value:
+
+    Returns the number of events returned, which is 0 on timeout.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
+#ifdef __cplusplus
+
+}
+
+#endif
+#endif
+
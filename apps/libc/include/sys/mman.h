@@ -126,6 +126,62 @@ extern "C" {
 
 #define MS_INVALIDATE 0x0004
 
+//
+// Define the advice values for madvise and posix_madvise. Dropping pages
+// with MADV_DONTNEED is not supported.
+//
+
+//
+// The application has no advice to give about its access pattern.
+//
+
+#define MADV_NORMAL 0
+#define POSIX_MADV_NORMAL MADV_NORMAL
+
+//
+// The application expects to access the region sequentially, from lower
+// addresses to higher ones.
+//
+
+#define MADV_SEQUENTIAL 1
+#define POSIX_MADV_SEQUENTIAL MADV_SEQUENTIAL
+
+//
+// The application expects to access the region in a random order.
+//
+
+#define MADV_RANDOM 2
+#define POSIX_MADV_RANDOM MADV_RANDOM
+
+//
+// The application expects to access the region in the near future.
+//
+
+#define MADV_WILLNEED 3
+#define POSIX_MADV_WILLNEED MADV_WILLNEED
+
+//
+// The application does not expect to access the region in the near future.
+// This is only accepted by posix_madvise, where it has no effect.
+//
+
+#define POSIX_MADV_DONTNEED 4
+
+//
+// The application expects to touch most of the anonymous region, so a page
+// fault should populate the whole aligned 2MB block around the faulting
+// address at once. This is a Minoca extension only accepted by madvise.
+//
+
+#define MADV_FAULTAROUND 14
+
+//
+// The application would like page faults in the anonymous region to populate
+// one page at a time again. This is only accepted by madvise.
+//
+
+#define MADV_NOFAULTAROUND 15
+
 //
 // Define the value used to indicate a failed mapping.
 //
@@ -283,6 +339,73 @@ Return Value:
 
 --*/
 
+LIBC_API
+int
+madvise (
+    void *Address,
+    size_t Length,
+    int Advice
+    );
+
+/*++
+
+Routine Description:
+
+    This routine advises the system about how the application expects to
+    access a region of its address space. For regions mapped from a file,
+    this steers how far ahead of page faults the file is read. For anonymous
+    regions, fault around advice controls whether a fault populates the whole
+    aligned block around it at once.
+
+Arguments:
+
+    Address - Supplies the start of the region. This must be aligned to a page
+        boundary.
+
+    Length - Supplies the size of the region in bytes.
+
+    Advice - Supplies the advice. See MADV_* definitions.
+
+Return Value:
+
+    0 on success.
+
+    -1 on failure. The errno variable will be set to indicate the error.
+
+--*/
+
+LIBC_API
+int
+posix_madvise (
+    void *Address,
+    size_t Length,
+    int Advice
+    );
+
+/*++
+
+Routine Description:
+
+    This routine advises the system about how the application expects to
+    access a region of its address space.
+
+Arguments:
+
+    Address - Supplies the start of the region. This must be aligned to a page
+        boundary.
+
+    Length - Supplies the size of the region in bytes.
+
+    Advice - Supplies the advice. See POSIX_MADV_* definitions.
+
+Return Value:
+
+    0 on success.
+
+    Returns an error number on failure. The errno variable is not set.
+
+--*/
+
 LIBC_API
 int
 shm_open (
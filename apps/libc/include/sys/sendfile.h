@@ -0,0 +1,105 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    sendfile.h
+
+Abstract:
+
+    This header contains definitions for transferring file data directly to
+    another file descriptor.
+
+Author:
+
+    agent 16-Oct-2026
+
+--*/
+
+#ifndef _SYS_SENDFILE_H
+#define _SYS_SENDFILE_H
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <libcbase.h>
+#include <sys/types.h>
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+#ifdef __cplusplus
+
+extern "C" {
+
+#endif
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// -------------------------------------------------------- Function Prototypes
+//
+
+LIBC_API
+ssize_t
+sendfile (
+    int OutputDescriptor,
+    int InputDescriptor,
+    off_t *Offset,
+    size_t Count
+    );
+
+/*++
+
+Routine Description:
+
+    This routine copies data from one file descriptor to another within the
+    kernel. When the input is a regular file and the output is a socket, the
+    file's cached pages are handed to the network stack without being copied.
+
+Arguments:
+
+    OutputDescriptor - Supplies the file descriptor to write to.
+
+    InputDescriptor - Supplies the file descriptor to read from.
+
+    Offset - Supplies an optional pointer to the offset in the input file to
+        start reading from. If supplied, this is advanced by the number of
+        bytes transferred and the file position of the input descriptor is
+        unchanged. If NULL, the data is read from the current file position,
+        which is advanced.
+
+    Count - Supplies the number of bytes to transfer.
+
+Return Value:
+
+    Returns the number of bytes written to the output descriptor, which may be
+    less than the requested count.
+
+    0 if the input is at the end of the file.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
+#ifdef __cplusplus
+
+}
+
+#endif
+#endif
+
@@ -789,6 +789,66 @@ Return Value:
     return OspSystemCallFull(SystemCallExecuteImage, Parameters);
 }
 
+OS_API
+KSTATUS
+OsSpawnProcess (
+    PPROCESS_ENVIRONMENT Environment,
+    PSPAWN_FILE_ACTION FileActions,
+    ULONG FileActionCount,
+    PSPAWN_ATTRIBUTES Attributes,
+    PPROCESS_ID NewProcessId
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates a new child process running the given image. This is
+    equivalent to a fork followed by an exec in the child, except that the
+    caller's address space is never copied. The call returns once the child
+    is running its new image or has failed to start it.
+
+Arguments:
+
+    Environment - Supplies a pointer to the environment of the new process,
+        which includes the image name, parameters, and environment variables.
+
+    FileActions - Supplies an optional pointer to an array of file actions to
+        perform in the child before the image is loaded.
+
+    FileActionCount - Supplies the number of elements in the file actions
+        array.
+
+    Attributes - Supplies an optional pointer to the attributes to apply to
+        the child before the image is loaded.
+
+    NewProcessId - Supplies a pointer where the ID of the child process will
+        be returned. If the child was created but failed to start the image,
+        this is still returned and a failure status is returned. In that case
+        the child exits with status 127 and must be reaped by the caller. This
+        is -1 if no child was created.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    SYSTEM_CALL_SPAWN_PROCESS Parameters;
+    KSTATUS Status;
+
+    Parameters.Environment = Environment;
+    Parameters.FileActions = FileActions;
+    Parameters.FileActionCount = FileActionCount;
+    Parameters.Attributes = Attributes;
+    Parameters.ProcessId = -1;
+    Status = OsSystemCall(SystemCallSpawnProcess, &Parameters);
+    *NewProcessId = Parameters.ProcessId;
+    return Status;
+}
+
 OS_API
 KSTATUS
 OsGetSystemVersion (
@@ -1154,6 +1214,252 @@ Return Value:
     return STATUS_SUCCESS;
 }
 
+OS_API
+KSTATUS
+OsCreatePollSet (
+    ULONG OpenFlags,
+    PHANDLE Handle
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates a poll set, a persistent collection of I/O handles
+    that can be waited on together.
+
+Arguments:
+
+    OpenFlags - Supplies an optional bitfield of open flags for the new
+        handle. Only SYS_OPEN_FLAG_CLOSE_ON_EXECUTE is accepted.
+
+    Handle - Supplies a pointer where the handle to the new poll set will be
+        returned on success.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    SYSTEM_CALL_CREATE_POLL_SET Parameters;
+    KSTATUS Status;
+
+    Parameters.OpenFlags = OpenFlags;
+    Status = OsSystemCall(SystemCallCreatePollSet, &Parameters);
+    *Handle = Parameters.Handle;
+    return Status;
+}
+
+OS_API
+KSTATUS
+OsControlPollSet (
+    HANDLE PollSet,
+    POLL_SET_OPERATION Operation,
+    HANDLE Descriptor,
+    PPOLL_SET_EVENT Event
+    )
+
+/*++
+
+Routine Description:
+
+    This routine adds, modifies, or removes an I/O handle in a poll set.
+
+Arguments:
+
+    PollSet - Supplies the handle to the poll set.
+
+    Operation - Supplies the operation to perform.
+
+    Descriptor - Supplies the I/O handle to add, modify, or remove.
+
+    Event - Supplies an optional pointer to the events to watch for and the
+        data to return when they occur. This is required for add and modify
+        operations.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_FILE_EXISTS if the handle being added is already in the poll set.
+
+    STATUS_NOT_FOUND if the handle being modified or removed is not in the
+    poll set.
+
+    Other error codes on failure.
+
+--*/
+
+{
+
+    SYSTEM_CALL_CONTROL_POLL_SET Parameters;
+
+    Parameters.PollSet = PollSet;
+    Parameters.Operation = Operation;
+    Parameters.Descriptor = Descriptor;
+    if (Event != NULL) {
+        Parameters.Event = *Event;
+
+    } else {
+        if (Operation != PollSetOperationDelete) {
+            return STATUS_INVALID_PARAMETER;
+        }
+
+        Parameters.Event.Events = 0;
+        Parameters.Event.Data = 0;
+    }
+
+    return OsSystemCall(SystemCallControlPollSet, &Parameters);
+}
+
+OS_API
+KSTATUS
+OsWaitForPollSet (
+    HANDLE PollSet,
+    PSIGNAL_SET SignalMask,
+    PPOLL_SET_EVENT Events,
+    ULONG EventCount,
+    ULONG TimeoutInMilliseconds,
+    PULONG EventsReturned
+    )
+
+/*++
+
+Routine Description:
+
+    This routine waits for one or more handles in a poll set to become ready.
+
+Arguments:
+
+    PollSet - Supplies the handle to the poll set.
+
+    SignalMask - Supplies an optional pointer to a mask to set for the
+        duration of the wait.
+
+    Events - Supplies a pointer to an array where the events of the ready
+        handles will be returned.
+
+    EventCount - Supplies the number of elements in the events array.
+
+    TimeoutInMilliseconds - Supplies the number of milliseconds to wait before
+        giving up.
+
+    EventsReturned - Supplies a pointer where the number of events returned
+        will be stored on success.
+
+Return Value:
+
+    STATUS_SUCCESS if one or more handles is ready.
+
+    STATUS_INTERRUPTED if a signal was caught during the wait.
+
+    STATUS_TIMEOUT if no handles were ready in the given amount of time.
+
+    STATUS_INVALID_PARAMETER if the event count is zero or larger than
+    MAX_LONG.
+
+--*/
+
+{
+
+    SYSTEM_CALL_WAIT_FOR_POLL_SET Parameters;
+    INTN Result;
+
+    *EventsReturned = 0;
+    if ((EventCount == 0) || (EventCount > (ULONG)MAX_LONG)) {
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    Parameters.PollSet = PollSet;
+    Parameters.SignalMask = SignalMask;
+    Parameters.Events = Events;
+    Parameters.EventCount = (LONG)EventCount;
+    Parameters.TimeoutInMilliseconds = TimeoutInMilliseconds;
+    Result = OsSystemCall(SystemCallWaitForPollSet, &Parameters);
+    if (Result < 0) {
+        return Result;
+    }
+
+    *EventsReturned = (ULONG)Result;
+    return STATUS_SUCCESS;
+}
+
+OS_API
+KSTATUS
+OsSendFile (
+    HANDLE Destination,
+    HANDLE Source,
+    IO_OFFSET SourceOffset,
+    IO_OFFSET DestinationOffset,
+    UINTN Size,
+    PUINTN BytesCompleted
+    )
+
+/*++
+
+Routine Description:
+
+    This routine transfers data from one open handle to another without
+    copying it through user mode. When a cached file is sent to a socket, the
+    file's pages are handed to the network stack directly.
+
+Arguments:
+
+    Destination - Supplies the handle to write the data to.
+
+    Source - Supplies the handle to read the data from.
+
+    SourceOffset - Supplies the offset in the source to start reading from.
+        Supply IO_OFFSET_NONE to read from and advance the source's current
+        file position.
+
+    DestinationOffset - Supplies the offset in the destination to start
+        writing to. Supply IO_OFFSET_NONE to use the destination's current
+        file position. This must be IO_OFFSET_NONE for sockets.
+
+    Size - Supplies the number of bytes to transfer.
+
+    BytesCompleted - Supplies a pointer where the number of bytes transferred
+        will be returned.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    SYSTEM_CALL_SEND_FILE Parameters;
+    INTN Result;
+
+    //
+    // Truncate the size so that the bytes completed can be returned via a
+    // register.
+    //
+
+    if (Size > (UINTN)MAX_INTN) {
+        Size = (UINTN)MAX_INTN;
+    }
+
+    Parameters.Destination = Destination;
+    Parameters.Source = Source;
+    Parameters.SourceOffset = SourceOffset;
+    Parameters.DestinationOffset = DestinationOffset;
+    Parameters.Size = (INTN)Size;
+    Result = OsSystemCall(SystemCallSendFile, &Parameters);
+    if (Result < 0) {
+        *BytesCompleted = 0;
+        return Result;
+    }
+
+    *BytesCompleted = (UINTN)Result;
+    return STATUS_SUCCESS;
+}
+
 OS_API
 PSIGNAL_HANDLER_ROUTINE
 OsSetSignalHandler (
@@ -2882,6 +3188,46 @@ Return Value:
     return OsSystemCall(SystemCallSetMemoryProtection, &Parameters);
 }
 
+OS_API
+KSTATUS
+OsSetMemoryAdvice (
+    PVOID Address,
+    UINTN Size,
+    IO_ADVICE Advice
+    )
+
+/*++
+
+Routine Description:
+
+    This routine tells the kernel how the given region of memory is expected
+    to be accessed.
+
+Arguments:
+
+    Address - Supplies the starting address of the region. This must be
+        aligned to a page boundary.
+
+    Size - Supplies the length, in bytes, of the region.
+
+    Advice - Supplies the expected access pattern.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    SYSTEM_CALL_SET_MEMORY_ADVICE Parameters;
+
+    Parameters.Address = Address;
+    Parameters.Size = Size;
+    Parameters.Advice = Advice;
+    return OsSystemCall(SystemCallSetMemoryAdvice, &Parameters);
+}
+
 OS_API
 KSTATUS
 OsMemoryFlush (
@@ -3144,6 +3490,132 @@ Return Value:
     return Status;
 }
 
+OS_API
+KSTATUS
+OsSetPriority (
+    PRIORITY_TARGET_TYPE TargetType,
+    LONG TargetId,
+    PLONG NewValue,
+    PLONG OldValue
+    )
+
+/*++
+
+Routine Description:
+
+    This routine gets or sets the scheduling nice value of a thread, process,
+    process group, or all processes belonging to a user.
+
+Arguments:
+
+    TargetType - Supplies the type of entity the identifier refers to.
+
+    TargetId - Supplies the thread, process, process group, or user ID. Supply
+        -1 to target the calling thread, process, process group, or user.
+
+    NewValue - Supplies an optional pointer to the new nice value to set. If
+        this is NULL, then a new value is not set.
+
+    OldValue - Supplies an optional pointer where the lowest nice value among
+        the matching threads will be returned.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_NO_SUCH_PROCESS if no matching process was found.
+
+    STATUS_PERMISSION_DENIED if the caller is trying to lower the nice value
+    or change another user's process and does not have the scheduling
+    permission.
+
+--*/
+
+{
+
+    SYSTEM_CALL_SET_PRIORITY Parameters;
+    KSTATUS Status;
+
+    Parameters.TargetType = TargetType;
+    Parameters.TargetId = TargetId;
+    Parameters.NiceValue = 0;
+    if (NewValue != NULL) {
+        Parameters.Set = TRUE;
+        Parameters.NiceValue = *NewValue;
+
+    } else {
+        Parameters.Set = FALSE;
+    }
+
+    Status = OsSystemCall(SystemCallSetPriority, &Parameters);
+    if (OldValue != NULL) {
+        *OldValue = Parameters.NiceValue;
+    }
+
+    return Status;
+}
+
+OS_API
+KSTATUS
+OsSetAffinity (
+    PRIORITY_TARGET_TYPE TargetType,
+    LONG TargetId,
+    BOOL Set,
+    PVOID Mask,
+    UINTN MaskSize
+    )
+
+/*++
+
+Routine Description:
+
+    This routine gets or sets the set of processors a thread, or all threads
+    of a process, are allowed to run on.
+
+Arguments:
+
+    TargetType - Supplies the type of entity the identifier refers to. Only
+        thread and process targets are supported.
+
+    TargetId - Supplies the thread or process ID. Supply -1 to target the
+        calling thread or process.
+
+    Set - Supplies a boolean indicating whether to set the affinity (TRUE) or
+        get it (FALSE).
+
+    Mask - Supplies a pointer to the processor bitmap, where bit N % 8 of byte
+        N / 8 represents processor N. On set operations this contains the new
+        mask. On get operations this receives the current mask.
+
+    MaskSize - Supplies the size of the mask buffer in bytes.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_INVALID_PARAMETER if the new mask does not contain any active
+    processors, or the target type is not supported.
+
+    STATUS_NO_SUCH_THREAD or STATUS_NO_SUCH_PROCESS if the target was not
+    found.
+
+    STATUS_PERMISSION_DENIED if the caller is trying to change another user's
+    process and does not have the scheduling permission.
+
+--*/
+
+{
+
+    SYSTEM_CALL_SET_AFFINITY Parameters;
+
+    Parameters.TargetType = TargetType;
+    Parameters.TargetId = TargetId;
+    Parameters.Set = Set;
+    Parameters.Mask = Mask;
+    Parameters.MaskSize = MaskSize;
+    return OsSystemCall(SystemCallSetAffinity, &Parameters);
+}
+
 OS_API
 KSTATUS
 OsCreateTerminal (
@@ -265,11 +265,21 @@ Routine Description:
         UserLockWake - Wakes the number of threads given in the value that are
         blocked on the given address.
 
+        UserLockPiLock - Acquires a priority inheritance lock. The address
+        contains the kernel thread ID of the owner (or zero if the lock is
+        free), plus USER_LOCK_PI_WAITERS if there are threads blocked on it.
+        The owner runs with the priority of the best waiter until it
+        releases the lock.
+
+        UserLockPiUnlock - Releases a priority inheritance lock held by the
+        current thread, handing it directly to the first waiter.
+
     Value - Supplies a pointer whose value depends on the operation. For wait
         operations, this contains the value to check the address against. This
         is not used on output for wait operations. For wake operations, this
         contains the number of processes to wake on input. On output, contains
-        the number of processes woken.
+        the number of processes woken. This is not used for priority
+        inheritance operations.
 
     TimeoutInMilliseconds - Supplies the number of milliseconds for a wait
         operation to complete before timing out. Set to
@@ -288,6 +298,12 @@ Return Value:
     STATUS_INTERRUPTED if a signal arrived before a wait was completed or timed
     out.
 
+    STATUS_DEADLOCK if the current thread already owns the priority
+    inheritance lock it is trying to acquire.
+
+    STATUS_PERMISSION_DENIED if the current thread does not own the priority
+    inheritance lock it is trying to release.
+
 --*/
 
 {
@@ -299,8 +315,146 @@ Return Value:
     Parameters.Value = *Value;
     Parameters.Operation = Operation;
     Parameters.TimeoutInMilliseconds = TimeoutInMilliseconds;
+    Parameters.SecondAddress = NULL;
+    Parameters.SecondValue = 0;
+    Parameters.Argument = 0;
+    Status = OsSystemCall(SystemCallUserLock, &Parameters);
+    *Value = Parameters.Value;
+    return Status;
+}
+
+OS_API
+KSTATUS
+OsUserLockRequeue (
+    PVOID Address,
+    ULONG Operation,
+    PULONG Value,
+    PVOID SecondAddress,
+    PULONG SecondValue,
+    ULONG Argument
+    )
+
+/*++
+
+Routine Description:
+
+    This routine wakes some of the threads blocked on one user lock and moves
+    the rest over to wait on a second user lock without waking them. This is
+    used to hand the waiters of a condition variable to its mutex one at a
+    time.
+
+Arguments:
+
+    Address - Supplies a pointer to the 32-bit lock whose waiters are woken
+        or moved.
+
+    Operation - Supplies the flags for the operation. The only valid flag is
+        USER_LOCK_PRIVATE, which applies to both addresses.
+
+    Value - Supplies a pointer that on input contains the maximum number of
+        threads to wake. On output, contains the number of threads woken.
+
+    SecondAddress - Supplies a pointer to the 32-bit lock that the remaining
+        waiters are moved to.
+
+    SecondValue - Supplies a pointer that on input contains the maximum number
+        of threads to move. On output, contains the number of threads moved.
+
+    Argument - Supplies the value the first address is expected to contain.
+        The operation fails if it does not.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_TRY_AGAIN if the first address no longer contains the expected
+    value.
+
+    Other error codes on failure.
+
+--*/
+
+{
+
+    SYSTEM_CALL_USER_LOCK Parameters;
+    KSTATUS Status;
+
+    Parameters.Address = Address;
+    Parameters.Value = *Value;
+    Parameters.Operation = UserLockRequeue | (Operation & USER_LOCK_PRIVATE);
+    Parameters.TimeoutInMilliseconds = 0;
+    Parameters.SecondAddress = SecondAddress;
+    Parameters.SecondValue = *SecondValue;
+    Parameters.Argument = Argument;
+    Status = OsSystemCall(SystemCallUserLock, &Parameters);
+    *Value = Parameters.Value;
+    *SecondValue = Parameters.SecondValue;
+    return Status;
+}
+
+OS_API
+KSTATUS
+OsUserLockWakeOperation (
+    PVOID Address,
+    ULONG Operation,
+    PULONG Value,
+    PVOID SecondAddress,
+    PULONG SecondValue,
+    ULONG Argument
+    )
+
+/*++
+
+Routine Description:
+
+    This routine atomically modifies a second user lock, wakes threads blocked
+    on the first user lock, and then wakes threads blocked on the second user
+    lock if its original value passes a comparison. This allows one lock to
+    be released and another to be signaled in a single call.
+
+Arguments:
+
+    Address - Supplies a pointer to the first 32-bit lock.
+
+    Operation - Supplies the flags for the operation. The only valid flag is
+        USER_LOCK_PRIVATE, which applies to both addresses.
+
+    Value - Supplies a pointer that on input contains the maximum number of
+        threads to wake on the first lock. On output, contains the number of
+        threads woken.
+
+    SecondAddress - Supplies a pointer to the 32-bit lock that is modified.
+
+    SecondValue - Supplies a pointer that on input contains the maximum number
+        of threads to wake on the second lock. On output, contains the number
+        of threads woken.
+
+    Argument - Supplies the operation and comparison to perform on the second
+        lock, built with the USER_LOCK_WAKE_OPERATION_ENCODE macro.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    SYSTEM_CALL_USER_LOCK Parameters;
+    KSTATUS Status;
+
+    Parameters.Address = Address;
+    Parameters.Value = *Value;
+    Parameters.Operation = UserLockWakeOperation |
+                           (Operation & USER_LOCK_PRIVATE);
+
+    Parameters.TimeoutInMilliseconds = 0;
+    Parameters.SecondAddress = SecondAddress;
+    Parameters.SecondValue = *SecondValue;
+    Parameters.Argument = Argument;
     Status = OsSystemCall(SystemCallUserLock, &Parameters);
     *Value = Parameters.Value;
+    *SecondValue = Parameters.SecondValue;
     return Status;
 }
 
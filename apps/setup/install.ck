@@ -129,6 +129,9 @@ if (arch == "x86") {
         "rtl81xx.drv",
         "uhci.drv",
         "pcnet32.drv",
+        "virtblk.drv",
+        "virtio.drv",
+        "virtnet.drv",
     ];
 
 } else if ((arch == "armv7") || (arch == "armv6")) {
@@ -158,6 +161,8 @@ if (arch == "x86") {
         "usbhub.drv",
         "usbmass.drv",
         "sd.drv",
+        "virtio.drv",
+        "virtblk.drv",
     ];
 }
 
@@ -752,6 +757,9 @@ if (plat == "install-x86") {
         "usbmass.drv",
         "usrinput.drv",
         "videocon.drv",
+        "virtblk.drv",
+        "virtio.drv",
+        "virtnet.drv",
     ];
 
     Files += [
@@ -1018,6 +1026,9 @@ if (plat == "pc-tiny") {
         "e100.drv",
         "e1000.drv",
         "i8042.drv",
+        "virtblk.drv",
+        "virtio.drv",
+        "virtnet.drv",
     ];
 
     DriverDb["BootDrivers"] = [
@@ -1029,6 +1040,8 @@ if (plat == "pc-tiny") {
         "pci.drv",
         "special.drv",
         "videocon.drv",
+        "virtio.drv",
+        "virtblk.drv",
     ];
 
     //
@@ -514,6 +514,24 @@ Return Value:
     }
 
     if (SwForkSupported != 0) {
+
+        //
+        // Try to launch the command directly first, which avoids copying the
+        // whole shell just to throw it away on exec.
+        //
+
+        fflush(NULL);
+        Result = ShOsSpawnCommand(FullCommandPath,
+                                  Arguments,
+                                  ArgumentCount,
+                                  &Child,
+                                  ReturnValue);
+
+        if (Result != FALSE) {
+            Status = 0;
+            goto RunCommandEnd;
+        }
+
         Child = SwFork();
         if (Child < 0) {
             PRINT_ERROR("sh: Failed to fork: %s\n", strerror(errno));
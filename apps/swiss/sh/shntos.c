@@ -898,6 +898,58 @@ Return Value:
     return;
 }
 
+int
+ShOsSpawnCommand (
+    char *Command,
+    char **Arguments,
+    int ArgumentCount,
+    int *ProcessId,
+    int *Error
+    )
+
+/*++
+
+Routine Description:
+
+    This routine attempts to launch the given command in a new child process
+    without forking the shell first. The child gets the original signal
+    dispositions the shell started with, as if
+    ShRestoreOriginalSignalDispositions had been called before the exec.
+
+Arguments:
+
+    Command - Supplies a pointer to the full path of the command to run.
+
+    Arguments - Supplies a pointer to the null terminated array of command
+        argument strings. This includes the first argument, the command name.
+
+    ArgumentCount - Supplies the number of arguments on the command line.
+
+    ProcessId - Supplies a pointer where the ID of the new child will be
+        returned on success.
+
+    Error - Supplies a pointer where an error code will be returned if the
+        command could not be launched.
+
+Return Value:
+
+    1 if the spawn was attempted, in which case either the process ID or the
+    error is returned.
+
+    0 if the command cannot be spawned directly in the shell's current state,
+    and the caller should fork and exec it instead.
+
+--*/
+
+{
+
+    //
+    // Commands are launched with SwRunCommand on Windows.
+    //
+
+    return 0;
+}
+
 void
 ShGetExecutableExtensions (
     char ***ExtensionList,
@@ -38,6 +38,7 @@ Module Name:
 #include <fcntl.h>
 #include <signal.h>
 #include <pwd.h>
+#include <spawn.h>
 #include <sys/times.h>
 #include <sys/wait.h>
 #include <errno.h>
@@ -67,6 +68,8 @@ ShConvertToOsSignal (
 // -------------------------------------------------------------------- Globals
 //
 
+extern char **environ;
+
 //
 // Remember the number of clock ticks per second.
 //
@@ -806,6 +809,114 @@ Return Value:
     return;
 }
 
+int
+ShOsSpawnCommand (
+    char *Command,
+    char **Arguments,
+    int ArgumentCount,
+    int *ProcessId,
+    int *Error
+    )
+
+/*++
+
+Routine Description:
+
+    This routine attempts to launch the given command in a new child process
+    without forking the shell first. The child gets the original signal
+    dispositions the shell started with, as if
+    ShRestoreOriginalSignalDispositions had been called before the exec.
+
+Arguments:
+
+    Command - Supplies a pointer to the full path of the command to run.
+
+    Arguments - Supplies a pointer to the null terminated array of command
+        argument strings. This includes the first argument, the command name.
+
+    ArgumentCount - Supplies the number of arguments on the command line.
+
+    ProcessId - Supplies a pointer where the ID of the new child will be
+        returned on success.
+
+    Error - Supplies a pointer where an error code will be returned if the
+        command could not be launched.
+
+Return Value:
+
+    1 if the spawn was attempted, in which case either the process ID or the
+    error is returned.
+
+    0 if the command cannot be spawned directly in the shell's current state,
+    and the caller should fork and exec it instead.
+
+--*/
+
+{
+
+    posix_spawnattr_t Attributes;
+    struct sigaction CurrentAction;
+    sigset_t DefaultSignals;
+    int OsSignalNumber;
+    pid_t Pid;
+    int Result;
+    int SignalIndex;
+
+    assert(ArgumentCount != 0);
+
+    //
+    // Signals the shell traps go back to the default across an exec anyway.
+    // Signals the shell ignores need to be explicitly set back to the
+    // default. A signal that started out ignored but is now trapped would
+    // need to be ignored again, which spawn can't express.
+    //
+
+    sigemptyset(&DefaultSignals);
+    for (SignalIndex = 0; SignalIndex < ShellSignalCount; SignalIndex += 1) {
+        if (ShOriginalSignalDispositionValid[SignalIndex] == 0) {
+            continue;
+        }
+
+        OsSignalNumber = ShConvertToOsSignal(SignalIndex);
+        if (OsSignalNumber == 0) {
+            continue;
+        }
+
+        if (ShOriginalSignalDispositions[SignalIndex].sa_handler == SIG_IGN) {
+            Result = sigaction(OsSignalNumber, NULL, &CurrentAction);
+            if ((Result != 0) || (CurrentAction.sa_handler != SIG_IGN)) {
+                return 0;
+            }
+
+        } else {
+            sigaddset(&DefaultSignals, OsSignalNumber);
+        }
+    }
+
+    if (posix_spawnattr_init(&Attributes) != 0) {
+        return 0;
+    }
+
+    posix_spawnattr_setflags(&Attributes, POSIX_SPAWN_SETSIGDEF);
+    posix_spawnattr_setsigdefault(&Attributes, &DefaultSignals);
+    Result = posix_spawnp(&Pid,
+                          Command,
+                          NULL,
+                          &Attributes,
+                          Arguments,
+                          environ);
+
+    posix_spawnattr_destroy(&Attributes);
+    if (Result != 0) {
+        *Error = Result;
+
+    } else {
+        *ProcessId = Pid;
+    }
+
+    return 1;
+}
+
 void
 ShGetExecutableExtensions (
     char ***ExtensionList,
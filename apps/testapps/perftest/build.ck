@@ -31,6 +31,7 @@ function build() {
         "create.c",
         "dlopen.c",
         "dup.c",
+        "epoll.c",
         "getppid.c",
         "exec.c",
         "fork.c",
@@ -42,8 +43,11 @@ function build() {
         "perftest.c",
         "pipeio.c",
         "pthread.c",
+        "qlock.c",
         "read.c",
         "rename.c",
+        "schedlat.c",
+        "sendfile.c",
         "stat.c",
         "write.c"
     ];
@@ -241,6 +241,15 @@ Return Value:
         goto MainEnd;
     }
 
+    //
+    // The source was just written, so it is all still in the page cache. Drop
+    // it so the reads actually go to the disk. Then let the system know it is
+    // read front to back so that it can read ahead.
+    //
+
+    posix_fadvise(SourceDescriptor, 0, 0, POSIX_FADV_DONTNEED);
+    posix_fadvise(SourceDescriptor, 0, 0, POSIX_FADV_SEQUENTIAL);
+
     //
     // Start the test. This snaps resource usage and starts the clock ticking.
     //
@@ -0,0 +1,409 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    epoll.c
+
+Abstract:
+
+    This module implements the epoll performance benchmark test. It registers
+    a large number of idle sockets alongside a few busy ones, and measures how
+    quickly events on the busy sockets can be harvested.
+
+Author:
+
+    agent 16-Oct-2026
+
+Environment:
+
+    User
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "perftest.h"
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+//
+// Define the number of idle and busy socket pairs registered with the epoll
+// instance. The idle count is trimmed if the descriptor limit is too low.
+//
+
+#define PT_EPOLL_IDLE_SOCKET_COUNT 10000
+#define PT_EPOLL_HOT_SOCKET_COUNT 4
+
+//
+// Define the number of descriptors held back for the standard descriptors and
+// the epoll instance itself.
+//
+
+#define PT_EPOLL_RESERVED_DESCRIPTORS 16
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+int
+EpollCreateSocketPairs (
+    int EpollDescriptor,
+    int *Sockets,
+    int PairCount
+    );
+
+void
+EpollDestroySocketPairs (
+    int *Sockets,
+    int PairCount
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+void
+EpollMain (
+    PPT_TEST_INFORMATION Test,
+    PPT_TEST_RESULT Result
+    )
+
+/*++
+
+Routine Description:
+
+    This routine performs the epoll performance benchmark test.
+
+Arguments:
+
+    Test - Supplies a pointer to the performance test being executed.
+
+    Result - Supplies a pointer to a performance test result structure that
+        receives the tests results.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    char Buffer;
+    ssize_t BytesCompleted;
+    int EpollDescriptor;
+    struct epoll_event Events[PT_EPOLL_HOT_SOCKET_COUNT];
+    int EventCount;
+    int EventIndex;
+    int HotCount;
+    int HotIndex;
+    int HotSockets[PT_EPOLL_HOT_SOCKET_COUNT * 2];
+    int IdleCount;
+    int *IdleSockets;
+    unsigned long long Iterations;
+    struct rlimit Limit;
+    int Status;
+
+    assert(Test->TestType == PtTestEpoll);
+
+    Buffer = 0;
+    HotCount = 0;
+    IdleCount = 0;
+    IdleSockets = NULL;
+    Iterations = 0;
+    Result->Type = PtResultIterations;
+    Result->Status = 0;
+    EpollDescriptor = epoll_create1(EPOLL_CLOEXEC);
+    if (EpollDescriptor < 0) {
+        Result->Status = errno;
+        goto MainEnd;
+    }
+
+    //
+    // Raise the descriptor limit as far as it will go, and size the idle set
+    // to fit under it.
+    //
+
+    IdleCount = PT_EPOLL_IDLE_SOCKET_COUNT;
+    if (getrlimit(RLIMIT_NOFILE, &Limit) == 0) {
+        if (Limit.rlim_cur < Limit.rlim_max) {
+            Limit.rlim_cur = Limit.rlim_max;
+            setrlimit(RLIMIT_NOFILE, &Limit);
+            getrlimit(RLIMIT_NOFILE, &Limit);
+        }
+
+        if ((Limit.rlim_cur != RLIM_INFINITY) &&
+            (Limit.rlim_cur < (PT_EPOLL_IDLE_SOCKET_COUNT * 2) +
+                              (PT_EPOLL_HOT_SOCKET_COUNT * 2) +
+                              PT_EPOLL_RESERVED_DESCRIPTORS)) {
+
+            IdleCount = ((int)Limit.rlim_cur -
+                         (PT_EPOLL_HOT_SOCKET_COUNT * 2) -
+                         PT_EPOLL_RESERVED_DESCRIPTORS) / 2;
+
+            if (IdleCount < 0) {
+                IdleCount = 0;
+            }
+        }
+    }
+
+    IdleSockets = malloc(sizeof(int) * 2 * IdleCount);
+    if ((IdleSockets == NULL) && (IdleCount != 0)) {
+        Result->Status = ENOMEM;
+        goto MainEnd;
+    }
+
+    Status = EpollCreateSocketPairs(EpollDescriptor, IdleSockets, IdleCount);
+    if (Status != 0) {
+        IdleCount = 0;
+        Result->Status = Status;
+        goto MainEnd;
+    }
+
+    Status = EpollCreateSocketPairs(EpollDescriptor,
+                                    HotSockets,
+                                    PT_EPOLL_HOT_SOCKET_COUNT);
+
+    if (Status != 0) {
+        Result->Status = Status;
+        goto MainEnd;
+    }
+
+    HotCount = PT_EPOLL_HOT_SOCKET_COUNT;
+
+    //
+    // Start the test. This snaps resource usage and starts the clock ticking.
+    //
+
+    Status = PtStartTimedTest(Test->Duration);
+    if (Status != 0) {
+        Result->Status = errno;
+        goto MainEnd;
+    }
+
+    //
+    // Each iteration makes every hot socket readable, harvests the events,
+    // and drains the sockets again. The cost should not depend on how many
+    // idle sockets are registered.
+    //
+
+    while (PtIsTimedTestRunning() != 0) {
+        for (HotIndex = 0; HotIndex < HotCount; HotIndex += 1) {
+            do {
+                BytesCompleted = write(HotSockets[(HotIndex * 2) + 1],
+                                       &Buffer,
+                                       1);
+
+            } while ((BytesCompleted < 0) && (errno == EINTR));
+
+            if (BytesCompleted != 1) {
+                Result->Status = errno;
+                if (Result->Status == 0) {
+                    Result->Status = EIO;
+                }
+
+                goto TestLoopEnd;
+            }
+        }
+
+        EventIndex = 0;
+        while (EventIndex < HotCount) {
+            EventCount = epoll_wait(EpollDescriptor,
+                                    Events,
+                                    PT_EPOLL_HOT_SOCKET_COUNT,
+                                    -1);
+
+            if (EventCount < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+
+                Result->Status = errno;
+                goto TestLoopEnd;
+            }
+
+            while (EventCount > 0) {
+                EventCount -= 1;
+                do {
+                    BytesCompleted = read(Events[EventCount].data.fd,
+                                          &Buffer,
+                                          1);
+
+                } while ((BytesCompleted < 0) && (errno == EINTR));
+
+                if (BytesCompleted != 1) {
+                    Result->Status = errno;
+                    if (Result->Status == 0) {
+                        Result->Status = EIO;
+                    }
+
+                    goto TestLoopEnd;
+                }
+
+                EventIndex += 1;
+            }
+        }
+
+        Iterations += 1;
+    }
+
+TestLoopEnd:
+    Status = PtFinishTimedTest(Result);
+    if ((Status != 0) && (Result->Status == 0)) {
+        Result->Status = errno;
+    }
+
+MainEnd:
+    EpollDestroySocketPairs(HotSockets, HotCount);
+    if (IdleSockets != NULL) {
+        EpollDestroySocketPairs(IdleSockets, IdleCount);
+        free(IdleSockets);
+    }
+
+    if (EpollDescriptor >= 0) {
+        close(EpollDescriptor);
+    }
+
+    Result->Data.Iterations = Iterations;
+    return;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+int
+EpollCreateSocketPairs (
+    int EpollDescriptor,
+    int *Sockets,
+    int PairCount
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates a number of connected socket pairs and registers the
+    first socket of each pair with the given epoll instance for input events.
+
+Arguments:
+
+    EpollDescriptor - Supplies the epoll instance to register with.
+
+    Sockets - Supplies a pointer to an array of twice the pair count
+        descriptors that receives the new sockets.
+
+    PairCount - Supplies the number of socket pairs to create.
+
+Return Value:
+
+    0 on success. On failure, any pairs that were created are destroyed.
+
+    Returns an error number on failure.
+
+--*/
+
+{
+
+    struct epoll_event Event;
+    int PairIndex;
+    int Status;
+
+    for (PairIndex = 0; PairIndex < PairCount; PairIndex += 1) {
+        Status = socketpair(AF_UNIX,
+                            SOCK_STREAM,
+                            0,
+                            &(Sockets[PairIndex * 2]));
+
+        if (Status != 0) {
+            Status = errno;
+            goto CreateSocketPairsEnd;
+        }
+
+        Event.events = EPOLLIN;
+        Event.data.fd = Sockets[PairIndex * 2];
+        Status = epoll_ctl(EpollDescriptor,
+                           EPOLL_CTL_ADD,
+                           Sockets[PairIndex * 2],
+                           &Event);
+
+        if (Status != 0) {
+            Status = errno;
+            PairIndex += 1;
+            goto CreateSocketPairsEnd;
+        }
+    }
+
+    Status = 0;
+
+CreateSocketPairsEnd:
+    if (Status != 0) {
+        EpollDestroySocketPairs(Sockets, PairIndex);
+    }
+
+    return Status;
+}
+
+void
+EpollDestroySocketPairs (
+    int *Sockets,
+    int PairCount
+    )
+
+/*++
+
+Routine Description:
+
+    This routine closes a number of socket pairs. Closing the sockets also
+    removes them from any epoll instance they were registered with.
+
+Arguments:
+
+    Sockets - Supplies a pointer to the array of sockets.
+
+    PairCount - Supplies the number of socket pairs to close.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    int SocketIndex;
+
+    for (SocketIndex = 0; SocketIndex < PairCount * 2; SocketIndex += 1) {
+        close(Sockets[SocketIndex]);
+    }
+
+    return;
+}
+
@@ -14,7 +14,7 @@ Module Name:
 Abstract:
 
     This module implements the performance benchmark tests for the fork()
-    C library call.
+    and posix_spawn() C library calls.
 
 Author:
 
@@ -32,7 +32,9 @@ Module Name:
 
 #include <stdlib.h>
 #include <errno.h>
+#include <spawn.h>
 #include <unistd.h>
+#include <sys/mman.h>
 #include <sys/wait.h>
 
 #include "perftest.h"
@@ -41,6 +43,14 @@ Module Name:
 // ---------------------------------------------------------------- Definitions
 //
 
+//
+// Define the sizes of the heaps the parent touches before forking in the large
+// parent variants of the test.
+//
+
+#define PT_FORK_64M_HEAP_SIZE (64UL * 1024 * 1024)
+#define PT_FORK_512M_HEAP_SIZE (512UL * 1024 * 1024)
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -53,6 +63,8 @@ Module Name:
 // -------------------------------------------------------------------- Globals
 //
 
+extern char **environ;
+
 //
 // ------------------------------------------------------------------ Functions
 //
@@ -85,13 +97,62 @@ Return Value:
 {
 
     pid_t Child;
+    char *Heap;
+    size_t HeapSize;
     unsigned long long Iterations;
+    size_t Offset;
+    long PageSize;
     int Status;
 
+    Heap = MAP_FAILED;
     Iterations = 0;
     Result->Type = PtResultIterations;
     Result->Status = 0;
 
+    //
+    // The large parent variants measure how fork scales with the size of the
+    // parent, the way a pre-forking server with a big heap would see it.
+    //
+
+    switch (Test->TestType) {
+    case PtTestFork64m:
+        HeapSize = PT_FORK_64M_HEAP_SIZE;
+        break;
+
+    case PtTestFork512m:
+        HeapSize = PT_FORK_512M_HEAP_SIZE;
+        break;
+
+    case PtTestFork:
+    default:
+        HeapSize = 0;
+        break;
+    }
+
+    //
+    // Write to every page of the heap so that it is all resident and private
+    // to the parent before the first fork.
+    //
+
+    if (HeapSize != 0) {
+        Heap = mmap(NULL,
+                    HeapSize,
+                    PROT_READ | PROT_WRITE,
+                    MAP_ANON | MAP_PRIVATE,
+                    -1,
+                    0);
+
+        if (Heap == MAP_FAILED) {
+            Result->Status = errno;
+            goto MainEnd;
+        }
+
+        PageSize = sysconf(_SC_PAGE_SIZE);
+        for (Offset = 0; Offset < HeapSize; Offset += PageSize) {
+            Heap[Offset] = (char)Offset;
+        }
+    }
+
     //
     // Start the test. This snaps resource usage and starts the clock ticking.
     //
@@ -142,6 +203,107 @@ Return Value:
         Result->Status = errno;
     }
 
+MainEnd:
+    if (Heap != MAP_FAILED) {
+        munmap(Heap, HeapSize);
+    }
+
+    Result->Data.Iterations = Iterations;
+    return;
+}
+
+void
+SpawnMain (
+    PPT_TEST_INFORMATION Test,
+    PPT_TEST_RESULT Result
+    )
+
+/*++
+
+Routine Description:
+
+    This routine performs the spawn performance benchmark test.
+
+Arguments:
+
+    Test - Supplies a pointer to the performance test being executed.
+
+    Result - Supplies a pointer to a performance test result structure that
+        receives the tests results.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    char *Arguments[3];
+    pid_t Child;
+    unsigned long long Iterations;
+    int Status;
+
+    Iterations = 0;
+    Result->Type = PtResultIterations;
+    Result->Status = 0;
+    Arguments[0] = PtProgramPath;
+    Arguments[1] = SPAWN_TEST_NAME;
+    Arguments[2] = NULL;
+
+    //
+    // Start the test. This snaps resource usage and starts the clock ticking.
+    //
+
+    Status = PtStartTimedTest(Test->Duration);
+    if (Status != 0) {
+        Result->Status = errno;
+        goto MainEnd;
+    }
+
+    //
+    // Measure the performance of the posix_spawn() C library routine by
+    // counting the number of times a spawned child can be waited on during
+    // the given duration. The child, this same program, exits immediately
+    // when it sees the spawn test argument.
+    //
+
+    while (PtIsTimedTestRunning() != 0) {
+        Status = posix_spawn(&Child,
+                             PtProgramPath,
+                             NULL,
+                             NULL,
+                             Arguments,
+                             environ);
+
+        if (Status != 0) {
+            Result->Status = Status;
+            break;
+        }
+
+        Child = waitpid(Child, &Status, 0);
+        if (Child == -1) {
+            if (PtIsTimedTestRunning() == 0) {
+                break;
+            }
+
+            Result->Status = errno;
+            break;
+        }
+
+        if (Status != 0) {
+            Result->Status = WEXITSTATUS(Status);
+            break;
+        }
+
+        Iterations += 1;
+    }
+
+    Status = PtFinishTimedTest(Result);
+    if ((Status != 0) && (Result->Status == 0)) {
+        Result->Status = errno;
+    }
+
 MainEnd:
     Result->Data.Iterations = Iterations;
     return;
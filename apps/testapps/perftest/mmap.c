@@ -49,6 +49,13 @@ Module Name:
 #define PT_MMAP_TEST_REGION_SIZE (2 * 1024 * 1024)
 #define PT_MMAP_TEST_BLOCK_SIZE 4096
 
+//
+// Define the size of the region used by the fault around test. It covers many
+// aligned blocks, so the cost of faulting in whole blocks at once dominates.
+//
+
+#define PT_MMAP_FAULT_AROUND_TEST_REGION_SIZE (32 * 1024 * 1024)
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -101,20 +108,24 @@ Return Value:
     int FileCreated;
     int FileDescriptor;
     char FileName[PT_MMAP_TEST_FILE_NAME_LENGTH];
+    int FaultAround;
     int Index;
     unsigned long long Iterations;
     int MmapFlags;
     int PerformIo;
     pid_t ProcessId;
     int ProtectionFlags;
+    size_t RegionSize;
     int Status;
     int Write;
 
     Buffer = NULL;
     CreateFile = 0;
     FileCreated = 0;
+    FaultAround = 0;
     Iterations = 0;
     PerformIo = 0;
+    RegionSize = PT_MMAP_TEST_REGION_SIZE;
     Result->Type = PtResultIterations;
     Result->Status = 0;
     Write = 0;
@@ -150,6 +161,13 @@ Return Value:
         MmapFlags = MAP_ANON | MAP_PRIVATE;
         break;
 
+    case PtTestMmapIoFaultAround:
+        PerformIo = 1;
+        FaultAround = 1;
+        MmapFlags = MAP_ANON | MAP_PRIVATE;
+        RegionSize = PT_MMAP_FAULT_AROUND_TEST_REGION_SIZE;
+        break;
+
     default:
 
         assert(0);
@@ -252,7 +270,7 @@ Return Value:
 
     while (PtIsTimedTestRunning() != 0) {
         Address = mmap(NULL,
-                       PT_MMAP_TEST_REGION_SIZE,
+                       RegionSize,
                        ProtectionFlags,
                        MmapFlags,
                        FileDescriptor,
@@ -263,6 +281,20 @@ Return Value:
             break;
         }
 
+        //
+        // Ask for faults to populate whole blocks before touching the region.
+        // Only the aligned blocks fully inside the region can use them.
+        //
+
+        if (FaultAround != 0) {
+            Status = madvise(Address, RegionSize, MADV_FAULTAROUND);
+            if (Status != 0) {
+                Result->Status = errno;
+                munmap(Address, RegionSize);
+                break;
+            }
+        }
+
         //
         // If this is an I/O test, then alternating reading and writing each
         // block in the mapped region.
@@ -270,7 +302,7 @@ Return Value:
 
         if (PerformIo != 0) {
             CurrentAddress = (char *)Address;
-            EndAddress = CurrentAddress + PT_MMAP_TEST_REGION_SIZE;
+            EndAddress = CurrentAddress + RegionSize;
             while (CurrentAddress < EndAddress) {
                 if (Write == 0) {
                     if (*CurrentAddress != 0) {
@@ -288,7 +320,7 @@ Return Value:
             }
         }
 
-        Status = munmap(Address, PT_MMAP_TEST_REGION_SIZE);
+        Status = munmap(Address, RegionSize);
         if (Status != 0) {
             Result->Status = errno;
             break;
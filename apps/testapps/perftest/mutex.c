@@ -13,7 +13,8 @@ Module Name:
 
 Abstract:
 
-    This module implements the mutex performance benchmark tests.
+    This module implements the mutex and condition variable performance
+    benchmark tests.
 
 Author:
 
@@ -56,12 +57,30 @@ MutexStartRoutine (
     void *Parameter
     );
 
+void *
+MutexConditionStartRoutine (
+    void *Parameter
+    );
+
 //
 // -------------------------------------------------------------------- Globals
 //
 
 volatile int MutexReadyThreadCount;
 
+//
+// Store the state for the contended condition variable test. Each round, the
+// main thread bumps the generation and broadcasts, and every worker thread
+// acknowledges it before the next round starts. All of this is protected by
+// the test mutex.
+//
+
+pthread_cond_t MutexCondition = PTHREAD_COND_INITIALIZER;
+pthread_cond_t MutexAcknowledgeCondition = PTHREAD_COND_INITIALIZER;
+volatile unsigned long MutexConditionGeneration;
+volatile int MutexConditionAcknowledgeCount;
+volatile int MutexConditionStop;
+
 //
 // ------------------------------------------------------------------ Functions
 //
@@ -95,6 +114,7 @@ Return Value:
 
     unsigned long long Iterations;
     pthread_mutex_t Mutex;
+    int MutexLocked;
     int MutexInitialized;
     int Status;
     int ThreadCount;
@@ -103,6 +123,7 @@ Return Value:
 
     Iterations = 0;
     MutexInitialized = 0;
+    MutexLocked = 0;
     Threads = NULL;
     Result->Type = PtResultIterations;
     Result->Status = 0;
@@ -160,6 +181,38 @@ Return Value:
 
         break;
 
+    case PtTestConditionContended:
+        Threads = malloc(sizeof(pthread_t) * PT_MUTEXT_TEST_THREAD_COUNT);
+        if (Threads == NULL) {
+            Result->Status = ENOMEM;
+            goto MainEnd;
+        }
+
+        for (ThreadIndex = 0;
+             ThreadIndex < PT_MUTEXT_TEST_THREAD_COUNT;
+             ThreadIndex += 1) {
+
+            Status = pthread_create(&(Threads[ThreadIndex]),
+                                    NULL,
+                                    MutexConditionStartRoutine,
+                                    &Mutex);
+
+            if (Status != 0) {
+                Result->Status = Status;
+                goto MainEnd;
+            }
+        }
+
+        //
+        // Wait until all threads are waiting on the condition variable.
+        //
+
+        while (MutexReadyThreadCount != PT_MUTEXT_TEST_THREAD_COUNT) {
+            sleep(1);
+        }
+
+        break;
+
     default:
 
         assert(0);
@@ -178,15 +231,40 @@ Return Value:
         goto MainEnd;
     }
 
+    //
+    // Measure the performance of a condition variable broadcast by seeing how
+    // many rounds of waking every thread and waiting for them all to run can
+    // be completed. Each woken thread needs the mutex before it can do
+    // anything, so this is sensitive to how a broadcast hands off waiters.
+    //
+
+    if (Test->TestType == PtTestConditionContended) {
+        pthread_mutex_lock(&Mutex);
+        MutexLocked = 1;
+        while (PtIsTimedTestRunning() != 0) {
+            MutexConditionAcknowledgeCount = 0;
+            MutexConditionGeneration += 1;
+            pthread_cond_broadcast(&MutexCondition);
+            while (MutexConditionAcknowledgeCount !=
+                   PT_MUTEXT_TEST_THREAD_COUNT) {
+
+                pthread_cond_wait(&MutexAcknowledgeCondition, &Mutex);
+            }
+
+            Iterations += 1;
+        }
+
     //
     // Measure the performance of the mutex lock and unlock by seeing how many
     // times it can be acquired and released.
     //
 
-    while (PtIsTimedTestRunning() != 0) {
-        pthread_mutex_lock(&Mutex);
-        pthread_mutex_unlock(&Mutex);
-        Iterations += 1;
+    } else {
+        while (PtIsTimedTestRunning() != 0) {
+            pthread_mutex_lock(&Mutex);
+            pthread_mutex_unlock(&Mutex);
+            Iterations += 1;
+        }
     }
 
     Status = PtFinishTimedTest(Result);
@@ -214,6 +292,27 @@ Return Value:
 
         break;
 
+    case PtTestConditionContended:
+        if (MutexLocked == 0) {
+            pthread_mutex_lock(&Mutex);
+            MutexLocked = 1;
+        }
+
+        MutexConditionStop = 1;
+        pthread_cond_broadcast(&MutexCondition);
+        pthread_mutex_unlock(&Mutex);
+        MutexLocked = 0;
+        if (Threads != NULL) {
+            ThreadCount = ThreadIndex;
+            for (ThreadIndex = 0; ThreadIndex < ThreadCount; ThreadIndex += 1) {
+                pthread_join(Threads[ThreadIndex], NULL);
+            }
+
+            free(Threads);
+        }
+
+        break;
+
     case PtTestMutex:
     default:
         break;
@@ -288,3 +387,52 @@ Return Value:
     return NULL;
 }
 
+void *
+MutexConditionStartRoutine (
+    void *Parameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine implements the start routine for a contended condition
+    variable test thread. It waits for each new round to be broadcast, and
+    acknowledges it.
+
+Arguments:
+
+    Parameter - Supplies a pointer to the mutex to use.
+
+Return Value:
+
+    Returns the NULL pointer.
+
+--*/
+
+{
+
+    unsigned long Generation;
+    pthread_mutex_t *Mutex;
+
+    Mutex = (pthread_mutex_t *)Parameter;
+    pthread_mutex_lock(Mutex);
+    MutexReadyThreadCount += 1;
+    Generation = MutexConditionGeneration;
+    while (MutexConditionStop == 0) {
+        if (MutexConditionGeneration == Generation) {
+            pthread_cond_wait(&MutexCondition, Mutex);
+            continue;
+        }
+
+        Generation = MutexConditionGeneration;
+        MutexConditionAcknowledgeCount += 1;
+        if (MutexConditionAcknowledgeCount == PT_MUTEXT_TEST_THREAD_COUNT) {
+            pthread_cond_signal(&MutexAcknowledgeCondition);
+        }
+    }
+
+    pthread_mutex_unlock(Mutex);
+    return NULL;
+}
+
@@ -260,6 +260,13 @@ PT_TEST_INFORMATION PerformanceTests[PtTestTypeCount] = {
      PtResultBytes,
      READ_TEST_DEFAULT_DURATION},
 
+    {READ_RANDOM_TEST_NAME,
+     READ_RANDOM_TEST_DESCRIPTION,
+     ReadMain,
+     PtTestReadRandom,
+     PtResultBytes,
+     READ_RANDOM_TEST_DEFAULT_DURATION},
+
     {WRITE_TEST_NAME,
      WRITE_TEST_DESCRIPTION,
      WriteMain,
@@ -379,6 +386,13 @@ PT_TEST_INFORMATION PerformanceTests[PtTestTypeCount] = {
      PtResultIterations,
      MUTEX_CONTENDED_TEST_DEFAULT_DURATION},
 
+    {CONDITION_CONTENDED_TEST_NAME,
+     CONDITION_CONTENDED_TEST_DESCRIPTION,
+     MutexMain,
+     PtTestConditionContended,
+     PtResultIterations,
+     CONDITION_CONTENDED_TEST_DEFAULT_DURATION},
+
     {STAT_TEST_NAME,
      STAT_TEST_DESCRIPTION,
      StatMain,
@@ -392,6 +406,118 @@ PT_TEST_INFORMATION PerformanceTests[PtTestTypeCount] = {
      PtTestFstat,
      PtResultIterations,
      FSTAT_TEST_DEFAULT_DURATION},
+
+    {SCHED_LATENCY_TEST_NAME,
+     SCHED_LATENCY_TEST_DESCRIPTION,
+     SchedLatencyMain,
+     PtTestSchedLatency,
+     PtResultMicroseconds,
+     SCHED_LATENCY_TEST_DEFAULT_DURATION},
+
+    {SCHED_LATENCY_LOADED_TEST_NAME,
+     SCHED_LATENCY_LOADED_TEST_DESCRIPTION,
+     SchedLatencyMain,
+     PtTestSchedLatencyLoaded,
+     PtResultMicroseconds,
+     SCHED_LATENCY_LOADED_TEST_DEFAULT_DURATION},
+
+    {QUEUED_LOCK_CONTENDED_TEST_NAME,
+     QUEUED_LOCK_CONTENDED_TEST_DESCRIPTION,
+     QueuedLockMain,
+     PtTestQueuedLockContended,
+     PtResultIterations,
+     QUEUED_LOCK_CONTENDED_TEST_DEFAULT_DURATION},
+
+    {EPOLL_TEST_NAME,
+     EPOLL_TEST_DESCRIPTION,
+     EpollMain,
+     PtTestEpoll,
+     PtResultIterations,
+     EPOLL_TEST_DEFAULT_DURATION},
+
+    {SEND_FILE_TEST_NAME,
+     SEND_FILE_TEST_DESCRIPTION,
+     SendFileMain,
+     PtTestSendFile,
+     PtResultBytes,
+     SEND_FILE_TEST_DEFAULT_DURATION},
+
+    {SEND_FILE_COPY_TEST_NAME,
+     SEND_FILE_COPY_TEST_DESCRIPTION,
+     SendFileMain,
+     PtTestSendFileCopy,
+     PtResultBytes,
+     SEND_FILE_COPY_TEST_DEFAULT_DURATION},
+
+    {PIPE_IO_LARGE_TEST_NAME,
+     PIPE_IO_LARGE_TEST_DESCRIPTION,
+     PipeStreamMain,
+     PtTestPipeIoLarge,
+     PtResultBytes,
+     PIPE_IO_LARGE_TEST_DEFAULT_DURATION},
+
+    {UNIX_STREAM_IO_TEST_NAME,
+     UNIX_STREAM_IO_TEST_DESCRIPTION,
+     PipeStreamMain,
+     PtTestUnixStreamIo,
+     PtResultBytes,
+     UNIX_STREAM_IO_TEST_DEFAULT_DURATION},
+
+    {UNIX_STREAM_IO_LARGE_TEST_NAME,
+     UNIX_STREAM_IO_LARGE_TEST_DESCRIPTION,
+     PipeStreamMain,
+     PtTestUnixStreamIoLarge,
+     PtResultBytes,
+     UNIX_STREAM_IO_LARGE_TEST_DEFAULT_DURATION},
+
+    {UNIX_DATAGRAM_IO_TEST_NAME,
+     UNIX_DATAGRAM_IO_TEST_DESCRIPTION,
+     PipeStreamMain,
+     PtTestUnixDatagramIo,
+     PtResultBytes,
+     UNIX_DATAGRAM_IO_TEST_DEFAULT_DURATION},
+
+    {UNIX_DATAGRAM_IO_LARGE_TEST_NAME,
+     UNIX_DATAGRAM_IO_LARGE_TEST_DESCRIPTION,
+     PipeStreamMain,
+     PtTestUnixDatagramIoLarge,
+     PtResultBytes,
+     UNIX_DATAGRAM_IO_LARGE_TEST_DEFAULT_DURATION},
+
+    {STAT_DEEP_TEST_NAME,
+     STAT_DEEP_TEST_DESCRIPTION,
+     StatDeepMain,
+     PtTestStatDeep,
+     PtResultIterations,
+     STAT_DEEP_TEST_DEFAULT_DURATION},
+
+    {SPAWN_TEST_NAME,
+     SPAWN_TEST_DESCRIPTION,
+     SpawnMain,
+     PtTestSpawn,
+     PtResultIterations,
+     SPAWN_TEST_DEFAULT_DURATION},
+
+    {FORK_64M_TEST_NAME,
+     FORK_64M_TEST_DESCRIPTION,
+     ForkMain,
+     PtTestFork64m,
+     PtResultIterations,
+     FORK_64M_TEST_DEFAULT_DURATION},
+
+    {FORK_512M_TEST_NAME,
+     FORK_512M_TEST_DESCRIPTION,
+     ForkMain,
+     PtTestFork512m,
+     PtResultIterations,
+     FORK_512M_TEST_DEFAULT_DURATION},
+
+    {MMAP_IO_FAULT_AROUND_TEST_NAME,
+     MMAP_IO_FAULT_AROUND_TEST_DESCRIPTION,
+     MmapMain,
+     PtTestMmapIoFaultAround,
+     PtResultIterations,
+     MMAP_IO_FAULT_AROUND_TEST_DEFAULT_DURATION},
 };
 
 //
@@ -402,6 +528,7 @@ char *PtResultTypeStrings[PtResultTypeCount] = {
     "Invalid",
     "Iterations",
     "Bytes",
+    "Microseconds",
 };
 
 //
@@ -477,6 +604,16 @@ Return Value:
         return ExecLoop(ArgumentCount, Arguments);
     }
 
+    //
+    // Children of the spawn test exit immediately.
+    //
+
+    if ((ArgumentCount == 2) &&
+        (strcasecmp(Arguments[1], SPAWN_TEST_NAME) == 0)) {
+
+        return 0;
+    }
+
     Duration = 0;
     Failures = 0;
     ProcessCount = PT_DEFAULT_PROCESS_COUNT;
@@ -951,6 +1088,12 @@ Return Value:
                 TotalResult.Data.Bytes += Process->Result.Data.Iterations;
                 break;
 
+            case PtResultMicroseconds:
+                TotalResult.Data.Microseconds +=
+                                             Process->Result.Data.Microseconds;
+
+                break;
+
             default:
 
                 assert(0);
@@ -989,6 +1132,10 @@ Return Value:
             Average = (double)TotalResult.Data.Bytes / ProcessCount;
             break;
 
+        case PtResultMicroseconds:
+            Average = (double)TotalResult.Data.Microseconds / ProcessCount;
+            break;
+
         default:
 
             assert(0);
@@ -998,7 +1145,18 @@ Return Value:
 
         assert(Test->Duration > 0);
 
-        Frequency = (double)Average / (double)(Test->Duration);
+        //
+        // Durations are already per operation, so only rates get divided by
+        // the test duration.
+        //
+
+        if (Test->ResultType == PtResultMicroseconds) {
+            Frequency = Average;
+
+        } else {
+            Frequency = (double)Average / (double)(Test->Duration);
+        }
+
         PT_PRINT_RESULT("%s (%ldp):decimal:%.3f\n",
                         Test->Name,
                         ProcessCount,
@@ -1158,6 +1316,10 @@ Return Value:
         PT_PRINT_RESULT("%llu", Result->Data.Bytes);
         break;
 
+    case PtResultMicroseconds:
+        PT_PRINT_RESULT("%llu", Result->Data.Microseconds);
+        break;
+
     default:
 
         assert(0);
@@ -41,6 +41,18 @@ Module Name:
 #define FORK_TEST_DESCRIPTION "Benchmarks the fork() C library routine."
 #define EXEC_TEST_NAME "exec"
 #define EXEC_TEST_DESCRIPTION "Benchmarks the exec() C library routine."
+#define SPAWN_TEST_NAME "spawn"
+#define SPAWN_TEST_DESCRIPTION \
+    "Benchmarks the posix_spawn() C library routine."
+
+#define FORK_64M_TEST_NAME "fork_64m"
+#define FORK_64M_TEST_DESCRIPTION \
+    "Benchmarks the fork() C library routine with a 64MB resident heap."
+
+#define FORK_512M_TEST_NAME "fork_512m"
+#define FORK_512M_TEST_DESCRIPTION \
+    "Benchmarks the fork() C library routine with a 512MB resident heap."
+
 #define OPEN_TEST_NAME "open"
 #define OPEN_TEST_DESCRIPTION \
     "Benchmarks the open() and close() C library routines."
@@ -59,6 +71,10 @@ Module Name:
 #define PIPE_IO_TEST_DESCRIPTION "Benchmarks pipe I/O throughput."
 #define READ_TEST_NAME "read"
 #define READ_TEST_DESCRIPTION "Benchmarks read() throughput."
+#define READ_RANDOM_TEST_NAME "read_random"
+#define READ_RANDOM_TEST_DESCRIPTION \
+    "Benchmarks random 4KB pread() throughput across a large file."
+
 #define WRITE_TEST_NAME "write"
 #define WRITE_TEST_DESCRIPTION "Benchmarks write() throughput."
 #define COPY_TEST_NAME "copy"
@@ -93,6 +109,10 @@ Module Name:
 #define MMAP_IO_ANON_TEST_DESCRIPTION \
     "Benchmarks the I/O throughput on anonymous memory mapped regions."
 
+#define MMAP_IO_FAULT_AROUND_TEST_NAME "mmap_io_faultaround"
+#define MMAP_IO_FAULT_AROUND_TEST_DESCRIPTION \
+    "Benchmarks fault-in and I/O on fault around advised anonymous regions."
+
 #define MALLOC_SMALL_TEST_NAME "malloc_small"
 #define MALLOC_SMALL_TEST_DESCRIPTION \
     "Benchmarks malloc() and free() using a small allocation size."
@@ -125,6 +145,10 @@ Module Name:
 #define MUTEX_CONTENDED_TEST_DESCRIPTION \
     "Benchmarks pthread mutex lock and unlock routines under contention."
 
+#define CONDITION_CONTENDED_TEST_NAME "cond_contended"
+#define CONDITION_CONTENDED_TEST_DESCRIPTION \
+    "Benchmarks pthread condition variable broadcasts to many waiters."
+
 #define STAT_TEST_NAME "stat"
 #define STAT_TEST_DESCRIPTION \
     "Benchmarks the stat() C library routine."
@@ -133,6 +157,54 @@ Module Name:
 #define FSTAT_TEST_DESCRIPTION \
     "Benchmarks the fstat() C library routine."
 
+#define SCHED_LATENCY_TEST_NAME "sched_latency"
+#define SCHED_LATENCY_TEST_DESCRIPTION \
+    "Measures the time from waking a thread until it runs."
+
+#define SCHED_LATENCY_LOADED_TEST_NAME "sched_latency_loaded"
+#define SCHED_LATENCY_LOADED_TEST_DESCRIPTION \
+    "Measures the time from waking a thread until it runs under CPU load."
+
+#define QUEUED_LOCK_CONTENDED_TEST_NAME "qlock_contended"
+#define QUEUED_LOCK_CONTENDED_TEST_DESCRIPTION \
+    "Benchmarks a contended kernel queued lock via dup() and close()."
+
+#define EPOLL_TEST_NAME "epoll"
+#define EPOLL_TEST_DESCRIPTION \
+    "Benchmarks epoll_wait() with a few busy and many idle sockets."
+
+#define SEND_FILE_TEST_NAME "sendfile"
+#define SEND_FILE_TEST_DESCRIPTION \
+    "Benchmarks serving a cached file over loopback TCP with sendfile()."
+
+#define SEND_FILE_COPY_TEST_NAME "sendfile_copy"
+#define SEND_FILE_COPY_TEST_DESCRIPTION \
+    "Benchmarks serving a cached file over loopback TCP with read and write."
+
+#define PIPE_IO_LARGE_TEST_NAME "pipe_io_256k"
+#define PIPE_IO_LARGE_TEST_DESCRIPTION \
+    "Benchmarks pipe throughput with 256KB writes to another process."
+
+#define UNIX_STREAM_IO_TEST_NAME "unix_stream_io"
+#define UNIX_STREAM_IO_TEST_DESCRIPTION \
+    "Benchmarks Unix stream socket throughput with 4KB writes."
+
+#define UNIX_STREAM_IO_LARGE_TEST_NAME "unix_stream_io_256k"
+#define UNIX_STREAM_IO_LARGE_TEST_DESCRIPTION \
+    "Benchmarks Unix stream socket throughput with 256KB writes."
+
+#define UNIX_DATAGRAM_IO_TEST_NAME "unix_dgram_io"
+#define UNIX_DATAGRAM_IO_TEST_DESCRIPTION \
+    "Benchmarks Unix datagram socket throughput with 4KB messages."
+
+#define UNIX_DATAGRAM_IO_LARGE_TEST_NAME "unix_dgram_io_64k"
+#define UNIX_DATAGRAM_IO_LARGE_TEST_DESCRIPTION \
+    "Benchmarks Unix datagram socket throughput with 64KB messages."
+
+#define STAT_DEEP_TEST_NAME "stat_deep"
+#define STAT_DEEP_TEST_DESCRIPTION \
+    "Benchmarks the stat() C library routine on a path 16 directories deep."
+
 //
 // Default test durations, in seconds.
 //
@@ -146,6 +218,7 @@ Module Name:
 #define GETPPID_TEST_DEFAULT_DURATION 10
 #define PIPE_IO_TEST_DEFAULT_DURATION 30
 #define READ_TEST_DEFAULT_DURATION 60
+#define READ_RANDOM_TEST_DEFAULT_DURATION 60
 #define WRITE_TEST_DEFAULT_DURATION 60
 #define COPY_TEST_DEFAULT_DURATION 60
 #define DLOPEN_TEST_DEFAULT_DURATION 30
@@ -155,6 +228,7 @@ Module Name:
 #define MMAP_IO_PRIVATE_TEST_DEFAULT_DURATION 30
 #define MMAP_IO_SHARED_TEST_DEFAULT_DURATION 30
 #define MMAP_IO_ANON_TEST_DEFAULT_DURATION 30
+#define MMAP_IO_FAULT_AROUND_TEST_DEFAULT_DURATION 30
 #define MALLOC_SMALL_TEST_DEFAULT_DURATION 30
 #define MALLOC_LARGE_TEST_DEFAULT_DURATION 30
 #define MALLOC_RANDOM_TEST_DEFAULT_DURATION 30
@@ -163,8 +237,24 @@ Module Name:
 #define PTHREAD_DETACH_TEST_DEFAULT_DURATION 30
 #define MUTEX_TEST_DEFAULT_DURATION 30
 #define MUTEX_CONTENDED_TEST_DEFAULT_DURATION 30
+#define CONDITION_CONTENDED_TEST_DEFAULT_DURATION 30
 #define STAT_TEST_DEFAULT_DURATION 30
 #define FSTAT_TEST_DEFAULT_DURATION 30
+#define SCHED_LATENCY_TEST_DEFAULT_DURATION 30
+#define SCHED_LATENCY_LOADED_TEST_DEFAULT_DURATION 30
+#define QUEUED_LOCK_CONTENDED_TEST_DEFAULT_DURATION 30
+#define EPOLL_TEST_DEFAULT_DURATION 30
+#define SEND_FILE_TEST_DEFAULT_DURATION 30
+#define SEND_FILE_COPY_TEST_DEFAULT_DURATION 30
+#define PIPE_IO_LARGE_TEST_DEFAULT_DURATION 30
+#define UNIX_STREAM_IO_TEST_DEFAULT_DURATION 30
+#define UNIX_STREAM_IO_LARGE_TEST_DEFAULT_DURATION 30
+#define UNIX_DATAGRAM_IO_TEST_DEFAULT_DURATION 30
+#define UNIX_DATAGRAM_IO_LARGE_TEST_DEFAULT_DURATION 30
+#define STAT_DEEP_TEST_DEFAULT_DURATION 30
+#define SPAWN_TEST_DEFAULT_DURATION 60
+#define FORK_64M_TEST_DEFAULT_DURATION 60
+#define FORK_512M_TEST_DEFAULT_DURATION 60
 
 //
 // Define the number of variables supplied to an iteration of the execute test
@@ -188,6 +278,7 @@ typedef enum _PT_TEST_TYPE {
     PtTestGetppid,
     PtTestPipeIo,
     PtTestRead,
+    PtTestReadRandom,
     PtTestWrite,
     PtTestCopy,
     PtTestDlopen,
@@ -205,8 +296,25 @@ typedef enum _PT_TEST_TYPE {
     PtTestPthreadDetach,
     PtTestMutex,
     PtTestMutexContended,
+    PtTestConditionContended,
     PtTestStat,
     PtTestFstat,
+    PtTestSchedLatency,
+    PtTestSchedLatencyLoaded,
+    PtTestQueuedLockContended,
+    PtTestEpoll,
+    PtTestSendFile,
+    PtTestSendFileCopy,
+    PtTestPipeIoLarge,
+    PtTestUnixStreamIo,
+    PtTestUnixStreamIoLarge,
+    PtTestUnixDatagramIo,
+    PtTestUnixDatagramIoLarge,
+    PtTestStatDeep,
+    PtTestSpawn,
+    PtTestFork64m,
+    PtTestFork512m,
+    PtTestMmapIoFaultAround,
     PtTestTypeCount
 } PT_TEST_TYPE, *PPT_TEST_TYPE;
 
@@ -227,6 +335,10 @@ Enumeration Description:
     PtResultsBytes - Indicates that the results are stored as the number of
         bytes processed over the duration of the test.
 
+    PtResultMicroseconds - Indicates that the results are stored as an
+        average time per operation, in microseconds. These results are not
+        divided by the test duration.
+
     PtResultTypeCount - Indicates the number of different result types.
 
 --*/
@@ -235,6 +347,7 @@ typedef enum _PT_RESULT_TYPE {
     PtResultInvalid,
     PtResultIterations,
     PtResultBytes,
+    PtResultMicroseconds,
     PtResultTypeCount
 } PT_RESULT_TYPE, *PPT_RESULT_TYPE;
 
@@ -281,6 +394,9 @@ Structure Description:
 
     Bytes - Stores the number of bytes the test processed.
 
+    Microseconds - Stores the average duration of an operation, in
+        microseconds.
+
 --*/
 
 typedef struct _PT_TEST_RESULT {
@@ -291,6 +407,7 @@ typedef struct _PT_TEST_RESULT {
     union {
         unsigned long long Iterations;
         unsigned long long Bytes;
+        unsigned long long Microseconds;
     } Data;
 
 } PT_TEST_RESULT, *PPT_TEST_RESULT;
@@ -526,6 +643,31 @@ Return Value:
 
 --*/
 
+void
+SpawnMain (
+    PPT_TEST_INFORMATION Test,
+    PPT_TEST_RESULT Result
+    );
+
+/*++
+
+Routine Description:
+
+    This routine performs the spawn performance benchmark test.
+
+Arguments:
+
+    Test - Supplies a pointer to the performance test being executed.
+
+    Result - Supplies a pointer to a performance test result structure that
+        receives the tests results.
+
+Return Value:
+
+    None.
+
+--*/
+
 void
 ExecMain (
     PPT_TEST_INFORMATION Test,
@@ -738,7 +880,7 @@ ReadMain (
 
 Routine Description:
 
-    This routine performs the read performance benchmark test.
+    This routine performs the read performance benchmark tests.
 
 Arguments:
 
@@ -953,6 +1095,32 @@ Return Value:
 
 --*/
 
+void
+StatDeepMain (
+    PPT_TEST_INFORMATION Test,
+    PPT_TEST_RESULT Result
+    );
+
+/*++
+
+Routine Description:
+
+    This routine performs the stat performance benchmark test on a file
+    nested several directories deep.
+
+Arguments:
+
+    Test - Supplies a pointer to the performance test being executed.
+
+    Result - Supplies a pointer to a performance test result structure that
+        receives the tests results.
+
+Return Value:
+
+    None.
+
+--*/
+
 void
 FstatMain (
     PPT_TEST_INFORMATION Test,
@@ -978,3 +1146,129 @@ Return Value:
 
 --*/
 
+void
+SchedLatencyMain (
+    PPT_TEST_INFORMATION Test,
+    PPT_TEST_RESULT Result
+    );
+
+/*++
+
+Routine Description:
+
+    This routine performs the scheduler wakeup latency benchmark tests.
+
+Arguments:
+
+    Test - Supplies a pointer to the performance test being executed.
+
+    Result - Supplies a pointer to a performance test result structure that
+        receives the tests results.
+
+Return Value:
+
+    None.
+
+--*/
+
+void
+QueuedLockMain (
+    PPT_TEST_INFORMATION Test,
+    PPT_TEST_RESULT Result
+    );
+
+/*++
+
+Routine Description:
+
+    This routine performs the kernel queued lock performance benchmark test.
+
+Arguments:
+
+    Test - Supplies a pointer to the performance test being executed.
+
+    Result - Supplies a pointer to a performance test result structure that
+        receives the tests results.
+
+Return Value:
+
+    None.
+
+--*/
+
+void
+EpollMain (
+    PPT_TEST_INFORMATION Test,
+    PPT_TEST_RESULT Result
+    );
+
+/*++
+
+Routine Description:
+
+    This routine performs the epoll performance benchmark test.
+
+Arguments:
+
+    Test - Supplies a pointer to the performance test being executed.
+
+    Result - Supplies a pointer to a performance test result structure that
+        receives the tests results.
+
+Return Value:
+
+    None.
+
+--*/
+
+void
+SendFileMain (
+    PPT_TEST_INFORMATION Test,
+    PPT_TEST_RESULT Result
+    );
+
+/*++
+
+Routine Description:
+
+    This routine performs the sendfile performance benchmark tests.
+
+Arguments:
+
+    Test - Supplies a pointer to the performance test being executed.
+
+    Result - Supplies a pointer to a performance test result structure that
+        receives the tests results.
+
+Return Value:
+
+    None.
+
+--*/
+
+void
+PipeStreamMain (
+    PPT_TEST_INFORMATION Test,
+    PPT_TEST_RESULT Result
+    );
+
+/*++
+
+Routine Description:
+
+    This routine performs the pipe and Unix socket streaming performance
+    benchmark tests, which write to a reader in another process.
+
+Arguments:
+
+    Test - Supplies a pointer to the performance test being executed.
+
+    Result - Supplies a pointer to a performance test result structure that
+        receives the tests results.
+
+Return Value:
+
+    None.
+
+--*/
+
@@ -14,6 +14,8 @@ Module Name:
 Abstract:
 
     This module implements the performance benchmark tests pipe I/O throughput.
+    It also measures streaming throughput over pipes and Unix domain sockets
+    to a reader in another process.
 
 Author:
 
@@ -32,6 +34,9 @@ Module Name:
 #include <stdlib.h>
 #include <errno.h>
 #include <signal.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
 #include "perftest.h"
@@ -42,6 +47,14 @@ Module Name:
 
 #define PT_PIPE_IO_BUFFER_SIZE 4096
 
+//
+// Define the message sizes used by the streaming tests.
+//
+
+#define PT_PIPE_STREAM_SMALL_SIZE 4096
+#define PT_PIPE_STREAM_LARGE_SIZE (256 * 1024)
+#define PT_PIPE_STREAM_DATAGRAM_LARGE_SIZE (64 * 1024)
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -189,6 +202,175 @@ Return Value:
     return;
 }
 
+void
+PipeStreamMain (
+    PPT_TEST_INFORMATION Test,
+    PPT_TEST_RESULT Result
+    )
+
+/*++
+
+Routine Description:
+
+    This routine performs the pipe and Unix socket streaming performance
+    benchmark tests, which write to a reader in another process.
+
+Arguments:
+
+    Test - Supplies a pointer to the performance test being executed.
+
+    Result - Supplies a pointer to a performance test result structure that
+        receives the tests results.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    char *Buffer;
+    ssize_t BytesCompleted;
+    int ChannelCreated;
+    pid_t Child;
+    int Descriptors[2];
+    size_t MessageSize;
+    int Status;
+    unsigned long long TotalBytes;
+
+    Buffer = NULL;
+    ChannelCreated = 0;
+    Child = -1;
+    Result->Type = PtResultBytes;
+    Result->Status = 0;
+    TotalBytes = 0;
+
+    //
+    // Create the channel. Either way, data is written to the second descriptor
+    // and read from the first.
+    //
+
+    switch (Test->TestType) {
+    case PtTestPipeIoLarge:
+        MessageSize = PT_PIPE_STREAM_LARGE_SIZE;
+        Status = pipe(Descriptors);
+        break;
+
+    case PtTestUnixStreamIo:
+        MessageSize = PT_PIPE_STREAM_SMALL_SIZE;
+        Status = socketpair(AF_UNIX, SOCK_STREAM, 0, Descriptors);
+        break;
+
+    case PtTestUnixStreamIoLarge:
+        MessageSize = PT_PIPE_STREAM_LARGE_SIZE;
+        Status = socketpair(AF_UNIX, SOCK_STREAM, 0, Descriptors);
+        break;
+
+    case PtTestUnixDatagramIo:
+        MessageSize = PT_PIPE_STREAM_SMALL_SIZE;
+        Status = socketpair(AF_UNIX, SOCK_DGRAM, 0, Descriptors);
+        break;
+
+    case PtTestUnixDatagramIoLarge:
+        MessageSize = PT_PIPE_STREAM_DATAGRAM_LARGE_SIZE;
+        Status = socketpair(AF_UNIX, SOCK_DGRAM, 0, Descriptors);
+        break;
+
+    default:
+        Result->Status = EINVAL;
+        goto StreamMainEnd;
+    }
+
+    if (Status != 0) {
+        Result->Status = errno;
+        goto StreamMainEnd;
+    }
+
+    ChannelCreated = 1;
+    Buffer = malloc(MessageSize);
+    if (Buffer == NULL) {
+        Result->Status = ENOMEM;
+        goto StreamMainEnd;
+    }
+
+    memset(Buffer, 'p', MessageSize);
+
+    //
+    // Fork a child to drain the channel. It is killed when the test is over,
+    // since a datagram reader never sees the end of the stream.
+    //
+
+    Child = fork();
+    if (Child < 0) {
+        Result->Status = errno;
+        goto StreamMainEnd;
+    }
+
+    if (Child == 0) {
+        close(Descriptors[1]);
+        do {
+            BytesCompleted = read(Descriptors[0], Buffer, MessageSize);
+
+        } while ((BytesCompleted > 0) ||
+                 ((BytesCompleted < 0) && (errno == EINTR)));
+
+        exit(0);
+    }
+
+    //
+    // Start the test. This snaps resource usage and starts the clock ticking.
+    //
+
+    Status = PtStartTimedTest(Test->Duration);
+    if (Status != 0) {
+        Result->Status = errno;
+        goto StreamMainEnd;
+    }
+
+    //
+    // Measure throughput by writing messages as fast as the reader will take
+    // them, counting the bytes written.
+    //
+
+    while (PtIsTimedTestRunning() != 0) {
+        BytesCompleted = write(Descriptors[1], Buffer, MessageSize);
+        if (BytesCompleted < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            Result->Status = errno;
+            break;
+        }
+
+        TotalBytes += (unsigned long long)BytesCompleted;
+    }
+
+    Status = PtFinishTimedTest(Result);
+    if ((Status != 0) && (Result->Status == 0)) {
+        Result->Status = errno;
+    }
+
+StreamMainEnd:
+    if (Child > 0) {
+        kill(Child, SIGKILL);
+        waitpid(Child, NULL, 0);
+    }
+
+    if (ChannelCreated != 0) {
+        close(Descriptors[0]);
+        close(Descriptors[1]);
+    }
+
+    if (Buffer != NULL) {
+        free(Buffer);
+    }
+
+    Result->Data.Bytes = TotalBytes;
+    return;
+}
+
 //
 // --------------------------------------------------------- Internal Functions
 //
@@ -0,0 +1,247 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    qlock.c
+
+Abstract:
+
+    This module implements the kernel queued lock performance benchmark test.
+    Kernel locks cannot be reached directly from user mode, so the test has
+    several threads duplicating and closing descriptors, which all serialize
+    on the queued lock guarding the process handle table.
+
+Author:
+
+    agent 16-Oct-2026
+
+Environment:
+
+    User
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "perftest.h"
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+#define PT_QUEUED_LOCK_TEST_THREAD_COUNT 8
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+void *
+QueuedLockStartRoutine (
+    void *Parameter
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+volatile int QueuedLockReadyThreadCount;
+pthread_mutex_t QueuedLockReadyMutex = PTHREAD_MUTEX_INITIALIZER;
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+void
+QueuedLockMain (
+    PPT_TEST_INFORMATION Test,
+    PPT_TEST_RESULT Result
+    )
+
+/*++
+
+Routine Description:
+
+    This routine performs the kernel queued lock performance benchmark test.
+
+Arguments:
+
+    Test - Supplies a pointer to the performance test being executed.
+
+    Result - Supplies a pointer to a performance test result structure that
+        receives the tests results.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    int FileDescriptor;
+    unsigned long long Iterations;
+    int Status;
+    int ThreadCount;
+    int ThreadIndex;
+    pthread_t *Threads;
+
+    assert(Test->TestType == PtTestQueuedLockContended);
+
+    Iterations = 0;
+    Result->Type = PtResultIterations;
+    Result->Status = 0;
+    ThreadIndex = 0;
+    Threads = malloc(sizeof(pthread_t) * PT_QUEUED_LOCK_TEST_THREAD_COUNT);
+    if (Threads == NULL) {
+        Result->Status = ENOMEM;
+        goto MainEnd;
+    }
+
+    for (ThreadIndex = 0;
+         ThreadIndex < PT_QUEUED_LOCK_TEST_THREAD_COUNT;
+         ThreadIndex += 1) {
+
+        Status = pthread_create(&(Threads[ThreadIndex]),
+                                NULL,
+                                QueuedLockStartRoutine,
+                                NULL);
+
+        if (Status != 0) {
+            Result->Status = Status;
+            goto MainEnd;
+        }
+    }
+
+    //
+    // Wait until all threads are spun up.
+    //
+
+    while (QueuedLockReadyThreadCount != PT_QUEUED_LOCK_TEST_THREAD_COUNT) {
+        sleep(1);
+    }
+
+    //
+    // Start the test. This snaps resource usage and starts the clock ticking.
+    //
+
+    Status = PtStartTimedTest(Test->Duration);
+    if (Status != 0) {
+        Result->Status = errno;
+        goto MainEnd;
+    }
+
+    //
+    // Count how many times this thread can get through the handle table lock
+    // while the other threads hammer on it too.
+    //
+
+    while (PtIsTimedTestRunning() != 0) {
+        FileDescriptor = dup(STDOUT_FILENO);
+        if (FileDescriptor < 0) {
+            Result->Status = errno;
+            break;
+        }
+
+        close(FileDescriptor);
+        Iterations += 1;
+    }
+
+    Status = PtFinishTimedTest(Result);
+    if ((Status != 0) && (Result->Status == 0)) {
+        Result->Status = errno;
+    }
+
+MainEnd:
+    if (Threads != NULL) {
+        ThreadCount = ThreadIndex;
+        for (ThreadIndex = 0; ThreadIndex < ThreadCount; ThreadIndex += 1) {
+            pthread_cancel(Threads[ThreadIndex]);
+            pthread_join(Threads[ThreadIndex], NULL);
+        }
+
+        free(Threads);
+    }
+
+    Result->Data.Iterations = Iterations;
+    return;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+void *
+QueuedLockStartRoutine (
+    void *Parameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine implements the start routine for a new test thread. It will
+    wait in a loop for the test to start and then loop duplicating and closing
+    a descriptor.
+
+Arguments:
+
+    Parameter - Supplies an unused parameter.
+
+Return Value:
+
+    Returns the NULL pointer.
+
+--*/
+
+{
+
+    int FileDescriptor;
+
+    //
+    // Announce that the thread is ready.
+    //
+
+    pthread_mutex_lock(&QueuedLockReadyMutex);
+    QueuedLockReadyThreadCount += 1;
+    pthread_mutex_unlock(&QueuedLockReadyMutex);
+
+    //
+    // Busy spin waiting for the test to start.
+    //
+
+    while (PtIsTimedTestRunning() == 0) {
+        pthread_testcancel();
+    }
+
+    //
+    // Loop running the test.
+    //
+
+    while (PtIsTimedTestRunning() != 0) {
+        FileDescriptor = dup(STDOUT_FILENO);
+        if (FileDescriptor >= 0) {
+            close(FileDescriptor);
+        }
+    }
+
+    return NULL;
+}
@@ -14,7 +14,8 @@ Module Name:
 Abstract:
 
     This module implements the performance benchmark tests for the read() C
-    library routine.
+    library routine, both reading a file front to back and reading random
+    blocks of a large file.
 
 Author:
 
@@ -30,10 +31,12 @@ Module Name:
 // ------------------------------------------------------------------- Includes
 //
 
+#include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "perftest.h"
@@ -46,6 +49,15 @@ Module Name:
 #define PT_READ_TEST_FILE_SIZE (2 * 1024 * 1024)
 #define PT_READ_TEST_BUFFER_SIZE 4096
 
+//
+// The random read test uses a much larger file so that, with a few processes
+// running, the reads spill out of the page cache and reach the disk. Many
+// outstanding random reads are what command queuing in the disk drivers is
+// meant to help with.
+//
+
+#define PT_READ_RANDOM_TEST_FILE_SIZE (64 * 1024 * 1024)
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -72,7 +84,7 @@ ReadMain (
 
 Routine Description:
 
-    This routine performs the read performance benchmark test.
+    This routine performs the read performance benchmark tests.
 
 Arguments:
 
@@ -89,6 +101,7 @@ Return Value:
 
 {
 
+    int BlockCount;
     char *Buffer;
     ssize_t BytesRead;
     ssize_t BytesWritten;
@@ -96,10 +109,20 @@ Return Value:
     int FileDescriptor;
     char FileName[PT_READ_TEST_FILE_NAME_LENGTH];
     int Index;
+    off_t Offset;
     pid_t ProcessId;
+    unsigned int Seed;
     int Status;
     unsigned long long TotalBytes;
 
+    assert((Test->TestType == PtTestRead) ||
+           (Test->TestType == PtTestReadRandom));
+
+    BlockCount = PT_READ_TEST_FILE_SIZE / PT_READ_TEST_BUFFER_SIZE;
+    if (Test->TestType == PtTestReadRandom) {
+        BlockCount = PT_READ_RANDOM_TEST_FILE_SIZE / PT_READ_TEST_BUFFER_SIZE;
+    }
+
     FileCreated = 0;
     FileDescriptor = -1;
     Result->Type = PtResultBytes;
@@ -154,9 +177,7 @@ Return Value:
     // various implementations of fruncate() file extension.
     //
 
-    for (Index = 0;
-         Index < (PT_READ_TEST_FILE_SIZE / PT_READ_TEST_BUFFER_SIZE);
-         Index += 1) {
+    for (Index = 0; Index < BlockCount; Index += 1) {
 
         do {
             BytesWritten = write(FileDescriptor,
@@ -186,6 +207,34 @@ Return Value:
         goto MainEnd;
     }
 
+    //
+    // The file was just written, so all of it is still in the page cache.
+    // Drop it from the cache so the reads actually go to the disk, and the
+    // access pattern advice below has something to act on.
+    //
+
+    posix_fadvise(FileDescriptor, 0, 0, POSIX_FADV_DONTNEED);
+
+    //
+    // The file is either read front to back or at random, so let the system
+    // know. It can then read ahead, or avoid reading ahead data that will not
+    // be used.
+    //
+
+    if (Test->TestType == PtTestReadRandom) {
+        posix_fadvise(FileDescriptor, 0, 0, POSIX_FADV_RANDOM);
+
+    } else {
+        posix_fadvise(FileDescriptor, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+
+    //
+    // Get a process-specific seed for the random number generator so that
+    // multiple processes do not all read the same blocks.
+    //
+
+    Seed = time(NULL) ^ ProcessId;
+
     //
     // Start the test. This snaps resource usage and starts the clock ticking.
     //
@@ -202,6 +251,32 @@ Return Value:
     //
 
     while (PtIsTimedTestRunning() != 0) {
+        if (Test->TestType == PtTestReadRandom) {
+            Offset = (off_t)(rand_r(&Seed) % BlockCount) *
+                     PT_READ_TEST_BUFFER_SIZE;
+
+            do {
+                BytesRead = pread(FileDescriptor,
+                                  Buffer,
+                                  PT_READ_TEST_BUFFER_SIZE,
+                                  Offset);
+
+            } while ((BytesRead < 0) && (errno == EINTR));
+
+            if (BytesRead < 0) {
+                Result->Status = errno;
+                break;
+            }
+
+            if (BytesRead != PT_READ_TEST_BUFFER_SIZE) {
+                Result->Status = EIO;
+                break;
+            }
+
+            TotalBytes += (unsigned long long)BytesRead;
+            continue;
+        }
+
         do {
             BytesRead = read(FileDescriptor, Buffer, PT_READ_TEST_BUFFER_SIZE);
 
@@ -0,0 +1,406 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    schedlat.c
+
+Abstract:
+
+    This module implements the scheduler wakeup latency performance benchmark
+    tests.
+
+Author:
+
+    agent 16-Oct-2026
+
+Environment:
+
+    User
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "perftest.h"
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+//
+// Define the number of CPU-bound threads to create per processor for the
+// loaded variant of the test.
+//
+
+#define SCHED_LATENCY_BATCH_THREADS_PER_PROCESSOR 2
+
+//
+// Define how long the waker sleeps between wakeups, in nanoseconds. This is
+// long enough for the sleeper to block again before the next wakeup.
+//
+
+#define SCHED_LATENCY_WAKE_INTERVAL 2000000
+
+#define NANOSECONDS_PER_SECOND 1000000000ULL
+#define NANOSECONDS_PER_MICROSECOND 1000ULL
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+/*++
+
+Structure Description:
+
+    This structure stores the state shared between the threads of the
+    scheduler latency test.
+
+Members:
+
+    Pipe - Stores the pipe the waker writes time stamps into to wake the
+        sleeper.
+
+    Stop - Stores a boolean indicating whether the batch threads should exit.
+
+    TotalNanoseconds - Stores the sum of all measured wakeup latencies.
+
+    Samples - Stores the number of wakeups measured.
+
+--*/
+
+typedef struct _SCHED_LATENCY_CONTEXT {
+    int Pipe[2];
+    volatile int Stop;
+    unsigned long long TotalNanoseconds;
+    unsigned long long Samples;
+} SCHED_LATENCY_CONTEXT, *PSCHED_LATENCY_CONTEXT;
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+void *
+SchedLatencySleeperRoutine (
+    void *Parameter
+    );
+
+void *
+SchedLatencyBatchRoutine (
+    void *Parameter
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+void
+SchedLatencyMain (
+    PPT_TEST_INFORMATION Test,
+    PPT_TEST_RESULT Result
+    )
+
+/*++
+
+Routine Description:
+
+    This routine performs the scheduler wakeup latency benchmark tests. The
+    main thread periodically wakes a sleeping thread through a pipe, and the
+    sleeper measures how long it took to run after the wakeup was issued.
+
+Arguments:
+
+    Test - Supplies a pointer to the performance test being executed.
+
+    Result - Supplies a pointer to a performance test result structure that
+        receives the tests results.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    int BatchCount;
+    int BatchIndex;
+    pthread_t *BatchThreads;
+    SCHED_LATENCY_CONTEXT Context;
+    struct timespec Interval;
+    long ProcessorCount;
+    pthread_t Sleeper;
+    int SleeperCreated;
+    struct timespec Stamp;
+    int Status;
+
+    BatchCount = 0;
+    BatchIndex = 0;
+    BatchThreads = NULL;
+    SleeperCreated = 0;
+    memset(&Context, 0, sizeof(SCHED_LATENCY_CONTEXT));
+    Context.Pipe[0] = -1;
+    Context.Pipe[1] = -1;
+    Result->Type = PtResultMicroseconds;
+    Result->Status = 0;
+    Status = pipe(Context.Pipe);
+    if (Status != 0) {
+        Result->Status = errno;
+        goto MainEnd;
+    }
+
+    //
+    // Initialize the given test state.
+    //
+
+    switch (Test->TestType) {
+    case PtTestSchedLatency:
+        break;
+
+    case PtTestSchedLatencyLoaded:
+        ProcessorCount = sysconf(_SC_NPROCESSORS_ONLN);
+        if (ProcessorCount <= 0) {
+            ProcessorCount = 1;
+        }
+
+        BatchCount = ProcessorCount *
+                     SCHED_LATENCY_BATCH_THREADS_PER_PROCESSOR;
+
+        BatchThreads = malloc(sizeof(pthread_t) * BatchCount);
+        if (BatchThreads == NULL) {
+            Result->Status = ENOMEM;
+            goto MainEnd;
+        }
+
+        for (BatchIndex = 0; BatchIndex < BatchCount; BatchIndex += 1) {
+            Status = pthread_create(&(BatchThreads[BatchIndex]),
+                                    NULL,
+                                    SchedLatencyBatchRoutine,
+                                    &Context);
+
+            if (Status != 0) {
+                Result->Status = Status;
+                goto MainEnd;
+            }
+        }
+
+        break;
+
+    default:
+
+        assert(0);
+
+        Result->Status = EINVAL;
+        goto MainEnd;
+    }
+
+    Status = pthread_create(&Sleeper,
+                            NULL,
+                            SchedLatencySleeperRoutine,
+                            &Context);
+
+    if (Status != 0) {
+        Result->Status = Status;
+        goto MainEnd;
+    }
+
+    SleeperCreated = 1;
+
+    //
+    // Start the test. This snaps resource usage and starts the clock ticking.
+    //
+
+    Status = PtStartTimedTest(Test->Duration);
+    if (Status != 0) {
+        Result->Status = errno;
+        goto MainEnd;
+    }
+
+    //
+    // Periodically wake the sleeper, handing it the time the wakeup was
+    // issued.
+    //
+
+    Interval.tv_sec = 0;
+    Interval.tv_nsec = SCHED_LATENCY_WAKE_INTERVAL;
+    while (PtIsTimedTestRunning() != 0) {
+        nanosleep(&Interval, NULL);
+        clock_gettime(CLOCK_MONOTONIC, &Stamp);
+        do {
+            Status = write(Context.Pipe[1], &Stamp, sizeof(Stamp));
+
+        } while ((Status < 0) && (errno == EINTR));
+
+        if (Status != sizeof(Stamp)) {
+            Result->Status = errno;
+            break;
+        }
+    }
+
+    Status = PtFinishTimedTest(Result);
+    if ((Status != 0) && (Result->Status == 0)) {
+        Result->Status = errno;
+    }
+
+MainEnd:
+
+    //
+    // Closing the write side of the pipe causes the sleeper to exit.
+    //
+
+    if (Context.Pipe[1] >= 0) {
+        close(Context.Pipe[1]);
+    }
+
+    if (SleeperCreated != 0) {
+        pthread_join(Sleeper, NULL);
+    }
+
+    Context.Stop = 1;
+    if (BatchThreads != NULL) {
+        BatchCount = BatchIndex;
+        for (BatchIndex = 0; BatchIndex < BatchCount; BatchIndex += 1) {
+            pthread_join(BatchThreads[BatchIndex], NULL);
+        }
+
+        free(BatchThreads);
+    }
+
+    if (Context.Pipe[0] >= 0) {
+        close(Context.Pipe[0]);
+    }
+
+    Result->Data.Microseconds = 0;
+    if (Context.Samples != 0) {
+        Result->Data.Microseconds = Context.TotalNanoseconds /
+                                    Context.Samples /
+                                    NANOSECONDS_PER_MICROSECOND;
+
+    } else if (Result->Status == 0) {
+        Result->Status = EIO;
+    }
+
+    return;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+void *
+SchedLatencySleeperRoutine (
+    void *Parameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine implements the thread that blocks on the pipe and measures
+    how long it takes to run once it is woken.
+
+Arguments:
+
+    Parameter - Supplies a pointer to the test context.
+
+Return Value:
+
+    Returns the NULL pointer.
+
+--*/
+
+{
+
+    PSCHED_LATENCY_CONTEXT Context;
+    long long Latency;
+    struct timespec Now;
+    ssize_t Size;
+    struct timespec Stamp;
+
+    Context = Parameter;
+    while (1) {
+        Size = read(Context->Pipe[0], &Stamp, sizeof(Stamp));
+        if (Size < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            break;
+        }
+
+        if (Size != sizeof(Stamp)) {
+            break;
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &Now);
+        Latency = ((long long)(Now.tv_sec - Stamp.tv_sec) *
+                   NANOSECONDS_PER_SECOND) +
+                  (Now.tv_nsec - Stamp.tv_nsec);
+
+        if (Latency < 0) {
+            Latency = 0;
+        }
+
+        Context->TotalNanoseconds += Latency;
+        Context->Samples += 1;
+    }
+
+    return NULL;
+}
+
+void *
+SchedLatencyBatchRoutine (
+    void *Parameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine implements a CPU-bound thread that competes with the sleeper
+    for the processor.
+
+Arguments:
+
+    Parameter - Supplies a pointer to the test context.
+
+Return Value:
+
+    Returns the NULL pointer.
+
+--*/
+
+{
+
+    PSCHED_LATENCY_CONTEXT Context;
+    volatile unsigned long Spin;
+
+    Context = Parameter;
+    Spin = 0;
+    while (Context->Stop == 0) {
+        Spin += 1;
+    }
+
+    return NULL;
+}
+
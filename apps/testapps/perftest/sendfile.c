@@ -0,0 +1,500 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    sendfile.c
+
+Abstract:
+
+    This module implements the performance benchmark tests that serve a
+    cached file over a loopback TCP connection, either with sendfile() or
+    with a read and write loop for comparison.
+
+Author:
+
+    agent 16-Oct-2026
+
+Environment:
+
+    User
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <arpa/inet.h>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "perftest.h"
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+#define PT_SEND_FILE_TEST_FILE_NAME_LENGTH 48
+#define PT_SEND_FILE_TEST_FILE_SIZE (16 * 1024 * 1024)
+#define PT_SEND_FILE_TEST_BUFFER_SIZE (64 * 1024)
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+int
+SendFileCreateConnection (
+    int *SendSocket,
+    int *ReceiveSocket
+    );
+
+ssize_t
+SendFileCopy (
+    int Socket,
+    int FileDescriptor,
+    off_t Offset,
+    char *Buffer
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+void
+SendFileMain (
+    PPT_TEST_INFORMATION Test,
+    PPT_TEST_RESULT Result
+    )
+
+/*++
+
+Routine Description:
+
+    This routine performs the sendfile performance benchmark tests.
+
+Arguments:
+
+    Test - Supplies a pointer to the performance test being executed.
+
+    Result - Supplies a pointer to a performance test result structure that
+        receives the tests results.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    char *Buffer;
+    ssize_t BytesRead;
+    ssize_t BytesSent;
+    ssize_t BytesWritten;
+    pid_t Child;
+    int FileCreated;
+    int FileDescriptor;
+    char FileName[PT_SEND_FILE_TEST_FILE_NAME_LENGTH];
+    int Index;
+    off_t Offset;
+    int ReceiveSocket;
+    int SendSocket;
+    int Status;
+    unsigned long long TotalBytes;
+
+    assert((Test->TestType == PtTestSendFile) ||
+           (Test->TestType == PtTestSendFileCopy));
+
+    Child = -1;
+    FileCreated = 0;
+    FileDescriptor = -1;
+    ReceiveSocket = -1;
+    SendSocket = -1;
+    Result->Type = PtResultBytes;
+    Result->Status = 0;
+    TotalBytes = 0;
+    Buffer = malloc(PT_SEND_FILE_TEST_BUFFER_SIZE);
+    if (Buffer == NULL) {
+        Result->Status = ENOMEM;
+        goto MainEnd;
+    }
+
+    memset(Buffer, 'f', PT_SEND_FILE_TEST_BUFFER_SIZE);
+
+    //
+    // Create a process specific file and fill it, which also leaves it in the
+    // page cache.
+    //
+
+    Status = snprintf(FileName,
+                      PT_SEND_FILE_TEST_FILE_NAME_LENGTH,
+                      "sendfile_%d.txt",
+                      getpid());
+
+    if (Status < 0) {
+        Result->Status = errno;
+        goto MainEnd;
+    }
+
+    FileDescriptor = open(FileName,
+                          O_RDWR | O_CREAT | O_TRUNC,
+                          S_IRUSR | S_IWUSR);
+
+    if (FileDescriptor < 0) {
+        Result->Status = errno;
+        goto MainEnd;
+    }
+
+    FileCreated = 1;
+    for (Index = 0;
+         Index < PT_SEND_FILE_TEST_FILE_SIZE / PT_SEND_FILE_TEST_BUFFER_SIZE;
+         Index += 1) {
+
+        do {
+            BytesWritten = write(FileDescriptor,
+                                 Buffer,
+                                 PT_SEND_FILE_TEST_BUFFER_SIZE);
+
+        } while ((BytesWritten < 0) && (errno == EINTR));
+
+        if (BytesWritten < 0) {
+            Result->Status = errno;
+            goto MainEnd;
+        }
+
+        if (BytesWritten != PT_SEND_FILE_TEST_BUFFER_SIZE) {
+            Result->Status = EIO;
+            goto MainEnd;
+        }
+    }
+
+    Status = fsync(FileDescriptor);
+    if (Status != 0) {
+        Result->Status = errno;
+        goto MainEnd;
+    }
+
+    Status = SendFileCreateConnection(&SendSocket, &ReceiveSocket);
+    if (Status != 0) {
+        Result->Status = Status;
+        goto MainEnd;
+    }
+
+    //
+    // Fork a child to drain the receiving end of the connection. It exits
+    // once the sending end is closed.
+    //
+
+    Child = fork();
+    if (Child < 0) {
+        Result->Status = errno;
+        goto MainEnd;
+    }
+
+    if (Child == 0) {
+        close(SendSocket);
+        do {
+            BytesRead = read(ReceiveSocket,
+                             Buffer,
+                             PT_SEND_FILE_TEST_BUFFER_SIZE);
+
+        } while ((BytesRead > 0) || ((BytesRead < 0) && (errno == EINTR)));
+
+        exit(0);
+    }
+
+    close(ReceiveSocket);
+    ReceiveSocket = -1;
+
+    //
+    // Start the test. This snaps resource usage and starts the clock ticking.
+    //
+
+    Status = PtStartTimedTest(Test->Duration);
+    if (Status != 0) {
+        Result->Status = errno;
+        goto MainEnd;
+    }
+
+    //
+    // Measure throughput by streaming the file over the connection again and
+    // again, counting the bytes sent.
+    //
+
+    Offset = 0;
+    while (PtIsTimedTestRunning() != 0) {
+        if (Test->TestType == PtTestSendFile) {
+            BytesSent = sendfile(SendSocket,
+                                 FileDescriptor,
+                                 &Offset,
+                                 PT_SEND_FILE_TEST_FILE_SIZE - Offset);
+
+        } else {
+            BytesSent = SendFileCopy(SendSocket,
+                                     FileDescriptor,
+                                     Offset,
+                                     Buffer);
+
+            if (BytesSent > 0) {
+                Offset += BytesSent;
+            }
+        }
+
+        if (BytesSent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            Result->Status = errno;
+            break;
+        }
+
+        if (BytesSent == 0) {
+            Result->Status = EIO;
+            break;
+        }
+
+        if (Offset >= PT_SEND_FILE_TEST_FILE_SIZE) {
+            Offset = 0;
+        }
+
+        TotalBytes += (unsigned long long)BytesSent;
+    }
+
+    Status = PtFinishTimedTest(Result);
+    if ((Status != 0) && (Result->Status == 0)) {
+        Result->Status = errno;
+    }
+
+MainEnd:
+    if (SendSocket >= 0) {
+        close(SendSocket);
+    }
+
+    if (ReceiveSocket >= 0) {
+        close(ReceiveSocket);
+    }
+
+    if (Child > 0) {
+        waitpid(Child, NULL, 0);
+    }
+
+    if (FileCreated != 0) {
+        close(FileDescriptor);
+        remove(FileName);
+    }
+
+    if (Buffer != NULL) {
+        free(Buffer);
+    }
+
+    Result->Data.Bytes = TotalBytes;
+    return;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+int
+SendFileCreateConnection (
+    int *SendSocket,
+    int *ReceiveSocket
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates a connected pair of loopback TCP sockets.
+
+Arguments:
+
+    SendSocket - Supplies a pointer where the connecting socket will be
+        returned.
+
+    ReceiveSocket - Supplies a pointer where the accepted socket will be
+        returned.
+
+Return Value:
+
+    0 on success.
+
+    Returns an error number on failure.
+
+--*/
+
+{
+
+    struct sockaddr_in Address;
+    socklen_t AddressLength;
+    int Client;
+    int Listener;
+    int Server;
+    int Status;
+
+    Client = -1;
+    Server = -1;
+    Listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (Listener < 0) {
+        Status = errno;
+        goto CreateConnectionEnd;
+    }
+
+    memset(&Address, 0, sizeof(Address));
+    Address.sin_family = AF_INET;
+    Address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    Address.sin_port = 0;
+    Status = bind(Listener, (struct sockaddr *)&Address, sizeof(Address));
+    if (Status != 0) {
+        Status = errno;
+        goto CreateConnectionEnd;
+    }
+
+    Status = listen(Listener, 1);
+    if (Status != 0) {
+        Status = errno;
+        goto CreateConnectionEnd;
+    }
+
+    AddressLength = sizeof(Address);
+    Status = getsockname(Listener, (struct sockaddr *)&Address, &AddressLength);
+    if (Status != 0) {
+        Status = errno;
+        goto CreateConnectionEnd;
+    }
+
+    Client = socket(AF_INET, SOCK_STREAM, 0);
+    if (Client < 0) {
+        Status = errno;
+        goto CreateConnectionEnd;
+    }
+
+    Status = connect(Client, (struct sockaddr *)&Address, sizeof(Address));
+    if (Status != 0) {
+        Status = errno;
+        goto CreateConnectionEnd;
+    }
+
+    Server = accept(Listener, NULL, NULL);
+    if (Server < 0) {
+        Status = errno;
+        goto CreateConnectionEnd;
+    }
+
+    Status = 0;
+
+CreateConnectionEnd:
+    if (Listener >= 0) {
+        close(Listener);
+    }
+
+    if (Status != 0) {
+        if (Client >= 0) {
+            close(Client);
+            Client = -1;
+        }
+
+        if (Server >= 0) {
+            close(Server);
+            Server = -1;
+        }
+    }
+
+    *SendSocket = Client;
+    *ReceiveSocket = Server;
+    return Status;
+}
+
+ssize_t
+SendFileCopy (
+    int Socket,
+    int FileDescriptor,
+    off_t Offset,
+    char *Buffer
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sends one buffer's worth of the file the traditional way, by
+    reading it into user mode and writing it back out to the socket.
+
+Arguments:
+
+    Socket - Supplies the socket to send to.
+
+    FileDescriptor - Supplies the file to send from.
+
+    Offset - Supplies the offset in the file to send from.
+
+    Buffer - Supplies a pointer to the scratch buffer to use.
+
+Return Value:
+
+    Returns the number of bytes sent on success.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
+{
+
+    ssize_t BytesRead;
+    ssize_t BytesWritten;
+    ssize_t TotalWritten;
+
+    BytesRead = pread(FileDescriptor,
+                      Buffer,
+                      PT_SEND_FILE_TEST_BUFFER_SIZE,
+                      Offset);
+
+    if (BytesRead <= 0) {
+        return BytesRead;
+    }
+
+    TotalWritten = 0;
+    while (TotalWritten < BytesRead) {
+        BytesWritten = write(Socket,
+                             Buffer + TotalWritten,
+                             BytesRead - TotalWritten);
+
+        if (BytesWritten < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            return -1;
+        }
+
+        TotalWritten += BytesWritten;
+    }
+
+    return TotalWritten;
+}
+
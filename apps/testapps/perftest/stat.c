@@ -44,6 +44,14 @@ Module Name:
 #define PT_STAT_TEST_FILE_NAME_LENGTH 48
 #define PT_FSTAT_TEST_FILE_NAME_LENGTH 49
 
+//
+// Define the number of directories the deep stat test nests its file under,
+// and the size of the buffer holding the path.
+//
+
+#define PT_STAT_DEEP_TEST_DEPTH 16
+#define PT_STAT_DEEP_TEST_PATH_LENGTH 256
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -52,6 +60,14 @@ Module Name:
 // ----------------------------------------------- Internal Function Prototypes
 //
 
+void
+PtpStatDeepGetPath (
+    char *Path,
+    pid_t ProcessId,
+    int Depth,
+    int File
+    );
+
 //
 // -------------------------------------------------------------------- Globals
 //
@@ -163,6 +179,121 @@ Return Value:
     return;
 }
 
+void
+StatDeepMain (
+    PPT_TEST_INFORMATION Test,
+    PPT_TEST_RESULT Result
+    )
+
+/*++
+
+Routine Description:
+
+    This routine performs the stat performance benchmark test on a file
+    nested several directories deep, which stresses path walking.
+
+Arguments:
+
+    Test - Supplies a pointer to the performance test being executed.
+
+    Result - Supplies a pointer to a performance test result structure that
+        receives the tests results.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    int DirectoriesCreated;
+    int FileCreated;
+    int FileDescriptor;
+    unsigned long long Iterations;
+    char Path[PT_STAT_DEEP_TEST_PATH_LENGTH];
+    pid_t ProcessId;
+    struct stat Stat;
+    int Status;
+
+    DirectoriesCreated = 0;
+    FileCreated = 0;
+    Iterations = 0;
+    Result->Type = PtResultIterations;
+    Result->Status = 0;
+
+    //
+    // Create a process safe directory tree, with the file at the bottom.
+    //
+
+    ProcessId = getpid();
+    while (DirectoriesCreated <= PT_STAT_DEEP_TEST_DEPTH) {
+        PtpStatDeepGetPath(Path, ProcessId, DirectoriesCreated, 0);
+        Status = mkdir(Path, S_IRWXU);
+        if (Status != 0) {
+            Result->Status = errno;
+            goto MainEnd;
+        }
+
+        DirectoriesCreated += 1;
+    }
+
+    PtpStatDeepGetPath(Path, ProcessId, PT_STAT_DEEP_TEST_DEPTH, 1);
+    FileDescriptor = creat(Path, S_IRUSR | S_IWUSR);
+    if (FileDescriptor < 0) {
+        Result->Status = errno;
+        goto MainEnd;
+    }
+
+    close(FileDescriptor);
+    FileCreated = 1;
+
+    //
+    // Start the test. This snaps resource usage and starts the clock ticking.
+    //
+
+    Status = PtStartTimedTest(Test->Duration);
+    if (Status != 0) {
+        Result->Status = errno;
+        goto MainEnd;
+    }
+
+    //
+    // Measure the performance of the stat() C library routine by counting the
+    // number of times the stats for the deeply nested file can be queried.
+    //
+
+    while (PtIsTimedTestRunning() != 0) {
+        Status = stat(Path, &Stat);
+        if (Status != 0) {
+            Result->Status = errno;
+            break;
+        }
+
+        Iterations += 1;
+    }
+
+    Status = PtFinishTimedTest(Result);
+    if ((Status != 0) && (Result->Status == 0)) {
+        Result->Status = errno;
+    }
+
+MainEnd:
+    if (FileCreated != 0) {
+        PtpStatDeepGetPath(Path, ProcessId, PT_STAT_DEEP_TEST_DEPTH, 1);
+        remove(Path);
+    }
+
+    while (DirectoriesCreated != 0) {
+        DirectoriesCreated -= 1;
+        PtpStatDeepGetPath(Path, ProcessId, DirectoriesCreated, 0);
+        rmdir(Path);
+    }
+
+    Result->Data.Iterations = Iterations;
+    return;
+}
+
 void
 FstatMain (
     PPT_TEST_INFORMATION Test,
@@ -270,3 +401,62 @@ Return Value:
 // --------------------------------------------------------- Internal Functions
 //
 
+void
+PtpStatDeepGetPath (
+    char *Path,
+    pid_t ProcessId,
+    int Depth,
+    int File
+    )
+
+/*++
+
+Routine Description:
+
+    This routine builds the path to a directory or the file in the deep stat
+    test's directory tree.
+
+Arguments:
+
+    Path - Supplies a pointer to a buffer of PT_STAT_DEEP_TEST_PATH_LENGTH
+        bytes where the path will be returned.
+
+    ProcessId - Supplies the ID of the process that owns the tree.
+
+    Depth - Supplies the number of directories below the top of the tree.
+
+    File - Supplies a non-zero value to get the path of the file at the given
+        depth rather than the directory.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    int Length;
+    int Level;
+
+    Length = snprintf(Path,
+                      PT_STAT_DEEP_TEST_PATH_LENGTH,
+                      "stat_deep_%d",
+                      ProcessId);
+
+    for (Level = 1; Level <= Depth; Level += 1) {
+        Length += snprintf(Path + Length,
+                           PT_STAT_DEEP_TEST_PATH_LENGTH - Length,
+                           "/level%02d",
+                           Level);
+    }
+
+    if (File != 0) {
+        snprintf(Path + Length,
+                 PT_STAT_DEEP_TEST_PATH_LENGTH - Length,
+                 "/file.txt");
+    }
+
+    return;
+}
+
@@ -51,10 +51,24 @@ Module Name:
     "usage: vmstat\n\n"                                                    \
     "The vmstat utility prints information about current system memory \n" \
     "usage. Options are:\n"                                                \
+    "  -d, --disks -- Print block device request queue statistics.\n"      \
+    "  -l, --locks -- Print kernel queued and spin lock contention \n"     \
+    "      statistics.\n"                                                  \
+    "  -p, --processes -- Print the resident and working set size of \n"   \
+    "      each process.\n"                                                \
+    "  -s, --spin-profile=on|off -- Turn kernel spin lock contention \n"   \
+    "      profiling on or off. Turning it on clears the profile.\n"       \
+    "  -S, --slabinfo -- Print kernel object cache statistics.\n"          \
     "  --help -- Display this help text.\n"                                \
     "  --version -- Display the application version and exit.\n\n"
 
-#define VMSTAT_OPTIONS_STRING "hV"
+#define VMSTAT_OPTIONS_STRING "dlps:ShV"
+
+//
+// Define the number of most contended locks to print.
+//
+
+#define VMSTAT_LOCK_COUNT 20
 
 //
 // ------------------------------------------------------ Data Type Definitions
@@ -69,11 +83,58 @@ VmstatPrintInformation (
     VOID
     );
 
+INT
+VmstatPrintLockInformation (
+    VOID
+    );
+
+int
+VmstatCompareLockEntries (
+    const void *First,
+    const void *Second
+    );
+
+INT
+VmstatPrintSpinLockInformation (
+    VOID
+    );
+
+INT
+VmstatSetSpinLockProfiling (
+    BOOL Enable
+    );
+
+int
+VmstatCompareSpinLockEntries (
+    const void *First,
+    const void *Second
+    );
+
+INT
+VmstatPrintObjectCacheInformation (
+    VOID
+    );
+
+INT
+VmstatPrintBlockQueueInformation (
+    VOID
+    );
+
+INT
+VmstatPrintProcessInformation (
+    VOID
+    );
+
 //
 // -------------------------------------------------------------------- Globals
 //
 
 struct option VmstatLongOptions[] = {
+    {"disks", no_argument, 0, 'd'},
+    {"locks", no_argument, 0, 'l'},
+    {"processes", no_argument, 0, 'p'},
+    {"spin-profile", required_argument, 0, 's'},
+    {"slabinfo", no_argument, 0, 'S'},
     {"help", no_argument, 0, 'h'},
     {"version", no_argument, 0, 'V'},
     {NULL, 0, 0, 0}
@@ -148,6 +209,59 @@ Return Value:
         }
 
         switch (Option) {
+        case 'd':
+            ReturnValue = VmstatPrintBlockQueueInformation();
+            if (ReturnValue != 0) {
+                goto mainEnd;
+            }
+
+            break;
+
+        case 'l':
+            ReturnValue = VmstatPrintLockInformation();
+            if (ReturnValue != 0) {
+                goto mainEnd;
+            }
+
+            break;
+
+        case 'p':
+            ReturnValue = VmstatPrintProcessInformation();
+            if (ReturnValue != 0) {
+                goto mainEnd;
+            }
+
+            break;
+
+        case 's':
+            if (strcmp(optarg, "on") == 0) {
+                ReturnValue = VmstatSetSpinLockProfiling(TRUE);
+
+            } else if (strcmp(optarg, "off") == 0) {
+                ReturnValue = VmstatSetSpinLockProfiling(FALSE);
+
+            } else {
+                fprintf(stderr,
+                        "Error: invalid spin-profile argument '%s'.\n",
+                        optarg);
+
+                ReturnValue = EINVAL;
+            }
+
+            if (ReturnValue != 0) {
+                goto mainEnd;
+            }
+
+            break;
+
+        case 'S':
+            ReturnValue = VmstatPrintObjectCacheInformation();
+            if (ReturnValue != 0) {
+                goto mainEnd;
+            }
+
+            break;
+
         case 'V':
             printf("vmstat version %d.%02d\n",
                    VMSTAT_VERSION_MAJOR,
@@ -252,6 +366,14 @@ Return Value:
                  MmStatistics.PageSize) / _1MB;
 
     printf("Non-Paged Physical Memory: %I64dMB\n", Megabytes);
+    Megabytes = (MmStatistics.ActivePhysicalPages *
+                 MmStatistics.PageSize) / _1MB;
+
+    printf("Active Paged Memory: %I64dMB\n", Megabytes);
+    Megabytes = (MmStatistics.InactivePhysicalPages *
+                 MmStatistics.PageSize) / _1MB;
+
+    printf("Inactive Paged Memory: %I64dMB\n", Megabytes);
     printf("Non Paged Pool:\n");
     printf("    Size: %ld\n", MmStatistics.NonPagedPool.TotalHeapSize);
     printf("    Maximum Size: %ld\n", MmStatistics.NonPagedPool.MaxHeapSize);
@@ -306,3 +428,784 @@ Return Value:
     return ReturnValue;
 }
 
+INT
+VmstatPrintLockInformation (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine prints kernel queued lock contention statistics, including
+    the locks with the most time spent waiting on them.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    0 on success.
+
+    Non-zero on failure.
+
+--*/
+
+{
+
+    PQUEUED_LOCK_STATISTICS_ENTRY Entries;
+    PQUEUED_LOCK_STATISTICS_ENTRY Entry;
+    ULONG Index;
+    ULONGLONG Microseconds;
+    PVOID NewStatistics;
+    INT ReturnValue;
+    UINTN Size;
+    PQUEUED_LOCK_STATISTICS Statistics;
+    KSTATUS Status;
+
+    //
+    // Grow the buffer until all the contended locks fit.
+    //
+
+    ReturnValue = 0;
+    Statistics = NULL;
+    Size = sizeof(QUEUED_LOCK_STATISTICS) +
+           (64 * sizeof(QUEUED_LOCK_STATISTICS_ENTRY));
+
+    while (TRUE) {
+        NewStatistics = realloc(Statistics, Size);
+        if (NewStatistics == NULL) {
+            ReturnValue = ENOMEM;
+            goto PrintLockInformationEnd;
+        }
+
+        Statistics = NewStatistics;
+        memset(Statistics, 0, Size);
+        Statistics->Version = QUEUED_LOCK_STATISTICS_VERSION;
+        Status = OsGetSetSystemInformation(SystemInformationKe,
+                                           KeInformationQueuedLockStatistics,
+                                           Statistics,
+                                           &Size,
+                                           FALSE);
+
+        if (Status != STATUS_BUFFER_TOO_SMALL) {
+            break;
+        }
+
+        Size += 64 * sizeof(QUEUED_LOCK_STATISTICS_ENTRY);
+    }
+
+    if (!KSUCCESS(Status)) {
+        ReturnValue = ClConvertKstatusToErrorNumber(Status);
+        fprintf(stderr,
+                "Error: failed to get lock information: status %d: %s.\n",
+                Status,
+                strerror(ReturnValue));
+
+        goto PrintLockInformationEnd;
+    }
+
+    printf("Queued Locks: %d\n", Statistics->LockCount);
+    printf("    Acquires: %lld\n", Statistics->AcquireCount);
+    printf("    Contended: %lld (%lld without blocking)\n",
+           Statistics->ContendedCount,
+           Statistics->SpinAcquireCount);
+
+    Microseconds = (Statistics->WaitTime * 1000000ULL) /
+                   Statistics->TimeCounterFrequency;
+
+    printf("    Wait Time: %lldus\n", Microseconds);
+    if (Statistics->EntryCount == 0) {
+        goto PrintLockInformationEnd;
+    }
+
+    Entries = (PQUEUED_LOCK_STATISTICS_ENTRY)(Statistics + 1);
+    qsort(Entries,
+          Statistics->EntryCount,
+          sizeof(QUEUED_LOCK_STATISTICS_ENTRY),
+          VmstatCompareLockEntries);
+
+    printf("%-18s %12s %12s %12s %14s\n",
+           "Lock",
+           "Acquires",
+           "Contended",
+           "Spun",
+           "Wait (us)");
+
+    for (Index = 0; Index < Statistics->EntryCount; Index += 1) {
+        if (Index == VMSTAT_LOCK_COUNT) {
+            break;
+        }
+
+        Entry = &(Entries[Index]);
+        Microseconds = (Entry->WaitTime * 1000000ULL) /
+                       Statistics->TimeCounterFrequency;
+
+        printf("0x%016llx %12lld %12lld %12lld %14lld\n",
+               Entry->Lock,
+               Entry->AcquireCount,
+               Entry->ContendedCount,
+               Entry->SpinAcquireCount,
+               Microseconds);
+    }
+
+PrintLockInformationEnd:
+    if (Statistics != NULL) {
+        free(Statistics);
+    }
+
+    if (ReturnValue == 0) {
+        ReturnValue = VmstatPrintSpinLockInformation();
+    }
+
+    return ReturnValue;
+}
+
+int
+VmstatCompareLockEntries (
+    const void *First,
+    const void *Second
+    )
+
+/*++
+
+Routine Description:
+
+    This routine compares two queued lock statistics entries, ordering the
+    ones with the most wait time first.
+
+Arguments:
+
+    First - Supplies a pointer to the first entry.
+
+    Second - Supplies a pointer to the second entry.
+
+Return Value:
+
+    Less than zero if the first entry has more wait time.
+
+    Zero if the entries have equal wait time.
+
+    Greater than zero if the second entry has more wait time.
+
+--*/
+
+{
+
+    const QUEUED_LOCK_STATISTICS_ENTRY *FirstEntry;
+    const QUEUED_LOCK_STATISTICS_ENTRY *SecondEntry;
+
+    FirstEntry = First;
+    SecondEntry = Second;
+    if (FirstEntry->WaitTime > SecondEntry->WaitTime) {
+        return -1;
+
+    } else if (FirstEntry->WaitTime < SecondEntry->WaitTime) {
+        return 1;
+    }
+
+    return 0;
+}
+
+INT
+VmstatPrintSpinLockInformation (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine prints the kernel spin lock contention profile, starting with
+    the most contended locks.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    0 on success.
+
+    Non-zero on failure.
+
+--*/
+
+{
+
+    PSPIN_LOCK_STATISTICS_ENTRY Entries;
+    PSPIN_LOCK_STATISTICS_ENTRY Entry;
+    ULONG Index;
+    PVOID NewStatistics;
+    INT ReturnValue;
+    UINTN Size;
+    PSPIN_LOCK_STATISTICS Statistics;
+    KSTATUS Status;
+
+    ReturnValue = 0;
+    Statistics = NULL;
+    Size = sizeof(SPIN_LOCK_STATISTICS) +
+           (64 * sizeof(SPIN_LOCK_STATISTICS_ENTRY));
+
+    while (TRUE) {
+        NewStatistics = realloc(Statistics, Size);
+        if (NewStatistics == NULL) {
+            ReturnValue = ENOMEM;
+            goto PrintSpinLockInformationEnd;
+        }
+
+        Statistics = NewStatistics;
+        memset(Statistics, 0, Size);
+        Statistics->Version = SPIN_LOCK_STATISTICS_VERSION;
+        Status = OsGetSetSystemInformation(SystemInformationKe,
+                                           KeInformationSpinLockStatistics,
+                                           Statistics,
+                                           &Size,
+                                           FALSE);
+
+        if (Status != STATUS_BUFFER_TOO_SMALL) {
+            break;
+        }
+
+        Size += 64 * sizeof(SPIN_LOCK_STATISTICS_ENTRY);
+    }
+
+    if (!KSUCCESS(Status)) {
+        ReturnValue = ClConvertKstatusToErrorNumber(Status);
+        fprintf(stderr,
+                "Error: failed to get spin lock information: status %d: "
+                "%s.\n",
+                Status,
+                strerror(ReturnValue));
+
+        goto PrintSpinLockInformationEnd;
+    }
+
+    printf("\nSpin Lock Profiling: %s\n",
+           (Statistics->Enabled != FALSE) ? "on" : "off");
+
+    printf("    Contended Locks: %d (%lld dropped)\n",
+           Statistics->EntryCount,
+           Statistics->DroppedCount);
+
+    if (Statistics->EntryCount == 0) {
+        goto PrintSpinLockInformationEnd;
+    }
+
+    Entries = (PSPIN_LOCK_STATISTICS_ENTRY)(Statistics + 1);
+    qsort(Entries,
+          Statistics->EntryCount,
+          sizeof(SPIN_LOCK_STATISTICS_ENTRY),
+          VmstatCompareSpinLockEntries);
+
+    printf("%-18s %12s %14s %8s\n", "Lock", "Contended", "Spins", "Waiters");
+    for (Index = 0; Index < Statistics->EntryCount; Index += 1) {
+        if (Index == VMSTAT_LOCK_COUNT) {
+            break;
+        }
+
+        Entry = &(Entries[Index]);
+        printf("0x%016llx %12lld %14lld %8d\n",
+               Entry->Lock,
+               Entry->ContendedCount,
+               Entry->SpinCount,
+               Entry->MaximumWaiters);
+    }
+
+PrintSpinLockInformationEnd:
+    if (Statistics != NULL) {
+        free(Statistics);
+    }
+
+    return ReturnValue;
+}
+
+INT
+VmstatSetSpinLockProfiling (
+    BOOL Enable
+    )
+
+/*++
+
+Routine Description:
+
+    This routine turns kernel spin lock contention profiling on or off.
+
+Arguments:
+
+    Enable - Supplies a boolean indicating whether to turn profiling on
+        (TRUE) or off (FALSE). Turning it on clears the existing profile.
+
+Return Value:
+
+    0 on success.
+
+    Non-zero on failure.
+
+--*/
+
+{
+
+    INT ReturnValue;
+    UINTN Size;
+    SPIN_LOCK_STATISTICS Statistics;
+    KSTATUS Status;
+
+    memset(&Statistics, 0, sizeof(SPIN_LOCK_STATISTICS));
+    Statistics.Version = SPIN_LOCK_STATISTICS_VERSION;
+    Statistics.Enabled = Enable;
+    Size = sizeof(SPIN_LOCK_STATISTICS);
+    Status = OsGetSetSystemInformation(SystemInformationKe,
+                                       KeInformationSpinLockStatistics,
+                                       &Statistics,
+                                       &Size,
+                                       TRUE);
+
+    if (!KSUCCESS(Status)) {
+        ReturnValue = ClConvertKstatusToErrorNumber(Status);
+        fprintf(stderr,
+                "Error: failed to set spin lock profiling: status %d: %s.\n",
+                Status,
+                strerror(ReturnValue));
+
+        return ReturnValue;
+    }
+
+    return 0;
+}
+
+int
+VmstatCompareSpinLockEntries (
+    const void *First,
+    const void *Second
+    )
+
+/*++
+
+Routine Description:
+
+    This routine compares two spin lock statistics entries, ordering the most
+    contended ones first.
+
+Arguments:
+
+    First - Supplies a pointer to the first entry.
+
+    Second - Supplies a pointer to the second entry.
+
+Return Value:
+
+    Less than zero if the first entry was contended more often.
+
+    Zero if the entries were contended equally often.
+
+    Greater than zero if the second entry was contended more often.
+
+--*/
+
+{
+
+    const SPIN_LOCK_STATISTICS_ENTRY *FirstEntry;
+    const SPIN_LOCK_STATISTICS_ENTRY *SecondEntry;
+
+    FirstEntry = First;
+    SecondEntry = Second;
+    if (FirstEntry->ContendedCount > SecondEntry->ContendedCount) {
+        return -1;
+
+    } else if (FirstEntry->ContendedCount < SecondEntry->ContendedCount) {
+        return 1;
+    }
+
+    return 0;
+}
+
+INT
+VmstatPrintObjectCacheInformation (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine prints usage statistics for each kernel object cache.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    0 on success.
+
+    Non-zero on failure.
+
+--*/
+
+{
+
+    PMM_OBJECT_CACHE_STATISTICS_ENTRY Entries;
+    PMM_OBJECT_CACHE_STATISTICS_ENTRY Entry;
+    ULONG Index;
+    PVOID NewStatistics;
+    INT ReturnValue;
+    UINTN Size;
+    PMM_OBJECT_CACHE_STATISTICS Statistics;
+    KSTATUS Status;
+
+    ReturnValue = 0;
+    Statistics = NULL;
+    Size = sizeof(MM_OBJECT_CACHE_STATISTICS) +
+           (16 * sizeof(MM_OBJECT_CACHE_STATISTICS_ENTRY));
+
+    while (TRUE) {
+        NewStatistics = realloc(Statistics, Size);
+        if (NewStatistics == NULL) {
+            ReturnValue = ENOMEM;
+            goto PrintObjectCacheInformationEnd;
+        }
+
+        Statistics = NewStatistics;
+        memset(Statistics, 0, Size);
+        Statistics->Version = MM_OBJECT_CACHE_STATISTICS_VERSION;
+        Status = OsGetSetSystemInformation(SystemInformationMm,
+                                           MmInformationObjectCacheStatistics,
+                                           Statistics,
+                                           &Size,
+                                           FALSE);
+
+        if (Status != STATUS_BUFFER_TOO_SMALL) {
+            break;
+        }
+
+        Size += 16 * sizeof(MM_OBJECT_CACHE_STATISTICS_ENTRY);
+    }
+
+    if (!KSUCCESS(Status)) {
+        ReturnValue = ClConvertKstatusToErrorNumber(Status);
+        fprintf(stderr,
+                "Error: failed to get object cache information: status %d: "
+                "%s.\n",
+                Status,
+                strerror(ReturnValue));
+
+        goto PrintObjectCacheInformationEnd;
+    }
+
+    printf("%-16s %8s %8s %6s %6s %8s %12s %10s %10s\n",
+           "Cache",
+           "Active",
+           "Cached",
+           "Size",
+           "Slabs",
+           "SlabObjs",
+           "Allocations",
+           "Misses",
+           "Reclaimed");
+
+    Entries = (PMM_OBJECT_CACHE_STATISTICS_ENTRY)(Statistics + 1);
+    for (Index = 0; Index < Statistics->CacheCount; Index += 1) {
+        Entry = &(Entries[Index]);
+        Entry->Name[MM_OBJECT_CACHE_NAME_SIZE - 1] = '\0';
+        printf("%-16s %8ld %8ld %6d %6ld %8ld %12lld %10lld %10lld\n",
+               Entry->Name,
+               Entry->ActiveObjects,
+               Entry->CachedObjects,
+               Entry->ObjectStride,
+               Entry->SlabCount,
+               Entry->SlabObjects,
+               Entry->AllocationCount,
+               Entry->MissCount,
+               Entry->ReclaimCount);
+    }
+
+PrintObjectCacheInformationEnd:
+    if (Statistics != NULL) {
+        free(Statistics);
+    }
+
+    return ReturnValue;
+}
+
+INT
+VmstatPrintBlockQueueInformation (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine prints the request queue statistics for each block device.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    0 on success.
+
+    Non-zero on failure.
+
+--*/
+
+{
+
+    ULONGLONG AverageLatency;
+    PIO_BLOCK_QUEUE_STATISTICS_ENTRY Entries;
+    PIO_BLOCK_QUEUE_STATISTICS_ENTRY Entry;
+    ULONG Index;
+    PVOID NewStatistics;
+    PSTR Policy;
+    INT ReturnValue;
+    UINTN Size;
+    PIO_BLOCK_QUEUE_STATISTICS Statistics;
+    KSTATUS Status;
+
+    ReturnValue = 0;
+    Statistics = NULL;
+    Size = sizeof(IO_BLOCK_QUEUE_STATISTICS) +
+           (8 * sizeof(IO_BLOCK_QUEUE_STATISTICS_ENTRY));
+
+    while (TRUE) {
+        NewStatistics = realloc(Statistics, Size);
+        if (NewStatistics == NULL) {
+            ReturnValue = ENOMEM;
+            goto PrintBlockQueueInformationEnd;
+        }
+
+        Statistics = NewStatistics;
+        memset(Statistics, 0, Size);
+        Statistics->Version = IO_BLOCK_QUEUE_STATISTICS_VERSION;
+        Status = OsGetSetSystemInformation(SystemInformationIo,
+                                           IoInformationBlockQueueStatistics,
+                                           Statistics,
+                                           &Size,
+                                           FALSE);
+
+        if (Status != STATUS_BUFFER_TOO_SMALL) {
+            break;
+        }
+
+        Size += 8 * sizeof(IO_BLOCK_QUEUE_STATISTICS_ENTRY);
+    }
+
+    if (!KSUCCESS(Status)) {
+        ReturnValue = ClConvertKstatusToErrorNumber(Status);
+        fprintf(stderr,
+                "Error: failed to get block queue information: status %d: "
+                "%s.\n",
+                Status,
+                strerror(ReturnValue));
+
+        goto PrintBlockQueueInformationEnd;
+    }
+
+    printf("%-16s %-8s %5s %9s %9s %10s %10s %8s %10s %10s\n",
+           "Device",
+           "Policy",
+           "Depth",
+           "InFlight",
+           "Pending",
+           "Requests",
+           "Dispatched",
+           "Merges",
+           "AvgLatUs",
+           "MaxLatUs");
+
+    Entries = (PIO_BLOCK_QUEUE_STATISTICS_ENTRY)(Statistics + 1);
+    for (Index = 0; Index < Statistics->QueueCount; Index += 1) {
+        Entry = &(Entries[Index]);
+        Entry->DeviceName[IO_BLOCK_QUEUE_NAME_SIZE - 1] = '\0';
+        switch (Entry->Policy) {
+        case IoBlockQueuePolicyNoop:
+            Policy = "noop";
+            break;
+
+        case IoBlockQueuePolicyDeadline:
+            Policy = "deadline";
+            break;
+
+        default:
+            Policy = "unknown";
+            break;
+        }
+
+        AverageLatency = 0;
+        if (Entry->RequestCount != 0) {
+            AverageLatency = Entry->TotalLatency / Entry->RequestCount;
+        }
+
+        printf("%-16s %-8s %5d %4d/%-4d %4d/%-4d %10lld %10lld %8lld "
+               "%10lld %10lld\n",
+               Entry->DeviceName,
+               Policy,
+               Entry->Depth,
+               Entry->InFlight,
+               Entry->MaxInFlight,
+               Entry->Pending,
+               Entry->MaxPending,
+               Entry->RequestCount,
+               Entry->DispatchCount,
+               Entry->MergeCount,
+               AverageLatency,
+               Entry->MaxLatency);
+    }
+
+PrintBlockQueueInformationEnd:
+    if (Statistics != NULL) {
+        free(Statistics);
+    }
+
+    return ReturnValue;
+}
+
+INT
+VmstatPrintProcessInformation (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine prints the resident set and working set size of every
+    process in the system. The working set is the portion of the process's
+    pagable memory that has been referenced recently.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    0 on success.
+
+    Non-zero on failure.
+
+--*/
+
+{
+
+    UINTN Count;
+    UINTN Index;
+    PPROCESS_INFORMATION Information;
+    UINTN InformationSize;
+    PSTR Name;
+    PVOID NewInformation;
+    ULONG PageSize;
+    PPROCESS_ID ProcessIds;
+    INT ReturnValue;
+    UINTN Size;
+    KSTATUS Status;
+
+    Information = NULL;
+    InformationSize = sizeof(PROCESS_INFORMATION) + 256;
+    PageSize = sysconf(_SC_PAGE_SIZE);
+    ProcessIds = NULL;
+    ReturnValue = 0;
+
+    //
+    // Get the size of the process ID list, and leave some room for processes
+    // created in the meantime.
+    //
+
+    Size = 0;
+    OsGetSetSystemInformation(SystemInformationPs,
+                              PsInformationProcessIdList,
+                              NULL,
+                              &Size,
+                              FALSE);
+
+    Size *= 2;
+    ProcessIds = malloc(Size);
+    if (ProcessIds == NULL) {
+        ReturnValue = ENOMEM;
+        goto PrintProcessInformationEnd;
+    }
+
+    Status = OsGetSetSystemInformation(SystemInformationPs,
+                                       PsInformationProcessIdList,
+                                       ProcessIds,
+                                       &Size,
+                                       FALSE);
+
+    if (!KSUCCESS(Status)) {
+        ReturnValue = ClConvertKstatusToErrorNumber(Status);
+        fprintf(stderr,
+                "Error: failed to get process list: status %d: %s.\n",
+                Status,
+                strerror(ReturnValue));
+
+        goto PrintProcessInformationEnd;
+    }
+
+    printf("%7s %12s %12s  %s\n", "PID", "Resident", "Working", "Name");
+    Count = Size / sizeof(PROCESS_ID);
+    for (Index = 0; Index < Count; Index += 1) {
+
+        //
+        // Grow the buffer until the process name and arguments fit.
+        //
+
+        while (TRUE) {
+            NewInformation = realloc(Information, InformationSize);
+            if (NewInformation == NULL) {
+                ReturnValue = ENOMEM;
+                goto PrintProcessInformationEnd;
+            }
+
+            Information = NewInformation;
+            memset(Information, 0, InformationSize);
+            Information->Version = PROCESS_INFORMATION_VERSION;
+            Information->ProcessId = ProcessIds[Index];
+            Size = InformationSize;
+            Status = OsGetSetSystemInformation(SystemInformationPs,
+                                               PsInformationProcess,
+                                               Information,
+                                               &Size,
+                                               FALSE);
+
+            if ((Status != STATUS_BUFFER_TOO_SMALL) ||
+                (Size <= InformationSize)) {
+
+                break;
+            }
+
+            InformationSize = Size;
+        }
+
+        //
+        // The process may have exited since the list was taken.
+        //
+
+        if (!KSUCCESS(Status)) {
+            continue;
+        }
+
+        Name = "";
+        if (Information->NameOffset != 0) {
+            Name = (PSTR)Information + Information->NameOffset;
+        }
+
+        printf("%7d %10ldKB %10ldKB  %s\n",
+               Information->ProcessId,
+               (long)((Information->ResidentSet * PageSize) / _1KB),
+               (long)((Information->WorkingSet * PageSize) / _1KB),
+               Name);
+    }
+
+PrintProcessInformationEnd:
+    if (Information != NULL) {
+        free(Information);
+    }
+
+    if (ProcessIds != NULL) {
+        free(ProcessIds);
+    }
+
+    return ReturnValue;
+}
@@ -2188,13 +2188,15 @@ Return Value:
     AllocationSize = DescriptorCount * sizeof(MEMORY_DESCRIPTOR);
 
     //
-    // It also needs a word for each physical page, plus an extra page for the
-    // physical memory segments.
+    // It also needs a word and a pair of free list links for each physical
+    // page, plus an extra page for the physical memory segments.
     // Note: if the loader continues to be 32-bit for a 64-bit kernel, then
-    // this ULONG calculation is off.
+    // this UINTN calculation is off.
     //
 
-    AllocationSize += sizeof(ULONG) * (BoMemoryMap.TotalSpace >> PageShift);
+    AllocationSize += (sizeof(UINTN) + (2 * sizeof(ULONG))) *
+                      (BoMemoryMap.TotalSpace >> PageShift);
+
     AllocationSize += PageSize;
     AllocationSize = ALIGN_RANGE_UP(AllocationSize, PageSize);
     Status = BopAllocateKernelBuffer(AllocationSize,
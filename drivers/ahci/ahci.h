@@ -79,6 +79,17 @@ Module Name:
 #define SATA_GET_FIS_COUNT(_Fis)            \
     ((_Fis)->Count0 | ((_Fis)->Count1 << 8))
 
+//
+// Queued commands carry the sector count in the features register, as the
+// count register holds the tag.
+//
+
+#define SATA_SET_FIS_QUEUED_COUNT(_Fis, _Count)         \
+    do {                                                \
+        (_Fis)->FeaturesLow = (UCHAR)(_Count);          \
+        (_Fis)->FeaturesHigh = (UCHAR)((_Count) >> 8);  \
+    } while (FALSE)
+
 //
 // This macro determines the value to put in the CFL (command FIS length) of
 // the command header control member given a size in bytes.
@@ -112,6 +123,13 @@ Module Name:
 
 #define AHCI_PHY_DETECT_TIMEOUT_MS 50
 
+//
+// Define the amount of time to wait for the error log to be read back from a
+// device during error recovery, in milliseconds.
+//
+
+#define AHCI_ERROR_LOG_TIMEOUT_MS 1000
+
 #define AHCI_COMMAND_TABLE_ALIGNMENT 128
 #define AHCI_RECEIVE_FIS_MAX_SIZE 0x1000
 
@@ -141,7 +159,9 @@ Module Name:
 #define AHCI_PORT_LBA48 0x00000001
 
 //
-// This bit is set if native command queuing is enabled.
+// This bit is set if native command queuing is enabled. I/O is issued with the
+// first-party DMA queued commands, which allows the drive to reorder requests
+// across all the port's command slots.
 //
 
 #define AHCI_PORT_NATIVE_COMMAND_QUEUING 0x00000002
@@ -236,7 +256,7 @@ Module Name:
      AHCI_INTERRUPT_HOST_BUS_DATA_ERROR | \
      AHCI_INTERRUPT_HOST_BUS_FATAL_ERROR | \
      AHCI_INTERRUPT_TASK_FILE_ERROR | \
-     AHCI_INTERRUPT_TASK_FILE_ERROR)
+     AHCI_INTERRUPT_SET_DEVICE_BITS)
 
 #define AHCI_INTERRUPT_CONNECTION_MASK \
     (AHCI_INTERRUPT_PORT_CONNECT_CHANGE | \
@@ -253,6 +273,17 @@ Module Name:
      AHCI_INTERRUPT_HOST_BUS_FATAL_ERROR | \
      AHCI_INTERRUPT_TASK_FILE_ERROR)
 
+//
+// Define the errors that halt the port's command list. The port must be
+// restarted and the outstanding commands dealt with when one of these occurs.
+//
+
+#define AHCI_INTERRUPT_FATAL_MASK \
+    (AHCI_INTERRUPT_FATAL_ERROR | \
+     AHCI_INTERRUPT_HOST_BUS_DATA_ERROR | \
+     AHCI_INTERRUPT_HOST_BUS_FATAL_ERROR | \
+     AHCI_INTERRUPT_TASK_FILE_ERROR)
+
 //
 // Port command/status register bits.
 //
@@ -1012,6 +1043,10 @@ Structure Description:
 
     PendingCommands - Stores the mask of commands that are in use.
 
+    QueuedCommands - Stores the mask of pending commands that were issued as
+        native queued commands. These complete when their bit clears in the
+        SATA active register rather than the command issue register.
+
     OsDevice - Stores a pointer to the OS device for this port, if present.
 
     Flags - Stores a bitfield of flags about the port. See AHCI_PORT_*
@@ -1029,6 +1064,9 @@ Structure Description:
 
     IrpQueue - Stores the queue of IRPs that have not yet been started.
 
+    LogIoBuffer - Stores a pointer to the I/O buffer used to read the queued
+        command error log during error recovery.
+
 --*/
 
 typedef struct _AHCI_PORT {
@@ -1046,11 +1084,13 @@ typedef struct _AHCI_PORT {
     ULONG CommandMask;
     volatile ULONG AllocatedCommands;
     ULONG PendingCommands;
+    ULONG QueuedCommands;
     PDEVICE OsDevice;
     ULONG Flags;
     KSPIN_LOCK DpcLock;
     ULONGLONG TotalSectors;
     LIST_ENTRY IrpQueue;
+    PIO_BUFFER LogIoBuffer;
 } AHCI_PORT, *PAHCI_PORT;
 
 /*++
@@ -65,11 +65,35 @@ AhcipStopPort (
     );
 
 VOID
-AhcipBeginNextIrp (
+AhcipRecoverFromError (
+    PAHCI_PORT Port
+    );
+
+KSTATUS
+AhcipReadQueuedErrorLog (
+    PAHCI_PORT Port,
+    LONG Index,
+    PLONG FailedTag
+    );
+
+BOOL
+AhcipCanStartIrp (
+    PAHCI_PORT Port,
+    PIRP Irp
+    );
+
+KSTATUS
+AhcipStartIrp (
     PAHCI_PORT Port,
+    PIRP Irp,
     LONG HeaderIndex
     );
 
+VOID
+AhcipBeginQueuedIrps (
+    PAHCI_PORT Port
+    );
+
 VOID
 AhcipPerformDmaIo (
     PAHCI_PORT Port,
@@ -97,7 +121,8 @@ AhcipFreeCommand (
 VOID
 AhcipSubmitCommand (
     PAHCI_PORT Port,
-    ULONG Mask
+    ULONG Mask,
+    BOOL Queued
     );
 
 //
@@ -314,15 +339,13 @@ Return Value:
     //
     // Figure out the number of commands that can be simultaneously queued to
     // each port. If native queuing is not supported, then there's not much
-    // point.
+    // point, as commands are only ever issued one at a time.
     //
 
     CommandCount = (Capabilities & AHCI_HOST_CAPABILITY_COMMAND_SLOTS_MASK) >>
                    AHCI_HOST_CAPABILITY_COMMAND_SLOTS_SHIFT;
 
-    if (((Capabilities & AHCI_HOST_CAPABILITY_NATIVE_QUEUING) == 0) ||
-        ((Capabilities & AHCI_HOST_CAPABILITY_SNOTIFICATION) == 0)) {
-
+    if ((Capabilities & AHCI_HOST_CAPABILITY_NATIVE_QUEUING) == 0) {
         CommandCount = 0;
     }
 
@@ -356,6 +379,7 @@ Return Value:
         }
 
         Port->PendingCommands = 0;
+        Port->QueuedCommands = 0;
         if (CommandCount >= 32) {
             Port->CommandMask = ~0;
 
@@ -618,6 +642,7 @@ Return Value:
 {
 
     PAHCI_COMMAND_TABLE Command;
+    ULONG CommandCount;
     PSATA_FIS_REGISTER_H2D Fis;
     PAHCI_COMMAND_HEADER Header;
     LONG HeaderIndex;
@@ -625,6 +650,7 @@ Return Value:
     PIO_BUFFER IoBuffer;
     RUNLEVEL OldRunLevel;
     PAHCI_PRDT Prdt;
+    ULONG QueueDepth;
     KSTATUS Status;
     ULONG TaskFile;
 
@@ -640,6 +666,29 @@ Return Value:
 
     ASSERT(IoBuffer->FragmentCount == 1);
 
+    //
+    // If the controller can queue commands, allocate the buffer used to read
+    // the queued command error log now, as it cannot be allocated during
+    // error recovery.
+    //
+
+    CommandCount = Port->Controller->CommandCount;
+    if ((CommandCount > 1) && (Port->LogIoBuffer == NULL)) {
+        Port->LogIoBuffer = MmAllocateNonPagedIoBuffer(
+                                         0,
+                                         Port->Controller->MaxPhysical,
+                                         ATA_SECTOR_SIZE,
+                                         ATA_SECTOR_SIZE,
+                                         IO_BUFFER_FLAG_PHYSICALLY_CONTIGUOUS);
+
+        if (Port->LogIoBuffer == NULL) {
+            MmFreeIoBuffer(IoBuffer);
+            return STATUS_INSUFFICIENT_RESOURCES;
+        }
+
+        ASSERT(Port->LogIoBuffer->FragmentCount == 1);
+    }
+
     Identify = IoBuffer->Fragment[0].VirtualAddress;
     RtlZeroMemory(Identify, sizeof(ATA_IDENTIFY_PACKET));
     OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
@@ -671,16 +720,21 @@ Return Value:
     // Submit the command for execution.
     //
 
-    AhcipSubmitCommand(Port, 1 << HeaderIndex);
+    AhcipSubmitCommand(Port, 1 << HeaderIndex, FALSE);
 
     //
-    // Wait for the command to complete.
+    // Wait for the command to complete. The lock must be dropped, as the
+    // interrupt processing that retires the command acquires it.
     //
 
+    KeReleaseSpinLock(&(Port->DpcLock));
+    KeLowerRunLevel(OldRunLevel);
     while ((Port->PendingCommands & (1 << HeaderIndex)) != 0) {
         KeYield();
     }
 
+    OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+    KeAcquireSpinLock(&(Port->DpcLock));
     TaskFile = AHCI_READ(Port, AhciPortTaskFile);
     if ((TaskFile & AHCI_PORT_TASK_ERROR_MASK) != 0) {
         Status = STATUS_DEVICE_IO_ERROR;
@@ -699,6 +753,36 @@ Return Value:
         Port->TotalSectors = Identify->TotalSectors;
     }
 
+    //
+    // Use native command queuing if both the controller and the drive support
+    // it. The queued commands are all 48-bit commands, so the drive must
+    // support those too. The queue depth is the smaller of the number of
+    // controller slots and the depth the drive advertises.
+    //
+
+    if ((CommandCount > 1) &&
+        (Port->LogIoBuffer != NULL) &&
+        ((Port->Flags & AHCI_PORT_LBA48) != 0) &&
+        ((Identify->SataCapabilities &
+          ATA_SATA_CAPABILITY_NATIVE_COMMAND_QUEUING) != 0)) {
+
+        QueueDepth = (Identify->QueueDepth & ATA_QUEUE_DEPTH_MASK) + 1;
+        if (QueueDepth > CommandCount) {
+            QueueDepth = CommandCount;
+        }
+
+        if (QueueDepth > 1) {
+            if (QueueDepth >= 32) {
+                Port->CommandMask = ~0;
+
+            } else {
+                Port->CommandMask = (1 << QueueDepth) - 1;
+            }
+
+            Port->Flags |= AHCI_PORT_NATIVE_COMMAND_QUEUING;
+        }
+    }
+
     Status = STATUS_SUCCESS;
 
 EnumeratePortEnd:
@@ -763,42 +847,27 @@ Return Value:
         goto EnqueueIrpEnd;
     }
 
-    HeaderIndex = AhcipAllocateCommand(Port);
-
     //
     // Transfers may already be in progress that are taking up all the command
-    // slots. Queue the command if so. If a real allocation failure occured,
-    // bail out.
+    // slots, or that cannot be mixed with this command. Queue the command if
+    // so. Anything already in the queue goes first to keep IRPs from passing
+    // a waiting cache flush.
     //
 
+    HeaderIndex = -1;
+    if ((LIST_EMPTY(&(Port->IrpQueue)) != FALSE) &&
+        (AhcipCanStartIrp(Port, Irp) != FALSE)) {
+
+        HeaderIndex = AhcipAllocateCommand(Port);
+    }
+
     if (HeaderIndex < 0) {
         INSERT_BEFORE(&(Irp->ListEntry), &(Port->IrpQueue));
         Status = STATUS_SUCCESS;
         goto EnqueueIrpEnd;
     }
 
-    ASSERT(Port->CommandState[HeaderIndex].Irp == NULL);
-
-    Port->CommandState[HeaderIndex].Irp = Irp;
-    if (Irp->MajorCode == IrpMajorIo) {
-        AhcipPerformDmaIo(Port, Irp, HeaderIndex);
-
-    } else if (Irp->MajorCode == IrpMajorSystemControl) {
-
-        ASSERT(Irp->MinorCode == IrpMinorSystemControlSynchronize);
-
-        AhcipExecuteCacheFlush(Port, HeaderIndex);
-
-    } else {
-
-        ASSERT(FALSE);
-
-        Status = STATUS_NOT_SUPPORTED;
-        AhcipFreeCommand(Port, HeaderIndex);
-        goto EnqueueIrpEnd;
-    }
-
-    Status = STATUS_SUCCESS;
+    Status = AhcipStartIrp(Port, Irp, HeaderIndex);
 
 EnqueueIrpEnd:
     KeReleaseSpinLock(&(Port->DpcLock));
@@ -877,6 +946,7 @@ Return Value:
         IoCompleteIrp(AhciDriver, Irp, STATUS_NO_SUCH_DEVICE);
     }
 
+    Port->QueuedCommands = 0;
     Port->OsDevice = NULL;
     Port->TotalSectors = 0;
     Port->Flags = 0;
@@ -914,14 +984,11 @@ Return Value:
 
     LONG Bit;
     BOOL CommandInUse;
-    BOOL CompleteIrp;
     ULONG Finished;
     ULONG Interrupt;
     UINTN IoSize;
     PIRP Irp;
     ULONG NewPending;
-    KSTATUS Status;
-    ULONG TaskFile;
 
     Interrupt = RtlAtomicExchange(&(Port->PendingInterrupts), 0);
     if (Interrupt == 0) {
@@ -946,16 +1013,33 @@ Return Value:
         Interrupt &= ~AHCI_INTERRUPT_CONNECTION_MASK;
     }
 
+    //
+    // Fatal errors halt the port. Restart it and deal with the commands that
+    // were outstanding. Commands that finished before the error are left
+    // pending to be completed below.
+    //
+
     if ((Interrupt & AHCI_INTERRUPT_ERROR_MASK) != 0) {
         RtlDebugPrint("AHCI: Error %x\n", Interrupt);
+        if ((Interrupt & AHCI_INTERRUPT_FATAL_MASK) != 0) {
+            AhcipRecoverFromError(Port);
+        }
+
         Interrupt &= ~AHCI_INTERRUPT_ERROR_MASK;
     }
 
     //
-    // See which commands are no longer outstanding.
+    // See which commands are no longer outstanding. Queued commands clear
+    // their command issue bit as soon as the drive accepts them, but stay
+    // active until the drive reports them complete with a set device bits
+    // FIS.
     //
 
     NewPending = AHCI_READ(Port, AhciPortCommandIssue);
+    if (Port->QueuedCommands != 0) {
+        NewPending |= AHCI_READ(Port, AhciPortSataActive);
+    }
+
     Finished = (NewPending ^ Port->PendingCommands) & Port->PendingCommands;
 
     //
@@ -965,14 +1049,8 @@ Return Value:
     ASSERT(((NewPending ^ Port->PendingCommands) &
             ~Port->PendingCommands) == 0);
 
-    TaskFile = AHCI_READ(Port, AhciPortTaskFile);
-    Status = STATUS_SUCCESS;
-    if ((TaskFile & AHCI_PORT_TASK_ERROR_MASK) != 0) {
-        RtlDebugPrint("AHCI: I/O Error status: %x\n", TaskFile);
-        TaskFile = STATUS_DEVICE_IO_ERROR;
-    }
-
     Port->PendingCommands = NewPending;
+    Port->QueuedCommands &= NewPending;
 
     //
     // Loop over all the commands that have finished.
@@ -987,72 +1065,60 @@ Return Value:
         IoSize = Port->CommandState[Bit].IoSize;
         Port->CommandState[Bit].IoSize = 0;
         CommandInUse = FALSE;
-        CompleteIrp = TRUE;
 
         //
-        // There should not be a case where a command completed without an IRP.
+        // Commands without an IRP are internal commands whose issuer is
+        // waiting for them to finish. The issuer frees the command.
         //
 
         if (Irp == NULL) {
-            RtlDebugPrint("AHCI: Command without IRP.\n");
-            CompleteIrp = FALSE;
-
-            ASSERT(FALSE);
+            CommandInUse = TRUE;
 
-        } else if (KSUCCESS(Status)) {
-            if (Irp->MajorCode == IrpMajorIo) {
-                Irp->U.ReadWrite.IoBytesCompleted += IoSize;
-                Irp->U.ReadWrite.NewIoOffset += IoSize;
-            }
+        } else if (Irp->MajorCode == IrpMajorIo) {
+            Irp->U.ReadWrite.IoBytesCompleted += IoSize;
+            Irp->U.ReadWrite.NewIoOffset += IoSize;
 
             //
-            // If this isn't an I/O request, just complete it.
+            // If this is a synchronized write, then send a cache flush
+            // command along with it. Use the IoSize as a hint as to whether
+            // or not the cache flush part has already gone around. Queued
+            // writes force unit access instead, as a flush cannot be issued
+            // while other queued commands are outstanding.
             //
 
-            if (Irp->MajorCode == IrpMajorIo) {
+            if ((Irp->MinorCode == IrpMinorIoWrite) &&
+                ((Irp->U.ReadWrite.IoFlags &
+                  IO_FLAG_DATA_SYNCHRONIZED) != 0) &&
+                ((Port->Flags & AHCI_PORT_NATIVE_COMMAND_QUEUING) == 0) &&
+                (Irp->U.ReadWrite.IoBytesCompleted >=
+                 Irp->U.ReadWrite.IoSizeInBytes) &&
+                (IoSize != 0)) {
 
-                //
-                // If this is a synchronized write, then send a cache flush
-                // command along with it. Use the IoSize as a hint as to
-                // whether or not the cache flush part has already gone around.
-                //
+                AhcipExecuteCacheFlush(Port, Bit);
+                CommandInUse = TRUE;
 
-                if ((Irp->MinorCode == IrpMinorIoWrite) &&
-                    ((Irp->U.ReadWrite.IoFlags &
-                      IO_FLAG_DATA_SYNCHRONIZED) != 0) &&
-                    (Irp->U.ReadWrite.IoBytesCompleted >=
-                     Irp->U.ReadWrite.IoSizeInBytes) &&
-                    (IoSize != 0)) {
-
-                    AhcipExecuteCacheFlush(Port, Bit);
-                    CommandInUse = TRUE;
-
-                //
-                // If the IRP is not finished, queue up the next part. The
-                // command table will be in use then.
-                //
+            //
+            // If the IRP is not finished, queue up the next part. The
+            // command table will be in use then.
+            //
 
-                } else if (Irp->U.ReadWrite.IoBytesCompleted <
-                           Irp->U.ReadWrite.IoSizeInBytes) {
+            } else if (Irp->U.ReadWrite.IoBytesCompleted <
+                       Irp->U.ReadWrite.IoSizeInBytes) {
 
-                    AhcipPerformDmaIo(Port, Irp, Bit);
-                    CommandInUse = TRUE;
-                }
+                AhcipPerformDmaIo(Port, Irp, Bit);
+                CommandInUse = TRUE;
             }
         }
 
-        if (CompleteIrp != FALSE) {
-            Port->CommandState[Bit].Irp = NULL;
-            IoCompleteIrp(AhciDriver, Irp, Status);
-        }
-
         //
-        // Begin the next IRP reusing this command table if there's more
-        // to do.
+        // If the command is done, complete the IRP and release the command so
+        // that the next IRP can use it.
         //
 
         if (CommandInUse == FALSE) {
-            AhcipBeginNextIrp(Port, Bit);
+            Port->CommandState[Bit].Irp = NULL;
+            AhcipFreeCommand(Port, Bit);
+            IoCompleteIrp(AhciDriver, Irp, STATUS_SUCCESS);
         }
 
         Finished &= ~(1 << Bit);
@@ -1061,6 +1127,11 @@ Return Value:
         }
     }
 
+    //
+    // Fill any free command slots with IRPs that were waiting.
+    //
+
+    AhcipBeginQueuedIrps(Port);
     KeReleaseSpinLock(&(Port->DpcLock));
     return;
 }
@@ -1209,26 +1280,25 @@ Return Value:
 }
 
 VOID
-AhcipBeginNextIrp (
-    PAHCI_PORT Port,
-    LONG HeaderIndex
+AhcipRecoverFromError (
+    PAHCI_PORT Port
     )
 
 /*++
 
 Routine Description:
 
-    This routine begins processing for the next queued I/O IRP given a
-    command index and table already (reused from the previous command). If
-    there is no work left to do, the command is freed.
+    This routine recovers a port after a fatal error halted its command list.
+    The port is restarted, and the commands that were outstanding are either
+    failed or put back on the queue to be retried. For queued commands, the
+    drive's error log is read to determine which command actually failed, as
+    the drive aborts all other outstanding queued commands too. This routine
+    assumes the DPC lock is held.
 
 Arguments:
 
     Port - Supplies a pointer to the port.
 
-    HeaderIndex - Supplies the header index to use. The header had better be
-        pointing at the command table already.
-
 Return Value:
 
     None.
@@ -1237,22 +1307,402 @@ Return Value:
 
 {
 
+    ULONG Bit;
+    ULONG Command;
+    ULONG FailedMask;
+    LONG FailedTag;
     PIRP Irp;
+    ULONG Outstanding;
+    PLIST_ENTRY Requeue;
+    KSTATUS Status;
+    ULONG TaskFile;
 
-    ASSERT(KeGetRunLevel() == RunLevelDispatch);
+    ASSERT(KeIsSpinLockHeld(&(Port->DpcLock)) != FALSE);
 
-    KeAcquireSpinLock(&(Port->DpcLock));
-    if (!LIST_EMPTY(&(Port->IrpQueue))) {
-        Irp = LIST_VALUE(Port->IrpQueue.Next, IRP, ListEntry);
-        LIST_REMOVE(&(Irp->ListEntry));
-        KeReleaseSpinLock(&(Port->DpcLock));
-        Port->CommandState[HeaderIndex].Irp = Irp;
+    //
+    // Figure out which commands never completed. Anything pending that is no
+    // longer outstanding finished successfully before the error.
+    //
+
+    Outstanding = AHCI_READ(Port, AhciPortCommandIssue) |
+                  AHCI_READ(Port, AhciPortSataActive);
+
+    Outstanding &= Port->PendingCommands;
+    TaskFile = AHCI_READ(Port, AhciPortTaskFile);
+    RtlDebugPrint("AHCI: Recovering from error. Task file %x, SError %x, "
+                  "outstanding %x, queued %x\n",
+                  TaskFile,
+                  AHCI_READ(Port, AhciPortSataError),
+                  Outstanding,
+                  Port->QueuedCommands);
+
+    //
+    // Stop the port, which clears the command issue and active registers,
+    // clear the errors, and start it back up.
+    //
+
+    AhcipStopPort(Port);
+    AHCI_WRITE(Port, AhciPortSataError, 0xFFFFFFFF);
+    AHCI_WRITE(Port, AhciPortInterruptStatus, 0xFFFFFFFF);
+    Command = AHCI_READ(Port, AhciPortCommand);
+    Command |= AHCI_PORT_COMMAND_START | AHCI_PORT_COMMAND_FIS_RX_ENABLE;
+    AHCI_WRITE(Port, AhciPortCommand, Command);
+
+    //
+    // If none of the outstanding commands were queued, then the one command
+    // outstanding is the one that failed. Otherwise ask the drive which tag
+    // failed. The drive does not accept new commands until the log is read.
+    // If the log cannot be read, fail everything to avoid retrying forever.
+    //
+
+    Port->PendingCommands &= ~Outstanding;
+    FailedMask = Outstanding;
+    if ((Outstanding & Port->QueuedCommands) != 0) {
+        Status = STATUS_DEVICE_IO_ERROR;
+        if ((TaskFile &
+             (AHCI_PORT_TASK_BUSY | AHCI_PORT_TASK_DATA_REQUEST)) == 0) {
+
+            Status = AhcipReadQueuedErrorLog(
+                                         Port,
+                                         RtlCountTrailingZeros32(Outstanding),
+                                         &FailedTag);
+        }
+
+        if ((KSUCCESS(Status)) &&
+            (FailedTag >= 0) &&
+            ((Outstanding & (1 << FailedTag)) != 0)) {
+
+            FailedMask = 1 << FailedTag;
+
+        } else {
+            RtlDebugPrint("AHCI: Failed to determine failed tag: %d\n",
+                          Status);
+
+            //
+            // Restart the port again if the log command itself got stuck.
+            //
+
+            if (!KSUCCESS(Status)) {
+                AhcipStopPort(Port);
+                AHCI_WRITE(Port, AhciPortSataError, 0xFFFFFFFF);
+                AHCI_WRITE(Port, AhciPortInterruptStatus, 0xFFFFFFFF);
+                Command = AHCI_READ(Port, AhciPortCommand);
+                Command |= AHCI_PORT_COMMAND_START |
+                           AHCI_PORT_COMMAND_FIS_RX_ENABLE;
+
+                AHCI_WRITE(Port, AhciPortCommand, Command);
+            }
+        }
+    }
+
+    Port->QueuedCommands &= ~Outstanding;
+    Requeue = &(Port->IrpQueue);
+    for (Bit = 0; Bit < AHCI_COMMAND_COUNT; Bit += 1) {
+        if ((Outstanding & (1 << Bit)) == 0) {
+            continue;
+        }
+
+        Irp = Port->CommandState[Bit].Irp;
+        Port->CommandState[Bit].IoSize = 0;
+
+        //
+        // Internal commands without IRPs are freed by their issuer, which is
+        // watching for the pending bit to clear.
+        //
+
+        if (Irp != NULL) {
+            Port->CommandState[Bit].Irp = NULL;
+            AhcipFreeCommand(Port, Bit);
+
+            //
+            // The failed command is completed with an error. The others were
+            // aborted by the drive through no fault of their own, so put them
+            // back at the head of the queue, keeping them in the same order
+            // relative to each other. They start over from the last piece
+            // that completed.
+            //
+
+            if ((FailedMask & (1 << Bit)) != 0) {
+                IoCompleteIrp(AhciDriver, Irp, STATUS_DEVICE_IO_ERROR);
+
+            } else {
+                INSERT_AFTER(&(Irp->ListEntry), Requeue);
+                Requeue = &(Irp->ListEntry);
+            }
+        }
+
+        Outstanding &= ~(1 << Bit);
+        if (Outstanding == 0) {
+            break;
+        }
+    }
+
+    return;
+}
+
+KSTATUS
+AhcipReadQueuedErrorLog (
+    PAHCI_PORT Port,
+    LONG Index,
+    PLONG FailedTag
+    )
+
+/*++
+
+Routine Description:
+
+    This routine reads the queued command error log from the drive after a
+    queued command failed. This routine polls for completion, and assumes the
+    port has been restarted and no other commands are running on it.
+
+Arguments:
+
+    Port - Supplies a pointer to the port.
+
+    Index - Supplies the command index to use. This must be an allocated
+        command that is not currently pending.
+
+    FailedTag - Supplies a pointer where the tag of the queued command that
+        failed will be returned on success. -1 is returned if the error was
+        not caused by a queued command.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_TIMEOUT if the drive did not respond in time.
+
+    STATUS_DEVICE_IO_ERROR if the drive failed the command.
+
+--*/
+
+{
+
+    PAHCI_COMMAND_TABLE Command;
+    PSATA_FIS_REGISTER_H2D Fis;
+    PAHCI_COMMAND_HEADER Header;
+    PUCHAR Log;
+    PAHCI_PRDT Prdt;
+    ULONG TaskFile;
+    ULONGLONG Time;
+    ULONGLONG Timeout;
+
+    ASSERT(KeIsSpinLockHeld(&(Port->DpcLock)) != FALSE);
+    ASSERT((Index >= 0) &&
+           ((Port->AllocatedCommands & (1 << Index)) != 0) &&
+           ((Port->PendingCommands & (1 << Index)) == 0));
+
+    *FailedTag = -1;
+    Log = Port->LogIoBuffer->Fragment[0].VirtualAddress;
+    RtlZeroMemory(Log, ATA_SECTOR_SIZE);
+    Header = &(Port->Commands[Index]);
+    Command = &(Port->Tables[Index]);
+    RtlZeroMemory(&(Command->CommandFis), sizeof(Command->CommandFis));
+    Fis = (PSATA_FIS_REGISTER_H2D)&(Command->CommandFis);
+    Fis->Type = SataFisRegisterH2d;
+    Fis->Flags = SATA_FIS_REGISTER_H2D_FLAG_COMMAND;
+    Fis->Command = AtaCommandReadLogExt;
+    Fis->Lba0 = ATA_LOG_NCQ_COMMAND_ERROR;
+    Fis->Device = ATA_DRIVE_SELECT_LBA;
+    SATA_SET_FIS_COUNT(Fis, 1);
+    Header->Control = AHCI_COMMAND_FIS_SIZE(sizeof(SATA_FIS_REGISTER_H2D));
+    Header->PrdtLength = 1;
+    Header->Size = 0;
+    Prdt = &(Command->Prdt[0]);
+    Prdt->AddressLow = (ULONG)(Port->LogIoBuffer->Fragment[0].PhysicalAddress);
+    Prdt->AddressHigh =
+              (ULONG)(Port->LogIoBuffer->Fragment[0].PhysicalAddress >> 32);
+
+    Prdt->Reserved = 0;
+    Prdt->Count = ATA_SECTOR_SIZE - 1;
+
+    //
+    // Issue the command directly rather than marking it pending, so that the
+    // interrupt it generates does not try to retire it.
+    //
+
+    AHCI_WRITE(Port, AhciPortCommandIssue, 1 << Index);
+    Time = HlQueryTimeCounter();
+    Timeout = Time + ((AHCI_ERROR_LOG_TIMEOUT_MS *
+                       HlQueryTimeCounterFrequency()) /
+                      MILLISECONDS_PER_SECOND);
+
+    while (((AHCI_READ(Port, AhciPortCommandIssue) & (1 << Index)) != 0) &&
+           (Time <= Timeout)) {
+
+        TaskFile = AHCI_READ(Port, AhciPortTaskFile);
+        if ((TaskFile & AHCI_PORT_TASK_ERROR) != 0) {
+            return STATUS_DEVICE_IO_ERROR;
+        }
+
+        Time = HlQueryTimeCounter();
+    }
+
+    if ((AHCI_READ(Port, AhciPortCommandIssue) & (1 << Index)) != 0) {
+        return STATUS_TIMEOUT;
+    }
+
+    if ((Log[0] & ATA_NCQ_ERROR_LOG_NOT_QUEUED) == 0) {
+        *FailedTag = Log[0] & ATA_NCQ_ERROR_LOG_TAG_MASK;
+    }
+
+    return STATUS_SUCCESS;
+}
+
+BOOL
+AhcipCanStartIrp (
+    PAHCI_PORT Port,
+    PIRP Irp
+    )
+
+/*++
+
+Routine Description:
+
+    This routine determines whether or not the given IRP can be started given
+    the commands currently pending on the port. Queued commands cannot be
+    mixed with non-queued commands, so queued I/O waits for any non-queued
+    command to finish, and non-queued commands wait for the port to go idle.
+    This routine assumes the DPC lock is held.
+
+Arguments:
+
+    Port - Supplies a pointer to the port.
+
+    Irp - Supplies a pointer to the IRP that would be started.
+
+Return Value:
+
+    TRUE if the IRP can be started now, resources permitting.
+
+    FALSE if the IRP must wait for pending commands to drain.
+
+--*/
+
+{
+
+    if (((Port->Flags & AHCI_PORT_NATIVE_COMMAND_QUEUING) != 0) &&
+        (Irp->MajorCode == IrpMajorIo)) {
+
+        if ((Port->PendingCommands & ~Port->QueuedCommands) != 0) {
+            return FALSE;
+        }
+
+        return TRUE;
+    }
+
+    if (Port->PendingCommands != 0) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+KSTATUS
+AhcipStartIrp (
+    PAHCI_PORT Port,
+    PIRP Irp,
+    LONG HeaderIndex
+    )
+
+/*++
+
+Routine Description:
+
+    This routine starts the given IRP on a freshly allocated command. This
+    routine assumes the DPC lock is held.
+
+Arguments:
+
+    Port - Supplies a pointer to the port.
+
+    Irp - Supplies a pointer to the IRP to start.
+
+    HeaderIndex - Supplies the allocated command header index to use.
+
+Return Value:
+
+    STATUS_SUCCESS if the IRP was started.
+
+    STATUS_NOT_SUPPORTED if the IRP is not one that the port handles. The
+    command is freed in this case.
+
+--*/
+
+{
+
+    ASSERT(Port->CommandState[HeaderIndex].Irp == NULL);
+
+    Port->CommandState[HeaderIndex].Irp = Irp;
+    if (Irp->MajorCode == IrpMajorIo) {
         AhcipPerformDmaIo(Port, Irp, HeaderIndex);
 
+    } else if (Irp->MajorCode == IrpMajorSystemControl) {
+
+        ASSERT(Irp->MinorCode == IrpMinorSystemControlSynchronize);
+
+        AhcipExecuteCacheFlush(Port, HeaderIndex);
+
     } else {
-        KeReleaseSpinLock(&(Port->DpcLock));
+
+        ASSERT(FALSE);
+
         Port->CommandState[HeaderIndex].Irp = NULL;
         AhcipFreeCommand(Port, HeaderIndex);
+        return STATUS_NOT_SUPPORTED;
+    }
+
+    return STATUS_SUCCESS;
+}
+
+VOID
+AhcipBeginQueuedIrps (
+    PAHCI_PORT Port
+    )
+
+/*++
+
+Routine Description:
+
+    This routine starts as many of the queued IRPs as there are free command
+    slots for. IRPs are started in order, so an IRP that must wait for the
+    port to drain holds up the ones behind it. This routine assumes the DPC
+    lock is held.
+
+Arguments:
+
+    Port - Supplies a pointer to the port.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    LONG HeaderIndex;
+    PIRP Irp;
+    KSTATUS Status;
+
+    ASSERT(KeIsSpinLockHeld(&(Port->DpcLock)) != FALSE);
+
+    while (!LIST_EMPTY(&(Port->IrpQueue))) {
+        Irp = LIST_VALUE(Port->IrpQueue.Next, IRP, ListEntry);
+        if (AhcipCanStartIrp(Port, Irp) == FALSE) {
+            break;
+        }
+
+        HeaderIndex = AhcipAllocateCommand(Port);
+        if (HeaderIndex < 0) {
+            break;
+        }
+
+        LIST_REMOVE(&(Irp->ListEntry));
+        Status = AhcipStartIrp(Port, Irp, HeaderIndex);
+        if (!KSUCCESS(Status)) {
+            IoCompleteIrp(AhciDriver, Irp, Status);
+        }
     }
 
     return;
@@ -1306,6 +1756,7 @@ Return Value:
     PHYSICAL_ADDRESS PhysicalAddress;
     PAHCI_PRDT Prdt;
     ULONG PrdtIndex;
+    BOOL Queued;
     ULONG SectorCount;
     UINTN TransferSize;
     UINTN TransferSizeRemaining;
@@ -1336,6 +1787,7 @@ Return Value:
     }
 
     if (TransferSize == 0) {
+        Port->CommandState[HeaderIndex].Irp = NULL;
         AhcipFreeCommand(Port, HeaderIndex);
         IoCompleteIrp(AhciDriver, Irp, STATUS_SUCCESS);
         return;
@@ -1425,12 +1877,23 @@ Return Value:
     SectorCount = TransferSize / ATA_SECTOR_SIZE;
 
     //
-    // Use LBA48 if the block address is too high or the sector size is too
+    // Use the queued commands if native command queuing is enabled. Otherwise
+    // use LBA48 if the block address is too high or the sector size is too
     // large.
     //
 
-    if ((BlockAddress > ATA_MAX_LBA28) ||
-        (SectorCount > ATA_MAX_LBA28_SECTOR_COUNT)) {
+    Queued = FALSE;
+    if ((Port->Flags & AHCI_PORT_NATIVE_COMMAND_QUEUING) != 0) {
+        Queued = TRUE;
+        if (Write != FALSE) {
+            Command = AtaCommandWriteFpdmaQueued;
+
+        } else {
+            Command = AtaCommandReadFpdmaQueued;
+        }
+
+    } else if ((BlockAddress > ATA_MAX_LBA28) ||
+               (SectorCount > ATA_MAX_LBA28_SECTOR_COUNT)) {
 
         if (Write != FALSE) {
             Command = AtaCommandWriteDma48;
@@ -1462,13 +1925,37 @@ Return Value:
     Fis->Flags = SATA_FIS_REGISTER_H2D_FLAG_COMMAND;
     Fis->Command = Command;
     SATA_SET_FIS_LBA(Fis, BlockAddress);
-    SATA_SET_FIS_COUNT(Fis, SectorCount);
     Fis->Device = ATA_DRIVE_SELECT_LBA;
+
+    //
+    // Queued commands carry the tag in the count register. Synchronized
+    // writes force unit access, since the drive cannot be flushed while other
+    // queued commands are in flight.
+    //
+
+    if (Queued != FALSE) {
+        SATA_SET_FIS_QUEUED_COUNT(Fis, SectorCount);
+        Fis->Count0 = HeaderIndex << ATA_QUEUED_TAG_SHIFT;
+        if ((Write != FALSE) &&
+            ((Irp->U.ReadWrite.IoFlags & IO_FLAG_DATA_SYNCHRONIZED) != 0)) {
+
+            Fis->Device |= ATA_DRIVE_SELECT_FORCE_UNIT_ACCESS;
+        }
+
+    } else {
+        SATA_SET_FIS_COUNT(Fis, SectorCount);
+    }
+
     Header = &(Port->Commands[HeaderIndex]);
     Header->Control = AHCI_COMMAND_FIS_SIZE(sizeof(SATA_FIS_REGISTER_H2D));
+    if (Write != FALSE) {
+        Header->Control |= AHCI_COMMAND_HEADER_WRITE;
+    }
+
     Header->PrdtLength = PrdtIndex;
     Header->Size = TransferSize;
-    AhcipSubmitCommand(Port, 1 << HeaderIndex);
+    Port->CommandState[HeaderIndex].IoSize = TransferSize;
+    AhcipSubmitCommand(Port, 1 << HeaderIndex, Queued);
     return;
 }
 
@@ -1523,7 +2010,7 @@ Return Value:
     // Submit the command for execution.
     //
 
-    AhcipSubmitCommand(Port, 1 << Index);
+    AhcipSubmitCommand(Port, 1 << Index, FALSE);
     return;
 }
 
@@ -1661,7 +2148,8 @@ Return Value:
 VOID
 AhcipSubmitCommand (
     PAHCI_PORT Port,
-    ULONG Mask
+    ULONG Mask,
+    BOOL Queued
     )
 
 /*++
@@ -1677,6 +2165,9 @@ Routine Description:
 
     Mask - Supplies the mask to submit.
 
+    Queued - Supplies a boolean indicating if the commands are native queued
+        commands.
+
 Return Value:
 
     None.
@@ -1687,6 +2178,15 @@ Return Value:
 
     ASSERT(KeIsSpinLockHeld(&(Port->DpcLock)) != FALSE);
 
+    //
+    // Queued commands must be marked active before they are issued.
+    //
+
+    if (Queued != FALSE) {
+        AHCI_WRITE(Port, AhciPortSataActive, Mask);
+        Port->QueuedCommands |= Mask;
+    }
+
     //
     // There is no safe order to do these in, which is why holding the lock
     // is necessary.
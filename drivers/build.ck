@@ -43,7 +43,8 @@ function build() {
         "//drivers/special:special",
         "//drivers/term/ser16550:ser16550",
         "//drivers/usb:usb_drivers",
-        "//drivers/videocon:videocon"
+        "//drivers/videocon:videocon",
+        "//drivers/virtio:virtio_drivers"
     ];
 
     if ((arch == "armv7") || (arch == "armv6")) {
@@ -47,6 +47,14 @@ Module Name:
 #define E1000_WRITE_ARRAY(_Controller, _Register, _Offset, _Value) \
     E1000_WRITE((_Controller), (_Register) + ((_Offset) << 2), (_Value))
 
+//
+// This macro converts a maximum interrupt rate, in interrupts per second,
+// into an interrupt throttling register value, which counts in 256ns units.
+//
+
+#define E1000_INTERRUPT_THROTTLING_INTERVAL(_Rate) \
+    (1000000000 / ((_Rate) * 256))
+
 //
 // ---------------------------------------------------------------- Definitions
 //
@@ -469,6 +477,34 @@ Module Name:
      E1000_INTERRUPT_RX_SEQUENCE_ERROR | \
      E1000_INTERRUPT_LINK_STATUS_CHANGE)
 
+//
+// Define the interrupts that signal received frames. These stay masked while
+// the receive poll drains the ring.
+//
+
+#define E1000_INTERRUPT_RX_MASK \
+    (E1000_INTERRUPT_RX_TIMER | \
+     E1000_INTERRUPT_RX_MIN_THRESHOLD)
+
+//
+// Define the interrupt rates used for adaptive interrupt moderation, in
+// interrupts per second. Light traffic gets low latency; a flood gets fewer,
+// larger batches.
+//
+
+#define E1000_INTERRUPT_RATE_LOWEST_LATENCY 70000
+#define E1000_INTERRUPT_RATE_LOW_LATENCY 20000
+#define E1000_INTERRUPT_RATE_BULK 4000
+
+//
+// Define the number of frames handled in one poll at or below which the
+// moderation steps toward lower latency, and at or above which it steps
+// toward bulk.
+//
+
+#define E1000_MODERATION_LATENCY_FRAME_COUNT 4
+#define E1000_MODERATION_BULK_FRAME_COUNT 32
+
 //
 // Management control register bits
 //
@@ -743,6 +779,12 @@ typedef enum _E1000_EEPROM_TYPE {
     E1000EepromSpi,
 } E1000_EEPROM_TYPE, *PE1000_EEPROM_TYPE;
 
+typedef enum _E1000_INTERRUPT_MODERATION {
+    E1000ModerationLowestLatency,
+    E1000ModerationLowLatency,
+    E1000ModerationBulk,
+} E1000_INTERRUPT_MODERATION, *PE1000_INTERRUPT_MODERATION;
+
 /*++
 
 Structure Description:
@@ -887,6 +929,12 @@ Structure Description:
     RxListLock - Stores a pointer to a queued lock that protects the receive
         list.
 
+    RxPoll - Stores a pointer to the core networking poll that drains the
+        receive ring while receive interrupts are masked.
+
+    InterruptModeration - Stores the current interrupt moderation level,
+        which is adjusted based on how many frames each poll finds.
+
     TxIoBuffer - Stores a pointer to the I/O buffer associated with
         the transmit descriptor list.
 
@@ -944,6 +992,8 @@ typedef struct _E1000_DEVICE {
     PNET_PACKET_BUFFER *RxPackets;
     ULONG RxListBegin;
     PQUEUED_LOCK RxListLock;
+    PNET_POLL RxPoll;
+    E1000_INTERRUPT_MODERATION InterruptModeration;
     PIO_BUFFER TxIoBuffer;
     PE1000_TX_DESCRIPTOR TxDescriptors;
     PNET_PACKET_BUFFER *TxPacket;
@@ -173,9 +173,27 @@ E1000pReapTxDescriptors (
     PE1000_DEVICE Device
     );
 
+ULONG
+E1000pPollReceive (
+    PVOID Context,
+    ULONG Budget
+    );
+
 VOID
+E1000pPollComplete (
+    PVOID Context
+    );
+
+ULONG
 E1000pReapReceivedFrames (
-    PE1000_DEVICE Device
+    PE1000_DEVICE Device,
+    ULONG Budget
+    );
+
+VOID
+E1000pUpdateInterruptModeration (
+    PE1000_DEVICE Device,
+    ULONG FrameCount
     );
 
 VOID
@@ -400,6 +418,21 @@ Return Value:
         goto InitializeDeviceStructuresEnd;
     }
 
+    //
+    // Received frames are drained by a poll rather than directly from the
+    // interrupt worker.
+    //
+
+    Status = NetCreatePoll(E1000pPollReceive,
+                           E1000pPollComplete,
+                           Device,
+                           0,
+                           &(Device->RxPoll));
+
+    if (!KSUCCESS(Status)) {
+        goto InitializeDeviceStructuresEnd;
+    }
+
     //
     // Allocate the receive buffers, including space for the descriptors and
     // space for the data.
@@ -502,6 +535,11 @@ Return Value:
             Device->RxListLock = NULL;
         }
 
+        if (Device->RxPoll != NULL) {
+            NetDestroyPoll(Device->RxPoll);
+            Device->RxPoll = NULL;
+        }
+
         if (Device->RxIoBuffer != NULL) {
             MmFreeIoBuffer(Device->RxIoBuffer);
             Device->RxIoBuffer = NULL;
@@ -736,6 +774,17 @@ Return Value:
                 E1000RxInterruptAbsoluteDelayTimer,
                 E1000_RX_ABSOLUTE_INTERRUPT_DELAY);
 
+    //
+    // Start out favoring latency. The receive poll adjusts the interrupt rate
+    // as the traffic changes.
+    //
+
+    Device->InterruptModeration = E1000ModerationLowLatency;
+    E1000_WRITE(Device,
+                E1000InterruptThrottlingRate,
+                E1000_INTERRUPT_THROTTLING_INTERVAL(
+                                           E1000_INTERRUPT_RATE_LOW_LATENCY));
+
     E1000_WRITE(Device,
                 E1000RxDescriptorLength0,
                 sizeof(E1000_RX_DESCRIPTOR) * E1000_RX_RING_SIZE);
@@ -876,10 +925,13 @@ Return Value:
     }
 
     //
-    // Process new receive frames.
+    // Hand new receive frames off to the poll. The receive interrupts stay
+    // masked until the poll finds the ring empty.
     //
 
-    E1000pReapReceivedFrames(Device);
+    if ((PendingBits & E1000_INTERRUPT_RX_MASK) != 0) {
+        NetSchedulePoll(Device->RxPoll);
+    }
 
     //
     // If the command unit finished what it was up to, reap that memory.
@@ -890,10 +942,15 @@ Return Value:
     }
 
     //
-    // Re-enable interrupts now that they've been serviced.
+    // Re-enable interrupts now that they've been serviced, except for the
+    // receive interrupts the poll re-enables.
     //
 
-    E1000_WRITE(Device, E1000InterruptMaskSet, PendingBits);
+    PendingBits &= ~E1000_INTERRUPT_RX_MASK;
+    if (PendingBits != 0) {
+        E1000_WRITE(Device, E1000InterruptMaskSet, PendingBits);
+    }
+
     return InterruptStatusClaimed;
 }
 
@@ -2327,24 +2384,95 @@ Return Value:
     return;
 }
 
+ULONG
+E1000pPollReceive (
+    PVOID Context,
+    ULONG Budget
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is called by the core networking library to drain received
+    frames while receive interrupts are masked.
+
+Arguments:
+
+    Context - Supplies a pointer to the device.
+
+    Budget - Supplies the maximum number of frames to process.
+
+Return Value:
+
+    Returns the number of frames processed.
+
+--*/
+
+{
+
+    PE1000_DEVICE Device;
+    ULONG FrameCount;
+
+    Device = (PE1000_DEVICE)Context;
+    FrameCount = E1000pReapReceivedFrames(Device, Budget);
+    E1000pUpdateInterruptModeration(Device, FrameCount);
+    return FrameCount;
+}
+
 VOID
+E1000pPollComplete (
+    PVOID Context
+    )
+
+/*++
+
+Routine Description:
+
+    This routine re-enables receive interrupts once the receive poll has found
+    the ring empty.
+
+Arguments:
+
+    Context - Supplies a pointer to the device.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PE1000_DEVICE Device;
+
+    Device = (PE1000_DEVICE)Context;
+    E1000_WRITE(Device, E1000InterruptMaskSet, E1000_INTERRUPT_RX_MASK);
+    return;
+}
+
+ULONG
 E1000pReapReceivedFrames (
-    PE1000_DEVICE Device
+    PE1000_DEVICE Device,
+    ULONG Budget
     )
 
 /*++
 
 Routine Description:
 
-    This routine processes any received frames from the network.
+    This routine processes received frames from the network, handing them up
+    the stack as a single batch.
 
 Arguments:
 
     Device - Supplies a pointer to the device.
 
+    Budget - Supplies the maximum number of frames to process.
+
 Return Value:
 
-    None.
+    Returns the number of frames processed.
 
 --*/
 
@@ -2353,13 +2481,25 @@ Return Value:
     PE1000_RX_DESCRIPTOR Descriptor;
     ULONG DescriptorIndex;
     ULONG Flags;
+    ULONG FrameCount;
+    ULONG Index;
     ULONG NewTail;
     PNET_PACKET_BUFFER Packet;
+    NET_PACKET_LIST PacketList;
+
+    //
+    // Gather up the completed frames. The poll never runs concurrently with
+    // itself, so the descriptors stay put while the lock is dropped to
+    // process them.
+    //
 
+    NET_INITIALIZE_PACKET_LIST(&PacketList);
+    FrameCount = 0;
     KeAcquireQueuedLock(Device->RxListLock);
     DescriptorIndex = Device->RxListBegin;
     Descriptor = &(Device->RxDescriptors[DescriptorIndex]);
-    while ((Descriptor->Status & E1000_RX_STATUS_DONE) != 0) {
+    while ((FrameCount < Budget) &&
+           ((Descriptor->Status & E1000_RX_STATUS_DONE) != 0)) {
 
         //
         // Handling packets that spawn multiple descriptors is not currently
@@ -2419,8 +2559,8 @@ Return Value:
         }
 
         Packet->Flags = Flags;
-        NetProcessReceivedPacket(Device->NetworkLink, Packet);
-        Descriptor->Status = 0;
+        NET_ADD_PACKET_TO_LIST(Packet, &PacketList);
+        FrameCount += 1;
         DescriptorIndex += 1;
         if (DescriptorIndex == E1000_RX_RING_SIZE) {
             DescriptorIndex = 0;
@@ -2429,24 +2569,110 @@ Return Value:
         Descriptor = &(Device->RxDescriptors[DescriptorIndex]);
     }
 
+    KeReleaseQueuedLock(Device->RxListLock);
+    if (FrameCount == 0) {
+        return 0;
+    }
+
+    NetProcessReceivedPackets(Device->NetworkLink, &PacketList);
+
     //
-    // Write the new tail if there is one.
+    // Hand the descriptors back to the hardware now that the stack is done
+    // with their buffers, and write the new tail once for the whole batch.
     //
 
-    if (DescriptorIndex != Device->RxListBegin) {
-        Device->RxListBegin = DescriptorIndex;
-        if (DescriptorIndex == 0) {
-            NewTail = E1000_RX_RING_SIZE - 1;
-
-        } else {
-            NewTail = DescriptorIndex - 1;
+    KeAcquireQueuedLock(Device->RxListLock);
+    DescriptorIndex = Device->RxListBegin;
+    for (Index = 0; Index < FrameCount; Index += 1) {
+        Device->RxDescriptors[DescriptorIndex].Status = 0;
+        DescriptorIndex += 1;
+        if (DescriptorIndex == E1000_RX_RING_SIZE) {
+            DescriptorIndex = 0;
         }
+    }
 
-        RtlMemoryBarrier();
-        E1000_WRITE(Device, E1000RxDescriptorTail0, NewTail);
+    Device->RxListBegin = DescriptorIndex;
+    if (DescriptorIndex == 0) {
+        NewTail = E1000_RX_RING_SIZE - 1;
+
+    } else {
+        NewTail = DescriptorIndex - 1;
     }
 
+    RtlMemoryBarrier();
+    E1000_WRITE(Device, E1000RxDescriptorTail0, NewTail);
     KeReleaseQueuedLock(Device->RxListLock);
+    return FrameCount;
+}
+
+VOID
+E1000pUpdateInterruptModeration (
+    PE1000_DEVICE Device,
+    ULONG FrameCount
+    )
+
+/*++
+
+Routine Description:
+
+    This routine adjusts the interrupt throttling rate based on how many
+    frames a receive poll found. Busy polls push the rate down so that each
+    interrupt carries a bigger batch, and quiet polls push it back up for
+    latency. The level moves one step at a time to avoid flapping.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+    FrameCount - Supplies the number of frames the poll processed.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    E1000_INTERRUPT_MODERATION Moderation;
+    ULONG Rate;
+
+    Moderation = Device->InterruptModeration;
+    if (FrameCount >= E1000_MODERATION_BULK_FRAME_COUNT) {
+        if (Moderation != E1000ModerationBulk) {
+            Moderation += 1;
+        }
+
+    } else if (FrameCount <= E1000_MODERATION_LATENCY_FRAME_COUNT) {
+        if (Moderation != E1000ModerationLowestLatency) {
+            Moderation -= 1;
+        }
+    }
+
+    if (Moderation == Device->InterruptModeration) {
+        return;
+    }
+
+    Device->InterruptModeration = Moderation;
+    switch (Moderation) {
+    case E1000ModerationLowestLatency:
+        Rate = E1000_INTERRUPT_RATE_LOWEST_LATENCY;
+        break;
+
+    case E1000ModerationBulk:
+        Rate = E1000_INTERRUPT_RATE_BULK;
+        break;
+
+    case E1000ModerationLowLatency:
+    default:
+        Rate = E1000_INTERRUPT_RATE_LOW_LATENCY;
+        break;
+    }
+
+    E1000_WRITE(Device,
+                E1000InterruptThrottlingRate,
+                E1000_INTERRUPT_THROTTLING_INTERVAL(Rate));
+
     return;
 }
 
@@ -0,0 +1,774 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    virtnet.c
+
+Abstract:
+
+    This module implements the virtio network device driver.
+
+Author:
+
+    agent 16-Oct-2026
+
+Environment:
+
+    Kernel
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <minoca/kernel/driver.h>
+#include <minoca/net/netdrv.h>
+#include "virtnet.h"
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+KSTATUS
+VirtnetAddDevice (
+    PVOID Driver,
+    PCSTR DeviceId,
+    PCSTR ClassId,
+    PCSTR CompatibleIds,
+    PVOID DeviceToken
+    );
+
+VOID
+VirtnetDispatchStateChange (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    );
+
+VOID
+VirtnetDispatchOpen (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    );
+
+VOID
+VirtnetDispatchClose (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    );
+
+VOID
+VirtnetDispatchIo (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    );
+
+VOID
+VirtnetDispatchSystemControl (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    );
+
+VOID
+VirtnetDestroyLink (
+    PVOID DeviceContext
+    );
+
+KSTATUS
+VirtnetpStartDevice (
+    PIRP Irp,
+    PVIRTNET_DEVICE Device
+    );
+
+KSTATUS
+VirtnetpConnectMessageInterrupts (
+    PVIRTNET_DEVICE Device
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+PDRIVER VirtnetDriver = NULL;
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+KSTATUS
+DriverEntry (
+    PDRIVER Driver
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is the entry point for the virtio network driver. It registers
+    its other dispatch functions, and performs driver-wide initialization.
+
+Arguments:
+
+    Driver - Supplies a pointer to the driver object.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    Failure code on error.
+
+--*/
+
+{
+
+    DRIVER_FUNCTION_TABLE FunctionTable;
+    KSTATUS Status;
+
+    VirtnetDriver = Driver;
+    RtlZeroMemory(&FunctionTable, sizeof(DRIVER_FUNCTION_TABLE));
+    FunctionTable.Version = DRIVER_FUNCTION_TABLE_VERSION;
+    FunctionTable.AddDevice = VirtnetAddDevice;
+    FunctionTable.DispatchStateChange = VirtnetDispatchStateChange;
+    FunctionTable.DispatchOpen = VirtnetDispatchOpen;
+    FunctionTable.DispatchClose = VirtnetDispatchClose;
+    FunctionTable.DispatchIo = VirtnetDispatchIo;
+    FunctionTable.DispatchSystemControl = VirtnetDispatchSystemControl;
+    Status = IoRegisterDriverFunctions(Driver, &FunctionTable);
+    return Status;
+}
+
+KSTATUS
+VirtnetAddDevice (
+    PVOID Driver,
+    PCSTR DeviceId,
+    PCSTR ClassId,
+    PCSTR CompatibleIds,
+    PVOID DeviceToken
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is called when a device is detected for which the virtio
+    network driver acts as the function driver. The driver will attach itself
+    to the stack.
+
+Arguments:
+
+    Driver - Supplies a pointer to the driver being called.
+
+    DeviceId - Supplies a pointer to a string with the device ID.
+
+    ClassId - Supplies a pointer to a string containing the device's class ID.
+
+    CompatibleIds - Supplies a pointer to a string containing device IDs
+        that would be compatible with this device.
+
+    DeviceToken - Supplies an opaque token that the driver can use to identify
+        the device in the system. This token should be used when attaching to
+        the stack.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    Failure code if the driver was unsuccessful in attaching itself.
+
+--*/
+
+{
+
+    PVIRTNET_DEVICE Device;
+    ULONG Index;
+    KSTATUS Status;
+
+    Device = MmAllocateNonPagedPool(sizeof(VIRTNET_DEVICE),
+                                    VIRTNET_ALLOCATION_TAG);
+
+    if (Device == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto AddDeviceEnd;
+    }
+
+    RtlZeroMemory(Device, sizeof(VIRTNET_DEVICE));
+    Device->InterruptHandle = INVALID_HANDLE;
+    Device->OsDevice = DeviceToken;
+    for (Index = 0; Index < VIRTNET_MAX_QUEUE_PAIRS; Index += 1) {
+        Device->QueuePairs[Index].Device = Device;
+        Device->QueuePairs[Index].ReceiveInterruptHandle = INVALID_HANDLE;
+        Device->QueuePairs[Index].TransmitInterruptHandle = INVALID_HANDLE;
+        NET_INITIALIZE_PACKET_LIST(
+                              &(Device->QueuePairs[Index].TransmitPacketList));
+    }
+
+    VirtioInitializeDevice(&(Device->Virtio), DeviceToken);
+    Status = IoAttachDriverToDevice(Driver, DeviceToken, Device);
+    if (!KSUCCESS(Status)) {
+        goto AddDeviceEnd;
+    }
+
+AddDeviceEnd:
+    if (!KSUCCESS(Status)) {
+        if (Device != NULL) {
+            MmFreeNonPagedPool(Device);
+            Device = NULL;
+        }
+    }
+
+    return Status;
+}
+
+VOID
+VirtnetDispatchStateChange (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles State Change IRPs.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    DeviceContext - Supplies the context pointer supplied by the driver when it
+        attached itself to the driver stack. Presumably this pointer contains
+        driver-specific device context.
+
+    IrpContext - Supplies the context pointer supplied by the driver when
+        the IRP was created.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PVIRTNET_DEVICE Device;
+    KSTATUS Status;
+
+    ASSERT(Irp->MajorCode == IrpMajorStateChange);
+
+    Device = DeviceContext;
+    if (Irp->Direction == IrpUp) {
+        switch (Irp->MinorCode) {
+        case IrpMinorQueryResources:
+            Status = VirtioProcessResourceRequirements(
+                                                 &(Device->Virtio),
+                                                 Irp,
+                                                 VIRTNET_MIN_MESSAGE_VECTORS,
+                                                 VIRTNET_MAX_MESSAGE_VECTORS);
+
+            if (!KSUCCESS(Status)) {
+                IoCompleteIrp(VirtnetDriver, Irp, Status);
+            }
+
+            break;
+
+        case IrpMinorStartDevice:
+            Status = VirtnetpStartDevice(Irp, Device);
+            if (!KSUCCESS(Status)) {
+                IoCompleteIrp(VirtnetDriver, Irp, Status);
+            }
+
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    return;
+}
+
+VOID
+VirtnetDispatchOpen (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles Open IRPs.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    DeviceContext - Supplies the context pointer supplied by the driver when it
+        attached itself to the driver stack. Presumably this pointer contains
+        driver-specific device context.
+
+    IrpContext - Supplies the context pointer supplied by the driver when
+        the IRP was created.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    return;
+}
+
+VOID
+VirtnetDispatchClose (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles Close IRPs.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    DeviceContext - Supplies the context pointer supplied by the driver when it
+        attached itself to the driver stack. Presumably this pointer contains
+        driver-specific device context.
+
+    IrpContext - Supplies the context pointer supplied by the driver when
+        the IRP was created.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    return;
+}
+
+VOID
+VirtnetDispatchIo (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles I/O IRPs.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    DeviceContext - Supplies the context pointer supplied by the driver when it
+        attached itself to the driver stack. Presumably this pointer contains
+        driver-specific device context.
+
+    IrpContext - Supplies the context pointer supplied by the driver when
+        the IRP was created.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    return;
+}
+
+VOID
+VirtnetDispatchSystemControl (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles System Control IRPs.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    DeviceContext - Supplies the context pointer supplied by the driver when it
+        attached itself to the driver stack. Presumably this pointer contains
+        driver-specific device context.
+
+    IrpContext - Supplies the context pointer supplied by the driver when
+        the IRP was created.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PVIRTNET_DEVICE Device;
+    PSYSTEM_CONTROL_DEVICE_INFORMATION DeviceInformationRequest;
+    KSTATUS Status;
+
+    ASSERT(Irp->MajorCode == IrpMajorSystemControl);
+
+    Device = DeviceContext;
+    if (Irp->Direction == IrpDown) {
+        switch (Irp->MinorCode) {
+        case IrpMinorSystemControlDeviceInformation:
+            if (Device->NetworkLink == NULL) {
+                break;
+            }
+
+            DeviceInformationRequest = Irp->U.SystemControl.SystemContext;
+            Status = NetGetSetLinkDeviceInformation(
+                                         Device->NetworkLink,
+                                         &(DeviceInformationRequest->Uuid),
+                                         DeviceInformationRequest->Data,
+                                         &(DeviceInformationRequest->DataSize),
+                                         DeviceInformationRequest->Set);
+
+            IoCompleteIrp(VirtnetDriver, Irp, Status);
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    return;
+}
+
+VOID
+VirtnetDestroyLink (
+    PVOID DeviceContext
+    )
+
+/*++
+
+Routine Description:
+
+    This routine notifies the device layer that the networking core is in the
+    process of destroying the link and will no longer call into the device for
+    this link. This allows the device layer to release any context that was
+    supporting the device link interface.
+
+Arguments:
+
+    DeviceContext - Supplies a pointer to the device context associated with
+        the link being destroyed.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    return;
+}
+
+KSTATUS
+VirtnetpAddNetworkDevice (
+    PVIRTNET_DEVICE Device
+    )
+
+/*++
+
+Routine Description:
+
+    This routine adds the device to core networking's available links.
+
+Arguments:
+
+    Device - Supplies a pointer to the device to add.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    NET_LINK_PROPERTIES Properties;
+    KSTATUS Status;
+
+    if (Device->NetworkLink != NULL) {
+        Status = STATUS_SUCCESS;
+        goto AddNetworkDeviceEnd;
+    }
+
+    //
+    // Add a link to the core networking library. Every packet sent to the
+    // device starts with a virtio header, so reserve room for it in front of
+    // each outgoing packet. This lets a packet go out in a single descriptor.
+    //
+
+    RtlZeroMemory(&Properties, sizeof(NET_LINK_PROPERTIES));
+    Properties.Version = NET_LINK_PROPERTIES_VERSION;
+    Properties.TransmitAlignment = 1;
+    Properties.Device = Device->OsDevice;
+    Properties.DeviceContext = Device;
+    Properties.PacketSizeInformation.HeaderSize = sizeof(VIRTIO_NET_HEADER);
+    Properties.PacketSizeInformation.MaxPacketSize = VIRTNET_RX_BUFFER_SIZE;
+    Properties.DataLinkType = NetDomainEthernet;
+    Properties.MaxPhysicalAddress = MAX_ULONGLONG;
+    Properties.PhysicalAddress.Domain = NetDomainEthernet;
+    RtlCopyMemory(&(Properties.PhysicalAddress.Address),
+                  &(Device->MacAddress),
+                  sizeof(Device->MacAddress));
+
+    Properties.Interface.Send = VirtnetSend;
+    Properties.Interface.GetSetInformation = VirtnetGetSetInformation;
+    Properties.Interface.DestroyLink = VirtnetDestroyLink;
+    Properties.ChecksumFlags = Device->ChecksumFlags;
+    Status = NetAddLink(&Properties, &(Device->NetworkLink));
+    if (!KSUCCESS(Status)) {
+        goto AddNetworkDeviceEnd;
+    }
+
+AddNetworkDeviceEnd:
+    if (!KSUCCESS(Status)) {
+        if (Device->NetworkLink != NULL) {
+            NetRemoveLink(Device->NetworkLink);
+            Device->NetworkLink = NULL;
+        }
+    }
+
+    return Status;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+KSTATUS
+VirtnetpStartDevice (
+    PIRP Irp,
+    PVIRTNET_DEVICE Device
+    )
+
+/*++
+
+Routine Description:
+
+    This routine starts the virtio network device.
+
+Arguments:
+
+    Irp - Supplies a pointer to the start IRP.
+
+    Device - Supplies a pointer to the device information.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    IO_CONNECT_INTERRUPT_PARAMETERS Connect;
+    KSTATUS Status;
+
+    //
+    // The queues survive across restarts of the device. Starting the virtio
+    // device again would reset it out from under them.
+    //
+
+    if (Device->Started != FALSE) {
+        return STATUS_SUCCESS;
+    }
+
+    Status = VirtioStartDevice(&(Device->Virtio), Irp);
+    if (!KSUCCESS(Status)) {
+        goto StartDeviceEnd;
+    }
+
+    //
+    // Negotiate features and create the queues.
+    //
+
+    Status = VirtnetpInitializeDeviceStructures(Device);
+    if (!KSUCCESS(Status)) {
+        goto StartDeviceEnd;
+    }
+
+    Status = VirtnetpAddNetworkDevice(Device);
+    if (!KSUCCESS(Status)) {
+        goto StartDeviceEnd;
+    }
+
+    //
+    // Attempt to connect the interrupts. With MSI-X, each queue has its own
+    // vector. Otherwise one interrupt line serves all the queues.
+    //
+
+    if (Device->Virtio.MessageVectorCount != 0) {
+        Status = VirtnetpConnectMessageInterrupts(Device);
+        if (!KSUCCESS(Status)) {
+            goto StartDeviceEnd;
+        }
+
+    } else if (Device->InterruptHandle == INVALID_HANDLE) {
+        RtlZeroMemory(&Connect, sizeof(IO_CONNECT_INTERRUPT_PARAMETERS));
+        Connect.Version = IO_CONNECT_INTERRUPT_PARAMETERS_VERSION;
+        Connect.Device = Device->OsDevice;
+        Connect.LineNumber = Device->Virtio.InterruptLine;
+        Connect.Vector = Device->Virtio.InterruptVector;
+        Connect.InterruptServiceRoutine = VirtnetpInterruptService;
+        Connect.LowLevelServiceRoutine = VirtnetpInterruptServiceWorker;
+        Connect.Context = Device;
+        Connect.Interrupt = &(Device->InterruptHandle);
+        Status = IoConnectInterrupt(&Connect);
+        if (!KSUCCESS(Status)) {
+            goto StartDeviceEnd;
+        }
+    }
+
+    //
+    // Start up the device.
+    //
+
+    Status = VirtnetpEnableDevice(Device);
+    if (!KSUCCESS(Status)) {
+        goto StartDeviceEnd;
+    }
+
+    Device->Started = TRUE;
+
+StartDeviceEnd:
+    if (!KSUCCESS(Status)) {
+        RtlDebugPrint("Virtnet: Failed to start: %d\n", Status);
+        VirtioResetDevice(&(Device->Virtio));
+        if (Device->NetworkLink != NULL) {
+            NetSetLinkState(Device->NetworkLink, FALSE, 0);
+        }
+
+        VirtnetpDestroyDeviceStructures(Device);
+    }
+
+    return Status;
+}
+
+KSTATUS
+VirtnetpConnectMessageInterrupts (
+    PVIRTNET_DEVICE Device
+    )
+
+/*++
+
+Routine Description:
+
+    This routine connects the MSI-X vectors of a virtio network device: one
+    for configuration changes and one for each queue in use.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    IO_CONNECT_INTERRUPT_PARAMETERS Connect;
+    PVIRTNET_QUEUE_PAIR Pair;
+    ULONG PairIndex;
+    KSTATUS Status;
+
+    RtlZeroMemory(&Connect, sizeof(IO_CONNECT_INTERRUPT_PARAMETERS));
+    Connect.Version = IO_CONNECT_INTERRUPT_PARAMETERS_VERSION;
+    Connect.Device = Device->OsDevice;
+    Connect.LineNumber = INVALID_INTERRUPT_LINE;
+    Connect.InterruptServiceRoutine = VirtnetpMessageInterruptService;
+    if (Device->InterruptHandle == INVALID_HANDLE) {
+        Connect.Vector = Device->Virtio.InterruptVector +
+                         VIRTNET_CONFIGURATION_VECTOR;
+
+        Connect.LowLevelServiceRoutine = VirtnetpConfigurationInterruptWorker;
+        Connect.Context = Device;
+        Connect.Interrupt = &(Device->InterruptHandle);
+        Status = IoConnectInterrupt(&Connect);
+        if (!KSUCCESS(Status)) {
+            goto ConnectMessageInterruptsEnd;
+        }
+    }
+
+    for (PairIndex = 0; PairIndex < Device->QueuePairCount; PairIndex += 1) {
+        Pair = &(Device->QueuePairs[PairIndex]);
+        Connect.Context = Pair;
+        if (Pair->ReceiveInterruptHandle == INVALID_HANDLE) {
+            Connect.Vector = Device->Virtio.InterruptVector +
+                             VIRTNET_RECEIVE_VECTOR(PairIndex);
+
+            Connect.LowLevelServiceRoutine = VirtnetpReceiveInterruptWorker;
+            Connect.Interrupt = &(Pair->ReceiveInterruptHandle);
+            Status = IoConnectInterrupt(&Connect);
+            if (!KSUCCESS(Status)) {
+                goto ConnectMessageInterruptsEnd;
+            }
+        }
+
+        if (Pair->TransmitInterruptHandle == INVALID_HANDLE) {
+            Connect.Vector = Device->Virtio.InterruptVector +
+                             VIRTNET_TRANSMIT_VECTOR(PairIndex);
+
+            Connect.LowLevelServiceRoutine = VirtnetpTransmitInterruptWorker;
+            Connect.Interrupt = &(Pair->TransmitInterruptHandle);
+            Status = IoConnectInterrupt(&Connect);
+            if (!KSUCCESS(Status)) {
+                goto ConnectMessageInterruptsEnd;
+            }
+        }
+    }
+
+    Status = STATUS_SUCCESS;
+
+ConnectMessageInterruptsEnd:
+    return Status;
+}
@@ -0,0 +1,643 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    virtnet.h
+
+Abstract:
+
+    This header contains internal definitions for the virtio network device
+    driver.
+
+Author:
+
+    agent 16-Oct-2026
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <minoca/virtio/virtio.h>
+
+//
+// --------------------------------------------------------------------- Macros
+//
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+//
+// Define the allocation tag: VNet
+//
+
+#define VIRTNET_ALLOCATION_TAG 0x74654E56
+
+//
+// Define the virtio network device feature bits.
+//
+
+#define VIRTIO_NET_FEATURE_CHECKSUM           (1ULL << 0)
+#define VIRTIO_NET_FEATURE_GUEST_CHECKSUM     (1ULL << 1)
+#define VIRTIO_NET_FEATURE_MAC                (1ULL << 5)
+#define VIRTIO_NET_FEATURE_MERGE_RX_BUFFERS   (1ULL << 15)
+#define VIRTIO_NET_FEATURE_STATUS             (1ULL << 16)
+#define VIRTIO_NET_FEATURE_CONTROL_QUEUE      (1ULL << 17)
+#define VIRTIO_NET_FEATURE_MULTIQUEUE         (1ULL << 22)
+
+#define VIRTNET_FEATURES                        \
+    (VIRTIO_NET_FEATURE_CHECKSUM |              \
+     VIRTIO_NET_FEATURE_GUEST_CHECKSUM |        \
+     VIRTIO_NET_FEATURE_MAC |                   \
+     VIRTIO_NET_FEATURE_MERGE_RX_BUFFERS |      \
+     VIRTIO_NET_FEATURE_STATUS |                \
+     VIRTIO_NET_FEATURE_CONTROL_QUEUE |         \
+     VIRTIO_NET_FEATURE_MULTIQUEUE)
+
+//
+// Define the offsets of the fields in the device configuration region.
+//
+
+#define VIRTIO_NET_CONFIG_MAC_ADDRESS     0
+#define VIRTIO_NET_CONFIG_STATUS          6
+#define VIRTIO_NET_CONFIG_MAX_QUEUE_PAIRS 8
+
+//
+// Define the bits in the device status field.
+//
+
+#define VIRTIO_NET_STATUS_LINK_UP 0x0001
+
+//
+// Define the flags in the per-packet header.
+//
+
+#define VIRTIO_NET_HEADER_FLAG_NEEDS_CHECKSUM 0x01
+#define VIRTIO_NET_HEADER_FLAG_DATA_VALID     0x02
+
+#define VIRTIO_NET_HEADER_GSO_NONE 0
+
+//
+// Define the control queue command classes, commands, and acknowledgments.
+//
+
+#define VIRTIO_NET_CONTROL_CLASS_MULTIQUEUE 4
+#define VIRTIO_NET_CONTROL_MULTIQUEUE_SET_PAIRS 0
+
+#define VIRTIO_NET_CONTROL_OK    0
+#define VIRTIO_NET_CONTROL_ERROR 1
+
+//
+// Define the maximum number of receive/transmit queue pairs used. Transmits
+// are spread across the pairs by processor.
+//
+
+#define VIRTNET_MAX_QUEUE_PAIRS 8
+
+//
+// Define the MSI-X vector layout. The first vector reports configuration
+// changes, and each queue pair gets a receive vector and a transmit vector
+// after it. The control queue is polled, so it gets no vector.
+//
+
+#define VIRTNET_CONFIGURATION_VECTOR 0
+#define VIRTNET_RECEIVE_VECTOR(_PairIndex) (1 + ((_PairIndex) * 2))
+#define VIRTNET_TRANSMIT_VECTOR(_PairIndex) (2 + ((_PairIndex) * 2))
+
+#define VIRTNET_MIN_MESSAGE_VECTORS (VIRTNET_TRANSMIT_VECTOR(0) + 1)
+#define VIRTNET_MAX_MESSAGE_VECTORS \
+    (VIRTNET_TRANSMIT_VECTOR(VIRTNET_MAX_QUEUE_PAIRS - 1) + 1)
+
+//
+// Define the number of descriptors requested for each queue.
+//
+
+#define VIRTNET_QUEUE_SIZE 256
+
+//
+// Define the size of each receive buffer and the maximum number of them
+// posted to a receive queue.
+//
+
+#define VIRTNET_RX_BUFFER_SIZE 2048
+#define VIRTNET_RX_BUFFER_COUNT 128
+
+//
+// Define the maximum number of pending transmit packets allowed on a queue
+// before the driver starts to drop packets.
+//
+
+#define VIRTNET_MAX_TRANSMIT_PACKET_LIST_COUNT (VIRTNET_QUEUE_SIZE * 2)
+
+//
+// Define how often to check on a control command, in microseconds. The device
+// is given a second to process each command.
+//
+
+#define VIRTNET_CONTROL_POLL_INTERVAL 100
+
+//
+// Define the link speed reported for the device. Virtual links have no real
+// speed.
+//
+
+#define VIRTNET_LINK_SPEED NET_SPEED_1000_MBPS
+
+//
+// Define the size of the Ethernet header in front of outgoing IP packets.
+//
+
+#define VIRTNET_ETHERNET_HEADER_SIZE ((2 * ETHERNET_ADDRESS_SIZE) + 2)
+
+//
+// Define the offsets of the checksum fields within the TCP and UDP headers.
+//
+
+#define VIRTNET_TCP_CHECKSUM_OFFSET 16
+#define VIRTNET_UDP_CHECKSUM_OFFSET 6
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+/*++
+
+Structure Description:
+
+    This structure defines the header that precedes every packet sent to or
+    received from a virtio network device.
+
+Members:
+
+    Flags - Stores a bitmask of flags. See VIRTIO_NET_HEADER_FLAG_*
+        definitions.
+
+    GsoType - Stores the segmentation offload type. This driver always uses
+        VIRTIO_NET_HEADER_GSO_NONE.
+
+    HeaderLength - Stores the length of the headers for segmentation offload.
+
+    GsoSize - Stores the segment size for segmentation offload.
+
+    ChecksumStart - Stores the offset from the start of the frame where
+        checksumming begins.
+
+    ChecksumOffset - Stores the offset from the checksum start where the
+        checksum is stored.
+
+    BufferCount - Stores the number of receive buffers the packet spans when
+        receive buffers are merged.
+
+--*/
+
+typedef struct _VIRTIO_NET_HEADER {
+    UCHAR Flags;
+    UCHAR GsoType;
+    USHORT HeaderLength;
+    USHORT GsoSize;
+    USHORT ChecksumStart;
+    USHORT ChecksumOffset;
+    USHORT BufferCount;
+} PACKED VIRTIO_NET_HEADER, *PVIRTIO_NET_HEADER;
+
+/*++
+
+Structure Description:
+
+    This structure defines the control command used to set the number of
+    queue pairs.
+
+Members:
+
+    Class - Stores the command class.
+
+    Command - Stores the command within the class.
+
+    QueuePairs - Stores the number of queue pairs to use.
+
+    Acknowledge - Stores the result written by the device.
+
+--*/
+
+typedef struct _VIRTIO_NET_CONTROL_QUEUE_PAIRS {
+    UCHAR Class;
+    UCHAR Command;
+    USHORT QueuePairs;
+    UCHAR Acknowledge;
+} PACKED VIRTIO_NET_CONTROL_QUEUE_PAIRS, *PVIRTIO_NET_CONTROL_QUEUE_PAIRS;
+
+typedef struct _VIRTNET_DEVICE VIRTNET_DEVICE, *PVIRTNET_DEVICE;
+
+/*++
+
+Structure Description:
+
+    This structure defines a receive and transmit queue pair.
+
+Members:
+
+    Device - Stores a pointer back to the device.
+
+    ReceiveQueue - Stores a pointer to the virtio receive queue. The posted
+        network buffers are the cookies of the queue entries.
+
+    ReceiveLock - Stores a pointer to the lock serializing receive processing.
+
+    TransmitQueue - Stores a pointer to the virtio transmit queue.
+
+    TransmitLock - Stores a pointer to the lock serializing transmits.
+
+    TransmitPacketList - Stores the list of packets waiting for room in the
+        transmit queue.
+
+    ReceiveInterruptHandle - Stores the handle of the receive queue's MSI-X
+        interrupt, or INVALID_HANDLE if the shared interrupt is used.
+
+    TransmitInterruptHandle - Stores the handle of the transmit queue's MSI-X
+        interrupt, or INVALID_HANDLE if the shared interrupt is used.
+
+--*/
+
+typedef struct _VIRTNET_QUEUE_PAIR {
+    PVIRTNET_DEVICE Device;
+    PVIRTIO_QUEUE ReceiveQueue;
+    PQUEUED_LOCK ReceiveLock;
+    PVIRTIO_QUEUE TransmitQueue;
+    PQUEUED_LOCK TransmitLock;
+    NET_PACKET_LIST TransmitPacketList;
+    HANDLE ReceiveInterruptHandle;
+    HANDLE TransmitInterruptHandle;
+} VIRTNET_QUEUE_PAIR, *PVIRTNET_QUEUE_PAIR;
+
+/*++
+
+Structure Description:
+
+    This structure defines a virtio network device.
+
+Members:
+
+    OsDevice - Stores a pointer to the OS device object.
+
+    Virtio - Stores the virtio transport state.
+
+    InterruptHandle - Stores the handle to the connected interrupt. With
+        MSI-X, this is the configuration change vector.
+
+    NetworkLink - Stores a pointer to the core networking link.
+
+    PendingStatusBits - Stores the interrupt status bits not yet processed by
+        the worker.
+
+    Started - Stores a boolean indicating if the queues are set up.
+
+    LinkActive - Stores a boolean indicating if the link is up.
+
+    ChecksumFlags - Stores the checksum offload flags advertised to the
+        networking core. See NET_LINK_CHECKSUM_FLAG_* definitions.
+
+    QueuePairCount - Stores the number of queue pairs in use.
+
+    QueuePairs - Stores the queue pairs.
+
+    ControlQueue - Stores a pointer to the control queue, if the device has
+        one and more than one queue pair is in use.
+
+    ControlIoBuffer - Stores a pointer to the I/O buffer holding control
+        commands.
+
+    MacAddress - Stores the device's MAC address.
+
+--*/
+
+struct _VIRTNET_DEVICE {
+    PDEVICE OsDevice;
+    VIRTIO_DEVICE Virtio;
+    HANDLE InterruptHandle;
+    PNET_LINK NetworkLink;
+    volatile ULONG PendingStatusBits;
+    BOOL Started;
+    BOOL LinkActive;
+    ULONG ChecksumFlags;
+    ULONG QueuePairCount;
+    VIRTNET_QUEUE_PAIR QueuePairs[VIRTNET_MAX_QUEUE_PAIRS];
+    PVIRTIO_QUEUE ControlQueue;
+    PIO_BUFFER ControlIoBuffer;
+    BYTE MacAddress[ETHERNET_ADDRESS_SIZE];
+};
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// -------------------------------------------------------- Function Prototypes
+//
+
+//
+// Hardware functions called by the administrative side.
+//
+
+KSTATUS
+VirtnetSend (
+    PVOID DeviceContext,
+    PNET_PACKET_LIST PacketList
+    );
+
+/*++
+
+Routine Description:
+
+    This routine sends data through the network.
+
+Arguments:
+
+    DeviceContext - Supplies a pointer to the device context associated with
+        the link down which this data is to be sent.
+
+    PacketList - Supplies a pointer to a list of network packets to send. Data
+        in these packets may be modified by this routine, but must not be used
+        once this routine returns.
+
+Return Value:
+
+    STATUS_SUCCESS if all packets were sent.
+
+    STATUS_RESOURCE_IN_USE if some or all of the packets were dropped due to
+    the hardware being backed up with too many packets to send.
+
+    Other failure codes indicate that none of the packets were sent.
+
+--*/
+
+KSTATUS
+VirtnetGetSetInformation (
+    PVOID DeviceContext,
+    NET_LINK_INFORMATION_TYPE InformationType,
+    PVOID Data,
+    PUINTN DataSize,
+    BOOL Set
+    );
+
+/*++
+
+Routine Description:
+
+    This routine gets or sets the network device layer's link information.
+
+Arguments:
+
+    DeviceContext - Supplies a pointer to the device context associated with
+        the link for which information is being set or queried.
+
+    InformationType - Supplies the type of information being queried or set.
+
+    Data - Supplies a pointer to the data buffer where the data is either
+        returned for a get operation or given for a set operation.
+
+    DataSize - Supplies a pointer that on input contains the size of the data
+        buffer. On output, contains the required size of the data buffer.
+
+    Set - Supplies a boolean indicating if this is a get operation (FALSE) or a
+        set operation (TRUE).
+
+Return Value:
+
+    Status code.
+
+--*/
+
+KSTATUS
+VirtnetpInitializeDeviceStructures (
+    PVIRTNET_DEVICE Device
+    );
+
+/*++
+
+Routine Description:
+
+    This routine negotiates features with a freshly started virtio network
+    device, reads its configuration, and creates its queues.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+VOID
+VirtnetpDestroyDeviceStructures (
+    PVIRTNET_DEVICE Device
+    );
+
+/*++
+
+Routine Description:
+
+    This routine tears down the queues and buffers of a virtio network device.
+    The device must be reset first.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+Return Value:
+
+    None.
+
+--*/
+
+KSTATUS
+VirtnetpEnableDevice (
+    PVIRTNET_DEVICE Device
+    );
+
+/*++
+
+Routine Description:
+
+    This routine fills the receive queues, tells the device the driver is
+    ready, enables the queue pairs, and reports the initial link state.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+INTERRUPT_STATUS
+VirtnetpInterruptService (
+    PVOID Context
+    );
+
+/*++
+
+Routine Description:
+
+    This routine implements the virtio network interrupt service routine.
+
+Arguments:
+
+    Context - Supplies the context pointer given to the system when the
+        interrupt was connected. In this case, this points to the device
+        structure.
+
+Return Value:
+
+    Interrupt status.
+
+--*/
+
+INTERRUPT_STATUS
+VirtnetpInterruptServiceWorker (
+    PVOID Parameter
+    );
+
+/*++
+
+Routine Description:
+
+    This routine processes interrupts for the virtio network device at low
+    level.
+
+Arguments:
+
+    Parameter - Supplies an optional parameter passed in by the creator of the
+        work item.
+
+Return Value:
+
+    Interrupt status.
+
+--*/
+
+INTERRUPT_STATUS
+VirtnetpMessageInterruptService (
+    PVOID Context
+    );
+
+/*++
+
+Routine Description:
+
+    This routine implements the interrupt service routine for one of the
+    device's MSI-X vectors. The vectors are not shared and message signaled
+    interrupts need no acknowledgement, so it always claims the interrupt and
+    leaves the work to the low level worker.
+
+Arguments:
+
+    Context - Supplies the context pointer given to the system when the
+        interrupt was connected.
+
+Return Value:
+
+    Interrupt status.
+
+--*/
+
+INTERRUPT_STATUS
+VirtnetpConfigurationInterruptWorker (
+    PVOID Parameter
+    );
+
+/*++
+
+Routine Description:
+
+    This routine handles the configuration change MSI-X vector at low level.
+
+Arguments:
+
+    Parameter - Supplies a pointer to the device.
+
+Return Value:
+
+    Interrupt status.
+
+--*/
+
+INTERRUPT_STATUS
+VirtnetpReceiveInterruptWorker (
+    PVOID Parameter
+    );
+
+/*++
+
+Routine Description:
+
+    This routine handles a receive queue's MSI-X vector at low level.
+
+Arguments:
+
+    Parameter - Supplies a pointer to the queue pair.
+
+Return Value:
+
+    Interrupt status.
+
+--*/
+
+INTERRUPT_STATUS
+VirtnetpTransmitInterruptWorker (
+    PVOID Parameter
+    );
+
+/*++
+
+Routine Description:
+
+    This routine handles a transmit queue's MSI-X vector at low level.
+
+Arguments:
+
+    Parameter - Supplies a pointer to the queue pair.
+
+Return Value:
+
+    Interrupt status.
+
+--*/
+
+//
+// Administrative functions called by the hardware side.
+//
+
+KSTATUS
+VirtnetpAddNetworkDevice (
+    PVIRTNET_DEVICE Device
+    );
+
+/*++
+
+Routine Description:
+
+    This routine adds the device to core networking's available links.
+
+Arguments:
+
+    Device - Supplies a pointer to the device to add.
+
+Return Value:
+
+    Status code.
+
+--*/
+
@@ -0,0 +1,1553 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    virtnethw.c
+
+Abstract:
+
+    This module implements the queue handling for the virtio network device
+    driver.
+
+Author:
+
+    agent 16-Oct-2026
+
+Environment:
+
+    Kernel
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <minoca/kernel/driver.h>
+#include <minoca/net/netdrv.h>
+#include <minoca/net/ip4.h>
+#include "virtnet.h"
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+KSTATUS
+VirtnetpSetQueuePairCount (
+    PVIRTNET_DEVICE Device
+    );
+
+VOID
+VirtnetpCheckLink (
+    PVIRTNET_DEVICE Device
+    );
+
+KSTATUS
+VirtnetpPostReceiveBuffer (
+    PVIRTNET_QUEUE_PAIR Pair,
+    PNET_PACKET_BUFFER Packet
+    );
+
+VOID
+VirtnetpReapReceivedFrames (
+    PVIRTNET_QUEUE_PAIR Pair
+    );
+
+PNET_PACKET_BUFFER
+VirtnetpGatherReceivedFrame (
+    PVIRTNET_QUEUE_PAIR Pair,
+    PNET_PACKET_BUFFER FirstPacket,
+    ULONG FirstLength,
+    ULONG BufferCount
+    );
+
+VOID
+VirtnetpReapTransmittedPackets (
+    PVIRTNET_QUEUE_PAIR Pair
+    );
+
+VOID
+VirtnetpSendPendingPackets (
+    PVIRTNET_QUEUE_PAIR Pair
+    );
+
+VOID
+VirtnetpSetTransmitChecksum (
+    PVIRTIO_NET_HEADER Header,
+    PNET_PACKET_BUFFER Packet
+    );
+
+VOID
+VirtnetpFreeOutstandingPackets (
+    PVIRTIO_QUEUE Queue
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+KSTATUS
+VirtnetSend (
+    PVOID DeviceContext,
+    PNET_PACKET_LIST PacketList
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sends data through the network.
+
+Arguments:
+
+    DeviceContext - Supplies a pointer to the device context associated with
+        the link down which this data is to be sent.
+
+    PacketList - Supplies a pointer to a list of network packets to send. Data
+        in these packets may be modified by this routine, but must not be used
+        once this routine returns.
+
+Return Value:
+
+    STATUS_SUCCESS if all packets were sent.
+
+    STATUS_RESOURCE_IN_USE if some or all of the packets were dropped due to
+    the hardware being backed up with too many packets to send.
+
+    Other failure codes indicate that none of the packets were sent.
+
+--*/
+
+{
+
+    PVIRTNET_DEVICE Device;
+    PVIRTNET_QUEUE_PAIR Pair;
+    UINTN PacketListCount;
+    ULONG PairIndex;
+    KSTATUS Status;
+
+    ASSERT(KeGetRunLevel() == RunLevelLow);
+
+    Device = (PVIRTNET_DEVICE)DeviceContext;
+    if (Device->LinkActive == FALSE) {
+        return STATUS_NO_NETWORK_CONNECTION;
+    }
+
+    //
+    // Spread transmits across the queue pairs by processor so that senders on
+    // different processors do not contend on the same lock and queue. The
+    // thread may migrate after the pair is picked, which only costs a little
+    // locality.
+    //
+
+    PairIndex = KeGetCurrentProcessorNumber() % Device->QueuePairCount;
+    Pair = &(Device->QueuePairs[PairIndex]);
+    KeAcquireQueuedLock(Pair->TransmitLock);
+
+    //
+    // Free up whatever the device has finished with to make room.
+    //
+
+    VirtnetpReapTransmittedPackets(Pair);
+
+    //
+    // If there is any room in the packet list, add all of the packets to the
+    // list waiting to be sent.
+    //
+
+    PacketListCount = Pair->TransmitPacketList.Count;
+    if (PacketListCount < VIRTNET_MAX_TRANSMIT_PACKET_LIST_COUNT) {
+        NET_APPEND_PACKET_LIST(PacketList, &(Pair->TransmitPacketList));
+        VirtnetpSendPendingPackets(Pair);
+        Status = STATUS_SUCCESS;
+
+    //
+    // Otherwise report that the resource is use as it is too busy to handle
+    // more packets.
+    //
+
+    } else {
+        Status = STATUS_RESOURCE_IN_USE;
+    }
+
+    KeReleaseQueuedLock(Pair->TransmitLock);
+    return Status;
+}
+
+KSTATUS
+VirtnetGetSetInformation (
+    PVOID DeviceContext,
+    NET_LINK_INFORMATION_TYPE InformationType,
+    PVOID Data,
+    PUINTN DataSize,
+    BOOL Set
+    )
+
+/*++
+
+Routine Description:
+
+    This routine gets or sets the network device layer's link information.
+
+Arguments:
+
+    DeviceContext - Supplies a pointer to the device context associated with
+        the link for which information is being set or queried.
+
+    InformationType - Supplies the type of information being queried or set.
+
+    Data - Supplies a pointer to the data buffer where the data is either
+        returned for a get operation or given for a set operation.
+
+    DataSize - Supplies a pointer that on input contains the size of the data
+        buffer. On output, contains the required size of the data buffer.
+
+    Set - Supplies a boolean indicating if this is a get operation (FALSE) or a
+        set operation (TRUE).
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    PVIRTNET_DEVICE Device;
+    PULONG Flags;
+    KSTATUS Status;
+
+    Device = (PVIRTNET_DEVICE)DeviceContext;
+    switch (InformationType) {
+    case NetLinkInformationChecksumOffload:
+        if (*DataSize != sizeof(ULONG)) {
+            return STATUS_INVALID_PARAMETER;
+        }
+
+        if (Set != FALSE) {
+            return STATUS_NOT_SUPPORTED;
+        }
+
+        Flags = (PULONG)Data;
+        *Flags = Device->ChecksumFlags;
+        Status = STATUS_SUCCESS;
+        break;
+
+    default:
+        Status = STATUS_NOT_SUPPORTED;
+        break;
+    }
+
+    return Status;
+}
+
+KSTATUS
+VirtnetpInitializeDeviceStructures (
+    PVIRTNET_DEVICE Device
+    )
+
+/*++
+
+Routine Description:
+
+    This routine negotiates features with a freshly started virtio network
+    device, reads its configuration, and creates its queues.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    ULONGLONG Features;
+    USHORT MaxPairCount;
+    ULONG MessageVectorCount;
+    PVIRTNET_QUEUE_PAIR Pair;
+    ULONG PairCount;
+    ULONG PairIndex;
+    ULONG ProcessorCount;
+    ULONG QueueCount;
+    KSTATUS Status;
+
+    Status = VirtioNegotiateFeatures(&(Device->Virtio), VIRTNET_FEATURES);
+    if (!KSUCCESS(Status)) {
+        goto InitializeDeviceStructuresEnd;
+    }
+
+    Features = Device->Virtio.Features;
+    if ((Features & VIRTIO_NET_FEATURE_MAC) != 0) {
+        VirtioReadDeviceConfiguration(&(Device->Virtio),
+                                      VIRTIO_NET_CONFIG_MAC_ADDRESS,
+                                      Device->MacAddress,
+                                      sizeof(Device->MacAddress));
+
+    } else {
+        NetCreateEthernetAddress(Device->MacAddress);
+    }
+
+    //
+    // Use a queue pair per processor if the device supports enough of them.
+    // Turning on more than one pair requires a command on the control queue.
+    //
+
+    MaxPairCount = 1;
+    if (((Features & VIRTIO_NET_FEATURE_MULTIQUEUE) != 0) &&
+        ((Features & VIRTIO_NET_FEATURE_CONTROL_QUEUE) != 0)) {
+
+        VirtioReadDeviceConfiguration(&(Device->Virtio),
+                                      VIRTIO_NET_CONFIG_MAX_QUEUE_PAIRS,
+                                      &MaxPairCount,
+                                      sizeof(USHORT));
+
+        if (MaxPairCount == 0) {
+            MaxPairCount = 1;
+        }
+    }
+
+    PairCount = MaxPairCount;
+    ProcessorCount = KeGetActiveProcessorCount();
+    if (PairCount > ProcessorCount) {
+        PairCount = ProcessorCount;
+    }
+
+    if (PairCount > VIRTNET_MAX_QUEUE_PAIRS) {
+        PairCount = VIRTNET_MAX_QUEUE_PAIRS;
+    }
+
+    //
+    // The control queue comes after all the queue pairs the device supports,
+    // not just the ones in use.
+    //
+
+    QueueCount = Device->Virtio.QueueCount;
+    if ((PairCount > 1) && (QueueCount <= (MaxPairCount * 2))) {
+        PairCount = 1;
+    }
+
+    if ((PairCount * 2) > QueueCount) {
+        Status = STATUS_NOT_SUPPORTED;
+        goto InitializeDeviceStructuresEnd;
+    }
+
+    //
+    // With MSI-X, every queue pair needs its own two vectors.
+    //
+
+    MessageVectorCount = Device->Virtio.MessageVectorCount;
+    if (MessageVectorCount != 0) {
+        if (PairCount > ((MessageVectorCount - 1) / 2)) {
+            PairCount = (MessageVectorCount - 1) / 2;
+        }
+
+        ASSERT(PairCount != 0);
+
+        Status = VirtioSetConfigurationVector(&(Device->Virtio),
+                                              VIRTNET_CONFIGURATION_VECTOR);
+
+        if (!KSUCCESS(Status)) {
+            goto InitializeDeviceStructuresEnd;
+        }
+    }
+
+    for (PairIndex = 0; PairIndex < PairCount; PairIndex += 1) {
+        Pair = &(Device->QueuePairs[PairIndex]);
+        Pair->ReceiveLock = KeCreateQueuedLock();
+        Pair->TransmitLock = KeCreateQueuedLock();
+        if ((Pair->ReceiveLock == NULL) || (Pair->TransmitLock == NULL)) {
+            Status = STATUS_INSUFFICIENT_RESOURCES;
+            goto InitializeDeviceStructuresEnd;
+        }
+
+        Status = VirtioCreateQueue(&(Device->Virtio),
+                                   PairIndex * 2,
+                                   VIRTNET_QUEUE_SIZE,
+                                   VIRTNET_RECEIVE_VECTOR(PairIndex),
+                                   &(Pair->ReceiveQueue));
+
+        if (!KSUCCESS(Status)) {
+            goto InitializeDeviceStructuresEnd;
+        }
+
+        Status = VirtioCreateQueue(&(Device->Virtio),
+                                   (PairIndex * 2) + 1,
+                                   VIRTNET_QUEUE_SIZE,
+                                   VIRTNET_TRANSMIT_VECTOR(PairIndex),
+                                   &(Pair->TransmitQueue));
+
+        if (!KSUCCESS(Status)) {
+            goto InitializeDeviceStructuresEnd;
+        }
+    }
+
+    Device->QueuePairCount = PairCount;
+    if (PairCount > 1) {
+        Status = VirtioCreateQueue(&(Device->Virtio),
+                                   MaxPairCount * 2,
+                                   1,
+                                   VIRTIO_MSI_NO_VECTOR,
+                                   &(Device->ControlQueue));
+
+        if (!KSUCCESS(Status)) {
+            goto InitializeDeviceStructuresEnd;
+        }
+
+        Device->ControlIoBuffer = MmAllocateNonPagedIoBuffer(
+                                        0,
+                                        MAX_ULONGLONG,
+                                        sizeof(ULONG),
+                                        sizeof(VIRTIO_NET_CONTROL_QUEUE_PAIRS),
+                                        IO_BUFFER_FLAG_PHYSICALLY_CONTIGUOUS);
+
+        if (Device->ControlIoBuffer == NULL) {
+            Status = STATUS_INSUFFICIENT_RESOURCES;
+            goto InitializeDeviceStructuresEnd;
+        }
+    }
+
+    //
+    // Advertise checksum offload in each direction the device agreed to.
+    //
+
+    Device->ChecksumFlags = 0;
+    if ((Features & VIRTIO_NET_FEATURE_CHECKSUM) != 0) {
+        Device->ChecksumFlags |= NET_LINK_CHECKSUM_FLAG_TRANSMIT_TCP_OFFLOAD |
+                                 NET_LINK_CHECKSUM_FLAG_TRANSMIT_UDP_OFFLOAD;
+    }
+
+    if ((Features & VIRTIO_NET_FEATURE_GUEST_CHECKSUM) != 0) {
+        Device->ChecksumFlags |= NET_LINK_CHECKSUM_FLAG_RECEIVE_TCP_OFFLOAD |
+                                 NET_LINK_CHECKSUM_FLAG_RECEIVE_UDP_OFFLOAD;
+    }
+
+    Status = STATUS_SUCCESS;
+
+InitializeDeviceStructuresEnd:
+    return Status;
+}
+
+VOID
+VirtnetpDestroyDeviceStructures (
+    PVIRTNET_DEVICE Device
+    )
+
+/*++
+
+Routine Description:
+
+    This routine tears down the queues and buffers of a virtio network device.
+    The device must be reset first.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PNET_PACKET_BUFFER Packet;
+    PVIRTNET_QUEUE_PAIR Pair;
+    ULONG PairIndex;
+
+    for (PairIndex = 0; PairIndex < VIRTNET_MAX_QUEUE_PAIRS; PairIndex += 1) {
+        Pair = &(Device->QueuePairs[PairIndex]);
+        if (Pair->ReceiveInterruptHandle != INVALID_HANDLE) {
+            IoDisconnectInterrupt(Pair->ReceiveInterruptHandle);
+            Pair->ReceiveInterruptHandle = INVALID_HANDLE;
+        }
+
+        if (Pair->TransmitInterruptHandle != INVALID_HANDLE) {
+            IoDisconnectInterrupt(Pair->TransmitInterruptHandle);
+            Pair->TransmitInterruptHandle = INVALID_HANDLE;
+        }
+
+        if (Pair->ReceiveQueue != NULL) {
+            VirtnetpFreeOutstandingPackets(Pair->ReceiveQueue);
+            VirtioDestroyQueue(Pair->ReceiveQueue);
+            Pair->ReceiveQueue = NULL;
+        }
+
+        if (Pair->TransmitQueue != NULL) {
+            VirtnetpFreeOutstandingPackets(Pair->TransmitQueue);
+            VirtioDestroyQueue(Pair->TransmitQueue);
+            Pair->TransmitQueue = NULL;
+        }
+
+        while (NET_PACKET_LIST_EMPTY(&(Pair->TransmitPacketList)) == FALSE) {
+            Packet = LIST_VALUE(Pair->TransmitPacketList.Head.Next,
+                                NET_PACKET_BUFFER,
+                                ListEntry);
+
+            NET_REMOVE_PACKET_FROM_LIST(Packet, &(Pair->TransmitPacketList));
+            NetFreeBuffer(Packet);
+        }
+
+        if (Pair->ReceiveLock != NULL) {
+            KeDestroyQueuedLock(Pair->ReceiveLock);
+            Pair->ReceiveLock = NULL;
+        }
+
+        if (Pair->TransmitLock != NULL) {
+            KeDestroyQueuedLock(Pair->TransmitLock);
+            Pair->TransmitLock = NULL;
+        }
+    }
+
+    Device->QueuePairCount = 0;
+    if (Device->ControlQueue != NULL) {
+        VirtioDestroyQueue(Device->ControlQueue);
+        Device->ControlQueue = NULL;
+    }
+
+    if (Device->ControlIoBuffer != NULL) {
+        MmFreeIoBuffer(Device->ControlIoBuffer);
+        Device->ControlIoBuffer = NULL;
+    }
+
+    return;
+}
+
+KSTATUS
+VirtnetpEnableDevice (
+    PVIRTNET_DEVICE Device
+    )
+
+/*++
+
+Routine Description:
+
+    This routine fills the receive queues, tells the device the driver is
+    ready, enables the queue pairs, and reports the initial link state.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    ULONG BufferCount;
+    ULONG BufferIndex;
+    PNET_PACKET_BUFFER Packet;
+    PVIRTNET_QUEUE_PAIR Pair;
+    ULONG PairIndex;
+    KSTATUS Status;
+
+    for (PairIndex = 0; PairIndex < Device->QueuePairCount; PairIndex += 1) {
+        Pair = &(Device->QueuePairs[PairIndex]);
+        BufferCount = Pair->ReceiveQueue->Size;
+        if (BufferCount > VIRTNET_RX_BUFFER_COUNT) {
+            BufferCount = VIRTNET_RX_BUFFER_COUNT;
+        }
+
+        for (BufferIndex = 0; BufferIndex < BufferCount; BufferIndex += 1) {
+            Status = NetAllocateBuffer(0,
+                                       VIRTNET_RX_BUFFER_SIZE,
+                                       0,
+                                       Device->NetworkLink,
+                                       0,
+                                       &Packet);
+
+            if (!KSUCCESS(Status)) {
+                goto EnableDeviceEnd;
+            }
+
+            Status = VirtnetpPostReceiveBuffer(Pair, Packet);
+            if (!KSUCCESS(Status)) {
+                NetFreeBuffer(Packet);
+                goto EnableDeviceEnd;
+            }
+        }
+
+        VirtioQueueNotify(Pair->ReceiveQueue);
+    }
+
+    VirtioSetDriverReady(&(Device->Virtio));
+    if (Device->ControlQueue != NULL) {
+        Status = VirtnetpSetQueuePairCount(Device);
+        if (!KSUCCESS(Status)) {
+            goto EnableDeviceEnd;
+        }
+    }
+
+    VirtnetpCheckLink(Device);
+    Status = STATUS_SUCCESS;
+
+EnableDeviceEnd:
+    return Status;
+}
+
+INTERRUPT_STATUS
+VirtnetpInterruptService (
+    PVOID Context
+    )
+
+/*++
+
+Routine Description:
+
+    This routine implements the virtio network interrupt service routine.
+
+Arguments:
+
+    Context - Supplies the context pointer given to the system when the
+        interrupt was connected. In this case, this points to the device
+        structure.
+
+Return Value:
+
+    Interrupt status.
+
+--*/
+
+{
+
+    PVIRTNET_DEVICE Device;
+    ULONG PendingBits;
+
+    Device = (PVIRTNET_DEVICE)Context;
+
+    //
+    // Reading the interrupt status register also acknowledges and lowers the
+    // interrupt.
+    //
+
+    PendingBits = VirtioReadInterruptStatus(&(Device->Virtio));
+    if (PendingBits == 0) {
+        return InterruptStatusNotClaimed;
+    }
+
+    RtlAtomicOr32(&(Device->PendingStatusBits), PendingBits);
+    return InterruptStatusClaimed;
+}
+
+INTERRUPT_STATUS
+VirtnetpInterruptServiceWorker (
+    PVOID Parameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine processes interrupts for the virtio network device at low
+    level.
+
+Arguments:
+
+    Parameter - Supplies an optional parameter passed in by the creator of the
+        work item.
+
+Return Value:
+
+    Interrupt status.
+
+--*/
+
+{
+
+    PVIRTNET_DEVICE Device;
+    PVIRTNET_QUEUE_PAIR Pair;
+    ULONG PairIndex;
+    ULONG PendingBits;
+
+    Device = (PVIRTNET_DEVICE)(Parameter);
+
+    ASSERT(KeGetRunLevel() == RunLevelLow);
+
+    //
+    // Clear out the pending bits.
+    //
+
+    PendingBits = RtlAtomicExchange32(&(Device->PendingStatusBits), 0);
+    if (PendingBits == 0) {
+        return InterruptStatusNotClaimed;
+    }
+
+    //
+    // Handle link status changes.
+    //
+
+    if ((PendingBits & VIRTIO_ISR_CONFIGURATION) != 0) {
+        VirtnetpCheckLink(Device);
+    }
+
+    //
+    // The shared legacy interrupt does not say which queue needs attention,
+    // so look at all of them.
+    //
+
+    if ((PendingBits & VIRTIO_ISR_QUEUE) != 0) {
+        for (PairIndex = 0;
+             PairIndex < Device->QueuePairCount;
+             PairIndex += 1) {
+
+            Pair = &(Device->QueuePairs[PairIndex]);
+            VirtnetpReapReceivedFrames(Pair);
+            KeAcquireQueuedLock(Pair->TransmitLock);
+            VirtnetpReapTransmittedPackets(Pair);
+            KeReleaseQueuedLock(Pair->TransmitLock);
+        }
+    }
+
+    return InterruptStatusClaimed;
+}
+
+INTERRUPT_STATUS
+VirtnetpMessageInterruptService (
+    PVOID Context
+    )
+
+/*++
+
+Routine Description:
+
+    This routine implements the interrupt service routine for one of the
+    device's MSI-X vectors. The vectors are not shared and message signaled
+    interrupts need no acknowledgement, so it always claims the interrupt and
+    leaves the work to the low level worker.
+
+Arguments:
+
+    Context - Supplies the context pointer given to the system when the
+        interrupt was connected.
+
+Return Value:
+
+    Interrupt status.
+
+--*/
+
+{
+
+    return InterruptStatusClaimed;
+}
+
+INTERRUPT_STATUS
+VirtnetpConfigurationInterruptWorker (
+    PVOID Parameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles the configuration change MSI-X vector at low level.
+
+Arguments:
+
+    Parameter - Supplies a pointer to the device.
+
+Return Value:
+
+    Interrupt status.
+
+--*/
+
+{
+
+    ASSERT(KeGetRunLevel() == RunLevelLow);
+
+    VirtnetpCheckLink(Parameter);
+    return InterruptStatusClaimed;
+}
+
+INTERRUPT_STATUS
+VirtnetpReceiveInterruptWorker (
+    PVOID Parameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles a receive queue's MSI-X vector at low level.
+
+Arguments:
+
+    Parameter - Supplies a pointer to the queue pair.
+
+Return Value:
+
+    Interrupt status.
+
+--*/
+
+{
+
+    ASSERT(KeGetRunLevel() == RunLevelLow);
+
+    VirtnetpReapReceivedFrames(Parameter);
+    return InterruptStatusClaimed;
+}
+
+INTERRUPT_STATUS
+VirtnetpTransmitInterruptWorker (
+    PVOID Parameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles a transmit queue's MSI-X vector at low level.
+
+Arguments:
+
+    Parameter - Supplies a pointer to the queue pair.
+
+Return Value:
+
+    Interrupt status.
+
+--*/
+
+{
+
+    PVIRTNET_QUEUE_PAIR Pair;
+
+    ASSERT(KeGetRunLevel() == RunLevelLow);
+
+    Pair = Parameter;
+    KeAcquireQueuedLock(Pair->TransmitLock);
+    VirtnetpReapTransmittedPackets(Pair);
+    KeReleaseQueuedLock(Pair->TransmitLock);
+    return InterruptStatusClaimed;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+KSTATUS
+VirtnetpSetQueuePairCount (
+    PVIRTNET_DEVICE Device
+    )
+
+/*++
+
+Routine Description:
+
+    This routine tells the device how many queue pairs to use. The device
+    starts out with just the first pair.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    VIRTIO_BUFFER Buffers[2];
+    PVIRTIO_NET_CONTROL_QUEUE_PAIRS Command;
+    PVOID Cookie;
+    ULONG Length;
+    PHYSICAL_ADDRESS PhysicalAddress;
+    KSTATUS Status;
+    ULONGLONG Time;
+    ULONGLONG Timeout;
+
+    Command = Device->ControlIoBuffer->Fragment[0].VirtualAddress;
+    PhysicalAddress = Device->ControlIoBuffer->Fragment[0].PhysicalAddress;
+    Command->Class = VIRTIO_NET_CONTROL_CLASS_MULTIQUEUE;
+    Command->Command = VIRTIO_NET_CONTROL_MULTIQUEUE_SET_PAIRS;
+    Command->QueuePairs = Device->QueuePairCount;
+    Command->Acknowledge = VIRTIO_NET_CONTROL_ERROR;
+    Buffers[0].Address = PhysicalAddress;
+    Buffers[0].Length = FIELD_OFFSET(VIRTIO_NET_CONTROL_QUEUE_PAIRS,
+                                     Acknowledge);
+
+    Buffers[1].Address = PhysicalAddress + Buffers[0].Length;
+    Buffers[1].Length = sizeof(Command->Acknowledge);
+
+    //
+    // The control queue is only used here, so poll for the result rather than
+    // taking an interrupt for it.
+    //
+
+    VirtioQueueDisableInterrupts(Device->ControlQueue);
+    Status = VirtioQueueAddBuffers(Device->ControlQueue,
+                                   Buffers,
+                                   1,
+                                   1,
+                                   Command);
+
+    if (!KSUCCESS(Status)) {
+        goto SetQueuePairCountEnd;
+    }
+
+    VirtioQueueNotify(Device->ControlQueue);
+    Status = STATUS_TIMEOUT;
+    Time = HlQueryTimeCounter();
+    Timeout = Time + HlQueryTimeCounterFrequency();
+    while (Time <= Timeout) {
+        if (VirtioQueueGetUsedBuffer(Device->ControlQueue,
+                                     &Cookie,
+                                     &Length) != FALSE) {
+
+            Status = STATUS_SUCCESS;
+            break;
+        }
+
+        HlBusySpin(VIRTNET_CONTROL_POLL_INTERVAL);
+        Time = HlQueryTimeCounter();
+    }
+
+    if (!KSUCCESS(Status)) {
+        goto SetQueuePairCountEnd;
+    }
+
+    if (Command->Acknowledge != VIRTIO_NET_CONTROL_OK) {
+        Status = STATUS_DEVICE_IO_ERROR;
+        goto SetQueuePairCountEnd;
+    }
+
+SetQueuePairCountEnd:
+    if (!KSUCCESS(Status)) {
+        RtlDebugPrint("Virtnet: Failed to enable %d queue pairs: %d\n",
+                      Device->QueuePairCount,
+                      Status);
+    }
+
+    return Status;
+}
+
+VOID
+VirtnetpCheckLink (
+    PVIRTNET_DEVICE Device
+    )
+
+/*++
+
+Routine Description:
+
+    This routine reads the device's link state and reports any change to the
+    networking core.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    BOOL LinkActive;
+    USHORT Status;
+
+    //
+    // Without the status feature the link is always up.
+    //
+
+    LinkActive = TRUE;
+    if ((Device->Virtio.Features & VIRTIO_NET_FEATURE_STATUS) != 0) {
+        VirtioReadDeviceConfiguration(&(Device->Virtio),
+                                      VIRTIO_NET_CONFIG_STATUS,
+                                      &Status,
+                                      sizeof(USHORT));
+
+        if ((Status & VIRTIO_NET_STATUS_LINK_UP) == 0) {
+            LinkActive = FALSE;
+        }
+    }
+
+    if (LinkActive == Device->LinkActive) {
+        return;
+    }
+
+    Device->LinkActive = LinkActive;
+    if (LinkActive != FALSE) {
+        NetSetLinkState(Device->NetworkLink, TRUE, VIRTNET_LINK_SPEED);
+
+    } else {
+        NetSetLinkState(Device->NetworkLink, FALSE, 0);
+    }
+
+    return;
+}
+
+KSTATUS
+VirtnetpPostReceiveBuffer (
+    PVIRTNET_QUEUE_PAIR Pair,
+    PNET_PACKET_BUFFER Packet
+    )
+
+/*++
+
+Routine Description:
+
+    This routine hands a receive buffer to the device. The caller is
+    responsible for notifying the device.
+
+Arguments:
+
+    Pair - Supplies a pointer to the queue pair to post the buffer to.
+
+    Packet - Supplies a pointer to the network buffer to post. The whole
+        buffer is given to the device.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    VIRTIO_BUFFER Buffer;
+
+    Buffer.Address = Packet->BufferPhysicalAddress;
+    Buffer.Length = Packet->BufferSize;
+    return VirtioQueueAddBuffers(Pair->ReceiveQueue, &Buffer, 0, 1, Packet);
+}
+
+VOID
+VirtnetpReapReceivedFrames (
+    PVIRTNET_QUEUE_PAIR Pair
+    )
+
+/*++
+
+Routine Description:
+
+    This routine processes any received frames from the network.
+
+Arguments:
+
+    Pair - Supplies a pointer to the queue pair to process.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG BufferCount;
+    PVOID Cookie;
+    PVIRTNET_DEVICE Device;
+    PNET_PACKET_BUFFER Frame;
+    PVIRTIO_NET_HEADER Header;
+    ULONG Length;
+    PNET_PACKET_BUFFER Packet;
+    BOOL Posted;
+    KSTATUS Status;
+
+    Device = Pair->Device;
+    Posted = FALSE;
+    KeAcquireQueuedLock(Pair->ReceiveLock);
+    while (VirtioQueueGetUsedBuffer(Pair->ReceiveQueue,
+                                    &Cookie,
+                                    &Length) != FALSE) {
+
+        Packet = Cookie;
+        Header = Packet->Buffer;
+        Frame = NULL;
+        if (Length < sizeof(VIRTIO_NET_HEADER)) {
+            RtlDebugPrint("Virtnet: Runt frame of %d bytes.\n", Length);
+            goto RepostBuffer;
+        }
+
+        //
+        // With merged receive buffers a large frame can span several buffers,
+        // which get copied together into a separate packet.
+        //
+
+        BufferCount = 1;
+        if ((Device->Virtio.Features &
+             VIRTIO_NET_FEATURE_MERGE_RX_BUFFERS) != 0) {
+
+            BufferCount = Header->BufferCount;
+        }
+
+        Frame = Packet;
+        if (BufferCount > 1) {
+            Frame = VirtnetpGatherReceivedFrame(Pair,
+                                                Packet,
+                                                Length,
+                                                BufferCount);
+
+            if (Frame == NULL) {
+                goto RepostBuffer;
+            }
+
+        } else {
+            Packet->DataSize = Length;
+            Packet->DataOffset = sizeof(VIRTIO_NET_HEADER);
+            Packet->FooterOffset = Length;
+        }
+
+        //
+        // The device either validated the checksum or, for packets looped back
+        // from the same host, never computed one. Either way the networking
+        // core should not check it.
+        //
+
+        Frame->Flags = 0;
+        if ((Header->Flags &
+             (VIRTIO_NET_HEADER_FLAG_DATA_VALID |
+              VIRTIO_NET_HEADER_FLAG_NEEDS_CHECKSUM)) != 0) {
+
+            Frame->Flags |= NET_PACKET_FLAG_TCP_CHECKSUM_OFFLOAD |
+                            NET_PACKET_FLAG_UDP_CHECKSUM_OFFLOAD;
+        }
+
+        NetProcessReceivedPacket(Device->NetworkLink, Frame);
+        if (Frame != Packet) {
+            NetFreeBuffer(Frame);
+        }
+
+RepostBuffer:
+        Status = VirtnetpPostReceiveBuffer(Pair, Packet);
+        if (!KSUCCESS(Status)) {
+            NetFreeBuffer(Packet);
+
+        } else {
+            Posted = TRUE;
+        }
+    }
+
+    if (Posted != FALSE) {
+        VirtioQueueNotify(Pair->ReceiveQueue);
+    }
+
+    KeReleaseQueuedLock(Pair->ReceiveLock);
+    return;
+}
+
+PNET_PACKET_BUFFER
+VirtnetpGatherReceivedFrame (
+    PVIRTNET_QUEUE_PAIR Pair,
+    PNET_PACKET_BUFFER FirstPacket,
+    ULONG FirstLength,
+    ULONG BufferCount
+    )
+
+/*++
+
+Routine Description:
+
+    This routine copies a frame that spans several merged receive buffers
+    into a single packet. The remaining buffers are pulled off the receive
+    queue and reposted. This routine assumes the receive lock is held.
+
+Arguments:
+
+    Pair - Supplies a pointer to the queue pair that received the frame.
+
+    FirstPacket - Supplies a pointer to the first buffer of the frame, which
+        starts with the virtio header. This buffer is not reposted.
+
+    FirstLength - Supplies the number of bytes the device wrote to the first
+        buffer.
+
+    BufferCount - Supplies the total number of buffers the frame spans.
+
+Return Value:
+
+    Returns a pointer to the new packet on success. The caller is responsible
+    for freeing it.
+
+    NULL if the frame was dropped.
+
+--*/
+
+{
+
+    PVOID Cookie;
+    UINTN CopyOffset;
+    PNET_PACKET_BUFFER Frame;
+    ULONG Index;
+    ULONG Length;
+    PNET_PACKET_BUFFER Packet;
+    KSTATUS Status;
+
+    Status = NetAllocateBuffer(0,
+                               BufferCount * VIRTNET_RX_BUFFER_SIZE,
+                               0,
+                               NULL,
+                               0,
+                               &Frame);
+
+    if (!KSUCCESS(Status)) {
+        Frame = NULL;
+    }
+
+    CopyOffset = 0;
+    if (Frame != NULL) {
+        RtlCopyMemory(Frame->Buffer, FirstPacket->Buffer, FirstLength);
+        CopyOffset = FirstLength;
+    }
+
+    //
+    // Always pull all the pieces of the frame off the queue, even if the
+    // frame is being dropped, so that the next frame starts in the right
+    // place.
+    //
+
+    for (Index = 1; Index < BufferCount; Index += 1) {
+        if (VirtioQueueGetUsedBuffer(Pair->ReceiveQueue,
+                                     &Cookie,
+                                     &Length) == FALSE) {
+
+            RtlDebugPrint("Virtnet: Missing merged receive buffer.\n");
+            if (Frame != NULL) {
+                NetFreeBuffer(Frame);
+                Frame = NULL;
+            }
+
+            break;
+        }
+
+        Packet = Cookie;
+        if (Frame != NULL) {
+            RtlCopyMemory(Frame->Buffer + CopyOffset, Packet->Buffer, Length);
+            CopyOffset += Length;
+        }
+
+        Status = VirtnetpPostReceiveBuffer(Pair, Packet);
+        if (!KSUCCESS(Status)) {
+            NetFreeBuffer(Packet);
+        }
+    }
+
+    if (Frame != NULL) {
+        Frame->DataSize = CopyOffset;
+        Frame->DataOffset = sizeof(VIRTIO_NET_HEADER);
+        Frame->FooterOffset = CopyOffset;
+    }
+
+    return Frame;
+}
+
+VOID
+VirtnetpReapTransmittedPackets (
+    PVIRTNET_QUEUE_PAIR Pair
+    )
+
+/*++
+
+Routine Description:
+
+    This routine frees the packets the device has finished sending and sends
+    more packets if any are waiting. This routine assumes the transmit lock is
+    held.
+
+Arguments:
+
+    Pair - Supplies a pointer to the queue pair to process.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PVOID Cookie;
+    ULONG Length;
+    BOOL Reaped;
+
+    Reaped = FALSE;
+    while (VirtioQueueGetUsedBuffer(Pair->TransmitQueue,
+                                    &Cookie,
+                                    &Length) != FALSE) {
+
+        NetFreeBuffer((PNET_PACKET_BUFFER)Cookie);
+        Reaped = TRUE;
+    }
+
+    if ((Reaped != FALSE) &&
+        (NET_PACKET_LIST_EMPTY(&(Pair->TransmitPacketList)) == FALSE)) {
+
+        VirtnetpSendPendingPackets(Pair);
+    }
+
+    return;
+}
+
+VOID
+VirtnetpSendPendingPackets (
+    PVIRTNET_QUEUE_PAIR Pair
+    )
+
+/*++
+
+Routine Description:
+
+    This routine moves as many waiting packets as will fit onto the transmit
+    queue. This routine assumes the transmit lock is held.
+
+Arguments:
+
+    Pair - Supplies a pointer to the queue pair to send on.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    VIRTIO_BUFFER Buffer;
+    PVIRTIO_NET_HEADER Header;
+    PNET_PACKET_BUFFER Packet;
+    BOOL Queued;
+    KSTATUS Status;
+
+    Queued = FALSE;
+    while ((NET_PACKET_LIST_EMPTY(&(Pair->TransmitPacketList)) == FALSE) &&
+           (Pair->TransmitQueue->FreeCount != 0)) {
+
+        Packet = LIST_VALUE(Pair->TransmitPacketList.Head.Next,
+                            NET_PACKET_BUFFER,
+                            ListEntry);
+
+        NET_REMOVE_PACKET_FROM_LIST(Packet, &(Pair->TransmitPacketList));
+
+        //
+        // The link reserves room for the virtio header in front of every
+        // packet, so the header and frame go out in a single descriptor.
+        //
+
+        if (Packet->DataOffset < sizeof(VIRTIO_NET_HEADER)) {
+            RtlDebugPrint("Virtnet: Dropping packet with no header space.\n");
+            NetFreeBuffer(Packet);
+            continue;
+        }
+
+        Packet->DataOffset -= sizeof(VIRTIO_NET_HEADER);
+        Header = Packet->Buffer + Packet->DataOffset;
+        RtlZeroMemory(Header, sizeof(VIRTIO_NET_HEADER));
+        Header->GsoType = VIRTIO_NET_HEADER_GSO_NONE;
+        if ((Packet->Flags &
+             (NET_PACKET_FLAG_TCP_CHECKSUM_OFFLOAD |
+              NET_PACKET_FLAG_UDP_CHECKSUM_OFFLOAD)) != 0) {
+
+            VirtnetpSetTransmitChecksum(Header, Packet);
+        }
+
+        Buffer.Address = Packet->BufferPhysicalAddress + Packet->DataOffset;
+        Buffer.Length = Packet->FooterOffset - Packet->DataOffset;
+        Status = VirtioQueueAddBuffers(Pair->TransmitQueue,
+                                       &Buffer,
+                                       1,
+                                       0,
+                                       Packet);
+
+        ASSERT(KSUCCESS(Status));
+
+        if (!KSUCCESS(Status)) {
+            NetFreeBuffer(Packet);
+            continue;
+        }
+
+        Queued = TRUE;
+    }
+
+    if (Queued != FALSE) {
+        VirtioQueueNotify(Pair->TransmitQueue);
+    }
+
+    return;
+}
+
+VOID
+VirtnetpSetTransmitChecksum (
+    PVIRTIO_NET_HEADER Header,
+    PNET_PACKET_BUFFER Packet
+    )
+
+/*++
+
+Routine Description:
+
+    This routine asks the device to fill in the TCP or UDP checksum of an
+    outgoing IPv4 frame. The networking core leaves the checksum field zeroed
+    for offloaded packets; the device expects it to hold the folded
+    pseudo-header sum.
+
+Arguments:
+
+    Header - Supplies a pointer to the virtio header in front of the frame.
+
+    Packet - Supplies a pointer to the packet, whose data offset points at the
+        virtio header.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG Address;
+    PUSHORT Checksum;
+    USHORT ChecksumOffset;
+    USHORT EtherType;
+    USHORT Fragment;
+    PUCHAR Frame;
+    UINTN FrameSize;
+    ULONG HeaderLength;
+    PIP4_HEADER IpHeader;
+    ULONG Sum;
+    ULONG TotalLength;
+
+    Frame = Packet->Buffer + Packet->DataOffset + sizeof(VIRTIO_NET_HEADER);
+    FrameSize = Packet->FooterOffset - Packet->DataOffset -
+                sizeof(VIRTIO_NET_HEADER);
+
+    if (FrameSize < VIRTNET_ETHERNET_HEADER_SIZE + sizeof(IP4_HEADER)) {
+        return;
+    }
+
+    RtlCopyMemory(&EtherType,
+                  Frame + (2 * ETHERNET_ADDRESS_SIZE),
+                  sizeof(USHORT));
+
+    if (EtherType != CPU_TO_NETWORK16(IP4_PROTOCOL_NUMBER)) {
+        return;
+    }
+
+    IpHeader = (PIP4_HEADER)(Frame + VIRTNET_ETHERNET_HEADER_SIZE);
+    HeaderLength = (IpHeader->VersionAndHeaderLength &
+                    IP4_HEADER_LENGTH_MASK) * sizeof(ULONG);
+
+    TotalLength = NETWORK_TO_CPU16(IpHeader->TotalLength);
+
+    //
+    // Fragments only carry part of the transport payload, so the device
+    // cannot compute its checksum. Leave those alone.
+    //
+
+    Fragment = NETWORK_TO_CPU16(IpHeader->FragmentOffset);
+    if (((Fragment & IP4_FRAGMENT_OFFSET_MASK) != 0) ||
+        (((Fragment >> IP4_FRAGMENT_FLAGS_SHIFT) &
+          IP4_FLAG_MORE_FRAGMENTS) != 0)) {
+
+        return;
+    }
+
+    if (IpHeader->Protocol == SOCKET_INTERNET_PROTOCOL_TCP) {
+        ChecksumOffset = VIRTNET_TCP_CHECKSUM_OFFSET;
+
+    } else if (IpHeader->Protocol == SOCKET_INTERNET_PROTOCOL_UDP) {
+        ChecksumOffset = VIRTNET_UDP_CHECKSUM_OFFSET;
+
+    } else {
+        return;
+    }
+
+    if ((TotalLength < HeaderLength + ChecksumOffset + sizeof(USHORT)) ||
+        (VIRTNET_ETHERNET_HEADER_SIZE + TotalLength > FrameSize)) {
+
+        return;
+    }
+
+    //
+    // Sum the pseudo-header in network order: the addresses, the protocol,
+    // and the transport length. Summing the raw words produces the checksum
+    // already in network order.
+    //
+
+    Address = IpHeader->SourceAddress;
+    Sum = (Address & 0xFFFF) + (Address >> 16);
+    Address = IpHeader->DestinationAddress;
+    Sum += (Address & 0xFFFF) + (Address >> 16);
+    Sum += CPU_TO_NETWORK16((USHORT)IpHeader->Protocol);
+    Sum += CPU_TO_NETWORK16((USHORT)(TotalLength - HeaderLength));
+    while ((Sum >> 16) != 0) {
+        Sum = (Sum & 0xFFFF) + (Sum >> 16);
+    }
+
+    Header->Flags = VIRTIO_NET_HEADER_FLAG_NEEDS_CHECKSUM;
+    Header->ChecksumStart = VIRTNET_ETHERNET_HEADER_SIZE + HeaderLength;
+    Header->ChecksumOffset = ChecksumOffset;
+    Checksum = (PUSHORT)(Frame + Header->ChecksumStart + ChecksumOffset);
+    *Checksum = (USHORT)Sum;
+    return;
+}
+
+VOID
+VirtnetpFreeOutstandingPackets (
+    PVIRTIO_QUEUE Queue
+    )
+
+/*++
+
+Routine Description:
+
+    This routine frees the network buffers still handed to a queue that has
+    been stopped by resetting the device.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG Index;
+
+    for (Index = 0; Index < Queue->Size; Index += 1) {
+        if (Queue->Cookies[Index] != NULL) {
+            NetFreeBuffer(Queue->Cookies[Index]);
+            Queue->Cookies[Index] = NULL;
+        }
+    }
+
+    return;
+}
+
@@ -283,6 +283,7 @@ Return Value:
 
 {
 
+    ULONG Alignment;
     PNET_DATA_LINK_ENTRY CurrentDataLink;
     PLIST_ENTRY CurrentEntry;
     PNET_NETWORK_ENTRY CurrentNetwork;
@@ -344,6 +345,25 @@ Return Value:
                               0,
                               NetpCompareAddressTranslationEntries);
 
+    //
+    // An alignment of zero means the link does not care. Treat it as one so
+    // that the link shares a pool with other unconstrained links, and
+    // allocations from the pool match what the link asks for.
+    //
+
+    Alignment = Link->Properties.TransmitAlignment;
+    if (Alignment == 0) {
+        Alignment = 1;
+    }
+
+    Status = NetpGetBufferPool(Link->Properties.MaxPhysicalAddress,
+                               Alignment,
+                               &(Link->BufferPool));
+
+    if (!KSUCCESS(Status)) {
+        goto AddLinkEnd;
+    }
+
     //
     // Find the appropriate data link layer and initialize it for this link.
     //
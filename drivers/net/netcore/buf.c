@@ -14,7 +14,10 @@ Module Name:
 Abstract:
 
     This module handles common buffer-related support for the core networking
-    library.
+    library. Packet buffers come from pools keyed by DMA constraints. Each
+    pool has a few fixed size classes, and each class keeps a small cache of
+    free buffers per processor in front of a shared depot, so the common
+    allocate and free paths never take a lock.
 
 Author:
 
@@ -37,24 +40,203 @@ Module Name:
 // ---------------------------------------------------------------- Definitions
 //
 
+//
+// Define the number of buffer size classes in each pool. Requests larger than
+// the biggest class are allocated directly and released when freed.
+//
+
+#define NET_BUFFER_CLASS_COUNT 3
+
+//
+// Define the number of free buffers each processor caches per size class,
+// and the number of buffers moved between a processor cache and the depot at
+// once.
+//
+
+#define NET_BUFFER_CACHE_SIZE 32
+#define NET_BUFFER_BATCH_SIZE 16
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
 
+/*++
+
+Structure Description:
+
+    This structure defines one processor's cache of free buffers for a size
+    class. It is only touched at dispatch level on its own processor.
+
+Members:
+
+    Count - Stores the number of buffers in the cache.
+
+    Allocations - Stores the number of allocations made on this processor.
+
+    Hits - Stores the number of allocations satisfied from the cache.
+
+    Buffers - Stores the cached buffers. Only the pointers live here, so the
+        paged buffer structures are never touched at dispatch level.
+
+--*/
+
+typedef struct _NET_BUFFER_CACHE {
+    ULONG Count;
+    ULONGLONG Allocations;
+    ULONGLONG Hits;
+    PNET_PACKET_BUFFER Buffers[NET_BUFFER_CACHE_SIZE];
+} NET_BUFFER_CACHE, *PNET_BUFFER_CACHE;
+
+/*++
+
+Structure Description:
+
+    This structure defines a size class within a packet buffer pool.
+
+Members:
+
+    Pool - Stores a pointer to the pool that owns the class.
+
+    Size - Stores the size of every buffer in the class, in bytes.
+
+    Caches - Stores an array of per-processor caches.
+
+    DepotList - Stores the head of the list of free buffers shared by all
+        processors. This is protected by the pool lock.
+
+    DepotCount - Stores the number of buffers on the depot list.
+
+    DepotRefills - Stores the number of batches moved from the depot into a
+        processor cache.
+
+    DepotDrains - Stores the number of batches moved from a processor cache
+        into the depot.
+
+    NewBuffers - Stores the number of buffers created for the class.
+
+--*/
+
+typedef struct _NET_BUFFER_CLASS {
+    PNET_BUFFER_POOL Pool;
+    ULONG Size;
+    PNET_BUFFER_CACHE Caches;
+    LIST_ENTRY DepotList;
+    ULONG DepotCount;
+    ULONGLONG DepotRefills;
+    ULONGLONG DepotDrains;
+    ULONGLONG NewBuffers;
+} NET_BUFFER_CLASS, *PNET_BUFFER_CLASS;
+
+/*++
+
+Structure Description:
+
+    This structure defines a pool of packet buffers that share the same DMA
+    constraints.
+
+Members:
+
+    ListEntry - Stores pointers to the next and previous pools.
+
+    Id - Stores the identifier of the pool, reported with its statistics.
+
+    Physical - Stores a boolean indicating if the pool's buffers are
+        physically contiguous and non-paged (TRUE) or paged (FALSE).
+
+    MaxPhysicalAddress - Stores the maximum physical address of any buffer
+        in the pool.
+
+    Alignment - Stores the alignment of the pool's buffers.
+
+    Lock - Stores a pointer to the lock protecting the depots.
+
+    ProcessorCount - Stores the number of processors that have caches.
+
+    Classes - Stores the pool's size classes, smallest first.
+
+--*/
+
+struct _NET_BUFFER_POOL {
+    LIST_ENTRY ListEntry;
+    ULONG Id;
+    BOOL Physical;
+    PHYSICAL_ADDRESS MaxPhysicalAddress;
+    ULONG Alignment;
+    PQUEUED_LOCK Lock;
+    ULONG ProcessorCount;
+    NET_BUFFER_CLASS Classes[NET_BUFFER_CLASS_COUNT];
+};
+
 //
 // ----------------------------------------------- Internal Function Prototypes
 //
 
+PNET_BUFFER_POOL
+NetpCreateBufferPool (
+    BOOL Physical,
+    PHYSICAL_ADDRESS MaxPhysicalAddress,
+    ULONG Alignment
+    );
+
+VOID
+NetpDestroyBufferPool (
+    PNET_BUFFER_POOL Pool
+    );
+
+PNET_PACKET_BUFFER
+NetpAllocatePooledBuffer (
+    PNET_BUFFER_CLASS Class
+    );
+
+VOID
+NetpReleasePooledBuffers (
+    PNET_BUFFER_CLASS Class,
+    PNET_PACKET_BUFFER *Buffers,
+    ULONG Count
+    );
+
+VOID
+NetpTrimBufferPool (
+    PNET_BUFFER_POOL Pool
+    );
+
+PNET_PACKET_BUFFER
+NetpCreateBuffer (
+    BOOL Physical,
+    PHYSICAL_ADDRESS MaxPhysicalAddress,
+    ULONG Alignment,
+    ULONG Size
+    );
+
+VOID
+NetpDestroyBuffer (
+    PNET_PACKET_BUFFER Buffer
+    );
+
 //
 // -------------------------------------------------------------------- Globals
 //
 
 //
-// Store a pointer to the global list of network buffers.
+// Define the buffer size classes: header-only packets, standard MTU frames,
+// and jumbo frames.
+//
+
+const ULONG NetBufferClassSizes[NET_BUFFER_CLASS_COUNT] = {
+    256,
+    2048,
+    9216
+};
+
+//
+// Store the list of buffer pools. The pool for buffers allocated without a
+// link is always first.
 //
 
-LIST_ENTRY NetFreeBufferList;
-PQUEUED_LOCK NetBufferListLock;
+LIST_ENTRY NetBufferPoolList;
+PQUEUED_LOCK NetBufferPoolListLock;
+ULONG NetBufferNextPoolId;
+PNET_BUFFER_POOL NetPagedBufferPool;
 
 //
 // ------------------------------------------------------------------ Functions
@@ -111,18 +293,16 @@ Return Value:
 
     ULONG Alignment;
     PNET_PACKET_BUFFER Buffer;
-    PHYSICAL_ADDRESS BufferPhysical;
-    ULONGLONG BufferSize;
-    PLIST_ENTRY CurrentEntry;
+    PNET_BUFFER_CLASS Class;
+    ULONG ClassIndex;
     PNET_DATA_LINK_ENTRY DataLinkEntry;
     ULONG DataLinkMask;
     ULONG DataSize;
-    ULONG IoBufferFlags;
-    BOOL LockHeld;
     PHYSICAL_ADDRESS MaximumPhysicalAddress;
     ULONG MinPacketSize;
     ULONG PacketSizeFlags;
     ULONG Padding;
+    PNET_BUFFER_POOL Pool;
     NET_PACKET_SIZE_INFORMATION SizeInformation;
     KSTATUS Status;
     ULONG TotalSize;
@@ -176,11 +356,13 @@ Return Value:
 
         MaximumPhysicalAddress = Link->Properties.MaxPhysicalAddress;
         MinPacketSize = Link->Properties.PacketSizeInformation.MinPacketSize;
+        Pool = Link->BufferPool;
 
     } else {
         Alignment = 1;
         MaximumPhysicalAddress = MAX_UINTN;
         MinPacketSize = 0;
+        Pool = NetPagedBufferPool;
     }
 
     DataSize = HeaderSize + Size + FooterSize;
@@ -199,122 +381,59 @@ Return Value:
     TotalSize = ALIGN_RANGE_UP(TotalSize, Alignment);
 
     //
-    // Loop through the list looking for the first buffer that fits.
+    // Use the smallest size class that fits. Oversized requests bypass the
+    // pool entirely.
     //
 
-    KeAcquireQueuedLock(NetBufferListLock);
-    LockHeld = TRUE;
-    CurrentEntry = NetFreeBufferList.Next;
-    while (CurrentEntry != &NetFreeBufferList) {
-        Buffer = LIST_VALUE(CurrentEntry, NET_PACKET_BUFFER, ListEntry);
-        CurrentEntry = CurrentEntry->Next;
-        BufferSize = Buffer->IoBuffer->Fragment[0].Size;
-        if (BufferSize < TotalSize) {
-            continue;
-        }
-
-        BufferPhysical = Buffer->IoBuffer->Fragment[0].PhysicalAddress;
-        if (Link == NULL) {
-            if (BufferPhysical != INVALID_PHYSICAL_ADDRESS) {
-                continue;
-            }
-
-        } else {
-            if ((BufferPhysical == INVALID_PHYSICAL_ADDRESS) ||
-                ((BufferPhysical + BufferSize) > MaximumPhysicalAddress) ||
-                (ALIGN_RANGE_DOWN(BufferPhysical, Alignment) !=
-                 BufferPhysical)) {
+    Class = NULL;
+    if (Pool != NULL) {
+        for (ClassIndex = 0;
+             ClassIndex < NET_BUFFER_CLASS_COUNT;
+             ClassIndex += 1) {
 
-                continue;
+            if (Pool->Classes[ClassIndex].Size >= TotalSize) {
+                Class = &(Pool->Classes[ClassIndex]);
+                break;
             }
         }
-
-        LIST_REMOVE(&(Buffer->ListEntry));
-        Status = STATUS_SUCCESS;
-        goto AllocateBufferEnd;
     }
 
-    KeReleaseQueuedLock(NetBufferListLock);
-    LockHeld = FALSE;
-
-    //
-    // Allocate a network packet buffer, but do not bother to zero it. This
-    // routine takes care to initialize all the necessary fields before it is
-    // used.
-    //
+    if (Class != NULL) {
+        Buffer = NetpAllocatePooledBuffer(Class);
 
-    Buffer = MmAllocatePagedPool(sizeof(NET_PACKET_BUFFER),
-                                 NET_CORE_ALLOCATION_TAG);
+    } else {
+        Buffer = NetpCreateBuffer(Link != NULL,
+                                  MaximumPhysicalAddress,
+                                  Alignment,
+                                  TotalSize);
+    }
 
     if (Buffer == NULL) {
         Status = STATUS_INSUFFICIENT_RESOURCES;
         goto AllocateBufferEnd;
     }
 
-    //
-    // A buffer will need to be allocated.
-    //
-
-    if (Link != NULL) {
-        IoBufferFlags = IO_BUFFER_FLAG_PHYSICALLY_CONTIGUOUS;
-        Buffer->IoBuffer = MmAllocateNonPagedIoBuffer(0,
-                                                      MaximumPhysicalAddress,
-                                                      Alignment,
-                                                      TotalSize,
-                                                      IoBufferFlags);
-
-    } else {
-        Buffer->IoBuffer = MmAllocatePagedIoBuffer(TotalSize, 0);
+    Buffer->Flags = 0;
+    if ((Flags & NET_ALLOCATE_BUFFER_FLAG_UNENCRYPTED) != 0) {
+        Buffer->Flags |= NET_PACKET_FLAG_UNENCRYPTED;
     }
 
-    if (Buffer->IoBuffer == NULL) {
-        Status = STATUS_INSUFFICIENT_RESOURCES;
-        goto AllocateBufferEnd;
-    }
+    Buffer->BufferSize = TotalSize;
+    Buffer->DataSize = DataSize;
+    Buffer->DataOffset = HeaderSize;
+    Buffer->FooterOffset = Buffer->DataOffset + Size;
 
-    ASSERT(Buffer->IoBuffer->FragmentCount == 1);
+    //
+    // If padding was added to the packet, then zero it.
+    //
 
-    Buffer->BufferPhysicalAddress =
-                                 Buffer->IoBuffer->Fragment[0].PhysicalAddress;
+    if (Padding != 0) {
+        RtlZeroMemory(Buffer->Buffer + DataSize, Padding);
+    }
 
-    Buffer->Buffer = Buffer->IoBuffer->Fragment[0].VirtualAddress;
     Status = STATUS_SUCCESS;
 
 AllocateBufferEnd:
-    if (LockHeld != FALSE) {
-        KeReleaseQueuedLock(NetBufferListLock);
-    }
-
-    if (!KSUCCESS(Status)) {
-        if (Buffer != NULL) {
-            if (Buffer->IoBuffer != NULL) {
-                MmFreeIoBuffer(Buffer->IoBuffer);
-            }
-
-            MmFreePagedPool(Buffer);
-            Buffer = NULL;
-        }
-
-    } else {
-        Buffer->Flags = 0;
-        if ((Flags & NET_ALLOCATE_BUFFER_FLAG_UNENCRYPTED) != 0) {
-            Buffer->Flags |= NET_PACKET_FLAG_UNENCRYPTED;
-        }
-
-        Buffer->BufferSize = TotalSize;
-        Buffer->DataSize = DataSize;
-        Buffer->DataOffset = HeaderSize;
-        Buffer->FooterOffset = Buffer->DataOffset + Size;
-
-        //
-        // If padding was added to the packet, then zero it.
-        //
-
-        if (Padding != 0) {
-            RtlZeroMemory(Buffer->Buffer + DataSize, Padding);
-        }
-    }
-
     *NewBuffer = Buffer;
     return Status;
 }
@@ -344,9 +463,15 @@ Return Value:
 
 {
 
-    KeAcquireQueuedLock(NetBufferListLock);
-    INSERT_AFTER(&(Buffer->ListEntry), &NetFreeBufferList);
-    KeReleaseQueuedLock(NetBufferListLock);
+    PNET_BUFFER_CLASS Class;
+
+    Class = Buffer->SizeClass;
+    if (Class == NULL) {
+        NetpDestroyBuffer(Buffer);
+        return;
+    }
+
+    NetpReleasePooledBuffers(Class, &Buffer, 1);
     return;
 }
 
@@ -389,6 +514,110 @@ Return Value:
     return;
 }
 
+NET_API
+KSTATUS
+NetGetBufferStatistics (
+    PNET_BUFFER_STATISTICS Statistics,
+    PULONG Count
+    )
+
+/*++
+
+Routine Description:
+
+    This routine collects the statistics for every size class of every
+    network packet buffer pool.
+
+Arguments:
+
+    Statistics - Supplies an optional pointer to an array of statistics
+        structures to fill in.
+
+    Count - Supplies a pointer that on input contains the number of elements
+        in the statistics array. On output, contains the number of size classes
+        in the system.
+
+Return Value:
+
+    STATUS_SUCCESS if all size classes were returned.
+
+    STATUS_BUFFER_TOO_SMALL if the array was too small to hold them all. The
+    elements that fit are still filled in.
+
+--*/
+
+{
+
+    PNET_BUFFER_CACHE Cache;
+    PNET_BUFFER_CLASS Class;
+    ULONG ClassIndex;
+    PLIST_ENTRY CurrentEntry;
+    PNET_BUFFER_STATISTICS Entry;
+    ULONG Index;
+    PNET_BUFFER_POOL Pool;
+    ULONG Processor;
+    KSTATUS Status;
+
+    ASSERT(KeGetRunLevel() == RunLevelLow);
+
+    Index = 0;
+    KeAcquireQueuedLock(NetBufferPoolListLock);
+    CurrentEntry = NetBufferPoolList.Next;
+    while (CurrentEntry != &NetBufferPoolList) {
+        Pool = LIST_VALUE(CurrentEntry, NET_BUFFER_POOL, ListEntry);
+        CurrentEntry = CurrentEntry->Next;
+        for (ClassIndex = 0;
+             ClassIndex < NET_BUFFER_CLASS_COUNT;
+             ClassIndex += 1) {
+
+            if ((Statistics == NULL) || (Index >= *Count)) {
+                Index += 1;
+                continue;
+            }
+
+            Class = &(Pool->Classes[ClassIndex]);
+            Entry = &(Statistics[Index]);
+            RtlZeroMemory(Entry, sizeof(NET_BUFFER_STATISTICS));
+            Entry->PoolId = Pool->Id;
+            Entry->Alignment = Pool->Alignment;
+            Entry->MaxPhysicalAddress = Pool->MaxPhysicalAddress;
+            Entry->Size = Class->Size;
+
+            //
+            // The processor caches are read without synchronization, so the
+            // numbers from them are only a snapshot.
+            //
+
+            for (Processor = 0;
+                 Processor < Pool->ProcessorCount;
+                 Processor += 1) {
+
+                Cache = &(Class->Caches[Processor]);
+                Entry->Allocations += Cache->Allocations;
+                Entry->CacheHits += Cache->Hits;
+                Entry->CachedCount += Cache->Count;
+            }
+
+            KeAcquireQueuedLock(Pool->Lock);
+            Entry->DepotRefills = Class->DepotRefills;
+            Entry->DepotDrains = Class->DepotDrains;
+            Entry->NewBuffers = Class->NewBuffers;
+            Entry->DepotCount = Class->DepotCount;
+            KeReleaseQueuedLock(Pool->Lock);
+            Index += 1;
+        }
+    }
+
+    KeReleaseQueuedLock(NetBufferPoolListLock);
+    Status = STATUS_SUCCESS;
+    if (Index > *Count) {
+        Status = STATUS_BUFFER_TOO_SMALL;
+    }
+
+    *Count = Index;
+    return Status;
+}
+
 KSTATUS
 NetpInitializeBuffers (
     VOID
@@ -412,12 +641,23 @@ Return Value:
 
 {
 
-    INITIALIZE_LIST_HEAD(&NetFreeBufferList);
-    NetBufferListLock = KeCreateQueuedLock();
-    if (NetBufferListLock == NULL) {
+    INITIALIZE_LIST_HEAD(&NetBufferPoolList);
+    NetBufferPoolListLock = KeCreateQueuedLock();
+    if (NetBufferPoolListLock == NULL) {
         return STATUS_INSUFFICIENT_RESOURCES;
     }
 
+    //
+    // Create the pool for buffers allocated without a link. These are paged
+    // and have no physical constraints.
+    //
+
+    NetPagedBufferPool = NetpCreateBufferPool(FALSE, MAX_UINTN, 1);
+    if (NetPagedBufferPool == NULL) {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    INSERT_BEFORE(&(NetPagedBufferPool->ListEntry), &NetBufferPoolList);
     return STATUS_SUCCESS;
 }
 
@@ -445,14 +685,610 @@ Return Value:
 
 {
 
-    if (NetBufferListLock != NULL) {
-        KeDestroyQueuedLock(NetBufferListLock);
+    PNET_BUFFER_POOL Pool;
+
+    if (NetBufferPoolListLock != NULL) {
+        while (LIST_EMPTY(&NetBufferPoolList) == FALSE) {
+            Pool = LIST_VALUE(NetBufferPoolList.Next,
+                              NET_BUFFER_POOL,
+                              ListEntry);
+
+            LIST_REMOVE(&(Pool->ListEntry));
+            NetpDestroyBufferPool(Pool);
+        }
+
+        NetPagedBufferPool = NULL;
+        KeDestroyQueuedLock(NetBufferPoolListLock);
     }
 
     return;
 }
 
+KSTATUS
+NetpGetBufferPool (
+    PHYSICAL_ADDRESS MaxPhysicalAddress,
+    ULONG Alignment,
+    PNET_BUFFER_POOL *Pool
+    )
+
+/*++
+
+Routine Description:
+
+    This routine finds or creates the packet buffer pool for a link with the
+    given DMA constraints. Pools are shared by all links with the same
+    constraints and live until the networking core is torn down.
+
+Arguments:
+
+    MaxPhysicalAddress - Supplies the maximum physical address the link's
+        hardware can reach.
+
+    Alignment - Supplies the required alignment of the link's buffers.
+
+    Pool - Supplies a pointer where a pointer to the pool will be returned.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    PLIST_ENTRY CurrentEntry;
+    PNET_BUFFER_POOL CurrentPool;
+    PNET_BUFFER_POOL FoundPool;
+    KSTATUS Status;
+
+    ASSERT(KeGetRunLevel() == RunLevelLow);
+
+    FoundPool = NULL;
+    KeAcquireQueuedLock(NetBufferPoolListLock);
+    CurrentEntry = NetBufferPoolList.Next;
+    while (CurrentEntry != &NetBufferPoolList) {
+        CurrentPool = LIST_VALUE(CurrentEntry, NET_BUFFER_POOL, ListEntry);
+        CurrentEntry = CurrentEntry->Next;
+        if ((CurrentPool->Physical != FALSE) &&
+            (CurrentPool->MaxPhysicalAddress == MaxPhysicalAddress) &&
+            (CurrentPool->Alignment == Alignment)) {
+
+            FoundPool = CurrentPool;
+            break;
+        }
+    }
+
+    if (FoundPool == NULL) {
+        FoundPool = NetpCreateBufferPool(TRUE, MaxPhysicalAddress, Alignment);
+        if (FoundPool == NULL) {
+            Status = STATUS_INSUFFICIENT_RESOURCES;
+            goto GetBufferPoolEnd;
+        }
+
+        INSERT_BEFORE(&(FoundPool->ListEntry), &NetBufferPoolList);
+    }
+
+    Status = STATUS_SUCCESS;
+
+GetBufferPoolEnd:
+    KeReleaseQueuedLock(NetBufferPoolListLock);
+    *Pool = FoundPool;
+    return Status;
+}
+
 //
 // --------------------------------------------------------- Internal Functions
 //
 
+PNET_BUFFER_POOL
+NetpCreateBufferPool (
+    BOOL Physical,
+    PHYSICAL_ADDRESS MaxPhysicalAddress,
+    ULONG Alignment
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates a packet buffer pool. The caller must either hold the
+    pool list lock or be initializing the buffer support.
+
+Arguments:
+
+    Physical - Supplies a boolean indicating if the pool's buffers must be
+        physically contiguous and non-paged (TRUE) or may be paged (FALSE).
+
+    MaxPhysicalAddress - Supplies the maximum physical address of the pool's
+        buffers.
+
+    Alignment - Supplies the alignment of the pool's buffers.
+
+Return Value:
+
+    Returns a pointer to the new pool on success.
+
+    NULL on allocation failure.
+
+--*/
+
+{
+
+    UINTN AllocationSize;
+    PNET_BUFFER_CACHE Caches;
+    PNET_BUFFER_CLASS Class;
+    ULONG ClassIndex;
+    PNET_BUFFER_POOL Pool;
+    ULONG ProcessorCount;
+
+    //
+    // The pool and its caches are touched at dispatch level, so they must be
+    // non-paged.
+    //
+
+    ProcessorCount = KeGetActiveProcessorCount();
+    AllocationSize = sizeof(NET_BUFFER_POOL) +
+                     (ProcessorCount * NET_BUFFER_CLASS_COUNT *
+                      sizeof(NET_BUFFER_CACHE));
+
+    Pool = MmAllocateNonPagedPool(AllocationSize, NET_CORE_ALLOCATION_TAG);
+    if (Pool == NULL) {
+        return NULL;
+    }
+
+    RtlZeroMemory(Pool, AllocationSize);
+    Pool->Lock = KeCreateQueuedLock();
+    if (Pool->Lock == NULL) {
+        MmFreeNonPagedPool(Pool);
+        return NULL;
+    }
+
+    Pool->Id = NetBufferNextPoolId;
+    NetBufferNextPoolId += 1;
+    Pool->Physical = Physical;
+    Pool->MaxPhysicalAddress = MaxPhysicalAddress;
+    Pool->Alignment = Alignment;
+    Pool->ProcessorCount = ProcessorCount;
+    Caches = (PNET_BUFFER_CACHE)(Pool + 1);
+    for (ClassIndex = 0; ClassIndex < NET_BUFFER_CLASS_COUNT; ClassIndex += 1) {
+        Class = &(Pool->Classes[ClassIndex]);
+        Class->Pool = Pool;
+        Class->Size = NetBufferClassSizes[ClassIndex];
+        Class->Caches = &(Caches[ClassIndex * ProcessorCount]);
+        INITIALIZE_LIST_HEAD(&(Class->DepotList));
+    }
+
+    return Pool;
+}
+
+VOID
+NetpDestroyBufferPool (
+    PNET_BUFFER_POOL Pool
+    )
+
+/*++
+
+Routine Description:
+
+    This routine destroys a packet buffer pool and all the free buffers in it.
+
+Arguments:
+
+    Pool - Supplies a pointer to the pool to destroy.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PNET_PACKET_BUFFER Buffer;
+    PNET_BUFFER_CACHE Cache;
+    PNET_BUFFER_CLASS Class;
+    ULONG ClassIndex;
+    ULONG Processor;
+
+    for (ClassIndex = 0; ClassIndex < NET_BUFFER_CLASS_COUNT; ClassIndex += 1) {
+        Class = &(Pool->Classes[ClassIndex]);
+        for (Processor = 0; Processor < Pool->ProcessorCount; Processor += 1) {
+            Cache = &(Class->Caches[Processor]);
+            while (Cache->Count != 0) {
+                Cache->Count -= 1;
+                NetpDestroyBuffer(Cache->Buffers[Cache->Count]);
+            }
+        }
+
+        while (LIST_EMPTY(&(Class->DepotList)) == FALSE) {
+            Buffer = LIST_VALUE(Class->DepotList.Next,
+                                NET_PACKET_BUFFER,
+                                ListEntry);
+
+            LIST_REMOVE(&(Buffer->ListEntry));
+            NetpDestroyBuffer(Buffer);
+        }
+    }
+
+    KeDestroyQueuedLock(Pool->Lock);
+    MmFreeNonPagedPool(Pool);
+    return;
+}
+
+PNET_PACKET_BUFFER
+NetpAllocatePooledBuffer (
+    PNET_BUFFER_CLASS Class
+    )
+
+/*++
+
+Routine Description:
+
+    This routine allocates a buffer from a size class, trying the current
+    processor's cache, then a batch from the depot, then creating a new
+    buffer.
+
+Arguments:
+
+    Class - Supplies a pointer to the size class to allocate from.
+
+Return Value:
+
+    Returns a pointer to the buffer on success.
+
+    NULL on allocation failure.
+
+--*/
+
+{
+
+    PNET_PACKET_BUFFER Batch[NET_BUFFER_BATCH_SIZE];
+    PNET_PACKET_BUFFER Buffer;
+    PNET_BUFFER_CACHE Cache;
+    ULONG Count;
+    RUNLEVEL OldRunLevel;
+    PNET_BUFFER_POOL Pool;
+    ULONG Processor;
+
+    Buffer = NULL;
+    Pool = Class->Pool;
+
+    //
+    // Raising to dispatch keeps the thread on this processor while its cache
+    // is manipulated. The cache only holds pointers, so nothing paged is
+    // touched.
+    //
+
+    OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+    Processor = KeGetCurrentProcessorNumber();
+    if (Processor < Pool->ProcessorCount) {
+        Cache = &(Class->Caches[Processor]);
+        Cache->Allocations += 1;
+        if (Cache->Count != 0) {
+            Cache->Count -= 1;
+            Buffer = Cache->Buffers[Cache->Count];
+            Cache->Hits += 1;
+        }
+    }
+
+    KeLowerRunLevel(OldRunLevel);
+    if (Buffer != NULL) {
+        return Buffer;
+    }
+
+    //
+    // The cache was empty. Grab a batch from the depot.
+    //
+
+    Count = 0;
+    KeAcquireQueuedLock(Pool->Lock);
+    while ((Count < NET_BUFFER_BATCH_SIZE) &&
+           (LIST_EMPTY(&(Class->DepotList)) == FALSE)) {
+
+        Buffer = LIST_VALUE(Class->DepotList.Next,
+                            NET_PACKET_BUFFER,
+                            ListEntry);
+
+        LIST_REMOVE(&(Buffer->ListEntry));
+        Batch[Count] = Buffer;
+        Count += 1;
+    }
+
+    if (Count != 0) {
+        Class->DepotCount -= Count;
+        Class->DepotRefills += 1;
+    }
+
+    KeReleaseQueuedLock(Pool->Lock);
+
+    //
+    // If the depot was empty too, make a new buffer.
+    //
+
+    if (Count == 0) {
+        Buffer = NetpCreateBuffer(Pool->Physical,
+                                  Pool->MaxPhysicalAddress,
+                                  Pool->Alignment,
+                                  Class->Size);
+
+        if (Buffer != NULL) {
+            Buffer->SizeClass = Class;
+            RtlAtomicAdd64(&(Class->NewBuffers), 1);
+        }
+
+        return Buffer;
+    }
+
+    //
+    // Keep one buffer and stash the rest of the batch in the cache.
+    //
+
+    Count -= 1;
+    Buffer = Batch[Count];
+    if (Count != 0) {
+        NetpReleasePooledBuffers(Class, Batch, Count);
+    }
+
+    return Buffer;
+}
+
+VOID
+NetpReleasePooledBuffers (
+    PNET_BUFFER_CLASS Class,
+    PNET_PACKET_BUFFER *Buffers,
+    ULONG Count
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns free buffers to a size class. They go into the
+    current processor's cache when there is room. A full cache moves a batch
+    of its buffers to the depot to make room. If the system is low on memory,
+    the pool's depots are emptied back to the system.
+
+Arguments:
+
+    Class - Supplies a pointer to the size class the buffers belong to.
+
+    Buffers - Supplies an array of buffers to release.
+
+    Count - Supplies the number of buffers in the array. This must be less
+        than the batch size.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PNET_BUFFER_CACHE Cache;
+    PNET_PACKET_BUFFER Drain[NET_BUFFER_BATCH_SIZE];
+    ULONG DrainCount;
+    ULONG Index;
+    RUNLEVEL OldRunLevel;
+    PNET_BUFFER_POOL Pool;
+    ULONG Processor;
+
+    ASSERT(Count < NET_BUFFER_BATCH_SIZE);
+
+    DrainCount = 0;
+    Pool = Class->Pool;
+    OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+    Processor = KeGetCurrentProcessorNumber();
+    if (Processor < Pool->ProcessorCount) {
+        Cache = &(Class->Caches[Processor]);
+        if ((Cache->Count + Count) > NET_BUFFER_CACHE_SIZE) {
+            DrainCount = NET_BUFFER_BATCH_SIZE;
+            Cache->Count -= DrainCount;
+            RtlCopyMemory(Drain,
+                          &(Cache->Buffers[Cache->Count]),
+                          DrainCount * sizeof(PNET_PACKET_BUFFER));
+        }
+
+        while (Count != 0) {
+            Count -= 1;
+            Cache->Buffers[Cache->Count] = Buffers[Count];
+            Cache->Count += 1;
+        }
+    }
+
+    KeLowerRunLevel(OldRunLevel);
+    if ((Count == 0) && (DrainCount == 0)) {
+        return;
+    }
+
+    //
+    // Put the drained batch, and anything that could not be cached, at the
+    // head of the depot so the most recently used buffers go out first.
+    //
+
+    KeAcquireQueuedLock(Pool->Lock);
+    for (Index = 0; Index < DrainCount; Index += 1) {
+        INSERT_AFTER(&(Drain[Index]->ListEntry), &(Class->DepotList));
+    }
+
+    for (Index = 0; Index < Count; Index += 1) {
+        INSERT_AFTER(&(Buffers[Index]->ListEntry), &(Class->DepotList));
+    }
+
+    Class->DepotCount += DrainCount + Count;
+    if (DrainCount != 0) {
+        Class->DepotDrains += 1;
+    }
+
+    KeReleaseQueuedLock(Pool->Lock);
+    if (MmGetPhysicalMemoryWarningLevel() != MemoryWarningLevelNone) {
+        NetpTrimBufferPool(Pool);
+    }
+
+    return;
+}
+
+VOID
+NetpTrimBufferPool (
+    PNET_BUFFER_POOL Pool
+    )
+
+/*++
+
+Routine Description:
+
+    This routine releases all the free buffers sitting in a pool's depots back
+    to the system. The per-processor caches are left alone, as they are small
+    and are only reachable from their own processors.
+
+Arguments:
+
+    Pool - Supplies a pointer to the pool to trim.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PNET_PACKET_BUFFER Buffer;
+    PNET_BUFFER_CLASS Class;
+    ULONG ClassIndex;
+    LIST_ENTRY FreeList;
+
+    INITIALIZE_LIST_HEAD(&FreeList);
+    KeAcquireQueuedLock(Pool->Lock);
+    for (ClassIndex = 0; ClassIndex < NET_BUFFER_CLASS_COUNT; ClassIndex += 1) {
+        Class = &(Pool->Classes[ClassIndex]);
+        if (LIST_EMPTY(&(Class->DepotList)) == FALSE) {
+            APPEND_LIST(&(Class->DepotList), &FreeList);
+            INITIALIZE_LIST_HEAD(&(Class->DepotList));
+            Class->DepotCount = 0;
+        }
+    }
+
+    KeReleaseQueuedLock(Pool->Lock);
+
+    //
+    // Destroy the buffers outside the lock, as freeing them can take a while.
+    //
+
+    while (LIST_EMPTY(&FreeList) == FALSE) {
+        Buffer = LIST_VALUE(FreeList.Next, NET_PACKET_BUFFER, ListEntry);
+        LIST_REMOVE(&(Buffer->ListEntry));
+        NetpDestroyBuffer(Buffer);
+    }
+
+    return;
+}
+
+PNET_PACKET_BUFFER
+NetpCreateBuffer (
+    BOOL Physical,
+    PHYSICAL_ADDRESS MaxPhysicalAddress,
+    ULONG Alignment,
+    ULONG Size
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates a new network packet buffer that does not belong to
+    any size class.
+
+Arguments:
+
+    Physical - Supplies a boolean indicating if the buffer must be physically
+        contiguous and non-paged (TRUE) or may be paged (FALSE).
+
+    MaxPhysicalAddress - Supplies the maximum physical address of the buffer.
+
+    Alignment - Supplies the required alignment of the buffer.
+
+    Size - Supplies the size of the buffer, in bytes.
+
+Return Value:
+
+    Returns a pointer to the new buffer on success.
+
+    NULL on allocation failure.
+
+--*/
+
+{
+
+    PNET_PACKET_BUFFER Buffer;
+    ULONG IoBufferFlags;
+
+    //
+    // Allocate a network packet buffer, but do not bother to zero it. The
+    // allocation routine takes care to initialize all the necessary fields
+    // before it is used.
+    //
+
+    Buffer = MmAllocatePagedPool(sizeof(NET_PACKET_BUFFER),
+                                 NET_CORE_ALLOCATION_TAG);
+
+    if (Buffer == NULL) {
+        return NULL;
+    }
+
+    if (Physical != FALSE) {
+        IoBufferFlags = IO_BUFFER_FLAG_PHYSICALLY_CONTIGUOUS;
+        Buffer->IoBuffer = MmAllocateNonPagedIoBuffer(0,
+                                                      MaxPhysicalAddress,
+                                                      Alignment,
+                                                      Size,
+                                                      IoBufferFlags);
+
+    } else {
+        Buffer->IoBuffer = MmAllocatePagedIoBuffer(Size, 0);
+    }
+
+    if (Buffer->IoBuffer == NULL) {
+        MmFreePagedPool(Buffer);
+        return NULL;
+    }
+
+    ASSERT(Buffer->IoBuffer->FragmentCount == 1);
+
+    Buffer->BufferPhysicalAddress =
+                                 Buffer->IoBuffer->Fragment[0].PhysicalAddress;
+
+    Buffer->Buffer = Buffer->IoBuffer->Fragment[0].VirtualAddress;
+    Buffer->SizeClass = NULL;
+    return Buffer;
+}
+
+VOID
+NetpDestroyBuffer (
+    PNET_PACKET_BUFFER Buffer
+    )
+
+/*++
+
+Routine Description:
+
+    This routine releases a network packet buffer and its backing memory back
+    to the system.
+
+Arguments:
+
+    Buffer - Supplies a pointer to the buffer to destroy.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    MmFreeIoBuffer(Buffer->IoBuffer);
+    MmFreePagedPool(Buffer);
+    return;
+}
+
@@ -38,8 +38,10 @@ function build() {
         "ip4.c",
         "netcore.c",
         "netlink/netlink.c",
+        "netlink/genbuf.c",
         "netlink/genctrl.c",
         "netlink/generic.c",
+        "poll.c",
         "raw.c",
         "tcp.c",
         "tcpcong.c",
@@ -1206,6 +1206,61 @@ Return Value:
     return;
 }
 
+NET_API
+VOID
+NetProcessReceivedPackets (
+    PNET_LINK Link,
+    PNET_PACKET_LIST PacketList
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is called by the low level NIC driver to pass a batch of
+    received packets onto the core networking library for dispatching. This is
+    generally called from a poll routine.
+
+Arguments:
+
+    Link - Supplies a pointer to the link that received the packets.
+
+    PacketList - Supplies a pointer to the list of received packets. Each
+        packet is removed from the list before it is dispatched, and the list
+        is empty when this routine returns. The packets themselves still
+        belong to the caller.
+
+Return Value:
+
+    None. When the function returns, the memory associated with the packets
+    may be reclaimed and reused.
+
+--*/
+
+{
+
+    PNET_DATA_LINK_ENTRY DataLinkEntry;
+    PNET_PACKET_BUFFER Packet;
+
+    //
+    // Look up the data link layer once for the whole batch. The packet's list
+    // entry is free for the stack to use once it is off the list.
+    //
+
+    DataLinkEntry = Link->DataLinkEntry;
+    while (NET_PACKET_LIST_EMPTY(PacketList) == FALSE) {
+        Packet = LIST_VALUE(PacketList->Head.Next,
+                            NET_PACKET_BUFFER,
+                            ListEntry);
+
+        NET_REMOVE_PACKET_FROM_LIST(Packet, PacketList);
+        DataLinkEntry->Interface.ProcessReceivedPacket(Link->DataLinkContext,
+                                                       Packet);
+    }
+
+    return;
+}
+
 NET_API
 BOOL
 NetGetGlobalDebugFlag (
@@ -151,6 +151,36 @@ Return Value:
 
 --*/
 
+KSTATUS
+NetpGetBufferPool (
+    PHYSICAL_ADDRESS MaxPhysicalAddress,
+    ULONG Alignment,
+    PNET_BUFFER_POOL *Pool
+    );
+
+/*++
+
+Routine Description:
+
+    This routine finds or creates the packet buffer pool for a link with the
+    given DMA constraints. Pools are shared by all links with the same
+    constraints and live until the networking core is torn down.
+
+Arguments:
+
+    MaxPhysicalAddress - Supplies the maximum physical address the link's
+        hardware can reach.
+
+    Alignment - Supplies the required alignment of the link's buffers.
+
+    Pool - Supplies a pointer where a pointer to the pool will be returned.
+
+Return Value:
+
+    Status code.
+
+--*/
+
 COMPARISON_RESULT
 NetpCompareNetworkAddresses (
     PNETWORK_ADDRESS FirstAddress,
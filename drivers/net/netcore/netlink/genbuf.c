@@ -0,0 +1,425 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    genbuf.c
+
+Abstract:
+
+    This module implements the generic netlink network buffer family, which
+    reports the statistics of the packet buffer pools.
+
+Author:
+
+    agent 16-Oct-2026
+
+Environment:
+
+    Kernel
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+//
+// Like the control family, avoid including netcore.h so this family only uses
+// the exported networking interface.
+//
+
+#define NET_API __DLLEXPORT
+
+#include <minoca/kernel/driver.h>
+#include <minoca/net/netdrv.h>
+#include <minoca/net/netlink.h>
+#include "generic.h"
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+//
+// Define the size of the attributes nested in each class attribute.
+//
+
+#define NETLINK_BUFFER_CLASS_LENGTH                    \
+    ((NETLINK_ATTRIBUTE_SIZE(sizeof(ULONG)) * 5) +     \
+     (NETLINK_ATTRIBUTE_SIZE(sizeof(ULONGLONG)) * 6))
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+KSTATUS
+NetlinkpGenericBufferGetStatistics (
+    PNET_SOCKET Socket,
+    PNET_PACKET_BUFFER Packet,
+    PNETLINK_GENERIC_COMMAND_INFORMATION Command
+    );
+
+KSTATUS
+NetlinkpGenericBufferAppendClass (
+    PNET_PACKET_BUFFER Packet,
+    PNET_BUFFER_STATISTICS Statistics
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+NETLINK_GENERIC_COMMAND NetlinkGenericBufferCommands[] = {
+    {
+        NETLINK_BUFFER_COMMAND_GET_STATISTICS,
+        0,
+        NetlinkpGenericBufferGetStatistics
+    },
+};
+
+NETLINK_GENERIC_FAMILY_PROPERTIES NetlinkGenericBufferFamilyProperties = {
+    NETLINK_GENERIC_FAMILY_PROPERTIES_VERSION,
+    0,
+    sizeof(NETLINK_GENERIC_BUFFER_NAME),
+    NETLINK_GENERIC_BUFFER_NAME,
+    NetlinkGenericBufferCommands,
+    sizeof(NetlinkGenericBufferCommands) /
+        sizeof(NetlinkGenericBufferCommands[0]),
+
+    NULL,
+    0
+};
+
+PNETLINK_GENERIC_FAMILY NetlinkGenericBufferFamily = NULL;
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+VOID
+NetlinkpGenericBufferInitialize (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine initializes the built in generic netlink network buffer
+    family, which reports packet buffer pool statistics.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    KSTATUS Status;
+
+    Status = NetlinkGenericRegisterFamily(
+                                        &NetlinkGenericBufferFamilyProperties,
+                                        &NetlinkGenericBufferFamily);
+
+    if (!KSUCCESS(Status)) {
+
+        ASSERT(KSUCCESS(Status));
+
+    }
+
+    return;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+KSTATUS
+NetlinkpGenericBufferGetStatistics (
+    PNET_SOCKET Socket,
+    PNET_PACKET_BUFFER Packet,
+    PNETLINK_GENERIC_COMMAND_INFORMATION Command
+    )
+
+/*++
+
+Routine Description:
+
+    This routine replies to a request for the packet buffer pool statistics
+    with one nested class attribute per size class.
+
+Arguments:
+
+    Socket - Supplies a pointer to the network socket that received the packet.
+
+    Packet - Supplies a pointer to a structure describing the incoming packet.
+        This structure may be used as a scratch space while this routine
+        executes and the packet travels up the stack, but will not be accessed
+        after this routine returns.
+
+    Command - Supplies a pointer to the command information.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    ULONG AllocatedCount;
+    ULONG Count;
+    ULONG HeaderLength;
+    ULONG Index;
+    UINTN PayloadLength;
+    PNET_PACKET_BUFFER Reply;
+    PNET_BUFFER_STATISTICS Statistics;
+    KSTATUS Status;
+
+    Reply = NULL;
+    Statistics = NULL;
+    Count = 0;
+    NetGetBufferStatistics(NULL, &Count);
+    if (Count != 0) {
+        Statistics = MmAllocatePagedPool(Count * sizeof(NET_BUFFER_STATISTICS),
+                                         NETLINK_GENERIC_ALLOCATION_TAG);
+
+        if (Statistics == NULL) {
+            Status = STATUS_INSUFFICIENT_RESOURCES;
+            goto GetStatisticsEnd;
+        }
+
+        //
+        // A pool may have been created in the meantime. Just report the ones
+        // that fit.
+        //
+
+        AllocatedCount = Count;
+        NetGetBufferStatistics(Statistics, &Count);
+        if (Count > AllocatedCount) {
+            Count = AllocatedCount;
+        }
+    }
+
+    PayloadLength = (NETLINK_ATTRIBUTE_SIZE(0) + NETLINK_BUFFER_CLASS_LENGTH) *
+                    Count;
+
+    HeaderLength = NETLINK_HEADER_LENGTH + NETLINK_GENERIC_HEADER_LENGTH;
+    Status = NetAllocateBuffer(0,
+                               HeaderLength + PayloadLength,
+                               0,
+                               NULL,
+                               0,
+                               &Reply);
+
+    if (!KSUCCESS(Status)) {
+        goto GetStatisticsEnd;
+    }
+
+    Status = NetlinkGenericAppendHeaders(NetlinkGenericBufferFamily,
+                                         Reply,
+                                         PayloadLength,
+                                         Command->Message.SequenceNumber,
+                                         0,
+                                         NETLINK_BUFFER_COMMAND_STATISTICS,
+                                         0);
+
+    if (!KSUCCESS(Status)) {
+        goto GetStatisticsEnd;
+    }
+
+    for (Index = 0; Index < Count; Index += 1) {
+        Status = NetlinkpGenericBufferAppendClass(Reply, &(Statistics[Index]));
+        if (!KSUCCESS(Status)) {
+            goto GetStatisticsEnd;
+        }
+    }
+
+    Status = NetlinkGenericSendCommand(NetlinkGenericBufferFamily,
+                                       Reply,
+                                       Command->Message.SourceAddress);
+
+    if (!KSUCCESS(Status)) {
+        goto GetStatisticsEnd;
+    }
+
+GetStatisticsEnd:
+    if (Reply != NULL) {
+        NetFreeBuffer(Reply);
+    }
+
+    if (Statistics != NULL) {
+        MmFreePagedPool(Statistics);
+    }
+
+    return Status;
+}
+
+KSTATUS
+NetlinkpGenericBufferAppendClass (
+    PNET_PACKET_BUFFER Packet,
+    PNET_BUFFER_STATISTICS Statistics
+    )
+
+/*++
+
+Routine Description:
+
+    This routine appends a nested class attribute describing one buffer pool
+    size class to the given packet.
+
+Arguments:
+
+    Packet - Supplies a pointer to the packet to append to.
+
+    Statistics - Supplies a pointer to the statistics of the size class.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    USHORT Attribute;
+    KSTATUS Status;
+
+    Status = NetlinkAppendAttribute(Packet,
+                                    NETLINK_BUFFER_ATTRIBUTE_CLASS,
+                                    NULL,
+                                    NETLINK_BUFFER_CLASS_LENGTH);
+
+    if (!KSUCCESS(Status)) {
+        goto AppendClassEnd;
+    }
+
+    Attribute = NETLINK_BUFFER_CLASS_ATTRIBUTE_POOL_ID;
+    Status = NetlinkAppendAttribute(Packet,
+                                    Attribute,
+                                    &(Statistics->PoolId),
+                                    sizeof(ULONG));
+
+    if (!KSUCCESS(Status)) {
+        goto AppendClassEnd;
+    }
+
+    Attribute = NETLINK_BUFFER_CLASS_ATTRIBUTE_ALIGNMENT;
+    Status = NetlinkAppendAttribute(Packet,
+                                    Attribute,
+                                    &(Statistics->Alignment),
+                                    sizeof(ULONG));
+
+    if (!KSUCCESS(Status)) {
+        goto AppendClassEnd;
+    }
+
+    Attribute = NETLINK_BUFFER_CLASS_ATTRIBUTE_MAX_PHYSICAL_ADDRESS;
+    Status = NetlinkAppendAttribute(Packet,
+                                    Attribute,
+                                    &(Statistics->MaxPhysicalAddress),
+                                    sizeof(ULONGLONG));
+
+    if (!KSUCCESS(Status)) {
+        goto AppendClassEnd;
+    }
+
+    Attribute = NETLINK_BUFFER_CLASS_ATTRIBUTE_SIZE;
+    Status = NetlinkAppendAttribute(Packet,
+                                    Attribute,
+                                    &(Statistics->Size),
+                                    sizeof(ULONG));
+
+    if (!KSUCCESS(Status)) {
+        goto AppendClassEnd;
+    }
+
+    Attribute = NETLINK_BUFFER_CLASS_ATTRIBUTE_ALLOCATIONS;
+    Status = NetlinkAppendAttribute(Packet,
+                                    Attribute,
+                                    &(Statistics->Allocations),
+                                    sizeof(ULONGLONG));
+
+    if (!KSUCCESS(Status)) {
+        goto AppendClassEnd;
+    }
+
+    Attribute = NETLINK_BUFFER_CLASS_ATTRIBUTE_CACHE_HITS;
+    Status = NetlinkAppendAttribute(Packet,
+                                    Attribute,
+                                    &(Statistics->CacheHits),
+                                    sizeof(ULONGLONG));
+
+    if (!KSUCCESS(Status)) {
+        goto AppendClassEnd;
+    }
+
+    Attribute = NETLINK_BUFFER_CLASS_ATTRIBUTE_DEPOT_REFILLS;
+    Status = NetlinkAppendAttribute(Packet,
+                                    Attribute,
+                                    &(Statistics->DepotRefills),
+                                    sizeof(ULONGLONG));
+
+    if (!KSUCCESS(Status)) {
+        goto AppendClassEnd;
+    }
+
+    Attribute = NETLINK_BUFFER_CLASS_ATTRIBUTE_DEPOT_DRAINS;
+    Status = NetlinkAppendAttribute(Packet,
+                                    Attribute,
+                                    &(Statistics->DepotDrains),
+                                    sizeof(ULONGLONG));
+
+    if (!KSUCCESS(Status)) {
+        goto AppendClassEnd;
+    }
+
+    Attribute = NETLINK_BUFFER_CLASS_ATTRIBUTE_NEW_BUFFERS;
+    Status = NetlinkAppendAttribute(Packet,
+                                    Attribute,
+                                    &(Statistics->NewBuffers),
+                                    sizeof(ULONGLONG));
+
+    if (!KSUCCESS(Status)) {
+        goto AppendClassEnd;
+    }
+
+    Attribute = NETLINK_BUFFER_CLASS_ATTRIBUTE_CACHED_COUNT;
+    Status = NetlinkAppendAttribute(Packet,
+                                    Attribute,
+                                    &(Statistics->CachedCount),
+                                    sizeof(ULONG));
+
+    if (!KSUCCESS(Status)) {
+        goto AppendClassEnd;
+    }
+
+    Attribute = NETLINK_BUFFER_CLASS_ATTRIBUTE_DEPOT_COUNT;
+    Status = NetlinkAppendAttribute(Packet,
+                                    Attribute,
+                                    &(Statistics->DepotCount),
+                                    sizeof(ULONG));
+
+    if (!KSUCCESS(Status)) {
+        goto AppendClassEnd;
+    }
+
+AppendClassEnd:
+    return Status;
+}
+
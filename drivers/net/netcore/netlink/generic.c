@@ -1021,6 +1021,7 @@ Return Value:
         }
 
         NetlinkpGenericControlInitialize();
+        NetlinkpGenericBufferInitialize();
     }
 
 InitializeEnd:
@@ -99,6 +99,28 @@ Return Value:
 
 --*/
 
+VOID
+NetlinkpGenericBufferInitialize (
+    VOID
+    );
+
+/*++
+
+Routine Description:
+
+    This routine initializes the built in generic netlink network buffer
+    family, which reports packet buffer pool statistics.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    None.
+
+--*/
+
 KSTATUS
 NetlinkpGenericControlSendNotification (
     PNETLINK_GENERIC_FAMILY Family,
@@ -0,0 +1,383 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    poll.c
+
+Abstract:
+
+    This module implements interrupt mitigated receive polling for network
+    device drivers. Instead of handing frames up from an interrupt worker one
+    interrupt at a time, a driver masks its receive interrupts and schedules a
+    poll, which drains the device in bounded batches until it goes idle.
+
+Author:
+
+    agent 16-Oct-2026
+
+Environment:
+
+    Kernel
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <minoca/kernel/driver.h>
+#include "netcore.h"
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+//
+// Define the poll state flags. The scheduled flag is set while a run of the
+// work routine is queued or in progress, and stays set across the work
+// routine re-queueing itself. The stopped flag is set when the poll is being
+// destroyed.
+//
+
+#define NET_POLL_FLAG_SCHEDULED 0x00000001
+#define NET_POLL_FLAG_STOPPED   0x00000002
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+/*++
+
+Structure Description:
+
+    This structure defines a network device receive poll.
+
+Members:
+
+    Flags - Stores the poll state. See NET_POLL_FLAG_* definitions.
+
+    ActiveCount - Stores the number of runs of the work routine currently
+        touching the poll.
+
+    WorkItem - Stores a pointer to the work item that runs the poll routine.
+
+    PollRoutine - Stores a pointer to the driver's poll routine.
+
+    CompleteRoutine - Stores a pointer to the driver's routine to re-enable
+        receive interrupts.
+
+    Context - Stores the context pointer passed to the driver's routines.
+
+    Budget - Stores the maximum number of frames processed per poll call.
+
+--*/
+
+struct _NET_POLL {
+    volatile ULONG Flags;
+    volatile ULONG ActiveCount;
+    PWORK_ITEM WorkItem;
+    PNET_POLL_ROUTINE PollRoutine;
+    PNET_POLL_COMPLETE_ROUTINE CompleteRoutine;
+    PVOID Context;
+    ULONG Budget;
+};
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+VOID
+NetpPollWorkRoutine (
+    PVOID Parameter
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+NET_API
+KSTATUS
+NetCreatePoll (
+    PNET_POLL_ROUTINE PollRoutine,
+    PNET_POLL_COMPLETE_ROUTINE CompleteRoutine,
+    PVOID Context,
+    ULONG Budget,
+    PNET_POLL *NewPoll
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates a receive poll for a network device. A driver using a
+    poll masks its receive interrupts in its interrupt handler and schedules
+    the poll, which drains received frames in batches at low level until the
+    device goes idle.
+
+Arguments:
+
+    PollRoutine - Supplies a pointer to the routine that processes received
+        frames.
+
+    CompleteRoutine - Supplies a pointer to the routine that re-enables
+        receive interrupts once the device is idle.
+
+    Context - Supplies a context pointer passed to both routines.
+
+    Budget - Supplies the maximum number of frames to process per call to the
+        poll routine. Supply 0 to use the default.
+
+    NewPoll - Supplies a pointer where a pointer to the new poll will be
+        returned on success.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    PNET_POLL Poll;
+    KSTATUS Status;
+
+    Poll = MmAllocateNonPagedPool(sizeof(NET_POLL), NET_CORE_ALLOCATION_TAG);
+    if (Poll == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto CreatePollEnd;
+    }
+
+    RtlZeroMemory(Poll, sizeof(NET_POLL));
+    Poll->PollRoutine = PollRoutine;
+    Poll->CompleteRoutine = CompleteRoutine;
+    Poll->Context = Context;
+    Poll->Budget = Budget;
+    if (Poll->Budget == 0) {
+        Poll->Budget = NET_POLL_DEFAULT_BUDGET;
+    }
+
+    Poll->WorkItem = KeCreateWorkItem(NULL,
+                                      WorkPriorityNormal,
+                                      NetpPollWorkRoutine,
+                                      Poll,
+                                      NET_CORE_ALLOCATION_TAG);
+
+    if (Poll->WorkItem == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto CreatePollEnd;
+    }
+
+    Status = STATUS_SUCCESS;
+
+CreatePollEnd:
+    if (!KSUCCESS(Status)) {
+        if (Poll != NULL) {
+            MmFreeNonPagedPool(Poll);
+            Poll = NULL;
+        }
+    }
+
+    *NewPoll = Poll;
+    return Status;
+}
+
+NET_API
+VOID
+NetDestroyPoll (
+    PNET_POLL Poll
+    )
+
+/*++
+
+Routine Description:
+
+    This routine destroys a receive poll. The poll routine is not running and
+    will not be called again once this routine returns. The caller must make
+    sure the poll is no longer scheduled by its interrupt handler.
+
+Arguments:
+
+    Poll - Supplies a pointer to the poll to destroy.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    KSTATUS Status;
+
+    //
+    // Once stopped, the poll cannot be scheduled, and a run of the work
+    // routine neither calls the driver nor re-queues itself. If the work item
+    // can be pulled off the queue, the pending run never happens.
+    //
+
+    RtlAtomicOr32(&(Poll->Flags), NET_POLL_FLAG_STOPPED);
+    Status = KeCancelWorkItem(Poll->WorkItem);
+    if (KSUCCESS(Status)) {
+        RtlAtomicAnd32(&(Poll->Flags), ~NET_POLL_FLAG_SCHEDULED);
+    }
+
+    //
+    // Otherwise wait for the pending run to finish. Flushing the work item is
+    // not enough here: a run that checked the flags just before the poll was
+    // stopped may re-queue the work item, and the flush can return as that
+    // run ends, before the re-queued run starts. The re-queued run sees the
+    // stopped flag and clears the scheduled flag as it leaves.
+    //
+
+    while (((Poll->Flags & NET_POLL_FLAG_SCHEDULED) != 0) ||
+           (Poll->ActiveCount != 0)) {
+
+        KeYield();
+    }
+
+    KeDestroyWorkItem(Poll->WorkItem);
+    MmFreeNonPagedPool(Poll);
+    return;
+}
+
+NET_API
+VOID
+NetSchedulePoll (
+    PNET_POLL Poll
+    )
+
+/*++
+
+Routine Description:
+
+    This routine schedules a receive poll to run. If the poll is already
+    scheduled or running, this routine does nothing. This routine must be
+    called at or below dispatch level.
+
+Arguments:
+
+    Poll - Supplies a pointer to the poll to schedule.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG OldFlags;
+    KSTATUS Status;
+
+    OldFlags = RtlAtomicCompareExchange32(&(Poll->Flags),
+                                          NET_POLL_FLAG_SCHEDULED,
+                                          0);
+
+    if (OldFlags == 0) {
+        Status = KeQueueWorkItem(Poll->WorkItem);
+
+        ASSERT(KSUCCESS(Status));
+    }
+
+    return;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+VOID
+NetpPollWorkRoutine (
+    PVOID Parameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine runs a driver's poll routine.
+
+Arguments:
+
+    Parameter - Supplies a pointer to the poll.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG OldFlags;
+    PNET_POLL Poll;
+    ULONG Processed;
+    KSTATUS Status;
+
+    //
+    // The scheduled flag is still set, so the poll cannot be destroyed before
+    // this run is counted as active. Dropping the active count is the last
+    // thing this routine does with the poll.
+    //
+
+    Poll = Parameter;
+    RtlAtomicAdd32(&(Poll->ActiveCount), 1);
+
+    ASSERT((Poll->Flags & NET_POLL_FLAG_SCHEDULED) != 0);
+
+    if ((Poll->Flags & NET_POLL_FLAG_STOPPED) != 0) {
+        RtlAtomicAnd32(&(Poll->Flags), ~NET_POLL_FLAG_SCHEDULED);
+        goto PollWorkRoutineEnd;
+    }
+
+    Processed = Poll->PollRoutine(Poll->Context, Poll->Budget);
+
+    //
+    // If the whole budget was used there is probably more waiting. Leave
+    // interrupts masked and requeue rather than looping here. The work item
+    // is normal priority, so requeueing puts it behind everything already
+    // waiting in the system work queue, and a flood on one device cannot
+    // starve other work. If the poll was stopped in the meantime, the scheduled flag keeps it
+    // from being destroyed until the re-queued run has seen the stopped flag.
+    //
+
+    if (Processed >= Poll->Budget) {
+        if ((Poll->Flags & NET_POLL_FLAG_STOPPED) == 0) {
+            Status = KeQueueWorkItem(Poll->WorkItem);
+
+            ASSERT(KSUCCESS(Status));
+
+        } else {
+            RtlAtomicAnd32(&(Poll->Flags), ~NET_POLL_FLAG_SCHEDULED);
+        }
+
+        goto PollWorkRoutineEnd;
+    }
+
+    //
+    // The device is idle. Mark the poll idle before unmasking interrupts so
+    // that an interrupt arriving right after the unmask can schedule the poll
+    // again.
+    //
+
+    OldFlags = RtlAtomicAnd32(&(Poll->Flags), ~NET_POLL_FLAG_SCHEDULED);
+    if ((OldFlags & NET_POLL_FLAG_STOPPED) == 0) {
+        Poll->CompleteRoutine(Poll->Context);
+    }
+
+PollWorkRoutineEnd:
+    RtlAtomicAdd32(&(Poll->ActiveCount), -1);
+    return;
+}
+
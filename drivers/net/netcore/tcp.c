@@ -396,6 +396,11 @@ NetpTcpFreeSegment (
     PTCP_SEGMENT_HEADER Segment
     );
 
+VOID
+NetpTcpReleaseSendBuffer (
+    PTCP_SEND_BUFFER Buffer
+    );
+
 //
 // -------------------------------------------------------------------- Globals
 //
@@ -1651,6 +1656,7 @@ Return Value:
     ULONG RequiredOpening;
     ULONG ReturnedEvents;
     ULONG SegmentSize;
+    PTCP_SEND_BUFFER SendBuffer;
     UINTN Size;
     KSTATUS Status;
     PTCP_SOCKET TcpSocket;
@@ -1664,6 +1670,7 @@ Return Value:
     Parameters->SocketIoFlags = 0;
     LockHeld = FALSE;
     NewSegment = NULL;
+    SendBuffer = NULL;
     OutgoingSegmentListWasEmpty = FALSE;
     PushNeeded = TRUE;
     TcpSocket = (PTCP_SOCKET)Socket;
@@ -1701,6 +1708,26 @@ Return Value:
         goto TcpSendEnd;
     }
 
+    //
+    // Kernel mode callers may donate the I/O buffer, in which case the new
+    // segments point into it rather than holding a copy of the data. The
+    // buffer is freed when the last segment using it is acknowledged. If the
+    // wrapper cannot be allocated, just copy the data as usual.
+    //
+
+    if ((FromKernelMode != FALSE) &&
+        ((Flags & SOCKET_IO_DONATE_BUFFER) != 0)) {
+
+        SendBuffer = MmAllocatePagedPool(sizeof(TCP_SEND_BUFFER),
+                                         TCP_ALLOCATION_TAG);
+
+        if (SendBuffer != NULL) {
+            SendBuffer->ReferenceCount = 1;
+            SendBuffer->IoBuffer = IoBuffer;
+            Parameters->SocketIoFlags |= SOCKET_IO_BUFFER_RETAINED;
+        }
+    }
+
     //
     // Set a timeout timer to give up on. The socket stores the maximum timeout.
     //
@@ -1809,7 +1836,8 @@ Return Value:
 
         //
         // If the last packet has already been sent off or is jam packed, then
-        // forget it, make a new packet.
+        // forget it, make a new packet. Segments that reference a donated
+        // buffer are never merged, as that would mean copying the data.
         //
 
         LastSegment = LIST_VALUE(TcpSocket->OutgoingSegmentList.Previous,
@@ -1818,7 +1846,9 @@ Return Value:
 
         LastSegmentLength = LastSegment->Length - LastSegment->Offset;
         if ((LastSegment->SendAttemptCount != 0) ||
-            (LastSegmentLength == TcpSocket->SendMaxSegmentSize)) {
+            (LastSegmentLength == TcpSocket->SendMaxSegmentSize) ||
+            (LastSegment->Buffer != NULL) ||
+            (SendBuffer != NULL)) {
 
             break;
         }
@@ -1877,6 +1907,8 @@ Return Value:
         NewSegment->SendAttemptCount = 0;
         NewSegment->TimeoutInterval = 0;
         NewSegment->Flags = LastSegment->Flags;
+        NewSegment->Buffer = NULL;
+        NewSegment->BufferOffset = 0;
 
         //
         // If all the new data fit into this existing segment, then add the
@@ -2007,32 +2039,50 @@ Return Value:
         ASSERT(KeIsQueuedLockHeld(TcpSocket->Lock) != FALSE);
 
         //
-        // Create a new segment.
+        // Create a new segment. A segment pointing at the donated buffer
+        // carries no data of its own, so it is allocated at just the size of
+        // the header rather than coming from the socket's maximum sized
+        // segments. Otherwise copy the new data in.
         //
 
         SegmentSize = RequiredOpening;
-        AllocationSize = sizeof(TCP_SEND_SEGMENT) + SegmentSize;
-        NewSegment = (PTCP_SEND_SEGMENT)NetpTcpAllocateSegment(TcpSocket,
+        if (SendBuffer != NULL) {
+            NewSegment = MmAllocatePagedPool(sizeof(TCP_SEND_SEGMENT),
+                                             TCP_ALLOCATION_TAG);
+
+            if (NewSegment == NULL) {
+                Status = STATUS_INSUFFICIENT_RESOURCES;
+                goto TcpSendEnd;
+            }
+
+            RtlAtomicAdd32(&(SendBuffer->ReferenceCount), 1);
+            NewSegment->Buffer = SendBuffer;
+            NewSegment->BufferOffset = BytesComplete;
+
+        } else {
+            AllocationSize = sizeof(TCP_SEND_SEGMENT) + SegmentSize;
+            NewSegment = (PTCP_SEND_SEGMENT)NetpTcpAllocateSegment(
+                                                               TcpSocket,
                                                                AllocationSize);
 
-        if (NewSegment == NULL) {
-            Status = STATUS_INSUFFICIENT_RESOURCES;
-            goto TcpSendEnd;
-        }
+            if (NewSegment == NULL) {
+                Status = STATUS_INSUFFICIENT_RESOURCES;
+                goto TcpSendEnd;
+            }
 
-        //
-        // Copy the new data in.
-        //
+            Status = MmCopyIoBufferData(IoBuffer,
+                                        NewSegment + 1,
+                                        BytesComplete,
+                                        SegmentSize,
+                                        FALSE);
 
-        Status = MmCopyIoBufferData(IoBuffer,
-                                    NewSegment + 1,
-                                    BytesComplete,
-                                    SegmentSize,
-                                    FALSE);
+            if (!KSUCCESS(Status)) {
+                NetpTcpFreeSegment(TcpSocket, (PTCP_SEGMENT_HEADER)NewSegment);
+                goto TcpSendEnd;
+            }
 
-        if (!KSUCCESS(Status)) {
-            NetpTcpFreeSegment(TcpSocket, (PTCP_SEGMENT_HEADER)NewSegment);
-            goto TcpSendEnd;
+            NewSegment->Buffer = NULL;
+            NewSegment->BufferOffset = 0;
         }
 
         NewSegment->SequenceNumber = TcpSocket->SendNextBufferSequence;
@@ -2102,6 +2152,10 @@ Return Value:
         KeReleaseQueuedLock(TcpSocket->Lock);
     }
 
+    if (SendBuffer != NULL) {
+        NetpTcpReleaseSendBuffer(SendBuffer);
+    }
+
     //
     // If any bytes were written, then consider this a success.
     //
@@ -6969,12 +7023,29 @@ Return Value:
     HeaderFlags = Segment->Flags & TCP_SEND_SEGMENT_HEADER_FLAG_MASK;
 
     //
-    // Copy the segment data over and fill out the TCP header.
+    // Copy the segment data over and fill out the TCP header. Data in a
+    // donated buffer is copied straight out of it, which for page cache pages
+    // is the only copy the data ever sees.
     //
 
-    RtlCopyMemory(Packet->Buffer + Packet->DataOffset,
-                  (PUCHAR)(Segment + 1) + Segment->Offset,
-                  SegmentLength);
+    if (Segment->Buffer != NULL) {
+        Status = MmCopyIoBufferData(Segment->Buffer->IoBuffer,
+                                    Packet->Buffer + Packet->DataOffset,
+                                    Segment->BufferOffset + Segment->Offset,
+                                    SegmentLength,
+                                    FALSE);
+
+        if (!KSUCCESS(Status)) {
+            NetFreeBuffer(Packet);
+            Packet = NULL;
+            goto TcpCreatePacketEnd;
+        }
+
+    } else {
+        RtlCopyMemory(Packet->Buffer + Packet->DataOffset,
+                      (PUCHAR)(Segment + 1) + Segment->Offset,
+                      SegmentLength);
+    }
 
     ASSERT(Packet->DataOffset >= sizeof(TCP_HEADER));
 
@@ -7092,7 +7163,19 @@ Return Value:
             }
 
             SignalTransmitReadyEvent = TRUE;
-            NetpTcpFreeSegment(Socket, &(Segment->Header));
+
+            //
+            // Segments on donated buffers are only header sized, so they
+            // cannot go back on the free list for reuse.
+            //
+
+            if (Segment->Buffer != NULL) {
+                NetpTcpReleaseSendBuffer(Segment->Buffer);
+                MmFreePagedPool(Segment);
+
+            } else {
+                NetpTcpFreeSegment(Socket, &(Segment->Header));
+            }
 
         //
         // If the current acknowledge number is in the middle of the segment,
@@ -7192,6 +7275,10 @@ Return Value:
             NetpTcpTimerReleaseReference(Socket);
         }
 
+        if (OutgoingSegment->Buffer != NULL) {
+            NetpTcpReleaseSendBuffer(OutgoingSegment->Buffer);
+        }
+
         MmFreePagedPool(OutgoingSegment);
     }
 
@@ -8892,3 +8979,41 @@ Return Value:
     return;
 }
 
+VOID
+NetpTcpReleaseSendBuffer (
+    PTCP_SEND_BUFFER Buffer
+    )
+
+/*++
+
+Routine Description:
+
+    This routine releases a reference on a donated send buffer, freeing the
+    buffer and the I/O buffer it wraps if this was the last reference.
+
+Arguments:
+
+    Buffer - Supplies a pointer to the send buffer to release.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG OldReferenceCount;
+
+    OldReferenceCount = RtlAtomicAdd32(&(Buffer->ReferenceCount), (ULONG)-1);
+
+    ASSERT((OldReferenceCount != 0) && (OldReferenceCount < 0x10000000));
+
+    if (OldReferenceCount == 1) {
+        MmFreeIoBuffer(Buffer->IoBuffer);
+        MmFreePagedPool(Buffer);
+    }
+
+    return;
+}
+
@@ -724,10 +724,34 @@ typedef struct _TCP_RECEIVED_SEGMENT {
 
 /*++
 
+Structure Description:
+
+    This structure defines an I/O buffer donated to TCP by a kernel mode
+    sender, typically holding page cache pages. Send segments reference it
+    instead of copying its data, and it is freed once every segment that
+    points into it has been acknowledged.
+
+Members:
+
+    ReferenceCount - Stores the number of send segments using the buffer, plus
+        one while the send call that donated it is still running.
+
+    IoBuffer - Stores a pointer to the donated I/O buffer.
+
+--*/
+
+typedef struct _TCP_SEND_BUFFER {
+    volatile ULONG ReferenceCount;
+    PIO_BUFFER IoBuffer;
+} TCP_SEND_BUFFER, *PTCP_SEND_BUFFER;
+
+/*++
+
 Structure Description:
 
     This structure stores information about an outgoing TCP segment. The data
-    comes immediately after this structure.
+    comes immediately after this structure, unless the segment references a
+    donated send buffer.
 
 Members:
 
@@ -754,6 +778,12 @@ Structure Description:
     Flags - Stores a bitmask of flags for the outgoing TCP segment. See
         TCP_SEND_SEGMENT_FLAG_* for definitions.
 
+    Buffer - Stores an optional pointer to the donated send buffer holding
+        this segment's data. If this is NULL, the data follows the segment.
+
+    BufferOffset - Stores the offset into the donated send buffer's I/O buffer
+        where this segment's data begins.
+
 --*/
 
 typedef struct _TCP_SEND_SEGMENT {
@@ -765,6 +795,8 @@ typedef struct _TCP_SEND_SEGMENT {
     ULONG Length;
     ULONG Offset;
     ULONG Flags;
+    PTCP_SEND_BUFFER Buffer;
+    UINTN BufferOffset;
 } TCP_SEND_SEGMENT, *PTCP_SEND_SEGMENT;
 
 /*++
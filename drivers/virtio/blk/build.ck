@@ -0,0 +1,48 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    Virtio Block
+
+Abstract:
+
+    This module implements the virtio block device driver, which
+    exposes paravirtualized disks to the partition manager.
+
+Author:
+
+    agent 16-Oct-2026
+
+Environment:
+
+    Kernel
+
+--*/
+
+function build() {
+    name = "virtblk";
+    sources = [
+        "virtblk.c"
+    ];
+
+    dynlibs = [
+        "//drivers/virtio/core:virtio"
+    ];
+
+    drv = {
+        "label": name,
+        "inputs": sources + dynlibs,
+    };
+
+    entries = driver(drv);
+    return entries;
+}
+
+return build();
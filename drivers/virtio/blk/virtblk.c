@@ -0,0 +1,2017 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    virtblk.c
+
+Abstract:
+
+    This module implements the virtio block device driver. The device is
+    exposed as a single disk, and I/O is spread across the device's request
+    queues by processor.
+
+Author:
+
+    agent 16-Oct-2026
+
+Environment:
+
+    Kernel
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <minoca/kernel/driver.h>
+#include "virtblk.h"
+
+//
+// --------------------------------------------------------------------- Macros
+//
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+KSTATUS
+VirtblkAddDevice (
+    PVOID Driver,
+    PCSTR DeviceId,
+    PCSTR ClassId,
+    PCSTR CompatibleIds,
+    PVOID DeviceToken
+    );
+
+VOID
+VirtblkDispatchStateChange (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    );
+
+VOID
+VirtblkDispatchOpen (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    );
+
+VOID
+VirtblkDispatchClose (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    );
+
+VOID
+VirtblkDispatchIo (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    );
+
+VOID
+VirtblkDispatchSystemControl (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    );
+
+VOID
+VirtblkpDispatchControllerStateChange (
+    PIRP Irp,
+    PVIRTBLK_CONTROLLER Controller
+    );
+
+VOID
+VirtblkpDispatchDiskStateChange (
+    PIRP Irp,
+    PVIRTBLK_DISK Disk
+    );
+
+VOID
+VirtblkpDispatchDiskSystemControl (
+    PIRP Irp,
+    PVIRTBLK_DISK Disk
+    );
+
+KSTATUS
+VirtblkpStartController (
+    PIRP Irp,
+    PVIRTBLK_CONTROLLER Controller
+    );
+
+VOID
+VirtblkpEnumerateDisk (
+    PIRP Irp,
+    PVIRTBLK_CONTROLLER Controller
+    );
+
+KSTATUS
+VirtblkpCreateQueue (
+    PVIRTBLK_CONTROLLER Controller,
+    USHORT Index,
+    PVIRTBLK_QUEUE *NewQueue
+    );
+
+VOID
+VirtblkpDestroyQueue (
+    PVIRTBLK_QUEUE Queue
+    );
+
+INTERRUPT_STATUS
+VirtblkpInterruptService (
+    PVOID Context
+    );
+
+INTERRUPT_STATUS
+VirtblkpInterruptServiceDpc (
+    PVOID Parameter
+    );
+
+INTERRUPT_STATUS
+VirtblkpQueueInterruptService (
+    PVOID Context
+    );
+
+INTERRUPT_STATUS
+VirtblkpQueueInterruptServiceDpc (
+    PVOID Parameter
+    );
+
+KSTATUS
+VirtblkpEnqueueIrp (
+    PVIRTBLK_DISK Disk,
+    PIRP Irp
+    );
+
+VOID
+VirtblkpStartIrp (
+    PVIRTBLK_QUEUE Queue,
+    PIRP Irp
+    );
+
+VOID
+VirtblkpBeginQueuedIrps (
+    PVIRTBLK_QUEUE Queue
+    );
+
+VOID
+VirtblkpSubmitRequest (
+    PVIRTBLK_QUEUE Queue,
+    PVIRTBLK_REQUEST Request,
+    BOOL Flush
+    );
+
+VOID
+VirtblkpCompleteRequest (
+    PVIRTBLK_QUEUE Queue,
+    PVIRTBLK_REQUEST Request,
+    KSTATUS Status
+    );
+
+VOID
+VirtblkpProcessQueue (
+    PVIRTBLK_QUEUE Queue
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+PDRIVER VirtblkDriver = NULL;
+
+DRIVER_FUNCTION_TABLE VirtblkDriverFunctionTable = {
+    DRIVER_FUNCTION_TABLE_VERSION,
+    NULL,
+    VirtblkAddDevice,
+    NULL,
+    NULL,
+    VirtblkDispatchStateChange,
+    VirtblkDispatchOpen,
+    VirtblkDispatchClose,
+    VirtblkDispatchIo,
+    VirtblkDispatchSystemControl,
+    NULL
+};
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+KSTATUS
+DriverEntry (
+    PDRIVER Driver
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is the entry point for the virtio block driver. It registers
+    its other dispatch functions, and performs driver-wide initialization.
+
+Arguments:
+
+    Driver - Supplies a pointer to the driver object.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    Failure code on error.
+
+--*/
+
+{
+
+    KSTATUS Status;
+
+    VirtblkDriver = Driver;
+    Status = IoRegisterDriverFunctions(Driver, &VirtblkDriverFunctionTable);
+    return Status;
+}
+
+KSTATUS
+VirtblkAddDevice (
+    PVOID Driver,
+    PCSTR DeviceId,
+    PCSTR ClassId,
+    PCSTR CompatibleIds,
+    PVOID DeviceToken
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is called when a device is detected for which the virtio
+    block driver acts as the function driver. The driver will attach itself to
+    the stack.
+
+Arguments:
+
+    Driver - Supplies a pointer to the driver being called.
+
+    DeviceId - Supplies a pointer to a string with the device ID.
+
+    ClassId - Supplies a pointer to a string containing the device's class ID.
+
+    CompatibleIds - Supplies a pointer to a string containing device IDs
+        that would be compatible with this device.
+
+    DeviceToken - Supplies an opaque token that the driver can use to identify
+        the device in the system. This token should be used when attaching to
+        the stack.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    Failure code if the driver was unsuccessful in attaching itself.
+
+--*/
+
+{
+
+    PVIRTBLK_CONTROLLER Controller;
+    KSTATUS Status;
+
+    Controller = MmAllocateNonPagedPool(sizeof(VIRTBLK_CONTROLLER),
+                                        VIRTBLK_ALLOCATION_TAG);
+
+    if (Controller == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto AddDeviceEnd;
+    }
+
+    RtlZeroMemory(Controller, sizeof(VIRTBLK_CONTROLLER));
+    Controller->Type = VirtblkContextController;
+    Controller->OsDevice = DeviceToken;
+    Controller->InterruptHandle = INVALID_HANDLE;
+    Controller->Disk.Type = VirtblkContextDisk;
+    Controller->Disk.Controller = Controller;
+    VirtioInitializeDevice(&(Controller->Virtio), DeviceToken);
+    Status = IoAttachDriverToDevice(Driver, DeviceToken, Controller);
+    if (!KSUCCESS(Status)) {
+        goto AddDeviceEnd;
+    }
+
+    Status = STATUS_SUCCESS;
+
+AddDeviceEnd:
+    if (!KSUCCESS(Status)) {
+        if (Controller != NULL) {
+            MmFreeNonPagedPool(Controller);
+        }
+    }
+
+    return Status;
+}
+
+VOID
+VirtblkDispatchStateChange (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles State Change IRPs.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    DeviceContext - Supplies the context pointer supplied by the driver when it
+        attached itself to the driver stack. Presumably this pointer contains
+        driver-specific device context.
+
+    IrpContext - Supplies the context pointer supplied by the driver when
+        the IRP was created.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PVIRTBLK_CONTROLLER Controller;
+
+    Controller = DeviceContext;
+    switch (Controller->Type) {
+    case VirtblkContextController:
+        VirtblkpDispatchControllerStateChange(Irp, Controller);
+        break;
+
+    case VirtblkContextDisk:
+        VirtblkpDispatchDiskStateChange(Irp, (PVIRTBLK_DISK)Controller);
+        break;
+
+    default:
+
+        ASSERT(FALSE);
+
+        IoCompleteIrp(VirtblkDriver, Irp, STATUS_INVALID_CONFIGURATION);
+        break;
+    }
+
+    return;
+}
+
+VOID
+VirtblkDispatchOpen (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles Open IRPs.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    DeviceContext - Supplies the context pointer supplied by the driver when it
+        attached itself to the driver stack. Presumably this pointer contains
+        driver-specific device context.
+
+    IrpContext - Supplies the context pointer supplied by the driver when
+        the IRP was created.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PVIRTBLK_DISK Disk;
+
+    //
+    // Only the disk can be opened or closed.
+    //
+
+    Disk = (PVIRTBLK_DISK)DeviceContext;
+    if (Disk->Type != VirtblkContextDisk) {
+        return;
+    }
+
+    Irp->U.Open.DeviceContext = Disk;
+    IoCompleteIrp(VirtblkDriver, Irp, STATUS_SUCCESS);
+    return;
+}
+
+VOID
+VirtblkDispatchClose (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles Close IRPs.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    DeviceContext - Supplies the context pointer supplied by the driver when it
+        attached itself to the driver stack. Presumably this pointer contains
+        driver-specific device context.
+
+    IrpContext - Supplies the context pointer supplied by the driver when
+        the IRP was created.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PVIRTBLK_DISK Disk;
+
+    //
+    // Only the disk can be opened or closed.
+    //
+
+    Disk = (PVIRTBLK_DISK)DeviceContext;
+    if (Disk->Type != VirtblkContextDisk) {
+        return;
+    }
+
+    IoCompleteIrp(VirtblkDriver, Irp, STATUS_SUCCESS);
+    return;
+}
+
+VOID
+VirtblkDispatchIo (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles I/O IRPs.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    DeviceContext - Supplies the context pointer supplied by the driver when it
+        attached itself to the driver stack. Presumably this pointer contains
+        driver-specific device context.
+
+    IrpContext - Supplies the context pointer supplied by the driver when
+        the IRP was created.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    BOOL CompleteIrp;
+    PVIRTBLK_DISK Disk;
+    ULONG IrpReadWriteFlags;
+    KSTATUS Status;
+    BOOL Write;
+
+    Disk = (PVIRTBLK_DISK)Irp->U.ReadWrite.DeviceContext;
+    if (Disk->Type != VirtblkContextDisk) {
+        return;
+    }
+
+    CompleteIrp = TRUE;
+    Write = FALSE;
+    if (Irp->MinorCode == IrpMinorIoWrite) {
+        Write = TRUE;
+    }
+
+    IrpReadWriteFlags = IRP_READ_WRITE_FLAG_DMA;
+    if (Write != FALSE) {
+        IrpReadWriteFlags |= IRP_READ_WRITE_FLAG_WRITE;
+    }
+
+    //
+    // If the IRP is on the way up, then clean up after the DMA. An IRP going
+    // up is already complete.
+    //
+
+    if (Irp->Direction == IrpUp) {
+        CompleteIrp = FALSE;
+        Status = IoCompleteReadWriteIrp(&(Irp->U.ReadWrite), IrpReadWriteFlags);
+        if (!KSUCCESS(Status)) {
+            IoUpdateIrpStatus(Irp, Status);
+        }
+
+    //
+    // Start the DMA on the way down.
+    //
+
+    } else {
+        if ((Write != FALSE) && (Disk->ReadOnly != FALSE)) {
+            Status = STATUS_ACCESS_DENIED;
+            goto DispatchIoEnd;
+        }
+
+        Irp->U.ReadWrite.NewIoOffset = Irp->U.ReadWrite.IoOffset;
+
+        //
+        // The device can reach all of physical memory, so the I/O buffer only
+        // needs to be block aligned.
+        //
+
+        Status = IoPrepareReadWriteIrp(&(Irp->U.ReadWrite),
+                                       Disk->BlockSize,
+                                       0,
+                                       MAX_ULONGLONG,
+                                       IrpReadWriteFlags);
+
+        if (!KSUCCESS(Status)) {
+            goto DispatchIoEnd;
+        }
+
+        CompleteIrp = FALSE;
+        Status = VirtblkpEnqueueIrp(Disk, Irp);
+        if (!KSUCCESS(Status)) {
+            IoCompleteReadWriteIrp(&(Irp->U.ReadWrite), IrpReadWriteFlags);
+            CompleteIrp = TRUE;
+        }
+    }
+
+DispatchIoEnd:
+    if (CompleteIrp != FALSE) {
+        IoCompleteIrp(VirtblkDriver, Irp, Status);
+    }
+
+    return;
+}
+
+VOID
+VirtblkDispatchSystemControl (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles System Control IRPs.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    DeviceContext - Supplies the context pointer supplied by the driver when it
+        attached itself to the driver stack. Presumably this pointer contains
+        driver-specific device context.
+
+    IrpContext - Supplies the context pointer supplied by the driver when
+        the IRP was created.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PVIRTBLK_DISK Disk;
+
+    ASSERT(Irp->MajorCode == IrpMajorSystemControl);
+
+    Disk = (PVIRTBLK_DISK)DeviceContext;
+    if (Disk->Type == VirtblkContextDisk) {
+        VirtblkpDispatchDiskSystemControl(Irp, Disk);
+    }
+
+    return;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+VOID
+VirtblkpDispatchControllerStateChange (
+    PIRP Irp,
+    PVIRTBLK_CONTROLLER Controller
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles state change IRPs for a virtio block controller.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    Controller - Supplies a pointer to the controller context.
+
+Return Value:
+
+    None. The routine completes the IRP if appropriate.
+
+--*/
+
+{
+
+    KSTATUS Status;
+
+    if (Irp->Direction == IrpUp) {
+        if (!KSUCCESS(IoGetIrpStatus(Irp))) {
+            return;
+        }
+
+        switch (Irp->MinorCode) {
+        case IrpMinorQueryResources:
+            Status = VirtioProcessResourceRequirements(&(Controller->Virtio),
+                                                       Irp,
+                                                       1,
+                                                       VIRTBLK_MAX_QUEUES);
+
+            if (!KSUCCESS(Status)) {
+                IoCompleteIrp(VirtblkDriver, Irp, Status);
+            }
+
+            break;
+
+        case IrpMinorStartDevice:
+            Status = VirtblkpStartController(Irp, Controller);
+            if (!KSUCCESS(Status)) {
+                IoCompleteIrp(VirtblkDriver, Irp, Status);
+            }
+
+            break;
+
+        case IrpMinorQueryChildren:
+            VirtblkpEnumerateDisk(Irp, Controller);
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    return;
+}
+
+VOID
+VirtblkpDispatchDiskStateChange (
+    PIRP Irp,
+    PVIRTBLK_DISK Disk
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles state change IRPs for a virtio disk.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    Disk - Supplies a pointer to the disk.
+
+Return Value:
+
+    None. The routine completes the IRP if appropriate.
+
+--*/
+
+{
+
+    if (Irp->Direction == IrpDown) {
+        switch (Irp->MinorCode) {
+        case IrpMinorStartDevice:
+
+            ASSERT(Disk->OsDevice == Irp->Device);
+
+            IoCompleteIrp(VirtblkDriver, Irp, STATUS_SUCCESS);
+            break;
+
+        case IrpMinorQueryResources:
+        case IrpMinorQueryChildren:
+        case IrpMinorIdle:
+        case IrpMinorSuspend:
+        case IrpMinorResume:
+        case IrpMinorRemoveDevice:
+            IoCompleteIrp(VirtblkDriver, Irp, STATUS_SUCCESS);
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    return;
+}
+
+VOID
+VirtblkpDispatchDiskSystemControl (
+    PIRP Irp,
+    PVIRTBLK_DISK Disk
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles System Control IRPs for a virtio disk.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    Disk - Supplies a pointer to the disk.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PVOID Context;
+    PSYSTEM_CONTROL_FILE_OPERATION FileOperation;
+    PSYSTEM_CONTROL_LOOKUP Lookup;
+    PFILE_PROPERTIES Properties;
+    ULONGLONG PropertiesFileSize;
+    KSTATUS Status;
+
+    Context = Irp->U.SystemControl.SystemContext;
+    if (Irp->Direction == IrpUp) {
+        return;
+    }
+
+    switch (Irp->MinorCode) {
+    case IrpMinorSystemControlLookup:
+        Lookup = (PSYSTEM_CONTROL_LOOKUP)Context;
+        Status = STATUS_PATH_NOT_FOUND;
+        if (Lookup->Root != FALSE) {
+
+            //
+            // Enable opening of the root as a single file.
+            //
+
+            Properties = &(Lookup->Properties);
+            Properties->FileId = 0;
+            Properties->Type = IoObjectBlockDevice;
+            Properties->HardLinkCount = 1;
+            Properties->BlockSize = Disk->BlockSize;
+            Properties->BlockCount = Disk->BlockCount;
+            WRITE_INT64_SYNC(&(Properties->FileSize),
+                             Disk->BlockCount * Disk->BlockSize);
+
+            Status = STATUS_SUCCESS;
+        }
+
+        IoCompleteIrp(VirtblkDriver, Irp, Status);
+        break;
+
+    //
+    // Writes to the disk's properties are not allowed. Fail if the data
+    // has changed.
+    //
+
+    case IrpMinorSystemControlWriteFileProperties:
+        FileOperation = (PSYSTEM_CONTROL_FILE_OPERATION)Context;
+        Properties = FileOperation->FileProperties;
+        READ_INT64_SYNC(&(Properties->FileSize), &PropertiesFileSize);
+        if ((Properties->FileId != 0) ||
+            (Properties->Type != IoObjectBlockDevice) ||
+            (Properties->HardLinkCount != 1) ||
+            (Properties->BlockSize != Disk->BlockSize) ||
+            (Properties->BlockCount != Disk->BlockCount) ||
+            (PropertiesFileSize != (Disk->BlockCount * Disk->BlockSize))) {
+
+            Status = STATUS_NOT_SUPPORTED;
+
+        } else {
+            Status = STATUS_SUCCESS;
+        }
+
+        IoCompleteIrp(VirtblkDriver, Irp, Status);
+        break;
+
+    //
+    // Do not support disk truncation.
+    //
+
+    case IrpMinorSystemControlTruncate:
+        IoCompleteIrp(VirtblkDriver, Irp, STATUS_NOT_SUPPORTED);
+        break;
+
+    //
+    // Gather and return device information.
+    //
+
+    case IrpMinorSystemControlDeviceInformation:
+        break;
+
+    //
+    // Send a flush request to the device upon getting a synchronize request.
+    // Devices without a write cache complete writes durably, so there is
+    // nothing to do for them.
+    //
+
+    case IrpMinorSystemControlSynchronize:
+        if ((Disk->Controller->Virtio.Features &
+             VIRTIO_BLK_FEATURE_FLUSH) == 0) {
+
+            IoCompleteIrp(VirtblkDriver, Irp, STATUS_SUCCESS);
+            break;
+        }
+
+        Status = VirtblkpEnqueueIrp(Disk, Irp);
+        if (!KSUCCESS(Status)) {
+            IoCompleteIrp(VirtblkDriver, Irp, Status);
+        }
+
+        break;
+
+    //
+    // Ignore everything unrecognized.
+    //
+
+    default:
+
+        ASSERT(FALSE);
+
+        break;
+    }
+
+    return;
+}
+
+KSTATUS
+VirtblkpStartController (
+    PIRP Irp,
+    PVIRTBLK_CONTROLLER Controller
+    )
+
+/*++
+
+Routine Description:
+
+    This routine starts a virtio block controller. It negotiates features,
+    reads the disk geometry, and sets up one request queue per processor, up
+    to the number of queues the device offers.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    Controller - Supplies a pointer to the controller.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    ULONG BlockSize;
+    ULONGLONG Capacity;
+    IO_CONNECT_INTERRUPT_PARAMETERS Connect;
+    ULONGLONG Features;
+    ULONG MessageVectorCount;
+    ULONG ProcessorCount;
+    PVIRTBLK_QUEUE Queue;
+    USHORT QueueCount;
+    USHORT QueueIndex;
+    KSTATUS Status;
+    ULONG Value;
+
+    //
+    // The queues survive across restarts of the device. Starting the virtio
+    // device again would reset it out from under them.
+    //
+
+    if (Controller->Started != FALSE) {
+        return STATUS_SUCCESS;
+    }
+
+    QueueCount = 0;
+    Status = VirtioStartDevice(&(Controller->Virtio), Irp);
+    if (!KSUCCESS(Status)) {
+        goto StartControllerEnd;
+    }
+
+    Status = VirtioNegotiateFeatures(&(Controller->Virtio), VIRTBLK_FEATURES);
+    if (!KSUCCESS(Status)) {
+        goto StartControllerEnd;
+    }
+
+    Features = Controller->Virtio.Features;
+    VirtioReadDeviceConfiguration(&(Controller->Virtio),
+                                  VIRTIO_BLK_CONFIG_CAPACITY,
+                                  &Capacity,
+                                  sizeof(ULONGLONG));
+
+    BlockSize = VIRTBLK_SECTOR_SIZE;
+    if ((Features & VIRTIO_BLK_FEATURE_BLOCK_SIZE) != 0) {
+        VirtioReadDeviceConfiguration(&(Controller->Virtio),
+                                      VIRTIO_BLK_CONFIG_BLOCK_SIZE,
+                                      &BlockSize,
+                                      sizeof(ULONG));
+
+        if ((BlockSize < VIRTBLK_SECTOR_SIZE) ||
+            (POWER_OF_2(BlockSize) == FALSE)) {
+
+            BlockSize = VIRTBLK_SECTOR_SIZE;
+        }
+    }
+
+    Controller->MaxSegments = VIRTBLK_MAX_SEGMENTS;
+    if ((Features & VIRTIO_BLK_FEATURE_SEG_MAX) != 0) {
+        VirtioReadDeviceConfiguration(&(Controller->Virtio),
+                                      VIRTIO_BLK_CONFIG_SEG_MAX,
+                                      &Value,
+                                      sizeof(ULONG));
+
+        if ((Value != 0) && (Value < Controller->MaxSegments)) {
+            Controller->MaxSegments = Value;
+        }
+    }
+
+    //
+    // Keep segments block aligned so that a request cut short by the segment
+    // limit still transfers whole blocks.
+    //
+
+    Controller->MaxSegmentSize = ALIGN_RANGE_DOWN(MAX_ULONG, BlockSize);
+    if ((Features & VIRTIO_BLK_FEATURE_SIZE_MAX) != 0) {
+        VirtioReadDeviceConfiguration(&(Controller->Virtio),
+                                      VIRTIO_BLK_CONFIG_SIZE_MAX,
+                                      &Value,
+                                      sizeof(ULONG));
+
+        if (Value >= BlockSize) {
+            Controller->MaxSegmentSize = ALIGN_RANGE_DOWN(Value, BlockSize);
+        }
+    }
+
+    //
+    // Use a queue per processor if the device supports enough of them.
+    //
+
+    QueueCount = 1;
+    if ((Features & VIRTIO_BLK_FEATURE_MULTIQUEUE) != 0) {
+        VirtioReadDeviceConfiguration(&(Controller->Virtio),
+                                      VIRTIO_BLK_CONFIG_QUEUE_COUNT,
+                                      &QueueCount,
+                                      sizeof(USHORT));
+
+        if (QueueCount == 0) {
+            QueueCount = 1;
+        }
+    }
+
+    ProcessorCount = KeGetActiveProcessorCount();
+    if (QueueCount > ProcessorCount) {
+        QueueCount = ProcessorCount;
+    }
+
+    if (QueueCount > VIRTBLK_MAX_QUEUES) {
+        QueueCount = VIRTBLK_MAX_QUEUES;
+    }
+
+    if (QueueCount > Controller->Virtio.QueueCount) {
+        QueueCount = Controller->Virtio.QueueCount;
+    }
+
+    //
+    // With MSI-X, each queue gets its own vector, so there can be no more
+    // queues than vectors.
+    //
+
+    MessageVectorCount = Controller->Virtio.MessageVectorCount;
+    if ((MessageVectorCount != 0) && (QueueCount > MessageVectorCount)) {
+        QueueCount = MessageVectorCount;
+    }
+
+    if (QueueCount == 0) {
+        Status = STATUS_NOT_SUPPORTED;
+        goto StartControllerEnd;
+    }
+
+    for (QueueIndex = 0; QueueIndex < QueueCount; QueueIndex += 1) {
+        Status = VirtblkpCreateQueue(Controller,
+                                     QueueIndex,
+                                     &(Controller->Queues[QueueIndex]));
+
+        if (!KSUCCESS(Status)) {
+            goto StartControllerEnd;
+        }
+    }
+
+    Controller->Disk.BlockSize = BlockSize;
+    Controller->Disk.BlockCount = (Capacity * VIRTBLK_SECTOR_SIZE) / BlockSize;
+    Controller->Disk.ReadOnly = FALSE;
+    if ((Features & VIRTIO_BLK_FEATURE_READ_ONLY) != 0) {
+        Controller->Disk.ReadOnly = TRUE;
+    }
+
+    Controller->QueueCount = QueueCount;
+
+    //
+    // With MSI-X, connect each queue's vector so that a completion only
+    // looks at the queue that finished.
+    //
+
+    if (MessageVectorCount != 0) {
+        for (QueueIndex = 0; QueueIndex < QueueCount; QueueIndex += 1) {
+            Queue = Controller->Queues[QueueIndex];
+            RtlZeroMemory(&Connect, sizeof(IO_CONNECT_INTERRUPT_PARAMETERS));
+            Connect.Version = IO_CONNECT_INTERRUPT_PARAMETERS_VERSION;
+            Connect.Device = Irp->Device;
+            Connect.InterruptServiceRoutine = VirtblkpQueueInterruptService;
+            Connect.DispatchServiceRoutine = VirtblkpQueueInterruptServiceDpc;
+            Connect.Context = Queue;
+            Connect.LineNumber = INVALID_INTERRUPT_LINE;
+            Connect.Vector = Controller->Virtio.InterruptVector + QueueIndex;
+            Connect.Interrupt = &(Queue->InterruptHandle);
+            Status = IoConnectInterrupt(&Connect);
+            if (!KSUCCESS(Status)) {
+                goto StartControllerEnd;
+            }
+        }
+
+    } else if (Controller->InterruptHandle == INVALID_HANDLE) {
+        RtlZeroMemory(&Connect, sizeof(IO_CONNECT_INTERRUPT_PARAMETERS));
+        Connect.Version = IO_CONNECT_INTERRUPT_PARAMETERS_VERSION;
+        Connect.Device = Irp->Device;
+        Connect.InterruptServiceRoutine = VirtblkpInterruptService;
+        Connect.DispatchServiceRoutine = VirtblkpInterruptServiceDpc;
+        Connect.Context = Controller;
+        Connect.LineNumber = Controller->Virtio.InterruptLine;
+        Connect.Vector = Controller->Virtio.InterruptVector;
+        Connect.Interrupt = &(Controller->InterruptHandle);
+        Status = IoConnectInterrupt(&Connect);
+        if (!KSUCCESS(Status)) {
+            goto StartControllerEnd;
+        }
+    }
+
+    VirtioSetDriverReady(&(Controller->Virtio));
+    Controller->Started = TRUE;
+    Status = STATUS_SUCCESS;
+
+StartControllerEnd:
+    if (!KSUCCESS(Status)) {
+        RtlDebugPrint("Virtblk: Failed to start: %d\n", Status);
+        VirtioResetDevice(&(Controller->Virtio));
+        for (QueueIndex = 0; QueueIndex < QueueCount; QueueIndex += 1) {
+            if (Controller->Queues[QueueIndex] != NULL) {
+                VirtblkpDestroyQueue(Controller->Queues[QueueIndex]);
+                Controller->Queues[QueueIndex] = NULL;
+            }
+        }
+
+        Controller->QueueCount = 0;
+    }
+
+    return Status;
+}
+
+VOID
+VirtblkpEnumerateDisk (
+    PIRP Irp,
+    PVIRTBLK_CONTROLLER Controller
+    )
+
+/*++
+
+Routine Description:
+
+    This routine reports the disk child of a virtio block controller.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    Controller - Supplies a pointer to the controller.
+
+Return Value:
+
+    None. The IRP is completed with the appropriate status.
+
+--*/
+
+{
+
+    PVIRTBLK_DISK Disk;
+    KSTATUS Status;
+
+    Disk = &(Controller->Disk);
+    if (Disk->OsDevice == NULL) {
+        Status = IoCreateDevice(VirtblkDriver,
+                                Disk,
+                                Irp->Device,
+                                "Disk",
+                                DISK_CLASS_ID,
+                                NULL,
+                                &(Disk->OsDevice));
+
+        if (!KSUCCESS(Status)) {
+            goto EnumerateDiskEnd;
+        }
+    }
+
+    Status = IoMergeChildArrays(Irp,
+                                &(Disk->OsDevice),
+                                1,
+                                VIRTBLK_ALLOCATION_TAG);
+
+    if (!KSUCCESS(Status)) {
+        goto EnumerateDiskEnd;
+    }
+
+EnumerateDiskEnd:
+    IoCompleteIrp(VirtblkDriver, Irp, Status);
+    return;
+}
+
+KSTATUS
+VirtblkpCreateQueue (
+    PVIRTBLK_CONTROLLER Controller,
+    USHORT Index,
+    PVIRTBLK_QUEUE *NewQueue
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates a request queue and its command buffers.
+
+Arguments:
+
+    Controller - Supplies a pointer to the controller.
+
+    Index - Supplies the virtio queue index.
+
+    NewQueue - Supplies a pointer where the new queue will be returned.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    PVIRTBLK_COMMAND Commands;
+    PHYSICAL_ADDRESS PhysicalAddress;
+    PVIRTBLK_QUEUE Queue;
+    PVIRTBLK_REQUEST Request;
+    ULONG RequestCount;
+    ULONG RequestIndex;
+    ULONG Size;
+    KSTATUS Status;
+
+    Queue = MmAllocateNonPagedPool(sizeof(VIRTBLK_QUEUE),
+                                   VIRTBLK_ALLOCATION_TAG);
+
+    if (Queue == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto CreateQueueEnd;
+    }
+
+    RtlZeroMemory(Queue, sizeof(VIRTBLK_QUEUE));
+    Queue->Controller = Controller;
+    Queue->InterruptHandle = INVALID_HANDLE;
+    KeInitializeSpinLock(&(Queue->Lock));
+    INITIALIZE_LIST_HEAD(&(Queue->IrpQueue));
+
+    //
+    // Request queue N uses MSI-X table entry N.
+    //
+
+    Status = VirtioCreateQueue(&(Controller->Virtio),
+                               Index,
+                               VIRTBLK_QUEUE_SIZE,
+                               Index,
+                               &(Queue->Queue));
+
+    if (!KSUCCESS(Status)) {
+        goto CreateQueueEnd;
+    }
+
+    //
+    // Shrink the segment limit if the queue cannot hold a full request. This
+    // only ever shrinks, so queues sized with an earlier limit remain safe.
+    //
+
+    Size = Queue->Queue->Size;
+    if (Size <= VIRTBLK_REQUEST_OVERHEAD_DESCRIPTORS) {
+        Status = STATUS_NOT_SUPPORTED;
+        goto CreateQueueEnd;
+    }
+
+    if (Controller->MaxSegments >
+        (Size - VIRTBLK_REQUEST_OVERHEAD_DESCRIPTORS)) {
+
+        Controller->MaxSegments = Size - VIRTBLK_REQUEST_OVERHEAD_DESCRIPTORS;
+    }
+
+    //
+    // Only allow as many requests as the queue has descriptors for, so that a
+    // request slot always implies room in the queue.
+    //
+
+    RequestCount = Size /
+                   (Controller->MaxSegments +
+                    VIRTBLK_REQUEST_OVERHEAD_DESCRIPTORS);
+
+    if (RequestCount > VIRTBLK_MAX_REQUESTS) {
+        RequestCount = VIRTBLK_MAX_REQUESTS;
+    }
+
+    Queue->CommandIoBuffer = MmAllocateNonPagedIoBuffer(
+                                       0,
+                                       MAX_ULONGLONG,
+                                       sizeof(VIRTBLK_COMMAND),
+                                       RequestCount * sizeof(VIRTBLK_COMMAND),
+                                       IO_BUFFER_FLAG_PHYSICALLY_CONTIGUOUS);
+
+    if (Queue->CommandIoBuffer == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto CreateQueueEnd;
+    }
+
+    ASSERT(Queue->CommandIoBuffer->FragmentCount == 1);
+
+    Commands = Queue->CommandIoBuffer->Fragment[0].VirtualAddress;
+    PhysicalAddress = Queue->CommandIoBuffer->Fragment[0].PhysicalAddress;
+    RtlZeroMemory(Commands, RequestCount * sizeof(VIRTBLK_COMMAND));
+    for (RequestIndex = 0; RequestIndex < RequestCount; RequestIndex += 1) {
+        Request = &(Queue->Requests[RequestIndex]);
+        Request->Command = &(Commands[RequestIndex]);
+        Request->CommandPhysical = PhysicalAddress +
+                                   (RequestIndex * sizeof(VIRTBLK_COMMAND));
+    }
+
+    Queue->RequestCount = RequestCount;
+    if (RequestCount == VIRTBLK_MAX_REQUESTS) {
+        Queue->FreeRequests = MAX_ULONG;
+
+    } else {
+        Queue->FreeRequests = (1 << RequestCount) - 1;
+    }
+
+    Status = STATUS_SUCCESS;
+
+CreateQueueEnd:
+    if (!KSUCCESS(Status)) {
+        if (Queue != NULL) {
+            VirtblkpDestroyQueue(Queue);
+            Queue = NULL;
+        }
+    }
+
+    *NewQueue = Queue;
+    return Status;
+}
+
+VOID
+VirtblkpDestroyQueue (
+    PVIRTBLK_QUEUE Queue
+    )
+
+/*++
+
+Routine Description:
+
+    This routine destroys a request queue. The device must not be using it.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue to destroy.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ASSERT(LIST_EMPTY(&(Queue->IrpQueue)) != FALSE);
+
+    if (Queue->InterruptHandle != INVALID_HANDLE) {
+        IoDisconnectInterrupt(Queue->InterruptHandle);
+    }
+
+    if (Queue->Queue != NULL) {
+        VirtioDestroyQueue(Queue->Queue);
+    }
+
+    if (Queue->CommandIoBuffer != NULL) {
+        MmFreeIoBuffer(Queue->CommandIoBuffer);
+    }
+
+    MmFreeNonPagedPool(Queue);
+    return;
+}
+
+INTERRUPT_STATUS
+VirtblkpInterruptService (
+    PVOID Context
+    )
+
+/*++
+
+Routine Description:
+
+    This routine implements the virtio block interrupt service routine.
+
+Arguments:
+
+    Context - Supplies the context pointer given to the system when the
+        interrupt was connected. In this case, this points to the controller.
+
+Return Value:
+
+    Interrupt status.
+
+--*/
+
+{
+
+    PVIRTBLK_CONTROLLER Controller;
+    ULONG Status;
+
+    Controller = (PVIRTBLK_CONTROLLER)Context;
+
+    //
+    // Reading the status register also acknowledges the interrupt.
+    //
+
+    Status = VirtioReadInterruptStatus(&(Controller->Virtio));
+    if (Status == 0) {
+        return InterruptStatusNotClaimed;
+    }
+
+    RtlAtomicOr32(&(Controller->PendingInterrupts), Status);
+    return InterruptStatusClaimed;
+}
+
+INTERRUPT_STATUS
+VirtblkpInterruptServiceDpc (
+    PVOID Parameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine implements the virtio block dispatch level interrupt service.
+
+Arguments:
+
+    Parameter - Supplies the context, in this case the controller structure.
+
+Return Value:
+
+    Interrupt status.
+
+--*/
+
+{
+
+    PVIRTBLK_CONTROLLER Controller;
+    ULONG QueueIndex;
+    ULONG StatusBits;
+
+    Controller = Parameter;
+    StatusBits = RtlAtomicExchange32(&(Controller->PendingInterrupts), 0);
+    if (StatusBits == 0) {
+        return InterruptStatusNotClaimed;
+    }
+
+    //
+    // This is only used when the legacy interrupt line is shared by all the
+    // queues, so check them all.
+    //
+
+    if ((StatusBits & VIRTIO_ISR_QUEUE) != 0) {
+        for (QueueIndex = 0;
+             QueueIndex < Controller->QueueCount;
+             QueueIndex += 1) {
+
+            VirtblkpProcessQueue(Controller->Queues[QueueIndex]);
+        }
+    }
+
+    return InterruptStatusClaimed;
+}
+
+INTERRUPT_STATUS
+VirtblkpQueueInterruptService (
+    PVOID Context
+    )
+
+/*++
+
+Routine Description:
+
+    This routine implements the interrupt service routine for a request
+    queue's own MSI-X vector. The vector is not shared and message signaled
+    interrupts need no acknowledgement, so it always claims the interrupt and
+    leaves the work to the DPC.
+
+Arguments:
+
+    Context - Supplies the context pointer given to the system when the
+        interrupt was connected. In this case, this points to the queue.
+
+Return Value:
+
+    Interrupt status.
+
+--*/
+
+{
+
+    return InterruptStatusClaimed;
+}
+
+INTERRUPT_STATUS
+VirtblkpQueueInterruptServiceDpc (
+    PVOID Parameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine implements the dispatch level interrupt service for a
+    request queue's own MSI-X vector.
+
+Arguments:
+
+    Parameter - Supplies the context, in this case the queue structure.
+
+Return Value:
+
+    Interrupt status.
+
+--*/
+
+{
+
+    VirtblkpProcessQueue(Parameter);
+    return InterruptStatusClaimed;
+}
+
+KSTATUS
+VirtblkpEnqueueIrp (
+    PVIRTBLK_DISK Disk,
+    PIRP Irp
+    )
+
+/*++
+
+Routine Description:
+
+    This routine begins I/O on a fresh IRP. The IRP is submitted on the queue
+    belonging to the current processor.
+
+Arguments:
+
+    Disk - Supplies a pointer to the disk.
+
+    Irp - Supplies a pointer to the read/write or synchronize IRP.
+
+Return Value:
+
+    STATUS_SUCCESS if the IRP was successfully started or even queued.
+
+    Error code on failure.
+
+--*/
+
+{
+
+    PVIRTBLK_CONTROLLER Controller;
+    RUNLEVEL OldRunLevel;
+    PVIRTBLK_QUEUE Queue;
+    ULONG QueueIndex;
+
+    Controller = Disk->Controller;
+    if (Controller->QueueCount == 0) {
+        return STATUS_NOT_READY;
+    }
+
+    IoPendIrp(VirtblkDriver, Irp);
+
+    //
+    // Attempt to grab a request slot. If none are free, add this IRP to the
+    // queue atomically so it's always clear who is taking care of the queued
+    // IRP. Anything already waiting goes first to keep IRPs from passing a
+    // waiting flush.
+    //
+
+    OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+    QueueIndex = KeGetCurrentProcessorNumber() % Controller->QueueCount;
+    Queue = Controller->Queues[QueueIndex];
+    KeAcquireSpinLock(&(Queue->Lock));
+    if ((LIST_EMPTY(&(Queue->IrpQueue)) != FALSE) &&
+        (Queue->FreeRequests != 0)) {
+
+        VirtblkpStartIrp(Queue, Irp);
+
+    } else {
+        INSERT_BEFORE(&(Irp->ListEntry), &(Queue->IrpQueue));
+    }
+
+    KeReleaseSpinLock(&(Queue->Lock));
+    KeLowerRunLevel(OldRunLevel);
+    return STATUS_SUCCESS;
+}
+
+VOID
+VirtblkpStartIrp (
+    PVIRTBLK_QUEUE Queue,
+    PIRP Irp
+    )
+
+/*++
+
+Routine Description:
+
+    This routine starts the given IRP on a free request slot. This routine
+    assumes the queue lock is held and that a request slot is free.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+    Irp - Supplies a pointer to the IRP to start.
+
+Return Value:
+
+    None. The IRP is completed on failure.
+
+--*/
+
+{
+
+    BOOL Flush;
+    ULONG Index;
+    PVIRTBLK_REQUEST Request;
+
+    ASSERT(KeIsSpinLockHeld(&(Queue->Lock)) != FALSE);
+    ASSERT(Queue->FreeRequests != 0);
+
+    Index = RtlCountTrailingZeros32(Queue->FreeRequests);
+    Queue->FreeRequests &= ~(1 << Index);
+    Request = &(Queue->Requests[Index]);
+
+    ASSERT(Request->Irp == NULL);
+
+    Request->Irp = Irp;
+    Flush = FALSE;
+    if (Irp->MajorCode == IrpMajorSystemControl) {
+
+        ASSERT(Irp->MinorCode == IrpMinorSystemControlSynchronize);
+
+        Flush = TRUE;
+
+    } else if (Irp->U.ReadWrite.IoBytesCompleted >=
+               Irp->U.ReadWrite.IoSizeInBytes) {
+
+        VirtblkpCompleteRequest(Queue, Request, STATUS_SUCCESS);
+        return;
+    }
+
+    VirtblkpSubmitRequest(Queue, Request, Flush);
+    return;
+}
+
+VOID
+VirtblkpBeginQueuedIrps (
+    PVIRTBLK_QUEUE Queue
+    )
+
+/*++
+
+Routine Description:
+
+    This routine starts as many of the queued IRPs as there are free request
+    slots for. This routine assumes the queue lock is held.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PIRP Irp;
+
+    ASSERT(KeIsSpinLockHeld(&(Queue->Lock)) != FALSE);
+
+    while ((LIST_EMPTY(&(Queue->IrpQueue)) == FALSE) &&
+           (Queue->FreeRequests != 0)) {
+
+        Irp = LIST_VALUE(Queue->IrpQueue.Next, IRP, ListEntry);
+        LIST_REMOVE(&(Irp->ListEntry));
+        VirtblkpStartIrp(Queue, Irp);
+    }
+
+    return;
+}
+
+VOID
+VirtblkpSubmitRequest (
+    PVIRTBLK_QUEUE Queue,
+    PVIRTBLK_REQUEST Request,
+    BOOL Flush
+    )
+
+/*++
+
+Routine Description:
+
+    This routine fills out and submits the next request for an IRP. For I/O,
+    this transfers as much of the remaining IRP as fits in one request. This
+    routine assumes the queue lock is held.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+    Request - Supplies a pointer to the request slot, which has its IRP set.
+
+    Flush - Supplies a boolean indicating whether to submit a flush request
+        rather than a transfer.
+
+Return Value:
+
+    None. The IRP is completed on failure.
+
+--*/
+
+{
+
+    VIRTIO_BUFFER Buffers[VIRTBLK_MAX_SEGMENTS +
+                          VIRTBLK_REQUEST_OVERHEAD_DESCRIPTORS];
+
+    UINTN BytesPreviouslyCompleted;
+    PVIRTBLK_COMMAND Command;
+    PVIRTBLK_CONTROLLER Controller;
+    UINTN EntrySize;
+    PIO_BUFFER_FRAGMENT Fragment;
+    UINTN FragmentIndex;
+    UINTN FragmentOffset;
+    ULONG InCount;
+    PIO_BUFFER IoBuffer;
+    UINTN IoBufferOffset;
+    PIRP Irp;
+    ULONG OutCount;
+    ULONG SegmentCount;
+    KSTATUS Status;
+    UINTN TransferSize;
+    UINTN TransferSizeRemaining;
+    BOOL Write;
+
+    ASSERT(KeIsSpinLockHeld(&(Queue->Lock)) != FALSE);
+
+    Controller = Queue->Controller;
+    Irp = Request->Irp;
+    Command = Request->Command;
+    Command->Header.Reserved = 0;
+    Command->Header.Sector = 0;
+
+    //
+    // Preset the status so that a request the device never fills in does not
+    // read as a success.
+    //
+
+    Command->Status = VIRTIO_BLK_STATUS_IO_ERROR;
+    Buffers[0].Address = Request->CommandPhysical;
+    Buffers[0].Length = sizeof(VIRTBLK_REQUEST_HEADER);
+    SegmentCount = 0;
+    Write = FALSE;
+    if (Flush != FALSE) {
+        Command->Header.Type = VIRTIO_BLK_REQUEST_FLUSH;
+        Request->IoSize = 0;
+
+    } else {
+        IoBuffer = Irp->U.ReadWrite.IoBuffer;
+        BytesPreviouslyCompleted = Irp->U.ReadWrite.IoBytesCompleted;
+        TransferSize = Irp->U.ReadWrite.IoSizeInBytes -
+                       BytesPreviouslyCompleted;
+
+        ASSERT(TransferSize != 0);
+        ASSERT(Irp->U.ReadWrite.NewIoOffset ==
+               (Irp->U.ReadWrite.IoOffset + BytesPreviouslyCompleted));
+
+        if (Irp->MinorCode == IrpMinorIoWrite) {
+            Write = TRUE;
+        }
+
+        //
+        // Get to the current spot in the I/O buffer.
+        //
+
+        IoBufferOffset = MmGetIoBufferCurrentOffset(IoBuffer);
+        IoBufferOffset += BytesPreviouslyCompleted;
+        FragmentIndex = 0;
+        FragmentOffset = 0;
+        while (IoBufferOffset != 0) {
+
+            ASSERT(FragmentIndex < IoBuffer->FragmentCount);
+
+            Fragment = &(IoBuffer->Fragment[FragmentIndex]);
+            if (IoBufferOffset < Fragment->Size) {
+                FragmentOffset = IoBufferOffset;
+                break;
+            }
+
+            IoBufferOffset -= Fragment->Size;
+            FragmentIndex += 1;
+        }
+
+        //
+        // Describe as many fragments as fit in the request.
+        //
+
+        TransferSizeRemaining = TransferSize;
+        while ((TransferSizeRemaining != 0) &&
+               (SegmentCount < Controller->MaxSegments)) {
+
+            ASSERT(FragmentIndex < IoBuffer->FragmentCount);
+
+            Fragment = &(IoBuffer->Fragment[FragmentIndex]);
+            EntrySize = TransferSizeRemaining;
+            if (EntrySize > (Fragment->Size - FragmentOffset)) {
+                EntrySize = Fragment->Size - FragmentOffset;
+            }
+
+            if (EntrySize > Controller->MaxSegmentSize) {
+                EntrySize = Controller->MaxSegmentSize;
+            }
+
+            SegmentCount += 1;
+            Buffers[SegmentCount].Address = Fragment->PhysicalAddress +
+                                            FragmentOffset;
+
+            Buffers[SegmentCount].Length = EntrySize;
+            TransferSizeRemaining -= EntrySize;
+            FragmentOffset += EntrySize;
+            if (FragmentOffset >= Fragment->Size) {
+                FragmentIndex += 1;
+                FragmentOffset = 0;
+            }
+        }
+
+        TransferSize -= TransferSizeRemaining;
+
+        ASSERT(IS_ALIGNED(TransferSize, VIRTBLK_SECTOR_SIZE) != FALSE);
+
+        Command->Header.Type = VIRTIO_BLK_REQUEST_READ;
+        if (Write != FALSE) {
+            Command->Header.Type = VIRTIO_BLK_REQUEST_WRITE;
+        }
+
+        Command->Header.Sector = Irp->U.ReadWrite.NewIoOffset /
+                                 VIRTBLK_SECTOR_SIZE;
+
+        Request->IoSize = TransferSize;
+    }
+
+    Buffers[SegmentCount + 1].Address = Request->CommandPhysical +
+                                        FIELD_OFFSET(VIRTBLK_COMMAND, Status);
+
+    Buffers[SegmentCount + 1].Length = sizeof(UCHAR);
+
+    //
+    // The device reads the header and any data being written, and writes any
+    // data being read followed by the status.
+    //
+
+    if (Write != FALSE) {
+        OutCount = SegmentCount + 1;
+        InCount = 1;
+
+    } else {
+        OutCount = 1;
+        InCount = SegmentCount + 1;
+    }
+
+    Status = VirtioQueueAddBuffers(Queue->Queue,
+                                   Buffers,
+                                   OutCount,
+                                   InCount,
+                                   Request);
+
+    if (!KSUCCESS(Status)) {
+
+        ASSERT(FALSE);
+
+        VirtblkpCompleteRequest(Queue, Request, Status);
+        return;
+    }
+
+    VirtioQueueNotify(Queue->Queue);
+    return;
+}
+
+VOID
+VirtblkpCompleteRequest (
+    PVIRTBLK_QUEUE Queue,
+    PVIRTBLK_REQUEST Request,
+    KSTATUS Status
+    )
+
+/*++
+
+Routine Description:
+
+    This routine releases a request slot and completes its IRP. This routine
+    assumes the queue lock is held.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+    Request - Supplies a pointer to the request slot to release.
+
+    Status - Supplies the status to complete the IRP with.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG Index;
+    PIRP Irp;
+
+    Index = Request - Queue->Requests;
+
+    ASSERT((Queue->FreeRequests & (1 << Index)) == 0);
+
+    Irp = Request->Irp;
+    Request->Irp = NULL;
+    Request->IoSize = 0;
+    Queue->FreeRequests |= 1 << Index;
+    IoCompleteIrp(VirtblkDriver, Irp, Status);
+    return;
+}
+
+VOID
+VirtblkpProcessQueue (
+    PVIRTBLK_QUEUE Queue
+    )
+
+/*++
+
+Routine Description:
+
+    This routine processes the requests the device has finished on the given
+    queue, and starts any IRPs that were waiting for request slots.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PVOID Cookie;
+    PVIRTBLK_CONTROLLER Controller;
+    UINTN IoSize;
+    PIRP Irp;
+    ULONG Length;
+    PVIRTBLK_REQUEST Request;
+    KSTATUS Status;
+
+    Controller = Queue->Controller;
+    KeAcquireSpinLock(&(Queue->Lock));
+    while (VirtioQueueGetUsedBuffer(Queue->Queue, &Cookie, &Length) != FALSE) {
+        Request = Cookie;
+        Irp = Request->Irp;
+        IoSize = Request->IoSize;
+        if (Request->Command->Status != VIRTIO_BLK_STATUS_OK) {
+            RtlDebugPrint("Virtblk: Request failed: %d\n",
+                          Request->Command->Status);
+
+            Status = STATUS_DEVICE_IO_ERROR;
+            if (Request->Command->Status == VIRTIO_BLK_STATUS_UNSUPPORTED) {
+                Status = STATUS_NOT_SUPPORTED;
+            }
+
+            VirtblkpCompleteRequest(Queue, Request, Status);
+            continue;
+        }
+
+        if (Irp->MajorCode == IrpMajorIo) {
+            Irp->U.ReadWrite.IoBytesCompleted += IoSize;
+            Irp->U.ReadWrite.NewIoOffset += IoSize;
+
+            //
+            // If this is a synchronized write, then send a flush along with
+            // it. Use the IoSize as a hint as to whether or not the flush
+            // part has already gone around.
+            //
+
+            if ((Irp->MinorCode == IrpMinorIoWrite) &&
+                ((Irp->U.ReadWrite.IoFlags &
+                  IO_FLAG_DATA_SYNCHRONIZED) != 0) &&
+                ((Controller->Virtio.Features &
+                  VIRTIO_BLK_FEATURE_FLUSH) != 0) &&
+                (Irp->U.ReadWrite.IoBytesCompleted >=
+                 Irp->U.ReadWrite.IoSizeInBytes) &&
+                (IoSize != 0)) {
+
+                VirtblkpSubmitRequest(Queue, Request, TRUE);
+                continue;
+            }
+
+            //
+            // If the IRP is not finished, queue up the next part.
+            //
+
+            if (Irp->U.ReadWrite.IoBytesCompleted <
+                Irp->U.ReadWrite.IoSizeInBytes) {
+
+                VirtblkpSubmitRequest(Queue, Request, FALSE);
+                continue;
+            }
+        }
+
+        VirtblkpCompleteRequest(Queue, Request, STATUS_SUCCESS);
+    }
+
+    //
+    // Fill any free request slots with IRPs that were waiting.
+    //
+
+    VirtblkpBeginQueuedIrps(Queue);
+    KeReleaseSpinLock(&(Queue->Lock));
+    return;
+}
+
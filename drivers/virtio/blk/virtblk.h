@@ -0,0 +1,329 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    virtblk.h
+
+Abstract:
+
+    This header contains internal definitions for the virtio block device
+    driver.
+
+Author:
+
+    agent 16-Oct-2026
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <minoca/virtio/virtio.h>
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+#define VIRTBLK_ALLOCATION_TAG 0x6B6C4256 // 'klBV'
+
+//
+// Define the virtio block device feature bits.
+//
+
+#define VIRTIO_BLK_FEATURE_SIZE_MAX   (1ULL << 1)
+#define VIRTIO_BLK_FEATURE_SEG_MAX    (1ULL << 2)
+#define VIRTIO_BLK_FEATURE_READ_ONLY  (1ULL << 5)
+#define VIRTIO_BLK_FEATURE_BLOCK_SIZE (1ULL << 6)
+#define VIRTIO_BLK_FEATURE_FLUSH      (1ULL << 9)
+#define VIRTIO_BLK_FEATURE_MULTIQUEUE (1ULL << 12)
+
+#define VIRTBLK_FEATURES                \
+    (VIRTIO_BLK_FEATURE_SIZE_MAX |      \
+     VIRTIO_BLK_FEATURE_SEG_MAX |       \
+     VIRTIO_BLK_FEATURE_READ_ONLY |     \
+     VIRTIO_BLK_FEATURE_BLOCK_SIZE |    \
+     VIRTIO_BLK_FEATURE_FLUSH |         \
+     VIRTIO_BLK_FEATURE_MULTIQUEUE)
+
+//
+// Define the offsets of the fields in the device configuration region.
+//
+
+#define VIRTIO_BLK_CONFIG_CAPACITY    0
+#define VIRTIO_BLK_CONFIG_SIZE_MAX    8
+#define VIRTIO_BLK_CONFIG_SEG_MAX     12
+#define VIRTIO_BLK_CONFIG_BLOCK_SIZE  20
+#define VIRTIO_BLK_CONFIG_QUEUE_COUNT 34
+
+//
+// Define the request types.
+//
+
+#define VIRTIO_BLK_REQUEST_READ  0
+#define VIRTIO_BLK_REQUEST_WRITE 1
+#define VIRTIO_BLK_REQUEST_FLUSH 4
+
+//
+// Define the request status values written by the device.
+//
+
+#define VIRTIO_BLK_STATUS_OK          0
+#define VIRTIO_BLK_STATUS_IO_ERROR    1
+#define VIRTIO_BLK_STATUS_UNSUPPORTED 2
+
+//
+// Define the unit the device's capacity and request sectors are expressed in.
+//
+
+#define VIRTBLK_SECTOR_SIZE 512
+
+//
+// Define the maximum number of request queues used. Submissions are spread
+// across the queues by processor.
+//
+
+#define VIRTBLK_MAX_QUEUES 8
+
+//
+// Define the number of descriptors requested for each queue.
+//
+
+#define VIRTBLK_QUEUE_SIZE 256
+
+//
+// Define the maximum number of data segments in a single request. The header
+// and status byte take up two more descriptors.
+//
+
+#define VIRTBLK_MAX_SEGMENTS 30
+#define VIRTBLK_REQUEST_OVERHEAD_DESCRIPTORS 2
+
+//
+// Define the maximum number of requests outstanding on each queue. This is
+// also limited so that every request can always get its descriptors.
+//
+
+#define VIRTBLK_MAX_REQUESTS 32
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+typedef enum _VIRTBLK_CONTEXT_TYPE {
+    VirtblkContextInvalid,
+    VirtblkContextController,
+    VirtblkContextDisk
+} VIRTBLK_CONTEXT_TYPE, *PVIRTBLK_CONTEXT_TYPE;
+
+/*++
+
+Structure Description:
+
+    This structure defines the header at the start of every virtio block
+    request.
+
+Members:
+
+    Type - Stores the request type. See VIRTIO_BLK_REQUEST_* definitions.
+
+    Reserved - Stores a reserved value that must be zero.
+
+    Sector - Stores the starting sector of the request, in 512-byte units.
+
+--*/
+
+typedef struct _VIRTBLK_REQUEST_HEADER {
+    ULONG Type;
+    ULONG Reserved;
+    ULONGLONG Sector;
+} PACKED VIRTBLK_REQUEST_HEADER, *PVIRTBLK_REQUEST_HEADER;
+
+/*++
+
+Structure Description:
+
+    This structure defines the device visible portion of a request. These live
+    in a physically contiguous buffer per queue.
+
+Members:
+
+    Header - Stores the request header the device reads.
+
+    Status - Stores the status byte the device writes on completion.
+
+    Padding - Stores padding to keep the commands naturally aligned.
+
+--*/
+
+typedef struct _VIRTBLK_COMMAND {
+    VIRTBLK_REQUEST_HEADER Header;
+    UCHAR Status;
+    UCHAR Padding[15];
+} PACKED VIRTBLK_COMMAND, *PVIRTBLK_COMMAND;
+
+/*++
+
+Structure Description:
+
+    This structure defines the driver's tracking of an outstanding request.
+
+Members:
+
+    Irp - Stores a pointer to the IRP the request is servicing.
+
+    IoSize - Stores the number of bytes transferred by the current request.
+        This is zero for flush requests.
+
+    Command - Stores a pointer to the command the device sees.
+
+    CommandPhysical - Stores the physical address of the command.
+
+--*/
+
+typedef struct _VIRTBLK_REQUEST {
+    PIRP Irp;
+    UINTN IoSize;
+    PVIRTBLK_COMMAND Command;
+    PHYSICAL_ADDRESS CommandPhysical;
+} VIRTBLK_REQUEST, *PVIRTBLK_REQUEST;
+
+typedef struct _VIRTBLK_CONTROLLER VIRTBLK_CONTROLLER, *PVIRTBLK_CONTROLLER;
+
+/*++
+
+Structure Description:
+
+    This structure defines a virtio block request queue.
+
+Members:
+
+    Controller - Stores a pointer back to the controller.
+
+    Lock - Stores the spin lock serializing access to the queue. This is
+        acquired at dispatch level.
+
+    Queue - Stores a pointer to the virtio queue.
+
+    InterruptHandle - Stores the handle of the queue's own MSI-X interrupt,
+        or INVALID_HANDLE if the controller's shared interrupt is used.
+
+    IrpQueue - Stores the list of IRPs waiting for a free request.
+
+    FreeRequests - Stores a bitmask of the request slots that are free.
+
+    RequestCount - Stores the number of valid request slots.
+
+    CommandIoBuffer - Stores a pointer to the I/O buffer holding the commands.
+
+    Requests - Stores the request slots.
+
+--*/
+
+typedef struct _VIRTBLK_QUEUE {
+    PVIRTBLK_CONTROLLER Controller;
+    KSPIN_LOCK Lock;
+    PVIRTIO_QUEUE Queue;
+    HANDLE InterruptHandle;
+    LIST_ENTRY IrpQueue;
+    ULONG FreeRequests;
+    ULONG RequestCount;
+    PIO_BUFFER CommandIoBuffer;
+    VIRTBLK_REQUEST Requests[VIRTBLK_MAX_REQUESTS];
+} VIRTBLK_QUEUE, *PVIRTBLK_QUEUE;
+
+/*++
+
+Structure Description:
+
+    This structure defines the disk exposed by a virtio block device.
+
+Members:
+
+    Type - Stores the context type, which is always VirtblkContextDisk.
+
+    OsDevice - Stores a pointer to the OS device for the disk.
+
+    Controller - Stores a pointer to the controller that owns the disk.
+
+    BlockSize - Stores the disk's logical block size in bytes.
+
+    BlockCount - Stores the number of blocks on the disk.
+
+    ReadOnly - Stores a boolean indicating if the device rejects writes.
+
+--*/
+
+typedef struct _VIRTBLK_DISK {
+    VIRTBLK_CONTEXT_TYPE Type;
+    PDEVICE OsDevice;
+    PVIRTBLK_CONTROLLER Controller;
+    ULONG BlockSize;
+    ULONGLONG BlockCount;
+    BOOL ReadOnly;
+} VIRTBLK_DISK, *PVIRTBLK_DISK;
+
+/*++
+
+Structure Description:
+
+    This structure defines a virtio block controller, which is the PCI
+    function.
+
+Members:
+
+    Type - Stores the context type, which is always VirtblkContextController.
+
+    OsDevice - Stores a pointer to the OS device for the controller.
+
+    Virtio - Stores the virtio transport state.
+
+    InterruptHandle - Stores the connected interrupt handle when the legacy
+        interrupt line is shared by all the queues.
+
+    PendingInterrupts - Stores the interrupt status bits not yet processed by
+        the DPC.
+
+    Started - Stores a boolean indicating if the queues are set up.
+
+    MaxSegments - Stores the maximum number of data segments per request.
+
+    MaxSegmentSize - Stores the maximum size of a single data segment.
+
+    QueueCount - Stores the number of request queues in use.
+
+    Queues - Stores pointers to the request queues.
+
+    Disk - Stores the disk child.
+
+--*/
+
+struct _VIRTBLK_CONTROLLER {
+    VIRTBLK_CONTEXT_TYPE Type;
+    PDEVICE OsDevice;
+    VIRTIO_DEVICE Virtio;
+    HANDLE InterruptHandle;
+    volatile ULONG PendingInterrupts;
+    BOOL Started;
+    ULONG MaxSegments;
+    ULONG MaxSegmentSize;
+    ULONG QueueCount;
+    PVIRTBLK_QUEUE Queues[VIRTBLK_MAX_QUEUES];
+    VIRTBLK_DISK Disk;
+};
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// -------------------------------------------------------- Function Prototypes
+//
+
@@ -0,0 +1,40 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    Virtio
+
+Abstract:
+
+    This directory is responsible for building the virtio transport library
+    and the paravirtualized storage driver. The network driver lives with the
+    other Ethernet drivers.
+
+Author:
+
+    agent 16-Oct-2026
+
+Environment:
+
+    Kernel
+
+--*/
+
+function build() {
+    virtio_drivers = [
+        "//drivers/virtio/blk:virtblk",
+        "//drivers/virtio/core:virtio"
+    ];
+
+    entries = group("virtio_drivers", virtio_drivers);
+    return entries;
+}
+
+return build();
@@ -0,0 +1,2031 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    virtio.c
+
+Abstract:
+
+    This module implements the virtio PCI transport library. It discovers the
+    modern virtio register regions through the vendor specific PCI
+    capabilities, negotiates features, and manages split virtqueues on behalf
+    of the virtio device drivers.
+
+Author:
+
+    agent 16-Oct-2026
+
+Environment:
+
+    Kernel
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+//
+// This is the library itself, so define the API decorator as empty.
+//
+
+#define VIRTIO_API
+
+#include <minoca/kernel/driver.h>
+#include <minoca/virtio/virtio.h>
+
+//
+// --------------------------------------------------------------------- Macros
+//
+
+#define VIRTIO_COMMON_BASE(_Device) \
+    ((_Device)->Regions[VirtioRegionCommon].Base)
+
+#define VIRTIO_READ_COMMON8(_Device, _Register) \
+    HlReadRegister8(VIRTIO_COMMON_BASE(_Device) + (_Register))
+
+#define VIRTIO_WRITE_COMMON8(_Device, _Register, _Value) \
+    HlWriteRegister8(VIRTIO_COMMON_BASE(_Device) + (_Register), (_Value))
+
+#define VIRTIO_READ_COMMON16(_Device, _Register) \
+    HlReadRegister16(VIRTIO_COMMON_BASE(_Device) + (_Register))
+
+#define VIRTIO_WRITE_COMMON16(_Device, _Register, _Value) \
+    HlWriteRegister16(VIRTIO_COMMON_BASE(_Device) + (_Register), (_Value))
+
+#define VIRTIO_READ_COMMON32(_Device, _Register) \
+    HlReadRegister32(VIRTIO_COMMON_BASE(_Device) + (_Register))
+
+#define VIRTIO_WRITE_COMMON32(_Device, _Register, _Value) \
+    HlWriteRegister32(VIRTIO_COMMON_BASE(_Device) + (_Register), (_Value))
+
+//
+// This macro reads a field of a PCI capability structure.
+//
+
+#define VIRTIO_READ_CAPABILITY(_Device, _Capability, _Field, _Size) \
+    VirtiopReadPciConfig((_Device), (_Capability) + (_Field), (_Size))
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+//
+// Define the maximum number of capabilities walked before giving up on a
+// malformed capability list.
+//
+
+#define VIRTIO_MAX_CAPABILITY_COUNT 48
+
+//
+// Define how long to wait for a device reset to take effect, in microseconds.
+//
+
+#define VIRTIO_RESET_TIMEOUT 1000000
+#define VIRTIO_RESET_POLL_INTERVAL 1000
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+KSTATUS
+VirtiopMapRegions (
+    PVIRTIO_DEVICE Device,
+    PRESOURCE_ALLOCATION_LIST AllocationList
+    );
+
+KSTATUS
+VirtiopMapRegion (
+    PVIRTIO_DEVICE Device,
+    PRESOURCE_ALLOCATION_LIST AllocationList,
+    ULONG Bar,
+    ULONG Offset,
+    ULONG Length,
+    PVIRTIO_REGION_MAPPING Region
+    );
+
+VOID
+VirtiopUnmapRegions (
+    PVIRTIO_DEVICE Device
+    );
+
+ULONG
+VirtiopReadPciConfig (
+    PVIRTIO_DEVICE Device,
+    ULONG Offset,
+    ULONG Size
+    );
+
+VOID
+VirtiopSetStatus (
+    PVIRTIO_DEVICE Device,
+    UCHAR StatusBits
+    );
+
+KSTATUS
+VirtiopEnableMessageSignaledInterrupts (
+    PVIRTIO_DEVICE Device
+    );
+
+VOID
+VirtiopProcessPciConfigInterfaceChangeNotification (
+    PVOID Context,
+    PDEVICE Device,
+    PVOID InterfaceBuffer,
+    ULONG InterfaceBufferSize,
+    BOOL Arrival
+    );
+
+VOID
+VirtiopProcessPciMsiInterfaceChangeNotification (
+    PVOID Context,
+    PDEVICE Device,
+    PVOID InterfaceBuffer,
+    ULONG InterfaceBufferSize,
+    BOOL Arrival
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+UUID VirtioPciConfigurationInterfaceUuid = UUID_PCI_CONFIG_ACCESS;
+UUID VirtioPciMsiInterfaceUuid = UUID_PCI_MESSAGE_SIGNALED_INTERRUPTS;
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+KSTATUS
+DriverEntry (
+    PDRIVER Driver
+    )
+
+/*++
+
+Routine Description:
+
+    This routine implements the initial entry point of the virtio library,
+    called when the library is first loaded.
+
+Arguments:
+
+    Driver - Supplies a pointer to the driver object.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    DRIVER_FUNCTION_TABLE FunctionTable;
+    KSTATUS Status;
+
+    RtlZeroMemory(&FunctionTable, sizeof(DRIVER_FUNCTION_TABLE));
+    FunctionTable.Version = DRIVER_FUNCTION_TABLE_VERSION;
+    Status = IoRegisterDriverFunctions(Driver, &FunctionTable);
+    return Status;
+}
+
+VIRTIO_API
+VOID
+VirtioInitializeDevice (
+    PVIRTIO_DEVICE Device,
+    PDEVICE OsDevice
+    )
+
+/*++
+
+Routine Description:
+
+    This routine initializes the transport state of a virtio device. It should
+    be called when the driver is attached to the device.
+
+Arguments:
+
+    Device - Supplies a pointer to the virtio device to initialize.
+
+    OsDevice - Supplies a pointer to the OS device.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    RtlZeroMemory(Device, sizeof(VIRTIO_DEVICE));
+    Device->OsDevice = OsDevice;
+    Device->InterruptLine = INVALID_INTERRUPT_LINE;
+    Device->InterruptVector = INVALID_INTERRUPT_VECTOR;
+    return;
+}
+
+VIRTIO_API
+KSTATUS
+VirtioProcessResourceRequirements (
+    PVIRTIO_DEVICE Device,
+    PIRP Irp,
+    ULONG MinimumVectorCount,
+    ULONG MaximumVectorCount
+    )
+
+/*++
+
+Routine Description:
+
+    This routine filters through the resource requirements presented by the
+    bus for a virtio device. It registers for PCI configuration space and MSI
+    access. If the device supports MSI-X with enough table entries, it asks
+    for a block of message signaled interrupt vectors, with a vector for the
+    legacy interrupt line as the alternative. Otherwise it adds an interrupt
+    vector requirement for any interrupt line requested.
+
+Arguments:
+
+    Device - Supplies a pointer to the virtio device.
+
+    Irp - Supplies a pointer to the query resources I/O request packet.
+
+    MinimumVectorCount - Supplies the fewest MSI-X vectors the driver can make
+        use of. If the device has fewer, the legacy interrupt line is used.
+
+    MaximumVectorCount - Supplies the most MSI-X vectors the driver can make
+        use of. Supply zero to always use the legacy interrupt line.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    ULONGLONG EdgeTriggered;
+    ULONGLONG LineCharacteristics;
+    ULONGLONG MessageVectorCount;
+    PCI_MSI_INFORMATION MsiInformation;
+    PINTERFACE_PCI_MSI MsiInterface;
+    PRESOURCE_REQUIREMENT NextRequirement;
+    PRESOURCE_REQUIREMENT Requirement;
+    PRESOURCE_REQUIREMENT_LIST RequirementList;
+    PRESOURCE_CONFIGURATION_LIST Requirements;
+    KSTATUS Status;
+    ULONGLONG VectorCharacteristics;
+    PRESOURCE_REQUIREMENT VectorRequirement;
+    RESOURCE_REQUIREMENT VectorTemplate;
+
+    ASSERT((Irp->MajorCode == IrpMajorStateChange) &&
+           (Irp->MinorCode == IrpMinorQueryResources));
+
+    //
+    // Start listening for a PCI config interface, which is needed to find
+    // the virtio capabilities.
+    //
+
+    if (Device->RegisteredForPciConfigInterfaces == FALSE) {
+        Status = IoRegisterForInterfaceNotifications(
+                          &VirtioPciConfigurationInterfaceUuid,
+                          VirtiopProcessPciConfigInterfaceChangeNotification,
+                          Irp->Device,
+                          Device,
+                          TRUE);
+
+        if (!KSUCCESS(Status)) {
+            goto ProcessResourceRequirementsEnd;
+        }
+
+        Device->RegisteredForPciConfigInterfaces = TRUE;
+    }
+
+    //
+    // Also listen for the MSI interface. If it is ever going to be present,
+    // then it should have been registered immediately.
+    //
+
+    if (Device->RegisteredForPciMsiInterfaces == FALSE) {
+        Status = IoRegisterForInterfaceNotifications(
+                             &VirtioPciMsiInterfaceUuid,
+                             VirtiopProcessPciMsiInterfaceChangeNotification,
+                             Irp->Device,
+                             Device,
+                             TRUE);
+
+        if (!KSUCCESS(Status)) {
+            goto ProcessResourceRequirementsEnd;
+        }
+
+        Device->RegisteredForPciMsiInterfaces = TRUE;
+    }
+
+    //
+    // Initialize a nice interrupt vector requirement in preparation.
+    //
+
+    RtlZeroMemory(&VectorTemplate, sizeof(RESOURCE_REQUIREMENT));
+    VectorTemplate.Type = ResourceTypeInterruptVector;
+    VectorTemplate.Minimum = 0;
+    VectorTemplate.Maximum = -1;
+    VectorTemplate.Length = 1;
+
+    //
+    // Figure out how many MSI-X vectors the device's table can hold, and
+    // whether that is enough to be worth using.
+    //
+
+    MessageVectorCount = 0;
+    if ((MaximumVectorCount != 0) &&
+        (Device->PciMsiInterfaceAvailable != FALSE)) {
+
+        MsiInterface = &(Device->PciMsiInterface);
+        RtlZeroMemory(&MsiInformation, sizeof(PCI_MSI_INFORMATION));
+        MsiInformation.Version = PCI_MSI_INTERFACE_INFORMATION_VERSION;
+        MsiInformation.MsiType = PciMsiTypeExtended;
+        Status = MsiInterface->GetSetInformation(MsiInterface->DeviceToken,
+                                                 &MsiInformation,
+                                                 FALSE);
+
+        if (KSUCCESS(Status)) {
+            MessageVectorCount = MsiInformation.MaxVectorCount;
+            if (MessageVectorCount > MaximumVectorCount) {
+                MessageVectorCount = MaximumVectorCount;
+            }
+
+            if (MessageVectorCount < MinimumVectorCount) {
+                MessageVectorCount = 0;
+            }
+        }
+    }
+
+    //
+    // Without MSI-X, loop through all configuration lists, creating a vector
+    // for each line.
+    //
+
+    Requirements = Irp->U.QueryResources.ResourceRequirements;
+    if (MessageVectorCount == 0) {
+        Status = IoCreateAndAddInterruptVectorsForLines(Requirements,
+                                                        &VectorTemplate);
+
+        goto ProcessResourceRequirementsEnd;
+    }
+
+    //
+    // Ask for a contiguous block of vectors, one per MSI-X table entry, in
+    // every configuration.
+    //
+
+    RequirementList = IoGetNextResourceConfiguration(Requirements, NULL);
+    while (RequirementList != NULL) {
+        VectorTemplate.Characteristics = INTERRUPT_VECTOR_EDGE_TRIGGERED;
+        VectorTemplate.OwningRequirement = NULL;
+        VectorTemplate.Length = MessageVectorCount;
+        Status = IoCreateAndAddResourceRequirement(&VectorTemplate,
+                                                   RequirementList,
+                                                   &VectorRequirement);
+
+        if (!KSUCCESS(Status)) {
+            goto ProcessResourceRequirementsEnd;
+        }
+
+        //
+        // In case the block of vectors cannot be had, prepare to fall back to
+        // the legacy interrupt line by adding an alternative vector for each
+        // line in the requirement list.
+        //
+
+        VectorTemplate.Length = 1;
+        Requirement = IoGetNextResourceRequirement(RequirementList, NULL);
+        while (Requirement != NULL) {
+            NextRequirement = IoGetNextResourceRequirement(RequirementList,
+                                                           Requirement);
+
+            if (Requirement->Type != ResourceTypeInterruptLine) {
+                Requirement = NextRequirement;
+                continue;
+            }
+
+            VectorCharacteristics = 0;
+            LineCharacteristics = Requirement->Characteristics;
+            if ((LineCharacteristics & INTERRUPT_LINE_ACTIVE_LOW) != 0) {
+                VectorCharacteristics |= INTERRUPT_VECTOR_ACTIVE_LOW;
+            }
+
+            if ((LineCharacteristics & INTERRUPT_LINE_ACTIVE_HIGH) != 0) {
+                VectorCharacteristics |= INTERRUPT_VECTOR_ACTIVE_HIGH;
+            }
+
+            EdgeTriggered = LineCharacteristics & INTERRUPT_LINE_EDGE_TRIGGERED;
+            if (EdgeTriggered != 0) {
+                VectorCharacteristics |= INTERRUPT_VECTOR_EDGE_TRIGGERED;
+            }
+
+            VectorTemplate.Characteristics = VectorCharacteristics;
+            VectorTemplate.OwningRequirement = Requirement;
+            Status = IoCreateAndAddResourceRequirementAlternative(
+                                                            &VectorTemplate,
+                                                            VectorRequirement);
+
+            if (!KSUCCESS(Status)) {
+                goto ProcessResourceRequirementsEnd;
+            }
+
+            Requirement = NextRequirement;
+        }
+
+        RequirementList = IoGetNextResourceConfiguration(Requirements,
+                                                         RequirementList);
+    }
+
+    Status = STATUS_SUCCESS;
+
+ProcessResourceRequirementsEnd:
+    return Status;
+}
+
+VIRTIO_API
+KSTATUS
+VirtioStartDevice (
+    PVIRTIO_DEVICE Device,
+    PIRP Irp
+    )
+
+/*++
+
+Routine Description:
+
+    This routine starts a virtio device. It finds the interrupt resources,
+    maps the register regions described by the PCI capabilities, resets the
+    device, and acknowledges it. If MSI-X vectors were allocated, they are
+    programmed into the device's MSI-X table and MSI-X is enabled.
+
+Arguments:
+
+    Device - Supplies a pointer to the virtio device.
+
+    Irp - Supplies a pointer to the start device I/O request packet.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    PRESOURCE_ALLOCATION Allocation;
+    PRESOURCE_ALLOCATION_LIST AllocationList;
+    PRESOURCE_ALLOCATION LineAllocation;
+    KSTATUS Status;
+
+    //
+    // Loop through the allocated resources to get the interrupt.
+    //
+
+    Device->MessageVectorCount = 0;
+    AllocationList = Irp->U.StartDevice.ProcessorLocalResources;
+    Allocation = IoGetNextResourceAllocation(AllocationList, NULL);
+    while (Allocation != NULL) {
+
+        //
+        // If the resource is an interrupt vector, the presence of an owning
+        // interrupt line allocation dictates whether MSI-X or the legacy
+        // interrupt is used.
+        //
+
+        if (Allocation->Type == ResourceTypeInterruptVector) {
+
+            //
+            // Currently only one interrupt resource is expected.
+            //
+
+            ASSERT((Device->InterruptResourcesFound == FALSE) ||
+                   (Device->InterruptVector == Allocation->Allocation));
+
+            LineAllocation = Allocation->OwningAllocation;
+            if (LineAllocation == NULL) {
+
+                ASSERT(Allocation->Characteristics ==
+                       INTERRUPT_VECTOR_EDGE_TRIGGERED);
+
+                Device->InterruptLine = INVALID_INTERRUPT_LINE;
+                Device->MessageVectorCount = Allocation->Length;
+
+            } else {
+                Device->InterruptLine = LineAllocation->Allocation;
+                Device->MessageVectorCount = 0;
+            }
+
+            Device->InterruptVector = Allocation->Allocation;
+            Device->InterruptResourcesFound = TRUE;
+        }
+
+        //
+        // Get the next allocation in the list.
+        //
+
+        Allocation = IoGetNextResourceAllocation(AllocationList, Allocation);
+    }
+
+    if (Device->InterruptResourcesFound == FALSE) {
+        Status = STATUS_INVALID_CONFIGURATION;
+        goto StartDeviceEnd;
+    }
+
+    //
+    // The capabilities can only be found through PCI configuration space.
+    //
+
+    if (Device->PciConfigInterfaceAvailable == FALSE) {
+        Status = STATUS_NOT_CONFIGURED;
+        goto StartDeviceEnd;
+    }
+
+    if (VIRTIO_COMMON_BASE(Device) == NULL) {
+        Status = VirtiopMapRegions(Device, AllocationList);
+        if (!KSUCCESS(Status)) {
+            goto StartDeviceEnd;
+        }
+    }
+
+    //
+    // Reset the device, and then tell it that a driver has found it.
+    //
+
+    VirtioResetDevice(Device);
+    VirtiopSetStatus(Device, VIRTIO_STATUS_ACKNOWLEDGE);
+    VirtiopSetStatus(Device, VIRTIO_STATUS_DRIVER);
+    Device->QueueCount = VIRTIO_READ_COMMON16(Device, VirtioCommonQueueCount);
+
+    //
+    // The device cannot interrupt until the driver sets it ready, so it is
+    // safe to turn on MSI-X before the driver connects its interrupts.
+    //
+
+    if (Device->MessageVectorCount != 0) {
+        Status = VirtiopEnableMessageSignaledInterrupts(Device);
+        if (!KSUCCESS(Status)) {
+            goto StartDeviceEnd;
+        }
+    }
+
+    Status = STATUS_SUCCESS;
+
+StartDeviceEnd:
+    return Status;
+}
+
+VIRTIO_API
+KSTATUS
+VirtioNegotiateFeatures (
+    PVIRTIO_DEVICE Device,
+    ULONGLONG DriverFeatures
+    )
+
+/*++
+
+Routine Description:
+
+    This routine negotiates the feature bits with the device. The negotiated
+    set is stored in the device structure.
+
+Arguments:
+
+    Device - Supplies a pointer to the virtio device.
+
+    DriverFeatures - Supplies the set of features the driver supports. The
+        version 1 feature is always requested.
+
+Return Value:
+
+    STATUS_SUCCESS if the device accepted the features.
+
+    STATUS_NOT_SUPPORTED if the device does not support the modern interface
+    or rejected the feature set.
+
+--*/
+
+{
+
+    ULONGLONG DeviceFeatures;
+    ULONGLONG Features;
+    ULONG High;
+    ULONG Low;
+    UCHAR Status;
+
+    VIRTIO_WRITE_COMMON32(Device, VirtioCommonDeviceFeatureSelect, 0);
+    Low = VIRTIO_READ_COMMON32(Device, VirtioCommonDeviceFeature);
+    VIRTIO_WRITE_COMMON32(Device, VirtioCommonDeviceFeatureSelect, 1);
+    High = VIRTIO_READ_COMMON32(Device, VirtioCommonDeviceFeature);
+    DeviceFeatures = ((ULONGLONG)High << 32) | Low;
+    if ((DeviceFeatures & VIRTIO_FEATURE_VERSION_1) == 0) {
+        VirtiopSetStatus(Device, VIRTIO_STATUS_FAILED);
+        return STATUS_NOT_SUPPORTED;
+    }
+
+    Features = DeviceFeatures & (DriverFeatures | VIRTIO_FEATURE_VERSION_1);
+    VIRTIO_WRITE_COMMON32(Device, VirtioCommonDriverFeatureSelect, 0);
+    VIRTIO_WRITE_COMMON32(Device, VirtioCommonDriverFeature, (ULONG)Features);
+    VIRTIO_WRITE_COMMON32(Device, VirtioCommonDriverFeatureSelect, 1);
+    VIRTIO_WRITE_COMMON32(Device,
+                          VirtioCommonDriverFeature,
+                          (ULONG)(Features >> 32));
+
+    //
+    // The device gets a chance to reject the subset by not accepting the
+    // features OK bit.
+    //
+
+    VirtiopSetStatus(Device, VIRTIO_STATUS_FEATURES_OK);
+    Status = VIRTIO_READ_COMMON8(Device, VirtioCommonDeviceStatus);
+    if ((Status & VIRTIO_STATUS_FEATURES_OK) == 0) {
+        VirtiopSetStatus(Device, VIRTIO_STATUS_FAILED);
+        return STATUS_NOT_SUPPORTED;
+    }
+
+    Device->Features = Features;
+    return STATUS_SUCCESS;
+}
+
+VIRTIO_API
+VOID
+VirtioSetDriverReady (
+    PVIRTIO_DEVICE Device
+    )
+
+/*++
+
+Routine Description:
+
+    This routine tells the device that the driver has finished setting it up
+    and is ready to drive it.
+
+Arguments:
+
+    Device - Supplies a pointer to the virtio device.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    VirtiopSetStatus(Device, VIRTIO_STATUS_DRIVER_OK);
+    return;
+}
+
+VIRTIO_API
+VOID
+VirtioResetDevice (
+    PVIRTIO_DEVICE Device
+    )
+
+/*++
+
+Routine Description:
+
+    This routine resets a virtio device, stopping all queue activity.
+
+Arguments:
+
+    Device - Supplies a pointer to the virtio device.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG Waited;
+
+    if (VIRTIO_COMMON_BASE(Device) == NULL) {
+        return;
+    }
+
+    //
+    // Writing zero resets the device. The reset is not complete until the
+    // status reads back as zero.
+    //
+
+    VIRTIO_WRITE_COMMON8(Device, VirtioCommonDeviceStatus, 0);
+    Waited = 0;
+    while ((VIRTIO_READ_COMMON8(Device, VirtioCommonDeviceStatus) != 0) &&
+           (Waited < VIRTIO_RESET_TIMEOUT)) {
+
+        HlBusySpin(VIRTIO_RESET_POLL_INTERVAL);
+        Waited += VIRTIO_RESET_POLL_INTERVAL;
+    }
+
+    Device->Features = 0;
+    return;
+}
+
+VIRTIO_API
+VOID
+VirtioReadDeviceConfiguration (
+    PVIRTIO_DEVICE Device,
+    ULONG Offset,
+    PVOID Buffer,
+    ULONG Size
+    )
+
+/*++
+
+Routine Description:
+
+    This routine reads from the device specific configuration region,
+    retrying until a consistent snapshot is read.
+
+Arguments:
+
+    Device - Supplies a pointer to the virtio device.
+
+    Offset - Supplies the byte offset into the device configuration to read.
+
+    Buffer - Supplies a pointer where the configuration data will be returned.
+
+    Size - Supplies the number of bytes to read.
+
+Return Value:
+
+    None. The buffer is zeroed if the region is not large enough.
+
+--*/
+
+{
+
+    PVOID Address;
+    ULONG ByteIndex;
+    UCHAR Generation;
+    PVIRTIO_REGION_MAPPING Region;
+
+    Region = &(Device->Regions[VirtioRegionDevice]);
+    if ((Region->Base == NULL) ||
+        (Offset + Size < Offset) ||
+        (Offset + Size > Region->Length)) {
+
+        RtlZeroMemory(Buffer, Size);
+        return;
+    }
+
+    //
+    // Fields are read with accesses that match their size. The generation
+    // count changes if the device updated the configuration during the read,
+    // in which case the read must be retried.
+    //
+
+    Address = Region->Base + Offset;
+    do {
+        Generation = VIRTIO_READ_COMMON8(Device, VirtioCommonConfigGeneration);
+        switch (Size) {
+        case sizeof(UCHAR):
+            *((PUCHAR)Buffer) = HlReadRegister8(Address);
+            break;
+
+        case sizeof(USHORT):
+            *((PUSHORT)Buffer) = HlReadRegister16(Address);
+            break;
+
+        case sizeof(ULONG):
+            *((PULONG)Buffer) = HlReadRegister32(Address);
+            break;
+
+        case sizeof(ULONGLONG):
+            ((PULONG)Buffer)[0] = HlReadRegister32(Address);
+            ((PULONG)Buffer)[1] = HlReadRegister32(Address + sizeof(ULONG));
+            break;
+
+        default:
+            for (ByteIndex = 0; ByteIndex < Size; ByteIndex += 1) {
+                ((PUCHAR)Buffer)[ByteIndex] =
+                                        HlReadRegister8(Address + ByteIndex);
+            }
+
+            break;
+        }
+
+    } while (Generation !=
+             VIRTIO_READ_COMMON8(Device, VirtioCommonConfigGeneration));
+
+    return;
+}
+
+VIRTIO_API
+ULONG
+VirtioReadInterruptStatus (
+    PVIRTIO_DEVICE Device
+    )
+
+/*++
+
+Routine Description:
+
+    This routine reads and acknowledges the device's interrupt status. It is
+    safe to call from an interrupt service routine.
+
+Arguments:
+
+    Device - Supplies a pointer to the virtio device.
+
+Return Value:
+
+    Returns the interrupt status bits. See VIRTIO_ISR_* definitions.
+
+--*/
+
+{
+
+    PVOID Base;
+
+    Base = Device->Regions[VirtioRegionIsr].Base;
+    if (Base == NULL) {
+        return 0;
+    }
+
+    //
+    // Reading the register clears it and deasserts the interrupt line.
+    //
+
+    return HlReadRegister8(Base);
+}
+
+VIRTIO_API
+KSTATUS
+VirtioCreateQueue (
+    PVIRTIO_DEVICE Device,
+    USHORT Index,
+    USHORT MaxSize,
+    USHORT MessageVector,
+    PVIRTIO_QUEUE *NewQueue
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates and enables a virtio queue. It must be called after
+    features are negotiated and before the driver is marked ready.
+
+Arguments:
+
+    Device - Supplies a pointer to the virtio device.
+
+    Index - Supplies the index of the queue to create.
+
+    MaxSize - Supplies the maximum number of descriptors the caller wants in
+        the queue. The queue may be smaller if the device supports fewer.
+
+    MessageVector - Supplies the index of the MSI-X vector the queue should
+        interrupt on, or VIRTIO_MSI_NO_VECTOR for none. This is ignored if
+        the device is using its legacy interrupt line.
+
+    NewQueue - Supplies a pointer where a pointer to the new queue will be
+        returned on success.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    UINTN AllocationSize;
+    UINTN AvailableOffset;
+    PVOID Buffer;
+    USHORT DescriptorIndex;
+    ULONG NotifyOffset;
+    PHYSICAL_ADDRESS PhysicalAddress;
+    PVIRTIO_QUEUE Queue;
+    USHORT Size;
+    KSTATUS Status;
+    UINTN TotalSize;
+    UINTN UsedOffset;
+
+    Queue = NULL;
+    if ((Index >= Device->QueueCount) || (MaxSize == 0)) {
+        Status = STATUS_INVALID_PARAMETER;
+        goto CreateQueueEnd;
+    }
+
+    if (Device->MessageVectorCount == 0) {
+        MessageVector = VIRTIO_MSI_NO_VECTOR;
+
+    } else if ((MessageVector != VIRTIO_MSI_NO_VECTOR) &&
+               (MessageVector >= Device->MessageVectorCount)) {
+
+        Status = STATUS_INVALID_PARAMETER;
+        goto CreateQueueEnd;
+    }
+
+    VIRTIO_WRITE_COMMON16(Device, VirtioCommonQueueSelect, Index);
+    Size = VIRTIO_READ_COMMON16(Device, VirtioCommonQueueSize);
+    if ((Size == 0) || (POWER_OF_2(Size) == FALSE)) {
+        Status = STATUS_INVALID_CONFIGURATION;
+        goto CreateQueueEnd;
+    }
+
+    //
+    // The driver may shrink the queue, but split queues must stay a power of
+    // two in size.
+    //
+
+    while ((Size > MaxSize) || (Size > VIRTIO_MAX_QUEUE_SIZE)) {
+        Size >>= 1;
+    }
+
+    AllocationSize = sizeof(VIRTIO_QUEUE) + (Size * sizeof(PVOID));
+    Queue = MmAllocateNonPagedPool(AllocationSize, VIRTIO_ALLOCATION_TAG);
+    if (Queue == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto CreateQueueEnd;
+    }
+
+    RtlZeroMemory(Queue, AllocationSize);
+    Queue->Device = Device;
+    Queue->Index = Index;
+    Queue->Size = Size;
+    Queue->Cookies = (PVOID *)(Queue + 1);
+
+    //
+    // Lay the descriptor table, available ring (plus the used event field),
+    // and used ring (plus the available event field) out in one physically
+    // contiguous buffer.
+    //
+
+    AvailableOffset = sizeof(VIRTIO_DESCRIPTOR) * Size;
+    UsedOffset = AvailableOffset + (sizeof(USHORT) * (3 + Size));
+    UsedOffset = ALIGN_RANGE_UP(UsedOffset, VIRTIO_USED_ALIGNMENT);
+    TotalSize = UsedOffset + (sizeof(USHORT) * 3) +
+                (sizeof(VIRTIO_USED_ELEMENT) * Size);
+
+    Queue->IoBuffer = MmAllocateNonPagedIoBuffer(
+                                          0,
+                                          MAX_ULONGLONG,
+                                          VIRTIO_DESCRIPTOR_ALIGNMENT,
+                                          TotalSize,
+                                          IO_BUFFER_FLAG_PHYSICALLY_CONTIGUOUS);
+
+    if (Queue->IoBuffer == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto CreateQueueEnd;
+    }
+
+    ASSERT(Queue->IoBuffer->FragmentCount == 1);
+
+    Buffer = Queue->IoBuffer->Fragment[0].VirtualAddress;
+    RtlZeroMemory(Buffer, TotalSize);
+    Queue->Descriptors = Buffer;
+    Queue->Available = Buffer + AvailableOffset;
+    Queue->Used = Buffer + UsedOffset;
+
+    //
+    // Chain all the descriptors onto the free list.
+    //
+
+    for (DescriptorIndex = 0; DescriptorIndex < Size; DescriptorIndex += 1) {
+        Queue->Descriptors[DescriptorIndex].Next = DescriptorIndex + 1;
+    }
+
+    Queue->FreeHead = 0;
+    Queue->FreeCount = Size;
+
+    //
+    // Find the notify register for this queue.
+    //
+
+    NotifyOffset = VIRTIO_READ_COMMON16(Device, VirtioCommonQueueNotifyOffset);
+    NotifyOffset *= Device->NotifyOffsetMultiplier;
+    if (NotifyOffset + sizeof(USHORT) >
+        Device->Regions[VirtioRegionNotify].Length) {
+
+        Status = STATUS_INVALID_CONFIGURATION;
+        goto CreateQueueEnd;
+    }
+
+    Queue->NotifyAddress = Device->Regions[VirtioRegionNotify].Base +
+                           NotifyOffset;
+
+    //
+    // Program the queue and enable it.
+    //
+
+    PhysicalAddress = Queue->IoBuffer->Fragment[0].PhysicalAddress;
+    VIRTIO_WRITE_COMMON16(Device, VirtioCommonQueueSize, Size);
+
+    //
+    // The device reports a failure to map the vector by reading back the
+    // no vector value.
+    //
+
+    VIRTIO_WRITE_COMMON16(Device, VirtioCommonQueueMsixVector, MessageVector);
+    if ((MessageVector != VIRTIO_MSI_NO_VECTOR) &&
+        (VIRTIO_READ_COMMON16(Device, VirtioCommonQueueMsixVector) !=
+         MessageVector)) {
+
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto CreateQueueEnd;
+    }
+
+    VIRTIO_WRITE_COMMON32(Device,
+                          VirtioCommonQueueDescriptorLow,
+                          (ULONG)PhysicalAddress);
+
+    VIRTIO_WRITE_COMMON32(Device,
+                          VirtioCommonQueueDescriptorHigh,
+                          (ULONG)(PhysicalAddress >> 32));
+
+    PhysicalAddress += AvailableOffset;
+    VIRTIO_WRITE_COMMON32(Device,
+                          VirtioCommonQueueAvailableLow,
+                          (ULONG)PhysicalAddress);
+
+    VIRTIO_WRITE_COMMON32(Device,
+                          VirtioCommonQueueAvailableHigh,
+                          (ULONG)(PhysicalAddress >> 32));
+
+    PhysicalAddress += UsedOffset - AvailableOffset;
+    VIRTIO_WRITE_COMMON32(Device,
+                          VirtioCommonQueueUsedLow,
+                          (ULONG)PhysicalAddress);
+
+    VIRTIO_WRITE_COMMON32(Device,
+                          VirtioCommonQueueUsedHigh,
+                          (ULONG)(PhysicalAddress >> 32));
+
+    VIRTIO_WRITE_COMMON16(Device, VirtioCommonQueueEnable, 1);
+    Status = STATUS_SUCCESS;
+
+CreateQueueEnd:
+    if (!KSUCCESS(Status)) {
+        if (Queue != NULL) {
+            VirtioDestroyQueue(Queue);
+            Queue = NULL;
+        }
+    }
+
+    *NewQueue = Queue;
+    return Status;
+}
+
+VIRTIO_API
+KSTATUS
+VirtioSetConfigurationVector (
+    PVIRTIO_DEVICE Device,
+    USHORT MessageVector
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sets the MSI-X vector the device interrupts on when its
+    configuration changes. It does nothing if the device is using its legacy
+    interrupt line.
+
+Arguments:
+
+    Device - Supplies a pointer to the virtio device.
+
+    MessageVector - Supplies the index of the MSI-X vector to use, or
+        VIRTIO_MSI_NO_VECTOR for none.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_INSUFFICIENT_RESOURCES if the device could not map the vector.
+
+--*/
+
+{
+
+    if (Device->MessageVectorCount == 0) {
+        return STATUS_SUCCESS;
+    }
+
+    if ((MessageVector != VIRTIO_MSI_NO_VECTOR) &&
+        (MessageVector >= Device->MessageVectorCount)) {
+
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    VIRTIO_WRITE_COMMON16(Device, VirtioCommonMsixConfiguration, MessageVector);
+    if ((MessageVector != VIRTIO_MSI_NO_VECTOR) &&
+        (VIRTIO_READ_COMMON16(Device, VirtioCommonMsixConfiguration) !=
+         MessageVector)) {
+
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    return STATUS_SUCCESS;
+}
+
+VIRTIO_API
+VOID
+VirtioDestroyQueue (
+    PVIRTIO_QUEUE Queue
+    )
+
+/*++
+
+Routine Description:
+
+    This routine destroys a virtio queue. The device must be reset before the
+    queue is destroyed.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue to destroy.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    if (Queue->IoBuffer != NULL) {
+        MmFreeIoBuffer(Queue->IoBuffer);
+    }
+
+    MmFreeNonPagedPool(Queue);
+    return;
+}
+
+VIRTIO_API
+KSTATUS
+VirtioQueueAddBuffers (
+    PVIRTIO_QUEUE Queue,
+    PVIRTIO_BUFFER Buffers,
+    ULONG OutCount,
+    ULONG InCount,
+    PVOID Cookie
+    )
+
+/*++
+
+Routine Description:
+
+    This routine adds a chain of buffers to a virtio queue. The device is not
+    notified until the caller calls the notify routine.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+    Buffers - Supplies an array of buffers. The device reads from the first
+        out count buffers and writes to the in count buffers following them.
+
+    OutCount - Supplies the number of device readable buffers.
+
+    InCount - Supplies the number of device writable buffers.
+
+    Cookie - Supplies a context pointer returned when the chain is used.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_RESOURCE_IN_USE if there are not enough free descriptors.
+
+--*/
+
+{
+
+    ULONG BufferIndex;
+    ULONG Count;
+    PVIRTIO_DESCRIPTOR Descriptor;
+    USHORT DescriptorIndex;
+    USHORT Head;
+
+    Count = OutCount + InCount;
+
+    ASSERT(Count != 0);
+
+    if (Count > Queue->FreeCount) {
+        return STATUS_RESOURCE_IN_USE;
+    }
+
+    //
+    // Pull descriptors off the free list in order. The free list links are
+    // already the chain links, so only the last descriptor's link is left
+    // pointing at the rest of the free list.
+    //
+
+    Head = Queue->FreeHead;
+    DescriptorIndex = Head;
+    for (BufferIndex = 0; BufferIndex < Count; BufferIndex += 1) {
+        Descriptor = &(Queue->Descriptors[DescriptorIndex]);
+        Descriptor->Address = Buffers[BufferIndex].Address;
+        Descriptor->Length = Buffers[BufferIndex].Length;
+        Descriptor->Flags = 0;
+        if (BufferIndex >= OutCount) {
+            Descriptor->Flags |= VIRTIO_DESCRIPTOR_WRITE;
+        }
+
+        if (BufferIndex + 1 < Count) {
+            Descriptor->Flags |= VIRTIO_DESCRIPTOR_NEXT;
+        }
+
+        DescriptorIndex = Descriptor->Next;
+    }
+
+    Queue->FreeHead = DescriptorIndex;
+    Queue->FreeCount -= Count;
+    Queue->Cookies[Head] = Cookie;
+
+    //
+    // Publish the chain. The descriptors must be visible before the index.
+    //
+
+    Queue->Available->Ring[Queue->AvailableIndex & (Queue->Size - 1)] = Head;
+    Queue->AvailableIndex += 1;
+    RtlMemoryBarrier();
+    Queue->Available->Index = Queue->AvailableIndex;
+    return STATUS_SUCCESS;
+}
+
+VIRTIO_API
+VOID
+VirtioQueueNotify (
+    PVIRTIO_QUEUE Queue
+    )
+
+/*++
+
+Routine Description:
+
+    This routine notifies the device that new buffers are available in the
+    queue, unless the device has asked not to be notified.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    RtlMemoryBarrier();
+    if ((Queue->Used->Flags & VIRTIO_USED_NO_NOTIFY) == 0) {
+        HlWriteRegister16(Queue->NotifyAddress, Queue->Index);
+    }
+
+    return;
+}
+
+VIRTIO_API
+BOOL
+VirtioQueueGetUsedBuffer (
+    PVIRTIO_QUEUE Queue,
+    PVOID *Cookie,
+    PULONG Length
+    )
+
+/*++
+
+Routine Description:
+
+    This routine removes the next completed buffer chain from the queue and
+    frees its descriptors.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+    Cookie - Supplies a pointer where the cookie given when the chain was
+        added will be returned.
+
+    Length - Supplies a pointer where the number of bytes the device wrote to
+        the chain will be returned.
+
+Return Value:
+
+    TRUE if a used buffer was returned.
+
+    FALSE if the device has not completed any more buffers.
+
+--*/
+
+{
+
+    USHORT Count;
+    USHORT DescriptorIndex;
+    volatile VIRTIO_USED_ELEMENT *Element;
+    USHORT Head;
+
+    if (Queue->LastUsedIndex == Queue->Used->Index) {
+        return FALSE;
+    }
+
+    //
+    // Make sure the element is not read before the index that covers it.
+    //
+
+    RtlMemoryBarrier();
+    Element = &(Queue->Used->Ring[Queue->LastUsedIndex & (Queue->Size - 1)]);
+    Head = Element->Id;
+    *Length = Element->Length;
+    Queue->LastUsedIndex += 1;
+
+    ASSERT(Head < Queue->Size);
+
+    *Cookie = Queue->Cookies[Head];
+    Queue->Cookies[Head] = NULL;
+
+    //
+    // Put the chain back at the head of the free list.
+    //
+
+    Count = 1;
+    DescriptorIndex = Head;
+    while ((Queue->Descriptors[DescriptorIndex].Flags &
+            VIRTIO_DESCRIPTOR_NEXT) != 0) {
+
+        DescriptorIndex = Queue->Descriptors[DescriptorIndex].Next;
+        Count += 1;
+    }
+
+    Queue->Descriptors[DescriptorIndex].Next = Queue->FreeHead;
+    Queue->FreeHead = Head;
+    Queue->FreeCount += Count;
+    return TRUE;
+}
+
+VIRTIO_API
+VOID
+VirtioQueueDisableInterrupts (
+    PVIRTIO_QUEUE Queue
+    )
+
+/*++
+
+Routine Description:
+
+    This routine asks the device not to interrupt when it uses buffers from
+    the given queue. This is only a hint to the device.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    Queue->Available->Flags |= VIRTIO_AVAILABLE_NO_INTERRUPT;
+    return;
+}
+
+VIRTIO_API
+BOOL
+VirtioQueueEnableInterrupts (
+    PVIRTIO_QUEUE Queue
+    )
+
+/*++
+
+Routine Description:
+
+    This routine asks the device to interrupt when it uses buffers from the
+    given queue.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+Return Value:
+
+    TRUE if the device used more buffers before interrupts were enabled, in
+    which case the caller should process them since no interrupt may come.
+
+    FALSE if there is no pending work.
+
+--*/
+
+{
+
+    Queue->Available->Flags &= ~VIRTIO_AVAILABLE_NO_INTERRUPT;
+    RtlMemoryBarrier();
+    if (Queue->LastUsedIndex != Queue->Used->Index) {
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+KSTATUS
+VirtiopMapRegions (
+    PVIRTIO_DEVICE Device,
+    PRESOURCE_ALLOCATION_LIST AllocationList
+    )
+
+/*++
+
+Routine Description:
+
+    This routine walks the PCI capability list looking for the virtio vendor
+    capabilities, and maps each register region they describe.
+
+Arguments:
+
+    Device - Supplies a pointer to the virtio device.
+
+    AllocationList - Supplies a pointer to the device's resource allocations.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    ULONG Bar;
+    ULONG CapabilityCount;
+    ULONG CapabilityId;
+    ULONG Length;
+    ULONG Offset;
+    ULONG Pointer;
+    PVIRTIO_REGION_MAPPING Region;
+    ULONG RegionType;
+    KSTATUS Status;
+
+    Status = STATUS_SUCCESS;
+    if ((VirtiopReadPciConfig(Device, VIRTIO_PCI_STATUS_OFFSET, 2) &
+         VIRTIO_PCI_STATUS_CAPABILITIES_LIST) == 0) {
+
+        Status = STATUS_NOT_SUPPORTED;
+        goto MapRegionsEnd;
+    }
+
+    Pointer = VirtiopReadPciConfig(Device,
+                                   VIRTIO_PCI_CAPABILITIES_POINTER_OFFSET,
+                                   1);
+
+    Pointer &= VIRTIO_PCI_CAPABILITY_POINTER_MASK;
+    CapabilityCount = 0;
+    while ((Pointer != 0) && (CapabilityCount < VIRTIO_MAX_CAPABILITY_COUNT)) {
+        CapabilityCount += 1;
+        CapabilityId = VIRTIO_READ_CAPABILITY(Device,
+                                              Pointer,
+                                              VIRTIO_PCI_CAPABILITY_ID_OFFSET,
+                                              1);
+
+        if (CapabilityId != VIRTIO_PCI_CAPABILITY_VENDOR_SPECIFIC) {
+            goto NextCapability;
+        }
+
+        RegionType = VIRTIO_READ_CAPABILITY(Device,
+                                            Pointer,
+                                            VIRTIO_PCI_CAPABILITY_TYPE_OFFSET,
+                                            1);
+
+        if ((RegionType < VIRTIO_PCI_CAPABILITY_COMMON_CONFIGURATION) ||
+            (RegionType > VIRTIO_PCI_CAPABILITY_DEVICE_CONFIGURATION)) {
+
+            goto NextCapability;
+        }
+
+        //
+        // Use the first capability of each type that can be mapped.
+        //
+
+        Region = &(Device->Regions[RegionType - 1]);
+        if (Region->Base != NULL) {
+            goto NextCapability;
+        }
+
+        Bar = VIRTIO_READ_CAPABILITY(Device,
+                                     Pointer,
+                                     VIRTIO_PCI_CAPABILITY_BAR_OFFSET,
+                                     1);
+
+        Offset = VIRTIO_READ_CAPABILITY(Device,
+                                        Pointer,
+                                        VIRTIO_PCI_CAPABILITY_REGION_OFFSET,
+                                        4);
+
+        Length = VIRTIO_READ_CAPABILITY(Device,
+                                        Pointer,
+                                        VIRTIO_PCI_CAPABILITY_LENGTH_OFFSET,
+                                        4);
+
+        Status = VirtiopMapRegion(Device,
+                                  AllocationList,
+                                  Bar,
+                                  Offset,
+                                  Length,
+                                  Region);
+
+        if (Status == STATUS_NO_MEMORY) {
+            goto MapRegionsEnd;
+        }
+
+        if ((KSUCCESS(Status)) &&
+            (RegionType == VIRTIO_PCI_CAPABILITY_NOTIFY_CONFIGURATION)) {
+
+            Device->NotifyOffsetMultiplier = VIRTIO_READ_CAPABILITY(
+                                 Device,
+                                 Pointer,
+                                 VIRTIO_PCI_CAPABILITY_NOTIFY_MULTIPLIER_OFFSET,
+                                 4);
+        }
+
+NextCapability:
+        Pointer = VIRTIO_READ_CAPABILITY(Device,
+                                         Pointer,
+                                         VIRTIO_PCI_CAPABILITY_NEXT_OFFSET,
+                                         1);
+
+        Pointer &= VIRTIO_PCI_CAPABILITY_POINTER_MASK;
+    }
+
+    //
+    // Legacy-only devices do not have the modern capabilities, and are not
+    // supported.
+    //
+
+    if ((Device->Regions[VirtioRegionCommon].Base == NULL) ||
+        (Device->Regions[VirtioRegionNotify].Base == NULL) ||
+        (Device->Regions[VirtioRegionIsr].Base == NULL)) {
+
+        RtlDebugPrint("Virtio: Device has no modern PCI capabilities.\n");
+        Status = STATUS_NOT_SUPPORTED;
+        goto MapRegionsEnd;
+    }
+
+    Status = STATUS_SUCCESS;
+
+MapRegionsEnd:
+    if (!KSUCCESS(Status)) {
+        VirtiopUnmapRegions(Device);
+    }
+
+    return Status;
+}
+
+KSTATUS
+VirtiopMapRegion (
+    PVIRTIO_DEVICE Device,
+    PRESOURCE_ALLOCATION_LIST AllocationList,
+    ULONG Bar,
+    ULONG Offset,
+    ULONG Length,
+    PVIRTIO_REGION_MAPPING Region
+    )
+
+/*++
+
+Routine Description:
+
+    This routine maps a single virtio register region.
+
+Arguments:
+
+    Device - Supplies a pointer to the virtio device.
+
+    AllocationList - Supplies a pointer to the device's resource allocations.
+
+    Bar - Supplies the index of the BAR containing the region.
+
+    Offset - Supplies the offset of the region within the BAR.
+
+    Length - Supplies the length of the region in bytes.
+
+    Region - Supplies a pointer to the region structure to fill out.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    ULONG AlignmentOffset;
+    PRESOURCE_ALLOCATION Allocation;
+    ULONGLONG BarValue;
+    PHYSICAL_ADDRESS EndAddress;
+    ULONG High;
+    ULONG PageSize;
+    PHYSICAL_ADDRESS PhysicalAddress;
+    UINTN Size;
+    PVOID VirtualAddress;
+
+    if ((Bar >= VIRTIO_PCI_BAR_COUNT) || (Length == 0)) {
+        return STATUS_INVALID_CONFIGURATION;
+    }
+
+    //
+    // Get the BAR's address out of configuration space. I/O port BARs are not
+    // supported.
+    //
+
+    BarValue = VirtiopReadPciConfig(Device,
+                                    VIRTIO_PCI_BAR_OFFSET + (Bar * 4),
+                                    4);
+
+    if ((BarValue & VIRTIO_PCI_BAR_IO_SPACE) != 0) {
+        return STATUS_NOT_SUPPORTED;
+    }
+
+    if (((BarValue & VIRTIO_PCI_BAR_TYPE_MASK) == VIRTIO_PCI_BAR_TYPE_64_BIT) &&
+        (Bar + 1 < VIRTIO_PCI_BAR_COUNT)) {
+
+        High = VirtiopReadPciConfig(Device,
+                                    VIRTIO_PCI_BAR_OFFSET + ((Bar + 1) * 4),
+                                    4);
+
+        BarValue |= (ULONGLONG)High << 32;
+    }
+
+    PhysicalAddress = (BarValue & ~(ULONGLONG)VIRTIO_PCI_BAR_FLAGS_MASK) +
+                      Offset;
+
+    EndAddress = PhysicalAddress + Length;
+
+    //
+    // Make sure the region lies within a range the bus actually assigned.
+    //
+
+    Allocation = IoGetNextResourceAllocation(AllocationList, NULL);
+    while (Allocation != NULL) {
+        if ((Allocation->Type == ResourceTypePhysicalAddressSpace) &&
+            (PhysicalAddress >= Allocation->Allocation) &&
+            (EndAddress <= Allocation->Allocation + Allocation->Length)) {
+
+            break;
+        }
+
+        Allocation = IoGetNextResourceAllocation(AllocationList, Allocation);
+    }
+
+    if (Allocation == NULL) {
+        return STATUS_INVALID_CONFIGURATION;
+    }
+
+    //
+    // Page align the mapping request.
+    //
+
+    PageSize = MmPageSize();
+    EndAddress = ALIGN_RANGE_UP(EndAddress, PageSize);
+    AlignmentOffset = PhysicalAddress - ALIGN_RANGE_DOWN(PhysicalAddress,
+                                                         PageSize);
+
+    PhysicalAddress -= AlignmentOffset;
+    Size = (UINTN)(EndAddress - PhysicalAddress);
+    VirtualAddress = MmMapPhysicalAddress(PhysicalAddress,
+                                          Size,
+                                          TRUE,
+                                          FALSE,
+                                          TRUE);
+
+    if (VirtualAddress == NULL) {
+        return STATUS_NO_MEMORY;
+    }
+
+    Region->Mapping = VirtualAddress;
+    Region->MappingSize = Size;
+    Region->Base = VirtualAddress + AlignmentOffset;
+    Region->Length = Length;
+    return STATUS_SUCCESS;
+}
+
+VOID
+VirtiopUnmapRegions (
+    PVIRTIO_DEVICE Device
+    )
+
+/*++
+
+Routine Description:
+
+    This routine unmaps all of the virtio register regions.
+
+Arguments:
+
+    Device - Supplies a pointer to the virtio device.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PVIRTIO_REGION_MAPPING Region;
+    ULONG RegionIndex;
+
+    for (RegionIndex = 0; RegionIndex < VIRTIO_REGION_COUNT; RegionIndex += 1) {
+        Region = &(Device->Regions[RegionIndex]);
+        if (Region->Mapping != NULL) {
+            MmUnmapAddress(Region->Mapping, Region->MappingSize);
+        }
+
+        RtlZeroMemory(Region, sizeof(VIRTIO_REGION_MAPPING));
+    }
+
+    return;
+}
+
+ULONG
+VirtiopReadPciConfig (
+    PVIRTIO_DEVICE Device,
+    ULONG Offset,
+    ULONG Size
+    )
+
+/*++
+
+Routine Description:
+
+    This routine reads from the device's PCI configuration space.
+
+Arguments:
+
+    Device - Supplies a pointer to the virtio device.
+
+    Offset - Supplies the offset into configuration space to read.
+
+    Size - Supplies the access size. Valid values are 1, 2, and 4.
+
+Return Value:
+
+    Returns the value read, or 0 if the read failed.
+
+--*/
+
+{
+
+    KSTATUS Status;
+    ULONGLONG Value;
+
+    ASSERT(Device->PciConfigInterfaceAvailable != FALSE);
+
+    Value = 0;
+    Status = Device->PciConfigInterface.ReadPciConfig(
+                                        Device->PciConfigInterface.DeviceToken,
+                                        Offset,
+                                        Size,
+                                        &Value);
+
+    if (!KSUCCESS(Status)) {
+        return 0;
+    }
+
+    return (ULONG)Value;
+}
+
+VOID
+VirtiopSetStatus (
+    PVIRTIO_DEVICE Device,
+    UCHAR StatusBits
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sets additional bits in the device status register.
+
+Arguments:
+
+    Device - Supplies a pointer to the virtio device.
+
+    StatusBits - Supplies the bits to set. See VIRTIO_STATUS_* definitions.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    UCHAR Status;
+
+    Status = VIRTIO_READ_COMMON8(Device, VirtioCommonDeviceStatus);
+    VIRTIO_WRITE_COMMON8(Device,
+                         VirtioCommonDeviceStatus,
+                         Status | StatusBits);
+
+    return;
+}
+
+KSTATUS
+VirtiopEnableMessageSignaledInterrupts (
+    PVIRTIO_DEVICE Device
+    )
+
+/*++
+
+Routine Description:
+
+    This routine programs the device's MSI-X table so that table entry N
+    delivers the Nth allocated vector, and then enables MSI-X.
+
+Arguments:
+
+    Device - Supplies a pointer to the virtio device.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    PCI_MSI_INFORMATION MsiInformation;
+    PINTERFACE_PCI_MSI MsiInterface;
+    PROCESSOR_SET ProcessorSet;
+    KSTATUS Status;
+
+    ASSERT(Device->MessageVectorCount != 0);
+
+    if (Device->PciMsiInterfaceAvailable == FALSE) {
+        return STATUS_NOT_READY;
+    }
+
+    MsiInterface = &(Device->PciMsiInterface);
+    ProcessorSet.Target = ProcessorTargetAny;
+    Status = MsiInterface->SetVectors(MsiInterface->DeviceToken,
+                                      PciMsiTypeExtended,
+                                      Device->InterruptVector,
+                                      0,
+                                      Device->MessageVectorCount,
+                                      &ProcessorSet);
+
+    if (!KSUCCESS(Status)) {
+        return Status;
+    }
+
+    RtlZeroMemory(&MsiInformation, sizeof(PCI_MSI_INFORMATION));
+    MsiInformation.Version = PCI_MSI_INTERFACE_INFORMATION_VERSION;
+    MsiInformation.MsiType = PciMsiTypeExtended;
+    MsiInformation.Flags = PCI_MSI_INTERFACE_FLAG_ENABLED;
+    MsiInformation.VectorCount = Device->MessageVectorCount;
+    Status = MsiInterface->GetSetInformation(MsiInterface->DeviceToken,
+                                             &MsiInformation,
+                                             TRUE);
+
+    return Status;
+}
+
+VOID
+VirtiopProcessPciConfigInterfaceChangeNotification (
+    PVOID Context,
+    PDEVICE Device,
+    PVOID InterfaceBuffer,
+    ULONG InterfaceBufferSize,
+    BOOL Arrival
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is called when a PCI configuration space access interface
+    changes in availability.
+
+Arguments:
+
+    Context - Supplies the caller's context pointer, supplied when the caller
+        requested interface notifications.
+
+    Device - Supplies a pointer to the device exposing or deleting the
+        interface.
+
+    InterfaceBuffer - Supplies a pointer to the interface buffer of the
+        interface.
+
+    InterfaceBufferSize - Supplies the buffer size.
+
+    Arrival - Supplies TRUE if a new interface is arriving, or FALSE if an
+        interface is departing.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PVIRTIO_DEVICE VirtioDevice;
+
+    VirtioDevice = (PVIRTIO_DEVICE)Context;
+    if (Arrival != FALSE) {
+        if (InterfaceBufferSize >= sizeof(INTERFACE_PCI_CONFIG_ACCESS)) {
+
+            ASSERT(VirtioDevice->PciConfigInterfaceAvailable == FALSE);
+
+            RtlCopyMemory(&(VirtioDevice->PciConfigInterface),
+                          InterfaceBuffer,
+                          sizeof(INTERFACE_PCI_CONFIG_ACCESS));
+
+            VirtioDevice->PciConfigInterfaceAvailable = TRUE;
+        }
+
+    } else {
+        VirtioDevice->PciConfigInterfaceAvailable = FALSE;
+    }
+
+    return;
+}
+
+VOID
+VirtiopProcessPciMsiInterfaceChangeNotification (
+    PVOID Context,
+    PDEVICE Device,
+    PVOID InterfaceBuffer,
+    ULONG InterfaceBufferSize,
+    BOOL Arrival
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is called when a PCI MSI interface changes in availability.
+
+Arguments:
+
+    Context - Supplies the caller's context pointer, supplied when the caller
+        requested interface notifications.
+
+    Device - Supplies a pointer to the device exposing or deleting the
+        interface.
+
+    InterfaceBuffer - Supplies a pointer to the interface buffer of the
+        interface.
+
+    InterfaceBufferSize - Supplies the buffer size.
+
+    Arrival - Supplies TRUE if a new interface is arriving, or FALSE if an
+        interface is departing.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PVIRTIO_DEVICE VirtioDevice;
+
+    VirtioDevice = (PVIRTIO_DEVICE)Context;
+    if (Arrival != FALSE) {
+        if (InterfaceBufferSize >= sizeof(INTERFACE_PCI_MSI)) {
+
+            ASSERT(VirtioDevice->PciMsiInterfaceAvailable == FALSE);
+
+            RtlCopyMemory(&(VirtioDevice->PciMsiInterface),
+                          InterfaceBuffer,
+                          sizeof(INTERFACE_PCI_MSI));
+
+            VirtioDevice->PciMsiInterfaceAvailable = TRUE;
+        }
+
+    } else {
+        VirtioDevice->PciMsiInterfaceAvailable = FALSE;
+    }
+
+    return;
+}
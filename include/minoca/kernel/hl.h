@@ -806,6 +806,35 @@ Return Value:
 
 --*/
 
+KERNEL_API
+KSTATUS
+HlGetProcessorPhysicalId (
+    ULONG ProcessorIndex,
+    PULONGLONG PhysicalId
+    );
+
+/*++
+
+Routine Description:
+
+    This routine returns the physical identifier of the processor with the
+    given logical processor index, as described by the firmware tables.
+
+Arguments:
+
+    ProcessorIndex - Supplies the logical processor index.
+
+    PhysicalId - Supplies a pointer where the processor physical identifier
+        will be returned on success.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_NOT_FOUND if the processor is not known to the hardware layer.
+
+--*/
+
 KERNEL_API
 KSTATUS
 HlSuspend (
@@ -1196,6 +1225,38 @@ Return Value:
 
 --*/
 
+KSTATUS
+HlSetInterruptLineTarget (
+    PKINTERRUPT Interrupt,
+    PPROCESSOR_SET Target
+    );
+
+/*++
+
+Routine Description:
+
+    This routine changes the set of processors an enabled interrupt line is
+    delivered to. Since the line is shared by every interrupt connected to it,
+    this affects all of them.
+
+Arguments:
+
+    Interrupt - Supplies a pointer to an interrupt whose line has been enabled.
+
+    Target - Supplies a pointer to the set of processors the line should
+        target.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_NOT_SUPPORTED if the interrupt does not have an enabled line on a
+    primary interrupt controller.
+
+    Other error codes if the controller could not be reprogrammed.
+
+--*/
+
 KSTATUS
 HlStartProfilerTimer (
     VOID
@@ -314,6 +314,15 @@ Module Name:
 
 #define IO_FLAG_SERVICING_FAULT 0x40000000
 
+//
+// These flags are reserved for use only by the memory manager. They override
+// the read-ahead behavior of the I/O handle for a single read, indicating that
+// the caller expects to access the data sequentially or randomly.
+//
+
+#define IO_FLAG_SEQUENTIAL_ACCESS 0x20000000
+#define IO_FLAG_RANDOM_ACCESS 0x10000000
+
 //
 // This flag indicates that a write I/O operation should flush all the file
 // data provided before returning.
@@ -868,6 +877,25 @@ Module Name:
 #define IO_GLOBAL_STATISTICS_VERSION 0x1
 #define IO_GLOBAL_STATISTICS_MAX_VERSION 0x10000000
 
+//
+// Define the version number for the block queue statistics.
+//
+
+#define IO_BLOCK_QUEUE_STATISTICS_VERSION 0x1
+
+//
+// Define the version number for the block queue policy information.
+//
+
+#define IO_BLOCK_QUEUE_POLICY_INFORMATION_VERSION 0x1
+
+//
+// Define the number of characters of the device name returned in the block
+// queue statistics, including the null terminator.
+//
+
+#define IO_BLOCK_QUEUE_NAME_SIZE 32
+
 //
 // Define the device ID given to the object manager.
 //
@@ -930,6 +958,7 @@ typedef struct _IRP IRP, *PIRP;
 typedef struct _STREAM_BUFFER STREAM_BUFFER, *PSTREAM_BUFFER;
 typedef struct _IO_HANDLE IO_HANDLE, *PIO_HANDLE;
 typedef struct _PAGE_CACHE_ENTRY PAGE_CACHE_ENTRY, *PPAGE_CACHE_ENTRY;
+typedef struct _IO_POLL_STATE IO_POLL_STATE, *PIO_POLL_STATE;
 
 typedef enum _SEEK_COMMAND {
     SeekCommandInvalid,
@@ -1023,8 +1052,15 @@ typedef enum _IO_INFORMATION_TYPE {
     IoInformationBoot,
     IoInformationMountPoints,
     IoInformationCacheStatistics,
+    IoInformationBlockQueueStatistics,
+    IoInformationBlockQueuePolicy,
 } IO_INFORMATION_TYPE, *PIO_INFORMATION_TYPE;
 
+typedef enum _IO_BLOCK_QUEUE_POLICY {
+    IoBlockQueuePolicyNoop,
+    IoBlockQueuePolicyDeadline,
+} IO_BLOCK_QUEUE_POLICY, *PIO_BLOCK_QUEUE_POLICY;
+
 /*++
 
 Structure Description:
@@ -1485,6 +1521,7 @@ typedef enum _IO_OBJECT_TYPE {
     IoObjectTerminalSlave,
     IoObjectSharedMemoryObject,
     IoObjectSymbolicLink,
+    IoObjectPollSet,
     IoObjectTypeCount
 } IO_OBJECT_TYPE, *PIO_OBJECT_TYPE;
 
@@ -1693,6 +1730,9 @@ Structure Description:
 
     Async - Stores an optional pointer to the asynchronous object state.
 
+    Poll - Stores an optional pointer to the list of poll set entries watching
+        this object.
+
 --*/
 
 typedef struct _IO_OBJECT_STATE {
@@ -1703,6 +1743,7 @@ typedef struct _IO_OBJECT_STATE {
     PKEVENT ErrorEvent;
     volatile ULONG Events;
     PIO_ASYNC_STATE Async;
+    PIO_POLL_STATE Poll;
 } IO_OBJECT_STATE, *PIO_OBJECT_STATE;
 
 typedef enum _IRP_MAJOR_CODE {
@@ -2623,6 +2664,127 @@ typedef struct _IO_GLOBAL_STATISTICS {
 
 /*++
 
+Structure Description:
+
+    This structure defines the request queue statistics for a single block
+    device.
+
+Members:
+
+    DeviceName - Stores the device ID string of the block device.
+
+    Policy - Stores the scheduling policy in use by the queue.
+
+    Depth - Stores the maximum number of requests the queue sends to the
+        device at once.
+
+    InFlight - Stores the number of requests currently at the device.
+
+    Pending - Stores the number of requests currently waiting in the queue.
+
+    MaxInFlight - Stores the largest number of requests that have been at the
+        device at once.
+
+    MaxPending - Stores the largest number of requests that have waited in the
+        queue at once.
+
+    RequestCount - Stores the total number of requests submitted to the queue.
+
+    DispatchCount - Stores the total number of IRPs sent to the device. This
+        is lower than the request count by the number of merges.
+
+    MergeCount - Stores the number of requests that were merged into an
+        adjacent request rather than being sent on their own.
+
+    PlugCount - Stores the number of times the queue was plugged to collect
+        requests.
+
+    ExpiredCount - Stores the number of requests the deadline policy
+        dispatched out of order because they had waited too long.
+
+    BytesTransferred - Stores the total number of bytes the device completed
+        for requests that succeeded.
+
+    TotalWaitTime - Stores the total time requests spent waiting in the
+        queue before being sent to the device, in microseconds.
+
+    TotalLatency - Stores the total time from submission to completion of all
+        requests, in microseconds.
+
+    MaxLatency - Stores the longest time from submission to completion of a
+        single request, in microseconds.
+
+--*/
+
+typedef struct _IO_BLOCK_QUEUE_STATISTICS_ENTRY {
+    CHAR DeviceName[IO_BLOCK_QUEUE_NAME_SIZE];
+    IO_BLOCK_QUEUE_POLICY Policy;
+    ULONG Depth;
+    ULONG InFlight;
+    ULONG Pending;
+    ULONG MaxInFlight;
+    ULONG MaxPending;
+    ULONGLONG RequestCount;
+    ULONGLONG DispatchCount;
+    ULONGLONG MergeCount;
+    ULONGLONG PlugCount;
+    ULONGLONG ExpiredCount;
+    ULONGLONG BytesTransferred;
+    ULONGLONG TotalWaitTime;
+    ULONGLONG TotalLatency;
+    ULONGLONG MaxLatency;
+} IO_BLOCK_QUEUE_STATISTICS_ENTRY, *PIO_BLOCK_QUEUE_STATISTICS_ENTRY;
+
+/*++
+
+Structure Description:
+
+    This structure defines the block queue statistics header. It is followed
+    immediately in memory by an array of entries, one for each block device
+    that has performed I/O.
+
+Members:
+
+    Version - Stores the structure version number. Set this to
+        IO_BLOCK_QUEUE_STATISTICS_VERSION.
+
+    QueueCount - Stores the number of entries following this structure.
+
+--*/
+
+typedef struct _IO_BLOCK_QUEUE_STATISTICS {
+    ULONG Version;
+    ULONG QueueCount;
+} IO_BLOCK_QUEUE_STATISTICS, *PIO_BLOCK_QUEUE_STATISTICS;
+
+/*++
+
+Structure Description:
+
+    This structure defines the scheduling policy of a single block device's
+    request queue, used to query or change it.
+
+Members:
+
+    Version - Stores the structure version number. Set this to
+        IO_BLOCK_QUEUE_POLICY_INFORMATION_VERSION.
+
+    DeviceName - Stores the device ID string of the block device, as returned
+        in the block queue statistics.
+
+    Policy - Stores the scheduling policy. This is returned on a get
+        operation and supplied on a set operation.
+
+--*/
+
+typedef struct _IO_BLOCK_QUEUE_POLICY_INFORMATION {
+    ULONG Version;
+    CHAR DeviceName[IO_BLOCK_QUEUE_NAME_SIZE];
+    IO_BLOCK_QUEUE_POLICY Policy;
+} IO_BLOCK_QUEUE_POLICY_INFORMATION, *PIO_BLOCK_QUEUE_POLICY_INFORMATION;
+
+/*++
+
 Structure Description:
 
     This structure defines system boot information.
@@ -4150,6 +4312,39 @@ Return Value:
 
 --*/
 
+KERNEL_API
+KSTATUS
+IoReadAhead (
+    PIO_HANDLE Handle,
+    IO_OFFSET Offset,
+    ULONGLONG Size
+    );
+
+/*++
+
+Routine Description:
+
+    This routine starts reading the given region of a file or block device
+    into the page cache in the background. It does not wait for the reads to
+    complete.
+
+Arguments:
+
+    Handle - Supplies the open I/O handle.
+
+    Offset - Supplies the offset from the beginning of the file or device where
+        the region starts.
+
+    Size - Supplies the size of the region in bytes. Supply zero to read ahead
+        to the end of the file.
+
+Return Value:
+
+    Status code. Objects that are not backed by the page cache succeed without
+    doing anything.
+
+--*/
+
 KERNEL_API
 KSTATUS
 IoReadAtOffset (
@@ -6319,6 +6514,109 @@ Return Value:
 
 --*/
 
+INTN
+IoSysCreatePollSet (
+    PVOID SystemCallParameter
+    );
+
+/*++
+
+Routine Description:
+
+    This routine implements the user mode system call for creating a poll set.
+
+Arguments:
+
+    SystemCallParameter - Supplies a pointer to the parameters supplied with
+        the system call. This structure will be a stack-local copy of the
+        actual parameters passed from user-mode.
+
+Return Value:
+
+    STATUS_SUCCESS or positive integer on success.
+
+    Error status code on failure.
+
+--*/
+
+INTN
+IoSysControlPollSet (
+    PVOID SystemCallParameter
+    );
+
+/*++
+
+Routine Description:
+
+    This routine implements the user mode system call for adding, modifying,
+    or removing an I/O handle in a poll set.
+
+Arguments:
+
+    SystemCallParameter - Supplies a pointer to the parameters supplied with
+        the system call. This structure will be a stack-local copy of the
+        actual parameters passed from user-mode.
+
+Return Value:
+
+    STATUS_SUCCESS or positive integer on success.
+
+    Error status code on failure.
+
+--*/
+
+INTN
+IoSysWaitForPollSet (
+    PVOID SystemCallParameter
+    );
+
+/*++
+
+Routine Description:
+
+    This routine implements the user mode system call for waiting on a poll
+    set.
+
+Arguments:
+
+    SystemCallParameter - Supplies a pointer to the parameters supplied with
+        the system call. This structure will be a stack-local copy of the
+        actual parameters passed from user-mode.
+
+Return Value:
+
+    Returns the number of events returned (a positive integer) on success.
+
+    Error status code (a negative integer) on failure.
+
+--*/
+
+INTN
+IoSysSendFile (
+    PVOID SystemCallParameter
+    );
+
+/*++
+
+Routine Description:
+
+    This routine implements the user mode system call for transferring data
+    from one I/O handle to another without copying it through user mode.
+
+Arguments:
+
+    SystemCallParameter - Supplies a pointer to the parameters supplied with
+        the system call. This structure will be a stack-local copy of the
+        actual parameters passed from user-mode.
+
+Return Value:
+
+    Returns the number of bytes transferred (a positive integer) on success.
+
+    Error status code (a negative integer) on failure.
+
+--*/
+
 VOID
 IoIoHandleAddReference (
     PIO_HANDLE IoHandle
@@ -7079,6 +7377,43 @@ Return Value:
 
 --*/
 
+KERNEL_API
+KSTATUS
+IoSetInterruptAffinity (
+    HANDLE InterruptHandle,
+    PPROCESSOR_AFFINITY Affinity
+    );
+
+/*++
+
+Routine Description:
+
+    This routine steers a connected interrupt to the given set of processors.
+    The interrupt's deferred work follows it, as DPCs queued by the service
+    routine run on the processor that took the interrupt. Interrupt
+    controllers can only target either one processor or all of them, so if
+    the set does not contain every active processor, the interrupt is
+    delivered to the first processor in the set.
+
+Arguments:
+
+    InterruptHandle - Supplies the handle to the interrupt, returned when the
+        interrupt was connected.
+
+    Affinity - Supplies a pointer to the set of processors the interrupt
+        should be delivered to.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_INVALID_PARAMETER if the set contains no active processors.
+
+    STATUS_NOT_SUPPORTED if the interrupt cannot be steered, such as for
+    message signaled interrupts or lines on secondary interrupt controllers.
+
+--*/
+
 KERNEL_API
 RUNLEVEL
 IoRaiseToInterruptRunLevel (
@@ -7696,6 +8031,28 @@ Return Value:
 
 --*/
 
+VOID
+IoFileObjectAddReference (
+    PVOID FileObject
+    );
+
+/*++
+
+Routine Description:
+
+    This routine adds an external reference to a file object previously
+    returned by referencing the file object for a handle.
+
+Arguments:
+
+    FileObject - Supplies the opaque pointer to the file object.
+
+Return Value:
+
+    None.
+
+--*/
+
 VOID
 IoFileObjectReleaseReference (
     PVOID FileObject
@@ -94,6 +94,24 @@ Module Name:
 #define KERNEL_MAX_ARGUMENT_VALUES 10
 #define KERNEL_MAX_COMMAND_LINE 4096
 
+//
+// Define the current version of the queued lock statistics structure.
+//
+
+#define QUEUED_LOCK_STATISTICS_VERSION 1
+
+//
+// Define the current version of the spin lock statistics structure.
+//
+
+#define SPIN_LOCK_STATISTICS_VERSION 1
+
+//
+// Define the number of distinct spin locks the contention profiler can track.
+//
+
+#define SPIN_LOCK_PROFILE_ENTRY_COUNT 256
+
 //
 // Work queue flags.
 //
@@ -171,6 +189,15 @@ Module Name:
 
 #define DPC_FLAG_QUEUED_ON_PROCESSOR 0x00000001
 
+//
+// Define the range of valid thread nice values. Lower nice values get a
+// larger share of the processor.
+//
+
+#define SCHEDULER_NICE_MINIMUM (-20)
+#define SCHEDULER_NICE_DEFAULT 0
+#define SCHEDULER_NICE_MAXIMUM 19
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -246,6 +273,8 @@ typedef enum _KE_INFORMATION_TYPE {
     KeInformationProcessorUsage,
     KeInformationProcessorCount,
     KeInformationKernelCommandLine,
+    KeInformationQueuedLockStatistics,
+    KeInformationSpinLockStatistics,
 } KE_INFORMATION_TYPE, *PKE_INFORMATION_TYPE;
 
 typedef enum _SYSTEM_RESET_TYPE {
@@ -364,6 +393,9 @@ Structure Description:
     IdleCycles - Stores the accumulated number of cycles this processor has
         spent idle.
 
+    Migrations - Stores the number of threads the load balancer has moved
+        onto this processor from other processors.
+
 --*/
 
 typedef struct _PROCESSOR_CYCLE_ACCOUNTING {
@@ -371,6 +403,7 @@ typedef struct _PROCESSOR_CYCLE_ACCOUNTING {
     ULONGLONG KernelCycles;
     ULONGLONG InterruptCycles;
     ULONGLONG IdleCycles;
+    ULONGLONG Migrations;
 } PROCESSOR_CYCLE_ACCOUNTING, *PPROCESSOR_CYCLE_ACCOUNTING;
 
 /*++
@@ -418,13 +451,18 @@ Structure Description:
 
     Entry - Stores the regular scheduling entry data.
 
-    Children - Stores the head of the list of scheduling entries that are ready
-        to be run within this group.
+    Children - Stores the run queue of scheduling entries that are ready to be
+        run within this group, sorted by virtual runtime. Child group entries
+        are only in this tree while they contain ready threads.
 
     ReadyThreadCount - Stores the number of threads inside this group and all
         its children (meaning this includes all ready threads inside child and
         grandchild groups).
 
+    MinimumRuntime - Stores the monotonically increasing minimum virtual
+        runtime of the entries in this group. Waking entries are placed
+        relative to this value.
+
     Scheduler - Stores a pointer to the root CPU this group belongs to.
 
     Group - Stores a pointer to the owning group structure.
@@ -433,8 +471,9 @@ Structure Description:
 
 struct _SCHEDULER_GROUP_ENTRY {
     SCHEDULER_ENTRY Entry;
-    LIST_ENTRY Children;
+    RED_BLACK_TREE Children;
     UINTN ReadyThreadCount;
+    ULONGLONG MinimumRuntime;
     PSCHEDULER_DATA Scheduler;
     PSCHEDULER_GROUP Group;
 };
@@ -451,11 +490,30 @@ Structure Description:
 
     Group - Stores the fixed head scheduling group for this processor.
 
+    RunningEntry - Stores a pointer to the scheduler entry of the thread
+        currently running on this processor, or NULL if the processor is
+        running its idle thread. This is protected by the scheduler lock.
+
+    Load - Stores the decaying average of the number of ready threads on this
+        processor, in fixed point. This is updated by the clock interrupt and
+        read without synchronization by the load balancer.
+
+    Domain - Stores the scheduling domain (physical package) this processor
+        belongs to. The load balancer prefers to move threads between
+        processors in the same domain.
+
+    BalancePending - Stores a boolean indicating that the clock interrupt has
+        requested a periodic load balance on this processor.
+
 --*/
 
 struct _SCHEDULER_DATA {
     KSPIN_LOCK Lock;
     SCHEDULER_GROUP_ENTRY Group;
+    PSCHEDULER_ENTRY RunningEntry;
+    volatile ULONG Load;
+    ULONG Domain;
+    BOOL BalancePending;
 };
 
 /*++
@@ -644,9 +702,17 @@ Structure Description:
     IdleCycles - Stores the accumulated number of cycles this processor has
         spent idle.
 
+    Migrations - Stores the number of threads the load balancer has moved
+        onto this processor from other processors.
+
     SwapPage - Stores a pointer to a virtual address that can be used for
         temporary mappings.
 
+    PoolCaches - Stores this processor's caches of freed non-paged and paged
+        pool allocations, indexed by pool type minus one.
+
+    PhysicalPageCache - Stores this processor's cache of free physical pages.
+
     NmiCount - Stores a count of nested NMIs this processor has taken.
 
     CpuVersion - Stores the processor identification information for this CPU.
@@ -683,7 +749,10 @@ struct _PROCESSOR_BLOCK {
     volatile ULONGLONG KernelCycles;
     volatile ULONGLONG InterruptCycles;
     volatile ULONGLONG IdleCycles;
+    volatile ULONGLONG Migrations;
     PVOID SwapPage;
+    MM_POOL_CACHE PoolCaches[PoolTypeCount - 1];
+    MM_PHYSICAL_PAGE_CACHE PhysicalPageCache;
     UINTN NmiCount;
     PROCESSOR_IDENTIFICATION CpuVersion;
 };
@@ -741,21 +810,180 @@ Structure Description:
     This structure defines a queued lock. These locks can be used at or below
     dispatch level, or only below if paged memory is used.
 
+    Uncontended acquires and releases only touch the state word. The wait
+    queue in the object header is used only to put waiters to sleep once
+    spinning has stopped being worthwhile.
+
 Members:
 
     Header - Stores the object header.
 
     OwningThread - Stores a pointer to the thread that is holding the lock.
 
+    State - Stores the lock state. The lowest bit is set if the lock is held,
+        and the remaining bits count the threads blocked (or about to block)
+        on the wait queue.
+
+    OwningProcessor - Stores the number of the processor the owning thread
+        was running on when it acquired the lock. Contending threads spin only
+        while the owner is still running there.
+
+    AcquireCount - Stores the number of times the lock has been acquired.
+
+    ContendedCount - Stores the number of acquires that found the lock held.
+
+    SpinAcquireCount - Stores the number of contended acquires that got the
+        lock by spinning, without blocking.
+
+    WaitTime - Stores the total time spent in contended acquires, in time
+        counter ticks.
+
 --*/
 
 typedef struct _QUEUED_LOCK {
     OBJECT_HEADER Header;
     PKTHREAD OwningThread;
+    volatile ULONG State;
+    ULONG OwningProcessor;
+    ULONGLONG AcquireCount;
+    ULONGLONG ContendedCount;
+    ULONGLONG SpinAcquireCount;
+    ULONGLONG WaitTime;
 } QUEUED_LOCK, *PQUEUED_LOCK;
 
 /*++
 
+Structure Description:
+
+    This structure defines the contention statistics of a single queued lock.
+
+Members:
+
+    Lock - Stores the address of the lock, which serves as its identifier.
+
+    AcquireCount - Stores the number of times the lock has been acquired.
+
+    ContendedCount - Stores the number of acquires that found the lock held.
+
+    SpinAcquireCount - Stores the number of contended acquires that got the
+        lock by spinning, without blocking.
+
+    WaitTime - Stores the total time spent in contended acquires, in time
+        counter ticks.
+
+--*/
+
+typedef struct _QUEUED_LOCK_STATISTICS_ENTRY {
+    ULONGLONG Lock;
+    ULONGLONG AcquireCount;
+    ULONGLONG ContendedCount;
+    ULONGLONG SpinAcquireCount;
+    ULONGLONG WaitTime;
+} QUEUED_LOCK_STATISTICS_ENTRY, *PQUEUED_LOCK_STATISTICS_ENTRY;
+
+/*++
+
+Structure Description:
+
+    This structure defines queued lock contention statistics. It is followed
+    immediately in memory by an array of entries for each lock that has been
+    contended.
+
+Members:
+
+    Version - Stores the structure version number. Set this to
+        QUEUED_LOCK_STATISTICS_VERSION.
+
+    LockCount - Stores the total number of queued locks in the system.
+
+    EntryCount - Stores the number of entries following this structure.
+
+    TimeCounterFrequency - Stores the frequency of the time counter, for
+        converting wait times into real time.
+
+    AcquireCount - Stores the total number of queued lock acquires.
+
+    ContendedCount - Stores the total number of contended acquires.
+
+    SpinAcquireCount - Stores the total number of contended acquires that
+        got the lock without blocking.
+
+    WaitTime - Stores the total time spent in contended acquires, in time
+        counter ticks.
+
+--*/
+
+typedef struct _QUEUED_LOCK_STATISTICS {
+    ULONG Version;
+    ULONG LockCount;
+    ULONG EntryCount;
+    ULONGLONG TimeCounterFrequency;
+    ULONGLONG AcquireCount;
+    ULONGLONG ContendedCount;
+    ULONGLONG SpinAcquireCount;
+    ULONGLONG WaitTime;
+} QUEUED_LOCK_STATISTICS, *PQUEUED_LOCK_STATISTICS;
+
+/*++
+
+Structure Description:
+
+    This structure defines the contention profile of a single spin lock.
+
+Members:
+
+    Lock - Stores the address of the lock, which serves as its identifier.
+        This is zero for an unused entry.
+
+    ContendedCount - Stores the number of acquires that had to wait.
+
+    SpinCount - Stores the total number of times waiters spun on the lock.
+
+    MaximumWaiters - Stores the longest line of waiters seen ahead of an
+        acquirer, including the lock holder.
+
+--*/
+
+typedef struct _SPIN_LOCK_STATISTICS_ENTRY {
+    volatile ULONGLONG Lock;
+    volatile ULONGLONG ContendedCount;
+    volatile ULONGLONG SpinCount;
+    volatile ULONG MaximumWaiters;
+} SPIN_LOCK_STATISTICS_ENTRY, *PSPIN_LOCK_STATISTICS_ENTRY;
+
+/*++
+
+Structure Description:
+
+    This structure defines spin lock contention profiling state. On get
+    operations it is followed immediately in memory by an array of entries
+    for each spin lock that has been contended while profiling was enabled.
+
+Members:
+
+    Version - Stores the structure version number. Set this to
+        SPIN_LOCK_STATISTICS_VERSION.
+
+    Enabled - Stores a boolean indicating whether spin lock contention
+        profiling is on. Set operations use this to turn profiling on or off.
+        Turning profiling on clears out any previous results.
+
+    EntryCount - Stores the number of entries following this structure.
+
+    DroppedCount - Stores the number of contended acquires that were not
+        recorded because the profile table was full.
+
+--*/
+
+typedef struct _SPIN_LOCK_STATISTICS {
+    ULONG Version;
+    BOOL Enabled;
+    ULONG EntryCount;
+    ULONGLONG DroppedCount;
+} SPIN_LOCK_STATISTICS, *PSPIN_LOCK_STATISTICS;
+
+/*++
+
 Structure Description:
 
     This structure defines an event.
@@ -3329,6 +3557,64 @@ Return Value:
 
 --*/
 
+VOID
+KeSetThreadNiceValue (
+    PKTHREAD Thread,
+    LONG NiceValue
+    );
+
+/*++
+
+Routine Description:
+
+    This routine sets the nice value of the given thread, which determines its
+    scheduling weight relative to other threads. The new weight takes effect
+    the next time the thread's run time is charged.
+
+Arguments:
+
+    Thread - Supplies a pointer to the thread to modify.
+
+    NiceValue - Supplies the new nice value, between SCHEDULER_NICE_MINIMUM
+        and SCHEDULER_NICE_MAXIMUM. Values outside this range are clipped.
+
+Return Value:
+
+    None.
+
+--*/
+
+KERNEL_API
+KSTATUS
+KeSetThreadAffinity (
+    PKTHREAD Thread,
+    PPROCESSOR_AFFINITY Affinity
+    );
+
+/*++
+
+Routine Description:
+
+    This routine sets the set of processors the given thread is allowed to
+    run on. If the thread is currently queued or running on a processor that
+    is no longer allowed, it is moved. This routine must be called at or
+    below dispatch level.
+
+Arguments:
+
+    Thread - Supplies a pointer to the thread to modify.
+
+    Affinity - Supplies a pointer to the new processor affinity mask.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_INVALID_PARAMETER if the mask does not contain any active
+    processors.
+
+--*/
+
 VOID
 KeSuspendExecution (
     VOID
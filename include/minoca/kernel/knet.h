@@ -208,6 +208,30 @@ Module Name:
 
 #define SOCKET_IO_DONT_ROUTE 0x00000100
 
+//
+// This flag is set by kernel mode callers on send to offer the I/O buffer to
+// the protocol rather than having it copy the data out. The buffer must not
+// be modified until the protocol is done with it. It is not available to user
+// mode.
+//
+
+#define SOCKET_IO_DONATE_BUFFER 0x40000000
+
+//
+// This flag is returned on send if the protocol took ownership of a donated
+// I/O buffer. The protocol frees the buffer when it no longer needs the data,
+// so the caller must not touch or free it again.
+//
+
+#define SOCKET_IO_BUFFER_RETAINED 0x80000000
+
+//
+// Define the mask of socket I/O flags that only kernel mode may set.
+//
+
+#define SOCKET_IO_KERNEL_FLAGS \
+    (SOCKET_IO_DONATE_BUFFER | SOCKET_IO_BUFFER_RETAINED)
+
 //
 // Define common internet protocol numbers, as defined by the IANA.
 //
@@ -75,6 +75,18 @@ Module Name:
 #define MM_STATISTICS_VERSION 1
 #define MM_STATISTICS_MAX_VERSION 0x10000000
 
+//
+// Define the current version of the object cache statistics structure.
+//
+
+#define MM_OBJECT_CACHE_STATISTICS_VERSION 1
+
+//
+// Define the size of an object cache name, including the null terminator.
+//
+
+#define MM_OBJECT_CACHE_NAME_SIZE 32
+
 //
 // Define flags for memory accounting systems.
 //
@@ -126,16 +138,20 @@ Module Name:
 #define IMAGE_SECTION_DESTROYING        0x00000100
 #define IMAGE_SECTION_DESTROYED         0x00000200
 #define IMAGE_SECTION_WAS_WRITABLE      0x00000400
+#define IMAGE_SECTION_SEQUENTIAL        0x00000800
+#define IMAGE_SECTION_RANDOM            0x00001000
+#define IMAGE_SECTION_FAULT_AROUND      0x00002000
 
 //
 // Define a mask of image section flags that should be transfered when an image
 // section is copied. For internal use only.
 //
 
-#define IMAGE_SECTION_COPY_MASK                             \
-    (IMAGE_SECTION_ACCESS_MASK | IMAGE_SECTION_NON_PAGED |  \
-     IMAGE_SECTION_SHARED | IMAGE_SECTION_MAP_SYSTEM_CALL | \
-     IMAGE_SECTION_WAS_WRITABLE)
+#define IMAGE_SECTION_COPY_MASK                                      \
+    (IMAGE_SECTION_ACCESS_MASK | IMAGE_SECTION_NON_PAGED |           \
+     IMAGE_SECTION_SHARED | IMAGE_SECTION_MAP_SYSTEM_CALL |          \
+     IMAGE_SECTION_WAS_WRITABLE | IMAGE_SECTION_ACCESS_ADVICE_MASK | \
+     IMAGE_SECTION_FAULT_AROUND)
 
 //
 // Define a mask of image section access flags.
@@ -144,6 +160,13 @@ Module Name:
 #define IMAGE_SECTION_ACCESS_MASK \
     (IMAGE_SECTION_READABLE | IMAGE_SECTION_WRITABLE | IMAGE_SECTION_EXECUTABLE)
 
+//
+// Define a mask of image section flags that record access pattern advice.
+//
+
+#define IMAGE_SECTION_ACCESS_ADVICE_MASK \
+    (IMAGE_SECTION_SEQUENTIAL | IMAGE_SECTION_RANDOM)
+
 //
 // Define the mask of flags that is internal and should not be specified by
 // outside callers.
@@ -206,6 +229,13 @@ Module Name:
 #define BLOCK_ALLOCATOR_FLAG_PHYSICALLY_CONTIGUOUS 0x00000004
 #define BLOCK_ALLOCATOR_FLAG_TRIM                  0x00000008
 #define BLOCK_ALLOCATOR_FLAG_NO_EXPANSION          0x00000010
+#define BLOCK_ALLOCATOR_FLAG_COLOR                 0x00000020
+
+//
+// Define flags used for creating object caches.
+//
+
+#define MM_OBJECT_CACHE_FLAG_NON_PAGED 0x00000001
 
 //
 // Define user mode virtual address for the user shared data page.
@@ -238,6 +268,27 @@ Module Name:
 #define IO_BUFFER_FLAG_MEMORY_LOCKED         0x00000008
 #define IO_BUFFER_FLAG_KERNEL_MODE_DATA      0x00000010
 
+//
+// Define the number of size classes and the number of allocations per size
+// class held in each processor's pool cache.
+//
+
+#define MM_POOL_CACHE_CLASS_COUNT 8
+#define MM_POOL_CACHE_DEPTH 16
+
+//
+// Define the largest allocation size that is served from the pool caches.
+//
+
+#define MM_POOL_CACHE_MAXIMUM_SIZE 512
+
+//
+// Define the number of free physical pages held in each processor's physical
+// page cache.
+//
+
+#define MM_PHYSICAL_PAGE_CACHE_DEPTH 16
+
 //
 // --------------------------------------------------------------------- Macros
 //
@@ -280,6 +331,18 @@ Module Name:
 typedef LONGLONG IO_OFFSET, *PIO_OFFSET;
 typedef struct _IMAGE_SECTION_LIST IMAGE_SECTION_LIST, *PIMAGE_SECTION_LIST;
 
+typedef enum _IO_ADVICE {
+    IoAdviceNormal,
+    IoAdviceSequential,
+    IoAdviceRandom,
+    IoAdviceWillNeed,
+    IoAdviceDontNeed,
+    IoAdviceNoReuse,
+    IoAdviceFaultAround,
+    IoAdviceNoFaultAround,
+    IoAdviceCount
+} IO_ADVICE, *PIO_ADVICE;
+
 typedef enum _POOL_CORRUPTION_DETAIL {
     PoolCorruptionNone,
     PoolCorruptionDoubleFree,
@@ -340,6 +403,7 @@ typedef enum _MEMORY_WARNING_LEVEL {
 typedef enum _MM_INFORMATION_TYPE {
     MmInformationInvalid,
     MmInformationSystemMemory,
+    MmInformationObjectCacheStatistics,
 } MM_INFORMATION_TYPE, *PMM_INFORMATION_TYPE;
 
 /*++
@@ -611,6 +675,154 @@ typedef struct _IO_BUFFER {
 } IO_BUFFER, *PIO_BUFFER;
 
 typedef struct _BLOCK_ALLOCATOR BLOCK_ALLOCATOR, *PBLOCK_ALLOCATOR;
+typedef struct _MM_OBJECT_CACHE MM_OBJECT_CACHE, *PMM_OBJECT_CACHE;
+
+typedef
+KSTATUS
+(*PMM_OBJECT_CONSTRUCTOR) (
+    PVOID Object,
+    PVOID Context
+    );
+
+/*++
+
+Routine Description:
+
+    This routine is called to set up an object when the object cache carves
+    it out of fresh memory. Objects keep their constructed state while they
+    sit in the cache, so this is not called again when a freed object is
+    handed back out.
+
+Arguments:
+
+    Object - Supplies a pointer to the object to construct.
+
+    Context - Supplies the context pointer supplied when the cache was
+        created.
+
+Return Value:
+
+    Status code. On failure, the allocation fails.
+
+--*/
+
+typedef
+VOID
+(*PMM_OBJECT_DESTRUCTOR) (
+    PVOID Object,
+    PVOID Context
+    );
+
+/*++
+
+Routine Description:
+
+    This routine is called to tear down an object before the object cache
+    gives its memory back.
+
+Arguments:
+
+    Object - Supplies a pointer to the object to destruct.
+
+    Context - Supplies the context pointer supplied when the cache was
+        created.
+
+Return Value:
+
+    None.
+
+--*/
+
+/*++
+
+Structure Description:
+
+    This structure defines a freed pool allocation sitting in a processor's
+    pool cache.
+
+Members:
+
+    Allocation - Stores a pointer to the allocation.
+
+    Tag - Stores the tag the allocation was made with.
+
+--*/
+
+typedef struct _MM_POOL_CACHE_ENTRY {
+    PVOID Allocation;
+    ULONG Tag;
+} MM_POOL_CACHE_ENTRY, *PMM_POOL_CACHE_ENTRY;
+
+/*++
+
+Structure Description:
+
+    This structure defines the stack of cached allocations for one size class.
+
+Members:
+
+    Count - Stores the number of valid entries in the array.
+
+    LowWater - Stores the smallest the count has been since the cache was last
+        trimmed. Entries below this mark went unused for a whole trim period.
+
+    Entries - Stores the cached allocations. The most recently freed entry is
+        at the end.
+
+--*/
+
+typedef struct _MM_POOL_CACHE_MAGAZINE {
+    ULONG Count;
+    ULONG LowWater;
+    MM_POOL_CACHE_ENTRY Entries[MM_POOL_CACHE_DEPTH];
+} MM_POOL_CACHE_MAGAZINE, *PMM_POOL_CACHE_MAGAZINE;
+
+/*++
+
+Structure Description:
+
+    This structure defines a per-processor cache of recently freed small pool
+    allocations, which lets allocate and free pairs skip the pool lock.
+
+Members:
+
+    Lock - Stores the spin lock protecting the cache. This is only ever
+        contended when another processor is draining the cache.
+
+    Magazines - Stores the cached allocations for each size class.
+
+--*/
+
+typedef struct _MM_POOL_CACHE {
+    KSPIN_LOCK Lock;
+    MM_POOL_CACHE_MAGAZINE Magazines[MM_POOL_CACHE_CLASS_COUNT];
+} MM_POOL_CACHE, *PMM_POOL_CACHE;
+
+/*++
+
+Structure Description:
+
+    This structure defines a per-processor cache of free physical pages, which
+    lets single page allocations and frees skip the physical page lock.
+
+Members:
+
+    Lock - Stores the spin lock protecting the cache. This is only ever
+        contended when another processor is draining the cache.
+
+    Count - Stores the number of valid entries in the pages array.
+
+    Pages - Stores the physical addresses of the cached pages. The most
+        recently freed page is at the end, as it is the most likely to still
+        be in the processor's cache.
+
+--*/
+
+typedef struct _MM_PHYSICAL_PAGE_CACHE {
+    KSPIN_LOCK Lock;
+    ULONG Count;
+    PHYSICAL_ADDRESS Pages[MM_PHYSICAL_PAGE_CACHE_DEPTH];
+} MM_PHYSICAL_PAGE_CACHE, *PMM_PHYSICAL_PAGE_CACHE;
 
 /*++
 
@@ -637,6 +849,12 @@ Structure Description:
     NonPagedPhysicalPages - Stores the number of physical pages that are
         pinned in memory and cannot be paged out to disk.
 
+    ActivePhysicalPages - Stores the number of pagable physical pages that
+        have been referenced recently.
+
+    InactivePhysicalPages - Stores the number of pagable physical pages that
+        have not been referenced recently, and will be paged out first.
+
 --*/
 
 typedef struct _MM_STATISTICS {
@@ -647,10 +865,91 @@ typedef struct _MM_STATISTICS {
     UINTN PhysicalPages;
     UINTN AllocatedPhysicalPages;
     UINTN NonPagedPhysicalPages;
+    UINTN ActivePhysicalPages;
+    UINTN InactivePhysicalPages;
 } MM_STATISTICS, *PMM_STATISTICS;
 
 /*++
 
+Structure Description:
+
+    This structure defines the statistics for a single object cache.
+
+Members:
+
+    Name - Stores the name of the cache.
+
+    Flags - Stores the flags the cache was created with. See
+        MM_OBJECT_CACHE_FLAG_* definitions.
+
+    ObjectSize - Stores the size of each object as requested by the creator
+        of the cache, in bytes.
+
+    ObjectStride - Stores the number of bytes each object actually takes up,
+        including alignment padding.
+
+    ActiveObjects - Stores the number of objects currently allocated.
+
+    CachedObjects - Stores the number of constructed objects sitting in the
+        cache waiting to be allocated again.
+
+    SlabCount - Stores the number of block allocator segments backing the
+        cache.
+
+    SlabObjects - Stores the total number of objects that fit in all the
+        segments backing the cache.
+
+    AllocationCount - Stores the total number of successful allocations.
+
+    MissCount - Stores the number of allocations that could not be satisfied
+        from a per-processor free list.
+
+    FreeCount - Stores the total number of frees.
+
+    ReclaimCount - Stores the number of cached objects given back by memory
+        pressure reclaim.
+
+--*/
+
+typedef struct _MM_OBJECT_CACHE_STATISTICS_ENTRY {
+    CHAR Name[MM_OBJECT_CACHE_NAME_SIZE];
+    ULONG Flags;
+    ULONG ObjectSize;
+    ULONG ObjectStride;
+    UINTN ActiveObjects;
+    UINTN CachedObjects;
+    UINTN SlabCount;
+    UINTN SlabObjects;
+    ULONGLONG AllocationCount;
+    ULONGLONG MissCount;
+    ULONGLONG FreeCount;
+    ULONGLONG ReclaimCount;
+} MM_OBJECT_CACHE_STATISTICS_ENTRY, *PMM_OBJECT_CACHE_STATISTICS_ENTRY;
+
+/*++
+
+Structure Description:
+
+    This structure defines the object cache statistics header. It is followed
+    immediately in memory by an array of entries, one for each object cache
+    in the system.
+
+Members:
+
+    Version - Stores the structure version number. Set this to
+        MM_OBJECT_CACHE_STATISTICS_VERSION.
+
+    CacheCount - Stores the number of entries following this structure.
+
+--*/
+
+typedef struct _MM_OBJECT_CACHE_STATISTICS {
+    ULONG Version;
+    ULONG CacheCount;
+} MM_OBJECT_CACHE_STATISTICS, *PMM_OBJECT_CACHE_STATISTICS;
+
+/*++
+
 Structure Description:
 
     This structure defines an I/O vector, a structure used in kernel mode that
@@ -691,6 +990,10 @@ Structure Description:
     MaxResidentSet - Stores the maximum resident set ever mapped into the
         process.
 
+    WorkingSet - Stores the number of pagable pages owned by the process that
+        have been referenced recently. This is protected by the physical page
+        lock.
+
     MaxMemoryMap - Stores the maximum address that map/unmap system calls
         should return.
 
@@ -706,6 +1009,7 @@ typedef struct _ADDRESS_SPACE {
     PMEMORY_ACCOUNTING Accountant;
     volatile UINTN ResidentSet;
     volatile UINTN MaxResidentSet;
+    volatile UINTN WorkingSet;
     PVOID MaxMemoryMap;
     PVOID BreakStart;
     PVOID BreakEnd;
@@ -1988,6 +2292,139 @@ Return Value:
 
 --*/
 
+KERNEL_API
+PMM_OBJECT_CACHE
+MmCreateObjectCache (
+    PCSTR Name,
+    ULONG ObjectSize,
+    ULONG Alignment,
+    PMM_OBJECT_CONSTRUCTOR Constructor,
+    PMM_OBJECT_DESTRUCTOR Destructor,
+    PVOID Context,
+    ULONG Flags,
+    ULONG Tag
+    );
+
+/*++
+
+Routine Description:
+
+    This routine creates a cache of fixed size objects. Objects are laid out
+    on cache line boundaries in block allocator segments, and freed objects
+    are kept constructed on per-processor free lists so that they can be
+    handed back out quickly. This routine must be called at low level.
+
+Arguments:
+
+    Name - Supplies the name of the cache, used for statistics. The name is
+        copied and truncated if needed.
+
+    ObjectSize - Supplies the size of each object, in bytes.
+
+    Alignment - Supplies the required alignment of each object, in bytes.
+        This must be a power of two or zero. Objects are always aligned to at
+        least a cache line.
+
+    Constructor - Supplies an optional pointer to a routine called to set up
+        each object when it is first carved out of memory.
+
+    Destructor - Supplies an optional pointer to a routine called to tear
+        down each object before its memory is given back.
+
+    Context - Supplies an optional context pointer passed to the constructor
+        and destructor.
+
+    Flags - Supplies a bitmask of flags governing the cache. See
+        MM_OBJECT_CACHE_FLAG_* definitions.
+
+    Tag - Supplies an identifier to associate with the cache's memory, useful
+        for debugging and leak detection.
+
+Return Value:
+
+    Returns a pointer to the new object cache on success.
+
+    NULL on failure.
+
+--*/
+
+KERNEL_API
+VOID
+MmDestroyObjectCache (
+    PMM_OBJECT_CACHE Cache
+    );
+
+/*++
+
+Routine Description:
+
+    This routine destroys an object cache. All objects must have been freed
+    back to the cache. This routine must be called at low level.
+
+Arguments:
+
+    Cache - Supplies a pointer to the cache to destroy.
+
+Return Value:
+
+    None.
+
+--*/
+
+KERNEL_API
+PVOID
+MmAllocateObject (
+    PMM_OBJECT_CACHE Cache
+    );
+
+/*++
+
+Routine Description:
+
+    This routine allocates a constructed object from an object cache. Paged
+    caches must be used at low level. Non-paged caches can be used at
+    dispatch level, but there the allocation can only be satisfied by objects
+    the cache is already holding.
+
+Arguments:
+
+    Cache - Supplies a pointer to the cache to allocate from.
+
+Return Value:
+
+    Returns a pointer to the object on success.
+
+    NULL on failure.
+
+--*/
+
+KERNEL_API
+VOID
+MmFreeObject (
+    PMM_OBJECT_CACHE Cache,
+    PVOID Object
+    );
+
+/*++
+
+Routine Description:
+
+    This routine frees an object back to its object cache. The object should
+    be returned in its constructed state. Paged caches must be used at low
+    level, non-paged caches at or below dispatch level.
+
+Arguments:
+
+    Cache - Supplies a pointer to the cache the object came from.
+
+    Object - Supplies a pointer to the object to free.
+
+Return Value:
+
+    None.
+
+--*/
+
 VOID
 MmHandleFault (
     ULONG FaultFlags,
@@ -2528,6 +2965,32 @@ Return Value:
 
 --*/
 
+INTN
+MmSysSetMemoryAdvice (
+    PVOID SystemCallParameter
+    );
+
+/*++
+
+Routine Description:
+
+    This routine responds to system calls from user mode giving advice about
+    how a region of memory is going to be accessed.
+
+Arguments:
+
+    SystemCallParameter - Supplies a pointer to the parameters supplied with
+        the system call. This structure will be a stack-local copy of the
+        actual parameters passed from user-mode.
+
+Return Value:
+
+    STATUS_SUCCESS or positive integer on success.
+
+    Error status code on failure.
+
+--*/
+
 INTN
 MmSysFlushMemory (
     PVOID SystemCallParameter
@@ -2874,6 +3337,42 @@ Return Value:
 
 --*/
 
+BOOL
+MmUserCompareExchange32 (
+    PVOID Buffer,
+    ULONG ExchangeValue,
+    ULONG CompareValue,
+    PULONG OriginalValue
+    );
+
+/*++
+
+Routine Description:
+
+    This routine performs an atomic 32-bit compare exchange on a user mode
+    address. This is assumed to be naturally aligned.
+
+Arguments:
+
+    Buffer - Supplies a pointer to the user mode value to compare and
+        potentially exchange.
+
+    ExchangeValue - Supplies the value to write if the comparison returns
+        equality.
+
+    CompareValue - Supplies the value to compare against.
+
+    OriginalValue - Supplies a pointer where the original value at the user
+        mode address will be returned.
+
+Return Value:
+
+    TRUE if the access succeeded, regardless of whether the exchange happened.
+
+    FALSE if the access failed.
+
+--*/
+
 PMEMORY_RESERVATION
 MmCreateMemoryReservation (
     PVOID PreferredVirtualAddress,
@@ -3686,6 +4185,42 @@ Return Value:
 
 --*/
 
+KSTATUS
+MmSetImageSectionRegionAdvice (
+    PVOID Address,
+    UINTN Size,
+    IO_ADVICE Advice
+    );
+
+/*++
+
+Routine Description:
+
+    This routine applies access pattern advice to the image sections of the
+    current process that cover the given address range. Sequential and random
+    advice are recorded on the sections and steer read-ahead when their pages
+    are faulted in from the backing file. Will-need advice starts reading the
+    backing file for the range in the background. Fault around advice lets
+    anonymous sections fault in whole aligned blocks of memory at once.
+
+Arguments:
+
+    Address - Supplies the starting address of the region.
+
+    Size - Supplies the size of the region.
+
+    Advice - Supplies the expected access pattern for the region.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_INVALID_ADDRESS_RANGE if some of the range is not mapped.
+
+    Other error codes if a section could not be split.
+
+--*/
+
 PVOID
 MmGetObjectForAddress (
     PVOID Address,
@@ -3721,6 +4256,34 @@ Return Value:
 
 --*/
 
+VOID
+MmAddObjectReference (
+    PVOID Object,
+    BOOL Shared
+    );
+
+/*++
+
+Routine Description:
+
+    This routine adds another reference to an object returned when getting
+    the object for a user mode address. Each reference must be released with
+    a call to release the object reference.
+
+Arguments:
+
+    Object - Supplies a pointer to the object returned when the address was
+        looked up.
+
+    Shared - Supplies the shared boolean that was returned when the address was
+        looked up.
+
+Return Value:
+
+    None.
+
+--*/
+
 VOID
 MmReleaseObjectReference (
     PVOID Object,
@@ -3851,6 +4414,28 @@ Return Value:
 
 --*/
 
+UINTN
+MmGetInactivePhysicalPages (
+    VOID
+    );
+
+/*++
+
+Routine Description:
+
+    This routine returns the number of pagable physical pages that have not
+    been referenced recently. These are the pages the pager will evict first.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Returns the number of inactive pagable physical pages.
+
+--*/
+
 UINTN
 MmGetTotalFreePhysicalPages (
     VOID
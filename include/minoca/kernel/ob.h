@@ -127,6 +127,7 @@ typedef enum _OBJECT_TYPE {
     ObjectTerminalMaster,
     ObjectTerminalSlave,
     ObjectSharedMemoryObject,
+    ObjectPollSet,
     ObjectMaxTypes
 } OBJECT_TYPE, *POBJECT_TYPE;
 
@@ -80,6 +80,24 @@ Module Name:
 #define PERMISSION_REMOVE_SET(_DestinationSet, _SetToRemove) \
     ((_DestinationSet) &= ~(_SetToRemove))
 
+//
+// This macro encodes a user lock wake operation. The operation and its
+// argument are applied atomically to the second address, and the comparison
+// and its argument are evaluated against the value the second address held
+// before the operation. See USER_LOCK_WAKE_* definitions.
+//
+
+#define USER_LOCK_WAKE_OPERATION_ENCODE(_Operation,                          \
+                                        _OperationArgument,                  \
+                                        _Comparison,                         \
+                                        _ComparisonArgument)                 \
+                                                                             \
+    (((_Operation) << USER_LOCK_WAKE_OPERATION_SHIFT) |                      \
+     ((_Comparison) << USER_LOCK_WAKE_COMPARISON_SHIFT) |                    \
+     (((_OperationArgument) & USER_LOCK_WAKE_ARGUMENT_MASK) <<               \
+      USER_LOCK_WAKE_OPERATION_ARGUMENT_SHIFT) |                             \
+     ((_ComparisonArgument) & USER_LOCK_WAKE_ARGUMENT_MASK))
+
 //
 // This macro evaluates to non-zero if the given permission set is the empty
 // set.
@@ -122,6 +140,24 @@ Module Name:
 #define PsIsSessionLeader(_Process) \
     ((_Process)->Identifiers.SessionId == (_Process)->Identifiers.ProcessId)
 
+//
+// These macros manipulate processor affinity masks. Processors beyond what a
+// mask can describe cannot be excluded, so they are always considered part of
+// the mask.
+//
+
+#define PROCESSOR_AFFINITY_CONTAINS(_Affinity, _Processor)              \
+    (((_Processor) >= PROCESSOR_AFFINITY_MAXIMUM) ||                    \
+     (((_Affinity)->Mask[(_Processor) / PROCESSOR_AFFINITY_WORD_BITS] & \
+       (1U << ((_Processor) % PROCESSOR_AFFINITY_WORD_BITS))) != 0))
+
+#define PROCESSOR_AFFINITY_ADD(_Affinity, _Processor)                   \
+    ((_Affinity)->Mask[(_Processor) / PROCESSOR_AFFINITY_WORD_BITS] |=  \
+     (1U << ((_Processor) % PROCESSOR_AFFINITY_WORD_BITS)))
+
+#define PROCESSOR_AFFINITY_SET_ALL(_Affinity) \
+    RtlSetMemory((_Affinity), 0xFF, sizeof(PROCESSOR_AFFINITY))
+
 //
 // ---------------------------------------------------------------- Definitions
 //
@@ -456,7 +492,7 @@ Module Name:
 #define PS_IMAGE_ALLOCATION_TAG 0x6D497350 // 'mIsP'
 #define PS_GROUP_ALLOCATION_TAG 0x70477350 // 'pGsP'
 
-#define PROCESS_INFORMATION_VERSION 1
+#define PROCESS_INFORMATION_VERSION 2
 
 #define PROCESS_DEBUG_MODULE_CHANGE_VERSION 1
 
@@ -483,6 +519,47 @@ Module Name:
 
 #define USER_LOCK_PRIVATE 0x00000080
 
+//
+// Define the layout of a priority inheritance user lock. The value is zero
+// when the lock is free. Otherwise it holds the thread ID of the owner, plus
+// the waiters bit if threads are blocked in the kernel on the lock. The owner
+// must call into the kernel to release the lock if the waiters bit is set.
+//
+
+#define USER_LOCK_PI_OWNER_MASK 0x3FFFFFFF
+#define USER_LOCK_PI_WAITERS 0x80000000
+
+//
+// Define the layout of an encoded wake operation.
+//
+
+#define USER_LOCK_WAKE_OPERATION_SHIFT 28
+#define USER_LOCK_WAKE_COMPARISON_SHIFT 24
+#define USER_LOCK_WAKE_OPERATION_ARGUMENT_SHIFT 12
+#define USER_LOCK_WAKE_ARGUMENT_MASK 0x00000FFF
+
+//
+// Define the operations a wake operation can perform on the second address.
+//
+
+#define USER_LOCK_WAKE_OPERATION_SET 0
+#define USER_LOCK_WAKE_OPERATION_ADD 1
+#define USER_LOCK_WAKE_OPERATION_OR 2
+#define USER_LOCK_WAKE_OPERATION_AND_NOT 3
+#define USER_LOCK_WAKE_OPERATION_XOR 4
+
+//
+// Define the comparisons a wake operation can perform on the original value
+// of the second address to decide whether to wake its waiters.
+//
+
+#define USER_LOCK_WAKE_COMPARE_EQUAL 0
+#define USER_LOCK_WAKE_COMPARE_NOT_EQUAL 1
+#define USER_LOCK_WAKE_COMPARE_LESS 2
+#define USER_LOCK_WAKE_COMPARE_LESS_OR_EQUAL 3
+#define USER_LOCK_WAKE_COMPARE_GREATER 4
+#define USER_LOCK_WAKE_COMPARE_GREATER_OR_EQUAL 5
+
 //
 // Define the current version of the process start data structure.
 //
@@ -507,6 +584,16 @@ Module Name:
 
 #define MAX_USER_ADDRESS ((PVOID)0x7FFFFFFF)
 
+//
+// Define the number of processors that can be described by a processor
+// affinity mask.
+//
+
+#define PROCESSOR_AFFINITY_MAXIMUM 256
+#define PROCESSOR_AFFINITY_WORD_BITS (sizeof(ULONG) * BITS_PER_BYTE)
+#define PROCESSOR_AFFINITY_WORDS \
+    (PROCESSOR_AFFINITY_MAXIMUM / PROCESSOR_AFFINITY_WORD_BITS)
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -585,6 +672,10 @@ typedef enum _USER_LOCK_OPERATION {
     UserLockInvalid,
     UserLockWait,
     UserLockWake,
+    UserLockRequeue,
+    UserLockWakeOperation,
+    UserLockPiLock,
+    UserLockPiUnlock,
 } USER_LOCK_OPERATION, *PUSER_LOCK_OPERATION;
 
 //
@@ -1492,6 +1583,24 @@ struct _SUPPLEMENTARY_GROUPS {
 
 /*++
 
+Structure Description:
+
+    This structure describes the set of processors a thread or interrupt is
+    allowed to run on.
+
+Members:
+
+    Mask - Stores the bitmap of allowed processors, where bit N of the bitmap
+        (bit N % 32 of word N / 32) corresponds to processor number N.
+
+--*/
+
+typedef struct _PROCESSOR_AFFINITY {
+    ULONG Mask[PROCESSOR_AFFINITY_WORDS];
+} PROCESSOR_AFFINITY, *PPROCESSOR_AFFINITY;
+
+/*++
+
 Structure Description:
 
     This structure defines an entry within the scheduler. This may either be a
@@ -1504,7 +1613,23 @@ Structure Description:
     Parent - Stores the parent group this entry belongs to.
 
     ListEntry - Stores pointers to the next and previous threads in the
-        ready list.
+        dead thread list once a thread has exited.
+
+    TreeNode - Stores the node in the parent group entry's run queue, which is
+        sorted by virtual runtime. The parent of this node is set to NULL
+        when the entry is not queued.
+
+    VirtualRuntime - Stores the weighted amount of processor time this entry
+        has consumed, in processor counter ticks. Entries with the lowest
+        virtual runtime are run first.
+
+    RunStart - Stores the processor counter value when this entry last began
+        running. This is only valid for thread entries.
+
+    Weight - Stores the scheduling weight of this entry. Virtual runtime
+        advances more slowly for entries with a larger weight.
+
+    NiceValue - Stores the nice value the weight was derived from.
 
 --*/
 
@@ -1513,6 +1638,11 @@ struct _SCHEDULER_ENTRY {
     SCHEDULER_ENTRY_TYPE Type;
     PSCHEDULER_ENTRY Parent;
     LIST_ENTRY ListEntry;
+    RED_BLACK_TREE_NODE TreeNode;
+    ULONGLONG VirtualRuntime;
+    ULONGLONG RunStart;
+    ULONG Weight;
+    LONG NiceValue;
 };
 
 /*++
@@ -1641,6 +1771,17 @@ Structure Description:
 
     Limits - Stores the resource limits associated with the thread.
 
+    Affinity - Stores the set of processors this thread is allowed to run on.
+        This is protected by the scheduler lock of the processor the thread
+        is queued on.
+
+    BaseNiceValue - Stores the nice value the thread returns to once it stops
+        inheriting priority from threads blocked on a user lock it owns. This
+        is only valid while the priority boosted flag is set.
+
+    PriorityBoosted - Stores a boolean indicating whether the thread is
+        currently running at a priority inherited through a user lock.
+
 --*/
 
 struct _KTHREAD {
@@ -1679,6 +1820,9 @@ struct _KTHREAD {
     RUNTIME_TIMER UserTimer;
     RUNTIME_TIMER ProfileTimer;
     RESOURCE_LIMIT Limits[ResourceLimitCount];
+    PROCESSOR_AFFINITY Affinity;
+    LONG BaseNiceValue;
+    BOOL PriorityBoosted;
 };
 
 /*++
@@ -1743,6 +1887,13 @@ Structure Description:
 
     ArgumentsBufferSize - Stores the size of the arguments buffer in bytes.
 
+    ResidentSet - Stores the number of pages currently mapped into the
+        process.
+
+    WorkingSet - Stores the number of pagable pages owned by the process that
+        have been referenced recently. This is an estimate of how much memory
+        the process needs to run without paging.
+
 --*/
 
 typedef struct _PROCESS_INFORMATION {
@@ -1769,6 +1920,8 @@ typedef struct _PROCESS_INFORMATION {
     ULONG NameLength;
     UINTN ArgumentsBufferOffset;
     ULONG ArgumentsBufferSize;
+    UINTN ResidentSet;
+    UINTN WorkingSet;
 } PROCESS_INFORMATION, *PPROCESS_INFORMATION;
 
 /*++
@@ -2551,6 +2704,58 @@ Return Value:
 
 --*/
 
+INTN
+PsSysSetPriority (
+    PVOID SystemCallParameter
+    );
+
+/*++
+
+Routine Description:
+
+    This routine implements the system call that gets or sets the scheduling
+    nice value of a thread, process, process group, or user.
+
+Arguments:
+
+    SystemCallParameter - Supplies a pointer to the parameters supplied with
+        the system call. This structure will be a stack-local copy of the
+        actual parameters passed from user-mode.
+
+Return Value:
+
+    STATUS_SUCCESS or positive integer on success.
+
+    Error status code on failure.
+
+--*/
+
+INTN
+PsSysSetAffinity (
+    PVOID SystemCallParameter
+    );
+
+/*++
+
+Routine Description:
+
+    This routine implements the system call that gets or sets the processor
+    affinity of a thread or of all threads in a process.
+
+Arguments:
+
+    SystemCallParameter - Supplies a pointer to the parameters supplied with
+        the system call. This structure will be a stack-local copy of the
+        actual parameters passed from user-mode.
+
+Return Value:
+
+    STATUS_SUCCESS or positive integer on success.
+
+    Error status code on failure.
+
+--*/
+
 INTN
 PsSysUserLock (
     PVOID SystemCallParameter
@@ -3178,6 +3383,33 @@ Return Value:
 
 --*/
 
+INTN
+PsSysSpawnProcess (
+    PVOID SystemCallParameter
+    );
+
+/*++
+
+Routine Description:
+
+    This routine creates a new child process running the given image without
+    copying the address space of the caller. File actions and attributes are
+    applied in the child before the image is loaded.
+
+Arguments:
+
+    SystemCallParameter - Supplies a pointer to the parameters supplied with
+        the system call. This structure will be a stack-local copy of the
+        actual parameters passed from user-mode.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    Error status code on failure.
+
+--*/
+
 INTN
 PsSysGetSetProcessId (
     PVOID SystemCallParameter
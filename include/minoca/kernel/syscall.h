@@ -259,6 +259,28 @@ Module Name:
     (POLL_EVENT_IN | POLL_EVENT_IN_HIGH_PRIORITY | POLL_EVENT_OUT | \
      POLL_EVENT_OUT_HIGH_PRIORITY)
 
+//
+// Define the poll set event flags, which are supplied in the high bits of the
+// events mask when adding or modifying a poll set entry.
+//
+
+//
+// Set this flag to report an entry only when new events are signaled on it,
+// rather than for as long as the events remain set.
+//
+
+#define POLL_SET_EVENT_EDGE_TRIGGERED 0x80000000
+
+//
+// Set this flag to disable the entry after it is reported once. It can be
+// re-armed by modifying the entry.
+//
+
+#define POLL_SET_EVENT_ONE_SHOT 0x40000000
+
+#define POLL_SET_EVENT_FLAGS \
+    (POLL_SET_EVENT_EDGE_TRIGGERED | POLL_SET_EVENT_ONE_SHOT)
+
 //
 // Define the effective access permission flags.
 //
@@ -274,6 +296,29 @@ Module Name:
 #define TIMER_CONTROL_FLAG_USE_TIMER_NUMBER 0x00000001
 #define TIMER_CONTROL_FLAG_SIGNAL_THREAD    0x00000002
 
+//
+// Define the spawn attribute flags, which control how a spawned child is set
+// up before its image starts.
+//
+
+#define SPAWN_ATTRIBUTE_RESET_IDS          0x00000001
+#define SPAWN_ATTRIBUTE_SET_PROCESS_GROUP  0x00000002
+#define SPAWN_ATTRIBUTE_SET_SIGNAL_DEFAULT 0x00000004
+#define SPAWN_ATTRIBUTE_SET_SIGNAL_MASK    0x00000008
+
+#define SPAWN_ATTRIBUTE_MASK              \
+    (SPAWN_ATTRIBUTE_RESET_IDS |          \
+     SPAWN_ATTRIBUTE_SET_PROCESS_GROUP |  \
+     SPAWN_ATTRIBUTE_SET_SIGNAL_DEFAULT | \
+     SPAWN_ATTRIBUTE_SET_SIGNAL_MASK)
+
+//
+// Define the maximum number of file actions that can be supplied to a single
+// spawn call.
+//
+
+#define SPAWN_MAX_FILE_ACTIONS 1024
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -351,6 +396,14 @@ typedef enum _SYSTEM_CALL_NUMBER {
     SystemCallSetITimer,
     SystemCallSetResourceLimit,
     SystemCallSetBreak,
+    SystemCallSetPriority,
+    SystemCallSetAffinity,
+    SystemCallSetMemoryAdvice,
+    SystemCallCreatePollSet,
+    SystemCallControlPollSet,
+    SystemCallWaitForPollSet,
+    SystemCallSendFile,
+    SystemCallSpawnProcess,
     SystemCallCount
 } SYSTEM_CALL_NUMBER, *PSYSTEM_CALL_NUMBER;
 
@@ -404,9 +457,17 @@ typedef enum _FILE_CONTROL_COMMAND {
     FileControlCommandSetDirectoryFlag,
     FileControlCommandCloseFrom,
     FileControlCommandGetPath,
+    FileControlCommandSetAdvice,
     FileControlCommandCount
 } FILE_CONTROL_COMMAND, *PFILE_CONTROL_COMMAND;
 
+typedef enum _POLL_SET_OPERATION {
+    PollSetOperationInvalid,
+    PollSetOperationAdd,
+    PollSetOperationModify,
+    PollSetOperationDelete
+} POLL_SET_OPERATION, *PPOLL_SET_OPERATION;
+
 typedef enum _TIME_ZONE_OPERATION {
     TimeZoneOperationInvalid,
     TimeZoneOperationGetCurrentZoneData,
@@ -437,6 +498,21 @@ typedef enum _RESOURCE_USAGE_REQUEST {
     ResourceUsageRequestThread,
 } RESOURCE_USAGE_REQUEST, *PRESOURCE_USAGE_REQUEST;
 
+typedef enum _PRIORITY_TARGET_TYPE {
+    PriorityTargetInvalid,
+    PriorityTargetProcess,
+    PriorityTargetThread,
+    PriorityTargetProcessGroup,
+    PriorityTargetUser,
+} PRIORITY_TARGET_TYPE, *PPRIORITY_TARGET_TYPE;
+
+typedef enum _SPAWN_FILE_ACTION_TYPE {
+    SpawnFileActionInvalid,
+    SpawnFileActionOpen,
+    SpawnFileActionDuplicate,
+    SpawnFileActionClose
+} SPAWN_FILE_ACTION_TYPE, *PSPAWN_FILE_ACTION_TYPE;
+
 //
 // System call parameter structures
 //
@@ -1201,6 +1277,30 @@ typedef struct _FILE_PATH {
 
 /*++
 
+Structure Description:
+
+    This structure defines advice about how a region of a file is going to be
+    accessed.
+
+Members:
+
+    Advice - Stores the expected access pattern for the region.
+
+    Offset - Stores the byte offset into the file where the region begins.
+
+    Size - Stores the size of the region in bytes. Zero means the region
+        extends to the end of the file.
+
+--*/
+
+typedef struct _FILE_ADVICE {
+    IO_ADVICE Advice;
+    ULONGLONG Offset;
+    ULONGLONG Size;
+} FILE_ADVICE, *PFILE_ADVICE;
+
+/*++
+
 Structure Description:
 
     This structure defines union of various parameters used by the file control
@@ -1223,6 +1323,8 @@ Structure Description:
     Owner - Stores the ID of the process to receive signals on asynchronous
         I/O events.
 
+    Advice - Stores the access pattern advice for a region of the file.
+
 --*/
 
 typedef union _FILE_CONTROL_PARAMETERS_UNION {
@@ -1232,6 +1334,7 @@ typedef union _FILE_CONTROL_PARAMETERS_UNION {
     ULONG Flags;
     FILE_PATH FilePath;
     PROCESS_ID Owner;
+    FILE_ADVICE Advice;
 } FILE_CONTROL_PARAMETERS_UNION, *PFILE_CONTROL_PARAMETERS_UNION;
 
 /*++
@@ -2210,6 +2313,272 @@ typedef struct _SYSTEM_CALL_SET_MEMORY_PROTECTION {
 
 /*++
 
+Structure Description:
+
+    This structure defines the system call parameters for giving the kernel
+    advice about how a region of memory is going to be accessed.
+
+Members:
+
+    Address - Stores the starting address of the region. This must be aligned
+        to a page boundary.
+
+    Size - Stores the length, in bytes, of the region.
+
+    Advice - Stores the expected access pattern for the region.
+
+--*/
+
+typedef struct _SYSTEM_CALL_SET_MEMORY_ADVICE {
+    PVOID Address;
+    UINTN Size;
+    IO_ADVICE Advice;
+} SYSCALL_STRUCT SYSTEM_CALL_SET_MEMORY_ADVICE,
+    *PSYSTEM_CALL_SET_MEMORY_ADVICE;
+
+/*++
+
+Structure Description:
+
+    This structure defines an event registered with or returned from a poll
+    set.
+
+Members:
+
+    Events - Stores the bitmask of poll events. When registering, this is the
+        set of events to watch for, plus any POLL_SET_EVENT_* flags. When
+        returned, this is the set of events that are signaled.
+
+    Data - Stores an opaque value supplied at registration and handed back
+        whenever the entry is reported.
+
+--*/
+
+typedef struct _POLL_SET_EVENT {
+    ULONG Events;
+    ULONGLONG Data;
+} POLL_SET_EVENT, *PPOLL_SET_EVENT;
+
+/*++
+
+Structure Description:
+
+    This structure defines the system call parameters for creating a poll set.
+
+Members:
+
+    OpenFlags - Stores an optional bitfield of open flags for the new handle.
+        Only SYS_OPEN_FLAG_CLOSE_ON_EXECUTE is accepted.
+
+    Handle - Stores the returned poll set handle on success.
+
+--*/
+
+typedef struct _SYSTEM_CALL_CREATE_POLL_SET {
+    ULONG OpenFlags;
+    HANDLE Handle;
+} SYSCALL_STRUCT SYSTEM_CALL_CREATE_POLL_SET, *PSYSTEM_CALL_CREATE_POLL_SET;
+
+/*++
+
+Structure Description:
+
+    This structure defines the system call parameters for adding, modifying,
+    or removing an I/O handle in a poll set.
+
+Members:
+
+    PollSet - Stores the handle to the poll set.
+
+    Operation - Stores the operation to perform.
+
+    Descriptor - Stores the I/O handle being added, modified, or removed.
+
+    Event - Stores the events to watch for and the data to return. This is
+        ignored for delete operations.
+
+--*/
+
+typedef struct _SYSTEM_CALL_CONTROL_POLL_SET {
+    HANDLE PollSet;
+    POLL_SET_OPERATION Operation;
+    HANDLE Descriptor;
+    POLL_SET_EVENT Event;
+} SYSCALL_STRUCT SYSTEM_CALL_CONTROL_POLL_SET, *PSYSTEM_CALL_CONTROL_POLL_SET;
+
+/*++
+
+Structure Description:
+
+    This structure defines the system call parameters for waiting on a poll
+    set.
+
+Members:
+
+    PollSet - Stores the handle to the poll set.
+
+    SignalMask - Stores an optional pointer to a signal mask to set for the
+        duration of the wait.
+
+    Events - Stores a pointer to an array where the ready events will be
+        returned.
+
+    EventCount - Stores the maximum number of elements in the events array.
+
+    TimeoutInMilliseconds - Stores the number of milliseconds to wait for an
+        entry to become ready before giving up.
+
+--*/
+
+typedef struct _SYSTEM_CALL_WAIT_FOR_POLL_SET {
+    HANDLE PollSet;
+    PSIGNAL_SET SignalMask;
+    PPOLL_SET_EVENT Events;
+    LONG EventCount;
+    ULONG TimeoutInMilliseconds;
+} SYSCALL_STRUCT SYSTEM_CALL_WAIT_FOR_POLL_SET,
+    *PSYSTEM_CALL_WAIT_FOR_POLL_SET;
+
+/*++
+
+Structure Description:
+
+    This structure defines the system call parameters for transferring data
+    from one I/O handle directly to another within the kernel.
+
+Members:
+
+    Destination - Stores the handle to write the data to.
+
+    Source - Stores the handle to read the data from.
+
+    SourceOffset - Stores the offset in the source to start reading from.
+        Supply -1ULL to read from and advance the current file pointer of the
+        source.
+
+    DestinationOffset - Stores the offset in the destination to start writing
+        to. Supply -1ULL to use the current file pointer of the destination.
+        This must be -1ULL if the destination is a socket.
+
+    Size - Stores the number of bytes to transfer.
+
+--*/
+
+typedef struct _SYSTEM_CALL_SEND_FILE {
+    HANDLE Destination;
+    HANDLE Source;
+    IO_OFFSET SourceOffset;
+    IO_OFFSET DestinationOffset;
+    INTN Size;
+} SYSCALL_STRUCT SYSTEM_CALL_SEND_FILE, *PSYSTEM_CALL_SEND_FILE;
+
+/*++
+
+Structure Description:
+
+    This structure defines a single file action performed in a spawned child
+    before its image is loaded.
+
+Members:
+
+    Type - Stores the type of action to perform.
+
+    Handle - Stores the handle to open into, duplicate from, or close.
+
+    NewHandle - Stores the handle to duplicate to. This is only used by
+        duplicate actions.
+
+    Path - Stores a pointer to the path to open. This is only used by open
+        actions.
+
+    PathBufferLength - Stores the size of the path buffer in bytes, including
+        the null terminator.
+
+    Flags - Stores the open flags. See SYS_OPEN_FLAG_* definitions.
+
+    CreatePermissions - Stores the permissions to apply if the open creates
+        the file.
+
+--*/
+
+typedef struct _SPAWN_FILE_ACTION {
+    SPAWN_FILE_ACTION_TYPE Type;
+    HANDLE Handle;
+    HANDLE NewHandle;
+    PSTR Path;
+    ULONG PathBufferLength;
+    ULONG Flags;
+    FILE_PERMISSIONS CreatePermissions;
+} SYSCALL_STRUCT SPAWN_FILE_ACTION, *PSPAWN_FILE_ACTION;
+
+/*++
+
+Structure Description:
+
+    This structure defines the attributes applied to a spawned child before
+    its image is loaded.
+
+Members:
+
+    Flags - Stores the set of attributes to apply. See SPAWN_ATTRIBUTE_*
+        definitions.
+
+    ProcessGroup - Stores the process group to put the child in. Zero creates
+        a new process group with the child as its leader.
+
+    DefaultSignals - Stores the set of signals to return to their default
+        disposition in the child.
+
+    SignalMask - Stores the blocked signal mask of the child's main thread.
+
+--*/
+
+typedef struct _SPAWN_ATTRIBUTES {
+    ULONG Flags;
+    PROCESS_GROUP_ID ProcessGroup;
+    SIGNAL_SET DefaultSignals;
+    SIGNAL_SET SignalMask;
+} SYSCALL_STRUCT SPAWN_ATTRIBUTES, *PSPAWN_ATTRIBUTES;
+
+/*++
+
+Structure Description:
+
+    This structure defines the system call parameters for creating a new
+    child process that runs a new image. This is equivalent to forking and
+    then executing, but the caller's address space is never copied.
+
+Members:
+
+    Environment - Stores a pointer to the image name, arguments, and
+        environment of the new process.
+
+    FileActions - Stores an optional pointer to an array of file actions to
+        perform in the child, in order.
+
+    FileActionCount - Stores the number of elements in the file actions
+        array.
+
+    Attributes - Stores an optional pointer to the attributes to apply to the
+        child.
+
+    ProcessId - Stores the ID of the new child process on return. If the
+        child was created but could not load its image, this is still set
+        and the child exits with status 127. The caller must reap it. This
+        is -1 if no child was created.
+
+--*/
+
+typedef struct _SYSTEM_CALL_SPAWN_PROCESS {
+    PPROCESS_ENVIRONMENT Environment;
+    PSPAWN_FILE_ACTION FileActions;
+    ULONG FileActionCount;
+    PSPAWN_ATTRIBUTES Attributes;
+    PROCESS_ID ProcessId;
+} SYSCALL_STRUCT SYSTEM_CALL_SPAWN_PROCESS, *PSYSTEM_CALL_SPAWN_PROCESS;
+
+/*++
+
 Structure Description:
 
     This structure defines the system call parameters for getting and setting
@@ -2389,6 +2758,19 @@ Structure Description:
     TimeoutInMilliseconds - Stores the timeout in milliseconds the caller
         should wait. Set to SYS_WAIT_TIME_INDEFINITE to wait forever.
 
+    SecondAddress - Stores a pointer to the second lock address, used by the
+        requeue and wake operations.
+
+    SecondValue - Stores the second value, whose meaning depends on the lock
+        operation. For requeue operations, this is the maximum number of
+        waiters to move on input, and the number moved on output. For wake
+        operations, this is the maximum number of waiters to wake on the second
+        address on input, and the number woken on output.
+
+    Argument - Stores an additional argument. For requeue operations, this is
+        the value the first address must still contain. For wake operations,
+        this is the encoded operation. See USER_LOCK_WAKE_OPERATION_ENCODE.
+
 --*/
 
 typedef struct _SYSTEM_CALL_USER_LOCK {
@@ -2396,6 +2778,9 @@ typedef struct _SYSTEM_CALL_USER_LOCK {
     ULONG Value;
     ULONG Operation;
     ULONG TimeoutInMilliseconds;
+    PULONG SecondAddress;
+    ULONG SecondValue;
+    ULONG Argument;
 } SYSCALL_STRUCT SYSTEM_CALL_USER_LOCK, *PSYSTEM_CALL_USER_LOCK;
 
 /*++
@@ -2531,6 +2916,75 @@ typedef struct _SYSTEM_CALL_SET_RESOURCE_LIMIT {
 
 /*++
 
+Structure Description:
+
+    This structure defines the system call parameters for getting or setting
+    the scheduling nice value of a thread, process, process group, or all
+    processes belonging to a user.
+
+Members:
+
+    TargetType - Stores the type of entity the identifier refers to.
+
+    TargetId - Stores the thread, process, process group, or user ID to
+        operate on. Supply -1 to target the calling thread, process, process
+        group, or real user. Thread IDs must belong to the calling process.
+
+    Set - Stores a boolean indicating whether to get the nice value (FALSE) or
+        set it (TRUE).
+
+    NiceValue - Stores the new nice value to set for set operations on input.
+        Returns the lowest nice value among all matching threads before any
+        change was made.
+
+--*/
+
+typedef struct _SYSTEM_CALL_SET_PRIORITY {
+    PRIORITY_TARGET_TYPE TargetType;
+    LONG TargetId;
+    BOOL Set;
+    LONG NiceValue;
+} SYSCALL_STRUCT SYSTEM_CALL_SET_PRIORITY, *PSYSTEM_CALL_SET_PRIORITY;
+
+/*++
+
+Structure Description:
+
+    This structure defines the system call parameters for getting or setting
+    the set of processors a thread or all threads of a process may run on.
+
+Members:
+
+    TargetType - Stores the type of entity the identifier refers to. Only
+        thread and process targets are supported.
+
+    TargetId - Stores the thread or process ID to operate on. Supply -1 to
+        target the calling thread or process. Thread IDs must belong to the
+        calling process.
+
+    Set - Stores a boolean indicating whether to get the affinity (FALSE) or
+        set it (TRUE).
+
+    Mask - Stores a pointer to the processor bitmap, where bit N (bit N % 8 of
+        byte N / 8) corresponds to processor N. For set operations this
+        contains the new mask. For get operations this receives the current
+        mask, or the union of the masks of all threads in a process.
+
+    MaskSize - Stores the size of the mask buffer in bytes. On get operations
+        the kernel will write at most this many bytes.
+
+--*/
+
+typedef struct _SYSTEM_CALL_SET_AFFINITY {
+    PRIORITY_TARGET_TYPE TargetType;
+    LONG TargetId;
+    BOOL Set;
+    PVOID Mask;
+    UINTN MaskSize;
+} SYSCALL_STRUCT SYSTEM_CALL_SET_AFFINITY, *PSYSTEM_CALL_SET_AFFINITY;
+
+/*++
+
 Structure Description:
 
     This structure defines a union of all possible system call parameter
@@ -2608,6 +3062,14 @@ typedef union _SYSTEM_CALL_PARAMETER_UNION {
     SYSTEM_CALL_SET_ITIMER SetITimer;
     SYSTEM_CALL_SET_RESOURCE_LIMIT SetResourceLimit;
     SYSTEM_CALL_SET_BREAK SetBreak;
+    SYSTEM_CALL_SET_PRIORITY SetPriority;
+    SYSTEM_CALL_SET_AFFINITY SetAffinity;
+    SYSTEM_CALL_SET_MEMORY_ADVICE SetMemoryAdvice;
+    SYSTEM_CALL_CREATE_POLL_SET CreatePollSet;
+    SYSTEM_CALL_CONTROL_POLL_SET ControlPollSet;
+    SYSTEM_CALL_WAIT_FOR_POLL_SET WaitForPollSet;
+    SYSTEM_CALL_SEND_FILE SendFile;
+    SYSTEM_CALL_SPAWN_PROCESS SpawnProcess;
 } SYSCALL_STRUCT SYSTEM_CALL_PARAMETER_UNION, *PSYSTEM_CALL_PARAMETER_UNION;
 
 typedef
@@ -168,11 +168,14 @@ Module Name:
 #define X86_CPUID_BASIC_EAX_EXTENDED_MODEL_SHIFT 16
 #define X86_CPUID_BASIC_EAX_EXTENDED_FAMILY_MASK (0xFF << 20)
 #define X86_CPUID_BASIC_EAX_EXTENDED_FAMILY_SHIFT 20
+#define X86_CPUID_BASIC_EBX_LOGICAL_PROCESSORS_MASK (0xFF << 16)
+#define X86_CPUID_BASIC_EBX_LOGICAL_PROCESSORS_SHIFT 16
 
 #define X86_CPUID_BASIC_ECX_MONITOR (1 << 3)
 #define X86_CPUID_BASIC_EDX_SYSENTER (1 << 11)
 #define X86_CPUID_BASIC_EDX_CMOV (1 << 15)
 #define X86_CPUID_BASIC_EDX_FX_SAVE_RESTORE (1 << 24)
+#define X86_CPUID_BASIC_EDX_HYPER_THREADING (1 << 28)
 
 //
 // Define known CPU vendors.
@@ -237,6 +240,8 @@ Module Name:
 #define PTE_FLAG_DIRTY          0x00000040
 #define PTE_FLAG_LARGE_PAGE     0x00000080
 #define PTE_FLAG_GLOBAL         0x00000100
+#define PTE_FLAG_SHARED         0x00000200
+#define PTE_FLAG_BORROWED       0x00000400
 #define PTE_FLAG_ENTRY_MASK     0xFFFFF000
 #define PTE_FLAG_ENTRY_SHIFT    12
 
@@ -538,7 +543,15 @@ Structure Description:
         if CR3 is changed. If this bit is set, then the TLB entry for this page
         will not be invalidated when CR3 is reset.
 
-    Unused - These bits are unused by both the processor and the OS.
+    Shared - Stores whether or not this page directory entry points at a page
+        table that has been lent out read-only to other address spaces. This
+        bit is ignored by the processor.
+
+    Borrowed - Stores whether or not this page directory entry points at a
+        page table owned by another address space. This bit is ignored by the
+        processor.
+
+    Unused - This bit is unused by both the processor and the OS.
 
     Entry - Stores a pointer to the 4kB aligned page.
 
@@ -554,7 +567,9 @@ typedef struct _PTE {
     ULONG Dirty:1;
     ULONG LargePage:1;
     ULONG Global:1;
-    ULONG Unused:3;
+    ULONG Shared:1;
+    ULONG Borrowed:1;
+    ULONG Unused:1;
     ULONG Entry:20;
 } PACKED PTE, *PPTE;
 
@@ -783,6 +798,41 @@ Return Value:
 
 /*++
 
+Structure Description:
+
+    This structure defines the sharing state of a single user mode page table.
+    After a fork, a child borrows the parent's page tables read-only instead of
+    receiving copies, and only takes a private copy when it first needs to
+    change one.
+
+Members:
+
+    ListEntry - Stores the head of the list of borrowers if this entry belongs
+        to the owner of a shared page table, or the borrower's link in the
+        owner's list if this entry belongs to a borrower.
+
+    AddressSpace - Stores a pointer to the address space this entry belongs
+        to.
+
+    Owner - Stores a pointer to the address space that owns the page table
+        being borrowed. This is only valid for borrowers.
+
+    Reserve - Stores the physical address of the page reserved for the
+        borrower's private copy of the page table. This is only valid for
+        borrowers, and ensures that breaking the share never needs to
+        allocate.
+
+--*/
+
+typedef struct _SHARED_PAGE_TABLE {
+    LIST_ENTRY ListEntry;
+    struct _ADDRESS_SPACE_X86 *AddressSpace;
+    struct _ADDRESS_SPACE_X86 *Owner;
+    ULONG Reserve;
+} SHARED_PAGE_TABLE, *PSHARED_PAGE_TABLE;
+
+/*++
+
 Structure Description:
 
     This structure defines the architecture specific form of an address space
@@ -800,6 +850,10 @@ Structure Description:
     PageTableCount - Stores the number of page tables that were allocated on
         behalf of this process (user mode only).
 
+    SharedPageTables - Stores an optional pointer to an array of page table
+        sharing state, one for each user mode page directory entry. This is
+        allocated the first time the address space is forked or forked into.
+
 --*/
 
 typedef struct _ADDRESS_SPACE_X86 {
@@ -807,6 +861,7 @@ typedef struct _ADDRESS_SPACE_X86 {
     PPTE PageDirectory;
     ULONG PageDirectoryPhysical;
     ULONG PageTableCount;
+    struct _SHARED_PAGE_TABLE *SharedPageTables;
 } ADDRESS_SPACE_X86, *PADDRESS_SPACE_X86;
 
 //
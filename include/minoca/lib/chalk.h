@@ -469,6 +469,11 @@ Structure Description:
         over 100, it's expressed as a number over 1024 to avoid the divide.
         So 50% would be 512 for instance.
 
+    NurserySize - Stores the number of bytes that can be allocated before
+        triggering a minor garbage collection, which only examines objects
+        created since the previous collection. Set this to zero to disable
+        minor collections, so that every collection is a full one.
+
     Flags - Stores a bitfield of flags governing the operation of the
         interpreter See CK_CONFIGURATION_* definitions.
 
@@ -485,11 +490,60 @@ typedef struct _CK_CONFIGURATION {
     UINTN InitialHeapSize;
     UINTN MinimumHeapSize;
     ULONG HeapGrowthPercent;
+    UINTN NurserySize;
     ULONG Flags;
 } CK_CONFIGURATION, *PCK_CONFIGURATION;
 
 /*++
 
+Structure Description:
+
+    This structure describes the garbage collector statistics of a Chalk
+    virtual machine. Times are in microseconds of processor time.
+
+Members:
+
+    MinorCollections - Stores the number of minor collections run, which only
+        examine young objects.
+
+    FullCollections - Stores the number of full collections run.
+
+    MinorTime - Stores the total time spent in minor collections.
+
+    FullTime - Stores the total time spent in full collections.
+
+    LastPause - Stores the duration of the most recent collection.
+
+    MaxPause - Stores the duration of the longest collection.
+
+    ObjectsFreed - Stores the total number of objects freed.
+
+    ObjectsPromoted - Stores the total number of young objects that survived
+        a collection and became old.
+
+    BytesAllocated - Stores the current estimate of the live heap size, plus
+        anything allocated since the last collection.
+
+    NextFullCollection - Stores the heap size that will trigger the next full
+        collection.
+
+--*/
+
+typedef struct _CK_GARBAGE_STATISTICS {
+    ULONGLONG MinorCollections;
+    ULONGLONG FullCollections;
+    ULONGLONG MinorTime;
+    ULONGLONG FullTime;
+    ULONGLONG LastPause;
+    ULONGLONG MaxPause;
+    ULONGLONG ObjectsFreed;
+    ULONGLONG ObjectsPromoted;
+    UINTN BytesAllocated;
+    UINTN NextFullCollection;
+} CK_GARBAGE_STATISTICS, *PCK_GARBAGE_STATISTICS;
+
+/*++
+
 Structure Description:
 
     This structure describes a variable or other data object in Chalk.
@@ -657,6 +711,32 @@ Return Value:
 
 --*/
 
+CK_API
+VOID
+CkGetGarbageStatistics (
+    PCK_VM Vm,
+    PCK_GARBAGE_STATISTICS Statistics
+    );
+
+/*++
+
+Routine Description:
+
+    This routine returns the garbage collector statistics for the given Chalk
+    instance.
+
+Arguments:
+
+    Vm - Supplies a pointer to the virtual machine.
+
+    Statistics - Supplies a pointer where the statistics will be returned.
+
+Return Value:
+
+    None.
+
+--*/
+
 CK_API
 PVOID
 CkGetContext (
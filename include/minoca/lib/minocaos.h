@@ -717,6 +717,51 @@ Return Value:
 
 --*/
 
+OS_API
+KSTATUS
+OsSpawnProcess (
+    PPROCESS_ENVIRONMENT Environment,
+    PSPAWN_FILE_ACTION FileActions,
+    ULONG FileActionCount,
+    PSPAWN_ATTRIBUTES Attributes,
+    PPROCESS_ID NewProcessId
+    );
+
+/*++
+
+Routine Description:
+
+    This routine creates a new child process running the given image. This is
+    equivalent to a fork followed by an exec in the child, except that the
+    caller's address space is never copied. The call returns once the child
+    is running its new image or has failed to start it.
+
+Arguments:
+
+    Environment - Supplies a pointer to the environment of the new process,
+        which includes the image name, parameters, and environment variables.
+
+    FileActions - Supplies an optional pointer to an array of file actions to
+        perform in the child before the image is loaded.
+
+    FileActionCount - Supplies the number of elements in the file actions
+        array.
+
+    Attributes - Supplies an optional pointer to the attributes to apply to
+        the child before the image is loaded.
+
+    NewProcessId - Supplies a pointer where the ID of the child process will
+        be returned. If the child was created but failed to start the image,
+        this is still returned and a failure status is returned. In that case
+        the child exits with status 127 and must be reaped by the caller. This
+        is -1 if no child was created.
+
+Return Value:
+
+    Status code.
+
+--*/
+
 OS_API
 KSTATUS
 OsGetSystemVersion (
@@ -894,6 +939,166 @@ Return Value:
 
 --*/
 
+OS_API
+KSTATUS
+OsCreatePollSet (
+    ULONG OpenFlags,
+    PHANDLE Handle
+    );
+
+/*++
+
+Routine Description:
+
+    This routine creates a poll set, a persistent collection of I/O handles
+    that can be waited on together.
+
+Arguments:
+
+    OpenFlags - Supplies an optional bitfield of open flags for the new
+        handle. Only SYS_OPEN_FLAG_CLOSE_ON_EXECUTE is accepted.
+
+    Handle - Supplies a pointer where the handle to the new poll set will be
+        returned on success.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+OS_API
+KSTATUS
+OsControlPollSet (
+    HANDLE PollSet,
+    POLL_SET_OPERATION Operation,
+    HANDLE Descriptor,
+    PPOLL_SET_EVENT Event
+    );
+
+/*++
+
+Routine Description:
+
+    This routine adds, modifies, or removes an I/O handle in a poll set.
+
+Arguments:
+
+    PollSet - Supplies the handle to the poll set.
+
+    Operation - Supplies the operation to perform.
+
+    Descriptor - Supplies the I/O handle to add, modify, or remove.
+
+    Event - Supplies an optional pointer to the events to watch for and the
+        data to return when they occur. This is required for add and modify
+        operations.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_FILE_EXISTS if the handle being added is already in the poll set.
+
+    STATUS_NOT_FOUND if the handle being modified or removed is not in the
+    poll set.
+
+    Other error codes on failure.
+
+--*/
+
+OS_API
+KSTATUS
+OsWaitForPollSet (
+    HANDLE PollSet,
+    PSIGNAL_SET SignalMask,
+    PPOLL_SET_EVENT Events,
+    ULONG EventCount,
+    ULONG TimeoutInMilliseconds,
+    PULONG EventsReturned
+    );
+
+/*++
+
+Routine Description:
+
+    This routine waits for one or more handles in a poll set to become ready.
+
+Arguments:
+
+    PollSet - Supplies the handle to the poll set.
+
+    SignalMask - Supplies an optional pointer to a mask to set for the
+        duration of the wait.
+
+    Events - Supplies a pointer to an array where the events of the ready
+        handles will be returned.
+
+    EventCount - Supplies the number of elements in the events array.
+
+    TimeoutInMilliseconds - Supplies the number of milliseconds to wait before
+        giving up.
+
+    EventsReturned - Supplies a pointer where the number of events returned
+        will be stored on success.
+
+Return Value:
+
+    STATUS_SUCCESS if one or more handles is ready.
+
+    STATUS_INTERRUPTED if a signal was caught during the wait.
+
+    STATUS_TIMEOUT if no handles were ready in the given amount of time.
+
+    STATUS_INVALID_PARAMETER if the event count is zero or larger than
+    MAX_LONG.
+
+--*/
+
+OS_API
+KSTATUS
+OsSendFile (
+    HANDLE Destination,
+    HANDLE Source,
+    IO_OFFSET SourceOffset,
+    IO_OFFSET DestinationOffset,
+    UINTN Size,
+    PUINTN BytesCompleted
+    );
+
+/*++
+
+Routine Description:
+
+    This routine transfers data from one open handle to another without
+    copying it through user mode. When a cached file is sent to a socket, the
+    file's pages are handed to the network stack directly.
+
+Arguments:
+
+    Destination - Supplies the handle to write the data to.
+
+    Source - Supplies the handle to read the data from.
+
+    SourceOffset - Supplies the offset in the source to start reading from.
+        Supply IO_OFFSET_NONE to read from and advance the source's current
+        file position.
+
+    DestinationOffset - Supplies the offset in the destination to start
+        writing to. Supply IO_OFFSET_NONE to use the destination's current
+        file position. This must be IO_OFFSET_NONE for sockets.
+
+    Size - Supplies the number of bytes to transfer.
+
+    BytesCompleted - Supplies a pointer where the number of bytes transferred
+        will be returned.
+
+Return Value:
+
+    Status code.
+
+--*/
+
 OS_API
 PSIGNAL_HANDLER_ROUTINE
 OsSetSignalHandler (
@@ -2126,6 +2331,36 @@ Return Value:
 
 --*/
 
+OS_API
+KSTATUS
+OsSetMemoryAdvice (
+    PVOID Address,
+    UINTN Size,
+    IO_ADVICE Advice
+    );
+
+/*++
+
+Routine Description:
+
+    This routine tells the kernel how the given region of memory is expected
+    to be accessed.
+
+Arguments:
+
+    Address - Supplies the starting address of the region. This must be
+        aligned to a page boundary.
+
+    Size - Supplies the length, in bytes, of the region.
+
+    Advice - Supplies the expected access pattern.
+
+Return Value:
+
+    Status code.
+
+--*/
+
 OS_API
 KSTATUS
 OsMemoryFlush (
@@ -2297,6 +2532,96 @@ Return Value:
 
 --*/
 
+OS_API
+KSTATUS
+OsSetPriority (
+    PRIORITY_TARGET_TYPE TargetType,
+    LONG TargetId,
+    PLONG NewValue,
+    PLONG OldValue
+    );
+
+/*++
+
+Routine Description:
+
+    This routine gets or sets the scheduling nice value of a thread, process,
+    process group, or all processes belonging to a user.
+
+Arguments:
+
+    TargetType - Supplies the type of entity the identifier refers to.
+
+    TargetId - Supplies the thread, process, process group, or user ID. Supply
+        -1 to target the calling thread, process, process group, or user.
+
+    NewValue - Supplies an optional pointer to the new nice value to set. If
+        this is NULL, then a new value is not set.
+
+    OldValue - Supplies an optional pointer where the lowest nice value among
+        the matching threads will be returned.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_NO_SUCH_PROCESS if no matching process was found.
+
+    STATUS_PERMISSION_DENIED if the caller is trying to lower the nice value
+    or change another user's process and does not have the scheduling
+    permission.
+
+--*/
+
+OS_API
+KSTATUS
+OsSetAffinity (
+    PRIORITY_TARGET_TYPE TargetType,
+    LONG TargetId,
+    BOOL Set,
+    PVOID Mask,
+    UINTN MaskSize
+    );
+
+/*++
+
+Routine Description:
+
+    This routine gets or sets the set of processors a thread, or all threads
+    of a process, are allowed to run on.
+
+Arguments:
+
+    TargetType - Supplies the type of entity the identifier refers to. Only
+        thread and process targets are supported.
+
+    TargetId - Supplies the thread or process ID. Supply -1 to target the
+        calling thread or process.
+
+    Set - Supplies a boolean indicating whether to set the affinity (TRUE) or
+        get it (FALSE).
+
+    Mask - Supplies a pointer to the processor bitmap, where bit N % 8 of byte
+        N / 8 represents processor N. On set operations this contains the new
+        mask. On get operations this receives the current mask.
+
+    MaskSize - Supplies the size of the mask buffer in bytes.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_INVALID_PARAMETER if the new mask does not contain any active
+    processors, or the target type is not supported.
+
+    STATUS_NO_SUCH_THREAD or STATUS_NO_SUCH_PROCESS if the target was not
+    found.
+
+    STATUS_PERMISSION_DENIED if the caller is trying to change another user's
+    process and does not have the scheduling permission.
+
+--*/
+
 OS_API
 KSTATUS
 OsCreateTerminal (
@@ -4180,11 +4505,21 @@ Routine Description:
         UserLockWake - Wakes the number of threads given in the value that are
         blocked on the given address.
 
+        UserLockPiLock - Acquires a priority inheritance lock. The address
+        contains the kernel thread ID of the owner (or zero if the lock is
+        free), plus USER_LOCK_PI_WAITERS if there are threads blocked on it.
+        The owner runs with the priority of the best waiter until it
+        releases the lock.
+
+        UserLockPiUnlock - Releases a priority inheritance lock held by the
+        current thread, handing it directly to the first waiter.
+
     Value - Supplies a pointer whose value depends on the operation. For wait
         operations, this contains the value to check the address against. This
         is not used on output for wait operations. For wake operations, this
         contains the number of processes to wake on input. On output, contains
-        the number of processes woken.
+        the number of processes woken. This is not used for priority
+        inheritance operations.
 
     TimeoutInMilliseconds - Supplies the number of milliseconds for a wait
         operation to complete before timing out. Set to
@@ -4203,6 +4538,109 @@ Return Value:
     STATUS_INTERRUPTED if a signal arrived before a wait was completed or timed
     out.
 
+    STATUS_DEADLOCK if the current thread already owns the priority
+    inheritance lock it is trying to acquire.
+
+    STATUS_PERMISSION_DENIED if the current thread does not own the priority
+    inheritance lock it is trying to release.
+
+--*/
+
+OS_API
+KSTATUS
+OsUserLockRequeue (
+    PVOID Address,
+    ULONG Operation,
+    PULONG Value,
+    PVOID SecondAddress,
+    PULONG SecondValue,
+    ULONG Argument
+    );
+
+/*++
+
+Routine Description:
+
+    This routine wakes some of the threads blocked on one user lock and moves
+    the rest over to wait on a second user lock without waking them. This is
+    used to hand the waiters of a condition variable to its mutex one at a
+    time.
+
+Arguments:
+
+    Address - Supplies a pointer to the 32-bit lock whose waiters are woken
+        or moved.
+
+    Operation - Supplies the flags for the operation. The only valid flag is
+        USER_LOCK_PRIVATE, which applies to both addresses.
+
+    Value - Supplies a pointer that on input contains the maximum number of
+        threads to wake. On output, contains the number of threads woken.
+
+    SecondAddress - Supplies a pointer to the 32-bit lock that the remaining
+        waiters are moved to.
+
+    SecondValue - Supplies a pointer that on input contains the maximum number
+        of threads to move. On output, contains the number of threads moved.
+
+    Argument - Supplies the value the first address is expected to contain.
+        The operation fails if it does not.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_TRY_AGAIN if the first address no longer contains the expected
+    value.
+
+    Other error codes on failure.
+
+--*/
+
+OS_API
+KSTATUS
+OsUserLockWakeOperation (
+    PVOID Address,
+    ULONG Operation,
+    PULONG Value,
+    PVOID SecondAddress,
+    PULONG SecondValue,
+    ULONG Argument
+    );
+
+/*++
+
+Routine Description:
+
+    This routine atomically modifies a second user lock, wakes threads blocked
+    on the first user lock, and then wakes threads blocked on the second user
+    lock if its original value passes a comparison. This allows one lock to
+    be released and another to be signaled in a single call.
+
+Arguments:
+
+    Address - Supplies a pointer to the first 32-bit lock.
+
+    Operation - Supplies the flags for the operation. The only valid flag is
+        USER_LOCK_PRIVATE, which applies to both addresses.
+
+    Value - Supplies a pointer that on input contains the maximum number of
+        threads to wake on the first lock. On output, contains the number of
+        threads woken.
+
+    SecondAddress - Supplies a pointer to the 32-bit lock that is modified.
+
+    SecondValue - Supplies a pointer that on input contains the maximum number
+        of threads to wake on the second lock. On output, contains the number
+        of threads woken.
+
+    Argument - Supplies the operation and comparison to perform on the second
+        lock, built with the USER_LOCK_WAKE_OPERATION_ENCODE macro.
+
+Return Value:
+
+    Status code.
+
 --*/
 
 OS_API
@@ -5734,6 +5734,41 @@ Return Value:
 
 --*/
 
+RTL_API
+VOID
+RtlHeapQueryAllocation (
+    PMEMORY_HEAP Heap,
+    PVOID Memory,
+    PUINTN Size,
+    PUINTN Tag
+    );
+
+/*++
+
+Routine Description:
+
+    This routine returns the usable size and tag of an active allocation. The
+    heap lock does not need to be held, as these fields of an in-use chunk
+    only change when it is freed or reallocated.
+
+Arguments:
+
+    Heap - Supplies the heap the memory was allocated from.
+
+    Memory - Supplies the allocation created by the heap allocation routine.
+
+    Size - Supplies a pointer where the number of usable bytes in the
+        allocation will be returned. This may be larger than the size
+        originally requested.
+
+    Tag - Supplies a pointer where the allocation's tag will be returned.
+
+Return Value:
+
+    None.
+
+--*/
+
 RTL_API
 VOID
 RtlHeapProfilerGetStatistics (
@@ -188,12 +188,16 @@ typedef struct _UUID {
 
 Structure Description:
 
-    This structure defines a spin lock.
+    This structure defines a spin lock. Spin locks are ticket locks: each
+    acquirer takes the next ticket and waits for its number to come up, so
+    the lock is granted in the order it was requested.
 
 Members:
 
-    LockHeld - Stores TRUE if the lock is acquired by someone, or FALSE if the
-        lock is free.
+    NextTicket - Stores the ticket number the next acquirer will get.
+
+    NowServing - Stores the ticket number of the current lock holder. The lock
+        is free if this is equal to the next ticket.
 
     OwningThread - Stores a pointer to the KTHREAD that holds the lock if the
         lock is held.
@@ -201,7 +205,8 @@ Structure Description:
 --*/
 
 typedef struct _KSPIN_LOCK {
-    volatile ULONG LockHeld;
+    volatile ULONG NextTicket;
+    volatile ULONG NowServing;
     volatile PVOID OwningThread;
 } KSPIN_LOCK, *PKSPIN_LOCK;
 
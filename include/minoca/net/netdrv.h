@@ -192,6 +192,13 @@ Module Name:
 #define NET_ALLOCATE_BUFFER_FLAG_ADD_DATA_LINK_FOOTERS   0x00000008
 #define NET_ALLOCATE_BUFFER_FLAG_UNENCRYPTED             0x00000010
 
+//
+// Define the number of received frames a poll routine is asked to process in
+// a single call when the driver does not pick its own budget.
+//
+
+#define NET_POLL_DEFAULT_BUDGET 64
+
 //
 // Define the network packet flags.
 //
@@ -374,6 +381,10 @@ Structure Description:
         beginning of the footer data (ie the location to store the first byte
         of new footer).
 
+    SizeClass - Stores an opaque pointer to the buffer pool size class the
+        buffer is returned to when freed, or NULL if the buffer is not pooled.
+        This is owned by the networking core.
+
 --*/
 
 typedef struct _NET_PACKET_BUFFER {
@@ -386,6 +397,7 @@ typedef struct _NET_PACKET_BUFFER {
     ULONG DataSize;
     ULONG DataOffset;
     ULONG FooterOffset;
+    PVOID SizeClass;
 } NET_PACKET_BUFFER, *PNET_PACKET_BUFFER;
 
 /*++
@@ -408,6 +420,116 @@ typedef struct _NET_PACKET_LIST {
     UINTN Count;
 } NET_PACKET_LIST, *PNET_PACKET_LIST;
 
+typedef struct _NET_POLL NET_POLL, *PNET_POLL;
+typedef struct _NET_BUFFER_POOL NET_BUFFER_POOL, *PNET_BUFFER_POOL;
+
+/*++
+
+Structure Description:
+
+    This structure defines the statistics for one size class of a network
+    packet buffer pool.
+
+Members:
+
+    PoolId - Stores the identifier of the pool the size class belongs to.
+        Pool zero backs buffers allocated without a link.
+
+    Alignment - Stores the alignment of the pool's buffers, in bytes.
+
+    MaxPhysicalAddress - Stores the maximum physical address of the pool's
+        buffers.
+
+    Size - Stores the size of each buffer in the class, in bytes.
+
+    Allocations - Stores the number of buffers allocated from the class.
+
+    CacheHits - Stores the number of allocations satisfied by a processor's
+        local cache without touching the shared depot.
+
+    DepotRefills - Stores the number of times a processor cache was refilled
+        with a batch of buffers from the depot.
+
+    DepotDrains - Stores the number of times a processor cache returned a
+        batch of buffers to the depot.
+
+    NewBuffers - Stores the number of buffers created because both the
+        processor cache and the depot were empty.
+
+    CachedCount - Stores the number of free buffers currently sitting in
+        processor caches.
+
+    DepotCount - Stores the number of free buffers currently in the depot.
+
+--*/
+
+typedef struct _NET_BUFFER_STATISTICS {
+    ULONG PoolId;
+    ULONG Alignment;
+    ULONGLONG MaxPhysicalAddress;
+    ULONG Size;
+    ULONGLONG Allocations;
+    ULONGLONG CacheHits;
+    ULONGLONG DepotRefills;
+    ULONGLONG DepotDrains;
+    ULONGLONG NewBuffers;
+    ULONG CachedCount;
+    ULONG DepotCount;
+} NET_BUFFER_STATISTICS, *PNET_BUFFER_STATISTICS;
+
+typedef
+ULONG
+(*PNET_POLL_ROUTINE) (
+    PVOID Context,
+    ULONG Budget
+    );
+
+/*++
+
+Routine Description:
+
+    This routine is called by the core networking library to process received
+    frames on a device whose receive interrupts are masked. It is called at
+    low level, and never concurrently with itself for the same poll.
+
+Arguments:
+
+    Context - Supplies the context pointer supplied when the poll was created.
+
+    Budget - Supplies the maximum number of frames to process.
+
+Return Value:
+
+    Returns the number of frames processed. Returning the full budget means
+    more work may be pending and the routine will be called again. Returning
+    less means the device is idle, and the poll's completion routine is called
+    to re-enable receive interrupts.
+
+--*/
+
+typedef
+VOID
+(*PNET_POLL_COMPLETE_ROUTINE) (
+    PVOID Context
+    );
+
+/*++
+
+Routine Description:
+
+    This routine is called by the core networking library once a poll routine
+    has drained the device. The driver should unmask its receive interrupts.
+
+Arguments:
+
+    Context - Supplies the context pointer supplied when the poll was created.
+
+Return Value:
+
+    None.
+
+--*/
+
 typedef
 KSTATUS
 (*PNET_DEVICE_LINK_SEND) (
@@ -626,6 +748,9 @@ Structure Description:
     AddressTranslationTree - Stores the tree containing translations between
         network addresses and physical addresses, keyed by network address.
 
+    BufferPool - Stores a pointer to the packet buffer pool that satisfies
+        this link's DMA constraints.
+
 --*/
 
 typedef struct _NET_LINK {
@@ -640,6 +765,7 @@ typedef struct _NET_LINK {
     NET_LINK_PROPERTIES Properties;
     PKEVENT AddressTranslationEvent;
     RED_BLACK_TREE AddressTranslationTree;
+    PNET_BUFFER_POOL BufferPool;
 } NET_LINK, *PNET_LINK;
 
 typedef
@@ -2331,6 +2457,126 @@ Return Value:
 
 --*/
 
+NET_API
+VOID
+NetProcessReceivedPackets (
+    PNET_LINK Link,
+    PNET_PACKET_LIST PacketList
+    );
+
+/*++
+
+Routine Description:
+
+    This routine is called by the low level NIC driver to pass a batch of
+    received packets onto the core networking library for dispatching. This is
+    generally called from a poll routine.
+
+Arguments:
+
+    Link - Supplies a pointer to the link that received the packets.
+
+    PacketList - Supplies a pointer to the list of received packets. Each
+        packet is removed from the list before it is dispatched, and the list
+        is empty when this routine returns. The packets themselves still
+        belong to the caller.
+
+Return Value:
+
+    None. When the function returns, the memory associated with the packets
+    may be reclaimed and reused.
+
+--*/
+
+NET_API
+KSTATUS
+NetCreatePoll (
+    PNET_POLL_ROUTINE PollRoutine,
+    PNET_POLL_COMPLETE_ROUTINE CompleteRoutine,
+    PVOID Context,
+    ULONG Budget,
+    PNET_POLL *NewPoll
+    );
+
+/*++
+
+Routine Description:
+
+    This routine creates a receive poll for a network device. A driver using a
+    poll masks its receive interrupts in its interrupt handler and schedules
+    the poll, which drains received frames in batches at low level until the
+    device goes idle.
+
+Arguments:
+
+    PollRoutine - Supplies a pointer to the routine that processes received
+        frames.
+
+    CompleteRoutine - Supplies a pointer to the routine that re-enables
+        receive interrupts once the device is idle.
+
+    Context - Supplies a context pointer passed to both routines.
+
+    Budget - Supplies the maximum number of frames to process per call to the
+        poll routine. Supply 0 to use the default.
+
+    NewPoll - Supplies a pointer where a pointer to the new poll will be
+        returned on success.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+NET_API
+VOID
+NetDestroyPoll (
+    PNET_POLL Poll
+    );
+
+/*++
+
+Routine Description:
+
+    This routine destroys a receive poll. The poll routine is not running and
+    will not be called again once this routine returns. The caller must make
+    sure the poll is no longer scheduled by its interrupt handler.
+
+Arguments:
+
+    Poll - Supplies a pointer to the poll to destroy.
+
+Return Value:
+
+    None.
+
+--*/
+
+NET_API
+VOID
+NetSchedulePoll (
+    PNET_POLL Poll
+    );
+
+/*++
+
+Routine Description:
+
+    This routine schedules a receive poll to run. If the poll is already
+    scheduled or running, this routine does nothing. This routine must be
+    called at or below dispatch level.
+
+Arguments:
+
+    Poll - Supplies a pointer to the poll to schedule.
+
+Return Value:
+
+    None.
+
+--*/
+
 NET_API
 BOOL
 NetGetGlobalDebugFlag (
@@ -3236,6 +3482,38 @@ Return Value:
 
 --*/
 
+NET_API
+KSTATUS
+NetGetBufferStatistics (
+    PNET_BUFFER_STATISTICS Statistics,
+    PULONG Count
+    );
+
+/*++
+
+Routine Description:
+
+    This routine collects the statistics for every size class of every
+    network packet buffer pool.
+
+Arguments:
+
+    Statistics - Supplies an optional pointer to an array of statistics
+        structures to fill in.
+
+    Count - Supplies a pointer that on input contains the number of elements
+        in the statistics array. On output, contains the number of size classes
+        in the system.
+
+Return Value:
+
+    STATUS_SUCCESS if all size classes were returned.
+
+    STATUS_BUFFER_TOO_SMALL if the array was too small to hold them all. The
+    elements that fit are still filled in.
+
+--*/
+
 //
 // Link-specific definitions.
 //
@@ -209,6 +209,7 @@ Module Name:
 
 #define NETLINK_GENERIC_CONTROL_NAME "nlctrl"
 #define NETLINK_GENERIC_80211_NAME   "nl80211"
+#define NETLINK_GENERIC_BUFFER_NAME  "netbuf"
 
 //
 // Define the generic control command values.
@@ -293,6 +294,37 @@ Module Name:
 
 #define NETLINK_80211_MULTICAST_SCAN_NAME "scan"
 
+//
+// Define the generic network buffer command values.
+//
+
+#define NETLINK_BUFFER_COMMAND_GET_STATISTICS 1
+#define NETLINK_BUFFER_COMMAND_STATISTICS 2
+#define NETLINK_BUFFER_COMMAND_MAX 255
+
+//
+// Define the generic network buffer attributes. Each size class of each
+// buffer pool is reported in its own nested class attribute.
+//
+
+#define NETLINK_BUFFER_ATTRIBUTE_CLASS 1
+
+//
+// Define the network buffer class attributes.
+//
+
+#define NETLINK_BUFFER_CLASS_ATTRIBUTE_POOL_ID 1
+#define NETLINK_BUFFER_CLASS_ATTRIBUTE_ALIGNMENT 2
+#define NETLINK_BUFFER_CLASS_ATTRIBUTE_MAX_PHYSICAL_ADDRESS 3
+#define NETLINK_BUFFER_CLASS_ATTRIBUTE_SIZE 4
+#define NETLINK_BUFFER_CLASS_ATTRIBUTE_ALLOCATIONS 5
+#define NETLINK_BUFFER_CLASS_ATTRIBUTE_CACHE_HITS 6
+#define NETLINK_BUFFER_CLASS_ATTRIBUTE_DEPOT_REFILLS 7
+#define NETLINK_BUFFER_CLASS_ATTRIBUTE_DEPOT_DRAINS 8
+#define NETLINK_BUFFER_CLASS_ATTRIBUTE_NEW_BUFFERS 9
+#define NETLINK_BUFFER_CLASS_ATTRIBUTE_CACHED_COUNT 10
+#define NETLINK_BUFFER_CLASS_ATTRIBUTE_DEPOT_COUNT 11
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -42,6 +42,19 @@ Module Name:
 
 #define ATA_SUPPORTED_COMMAND_LBA48 (1 << 26)
 
+//
+// Define SATA capability bits.
+//
+
+#define ATA_SATA_CAPABILITY_NATIVE_COMMAND_QUEUING (1 << 8)
+
+//
+// Define the mask of the queue depth word that holds the maximum queue depth
+// minus one.
+//
+
+#define ATA_QUEUE_DEPTH_MASK 0x001F
+
 //
 // Define values that come out of the LBA1 and LBA2 registers when ATAPI or
 // SATA devices are interrogated using an ATA IDENTIFY command.
@@ -71,6 +84,29 @@ Module Name:
 #define ATA_DRIVE_SELECT_MASTER 0xA0
 #define ATA_DRIVE_SELECT_SLAVE 0xB0
 
+//
+// Set this bit in the device register of a queued write to force the data
+// through to the media before the command completes.
+//
+
+#define ATA_DRIVE_SELECT_FORCE_UNIT_ACCESS 0x80
+
+//
+// Define the shift of the tag within the sector count register of a queued
+// command.
+//
+
+#define ATA_QUEUED_TAG_SHIFT 3
+
+//
+// Define the general purpose log page that reports the last queued command
+// error, and the bits within its first byte.
+//
+
+#define ATA_LOG_NCQ_COMMAND_ERROR 0x10
+#define ATA_NCQ_ERROR_LOG_TAG_MASK 0x1F
+#define ATA_NCQ_ERROR_LOG_NOT_QUEUED 0x80
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -79,9 +115,12 @@ typedef enum _ATA_COMMAND {
     AtaCommandReadPio28         = 0x20,
     AtaCommandReadPio48         = 0x24,
     AtaCommandReadDma48         = 0x25,
+    AtaCommandReadLogExt        = 0x2F,
     AtaCommandWritePio28        = 0x30,
     AtaCommandWritePio48        = 0x34,
     AtaCommandWriteDma48        = 0x35,
+    AtaCommandReadFpdmaQueued   = 0x60,
+    AtaCommandWriteFpdmaQueued  = 0x61,
     AtaCommandPacket            = 0xA0,
     AtaCommandIdentifyPacket    = 0xA1,
     AtaCommandReadDma28         = 0xC8,
@@ -147,6 +186,9 @@ Structure Description:
 
     QueueDepth - Stores the maximum queue depth minus one.
 
+    SataCapabilities - Stores the Serial ATA capabilities of the device, such
+        as whether native command queuing is supported.
+
     MajorVersion - Stores the major version of the ATA/ATAPI protocol
         supported.
 
@@ -227,7 +269,8 @@ typedef struct _ATA_IDENTIFY_PACKET {
     USHORT MinPioTransferCyclesWithFlow;
     USHORT Reserved7[6];
     USHORT QueueDepth;
-    USHORT Reserved8[4];
+    USHORT SataCapabilities;
+    USHORT Reserved8[3];
     USHORT MajorVersion;
     USHORT MinorVersion;
     ULONG CommandSetSupported;
@@ -0,0 +1,935 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    virtio.h
+
+Abstract:
+
+    This header contains definitions for the virtio PCI transport library,
+    which is used by paravirtualized device drivers running under hypervisors
+    like KVM and QEMU.
+
+Author:
+
+    agent 16-Oct-2026
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <minoca/intrface/pci.h>
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+//
+// Define the API decorator.
+//
+
+#ifndef VIRTIO_API
+
+#define VIRTIO_API __DLLIMPORT
+
+#endif
+
+#define VIRTIO_ALLOCATION_TAG 0x74726956 // 'triV'
+
+//
+// Define the PCI vendor ID used by all virtio devices.
+//
+
+#define VIRTIO_PCI_VENDOR_ID 0x1AF4
+
+//
+// Define the PCI configuration space offsets and values used to find the
+// virtio capability structures.
+//
+
+#define VIRTIO_PCI_STATUS_OFFSET 0x06
+#define VIRTIO_PCI_STATUS_CAPABILITIES_LIST 0x0010
+#define VIRTIO_PCI_BAR_OFFSET 0x10
+#define VIRTIO_PCI_BAR_COUNT 6
+#define VIRTIO_PCI_BAR_IO_SPACE 0x00000001
+#define VIRTIO_PCI_BAR_TYPE_MASK 0x00000006
+#define VIRTIO_PCI_BAR_TYPE_64_BIT 0x00000004
+#define VIRTIO_PCI_BAR_FLAGS_MASK 0x0000000F
+#define VIRTIO_PCI_CAPABILITIES_POINTER_OFFSET 0x34
+#define VIRTIO_PCI_CAPABILITY_POINTER_MASK 0xFC
+#define VIRTIO_PCI_CAPABILITY_VENDOR_SPECIFIC 0x09
+
+//
+// Define the offsets of the fields within a virtio PCI vendor capability.
+//
+
+#define VIRTIO_PCI_CAPABILITY_ID_OFFSET 0
+#define VIRTIO_PCI_CAPABILITY_NEXT_OFFSET 1
+#define VIRTIO_PCI_CAPABILITY_TYPE_OFFSET 3
+#define VIRTIO_PCI_CAPABILITY_BAR_OFFSET 4
+#define VIRTIO_PCI_CAPABILITY_REGION_OFFSET 8
+#define VIRTIO_PCI_CAPABILITY_LENGTH_OFFSET 12
+#define VIRTIO_PCI_CAPABILITY_NOTIFY_MULTIPLIER_OFFSET 16
+
+//
+// Define the virtio PCI capability types.
+//
+
+#define VIRTIO_PCI_CAPABILITY_COMMON_CONFIGURATION 1
+#define VIRTIO_PCI_CAPABILITY_NOTIFY_CONFIGURATION 2
+#define VIRTIO_PCI_CAPABILITY_ISR_CONFIGURATION 3
+#define VIRTIO_PCI_CAPABILITY_DEVICE_CONFIGURATION 4
+
+//
+// Define the device status bits.
+//
+
+#define VIRTIO_STATUS_ACKNOWLEDGE        0x01
+#define VIRTIO_STATUS_DRIVER             0x02
+#define VIRTIO_STATUS_DRIVER_OK          0x04
+#define VIRTIO_STATUS_FEATURES_OK        0x08
+#define VIRTIO_STATUS_DEVICE_NEEDS_RESET 0x40
+#define VIRTIO_STATUS_FAILED             0x80
+
+//
+// Define the device independent feature bits.
+//
+
+#define VIRTIO_FEATURE_RING_INDIRECT_DESCRIPTORS (1ULL << 28)
+#define VIRTIO_FEATURE_RING_EVENT_INDEX          (1ULL << 29)
+#define VIRTIO_FEATURE_VERSION_1                 (1ULL << 32)
+
+//
+// Define the interrupt status register bits.
+//
+
+#define VIRTIO_ISR_QUEUE         0x01
+#define VIRTIO_ISR_CONFIGURATION 0x02
+
+//
+// Define the queue descriptor flags.
+//
+
+#define VIRTIO_DESCRIPTOR_NEXT     0x0001
+#define VIRTIO_DESCRIPTOR_WRITE    0x0002
+#define VIRTIO_DESCRIPTOR_INDIRECT 0x0004
+
+//
+// Define the available ring flags.
+//
+
+#define VIRTIO_AVAILABLE_NO_INTERRUPT 0x0001
+
+//
+// Define the used ring flags.
+//
+
+#define VIRTIO_USED_NO_NOTIFY 0x0001
+
+//
+// Define the value used to indicate no MSI-X vector is assigned.
+//
+
+#define VIRTIO_MSI_NO_VECTOR 0xFFFF
+
+//
+// Define the maximum number of entries the library will use in a queue.
+//
+
+#define VIRTIO_MAX_QUEUE_SIZE 256
+
+//
+// Define the required alignments of the queue structures.
+//
+
+#define VIRTIO_DESCRIPTOR_ALIGNMENT 16
+#define VIRTIO_AVAILABLE_ALIGNMENT 2
+#define VIRTIO_USED_ALIGNMENT 4
+
+//
+// Define the number of register regions a virtio device maps.
+//
+
+#define VIRTIO_REGION_COUNT 4
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+typedef enum _VIRTIO_COMMON_REGISTER {
+    VirtioCommonDeviceFeatureSelect = 0x00,
+    VirtioCommonDeviceFeature       = 0x04,
+    VirtioCommonDriverFeatureSelect = 0x08,
+    VirtioCommonDriverFeature       = 0x0C,
+    VirtioCommonMsixConfiguration   = 0x10,
+    VirtioCommonQueueCount          = 0x12,
+    VirtioCommonDeviceStatus        = 0x14,
+    VirtioCommonConfigGeneration    = 0x15,
+    VirtioCommonQueueSelect         = 0x16,
+    VirtioCommonQueueSize           = 0x18,
+    VirtioCommonQueueMsixVector     = 0x1A,
+    VirtioCommonQueueEnable         = 0x1C,
+    VirtioCommonQueueNotifyOffset   = 0x1E,
+    VirtioCommonQueueDescriptorLow  = 0x20,
+    VirtioCommonQueueDescriptorHigh = 0x24,
+    VirtioCommonQueueAvailableLow   = 0x28,
+    VirtioCommonQueueAvailableHigh  = 0x2C,
+    VirtioCommonQueueUsedLow        = 0x30,
+    VirtioCommonQueueUsedHigh       = 0x34
+} VIRTIO_COMMON_REGISTER, *PVIRTIO_COMMON_REGISTER;
+
+typedef enum _VIRTIO_REGION {
+    VirtioRegionCommon,
+    VirtioRegionNotify,
+    VirtioRegionIsr,
+    VirtioRegionDevice
+} VIRTIO_REGION, *PVIRTIO_REGION;
+
+/*++
+
+Structure Description:
+
+    This structure defines a virtio queue descriptor.
+
+Members:
+
+    Address - Stores the physical address of the buffer.
+
+    Length - Stores the length of the buffer in bytes.
+
+    Flags - Stores a bitfield of flags. See VIRTIO_DESCRIPTOR_* definitions.
+
+    Next - Stores the index of the next descriptor in the chain if the next
+        flag is set.
+
+--*/
+
+typedef struct _VIRTIO_DESCRIPTOR {
+    ULONGLONG Address;
+    ULONG Length;
+    USHORT Flags;
+    USHORT Next;
+} PACKED VIRTIO_DESCRIPTOR, *PVIRTIO_DESCRIPTOR;
+
+/*++
+
+Structure Description:
+
+    This structure defines the virtio available ring, which the driver uses to
+    hand descriptor chains to the device.
+
+Members:
+
+    Flags - Stores a bitfield of flags. See VIRTIO_AVAILABLE_* definitions.
+
+    Index - Stores the index where the driver will put the next entry,
+        modulo the queue size. This only ever increments.
+
+    Ring - Stores the array of descriptor chain heads.
+
+--*/
+
+typedef struct _VIRTIO_AVAILABLE_RING {
+    USHORT Flags;
+    USHORT Index;
+    USHORT Ring[ANYSIZE_ARRAY];
+} PACKED VIRTIO_AVAILABLE_RING, *PVIRTIO_AVAILABLE_RING;
+
+/*++
+
+Structure Description:
+
+    This structure defines an element of the virtio used ring.
+
+Members:
+
+    Id - Stores the index of the head of the descriptor chain that completed.
+
+    Length - Stores the number of bytes the device wrote into the buffers of
+        the descriptor chain.
+
+--*/
+
+typedef struct _VIRTIO_USED_ELEMENT {
+    ULONG Id;
+    ULONG Length;
+} PACKED VIRTIO_USED_ELEMENT, *PVIRTIO_USED_ELEMENT;
+
+/*++
+
+Structure Description:
+
+    This structure defines the virtio used ring, which the device uses to hand
+    completed descriptor chains back to the driver.
+
+Members:
+
+    Flags - Stores a bitfield of flags. See VIRTIO_USED_* definitions.
+
+    Index - Stores the index where the device will put the next entry, modulo
+        the queue size. This only ever increments.
+
+    Ring - Stores the array of completed elements.
+
+--*/
+
+typedef struct _VIRTIO_USED_RING {
+    USHORT Flags;
+    USHORT Index;
+    VIRTIO_USED_ELEMENT Ring[ANYSIZE_ARRAY];
+} PACKED VIRTIO_USED_RING, *PVIRTIO_USED_RING;
+
+/*++
+
+Structure Description:
+
+    This structure defines a single physically contiguous buffer handed to a
+    virtio queue.
+
+Members:
+
+    Address - Stores the physical address of the buffer.
+
+    Length - Stores the length of the buffer in bytes.
+
+--*/
+
+typedef struct _VIRTIO_BUFFER {
+    PHYSICAL_ADDRESS Address;
+    ULONG Length;
+} VIRTIO_BUFFER, *PVIRTIO_BUFFER;
+
+typedef struct _VIRTIO_DEVICE VIRTIO_DEVICE, *PVIRTIO_DEVICE;
+
+/*++
+
+Structure Description:
+
+    This structure defines a virtio split virtqueue. The library does not
+    synchronize access to a queue, callers must serialize all operations on a
+    given queue.
+
+Members:
+
+    Device - Stores a pointer to the device that owns the queue.
+
+    Index - Stores the queue index within the device.
+
+    Size - Stores the number of descriptors in the queue. This is always a
+        power of two.
+
+    FreeCount - Stores the number of descriptors not currently handed to the
+        device.
+
+    FreeHead - Stores the index of the first free descriptor.
+
+    AvailableIndex - Stores the driver's copy of the available ring index.
+
+    LastUsedIndex - Stores the index of the next used ring element the driver
+        has not yet processed.
+
+    IoBuffer - Stores a pointer to the I/O buffer backing the rings.
+
+    Descriptors - Stores a pointer to the descriptor table.
+
+    Available - Stores a pointer to the available ring.
+
+    Used - Stores a pointer to the used ring.
+
+    NotifyAddress - Stores the virtual address of the register written to
+        notify the device of new available buffers.
+
+    Cookies - Stores an array of caller context pointers, indexed by the head
+        descriptor of each outstanding chain.
+
+--*/
+
+typedef struct _VIRTIO_QUEUE {
+    PVIRTIO_DEVICE Device;
+    USHORT Index;
+    USHORT Size;
+    USHORT FreeCount;
+    USHORT FreeHead;
+    USHORT AvailableIndex;
+    USHORT LastUsedIndex;
+    PIO_BUFFER IoBuffer;
+    PVIRTIO_DESCRIPTOR Descriptors;
+    PVIRTIO_AVAILABLE_RING Available;
+    volatile VIRTIO_USED_RING *Used;
+    PVOID NotifyAddress;
+    PVOID *Cookies;
+} VIRTIO_QUEUE, *PVIRTIO_QUEUE;
+
+/*++
+
+Structure Description:
+
+    This structure defines a virtio register region mapped from one of the
+    device's BARs.
+
+Members:
+
+    Base - Stores the virtual address of the start of the region.
+
+    Mapping - Stores the page aligned virtual address of the mapping that
+        contains the region.
+
+    MappingSize - Stores the size of the mapping in bytes.
+
+    Length - Stores the length of the region in bytes.
+
+--*/
+
+typedef struct _VIRTIO_REGION_MAPPING {
+    PVOID Base;
+    PVOID Mapping;
+    UINTN MappingSize;
+    ULONG Length;
+} VIRTIO_REGION_MAPPING, *PVIRTIO_REGION_MAPPING;
+
+/*++
+
+Structure Description:
+
+    This structure defines the transport state of a virtio PCI device. Device
+    drivers embed this structure in their own context.
+
+Members:
+
+    OsDevice - Stores a pointer to the OS device object.
+
+    PciConfigInterface - Stores the interface to access PCI configuration
+        space.
+
+    PciConfigInterfaceAvailable - Stores a boolean indicating if the PCI
+        config interface is actively available.
+
+    RegisteredForPciConfigInterfaces - Stores a boolean indicating whether or
+        not the driver has registered for PCI Configuration Space interface
+        access.
+
+    Regions - Stores the mapped register regions, indexed by VIRTIO_REGION.
+
+    NotifyOffsetMultiplier - Stores the multiplier applied to a queue's notify
+        offset to get the offset of its notify register.
+
+    PciMsiInterface - Stores the interface to program the device's message
+        signaled interrupts.
+
+    PciMsiInterfaceAvailable - Stores a boolean indicating if the PCI MSI
+        interface is actively available.
+
+    RegisteredForPciMsiInterfaces - Stores a boolean indicating whether or not
+        the driver has registered for PCI MSI interface access.
+
+    InterruptLine - Stores the interrupt line the device is connected to, or
+        INVALID_INTERRUPT_LINE if the device uses MSI-X.
+
+    InterruptVector - Stores the interrupt vector the device interrupts on.
+        When MSI-X is in use, this is the first of a contiguous block of
+        vectors, and MSI-X table entry N is wired to this vector plus N.
+
+    MessageVectorCount - Stores the number of MSI-X vectors allocated to the
+        device, or zero if the device uses its legacy interrupt line.
+
+    InterruptResourcesFound - Stores a boolean indicating whether or not the
+        interrupt line and vector were found.
+
+    QueueCount - Stores the number of queues the device supports.
+
+    Features - Stores the negotiated feature bits.
+
+--*/
+
+struct _VIRTIO_DEVICE {
+    PDEVICE OsDevice;
+    INTERFACE_PCI_CONFIG_ACCESS PciConfigInterface;
+    BOOL PciConfigInterfaceAvailable;
+    BOOL RegisteredForPciConfigInterfaces;
+    VIRTIO_REGION_MAPPING Regions[VIRTIO_REGION_COUNT];
+    ULONG NotifyOffsetMultiplier;
+    INTERFACE_PCI_MSI PciMsiInterface;
+    BOOL PciMsiInterfaceAvailable;
+    BOOL RegisteredForPciMsiInterfaces;
+    ULONGLONG InterruptLine;
+    ULONGLONG InterruptVector;
+    ULONG MessageVectorCount;
+    BOOL InterruptResourcesFound;
+    ULONG QueueCount;
+    ULONGLONG Features;
+};
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// -------------------------------------------------------- Function Prototypes
+//
+
+VIRTIO_API
+VOID
+VirtioInitializeDevice (
+    PVIRTIO_DEVICE Device,
+    PDEVICE OsDevice
+    );
+
+/*++
+
+Routine Description:
+
+    This routine initializes the transport state of a virtio device. It should
+    be called when the driver is attached to the device.
+
+Arguments:
+
+    Device - Supplies a pointer to the virtio device to initialize.
+
+    OsDevice - Supplies a pointer to the OS device.
+
+Return Value:
+
+    None.
+
+--*/
+
+VIRTIO_API
+KSTATUS
+VirtioProcessResourceRequirements (
+    PVIRTIO_DEVICE Device,
+    PIRP Irp,
+    ULONG MinimumVectorCount,
+    ULONG MaximumVectorCount
+    );
+
+/*++
+
+Routine Description:
+
+    This routine filters through the resource requirements presented by the
+    bus for a virtio device. It registers for PCI configuration space and MSI
+    access. If the device supports MSI-X with enough table entries, it asks
+    for a block of message signaled interrupt vectors, with a vector for the
+    legacy interrupt line as the alternative. Otherwise it adds an interrupt
+    vector requirement for any interrupt line requested.
+
+Arguments:
+
+    Device - Supplies a pointer to the virtio device.
+
+    Irp - Supplies a pointer to the query resources I/O request packet.
+
+    MinimumVectorCount - Supplies the fewest MSI-X vectors the driver can make
+        use of. If the device has fewer, the legacy interrupt line is used.
+
+    MaximumVectorCount - Supplies the most MSI-X vectors the driver can make
+        use of. Supply zero to always use the legacy interrupt line.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+VIRTIO_API
+KSTATUS
+VirtioStartDevice (
+    PVIRTIO_DEVICE Device,
+    PIRP Irp
+    );
+
+/*++
+
+Routine Description:
+
+    This routine starts a virtio device. It finds the interrupt resources,
+    maps the register regions described by the PCI capabilities, resets the
+    device, and acknowledges it. If MSI-X vectors were allocated, they are
+    programmed into the device's MSI-X table and MSI-X is enabled.
+
+Arguments:
+
+    Device - Supplies a pointer to the virtio device.
+
+    Irp - Supplies a pointer to the start device I/O request packet.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+VIRTIO_API
+KSTATUS
+VirtioNegotiateFeatures (
+    PVIRTIO_DEVICE Device,
+    ULONGLONG DriverFeatures
+    );
+
+/*++
+
+Routine Description:
+
+    This routine negotiates the feature bits with the device. The negotiated
+    set is stored in the device structure.
+
+Arguments:
+
+    Device - Supplies a pointer to the virtio device.
+
+    DriverFeatures - Supplies the set of features the driver supports. The
+        version 1 feature is always requested.
+
+Return Value:
+
+    STATUS_SUCCESS if the device accepted the features.
+
+    STATUS_NOT_SUPPORTED if the device does not support the modern interface
+    or rejected the feature set.
+
+--*/
+
+VIRTIO_API
+VOID
+VirtioSetDriverReady (
+    PVIRTIO_DEVICE Device
+    );
+
+/*++
+
+Routine Description:
+
+    This routine tells the device that the driver has finished setting it up
+    and is ready to drive it.
+
+Arguments:
+
+    Device - Supplies a pointer to the virtio device.
+
+Return Value:
+
+    None.
+
+--*/
+
+VIRTIO_API
+VOID
+VirtioResetDevice (
+    PVIRTIO_DEVICE Device
+    );
+
+/*++
+
+Routine Description:
+
+    This routine resets a virtio device, stopping all queue activity.
+
+Arguments:
+
+    Device - Supplies a pointer to the virtio device.
+
+Return Value:
+
+    None.
+
+--*/
+
+VIRTIO_API
+VOID
+VirtioReadDeviceConfiguration (
+    PVIRTIO_DEVICE Device,
+    ULONG Offset,
+    PVOID Buffer,
+    ULONG Size
+    );
+
+/*++
+
+Routine Description:
+
+    This routine reads from the device specific configuration region,
+    retrying until a consistent snapshot is read.
+
+Arguments:
+
+    Device - Supplies a pointer to the virtio device.
+
+    Offset - Supplies the byte offset into the device configuration to read.
+
+    Buffer - Supplies a pointer where the configuration data will be returned.
+
+    Size - Supplies the number of bytes to read.
+
+Return Value:
+
+    None. The buffer is zeroed if the region is not large enough.
+
+--*/
+
+VIRTIO_API
+ULONG
+VirtioReadInterruptStatus (
+    PVIRTIO_DEVICE Device
+    );
+
+/*++
+
+Routine Description:
+
+    This routine reads and acknowledges the device's interrupt status. It is
+    safe to call from an interrupt service routine.
+
+Arguments:
+
+    Device - Supplies a pointer to the virtio device.
+
+Return Value:
+
+    Returns the interrupt status bits. See VIRTIO_ISR_* definitions.
+
+--*/
+
+VIRTIO_API
+KSTATUS
+VirtioCreateQueue (
+    PVIRTIO_DEVICE Device,
+    USHORT Index,
+    USHORT MaxSize,
+    USHORT MessageVector,
+    PVIRTIO_QUEUE *NewQueue
+    );
+
+/*++
+
+Routine Description:
+
+    This routine creates and enables a virtio queue. It must be called after
+    features are negotiated and before the driver is marked ready.
+
+Arguments:
+
+    Device - Supplies a pointer to the virtio device.
+
+    Index - Supplies the index of the queue to create.
+
+    MaxSize - Supplies the maximum number of descriptors the caller wants in
+        the queue. The queue may be smaller if the device supports fewer.
+
+    MessageVector - Supplies the index of the MSI-X vector the queue should
+        interrupt on, or VIRTIO_MSI_NO_VECTOR for none. This is ignored if
+        the device is using its legacy interrupt line.
+
+    NewQueue - Supplies a pointer where a pointer to the new queue will be
+        returned on success.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+VIRTIO_API
+KSTATUS
+VirtioSetConfigurationVector (
+    PVIRTIO_DEVICE Device,
+    USHORT MessageVector
+    );
+
+/*++
+
+Routine Description:
+
+    This routine sets the MSI-X vector the device interrupts on when its
+    configuration changes. It does nothing if the device is using its legacy
+    interrupt line.
+
+Arguments:
+
+    Device - Supplies a pointer to the virtio device.
+
+    MessageVector - Supplies the index of the MSI-X vector to use, or
+        VIRTIO_MSI_NO_VECTOR for none.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_INSUFFICIENT_RESOURCES if the device could not map the vector.
+
+--*/
+
+VIRTIO_API
+VOID
+VirtioDestroyQueue (
+    PVIRTIO_QUEUE Queue
+    );
+
+/*++
+
+Routine Description:
+
+    This routine destroys a virtio queue. The device must be reset before the
+    queue is destroyed.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue to destroy.
+
+Return Value:
+
+    None.
+
+--*/
+
+VIRTIO_API
+KSTATUS
+VirtioQueueAddBuffers (
+    PVIRTIO_QUEUE Queue,
+    PVIRTIO_BUFFER Buffers,
+    ULONG OutCount,
+    ULONG InCount,
+    PVOID Cookie
+    );
+
+/*++
+
+Routine Description:
+
+    This routine adds a chain of buffers to a virtio queue. The device is not
+    notified until the caller calls the notify routine.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+    Buffers - Supplies an array of buffers. The device reads from the first
+        out count buffers and writes to the in count buffers following them.
+
+    OutCount - Supplies the number of device readable buffers.
+
+    InCount - Supplies the number of device writable buffers.
+
+    Cookie - Supplies a context pointer returned when the chain is used.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_RESOURCE_IN_USE if there are not enough free descriptors.
+
+--*/
+
+VIRTIO_API
+VOID
+VirtioQueueNotify (
+    PVIRTIO_QUEUE Queue
+    );
+
+/*++
+
+Routine Description:
+
+    This routine notifies the device that new buffers are available in the
+    queue, unless the device has asked not to be notified.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+Return Value:
+
+    None.
+
+--*/
+
+VIRTIO_API
+BOOL
+VirtioQueueGetUsedBuffer (
+    PVIRTIO_QUEUE Queue,
+    PVOID *Cookie,
+    PULONG Length
+    );
+
+/*++
+
+Routine Description:
+
+    This routine removes the next completed buffer chain from the queue and
+    frees its descriptors.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+    Cookie - Supplies a pointer where the cookie given when the chain was
+        added will be returned.
+
+    Length - Supplies a pointer where the number of bytes the device wrote to
+        the chain will be returned.
+
+Return Value:
+
+    TRUE if a used buffer was returned.
+
+    FALSE if the device has not completed any more buffers.
+
+--*/
+
+VIRTIO_API
+VOID
+VirtioQueueDisableInterrupts (
+    PVIRTIO_QUEUE Queue
+    );
+
+/*++
+
+Routine Description:
+
+    This routine asks the device not to interrupt when it uses buffers from
+    the given queue. This is only a hint to the device.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+Return Value:
+
+    None.
+
+--*/
+
+VIRTIO_API
+BOOL
+VirtioQueueEnableInterrupts (
+    PVIRTIO_QUEUE Queue
+    );
+
+/*++
+
+Routine Description:
+
+    This routine asks the device to interrupt when it uses buffers from the
+    given queue.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+Return Value:
+
+    TRUE if the device used more buffers before interrupts were enabled, in
+    which case the caller should process them since no interrupt may come.
+
+    FALSE if there is no pending work.
+
+--*/
+
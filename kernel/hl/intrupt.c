@@ -933,6 +933,111 @@ Return Value:
     return;
 }
 
+KSTATUS
+HlSetInterruptLineTarget (
+    PKINTERRUPT Interrupt,
+    PPROCESSOR_SET Target
+    )
+
+/*++
+
+Routine Description:
+
+    This routine changes the set of processors an enabled interrupt line is
+    delivered to. Since the line is shared by every interrupt connected to it,
+    this affects all of them.
+
+Arguments:
+
+    Interrupt - Supplies a pointer to an interrupt whose line has been enabled.
+
+    Target - Supplies a pointer to the set of processors the line should
+        target.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_NOT_SUPPORTED if the interrupt does not have an enabled line on a
+    primary interrupt controller.
+
+    Other error codes if the controller could not be reprogrammed.
+
+--*/
+
+{
+
+    PINTERRUPT_CONTROLLER Controller;
+    ULONG LineOffset;
+    PINTERRUPT_LINES Lines;
+    INTERRUPT_LINE_STATE OldState;
+    PINTERRUPT_LINE_STATE State;
+    KSTATUS Status;
+
+    HlpInterruptAcquireLock();
+    if (Interrupt->Line.Type != InterruptLineControllerSpecified) {
+        Status = STATUS_NOT_SUPPORTED;
+        goto SetInterruptLineTargetEnd;
+    }
+
+    Status = HlpInterruptFindLines(&(Interrupt->Line),
+                                   &Controller,
+                                   &Lines,
+                                   &LineOffset);
+
+    if (!KSUCCESS(Status)) {
+        goto SetInterruptLineTargetEnd;
+    }
+
+    //
+    // Lines on secondary controllers come in through their parent's line, so
+    // they cannot be steered individually.
+    //
+
+    State = &(Lines->State[LineOffset].PublicState);
+    if (((State->Flags & INTERRUPT_LINE_STATE_FLAG_ENABLED) == 0) ||
+        (Controller->RunLevel != RunLevelCount)) {
+
+        Status = STATUS_NOT_SUPPORTED;
+        goto SetInterruptLineTargetEnd;
+    }
+
+    RtlCopyMemory(&OldState, State, sizeof(INTERRUPT_LINE_STATE));
+    Status = HlpInterruptConvertProcessorSetToInterruptTarget(Target,
+                                                              &(State->Target));
+
+    if (!KSUCCESS(Status)) {
+        goto SetInterruptLineTargetEnd;
+    }
+
+    //
+    // Lowest priority delivery only makes sense when there is a choice of
+    // processors.
+    //
+
+    if (Target->Target == ProcessorTargetSingleProcessor) {
+        State->Flags &= ~INTERRUPT_LINE_STATE_FLAG_LOWEST_PRIORITY;
+
+    } else {
+        State->Flags |= INTERRUPT_LINE_STATE_FLAG_LOWEST_PRIORITY;
+    }
+
+    Status = Controller->FunctionTable.SetLineState(Controller->PrivateContext,
+                                                    &(Interrupt->Line),
+                                                    State,
+                                                    NULL,
+                                                    0);
+
+    if (!KSUCCESS(Status)) {
+        RtlCopyMemory(State, &OldState, sizeof(INTERRUPT_LINE_STATE));
+        goto SetInterruptLineTargetEnd;
+    }
+
+SetInterruptLineTargetEnd:
+    HlpInterruptReleaseLock();
+    return Status;
+}
+
 KERNEL_API
 KSTATUS
 HlGetMsiInformation (
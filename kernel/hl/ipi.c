@@ -190,6 +190,51 @@ Return Value:
     return STATUS_NOT_FOUND;
 }
 
+KERNEL_API
+KSTATUS
+HlGetProcessorPhysicalId (
+    ULONG ProcessorIndex,
+    PULONGLONG PhysicalId
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the physical identifier of the processor with the
+    given logical processor index, as described by the firmware tables.
+
+Arguments:
+
+    ProcessorIndex - Supplies the logical processor index.
+
+    PhysicalId - Supplies a pointer where the processor physical identifier
+        will be returned on success.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_NOT_FOUND if the processor is not known to the hardware layer.
+
+--*/
+
+{
+
+    if ((HlProcessorTargets == NULL) || (ProcessorIndex >= HlMaxProcessors)) {
+        return STATUS_NOT_FOUND;
+    }
+
+    if ((HlProcessorTargets[ProcessorIndex].Flags &
+         PROCESSOR_ADDRESSING_FLAG_PRESENT) == 0) {
+
+        return STATUS_NOT_FOUND;
+    }
+
+    *PhysicalId = HlProcessorTargets[ProcessorIndex].PhysicalId;
+    return STATUS_SUCCESS;
+}
+
 KSTATUS
 HlSendIpi (
     IPI_TYPE IpiType,
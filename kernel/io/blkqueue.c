@@ -0,0 +1,1482 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    blkqueue.c
+
+Abstract:
+
+    This module implements the block device request queue. Reads and writes to
+    block devices pass through a per-device queue that limits how many
+    requests are at the device at once. Requests that arrive while the device
+    is busy wait in the queue, where they are ordered by the queue's policy
+    and merged with requests for adjacent blocks into a single larger IRP.
+
+    I/O submission is synchronous, so each waiting request is owned by a
+    blocked thread. When the queue picks a request to go next, it wakes that
+    thread, which sends the IRP on behalf of itself and every request merged
+    into it.
+
+Author:
+
+    agent 16-Oct-2026
+
+Environment:
+
+    Kernel
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <minoca/kernel/kernel.h>
+#include "iop.h"
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+#define IO_BLOCK_QUEUE_ALLOCATION_TAG 0x516B6C42 // 'QklB'
+
+//
+// Define the default number of requests a block queue lets through to the
+// device at once.
+//
+
+#define IO_BLOCK_QUEUE_DEFAULT_DEPTH 4
+
+//
+// Define the limits on how large a merged request can grow.
+//
+
+#define IO_BLOCK_QUEUE_MAX_MERGE_SIZE _512KB
+#define IO_BLOCK_QUEUE_MAX_MERGE_COUNT 32
+
+//
+// Define how long, in milliseconds, an idle queue stays plugged waiting for
+// more requests to arrive, and how many requests unplug it early.
+//
+
+#define IO_BLOCK_QUEUE_PLUG_TIMEOUT 1
+#define IO_BLOCK_QUEUE_UNPLUG_COUNT 4
+
+//
+// Define the number of submissions an idle queue continues to plug for after
+// it last saw requests contend with each other. A queue that only ever sees
+// one request at a time stops plugging, since there is nothing to merge.
+//
+
+#define IO_BLOCK_QUEUE_CONTENTION_WINDOW 16
+
+//
+// Define how long, in milliseconds, the deadline policy lets reads and writes
+// wait before dispatching them ahead of the sorted order.
+//
+
+#define IO_BLOCK_QUEUE_READ_EXPIRE 500
+#define IO_BLOCK_QUEUE_WRITE_EXPIRE 5000
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+typedef enum _IO_BLOCK_REQUEST_STATE {
+    IoBlockRequestPending,
+    IoBlockRequestMerged,
+    IoBlockRequestDispatched,
+    IoBlockRequestComplete
+} IO_BLOCK_REQUEST_STATE, *PIO_BLOCK_REQUEST_STATE;
+
+/*++
+
+Structure Description:
+
+    This structure defines a block device request queue.
+
+Members:
+
+    ListEntry - Stores pointers to the next and previous queues in the global
+        list.
+
+    Device - Stores a pointer to the device the queue belongs to.
+
+    Lock - Stores a pointer to the lock that protects the queue.
+
+    SortedListHead - Stores the head of the list of pending requests, sorted
+        by device offset.
+
+    FifoListHead - Stores the head of the list of pending requests, in the
+        order they arrived.
+
+    Policy - Stores the scheduling policy of the queue.
+
+    Depth - Stores the maximum number of requests sent to the device at once.
+
+    InFlight - Stores the number of requests currently at the device.
+
+    PendingCount - Stores the number of requests on the pending lists. This
+        does not count requests merged into another request.
+
+    LastOffset - Stores the device offset just after the last request sent to
+        the device, which is where the deadline policy's sweep continues from.
+
+    Plugged - Stores a boolean indicating if the queue is holding requests
+        back to give adjacent requests a chance to arrive.
+
+    Contention - Stores a countdown of idle submissions left before the queue
+        stops plugging. This is refreshed whenever a request has to wait.
+
+    ReadExpire - Stores the deadline for reads, in time counter ticks.
+
+    WriteExpire - Stores the deadline for writes, in time counter ticks.
+
+    Statistics - Stores the queue statistics. The times are kept in time
+        counter ticks and converted when they are queried.
+
+--*/
+
+struct _IO_BLOCK_QUEUE {
+    LIST_ENTRY ListEntry;
+    PDEVICE Device;
+    PQUEUED_LOCK Lock;
+    LIST_ENTRY SortedListHead;
+    LIST_ENTRY FifoListHead;
+    IO_BLOCK_QUEUE_POLICY Policy;
+    ULONG Depth;
+    ULONG InFlight;
+    ULONG PendingCount;
+    IO_OFFSET LastOffset;
+    BOOL Plugged;
+    ULONG Contention;
+    ULONGLONG ReadExpire;
+    ULONGLONG WriteExpire;
+    IO_BLOCK_QUEUE_STATISTICS_ENTRY Statistics;
+};
+
+/*++
+
+Structure Description:
+
+    This structure defines a request in a block queue. It lives on the stack
+    of the thread that submitted it.
+
+Members:
+
+    ListEntry - Stores pointers to the next and previous pending requests in
+        the queue's sorted list.
+
+    FifoListEntry - Stores pointers to the next and previous pending requests
+        in the queue's arrival order list.
+
+    MemberListHead - Stores the head of the list of requests that will be sent
+        together with this one, sorted by offset. This includes the request
+        itself. It is only used while the request is pending.
+
+    MemberListEntry - Stores pointers to the next and previous requests in
+        the member list this request belongs to.
+
+    MinorCode - Stores the minor code of the request, either read or write.
+
+    Parameters - Stores a pointer to the caller's read/write parameters.
+
+    Offset - Stores the device offset of the first member of the request.
+
+    Size - Stores the combined size of all members of the request.
+
+    MemberCount - Stores the number of members in the request.
+
+    Mergeable - Stores a boolean indicating if the request's buffer is made of
+        whole page cache pages, which allows it to be combined with other
+        requests into a single I/O buffer.
+
+    SubmitTime - Stores the time counter value when the request was
+        submitted.
+
+    DispatchTime - Stores the time counter value when the queue picked the
+        request to go to the device.
+
+    Deadline - Stores the time counter value after which the deadline policy
+        dispatches the request ahead of others.
+
+    Event - Stores a pointer to the event the owning thread waits on. This is
+        NULL if the owning thread never needed to wait.
+
+    State - Stores the state of the request.
+
+    Status - Stores the final status of the request.
+
+--*/
+
+typedef struct _IO_BLOCK_REQUEST {
+    LIST_ENTRY ListEntry;
+    LIST_ENTRY FifoListEntry;
+    LIST_ENTRY MemberListHead;
+    LIST_ENTRY MemberListEntry;
+    IRP_MINOR_CODE MinorCode;
+    PIRP_READ_WRITE Parameters;
+    IO_OFFSET Offset;
+    ULONGLONG Size;
+    ULONG MemberCount;
+    BOOL Mergeable;
+    ULONGLONG SubmitTime;
+    ULONGLONG DispatchTime;
+    ULONGLONG Deadline;
+    PKEVENT Event;
+    volatile IO_BLOCK_REQUEST_STATE State;
+    KSTATUS Status;
+} IO_BLOCK_REQUEST, *PIO_BLOCK_REQUEST;
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+PIO_BLOCK_QUEUE
+IopGetBlockQueue (
+    PDEVICE Device
+    );
+
+BOOL
+IopIsBlockRequestMergeable (
+    PIRP_READ_WRITE Parameters
+    );
+
+BOOL
+IopMergeBlockRequest (
+    PIO_BLOCK_QUEUE Queue,
+    PIO_BLOCK_REQUEST Request
+    );
+
+VOID
+IopInsertBlockRequest (
+    PIO_BLOCK_QUEUE Queue,
+    PIO_BLOCK_REQUEST Request
+    );
+
+VOID
+IopRunBlockQueue (
+    PIO_BLOCK_QUEUE Queue
+    );
+
+PIO_BLOCK_REQUEST
+IopSelectBlockRequest (
+    PIO_BLOCK_QUEUE Queue
+    );
+
+ULONG
+IopDispatchBlockRequest (
+    PIO_BLOCK_QUEUE Queue,
+    PIO_BLOCK_REQUEST Request
+    );
+
+VOID
+IopCompleteBlockRequest (
+    PIO_BLOCK_QUEUE Queue,
+    PIO_BLOCK_REQUEST Request,
+    ULONG DispatchCount
+    );
+
+ULONGLONG
+IopConvertBlockQueueTime (
+    ULONGLONG Ticks,
+    ULONGLONG Frequency
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// Store the list of block queues and the lock that protects it.
+//
+
+LIST_ENTRY IoBlockQueueList;
+PQUEUED_LOCK IoBlockQueueListLock;
+
+//
+// Store the depth and policy given to new block queues.
+//
+
+ULONG IoBlockQueueDefaultDepth = IO_BLOCK_QUEUE_DEFAULT_DEPTH;
+IO_BLOCK_QUEUE_POLICY IoBlockQueueDefaultPolicy = IoBlockQueuePolicyDeadline;
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+KSTATUS
+IopQueueBlockIo (
+    PDEVICE Device,
+    IRP_MINOR_CODE MinorCodeNumber,
+    PIRP_READ_WRITE Request
+    )
+
+/*++
+
+Routine Description:
+
+    This routine submits a read or write request to a block device through the
+    device's request queue, and waits for it to complete. The request may be
+    held briefly, sorted against other outstanding requests, and merged with
+    requests for adjacent blocks before it is sent to the device.
+
+Arguments:
+
+    Device - Supplies a pointer to the block device.
+
+    MinorCodeNumber - Supplies the minor code number of the request, either
+        read or write.
+
+    Request - Supplies a pointer that on input contains the I/O request
+        parameters. On output, receives the completed parameters.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    IO_BLOCK_REQUEST BlockRequest;
+    ULONG DispatchCount;
+    BOOL Idle;
+    PIO_BLOCK_QUEUE Queue;
+    KSTATUS Status;
+    ULONG Timeout;
+
+    ASSERT(KeGetRunLevel() == RunLevelLow);
+
+    Queue = IopGetBlockQueue(Device);
+    if (Queue == NULL) {
+        return IopDispatchIoIrp(Device, MinorCodeNumber, Request);
+    }
+
+    BlockRequest.MinorCode = MinorCodeNumber;
+    BlockRequest.Parameters = Request;
+    BlockRequest.Offset = Request->IoOffset;
+    BlockRequest.Size = Request->IoSizeInBytes;
+    BlockRequest.MemberCount = 1;
+    BlockRequest.Mergeable = FALSE;
+    BlockRequest.Event = NULL;
+    BlockRequest.State = IoBlockRequestPending;
+    BlockRequest.Status = STATUS_SUCCESS;
+    INITIALIZE_LIST_HEAD(&(BlockRequest.MemberListHead));
+    INSERT_BEFORE(&(BlockRequest.MemberListEntry),
+                  &(BlockRequest.MemberListHead));
+
+    BlockRequest.SubmitTime = HlQueryTimeCounter();
+    BlockRequest.DispatchTime = BlockRequest.SubmitTime;
+    BlockRequest.Deadline = BlockRequest.SubmitTime;
+    if (MinorCodeNumber == IrpMinorIoRead) {
+        BlockRequest.Deadline += Queue->ReadExpire;
+
+    } else {
+        BlockRequest.Deadline += Queue->WriteExpire;
+    }
+
+    Timeout = WAIT_TIME_INDEFINITE;
+    KeAcquireQueuedLock(Queue->Lock);
+    Queue->Statistics.RequestCount += 1;
+    Idle = FALSE;
+    if ((Queue->InFlight == 0) && (Queue->PendingCount == 0)) {
+        Idle = TRUE;
+    }
+
+    //
+    // If the device is idle and there's no sign of other requests on the way,
+    // send this one straight down.
+    //
+
+    if ((Idle != FALSE) &&
+        ((Queue->Contention == 0) ||
+         ((Request->IoFlags & IO_FLAG_SERVICING_FAULT) != 0))) {
+
+        if (Queue->Contention != 0) {
+            Queue->Contention -= 1;
+        }
+
+        goto QueueBlockIoDispatchNow;
+    }
+
+    //
+    // This request will have to wait for something, so it needs an event. If
+    // that fails, skip the queue rather than fail the I/O.
+    //
+
+    BlockRequest.Event = KeCreateEvent(NULL);
+    if (BlockRequest.Event == NULL) {
+        goto QueueBlockIoDispatchNow;
+    }
+
+    if (Idle == FALSE) {
+        Queue->Contention = IO_BLOCK_QUEUE_CONTENTION_WINDOW;
+        BlockRequest.Mergeable = IopIsBlockRequestMergeable(Request);
+        if (IopMergeBlockRequest(Queue, &BlockRequest) != FALSE) {
+            KeReleaseQueuedLock(Queue->Lock);
+            while (BlockRequest.State != IoBlockRequestComplete) {
+                KeWaitForEvent(BlockRequest.Event,
+                               FALSE,
+                               WAIT_TIME_INDEFINITE);
+            }
+
+            goto QueueBlockIoEnd;
+        }
+
+    //
+    // Plug the idle queue for a moment to collect the other requests that
+    // recent contention suggests are coming.
+    //
+
+    } else {
+        BlockRequest.Mergeable = IopIsBlockRequestMergeable(Request);
+        Queue->Plugged = TRUE;
+        Queue->Statistics.PlugCount += 1;
+        Timeout = IO_BLOCK_QUEUE_PLUG_TIMEOUT;
+    }
+
+    IopInsertBlockRequest(Queue, &BlockRequest);
+    if ((Queue->Plugged != FALSE) &&
+        (Queue->PendingCount >= IO_BLOCK_QUEUE_UNPLUG_COUNT)) {
+
+        Queue->Plugged = FALSE;
+    }
+
+    IopRunBlockQueue(Queue);
+    KeReleaseQueuedLock(Queue->Lock);
+
+    //
+    // Wait for the queue to pick this request. If the plug times out first,
+    // pull it and get things moving.
+    //
+
+    while (BlockRequest.State == IoBlockRequestPending) {
+        Status = KeWaitForEvent(BlockRequest.Event, FALSE, Timeout);
+        if (Status == STATUS_TIMEOUT) {
+            Timeout = WAIT_TIME_INDEFINITE;
+            KeAcquireQueuedLock(Queue->Lock);
+            if (Queue->Plugged != FALSE) {
+                Queue->Plugged = FALSE;
+                IopRunBlockQueue(Queue);
+            }
+
+            KeReleaseQueuedLock(Queue->Lock);
+        }
+    }
+
+    ASSERT(BlockRequest.State == IoBlockRequestDispatched);
+
+    goto QueueBlockIoDispatch;
+
+QueueBlockIoDispatchNow:
+    Queue->InFlight += 1;
+    if (Queue->InFlight > Queue->Statistics.MaxInFlight) {
+        Queue->Statistics.MaxInFlight = Queue->InFlight;
+    }
+
+    BlockRequest.State = IoBlockRequestDispatched;
+    KeReleaseQueuedLock(Queue->Lock);
+
+QueueBlockIoDispatch:
+    DispatchCount = IopDispatchBlockRequest(Queue, &BlockRequest);
+    IopCompleteBlockRequest(Queue, &BlockRequest, DispatchCount);
+
+QueueBlockIoEnd:
+    if (BlockRequest.Event != NULL) {
+        KeDestroyEvent(BlockRequest.Event);
+    }
+
+    return BlockRequest.Status;
+}
+
+VOID
+IopDestroyBlockQueue (
+    PDEVICE Device
+    )
+
+/*++
+
+Routine Description:
+
+    This routine destroys the block request queue of the given device, if it
+    has one.
+
+Arguments:
+
+    Device - Supplies a pointer to the device being destroyed.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PIO_BLOCK_QUEUE Queue;
+
+    Queue = Device->BlockQueue;
+    if (Queue == NULL) {
+        return;
+    }
+
+    ASSERT((Queue->InFlight == 0) && (Queue->PendingCount == 0));
+
+    KeAcquireQueuedLock(IoBlockQueueListLock);
+    LIST_REMOVE(&(Queue->ListEntry));
+    KeReleaseQueuedLock(IoBlockQueueListLock);
+    Device->BlockQueue = NULL;
+    KeDestroyQueuedLock(Queue->Lock);
+    MmFreeNonPagedPool(Queue);
+    return;
+}
+
+KSTATUS
+IopGetBlockQueueStatistics (
+    PVOID Data,
+    PUINTN DataSize,
+    BOOL Set
+    )
+
+/*++
+
+Routine Description:
+
+    This routine gets the request queue statistics for every block device in
+    the system.
+
+Arguments:
+
+    Data - Supplies a pointer to the data buffer where the data is either
+        returned for a get operation or given for a set operation.
+
+    DataSize - Supplies a pointer that on input contains the size of the
+        data buffer. On output, contains the required size of the data buffer.
+
+    Set - Supplies a boolean indicating if this is a get operation (FALSE) or
+        a set operation (TRUE).
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_BUFFER_TOO_SMALL if not all entries fit. As many entries as fit are
+    still returned.
+
+    Other status codes on failure.
+
+--*/
+
+{
+
+    UINTN Capacity;
+    PLIST_ENTRY CurrentEntry;
+    PIO_BLOCK_QUEUE_STATISTICS_ENTRY Entry;
+    ULONGLONG Frequency;
+    PIO_BLOCK_QUEUE Queue;
+    ULONG QueueCount;
+    UINTN RequiredSize;
+    PIO_BLOCK_QUEUE_STATISTICS Statistics;
+    KSTATUS Status;
+
+    if (Set != FALSE) {
+        *DataSize = 0;
+        return STATUS_ACCESS_DENIED;
+    }
+
+    if (*DataSize < sizeof(IO_BLOCK_QUEUE_STATISTICS)) {
+        *DataSize = sizeof(IO_BLOCK_QUEUE_STATISTICS);
+        return STATUS_BUFFER_TOO_SMALL;
+    }
+
+    Statistics = Data;
+    if (Statistics->Version < IO_BLOCK_QUEUE_STATISTICS_VERSION) {
+        return STATUS_VERSION_MISMATCH;
+    }
+
+    Capacity = (*DataSize - sizeof(IO_BLOCK_QUEUE_STATISTICS)) /
+               sizeof(IO_BLOCK_QUEUE_STATISTICS_ENTRY);
+
+    Frequency = HlQueryTimeCounterFrequency();
+    Entry = (PIO_BLOCK_QUEUE_STATISTICS_ENTRY)(Statistics + 1);
+    QueueCount = 0;
+    KeAcquireQueuedLock(IoBlockQueueListLock);
+    CurrentEntry = IoBlockQueueList.Next;
+    while (CurrentEntry != &IoBlockQueueList) {
+        Queue = LIST_VALUE(CurrentEntry, IO_BLOCK_QUEUE, ListEntry);
+        CurrentEntry = CurrentEntry->Next;
+        if (QueueCount >= Capacity) {
+            QueueCount += 1;
+            continue;
+        }
+
+        KeAcquireQueuedLock(Queue->Lock);
+        RtlCopyMemory(Entry,
+                      &(Queue->Statistics),
+                      sizeof(IO_BLOCK_QUEUE_STATISTICS_ENTRY));
+
+        Entry->Policy = Queue->Policy;
+        Entry->Depth = Queue->Depth;
+        Entry->InFlight = Queue->InFlight;
+        Entry->Pending = Queue->PendingCount;
+        KeReleaseQueuedLock(Queue->Lock);
+        Entry->DeviceName[0] = '\0';
+        if (Queue->Device->Header.Name != NULL) {
+            RtlStringCopy(Entry->DeviceName,
+                          Queue->Device->Header.Name,
+                          IO_BLOCK_QUEUE_NAME_SIZE);
+        }
+
+        Entry->TotalWaitTime = IopConvertBlockQueueTime(Entry->TotalWaitTime,
+                                                        Frequency);
+
+        Entry->TotalLatency = IopConvertBlockQueueTime(Entry->TotalLatency,
+                                                       Frequency);
+
+        Entry->MaxLatency = IopConvertBlockQueueTime(Entry->MaxLatency,
+                                                     Frequency);
+
+        Entry += 1;
+        QueueCount += 1;
+    }
+
+    KeReleaseQueuedLock(IoBlockQueueListLock);
+    RequiredSize = sizeof(IO_BLOCK_QUEUE_STATISTICS) +
+                   (QueueCount * sizeof(IO_BLOCK_QUEUE_STATISTICS_ENTRY));
+
+    Status = STATUS_SUCCESS;
+    if (QueueCount > Capacity) {
+        QueueCount = Capacity;
+        Status = STATUS_BUFFER_TOO_SMALL;
+    }
+
+    Statistics->QueueCount = QueueCount;
+    *DataSize = RequiredSize;
+    return Status;
+}
+
+KSTATUS
+IopGetSetBlockQueuePolicy (
+    PVOID Data,
+    PUINTN DataSize,
+    BOOL Set
+    )
+
+/*++
+
+Routine Description:
+
+    This routine gets or sets the scheduling policy of a block device's
+    request queue.
+
+Arguments:
+
+    Data - Supplies a pointer to the block queue policy information.
+
+    DataSize - Supplies a pointer that on input contains the size of the
+        data buffer. On output, contains the required size of the data buffer.
+
+    Set - Supplies a boolean indicating if this is a get operation (FALSE) or
+        a set operation (TRUE).
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_NOT_FOUND if no block device by the given name has a request
+    queue.
+
+    Other status codes on failure.
+
+--*/
+
+{
+
+    PLIST_ENTRY CurrentEntry;
+    PIO_BLOCK_QUEUE_POLICY_INFORMATION Information;
+    PCSTR Name;
+    PIO_BLOCK_QUEUE Queue;
+    KSTATUS Status;
+
+    if (*DataSize < sizeof(IO_BLOCK_QUEUE_POLICY_INFORMATION)) {
+        *DataSize = sizeof(IO_BLOCK_QUEUE_POLICY_INFORMATION);
+        return STATUS_BUFFER_TOO_SMALL;
+    }
+
+    *DataSize = sizeof(IO_BLOCK_QUEUE_POLICY_INFORMATION);
+    Information = Data;
+    if (Information->Version < IO_BLOCK_QUEUE_POLICY_INFORMATION_VERSION) {
+        return STATUS_VERSION_MISMATCH;
+    }
+
+    if (Set != FALSE) {
+        Status = PsCheckPermission(PERMISSION_SYSTEM_ADMINISTRATOR);
+        if (!KSUCCESS(Status)) {
+            return Status;
+        }
+
+        if ((Information->Policy != IoBlockQueuePolicyNoop) &&
+            (Information->Policy != IoBlockQueuePolicyDeadline)) {
+
+            return STATUS_INVALID_PARAMETER;
+        }
+    }
+
+    //
+    // Match names the same way the statistics truncate them, so any name
+    // handed out there can be given back here.
+    //
+
+    Information->DeviceName[IO_BLOCK_QUEUE_NAME_SIZE - 1] = '\0';
+    Status = STATUS_NOT_FOUND;
+    KeAcquireQueuedLock(IoBlockQueueListLock);
+    CurrentEntry = IoBlockQueueList.Next;
+    while (CurrentEntry != &IoBlockQueueList) {
+        Queue = LIST_VALUE(CurrentEntry, IO_BLOCK_QUEUE, ListEntry);
+        CurrentEntry = CurrentEntry->Next;
+        Name = Queue->Device->Header.Name;
+        if ((Name == NULL) ||
+            (RtlAreStringsEqual(Name,
+                                Information->DeviceName,
+                                IO_BLOCK_QUEUE_NAME_SIZE - 1) == FALSE)) {
+
+            continue;
+        }
+
+        //
+        // Both pending lists are always kept up to date, so the policy can
+        // change with requests waiting. The next selection uses the new one.
+        //
+
+        KeAcquireQueuedLock(Queue->Lock);
+        if (Set != FALSE) {
+            Queue->Policy = Information->Policy;
+
+        } else {
+            Information->Policy = Queue->Policy;
+        }
+
+        KeReleaseQueuedLock(Queue->Lock);
+        Status = STATUS_SUCCESS;
+        break;
+    }
+
+    KeReleaseQueuedLock(IoBlockQueueListLock);
+    return Status;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+PIO_BLOCK_QUEUE
+IopGetBlockQueue (
+    PDEVICE Device
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the request queue for the given block device,
+    creating it if this is the first request to the device.
+
+Arguments:
+
+    Device - Supplies a pointer to the block device.
+
+Return Value:
+
+    Returns a pointer to the block queue on success.
+
+    NULL on allocation failure.
+
+--*/
+
+{
+
+    ULONGLONG Frequency;
+    PIO_BLOCK_QUEUE NewQueue;
+    PIO_BLOCK_QUEUE Queue;
+
+    Queue = Device->BlockQueue;
+    if (Queue != NULL) {
+        return Queue;
+    }
+
+    NewQueue = MmAllocateNonPagedPool(sizeof(IO_BLOCK_QUEUE),
+                                      IO_BLOCK_QUEUE_ALLOCATION_TAG);
+
+    if (NewQueue == NULL) {
+        return NULL;
+    }
+
+    RtlZeroMemory(NewQueue, sizeof(IO_BLOCK_QUEUE));
+    NewQueue->Lock = KeCreateQueuedLock();
+    if (NewQueue->Lock == NULL) {
+        MmFreeNonPagedPool(NewQueue);
+        return NULL;
+    }
+
+    NewQueue->Device = Device;
+    INITIALIZE_LIST_HEAD(&(NewQueue->SortedListHead));
+    INITIALIZE_LIST_HEAD(&(NewQueue->FifoListHead));
+    NewQueue->Policy = IoBlockQueueDefaultPolicy;
+    NewQueue->Depth = IoBlockQueueDefaultDepth;
+    if (NewQueue->Depth == 0) {
+        NewQueue->Depth = 1;
+    }
+
+    Frequency = HlQueryTimeCounterFrequency();
+    NewQueue->ReadExpire = (Frequency * IO_BLOCK_QUEUE_READ_EXPIRE) / 1000;
+    NewQueue->WriteExpire = (Frequency * IO_BLOCK_QUEUE_WRITE_EXPIRE) / 1000;
+
+    //
+    // Publish the queue, unless someone else beat this thread to it.
+    //
+
+    RtlMemoryBarrier();
+    KeAcquireQueuedLock(IoBlockQueueListLock);
+    if (Device->BlockQueue == NULL) {
+        Device->BlockQueue = NewQueue;
+        INSERT_BEFORE(&(NewQueue->ListEntry), &IoBlockQueueList);
+        NewQueue = NULL;
+    }
+
+    Queue = Device->BlockQueue;
+    KeReleaseQueuedLock(IoBlockQueueListLock);
+    if (NewQueue != NULL) {
+        KeDestroyQueuedLock(NewQueue->Lock);
+        MmFreeNonPagedPool(NewQueue);
+    }
+
+    return Queue;
+}
+
+BOOL
+IopIsBlockRequestMergeable (
+    PIRP_READ_WRITE Parameters
+    )
+
+/*++
+
+Routine Description:
+
+    This routine determines whether or not a request can be merged with
+    others. Merged requests share one I/O buffer built out of the page cache
+    pages of each request, so only requests made entirely of whole page cache
+    pages qualify.
+
+Arguments:
+
+    Parameters - Supplies a pointer to the read/write parameters.
+
+Return Value:
+
+    TRUE if the request can be merged.
+
+    FALSE if the request must be sent on its own.
+
+--*/
+
+{
+
+    UINTN BufferOffset;
+    PIO_BUFFER IoBuffer;
+    ULONG PageSize;
+    UINTN Size;
+
+    IoBuffer = Parameters->IoBuffer;
+    Size = Parameters->IoSizeInBytes;
+    PageSize = MmPageSize();
+    if ((IoBuffer == NULL) ||
+        (Size == 0) ||
+        (Size >= IO_BLOCK_QUEUE_MAX_MERGE_SIZE) ||
+        (IS_ALIGNED(Size, PageSize) == FALSE) ||
+        (IS_ALIGNED(MmGetIoBufferCurrentOffset(IoBuffer), PageSize) == FALSE) ||
+        (MmGetIoBufferSize(IoBuffer) < Size)) {
+
+        return FALSE;
+    }
+
+    for (BufferOffset = 0; BufferOffset < Size; BufferOffset += PageSize) {
+        if (MmGetIoBufferPageCacheEntry(IoBuffer, BufferOffset) == NULL) {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+BOOL
+IopMergeBlockRequest (
+    PIO_BLOCK_QUEUE Queue,
+    PIO_BLOCK_REQUEST Request
+    )
+
+/*++
+
+Routine Description:
+
+    This routine attempts to merge a new request into a pending request for
+    the blocks immediately before or after it. This routine assumes the queue
+    lock is held.
+
+Arguments:
+
+    Queue - Supplies a pointer to the block queue.
+
+    Request - Supplies a pointer to the new request.
+
+Return Value:
+
+    TRUE if the request was merged. Its owner should wait for the request it
+    was merged into to complete it.
+
+    FALSE if the request could not be merged.
+
+--*/
+
+{
+
+    PLIST_ENTRY CurrentEntry;
+    PIO_BLOCK_REQUEST Leader;
+    PIRP_READ_WRITE LeaderParameters;
+    PIRP_READ_WRITE Parameters;
+    PIO_BLOCK_REQUEST Pending;
+    PLIST_ENTRY Previous;
+
+    if (Request->Mergeable == FALSE) {
+        return FALSE;
+    }
+
+    Parameters = Request->Parameters;
+    CurrentEntry = Queue->SortedListHead.Next;
+    while (CurrentEntry != &(Queue->SortedListHead)) {
+        Leader = LIST_VALUE(CurrentEntry, IO_BLOCK_REQUEST, ListEntry);
+        CurrentEntry = CurrentEntry->Next;
+        LeaderParameters = Leader->Parameters;
+        if ((Leader->Mergeable == FALSE) ||
+            (Leader->MinorCode != Request->MinorCode) ||
+            (LeaderParameters->DeviceContext != Parameters->DeviceContext) ||
+            (LeaderParameters->IoFlags != Parameters->IoFlags) ||
+            (LeaderParameters->TimeoutInMilliseconds !=
+             Parameters->TimeoutInMilliseconds) ||
+            (Leader->MemberCount >= IO_BLOCK_QUEUE_MAX_MERGE_COUNT) ||
+            ((Leader->Size + Request->Size) > IO_BLOCK_QUEUE_MAX_MERGE_SIZE)) {
+
+            continue;
+        }
+
+        //
+        // Tack the request onto the end of a request that finishes where it
+        // starts.
+        //
+
+        if ((Leader->Offset + Leader->Size) == Request->Offset) {
+            LIST_REMOVE(&(Request->MemberListEntry));
+            INSERT_BEFORE(&(Request->MemberListEntry),
+                          &(Leader->MemberListHead));
+
+        //
+        // Or put it at the front of a request that starts where it finishes.
+        // The leader's offset moves back, so re-sort it.
+        //
+
+        } else if ((Request->Offset + Request->Size) == Leader->Offset) {
+            LIST_REMOVE(&(Request->MemberListEntry));
+            INSERT_AFTER(&(Request->MemberListEntry),
+                         &(Leader->MemberListHead));
+
+            Leader->Offset = Request->Offset;
+            Previous = Leader->ListEntry.Previous;
+            while (Previous != &(Queue->SortedListHead)) {
+                Pending = LIST_VALUE(Previous, IO_BLOCK_REQUEST, ListEntry);
+                if (Pending->Offset <= Leader->Offset) {
+                    break;
+                }
+
+                Previous = Previous->Previous;
+            }
+
+            if (Previous != Leader->ListEntry.Previous) {
+                LIST_REMOVE(&(Leader->ListEntry));
+                INSERT_AFTER(&(Leader->ListEntry), Previous);
+            }
+
+        } else {
+            continue;
+        }
+
+        Leader->Size += Request->Size;
+        Leader->MemberCount += 1;
+        Request->State = IoBlockRequestMerged;
+        Queue->Statistics.MergeCount += 1;
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+VOID
+IopInsertBlockRequest (
+    PIO_BLOCK_QUEUE Queue,
+    PIO_BLOCK_REQUEST Request
+    )
+
+/*++
+
+Routine Description:
+
+    This routine adds a request to the pending lists of the queue. This
+    routine assumes the queue lock is held.
+
+Arguments:
+
+    Queue - Supplies a pointer to the block queue.
+
+    Request - Supplies a pointer to the request to add.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PLIST_ENTRY CurrentEntry;
+    PIO_BLOCK_REQUEST Pending;
+
+    //
+    // Walk backwards, since new requests more often land after the others.
+    //
+
+    CurrentEntry = Queue->SortedListHead.Previous;
+    while (CurrentEntry != &(Queue->SortedListHead)) {
+        Pending = LIST_VALUE(CurrentEntry, IO_BLOCK_REQUEST, ListEntry);
+        if (Pending->Offset <= Request->Offset) {
+            break;
+        }
+
+        CurrentEntry = CurrentEntry->Previous;
+    }
+
+    INSERT_AFTER(&(Request->ListEntry), CurrentEntry);
+    INSERT_BEFORE(&(Request->FifoListEntry), &(Queue->FifoListHead));
+    Queue->PendingCount += 1;
+    if (Queue->PendingCount > Queue->Statistics.MaxPending) {
+        Queue->Statistics.MaxPending = Queue->PendingCount;
+    }
+
+    return;
+}
+
+VOID
+IopRunBlockQueue (
+    PIO_BLOCK_QUEUE Queue
+    )
+
+/*++
+
+Routine Description:
+
+    This routine picks pending requests to go to the device, as long as the
+    queue is not plugged and the device has room for them. The threads that
+    own the picked requests are woken to send them. This routine assumes the
+    queue lock is held.
+
+Arguments:
+
+    Queue - Supplies a pointer to the block queue.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PIO_BLOCK_REQUEST Request;
+
+    if (Queue->Plugged != FALSE) {
+        return;
+    }
+
+    while (Queue->InFlight < Queue->Depth) {
+        Request = IopSelectBlockRequest(Queue);
+        if (Request == NULL) {
+            break;
+        }
+
+        Queue->InFlight += 1;
+        if (Queue->InFlight > Queue->Statistics.MaxInFlight) {
+            Queue->Statistics.MaxInFlight = Queue->InFlight;
+        }
+
+        Request->DispatchTime = HlQueryTimeCounter();
+        Request->State = IoBlockRequestDispatched;
+
+        ASSERT(Request->Event != NULL);
+
+        KeSignalEvent(Request->Event, SignalOptionSignalAll);
+    }
+
+    return;
+}
+
+PIO_BLOCK_REQUEST
+IopSelectBlockRequest (
+    PIO_BLOCK_QUEUE Queue
+    )
+
+/*++
+
+Routine Description:
+
+    This routine removes the next request to go to the device from the
+    pending lists, according to the queue's policy. This routine assumes the
+    queue lock is held.
+
+Arguments:
+
+    Queue - Supplies a pointer to the block queue.
+
+Return Value:
+
+    Returns a pointer to the next request, or NULL if nothing is pending.
+
+--*/
+
+{
+
+    PLIST_ENTRY CurrentEntry;
+    PIO_BLOCK_REQUEST Oldest;
+    PIO_BLOCK_REQUEST Request;
+
+    if (Queue->PendingCount == 0) {
+        return NULL;
+    }
+
+    Oldest = LIST_VALUE(Queue->FifoListHead.Next,
+                        IO_BLOCK_REQUEST,
+                        FifoListEntry);
+
+    Request = Oldest;
+    switch (Queue->Policy) {
+    case IoBlockQueuePolicyNoop:
+        break;
+
+    //
+    // The deadline policy sweeps upwards through the device from where the
+    // last request left off, wrapping around at the end. A request that has
+    // waited too long goes first regardless.
+    //
+
+    case IoBlockQueuePolicyDeadline:
+        if (HlQueryTimeCounter() >= Oldest->Deadline) {
+            Queue->Statistics.ExpiredCount += 1;
+            break;
+        }
+
+        Request = LIST_VALUE(Queue->SortedListHead.Next,
+                             IO_BLOCK_REQUEST,
+                             ListEntry);
+
+        CurrentEntry = Queue->SortedListHead.Next;
+        while (CurrentEntry != &(Queue->SortedListHead)) {
+            Oldest = LIST_VALUE(CurrentEntry, IO_BLOCK_REQUEST, ListEntry);
+            if (Oldest->Offset >= Queue->LastOffset) {
+                Request = Oldest;
+                break;
+            }
+
+            CurrentEntry = CurrentEntry->Next;
+        }
+
+        break;
+
+    default:
+
+        ASSERT(FALSE);
+
+        break;
+    }
+
+    LIST_REMOVE(&(Request->ListEntry));
+    LIST_REMOVE(&(Request->FifoListEntry));
+    Queue->PendingCount -= 1;
+    Queue->LastOffset = Request->Offset + Request->Size;
+    return Request;
+}
+
+ULONG
+IopDispatchBlockRequest (
+    PIO_BLOCK_QUEUE Queue,
+    PIO_BLOCK_REQUEST Request
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sends a request and every request merged into it to the
+    device. Merged requests go down as one IRP whose I/O buffer is made up of
+    the page cache pages of each member, and the result is split back out to
+    the members afterwards.
+
+Arguments:
+
+    Queue - Supplies a pointer to the block queue.
+
+    Request - Supplies a pointer to the request to send.
+
+Return Value:
+
+    Returns the number of IRPs sent to the device.
+
+--*/
+
+{
+
+    UINTN BufferOffset;
+    UINTN Completed;
+    PLIST_ENTRY CurrentEntry;
+    ULONG DispatchCount;
+    PIO_BUFFER IoBuffer;
+    PIO_BLOCK_REQUEST Member;
+    PIRP_READ_WRITE MemberParameters;
+    PVOID PageCacheEntry;
+    ULONG PageSize;
+    IRP_READ_WRITE Parameters;
+    UINTN Remaining;
+    KSTATUS Status;
+
+    ASSERT(Request->State == IoBlockRequestDispatched);
+
+    if (Request->MemberCount == 1) {
+        Request->Status = IopDispatchIoIrp(Queue->Device,
+                                           Request->MinorCode,
+                                           Request->Parameters);
+
+        return 1;
+    }
+
+    //
+    // Build an I/O buffer out of the pages of all the members. If that can't
+    // be done, send the members down one at a time.
+    //
+
+    IoBuffer = MmAllocateUninitializedIoBuffer(Request->Size, 0);
+    if (IoBuffer == NULL) {
+        DispatchCount = 0;
+        CurrentEntry = Request->MemberListHead.Next;
+        while (CurrentEntry != &(Request->MemberListHead)) {
+            Member = LIST_VALUE(CurrentEntry,
+                                IO_BLOCK_REQUEST,
+                                MemberListEntry);
+
+            CurrentEntry = CurrentEntry->Next;
+            Member->Status = IopDispatchIoIrp(Queue->Device,
+                                              Member->MinorCode,
+                                              Member->Parameters);
+
+            DispatchCount += 1;
+        }
+
+        return DispatchCount;
+    }
+
+    PageSize = MmPageSize();
+    CurrentEntry = Request->MemberListHead.Next;
+    while (CurrentEntry != &(Request->MemberListHead)) {
+        Member = LIST_VALUE(CurrentEntry, IO_BLOCK_REQUEST, MemberListEntry);
+        CurrentEntry = CurrentEntry->Next;
+        MemberParameters = Member->Parameters;
+        for (BufferOffset = 0;
+             BufferOffset < MemberParameters->IoSizeInBytes;
+             BufferOffset += PageSize) {
+
+            PageCacheEntry = MmGetIoBufferPageCacheEntry(
+                                                     MemberParameters->IoBuffer,
+                                                     BufferOffset);
+
+            ASSERT(PageCacheEntry != NULL);
+
+            MmIoBufferAppendPage(IoBuffer,
+                                 PageCacheEntry,
+                                 NULL,
+                                 INVALID_PHYSICAL_ADDRESS);
+        }
+    }
+
+    RtlCopyMemory(&Parameters, Request->Parameters, sizeof(IRP_READ_WRITE));
+    Parameters.IoBuffer = IoBuffer;
+    Parameters.IoOffset = Request->Offset;
+    Parameters.IoSizeInBytes = Request->Size;
+    Parameters.IoBytesCompleted = 0;
+    Parameters.NewIoOffset = Request->Offset;
+    Status = IopDispatchIoIrp(Queue->Device, Request->MinorCode, &Parameters);
+
+    //
+    // Hand out the completed bytes to the members in order. Members that got
+    // all their bytes succeeded even if the device failed further along.
+    //
+
+    Remaining = Parameters.IoBytesCompleted;
+    CurrentEntry = Request->MemberListHead.Next;
+    while (CurrentEntry != &(Request->MemberListHead)) {
+        Member = LIST_VALUE(CurrentEntry, IO_BLOCK_REQUEST, MemberListEntry);
+        CurrentEntry = CurrentEntry->Next;
+        MemberParameters = Member->Parameters;
+        Completed = MemberParameters->IoSizeInBytes;
+        if (Completed > Remaining) {
+            Completed = Remaining;
+        }
+
+        Remaining -= Completed;
+        MemberParameters->IoBytesCompleted = Completed;
+        MemberParameters->NewIoOffset = MemberParameters->IoOffset + Completed;
+        Member->Status = STATUS_SUCCESS;
+        if (Completed != MemberParameters->IoSizeInBytes) {
+            Member->Status = Status;
+        }
+    }
+
+    MmFreeIoBuffer(IoBuffer);
+    return 1;
+}
+
+VOID
+IopCompleteBlockRequest (
+    PIO_BLOCK_QUEUE Queue,
+    PIO_BLOCK_REQUEST Request,
+    ULONG DispatchCount
+    )
+
+/*++
+
+Routine Description:
+
+    This routine finishes a request that came back from the device. It
+    records statistics, wakes the owners of any requests merged into it, and
+    lets the next requests go to the device.
+
+Arguments:
+
+    Queue - Supplies a pointer to the block queue.
+
+    Request - Supplies a pointer to the completed request.
+
+    DispatchCount - Supplies the number of IRPs it took to send the request.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PLIST_ENTRY CurrentEntry;
+    PKEVENT Event;
+    ULONGLONG Latency;
+    PIO_BLOCK_REQUEST Member;
+    ULONGLONG Now;
+    PIO_BLOCK_QUEUE_STATISTICS_ENTRY Statistics;
+
+    Now = HlQueryTimeCounter();
+    Statistics = &(Queue->Statistics);
+    KeAcquireQueuedLock(Queue->Lock);
+
+    ASSERT(Queue->InFlight != 0);
+
+    Queue->InFlight -= 1;
+    Statistics->DispatchCount += DispatchCount;
+    CurrentEntry = Request->MemberListHead.Next;
+    while (CurrentEntry != &(Request->MemberListHead)) {
+        Member = LIST_VALUE(CurrentEntry, IO_BLOCK_REQUEST, MemberListEntry);
+        CurrentEntry = CurrentEntry->Next;
+        Latency = Now - Member->SubmitTime;
+        Statistics->TotalLatency += Latency;
+        if (Latency > Statistics->MaxLatency) {
+            Statistics->MaxLatency = Latency;
+        }
+
+        Statistics->TotalWaitTime += Request->DispatchTime - Member->SubmitTime;
+        if (KSUCCESS(Member->Status)) {
+            Statistics->BytesTransferred +=
+                                        Member->Parameters->IoBytesCompleted;
+        }
+
+        if (Member == Request) {
+            continue;
+        }
+
+        //
+        // The member's owner may return the moment it sees the state change,
+        // taking the request with it. Hold a reference on the event so it
+        // survives being signaled.
+        //
+
+        Event = Member->Event;
+        ObAddReference(Event);
+        Member->State = IoBlockRequestComplete;
+        KeSignalEvent(Event, SignalOptionSignalAll);
+        ObReleaseReference(Event);
+    }
+
+    IopRunBlockQueue(Queue);
+    KeReleaseQueuedLock(Queue->Lock);
+    return;
+}
+
+ULONGLONG
+IopConvertBlockQueueTime (
+    ULONGLONG Ticks,
+    ULONGLONG Frequency
+    )
+
+/*++
+
+Routine Description:
+
+    This routine converts a time counter duration into microseconds without
+    overflowing on large totals.
+
+Arguments:
+
+    Ticks - Supplies the duration in time counter ticks.
+
+    Frequency - Supplies the time counter frequency, in Hertz.
+
+Return Value:
+
+    Returns the duration in microseconds.
+
+--*/
+
+{
+
+    ULONGLONG Microseconds;
+
+    if (Frequency == 0) {
+        return 0;
+    }
+
+    Microseconds = (Ticks / Frequency) * MICROSECONDS_PER_SECOND;
+    Microseconds += ((Ticks % Frequency) * MICROSECONDS_PER_SECOND) /
+                    Frequency;
+
+    return Microseconds;
+}
+
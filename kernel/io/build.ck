@@ -31,6 +31,7 @@ Module Name:
 function build() {
     base_sources = [
         "arb.c",
+        "blkqueue.c",
         "cachedio.c",
         "cstate.c",
         "device.c",
@@ -55,10 +56,12 @@ function build() {
         "perm.c",
         "pipe.c",
         "pminfo.c",
+        "pollset.c",
         "power.c",
         "pstate.c",
         "pty.c",
         "pwropt.c",
+        "sendfile.c",
         "shmemobj.c",
         "socket.c",
         "stream.c",
@@ -96,6 +96,30 @@ typedef struct _IO_WRITE_CONTEXT {
     ULONG IoFlags;
 } IO_WRITE_CONTEXT, *PIO_WRITE_CONTEXT;
 
+/*++
+
+Structure Description:
+
+    This structure defines a queued request to read a region of a file object
+    into the page cache ahead of its readers.
+
+Members:
+
+    FileObject - Stores a pointer to the file object to read. The request
+        holds a reference on it.
+
+    Offset - Stores the page-aligned offset where the region starts.
+
+    Size - Stores the size of the region in bytes.
+
+--*/
+
+typedef struct _IO_READ_AHEAD_REQUEST {
+    PFILE_OBJECT FileObject;
+    IO_OFFSET Offset;
+    ULONGLONG Size;
+} IO_READ_AHEAD_REQUEST, *PIO_READ_AHEAD_REQUEST;
+
 //
 // ----------------------------------------------- Internal Function Prototypes
 //
@@ -161,6 +185,45 @@ IopPerformDefaultPartialWrite (
     UINTN IoBufferOffset
     );
 
+BOOL
+IopIsReadAheadSupported (
+    PFILE_OBJECT FileObject
+    );
+
+VOID
+IopUpdateReadAhead (
+    PIO_HANDLE Handle,
+    IO_OFFSET Offset,
+    UINTN Size,
+    ULONG Flags
+    );
+
+KSTATUS
+IopScheduleReadAhead (
+    PFILE_OBJECT FileObject,
+    IO_OFFSET Offset,
+    ULONGLONG Size
+    );
+
+VOID
+IopReadAheadWorker (
+    PVOID Parameter
+    );
+
+KSTATUS
+IopReadAheadRange (
+    PFILE_OBJECT FileObject,
+    IO_OFFSET Offset,
+    UINTN Size
+    );
+
+KSTATUS
+IopDiscardCachedRegion (
+    PIO_HANDLE Handle,
+    IO_OFFSET Offset,
+    ULONGLONG Size
+    );
+
 //
 // -------------------------------------------------------------------- Globals
 //
@@ -359,6 +422,18 @@ Return Value:
         KeReleaseSharedExclusiveLockShared(FileObject->Lock);
     }
 
+    //
+    // Now that the lock is released, let read-ahead look at the read and get
+    // the next window started if the reader is moving sequentially.
+    //
+
+    if ((IoContext->Write == FALSE) && (IoContext->BytesCompleted != 0)) {
+        IopUpdateReadAhead(Handle,
+                           StartOffset,
+                           IoContext->BytesCompleted,
+                           IoContext->Flags);
+    }
+
     return Status;
 }
 
@@ -479,6 +554,139 @@ Return Value:
     return Status;
 }
 
+KERNEL_API
+KSTATUS
+IoReadAhead (
+    PIO_HANDLE Handle,
+    IO_OFFSET Offset,
+    ULONGLONG Size
+    )
+
+/*++
+
+Routine Description:
+
+    This routine starts reading the given region of a file or block device
+    into the page cache in the background. It does not wait for the reads to
+    complete.
+
+Arguments:
+
+    Handle - Supplies the open I/O handle.
+
+    Offset - Supplies the offset from the beginning of the file or device where
+        the region starts.
+
+    Size - Supplies the size of the region in bytes. Supply zero to read ahead
+        to the end of the file.
+
+Return Value:
+
+    Status code. Objects that are not backed by the page cache succeed without
+    doing anything.
+
+--*/
+
+{
+
+    IO_OFFSET End;
+    ULONGLONG FileSize;
+    PFILE_OBJECT FileObject;
+    IO_OFFSET Start;
+
+    if (Handle->HandleType == IoHandleTypePaging) {
+        Handle = ((PPAGING_IO_HANDLE)Handle)->IoHandle;
+    }
+
+    if (Offset < 0) {
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    FileObject = Handle->FileObject;
+    if (IopIsReadAheadSupported(FileObject) == FALSE) {
+        return STATUS_SUCCESS;
+    }
+
+    READ_INT64_SYNC(&(FileObject->Properties.FileSize), &FileSize);
+    if (Offset >= FileSize) {
+        return STATUS_SUCCESS;
+    }
+
+    End = Offset + Size;
+    if ((Size == 0) || (End < Offset) || (End > FileSize)) {
+        End = FileSize;
+    }
+
+    Start = ALIGN_RANGE_DOWN(Offset, MmPageSize());
+    return IopScheduleReadAhead(FileObject, Start, End - Start);
+}
+
+KSTATUS
+IopSetHandleAdvice (
+    PIO_HANDLE Handle,
+    PFILE_ADVICE Advice
+    )
+
+/*++
+
+Routine Description:
+
+    This routine applies access pattern advice to an I/O handle.
+
+Arguments:
+
+    Handle - Supplies a pointer to the I/O handle.
+
+    Advice - Supplies a pointer to the advice.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    PIO_READ_AHEAD ReadAhead;
+    KSTATUS Status;
+
+    ReadAhead = &(Handle->ReadAhead);
+    switch (Advice->Advice) {
+    case IoAdviceNormal:
+    case IoAdviceSequential:
+    case IoAdviceRandom:
+        ReadAhead->Advice = Advice->Advice;
+        ReadAhead->WindowStart = 0;
+        ReadAhead->WindowEnd = 0;
+        ReadAhead->WindowSize = 0;
+        Status = STATUS_SUCCESS;
+        break;
+
+    case IoAdviceWillNeed:
+        Status = IoReadAhead(Handle, Advice->Offset, Advice->Size);
+        break;
+
+    case IoAdviceDontNeed:
+        Status = IopDiscardCachedRegion(Handle, Advice->Offset, Advice->Size);
+        break;
+
+    //
+    // Unused page cache entries are already trimmed as memory gets tight, so
+    // there's nothing to do for data that won't be reused.
+    //
+
+    case IoAdviceNoReuse:
+        Status = STATUS_SUCCESS;
+        break;
+
+    default:
+        Status = STATUS_INVALID_PARAMETER;
+        break;
+    }
+
+    return Status;
+}
+
 //
 // --------------------------------------------------------- Internal Functions
 //
@@ -2424,3 +2632,539 @@ Return Value:
     return Status;
 }
 
+BOOL
+IopIsReadAheadSupported (
+    PFILE_OBJECT FileObject
+    )
+
+/*++
+
+Routine Description:
+
+    This routine determines whether or not the given file object can be read
+    ahead of its readers.
+
+Arguments:
+
+    FileObject - Supplies a pointer to the file object.
+
+Return Value:
+
+    TRUE if reads of the object go through the page cache and reading ahead
+    is worthwhile.
+
+    FALSE otherwise.
+
+--*/
+
+{
+
+    if ((FileObject->Properties.Type != IoObjectRegularFile) &&
+        (FileObject->Properties.Type != IoObjectBlockDevice)) {
+
+        return FALSE;
+    }
+
+    return IO_IS_FILE_OBJECT_CACHEABLE(FileObject);
+}
+
+VOID
+IopUpdateReadAhead (
+    PIO_HANDLE Handle,
+    IO_OFFSET Offset,
+    UINTN Size,
+    ULONG Flags
+    )
+
+/*++
+
+Routine Description:
+
+    This routine updates the access pattern tracking of an I/O handle after a
+    read completes, and schedules the next read-ahead window if the reader is
+    moving sequentially and has caught up to the last one. The window doubles
+    each time it is scheduled and collapses on random access. This routine
+    must be called without the file object lock held.
+
+Arguments:
+
+    Handle - Supplies a pointer to the I/O handle that was read.
+
+    Offset - Supplies the offset the read started at.
+
+    Size - Supplies the number of bytes that were read.
+
+    Flags - Supplies the I/O flags from the read. See IO_FLAG_* definitions.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    IO_ADVICE Advice;
+    IO_OFFSET End;
+    ULONGLONG FileSize;
+    PFILE_OBJECT FileObject;
+    IO_OFFSET LastPage;
+    PPAGE_CACHE_ENTRY PageCacheEntry;
+    ULONG PageSize;
+    PIO_READ_AHEAD ReadAhead;
+    BOOL Sequential;
+    IO_OFFSET WindowStart;
+    ULONG WindowSize;
+
+    //
+    // Reads done by file systems on behalf of another request are left to
+    // the read-ahead of the original request.
+    //
+
+    FileObject = Handle->FileObject;
+    if (((Flags & IO_FLAG_FS_DATA) != 0) ||
+        (IopIsReadAheadSupported(FileObject) == FALSE)) {
+
+        return;
+    }
+
+    PageSize = MmPageSize();
+    ReadAhead = &(Handle->ReadAhead);
+    Advice = ReadAhead->Advice;
+    if ((Flags & IO_FLAG_RANDOM_ACCESS) != 0) {
+        Advice = IoAdviceRandom;
+
+    } else if ((Flags & IO_FLAG_SEQUENTIAL_ACCESS) != 0) {
+        Advice = IoAdviceSequential;
+    }
+
+    //
+    // A read continues a sequential run if it picks up where the last one
+    // left off, allowing for small reads that start over in the same page.
+    //
+
+    Sequential = FALSE;
+    if ((Offset <= ReadAhead->NextOffset) &&
+        (Offset >= ALIGN_RANGE_DOWN(ReadAhead->NextOffset, PageSize))) {
+
+        Sequential = TRUE;
+    }
+
+    End = Offset + Size;
+    ReadAhead->NextOffset = End;
+
+    //
+    // Random access collapses the window. Sequential advice keeps reading
+    // ahead at full size from wherever the reader jumps to.
+    //
+
+    if ((Sequential == FALSE) || (Advice == IoAdviceRandom)) {
+        ReadAhead->WindowStart = 0;
+        ReadAhead->WindowEnd = 0;
+        if (Advice != IoAdviceSequential) {
+            ReadAhead->WindowSize = 0;
+            return;
+        }
+    }
+
+    //
+    // Wait until the reader gets into the last window scheduled. Scheduling
+    // the next one then keeps a full window ahead of the reader. Don't read
+    // ahead at all if memory is tight.
+    //
+
+    if ((End <= ReadAhead->WindowStart) ||
+        (MmGetPhysicalMemoryWarningLevel() != MemoryWarningLevelNone)) {
+
+        return;
+    }
+
+    WindowSize = ReadAhead->WindowSize;
+    if (Advice == IoAdviceSequential) {
+        WindowSize = IO_READ_AHEAD_MAXIMUM_SIZE;
+
+    } else if (WindowSize == 0) {
+        WindowSize = IO_READ_AHEAD_MINIMUM_SIZE;
+
+    } else if (WindowSize < IO_READ_AHEAD_MAXIMUM_SIZE) {
+        WindowSize <<= 1;
+    }
+
+    ReadAhead->WindowSize = WindowSize;
+    WindowStart = ALIGN_RANGE_UP(End, PageSize);
+    if (WindowStart < ReadAhead->WindowEnd) {
+        WindowStart = ReadAhead->WindowEnd;
+    }
+
+    READ_INT64_SYNC(&(FileObject->Properties.FileSize), &FileSize);
+    if (WindowStart >= FileSize) {
+        return;
+    }
+
+    ReadAhead->WindowStart = WindowStart;
+    ReadAhead->WindowEnd = WindowStart + WindowSize;
+
+    //
+    // Don't bother queuing work if the end of the window is already cached,
+    // which is the common case for a file that is read over and over.
+    //
+
+    LastPage = ReadAhead->WindowEnd - PageSize;
+    if (LastPage >= FileSize) {
+        LastPage = ALIGN_RANGE_DOWN(FileSize - 1, PageSize);
+    }
+
+    KeAcquireSharedExclusiveLockShared(FileObject->Lock);
+    PageCacheEntry = IopLookupPageCacheEntry(FileObject, LastPage);
+    KeReleaseSharedExclusiveLockShared(FileObject->Lock);
+    if (PageCacheEntry != NULL) {
+        IoPageCacheEntryReleaseReference(PageCacheEntry);
+        return;
+    }
+
+    IopScheduleReadAhead(FileObject, WindowStart, WindowSize);
+    return;
+}
+
+KSTATUS
+IopScheduleReadAhead (
+    PFILE_OBJECT FileObject,
+    IO_OFFSET Offset,
+    ULONGLONG Size
+    )
+
+/*++
+
+Routine Description:
+
+    This routine queues a work item to read the given region of a file object
+    into the page cache.
+
+Arguments:
+
+    FileObject - Supplies a pointer to the file object to read.
+
+    Offset - Supplies the page-aligned offset where the region starts.
+
+    Size - Supplies the size of the region in bytes.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    PIO_READ_AHEAD_REQUEST Request;
+    KSTATUS Status;
+
+    ASSERT(IS_ALIGNED(Offset, MmPageSize()) != FALSE);
+
+    Request = MmAllocatePagedPool(sizeof(IO_READ_AHEAD_REQUEST),
+                                  IO_ALLOCATION_TAG);
+
+    if (Request == NULL) {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    IopFileObjectAddReference(FileObject);
+    Request->FileObject = FileObject;
+    Request->Offset = Offset;
+    Request->Size = Size;
+    Status = KeCreateAndQueueWorkItem(NULL,
+                                      WorkPriorityNormal,
+                                      IopReadAheadWorker,
+                                      Request);
+
+    if (!KSUCCESS(Status)) {
+        IopFileObjectReleaseReference(FileObject);
+        MmFreePagedPool(Request);
+    }
+
+    return Status;
+}
+
+VOID
+IopReadAheadWorker (
+    PVOID Parameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine reads a region of a file object into the page cache on
+    behalf of a read-ahead request. Pages already in the cache are skipped.
+    The region is read in pieces, dropping the file object lock in between
+    so readers are not held off for the whole region.
+
+Arguments:
+
+    Parameter - Supplies a pointer to the read-ahead request, which this
+        routine frees.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    IO_OFFSET ChunkEnd;
+    IO_OFFSET End;
+    ULONGLONG FileSize;
+    PFILE_OBJECT FileObject;
+    IO_OFFSET MissEnd;
+    IO_OFFSET Offset;
+    PPAGE_CACHE_ENTRY PageCacheEntry;
+    ULONG PageSize;
+    PIO_READ_AHEAD_REQUEST Request;
+    KSTATUS Status;
+
+    Request = Parameter;
+    FileObject = Request->FileObject;
+    PageSize = MmPageSize();
+    Offset = Request->Offset;
+    End = Offset + Request->Size;
+    while (Offset < End) {
+        if (MmGetPhysicalMemoryWarningLevel() != MemoryWarningLevelNone) {
+            break;
+        }
+
+        KeAcquireSharedExclusiveLockExclusive(FileObject->Lock);
+        READ_INT64_SYNC(&(FileObject->Properties.FileSize), &FileSize);
+        if ((Offset >= FileSize) ||
+            (IO_IS_FILE_OBJECT_CACHEABLE(FileObject) == FALSE)) {
+
+            KeReleaseSharedExclusiveLockExclusive(FileObject->Lock);
+            break;
+        }
+
+        ChunkEnd = Offset + IO_READ_AHEAD_SIZE;
+        if (ChunkEnd > End) {
+            ChunkEnd = End;
+        }
+
+        if (ChunkEnd > FileSize) {
+            ChunkEnd = ALIGN_RANGE_UP(FileSize, PageSize);
+        }
+
+        //
+        // Skip over the pages that are already cached, and then find the run
+        // of missing pages after them.
+        //
+
+        while (Offset < ChunkEnd) {
+            PageCacheEntry = IopLookupPageCacheEntry(FileObject, Offset);
+            if (PageCacheEntry == NULL) {
+                break;
+            }
+
+            IoPageCacheEntryReleaseReference(PageCacheEntry);
+            Offset += PageSize;
+        }
+
+        MissEnd = Offset;
+        while (MissEnd < ChunkEnd) {
+            PageCacheEntry = IopLookupPageCacheEntry(FileObject, MissEnd);
+            if (PageCacheEntry != NULL) {
+                IoPageCacheEntryReleaseReference(PageCacheEntry);
+                break;
+            }
+
+            MissEnd += PageSize;
+        }
+
+        Status = STATUS_SUCCESS;
+        if (MissEnd != Offset) {
+            Status = IopReadAheadRange(FileObject,
+                                       Offset,
+                                       (UINTN)(MissEnd - Offset));
+        }
+
+        KeReleaseSharedExclusiveLockExclusive(FileObject->Lock);
+        if (!KSUCCESS(Status)) {
+            break;
+        }
+
+        Offset = MissEnd;
+    }
+
+    IopFileObjectReleaseReference(FileObject);
+    MmFreePagedPool(Request);
+    return;
+}
+
+KSTATUS
+IopReadAheadRange (
+    PFILE_OBJECT FileObject,
+    IO_OFFSET Offset,
+    UINTN Size
+    )
+
+/*++
+
+Routine Description:
+
+    This routine reads the given range of a file object and inserts the data
+    into the page cache. The file object lock must be held exclusive.
+
+Arguments:
+
+    FileObject - Supplies a pointer to the file object to read.
+
+    Offset - Supplies the page-aligned offset to read from.
+
+    Size - Supplies the number of bytes to read.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    IO_OFFSET BlockAlignedOffset;
+    UINTN BlockAlignedSize;
+    ULONG BlockSize;
+    UINTN BytesCopied;
+    ULONG PageSize;
+    PIO_BUFFER ReadIoBuffer;
+    IO_CONTEXT ReadIoContext;
+    KSTATUS Status;
+
+    ASSERT(KeIsSharedExclusiveLockHeldExclusive(FileObject->Lock) != FALSE);
+
+    //
+    // Align the read to the block size, just like a cache miss would.
+    //
+
+    PageSize = MmPageSize();
+    BlockSize = FileObject->Properties.BlockSize;
+    BlockAlignedOffset = ALIGN_RANGE_DOWN(Offset, BlockSize);
+    BlockAlignedSize = REMAINDER(Offset, BlockSize) + Size;
+    BlockAlignedSize = ALIGN_RANGE_UP(BlockAlignedSize, BlockSize);
+    BlockAlignedSize = ALIGN_RANGE_UP(BlockAlignedSize, PageSize);
+
+    ASSERT(IS_ALIGNED(BlockAlignedOffset, PageSize) != FALSE);
+
+    ReadIoBuffer = MmAllocateUninitializedIoBuffer(BlockAlignedSize, 0);
+    if (ReadIoBuffer == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto ReadAheadRangeEnd;
+    }
+
+    ReadIoContext.IoBuffer = ReadIoBuffer;
+    ReadIoContext.Offset = BlockAlignedOffset;
+    ReadIoContext.SizeInBytes = BlockAlignedSize;
+    ReadIoContext.BytesCompleted = 0;
+    ReadIoContext.Flags = 0;
+    ReadIoContext.TimeoutInMilliseconds = WAIT_TIME_INDEFINITE;
+    ReadIoContext.Write = FALSE;
+    Status = IopPerformNonCachedRead(FileObject, &ReadIoContext, NULL);
+    if ((!KSUCCESS(Status)) &&
+        ((Status != STATUS_END_OF_FILE) ||
+         (ReadIoContext.BytesCompleted == 0))) {
+
+        goto ReadAheadRangeEnd;
+    }
+
+    if (BlockAlignedSize != ReadIoContext.BytesCompleted) {
+        Status = MmZeroIoBuffer(
+                              ReadIoBuffer,
+                              ReadIoContext.BytesCompleted,
+                              BlockAlignedSize - ReadIoContext.BytesCompleted);
+
+        if (!KSUCCESS(Status)) {
+            goto ReadAheadRangeEnd;
+        }
+    }
+
+    //
+    // Cache the whole buffer without copying any of it anywhere.
+    //
+
+    Status = IopCopyAndCacheIoBuffer(FileObject,
+                                     BlockAlignedOffset,
+                                     NULL,
+                                     0,
+                                     ReadIoBuffer,
+                                     BlockAlignedSize,
+                                     0,
+                                     &BytesCopied);
+
+ReadAheadRangeEnd:
+    if (ReadIoBuffer != NULL) {
+        MmFreeIoBuffer(ReadIoBuffer);
+    }
+
+    return Status;
+}
+
+KSTATUS
+IopDiscardCachedRegion (
+    PIO_HANDLE Handle,
+    IO_OFFSET Offset,
+    ULONGLONG Size
+    )
+
+/*++
+
+Routine Description:
+
+    This routine writes out the given region of a file or block device and
+    then drops its clean, unused pages from the page cache, so that the next
+    read of the region goes back to the backing store.
+
+Arguments:
+
+    Handle - Supplies the open I/O handle.
+
+    Offset - Supplies the offset from the beginning of the file or device where
+        the region starts.
+
+    Size - Supplies the size of the region in bytes. Supply zero to discard
+        to the end of the file.
+
+Return Value:
+
+    Status code. Objects that are not backed by the page cache succeed without
+    doing anything.
+
+--*/
+
+{
+
+    PFILE_OBJECT FileObject;
+    KSTATUS Status;
+
+    if (Handle->HandleType == IoHandleTypePaging) {
+        Handle = ((PPAGING_IO_HANDLE)Handle)->IoHandle;
+    }
+
+    if (Offset < 0) {
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    FileObject = Handle->FileObject;
+    if (IopIsReadAheadSupported(FileObject) == FALSE) {
+        return STATUS_SUCCESS;
+    }
+
+    if (Size == 0) {
+        Size = -1ULL;
+    }
+
+    Status = IopFlushFileObject(FileObject, Offset, Size, 0, FALSE, NULL);
+    if (!KSUCCESS(Status)) {
+        return Status;
+    }
+
+    KeAcquireSharedExclusiveLockExclusive(FileObject->Lock);
+    IopEvictCleanPageCacheEntries(FileObject, Offset, Size);
+    KeReleaseSharedExclusiveLockExclusive(FileObject->Lock);
+    return STATUS_SUCCESS;
+}
@@ -707,6 +707,12 @@ Return Value:
 
     PmpDestroyDevice(Device);
 
+    //
+    // Tear down the block request queue if the device did block I/O.
+    //
+
+    IopDestroyBlockQueue(Device);
+
     //
     // Delete the arbiter list and the various resource lists.
     //
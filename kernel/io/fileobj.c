@@ -196,6 +196,14 @@ Return Value:
         KeSignalEvent(IoState->ErrorEvent, SignalOption);
     }
 
+    //
+    // Let any poll sets watching this object know about the new events.
+    //
+
+    if ((Set != FALSE) && (IoState->Poll != NULL)) {
+        IopNotifyPollSets(IoState, Events);
+    }
+
     //
     // If read or write just went high, potentially signal the owner.
     //
@@ -476,6 +484,10 @@ Return Value:
         IopDestroyAsyncState(State->Async);
     }
 
+    if (State->Poll != NULL) {
+        IopDestroyPollState(State->Poll);
+    }
+
     if (State->ReadEvent != NULL) {
         KeDestroyEvent(State->ReadEvent);
     }
@@ -534,6 +546,34 @@ Return Value:
     return FileObject;
 }
 
+VOID
+IoFileObjectAddReference (
+    PVOID FileObject
+    )
+
+/*++
+
+Routine Description:
+
+    This routine adds an external reference to a file object previously
+    returned by referencing the file object for a handle.
+
+Arguments:
+
+    FileObject - Supplies the opaque pointer to the file object.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    IopFileObjectAddReference(FileObject);
+    return;
+}
+
 VOID
 IoFileObjectReleaseReference (
     PVOID FileObject
@@ -831,6 +871,7 @@ Return Value:
                 case IoObjectTerminalMaster:
                 case IoObjectTerminalSlave:
                 case IoObjectSharedMemoryObject:
+                case IoObjectPollSet:
                     break;
 
                 default:
@@ -1198,6 +1239,7 @@ Return Value:
             case IoObjectTerminalMaster:
             case IoObjectTerminalSlave:
             case IoObjectSharedMemoryObject:
+            case IoObjectPollSet:
                 ObReleaseReference(Object->SpecialIo);
                 break;
 
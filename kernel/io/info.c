@@ -128,6 +128,14 @@ Return Value:
         Status = IopGetCacheStatistics(Data, DataSize, Set);
         break;
 
+    case IoInformationBlockQueueStatistics:
+        Status = IopGetBlockQueueStatistics(Data, DataSize, Set);
+        break;
+
+    case IoInformationBlockQueuePolicy:
+        Status = IopGetSetBlockQueuePolicy(Data, DataSize, Set);
+        break;
+
     default:
         Status = STATUS_INVALID_PARAMETER;
         *DataSize = 0;
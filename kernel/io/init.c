@@ -231,6 +231,11 @@ Return Value:
         goto InitializeEnd;
     }
 
+    Status = IopInitializeIrpSupport();
+    if (!KSUCCESS(Status)) {
+        goto InitializeEnd;
+    }
+
     //
     // Create the pipe directory.
     //
@@ -249,6 +254,42 @@ Return Value:
         goto InitializeEnd;
     }
 
+    //
+    // Create the poll set directory and the lock serializing poll set
+    // membership changes.
+    //
+
+    IoPollSetDirectory = ObCreateObject(ObjectDirectory,
+                                        NULL,
+                                        "PollSet",
+                                        sizeof("PollSet"),
+                                        sizeof(OBJECT_HEADER),
+                                        NULL,
+                                        OBJECT_FLAG_USE_NAME_DIRECTLY,
+                                        FI_ALLOCATION_TAG);
+
+    if (IoPollSetDirectory == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto InitializeEnd;
+    }
+
+    IoPollSetLock = KeCreateQueuedLock();
+    if (IoPollSetLock == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto InitializeEnd;
+    }
+
+    //
+    // Initialize the list of block device request queues.
+    //
+
+    INITIALIZE_LIST_HEAD(&IoBlockQueueList);
+    IoBlockQueueListLock = KeCreateQueuedLock();
+    if (IoBlockQueueListLock == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto InitializeEnd;
+    }
+
     //
     // Initialize the file system list head and create the lock protecting
     // access to it.
@@ -343,6 +343,78 @@ Return Value:
     return;
 }
 
+KERNEL_API
+KSTATUS
+IoSetInterruptAffinity (
+    HANDLE InterruptHandle,
+    PPROCESSOR_AFFINITY Affinity
+    )
+
+/*++
+
+Routine Description:
+
+    This routine steers a connected interrupt to the given set of processors.
+    The interrupt's deferred work follows it, as DPCs queued by the service
+    routine run on the processor that took the interrupt. Interrupt
+    controllers can only target either one processor or all of them, so if
+    the set does not contain every active processor, the interrupt is
+    delivered to the first processor in the set.
+
+Arguments:
+
+    InterruptHandle - Supplies the handle to the interrupt, returned when the
+        interrupt was connected.
+
+    Affinity - Supplies a pointer to the set of processors the interrupt
+        should be delivered to.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_INVALID_PARAMETER if the set contains no active processors.
+
+    STATUS_NOT_SUPPORTED if the interrupt cannot be steered, such as for
+    message signaled interrupts or lines on secondary interrupt controllers.
+
+--*/
+
+{
+
+    ULONG Count;
+    ULONG First;
+    PKINTERRUPT Interrupt;
+    ULONG Number;
+    PROCESSOR_SET Target;
+
+    ASSERT(KeGetRunLevel() == RunLevelLow);
+    ASSERT((InterruptHandle != INVALID_HANDLE) && (InterruptHandle != NULL));
+
+    Interrupt = (PKINTERRUPT)InterruptHandle;
+    Count = KeGetActiveProcessorCount();
+    First = Count;
+    RtlZeroMemory(&Target, sizeof(PROCESSOR_SET));
+    Target.Target = ProcessorTargetAny;
+    for (Number = 0; Number < Count; Number += 1) {
+        if (PROCESSOR_AFFINITY_CONTAINS(Affinity, Number)) {
+            if (First == Count) {
+                First = Number;
+            }
+
+        } else {
+            Target.Target = ProcessorTargetSingleProcessor;
+        }
+    }
+
+    if (First == Count) {
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    Target.U.Number = First;
+    return HlSetInterruptLineTarget(Interrupt, &Target);
+}
+
 KERNEL_API
 RUNLEVEL
 IoRaiseToInterruptRunLevel (
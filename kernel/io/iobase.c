@@ -2299,10 +2299,7 @@ Return Value:
                                        SourceFileObject);
 
             if (NewPathEntry != NULL) {
-                INSERT_BEFORE(
-                        &(NewPathEntry->SiblingListEntry),
-                        &(DestinationDirectoryPathPoint.PathEntry->ChildList));
-
+                IopPathLink(NewPathEntry);
                 IopFileObjectAddReference(SourceFileObject);
             }
         }
@@ -3476,6 +3473,14 @@ Return Value:
         Status = STATUS_SUCCESS;
         break;
 
+    //
+    // Poll sets are set up entirely at creation.
+    //
+
+    case IoObjectPollSet:
+        Status = STATUS_SUCCESS;
+        break;
+
     default:
 
         ASSERT(FALSE);
@@ -3672,6 +3677,10 @@ Return Value:
 
         break;
 
+    case IoObjectPollSet:
+        Status = IopCreatePollSet(CreatePermissions, FileObject);
+        break;
+
     default:
 
         ASSERT(FALSE);
@@ -3714,6 +3723,17 @@ Return Value:
     FileObject = NULL;
     if (IoHandle->PathPoint.PathEntry != NULL) {
         FileObject = IoHandle->FileObject;
+
+        //
+        // Pull the handle out of any poll sets it was added to.
+        //
+
+        if ((FileObject->IoState != NULL) &&
+            (FileObject->IoState->Poll != NULL)) {
+
+            IopRemovePollSetEntries(IoHandle);
+        }
+
         switch (FileObject->Properties.Type) {
         case IoObjectRegularFile:
         case IoObjectRegularDirectory:
@@ -3762,6 +3782,10 @@ Return Value:
             Status = IopTerminalCloseSlave(IoHandle);
             break;
 
+        case IoObjectPollSet:
+            Status = IopClosePollSet(IoHandle);
+            break;
+
         default:
             Status = STATUS_SUCCESS;
             break;
@@ -5355,6 +5379,14 @@ Return Value:
         Status = IopPerformObjectIoOperation(Handle, Context);
         break;
 
+    //
+    // Poll sets can only be waited on, not read or written.
+    //
+
+    case IoObjectPollSet:
+        Status = STATUS_INVALID_PARAMETER;
+        break;
+
     default:
 
         ASSERT(FALSE);
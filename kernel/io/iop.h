@@ -130,6 +130,13 @@ Module Name:
 
 #define IRP_ACTIVE 0x00000004
 
+//
+// This flag is set in an IRP when its stack came from the IRP stack object
+// cache rather than from pool.
+//
+
+#define IRP_STACK_CACHED 0x00000008
+
 //
 // This flag is used during processing Query Children to mark pre-existing
 // devices and notice missing ones.
@@ -225,6 +232,15 @@ Module Name:
 
 #define IO_READ_AHEAD_SIZE _128KB
 
+//
+// Define the bounds of the adaptive read-ahead window kept for each handle.
+// The window starts small when a handle begins reading sequentially and
+// doubles each time the reader catches up to it.
+//
+
+#define IO_READ_AHEAD_MINIMUM_SIZE (4 * _4KB)
+#define IO_READ_AHEAD_MAXIMUM_SIZE _512KB
+
 //
 // This flag is set to indicate that the eviction operation is executing as a
 // result of a truncate. All image sections should be unmapped and all page
@@ -327,6 +343,7 @@ typedef enum _FILE_OBJECT_TIME_TYPE {
 } FILE_OBJECT_TIME_TYPE, *PFILE_OBJECT_TIME_TYPE;
 
 typedef struct _DEVICE_POWER DEVICE_POWER, *PDEVICE_POWER;
+typedef struct _IO_BLOCK_QUEUE IO_BLOCK_QUEUE, *PIO_BLOCK_QUEUE;
 
 /*++
 
@@ -426,7 +443,12 @@ Structure Description:
         the parent directory.
 
     CacheListEntry - Stores pointers to the next and previous entries in the
-        LRU list of the path entry cache.
+        LRU list of the path entry cache. Once the entry is destroyed, this
+        links it into the list of entries waiting to be freed.
+
+    HashListEntry - Stores pointers to the next and previous entries in the
+        global path entry hash table bucket. The next pointer is NULL if the
+        entry is not in the hash table.
 
     ReferenceCount - Stores the reference count of the entry.
 
@@ -463,6 +485,7 @@ Structure Description:
 struct _PATH_ENTRY {
     LIST_ENTRY SiblingListEntry;
     LIST_ENTRY CacheListEntry;
+    LIST_ENTRY HashListEntry;
     volatile ULONG ReferenceCount;
     volatile ULONG MountCount;
     BOOL Negative;
@@ -539,6 +562,41 @@ typedef enum _IO_HANDLE_TYPE {
 
 /*++
 
+Structure Description:
+
+    This structure defines the read-ahead state of an I/O handle. It is updated
+    without synchronization, as racing readers on the same handle can at worst
+    cause an extra or a missed read-ahead.
+
+Members:
+
+    NextOffset - Stores the offset just past the end of the last read. A read
+        starting here, or within the page it lands in, continues a
+        sequential run.
+
+    WindowStart - Stores the start of the most recently scheduled read-ahead
+        window. When a reader gets this far, the next window is scheduled.
+
+    WindowEnd - Stores the end of the most recently scheduled read-ahead
+        window.
+
+    WindowSize - Stores the current size of the read-ahead window in bytes.
+        Zero means read-ahead is off until the reader looks sequential again.
+
+    Advice - Stores the access pattern advice given for the handle.
+
+--*/
+
+typedef struct _IO_READ_AHEAD {
+    IO_OFFSET NextOffset;
+    IO_OFFSET WindowStart;
+    IO_OFFSET WindowEnd;
+    ULONG WindowSize;
+    IO_ADVICE Advice;
+} IO_READ_AHEAD, *PIO_READ_AHEAD;
+
+/*++
+
 Structure Description:
 
     This structure defines the context behind a generic I/O handle.
@@ -574,6 +632,9 @@ Structure Description:
 
     Async - Stores an optional pointer to the asynchronous receiver state.
 
+    ReadAhead - Stores the access pattern tracking used to read ahead of
+        cached reads on this handle.
+
 --*/
 
 struct _IO_HANDLE {
@@ -586,6 +647,7 @@ struct _IO_HANDLE {
     PFILE_OBJECT FileObject;
     IO_OFFSET CurrentOffset;
     PASYNC_IO_RECEIVER Async;
+    IO_READ_AHEAD ReadAhead;
 };
 
 /*++
@@ -970,6 +1032,10 @@ Structure Description:
 
     Power - Stores the power management information for the device.
 
+    BlockQueue - Stores a pointer to the request queue that schedules I/O to
+        this device if it is a block device. This is created on the first
+        block I/O request.
+
 --*/
 
 struct _DEVICE {
@@ -1001,6 +1067,7 @@ struct _DEVICE {
     PRESOURCE_ALLOCATION_LIST ProcessorLocalResources;
     PRESOURCE_ALLOCATION_LIST BootResources;
     PDEVICE_POWER Power;
+    PIO_BLOCK_QUEUE BlockQueue;
 };
 
 /*++
@@ -1159,6 +1226,22 @@ extern POBJECT_HEADER IoIrpDirectory;
 
 extern POBJECT_HEADER IoPipeDirectory;
 
+//
+// Store a pointer to the poll set directory, and the lock serializing poll set
+// membership changes.
+//
+
+extern POBJECT_HEADER IoPollSetDirectory;
+extern PQUEUED_LOCK IoPollSetLock;
+
+//
+// Store the list of block device request queues and the lock that protects
+// it.
+//
+
+extern LIST_ENTRY IoBlockQueueList;
+extern PQUEUED_LOCK IoBlockQueueListLock;
+
 //
 // Store the saved boot information.
 //
@@ -2318,6 +2401,30 @@ Return Value:
 
 --*/
 
+KSTATUS
+IopSetHandleAdvice (
+    PIO_HANDLE Handle,
+    PFILE_ADVICE Advice
+    );
+
+/*++
+
+Routine Description:
+
+    This routine applies access pattern advice to an I/O handle.
+
+Arguments:
+
+    Handle - Supplies a pointer to the I/O handle.
+
+    Advice - Supplies a pointer to the advice.
+
+Return Value:
+
+    Status code.
+
+--*/
+
 KSTATUS
 IopPerformObjectIoOperation (
     PIO_HANDLE IoHandle,
@@ -3194,6 +3301,124 @@ Return Value:
 
 --*/
 
+KSTATUS
+IopCreatePollSet (
+    FILE_PERMISSIONS Permissions,
+    PFILE_OBJECT *FileObject
+    );
+
+/*++
+
+Routine Description:
+
+    This routine creates a new poll set and the file object that represents
+    it.
+
+Arguments:
+
+    Permissions - Supplies the permissions to give to the file object.
+
+    FileObject - Supplies a pointer where a pointer to the new poll set file
+        object will be returned on success.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+KSTATUS
+IopClosePollSet (
+    PIO_HANDLE IoHandle
+    );
+
+/*++
+
+Routine Description:
+
+    This routine is called when a poll set handle is closed. It removes every
+    entry from the set.
+
+Arguments:
+
+    IoHandle - Supplies a pointer to the I/O handle being closed.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+VOID
+IopRemovePollSetEntries (
+    PIO_HANDLE IoHandle
+    );
+
+/*++
+
+Routine Description:
+
+    This routine removes an I/O handle from every poll set it was added to.
+    It is called when the handle is closed.
+
+Arguments:
+
+    IoHandle - Supplies a pointer to the I/O handle being closed.
+
+Return Value:
+
+    None.
+
+--*/
+
+VOID
+IopNotifyPollSets (
+    PIO_OBJECT_STATE IoState,
+    ULONG Events
+    );
+
+/*++
+
+Routine Description:
+
+    This routine queues every poll set entry interested in the given events
+    onto its poll set's ready list. It is called whenever events are set on
+    an I/O object state that has been added to a poll set.
+
+Arguments:
+
+    IoState - Supplies a pointer to the I/O object state whose events were
+        just set.
+
+    Events - Supplies the mask of events that were set.
+
+Return Value:
+
+    None.
+
+--*/
+
+VOID
+IopDestroyPollState (
+    PIO_POLL_STATE PollState
+    );
+
+/*++
+
+Routine Description:
+
+    This routine destroys the poll set state of an I/O object state.
+
+Arguments:
+
+    PollState - Supplies a pointer to the poll state to destroy.
+
+Return Value:
+
+    None.
+
+--*/
+
 KSTATUS
 IopInitializeTerminalSupport (
     VOID
@@ -4071,6 +4296,30 @@ Return Value:
 
 --*/
 
+VOID
+IopPathLink (
+    PPATH_ENTRY Entry
+    );
+
+/*++
+
+Routine Description:
+
+    This routine links the given path entry into its parent's list of children
+    and into the global path entry hash table, making it visible to path walks.
+    The caller must hold the parent path entry's file object lock exclusively.
+
+Arguments:
+
+    Entry - Supplies a pointer to the path entry to link into the path
+        hierarchy.
+
+Return Value:
+
+    None.
+
+--*/
+
 VOID
 IopPathUnlink (
     PPATH_ENTRY Entry
@@ -4453,6 +4702,27 @@ Return Value:
 
 --*/
 
+KSTATUS
+IopInitializeIrpSupport (
+    VOID
+    );
+
+/*++
+
+Routine Description:
+
+    This routine performs global initialization for IRP support.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Status code.
+
+--*/
+
 KSTATUS
 IopSendStateChangeIrp (
     PDEVICE Device,
@@ -4563,6 +4833,35 @@ Return Value:
 
 --*/
 
+KSTATUS
+IopDispatchIoIrp (
+    PDEVICE Device,
+    IRP_MINOR_CODE MinorCodeNumber,
+    PIRP_READ_WRITE Request
+    );
+
+/*++
+
+Routine Description:
+
+    This routine creates an I/O IRP, sends it to the given device, and waits
+    for it to complete. It does not go through the block request queue.
+
+Arguments:
+
+    Device - Supplies a pointer to the device to send the IRP to.
+
+    MinorCodeNumber - Supplies the minor code number to send to the IRP.
+
+    Request - Supplies a pointer that on input contains the I/O request
+        parameters. On output, receives the completed parameters.
+
+Return Value:
+
+    Status code.
+
+--*/
+
 KSTATUS
 IopSendIoReadIrp (
     PDEVICE Device,
@@ -4900,3 +5199,128 @@ Return Value:
 
 --*/
 
+KSTATUS
+IopQueueBlockIo (
+    PDEVICE Device,
+    IRP_MINOR_CODE MinorCodeNumber,
+    PIRP_READ_WRITE Request
+    );
+
+/*++
+
+Routine Description:
+
+    This routine submits a read or write request to a block device through the
+    device's request queue, and waits for it to complete. The request may be
+    held briefly, sorted against other outstanding requests, and merged with
+    requests for adjacent blocks before it is sent to the device.
+
+Arguments:
+
+    Device - Supplies a pointer to the block device.
+
+    MinorCodeNumber - Supplies the minor code number of the request, either
+        read or write.
+
+    Request - Supplies a pointer that on input contains the I/O request
+        parameters. On output, receives the completed parameters.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+VOID
+IopDestroyBlockQueue (
+    PDEVICE Device
+    );
+
+/*++
+
+Routine Description:
+
+    This routine destroys the block request queue of the given device, if it
+    has one.
+
+Arguments:
+
+    Device - Supplies a pointer to the device being destroyed.
+
+Return Value:
+
+    None.
+
+--*/
+
+KSTATUS
+IopGetBlockQueueStatistics (
+    PVOID Data,
+    PUINTN DataSize,
+    BOOL Set
+    );
+
+/*++
+
+Routine Description:
+
+    This routine gets the request queue statistics for every block device in
+    the system.
+
+Arguments:
+
+    Data - Supplies a pointer to the data buffer where the data is either
+        returned for a get operation or given for a set operation.
+
+    DataSize - Supplies a pointer that on input contains the size of the
+        data buffer. On output, contains the required size of the data buffer.
+
+    Set - Supplies a boolean indicating if this is a get operation (FALSE) or
+        a set operation (TRUE).
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_BUFFER_TOO_SMALL if not all entries fit. As many entries as fit are
+    still returned.
+
+    Other status codes on failure.
+
+--*/
+
+KSTATUS
+IopGetSetBlockQueuePolicy (
+    PVOID Data,
+    PUINTN DataSize,
+    BOOL Set
+    );
+
+/*++
+
+Routine Description:
+
+    This routine gets or sets the scheduling policy of a block device's
+    request queue.
+
+Arguments:
+
+    Data - Supplies a pointer to the block queue policy information.
+
+    DataSize - Supplies a pointer that on input contains the size of the
+        data buffer. On output, contains the required size of the data buffer.
+
+    Set - Supplies a boolean indicating if this is a get operation (FALSE) or
+        a set operation (TRUE).
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_NOT_FOUND if no block device by the given name has a request
+    queue.
+
+    Other status codes on failure.
+
+--*/
+
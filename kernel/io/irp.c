@@ -36,6 +36,13 @@ Module Name:
 // ---------------------------------------------------------------- Definitions
 //
 
+//
+// Define the largest IRP stack, in entries, that comes from the IRP stack
+// object cache. Deeper stacks are allocated from pool.
+//
+
+#define IRP_CACHED_STACK_SIZE 8
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -130,6 +137,11 @@ IopAdvanceIrpStackLocation (
     PIRP_INTERNAL Irp
     );
 
+VOID
+IopFreeIrpStack (
+    PIRP_INTERNAL Irp
+    );
+
 //
 // -------------------------------------------------------------------- Globals
 //
@@ -140,6 +152,12 @@ IopAdvanceIrpStackLocation (
 
 POBJECT_HEADER IoIrpDirectory = NULL;
 
+//
+// Store the object cache that IRP stacks come from.
+//
+
+PMM_OBJECT_CACHE IoIrpStackCache;
+
 //
 // ------------------------------------------------------------------ Functions
 //
@@ -504,13 +522,26 @@ Return Value:
     }
 
     //
-    // Allocate the IRP stack.
+    // Allocate the IRP stack. Most stacks are shallow enough to come from the
+    // object cache, which may come up empty at dispatch level.
     //
 
     AllocationSize = sizeof(IRP_STACK_ENTRY) * Irp->StackSize;
-    Irp->Stack = MmAllocateNonPagedPool(AllocationSize, IRP_ALLOCATION_TAG);
+    if (Irp->StackSize <= IRP_CACHED_STACK_SIZE) {
+        Irp->Stack = MmAllocateObject(IoIrpStackCache);
+        if (Irp->Stack != NULL) {
+            Irp->Flags |= IRP_STACK_CACHED;
+        }
+    }
+
     if (Irp->Stack == NULL) {
-        Status = STATUS_INSUFFICIENT_RESOURCES;
+        Irp->Stack = MmAllocateNonPagedPool(AllocationSize,
+                                            IRP_ALLOCATION_TAG);
+
+        if (Irp->Stack == NULL) {
+            Status = STATUS_INSUFFICIENT_RESOURCES;
+            goto CreateIrpEnd;
+        }
     }
 
     RtlZeroMemory(Irp->Stack, AllocationSize);
@@ -600,7 +631,7 @@ Return Value:
                     }
                 }
 
-                MmFreeNonPagedPool(Irp->Stack);
+                IopFreeIrpStack(Irp);
             }
 
             ASSERT(Irp->Public.Header.ReferenceCount == 1);
@@ -691,7 +722,7 @@ Return Value:
         }
     }
 
-    MmFreeNonPagedPool(InternalIrp->Stack);
+    IopFreeIrpStack(InternalIrp);
     ObReleaseReference(Irp);
     return;
 }
@@ -1184,6 +1215,46 @@ Return Value:
     return TotalStatus;
 }
 
+KSTATUS
+IopInitializeIrpSupport (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine performs global initialization for IRP support.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    IoIrpStackCache = MmCreateObjectCache(
+                               "IrpStack",
+                               sizeof(IRP_STACK_ENTRY) * IRP_CACHED_STACK_SIZE,
+                               0,
+                               NULL,
+                               NULL,
+                               NULL,
+                               MM_OBJECT_CACHE_FLAG_NON_PAGED,
+                               IRP_ALLOCATION_TAG);
+
+    if (IoIrpStackCache == NULL) {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    return STATUS_SUCCESS;
+}
+
 KSTATUS
 IopSendStateChangeIrp (
     PDEVICE Device,
@@ -1399,19 +1470,12 @@ Return Value:
 
 {
 
-    PIRP IoIrp;
     KSTATUS Status;
     PKTHREAD Thread;
 
     ASSERT((Device != NULL) && (Device != IoRootDevice));
     ASSERT(KeGetRunLevel() < RunLevelDispatch);
 
-    IoIrp = IoCreateIrp(Device, IrpMajorIo, 0);
-    if (IoIrp == NULL) {
-        Status = STATUS_INSUFFICIENT_RESOURCES;
-        goto SendIoIrpEnd;
-    }
-
     Thread = KeGetCurrentThread();
 
     //
@@ -1424,44 +1488,103 @@ Return Value:
     }
 
     //
-    // Copy the supplied contents in and send the IRP.
+    // Reads and writes to block devices go through the device's request
+    // queue so they can be sorted and merged. Everything else goes straight
+    // down.
     //
 
-    IoIrp->MinorCode = MinorCodeNumber;
-    RtlCopyMemory(&(IoIrp->U.ReadWrite), Request, sizeof(IRP_READ_WRITE));
-    IoIrp->U.ReadWrite.IoBufferState.IoBuffer = NULL;
-    Status = IoSendSynchronousIrp(IoIrp);
-    if (!KSUCCESS(Status)) {
-        goto SendIoIrpEnd;
+    if ((Device->Header.Type == ObjectDevice) &&
+        (Request->FileProperties != NULL) &&
+        (Request->FileProperties->Type == IoObjectBlockDevice)) {
+
+        Status = IopQueueBlockIo(Device, MinorCodeNumber, Request);
+
+    } else {
+        Status = IopDispatchIoIrp(Device, MinorCodeNumber, Request);
     }
 
-    ASSERT(IoIrp->U.ReadWrite.IoBufferState.IoBuffer == NULL);
+    //
+    // Only account for I/O that succeeded.
+    //
 
-    RtlCopyMemory(Request, &(IoIrp->U.ReadWrite), sizeof(IRP_READ_WRITE));
-    if (Device->Header.Type == ObjectDevice) {
+    if (KSUCCESS(Status) && (Device->Header.Type == ObjectDevice)) {
         if (MinorCodeNumber == IrpMinorIoWrite) {
             RtlAtomicAdd64(&(IoGlobalStatistics.BytesWritten),
-                           IoIrp->U.ReadWrite.IoBytesCompleted);
-
-            Thread->ResourceUsage.BytesWritten +=
-                                           IoIrp->U.ReadWrite.IoBytesCompleted;
+                           Request->IoBytesCompleted);
 
+            Thread->ResourceUsage.BytesWritten += Request->IoBytesCompleted;
             Thread->ResourceUsage.DeviceWrites += 1;
 
         } else {
             RtlAtomicAdd64(&(IoGlobalStatistics.BytesRead),
-                           IoIrp->U.ReadWrite.IoBytesCompleted);
-
-            Thread->ResourceUsage.BytesRead +=
-                                           IoIrp->U.ReadWrite.IoBytesCompleted;
+                           Request->IoBytesCompleted);
 
+            Thread->ResourceUsage.BytesRead += Request->IoBytesCompleted;
             Thread->ResourceUsage.DeviceReads += 1;
         }
     }
 
+    return Status;
+}
+
+KSTATUS
+IopDispatchIoIrp (
+    PDEVICE Device,
+    IRP_MINOR_CODE MinorCodeNumber,
+    PIRP_READ_WRITE Request
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates an I/O IRP, sends it to the given device, and waits
+    for it to complete. It does not go through the block request queue.
+
+Arguments:
+
+    Device - Supplies a pointer to the device to send the IRP to.
+
+    MinorCodeNumber - Supplies the minor code number to send to the IRP.
+
+    Request - Supplies a pointer that on input contains the I/O request
+        parameters. On output, receives the completed parameters.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    PIRP IoIrp;
+    KSTATUS Status;
+
+    IoIrp = IoCreateIrp(Device, IrpMajorIo, 0);
+    if (IoIrp == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto DispatchIoIrpEnd;
+    }
+
+    //
+    // Copy the supplied contents in and send the IRP.
+    //
+
+    IoIrp->MinorCode = MinorCodeNumber;
+    RtlCopyMemory(&(IoIrp->U.ReadWrite), Request, sizeof(IRP_READ_WRITE));
+    IoIrp->U.ReadWrite.IoBufferState.IoBuffer = NULL;
+    Status = IoSendSynchronousIrp(IoIrp);
+    if (!KSUCCESS(Status)) {
+        goto DispatchIoIrpEnd;
+    }
+
+    ASSERT(IoIrp->U.ReadWrite.IoBufferState.IoBuffer == NULL);
+
+    RtlCopyMemory(Request, &(IoIrp->U.ReadWrite), sizeof(IRP_READ_WRITE));
     Status = IoGetIrpStatus(IoIrp);
 
-SendIoIrpEnd:
+DispatchIoIrpEnd:
     if (IoIrp != NULL) {
         IoDestroyIrp(IoIrp);
     }
@@ -1936,3 +2059,38 @@ Return Value:
     return FALSE;
 }
 
+VOID
+IopFreeIrpStack (
+    PIRP_INTERNAL Irp
+    )
+
+/*++
+
+Routine Description:
+
+    This routine frees an IRP's stack back to wherever it came from.
+
+Arguments:
+
+    Irp - Supplies a pointer to the IRP whose stack should be freed.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    if ((Irp->Flags & IRP_STACK_CACHED) != 0) {
+        MmFreeObject(IoIrpStackCache, Irp->Stack);
+        Irp->Flags &= ~IRP_STACK_CACHED;
+
+    } else {
+        MmFreeNonPagedPool(Irp->Stack);
+    }
+
+    Irp->Stack = NULL;
+    return;
+}
+
@@ -137,12 +137,6 @@ Module Name:
 
 #define PAGE_CACHE_FLUSH_MAX_CLEAN_STREAK 4
 
-//
-// Define the block expansion count for the page cache entry block allocator.
-//
-
-#define PAGE_CACHE_BLOCK_ALLOCATOR_EXPANSION_COUNT 0x40
-
 //
 // Define the maximum number of pages that can be used as the minimum number of
 // free pages necessary to require page cache flushes to give up in favor of
@@ -508,10 +502,10 @@ INT64_SYNC IoPageCacheLastCleanTime;
 ULONG IoPageCacheDebugFlags = 0x0;
 
 //
-// Store the global page cache entry block allocator.
+// Store the object cache that page cache entry structures come from.
 //
 
-PBLOCK_ALLOCATOR IoPageCacheBlockAllocator;
+PMM_OBJECT_CACHE IoPageCacheEntryCache;
 
 //
 // Store a pointer to the page cache thread itself.
@@ -995,7 +989,6 @@ Return Value:
 
 {
 
-    PBLOCK_ALLOCATOR BlockAllocator;
     ULONGLONG CurrentTime;
     ULONG PageShift;
     UINTN PhysicalPages;
@@ -1023,23 +1016,23 @@ Return Value:
     }
 
     //
-    // Create the block allocator for the page cache entry structures.
+    // Create the object cache for the page cache entry structures.
     //
 
-    BlockAllocator = MmCreateBlockAllocator(
-                                    sizeof(PAGE_CACHE_ENTRY),
-                                    0,
-                                    PAGE_CACHE_BLOCK_ALLOCATOR_EXPANSION_COUNT,
-                                    BLOCK_ALLOCATOR_FLAG_TRIM,
-                                    PAGE_CACHE_ALLOCATION_TAG);
+    IoPageCacheEntryCache = MmCreateObjectCache("PageCacheEntry",
+                                                sizeof(PAGE_CACHE_ENTRY),
+                                                0,
+                                                NULL,
+                                                NULL,
+                                                NULL,
+                                                0,
+                                                PAGE_CACHE_ALLOCATION_TAG);
 
-    if (BlockAllocator == NULL) {
+    if (IoPageCacheEntryCache == NULL) {
         Status = STATUS_INSUFFICIENT_RESOURCES;
         goto InitializePageCacheEnd;
     }
 
-    IoPageCacheBlockAllocator = BlockAllocator;
-
     //
     // Determine an appropriate limit on the size of the page cache based on
     // the total number of physical pages.
@@ -1165,9 +1158,9 @@ Return Value:
             IoPageCacheWorkTimer = NULL;
         }
 
-        if (IoPageCacheBlockAllocator != NULL) {
-            MmDestroyBlockAllocator(IoPageCacheBlockAllocator);
-            IoPageCacheBlockAllocator = NULL;
+        if (IoPageCacheEntryCache != NULL) {
+            MmDestroyObjectCache(IoPageCacheEntryCache);
+            IoPageCacheEntryCache = NULL;
         }
     }
 
@@ -2359,6 +2352,136 @@ Return Value:
     return;
 }
 
+VOID
+IopEvictCleanPageCacheEntries (
+    PFILE_OBJECT FileObject,
+    IO_OFFSET Offset,
+    ULONGLONG Size
+    )
+
+/*++
+
+Routine Description:
+
+    This routine evicts the page cache entries in the given region of a file
+    or device that are clean and not in use. Dirty entries and entries with
+    outstanding references are left alone. The file object lock must already
+    be held exclusively.
+
+Arguments:
+
+    FileObject - Supplies a pointer to a file object for the device or file.
+
+    Offset - Supplies the offset from the beginning of the file or device where
+        the region starts.
+
+    Size - Supplies the size of the region in bytes. Supply -1 to evict to the
+        end of the file.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PPAGE_CACHE_ENTRY CacheEntry;
+    LIST_ENTRY DestroyListHead;
+    IO_OFFSET End;
+    PRED_BLACK_TREE_NODE Node;
+    BOOL PageTakenDown;
+    PAGE_CACHE_ENTRY SearchEntry;
+    KSTATUS Status;
+
+    ASSERT(KeIsSharedExclusiveLockHeldExclusive(FileObject->Lock) != FALSE);
+
+    if (IO_IS_FILE_OBJECT_CACHEABLE(FileObject) == FALSE) {
+        return;
+    }
+
+    End = Offset + Size;
+    if ((Size == -1ULL) || (End < Offset)) {
+        End = MAX_LONGLONG;
+    }
+
+    INITIALIZE_LIST_HEAD(&DestroyListHead);
+    SearchEntry.FileObject = FileObject;
+    SearchEntry.Offset = Offset;
+    SearchEntry.Flags = 0;
+    Node = RtlRedBlackTreeSearchClosest(&(FileObject->PageCacheTree),
+                                        &(SearchEntry.Node),
+                                        TRUE);
+
+    while (Node != NULL) {
+        CacheEntry = LIST_VALUE(Node, PAGE_CACHE_ENTRY, Node);
+        if (CacheEntry->Offset >= End) {
+            break;
+        }
+
+        Node = RtlRedBlackTreeGetNextNode(&(FileObject->PageCacheTree),
+                                          FALSE,
+                                          Node);
+
+        if ((CacheEntry->ReferenceCount != 0) ||
+            ((CacheEntry->Flags & PAGE_CACHE_ENTRY_FLAG_DIRTY_MASK) != 0)) {
+
+            continue;
+        }
+
+        //
+        // The file object lock holds off new lookups, so with the only
+        // reference the entry can be unmapped from any image sections. Skip
+        // the entry if unmapping it found it dirty.
+        //
+
+        IoPageCacheEntryAddReference(CacheEntry);
+        PageTakenDown = FALSE;
+        if (CacheEntry->ReferenceCount == 1) {
+            Status = IopUnmapPageCacheEntrySections(CacheEntry);
+            if ((KSUCCESS(Status)) &&
+                ((CacheEntry->Flags & PAGE_CACHE_ENTRY_FLAG_DIRTY_MASK) == 0)) {
+
+                IopRemovePageCacheEntryFromTree(CacheEntry);
+                PageTakenDown = TRUE;
+            }
+        }
+
+        if (PageTakenDown == FALSE) {
+            IoPageCacheEntryReleaseReference(CacheEntry);
+            continue;
+        }
+
+        //
+        // Destroy the entry if this is the last reference. Otherwise let the
+        // page cache thread destroy it once the list traversal holding the
+        // other reference is done with it.
+        //
+
+        KeAcquireQueuedLock(IoPageCacheListLock);
+        if (CacheEntry->ListEntry.Next != NULL) {
+            LIST_REMOVE(&(CacheEntry->ListEntry));
+        }
+
+        if (CacheEntry->ReferenceCount == 1) {
+            INSERT_BEFORE(&(CacheEntry->ListEntry), &DestroyListHead);
+
+        } else {
+            INSERT_BEFORE(&(CacheEntry->ListEntry), &IoPageCacheRemovalList);
+        }
+
+        IoPageCacheEntryReleaseReference(CacheEntry);
+        KeReleaseQueuedLock(IoPageCacheListLock);
+    }
+
+    IopDestroyPageCacheEntries(&DestroyListHead);
+    if (LIST_EMPTY(&IoPageCacheRemovalList) == FALSE) {
+        IopSchedulePageCacheThread();
+    }
+
+    return;
+}
+
 BOOL
 IopIsIoBufferPageCacheBacked (
     PFILE_OBJECT FileObject,
@@ -3128,6 +3251,7 @@ Return Value:
     LIST_ENTRY DestroyListHead;
     UINTN FreePageTarget;
     UINTN FreePhysicalPages;
+    UINTN InactivePages;
     UINTN PageOutCount;
     UINTN TargetRemoveCount;
 
@@ -3205,7 +3329,10 @@ Return Value:
     // things so the page cache can grow back up to its target. This throws
     // pageable data into the mix, so if a process allocates a boatload of
     // memory, the page cache doesn't shrink to a dot and constantly lose the
-    // working set of the process.
+    // working set of the process. Go easy on pages that are still active
+    // though: evicting pages processes are using just to grow the page cache
+    // only makes them thrash. Ask for all the inactive pages, but only half
+    // of the remainder, which leaves the pager room to age more pages.
     //
 
     if ((TargetRemoveCount != 0) &&
@@ -3214,6 +3341,11 @@ Return Value:
         PageOutCount = IoPageCacheMinimumPagesTarget -
                        IoPageCachePhysicalPageCount;
 
+        InactivePages = MmGetInactivePhysicalPages();
+        if (PageOutCount > InactivePages) {
+            PageOutCount = InactivePages + ((PageOutCount - InactivePages) / 2);
+        }
+
         FreePageTarget = FreePhysicalPages + PageOutCount;
         if ((IoPageCacheDebugFlags & PAGE_CACHE_DEBUG_SIZE_MANAGEMENT) != 0) {
             RtlDebugPrint("PAGE CACHE: Requesting page out: 0x%I64x\n",
@@ -3388,7 +3520,7 @@ Return Value:
     // Allocate and initialize a new page cache entry.
     //
 
-    NewEntry = MmAllocateBlock(IoPageCacheBlockAllocator, NULL);
+    NewEntry = MmAllocateObject(IoPageCacheEntryCache);
     if (NewEntry == NULL) {
         goto CreatePageCacheEntryEnd;
     }
@@ -3570,7 +3702,7 @@ Return Value:
     // With the final reference gone, free the page cache entry.
     //
 
-    MmFreeBlock(IoPageCacheBlockAllocator, Entry);
+    MmFreeObject(IoPageCacheEntryCache, Entry);
     return;
 }
 
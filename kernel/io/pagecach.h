@@ -309,6 +309,38 @@ Return Value:
 
 --*/
 
+VOID
+IopEvictCleanPageCacheEntries (
+    PFILE_OBJECT FileObject,
+    IO_OFFSET Offset,
+    ULONGLONG Size
+    );
+
+/*++
+
+Routine Description:
+
+    This routine evicts the page cache entries in the given region of a file
+    or device that are clean and not in use. Dirty entries and entries with
+    outstanding references are left alone. The file object lock must already
+    be held exclusively.
+
+Arguments:
+
+    FileObject - Supplies a pointer to a file object for the device or file.
+
+    Offset - Supplies the offset from the beginning of the file or device where
+        the region starts.
+
+    Size - Supplies the size of the region in bytes. Supply -1 to evict to the
+        end of the file.
+
+Return Value:
+
+    None.
+
+--*/
+
 BOOL
 IopIsIoBufferPageCacheBacked (
     PFILE_OBJECT FileObject,
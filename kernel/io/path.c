@@ -58,10 +58,70 @@ Module Name:
 
 #define PATH_UNREACHABLE_PATH_PREFIX "(unreachable)/"
 
+//
+// Define the bounds on the number of buckets in the path entry hash table,
+// and how many physical pages there are per bucket in between.
+//
+
+#define PATH_ENTRY_HASH_MIN_BUCKETS 256
+#define PATH_ENTRY_HASH_MAX_BUCKETS 0x10000
+#define PATH_ENTRY_HASH_PAGES_PER_BUCKET 16
+
+//
+// Define the multiplier used to mix the parent and name hash into a bucket
+// index (2^32 divided by the golden ratio).
+//
+
+#define PATH_ENTRY_HASH_MULTIPLIER 0x9E3779B1
+
+//
+// Define the FNV-1a constants used to hash path components.
+//
+
+#define PATH_HASH_FNV_OFFSET_BASIS 0x811C9DC5
+#define PATH_HASH_FNV_PRIME 0x01000193
+
+//
+// Define the number of slots used to count lockless path lookups in progress.
+// Lookups pick a slot by processor number to avoid sharing a cache line.
+//
+
+#define PATH_WALKER_SLOT_COUNT 32
+
+//
+// Define the number of destroyed path entries to collect before trying to
+// free them, and the number at which destroying a path entry waits for
+// lockless lookups to drain rather than letting the list keep growing.
+//
+
+#define PATH_ENTRY_RETIRE_BATCH 32
+#define PATH_ENTRY_RETIRE_MAX 1024
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
 
+/*++
+
+Structure Description:
+
+    This structure defines a count of lockless path lookups in progress. It is
+    padded out to keep each count on its own cache line.
+
+Members:
+
+    Count - Stores the number of lookups using this slot that have not yet
+        finished.
+
+    Padding - Stores padding out to the size of a cache line.
+
+--*/
+
+typedef struct _PATH_WALKER_SLOT {
+    volatile ULONG Count;
+    ULONG Padding[15];
+} PATH_WALKER_SLOT, *PPATH_WALKER_SLOT;
+
 //
 // ----------------------------------------------- Internal Function Prototypes
 //
@@ -138,6 +198,52 @@ IopGetPathEntryCacheTargetSize (
     VOID
     );
 
+BOOL
+IopFindPathPointLockless (
+    PPATH_POINT Parent,
+    ULONG OpenFlags,
+    PCSTR Name,
+    ULONG NameSize,
+    ULONG Hash,
+    PPATH_POINT Result
+    );
+
+KSTATUS
+IopLookupPathEntryHash (
+    PPATH_ENTRY Parent,
+    PCSTR Name,
+    ULONG NameSize,
+    ULONG Hash,
+    PPATH_ENTRY *Entry,
+    PULONG Sequence
+    );
+
+PLIST_ENTRY
+IopGetPathEntryHashBucket (
+    PPATH_ENTRY Parent,
+    ULONG Hash
+    );
+
+ULONG
+IopStartLocklessPathLookup (
+    VOID
+    );
+
+VOID
+IopEndLocklessPathLookup (
+    ULONG Slot
+    );
+
+VOID
+IopRetirePathEntry (
+    PPATH_ENTRY Entry
+    );
+
+BOOL
+IopWaitForLocklessPathLookups (
+    BOOL Wait
+    );
+
 //
 // -------------------------------------------------------------------- Globals
 //
@@ -163,6 +269,28 @@ LIST_ENTRY IoPathEntryList;
 UINTN IoPathEntryListSize;
 UINTN IoPathEntryListMaxSize;
 
+//
+// Store the global hash table of linked path entries, keyed by parent and
+// name hash. Changes to the table are serialized by the hash lock. Removals
+// bump the sequence number, which is odd while one is in progress, so that
+// lockless readers can detect that the chain changed underneath them.
+//
+
+PQUEUED_LOCK IoPathEntryHashLock;
+PLIST_ENTRY IoPathEntryHashTable;
+ULONG IoPathEntryHashShift;
+volatile ULONG IoPathEntryHashSequence;
+
+//
+// Store the counts of lockless lookups in progress. Destroyed path entries
+// wait on the retired list, protected by the path entry list lock, until no
+// lookup that might have seen them is still running.
+//
+
+PATH_WALKER_SLOT IoPathWalkerSlots[PATH_WALKER_SLOT_COUNT];
+LIST_ENTRY IoPathEntryRetiredList;
+UINTN IoPathEntryRetiredCount;
+
 //
 // ------------------------------------------------------------------ Functions
 //
@@ -447,9 +575,12 @@ Return Value:
 
 {
 
+    ULONG BucketCount;
+    ULONG BucketIndex;
     BOOL Created;
     PFILE_OBJECT FileObject;
     ULONGLONG MaxMemory;
+    UINTN PageCount;
     PPATH_ENTRY PathEntry;
     FILE_PROPERTIES Properties;
     PVOID RootObject;
@@ -467,8 +598,43 @@ Return Value:
     }
 
     INITIALIZE_LIST_HEAD(&IoPathEntryList);
+    INITIALIZE_LIST_HEAD(&IoPathEntryRetiredList);
     IoPathEntryListSize = 0;
-    MaxMemory = MmGetTotalPhysicalPages() * MmPageSize();
+    IoPathEntryHashLock = KeCreateQueuedLock();
+    if (IoPathEntryHashLock == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto InitializePathSupportEnd;
+    }
+
+    //
+    // Size the hash table to the amount of memory in the system, which is
+    // what bounds the number of path entries that can be cached.
+    //
+
+    PageCount = MmGetTotalPhysicalPages();
+    IoPathEntryHashShift = 32;
+    BucketCount = 1;
+    while ((BucketCount < PATH_ENTRY_HASH_MAX_BUCKETS) &&
+           ((BucketCount < PATH_ENTRY_HASH_MIN_BUCKETS) ||
+            ((BucketCount * PATH_ENTRY_HASH_PAGES_PER_BUCKET) < PageCount))) {
+
+        BucketCount <<= 1;
+        IoPathEntryHashShift -= 1;
+    }
+
+    IoPathEntryHashTable = MmAllocatePagedPool(BucketCount * sizeof(LIST_ENTRY),
+                                               PATH_ALLOCATION_TAG);
+
+    if (IoPathEntryHashTable == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto InitializePathSupportEnd;
+    }
+
+    for (BucketIndex = 0; BucketIndex < BucketCount; BucketIndex += 1) {
+        INITIALIZE_LIST_HEAD(&(IoPathEntryHashTable[BucketIndex]));
+    }
+
+    MaxMemory = PageCount * MmPageSize();
     if (MaxMemory > (MAX_UINTN - (UINTN)KERNEL_VA_START + 1)) {
         MaxMemory = MAX_UINTN - (UINTN)KERNEL_VA_START + 1;
     }
@@ -507,6 +673,16 @@ Return Value:
             IoPathEntryListLock = NULL;
         }
 
+        if (IoPathEntryHashLock != NULL) {
+            KeDestroyQueuedLock(IoPathEntryHashLock);
+            IoPathEntryHashLock = NULL;
+        }
+
+        if (IoPathEntryHashTable != NULL) {
+            MmFreePagedPool(IoPathEntryHashTable);
+            IoPathEntryHashTable = NULL;
+        }
+
         if (RootObject != NULL) {
             ObReleaseReference(RootObject);
         }
@@ -986,9 +1162,25 @@ Return Value:
 
 {
 
+    ULONG Hash;
+    PCSTR End;
+
     ASSERT(StringSize != 0);
 
-    return RtlComputeCrc32(0, String, StringSize - 1);
+    //
+    // Use FNV-1a, which is a good deal cheaper than a CRC for the short
+    // strings that make up path components.
+    //
+
+    Hash = PATH_HASH_FNV_OFFSET_BASIS;
+    End = String + StringSize - 1;
+    while (String < End) {
+        Hash ^= (UCHAR)*String;
+        Hash *= PATH_HASH_FNV_PRIME;
+        String += 1;
+    }
+
+    return Hash;
 }
 
 BOOL
@@ -1040,6 +1232,57 @@ Return Value:
     return FALSE;
 }
 
+VOID
+IopPathLink (
+    PPATH_ENTRY Entry
+    )
+
+/*++
+
+Routine Description:
+
+    This routine links the given path entry into its parent's list of children
+    and into the global path entry hash table, making it visible to path walks.
+    The caller must hold the parent path entry's file object lock exclusively.
+
+Arguments:
+
+    Entry - Supplies a pointer to the path entry to link into the path
+        hierarchy.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PLIST_ENTRY Bucket;
+
+    ASSERT(Entry->Parent != NULL);
+    ASSERT(Entry->SiblingListEntry.Next == NULL);
+    ASSERT(Entry->HashListEntry.Next == NULL);
+
+    INSERT_BEFORE(&(Entry->SiblingListEntry), &(Entry->Parent->ChildList));
+
+    //
+    // Insertions do not change the sequence number, as a lockless lookup that
+    // misses a new entry simply falls back to the locked path. The barrier
+    // makes sure the entry is fully initialized before it becomes visible.
+    //
+
+    Bucket = IopGetPathEntryHashBucket(Entry->Parent, Entry->Hash);
+    KeAcquireQueuedLock(IoPathEntryHashLock);
+    Entry->HashListEntry.Next = Bucket;
+    Entry->HashListEntry.Previous = Bucket->Previous;
+    RtlMemoryBarrier();
+    Bucket->Previous->Next = &(Entry->HashListEntry);
+    Bucket->Previous = &(Entry->HashListEntry);
+    KeReleaseQueuedLock(IoPathEntryHashLock);
+    return;
+}
+
 VOID
 IopPathUnlink (
     PPATH_ENTRY Entry
@@ -1079,6 +1322,24 @@ Return Value:
         Entry->SiblingListEntry.Next = NULL;
     }
 
+    //
+    // Pull the entry out of the hash table. A lockless lookup standing on
+    // this entry may still follow its links, or find them cleared. Either
+    // way the sequence number change tells that lookup to give up.
+    //
+
+    if (Entry->HashListEntry.Next != NULL) {
+        KeAcquireQueuedLock(IoPathEntryHashLock);
+        IoPathEntryHashSequence += 1;
+        RtlMemoryBarrier();
+        Entry->HashListEntry.Previous->Next = Entry->HashListEntry.Next;
+        Entry->HashListEntry.Next->Previous = Entry->HashListEntry.Previous;
+        RtlMemoryBarrier();
+        IoPathEntryHashSequence += 1;
+        KeReleaseQueuedLock(IoPathEntryHashLock);
+        Entry->HashListEntry.Next = NULL;
+    }
+
     return;
 }
 
@@ -1496,6 +1757,33 @@ Return Value:
         return STATUS_SUCCESS;
     }
 
+    //
+    // Try to find an active entry in the cache without taking any locks.
+    //
+
+    Hash = IopHashPathString(Name, NameSize);
+    if (DirectoryLockHeld == FALSE) {
+        FoundPathPoint = IopFindPathPointLockless(Directory,
+                                                  OpenFlags,
+                                                  Name,
+                                                  NameSize,
+                                                  Hash,
+                                                  Result);
+
+        if (FoundPathPoint != FALSE) {
+
+            ASSERT(Result->PathEntry->Negative == FALSE);
+
+            if ((TypeOverride != IoObjectInvalid) &&
+                ((OpenFlags & OPEN_FLAG_FAIL_IF_EXISTS) != 0)) {
+
+                return STATUS_FILE_EXISTS;
+            }
+
+            return STATUS_SUCCESS;
+        }
+    }
+
     //
     // First cruise through the cached list looking for this entry. Successful
     // return adds a reference to the found entry.
@@ -1505,7 +1793,6 @@ Return Value:
         KeAcquireSharedExclusiveLockShared(DirectoryFileObject->Lock);
     }
 
-    Hash = IopHashPathString(Name, NameSize);
     FoundPathPoint = IopFindPathPoint(Directory,
                                       OpenFlags,
                                       Name,
@@ -2946,19 +3233,22 @@ Return Value:
                (FileObject->Device == PathRoot) &&
                (Result->MountPoint == Directory->MountPoint));
 
-        Result->PathEntry->Negative = FALSE;
         Result->PathEntry->DoNotCache = DoNotCache;
 
         ASSERT(FileObject != NULL);
         ASSERT(FileObject->ReferenceCount >= 2);
 
+        //
+        // Set the file object before clearing the negative flag, as lockless
+        // lookups may be looking at this entry.
+        //
+
         Result->PathEntry->FileObject = FileObject;
         IopFileObjectAddPathEntryReference(Result->PathEntry->FileObject);
+        RtlMemoryBarrier();
+        Result->PathEntry->Negative = FALSE;
         if ((OpenFlags & OPEN_FLAG_UNLINK_ON_CREATE) != 0) {
-            if (Result->PathEntry->SiblingListEntry.Next != NULL) {
-                LIST_REMOVE(&(Result->PathEntry->SiblingListEntry));
-                Result->PathEntry->SiblingListEntry.Next = NULL;
-            }
+            IopPathUnlink(Result->PathEntry);
         }
 
     //
@@ -2993,8 +3283,7 @@ Return Value:
             ASSERT((FileObject == NULL) ||
                    (FileObject->Properties.HardLinkCount != 0));
 
-            INSERT_BEFORE(&(PathEntry->SiblingListEntry),
-                          &(DirectoryEntry->ChildList));
+            IopPathLink(PathEntry);
         }
 
         Result->PathEntry = PathEntry;
@@ -3246,6 +3535,9 @@ Return Value:
     PPATH_ENTRY FoundPathEntry;
     PFILE_OBJECT ParentFileObject;
     BOOL ResultValid;
+    ULONG Sequence;
+    ULONG Slot;
+    KSTATUS Status;
 
     ResultValid = FALSE;
     ParentFileObject = Parent->PathEntry->FileObject;
@@ -3254,29 +3546,51 @@ Return Value:
     ASSERT(KeIsSharedExclusiveLockHeld(ParentFileObject->Lock) != FALSE);
 
     //
-    // Cruise through the cached list looking for this entry.
+    // Look in the hash table first. With the parent's lock held, this
+    // directory's children cannot change, but removals from other directories
+    // sharing the bucket can still cause the lookup to give up.
     //
 
-    CurrentEntry = Parent->PathEntry->ChildList.Next;
-    while (CurrentEntry != &(Parent->PathEntry->ChildList)) {
-        Entry = LIST_VALUE(CurrentEntry, PATH_ENTRY, SiblingListEntry);
-        CurrentEntry = CurrentEntry->Next;
+    Slot = IopStartLocklessPathLookup();
+    Status = IopLookupPathEntryHash(Parent->PathEntry,
+                                    Name,
+                                    NameSize,
+                                    Hash,
+                                    &Entry,
+                                    &Sequence);
 
-        //
-        // Quickly skip entries without a name or with the wrong hash.
-        //
+    IopEndLocklessPathLookup(Slot);
+    if (Status == STATUS_NOT_FOUND) {
+        return FALSE;
+    }
 
-        if ((Entry->Hash != Hash) || (Entry->Name == NULL)) {
-            continue;
-        }
+    //
+    // If the hash table was changing, cruise through the cached list looking
+    // for this entry.
+    //
 
-        //
-        // If the names are not equal, this isn't the winner.
-        //
+    if (!KSUCCESS(Status)) {
+        Entry = NULL;
+        CurrentEntry = Parent->PathEntry->ChildList.Next;
+        while (CurrentEntry != &(Parent->PathEntry->ChildList)) {
+            Entry = LIST_VALUE(CurrentEntry, PATH_ENTRY, SiblingListEntry);
+            CurrentEntry = CurrentEntry->Next;
+
+            //
+            // Stop at the entry with a matching hash and name.
+            //
+
+            if ((Entry->Hash == Hash) && (Entry->Name != NULL) &&
+                (IopArePathsEqual(Entry->Name, Name, NameSize) != FALSE)) {
 
-        if (IopArePathsEqual(Entry->Name, Name, NameSize) == FALSE) {
-            continue;
+                break;
+            }
+
+            Entry = NULL;
         }
+    }
+
+    if (Entry != NULL) {
 
         //
         // If the found entry is a mount point, then the parent mount point's
@@ -3312,7 +3626,6 @@ Return Value:
         Result->PathEntry = FoundPathEntry;
         Result->MountPoint = FoundMountPoint;
         ResultValid = TRUE;
-        break;
     }
 
     return ResultValid;
@@ -3360,6 +3673,7 @@ Return Value:
     PFILE_OBJECT NextFileObject;
     ULONG OldReferenceCount;
     PPATH_ENTRY Parent;
+    ULONG PreviousCount;
 
     ASSERT(KeGetRunLevel() == RunLevelLow);
 
@@ -3367,6 +3681,33 @@ Return Value:
     NextFileObject = NULL;
     while (Entry != NULL) {
 
+        //
+        // If this is not the last reference, just drop it. Only the drop to
+        // zero needs the parent's lock, so that it cannot race with a lookup
+        // bringing the entry back from the cache.
+        //
+
+        OldReferenceCount = Entry->ReferenceCount;
+        while (OldReferenceCount > 1) {
+            PreviousCount = RtlAtomicCompareExchange32(
+                                                &(Entry->ReferenceCount),
+                                                OldReferenceCount - 1,
+                                                OldReferenceCount);
+
+            if (PreviousCount == OldReferenceCount) {
+                break;
+            }
+
+            OldReferenceCount = PreviousCount;
+        }
+
+        if (OldReferenceCount > 1) {
+
+            ASSERT(OldReferenceCount < 0x10000000);
+
+            break;
+        }
+
         //
         // Acquire the parent's lock to avoid a situation where this routine
         // decrements the reference count to zero, but before removing it
@@ -3589,10 +3930,7 @@ Return Value:
         // entries.
         //
 
-        if (Entry->SiblingListEntry.Next != NULL) {
-            LIST_REMOVE(&(Entry->SiblingListEntry));
-            Entry->SiblingListEntry.Next = NULL;
-        }
+        IopPathUnlink(Entry);
 
         ASSERT(ParentFileObject != NULL);
 
@@ -3621,7 +3959,18 @@ Return Value:
         IopFileObjectReleaseReference(Entry->FileObject);
     }
 
-    MmFreePagedPool(Entry);
+    //
+    // An entry that had a parent may have been seen by a lockless lookup, so
+    // its memory cannot be reused until those lookups are done.
+    //
+
+    if (Parent != NULL) {
+        IopRetirePathEntry(Entry);
+
+    } else {
+        MmFreePagedPool(Entry);
+    }
+
     return Parent;
 }
 
@@ -3679,3 +4028,483 @@ Return Value:
     return 0;
 }
 
+BOOL
+IopFindPathPointLockless (
+    PPATH_POINT Parent,
+    ULONG OpenFlags,
+    PCSTR Name,
+    ULONG NameSize,
+    ULONG Hash,
+    PPATH_POINT Result
+    )
+
+/*++
+
+Routine Description:
+
+    This routine attempts to find a child of the given path point without
+    acquiring any locks. It only succeeds for path entries that are in use
+    (have a non-zero reference count), are not negative, and are not mount
+    points. Everything else is left to the locked lookup.
+
+Arguments:
+
+    Parent - Supplies a pointer to the parent path point whose children should
+        be searched. The caller must have a reference on this path point.
+
+    OpenFlags - Supplies a bitfield of flags governing the behavior of the
+        search. See OPEN_FLAG_* definitions.
+
+    Name - Supplies a pointer the query string, which may not be null
+        terminated.
+
+    NameSize - Supplies the size of the string including the assumed null
+        terminator that is never checked.
+
+    Hash - Supplies the hash of the name query string.
+
+    Result - Supplies a pointer to a path point that receives the found path
+        entry and associated mount point on success. References are taken on
+        both elements if found.
+
+Return Value:
+
+    Returns TRUE if a matching path point was found.
+
+    FALSE if the entry was not found or the caller should retry with locks
+    held.
+
+--*/
+
+{
+
+    PPATH_ENTRY Entry;
+    ULONG PreviousCount;
+    ULONG ReferenceCount;
+    BOOL Release;
+    ULONG Sequence;
+    ULONG Slot;
+    KSTATUS Status;
+
+    Release = FALSE;
+    Slot = IopStartLocklessPathLookup();
+    Status = IopLookupPathEntryHash(Parent->PathEntry,
+                                    Name,
+                                    NameSize,
+                                    Hash,
+                                    &Entry,
+                                    &Sequence);
+
+    if (!KSUCCESS(Status)) {
+        Entry = NULL;
+        goto FindPathPointLocklessEnd;
+    }
+
+    //
+    // Mount points need the mount tree lock to traverse, and negative entries
+    // may be in the middle of conversion. Let the locked path handle those.
+    //
+
+    if ((Entry->Negative != FALSE) ||
+        ((Entry->MountCount != 0) &&
+         ((OpenFlags & OPEN_FLAG_NO_MOUNT_POINT) == 0))) {
+
+        Entry = NULL;
+        goto FindPathPointLocklessEnd;
+    }
+
+    //
+    // Take a reference, but only if the entry already has one. An entry whose
+    // count has dropped to zero is either sitting on the cache list or on its
+    // way to being destroyed, and only the locked path can safely revive it.
+    //
+
+    ReferenceCount = Entry->ReferenceCount;
+    while (TRUE) {
+        if (ReferenceCount == 0) {
+            Entry = NULL;
+            goto FindPathPointLocklessEnd;
+        }
+
+        ASSERT(ReferenceCount < 0x10000000);
+
+        PreviousCount = RtlAtomicCompareExchange32(&(Entry->ReferenceCount),
+                                                   ReferenceCount + 1,
+                                                   ReferenceCount);
+
+        if (PreviousCount == ReferenceCount) {
+            break;
+        }
+
+        ReferenceCount = PreviousCount;
+    }
+
+    //
+    // If an entry was removed from the hash table since the lookup started,
+    // the entry found may no longer be the parent's child by that name.
+    //
+
+    RtlMemoryBarrier();
+    if (IoPathEntryHashSequence != Sequence) {
+        Release = TRUE;
+    }
+
+FindPathPointLocklessEnd:
+    IopEndLocklessPathLookup(Slot);
+    if (Entry == NULL) {
+        return FALSE;
+    }
+
+    if (Release != FALSE) {
+        IoPathEntryReleaseReference(Entry);
+        return FALSE;
+    }
+
+    ASSERT((Entry->Negative == FALSE) && (Entry->FileObject != NULL));
+
+    IoMountPointAddReference(Parent->MountPoint);
+    Result->PathEntry = Entry;
+    Result->MountPoint = Parent->MountPoint;
+    return TRUE;
+}
+
+KSTATUS
+IopLookupPathEntryHash (
+    PPATH_ENTRY Parent,
+    PCSTR Name,
+    ULONG NameSize,
+    ULONG Hash,
+    PPATH_ENTRY *Entry,
+    PULONG Sequence
+    )
+
+/*++
+
+Routine Description:
+
+    This routine searches the global path entry hash table for the child of
+    the given path entry with the given name. It does not acquire any locks,
+    so the caller must have started a lockless lookup. No reference is taken
+    on the returned entry.
+
+Arguments:
+
+    Parent - Supplies a pointer to the parent path entry.
+
+    Name - Supplies a pointer the query string, which may not be null
+        terminated.
+
+    NameSize - Supplies the size of the string including the assumed null
+        terminator that is never checked.
+
+    Hash - Supplies the hash of the name query string.
+
+    Entry - Supplies a pointer where a pointer to the matching path entry will
+        be returned on success.
+
+    Sequence - Supplies a pointer where the hash table sequence number that
+        the search was validated against will be returned. The caller can
+        compare against this later to see whether anything was removed since.
+
+Return Value:
+
+    STATUS_SUCCESS if a matching entry was found.
+
+    STATUS_NOT_FOUND if no entry by that name is in the hash table.
+
+    STATUS_TRY_AGAIN if an entry was removed from the hash table during the
+    search, in which case the result is unknown.
+
+--*/
+
+{
+
+    PLIST_ENTRY Bucket;
+    PLIST_ENTRY CurrentEntry;
+    ULONG CurrentSequence;
+    PPATH_ENTRY Found;
+
+    ASSERT(NameSize != 0);
+
+    *Entry = NULL;
+    *Sequence = IoPathEntryHashSequence;
+    if ((*Sequence & 0x1) != 0) {
+        return STATUS_TRY_AGAIN;
+    }
+
+    RtlMemoryBarrier();
+    Bucket = IopGetPathEntryHashBucket(Parent, Hash);
+    CurrentEntry = Bucket->Next;
+    while (CurrentEntry != Bucket) {
+
+        //
+        // A cleared link means the entry was just removed. The sequence
+        // number has already changed in that case.
+        //
+
+        if (CurrentEntry == NULL) {
+            return STATUS_TRY_AGAIN;
+        }
+
+        Found = LIST_VALUE(CurrentEntry, PATH_ENTRY, HashListEntry);
+        if ((Found->Parent == Parent) && (Found->Hash == Hash) &&
+            (Found->Name != NULL) &&
+            (IopArePathsEqual(Found->Name, Name, NameSize) != FALSE)) {
+
+            *Entry = Found;
+            break;
+        }
+
+        //
+        // If something was removed, this chain may have led off into another
+        // bucket, so give up rather than risk never coming back around.
+        //
+
+        CurrentEntry = CurrentEntry->Next;
+        RtlMemoryBarrier();
+        CurrentSequence = IoPathEntryHashSequence;
+        if (CurrentSequence != *Sequence) {
+            *Entry = NULL;
+            return STATUS_TRY_AGAIN;
+        }
+    }
+
+    RtlMemoryBarrier();
+    if (IoPathEntryHashSequence != *Sequence) {
+        *Entry = NULL;
+        return STATUS_TRY_AGAIN;
+    }
+
+    if (*Entry == NULL) {
+        return STATUS_NOT_FOUND;
+    }
+
+    return STATUS_SUCCESS;
+}
+
+PLIST_ENTRY
+IopGetPathEntryHashBucket (
+    PPATH_ENTRY Parent,
+    ULONG Hash
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the hash table bucket for the child of the given
+    parent with the given name hash.
+
+Arguments:
+
+    Parent - Supplies a pointer to the parent path entry.
+
+    Hash - Supplies the hash of the child's name.
+
+Return Value:
+
+    Returns a pointer to the list head of the bucket.
+
+--*/
+
+{
+
+    ULONG Index;
+
+    Index = Hash ^ (ULONG)((UINTN)Parent >> 4);
+    Index = (Index * PATH_ENTRY_HASH_MULTIPLIER) >> IoPathEntryHashShift;
+    return &(IoPathEntryHashTable[Index]);
+}
+
+ULONG
+IopStartLocklessPathLookup (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine marks the start of a section where path entries in the hash
+    table are examined without holding locks. Path entries destroyed while
+    the section is running are not freed until it ends.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Returns the slot to pass to the end routine.
+
+--*/
+
+{
+
+    ULONG Slot;
+
+    Slot = KeGetCurrentProcessorNumber() % PATH_WALKER_SLOT_COUNT;
+    RtlAtomicAdd32(&(IoPathWalkerSlots[Slot].Count), 1);
+    return Slot;
+}
+
+VOID
+IopEndLocklessPathLookup (
+    ULONG Slot
+    )
+
+/*++
+
+Routine Description:
+
+    This routine marks the end of a section where path entries in the hash
+    table are examined without holding locks.
+
+Arguments:
+
+    Slot - Supplies the slot returned when the section was started. The thread
+        may have moved to a different processor since.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG OldCount;
+
+    OldCount = RtlAtomicAdd32(&(IoPathWalkerSlots[Slot].Count), -1);
+
+    ASSERT((OldCount != 0) && (OldCount < 0x10000000));
+
+    return;
+}
+
+VOID
+IopRetirePathEntry (
+    PPATH_ENTRY Entry
+    )
+
+/*++
+
+Routine Description:
+
+    This routine frees a destroyed path entry once no lockless lookup can
+    still be looking at it. Entries are collected and freed in batches.
+
+Arguments:
+
+    Entry - Supplies a pointer to the destroyed path entry. It must already
+        have been removed from the hash table.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PLIST_ENTRY CurrentEntry;
+    UINTN Count;
+    LIST_ENTRY FreeList;
+    BOOL Wait;
+
+    ASSERT(KeGetRunLevel() == RunLevelLow);
+    ASSERT(Entry->HashListEntry.Next == NULL);
+    ASSERT(Entry->CacheListEntry.Next == NULL);
+
+    KeAcquireQueuedLock(IoPathEntryListLock);
+    INSERT_BEFORE(&(Entry->CacheListEntry), &IoPathEntryRetiredList);
+    IoPathEntryRetiredCount += 1;
+    if (IoPathEntryRetiredCount < PATH_ENTRY_RETIRE_BATCH) {
+        KeReleaseQueuedLock(IoPathEntryListLock);
+        return;
+    }
+
+    //
+    // Take the whole list. Every entry on it was removed from the hash table
+    // before this point, so any lookup started from here on cannot find them.
+    //
+
+    Wait = FALSE;
+    if (IoPathEntryRetiredCount >= PATH_ENTRY_RETIRE_MAX) {
+        Wait = TRUE;
+    }
+
+    Count = IoPathEntryRetiredCount;
+    MOVE_LIST(&IoPathEntryRetiredList, &FreeList);
+    INITIALIZE_LIST_HEAD(&IoPathEntryRetiredList);
+    IoPathEntryRetiredCount = 0;
+    KeReleaseQueuedLock(IoPathEntryListLock);
+
+    //
+    // If there are lookups in flight, put the entries back and try again
+    // with the next batch.
+    //
+
+    if (IopWaitForLocklessPathLookups(Wait) == FALSE) {
+        KeAcquireQueuedLock(IoPathEntryListLock);
+        APPEND_LIST(&FreeList, &IoPathEntryRetiredList);
+        IoPathEntryRetiredCount += Count;
+        KeReleaseQueuedLock(IoPathEntryListLock);
+        return;
+    }
+
+    while (LIST_EMPTY(&FreeList) == FALSE) {
+        CurrentEntry = FreeList.Next;
+        LIST_REMOVE(CurrentEntry);
+        MmFreePagedPool(LIST_VALUE(CurrentEntry, PATH_ENTRY, CacheListEntry));
+    }
+
+    return;
+}
+
+BOOL
+IopWaitForLocklessPathLookups (
+    BOOL Wait
+    )
+
+/*++
+
+Routine Description:
+
+    This routine determines whether every lockless path lookup that was
+    running when this routine was called has finished. Each slot only has to
+    be seen empty once, since a lookup that starts after its slot was checked
+    started after the call.
+
+Arguments:
+
+    Wait - Supplies a boolean indicating whether to yield the processor until
+        lookups in flight finish (TRUE) or to give up right away (FALSE).
+
+Return Value:
+
+    TRUE if no lookup that was in flight at the time of the call is still
+    running.
+
+    FALSE if a lookup was in flight and the caller did not want to wait.
+
+--*/
+
+{
+
+    ULONG Slot;
+
+    RtlMemoryBarrier();
+    for (Slot = 0; Slot < PATH_WALKER_SLOT_COUNT; Slot += 1) {
+        while (IoPathWalkerSlots[Slot].Count != 0) {
+            if (Wait == FALSE) {
+                return FALSE;
+            }
+
+            KeYield();
+        }
+    }
+
+    RtlMemoryBarrier();
+    return TRUE;
+}
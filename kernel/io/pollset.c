@@ -0,0 +1,1560 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    pollset.c
+
+Abstract:
+
+    This module implements poll sets, persistent collections of I/O handles
+    that can be waited on together. Unlike a poll call, which scans every
+    handle each time, a poll set registers itself with the I/O object state of
+    each member and is told when events are signaled. Waiting on a poll set
+    only looks at the members that have become ready.
+
+Author:
+
+    agent 16-Oct-2026
+
+Environment:
+
+    Kernel
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <minoca/kernel/kernel.h>
+#include "iop.h"
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+#define POLL_SET_ALLOCATION_TAG 0x74655350 // 'teSP'
+
+//
+// Define the maximum number of events returned by a single wait.
+//
+
+#define POLL_SET_MAX_WAIT_EVENTS 512
+
+//
+// Define poll set entry flags.
+//
+
+//
+// This flag is set if a one-shot entry has been reported and will not be
+// reported again until it is modified.
+//
+
+#define POLL_SET_ENTRY_FLAG_DISABLED 0x00000001
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+/*++
+
+Structure Description:
+
+    This structure defines a poll set.
+
+Members:
+
+    Header - Stores the standard object header.
+
+    Lock - Stores a pointer to the lock protecting the entry tree and the
+        ready list.
+
+    EntryTree - Stores the tree of entries in the set, keyed by descriptor.
+
+    ReadyList - Stores the list of entries that may have events signaled.
+
+    IoState - Stores a pointer to the I/O object state of the poll set itself,
+        which is readable whenever the ready list is not empty.
+
+    EntryCount - Stores the number of entries in the set.
+
+--*/
+
+typedef struct _POLL_SET {
+    OBJECT_HEADER Header;
+    PQUEUED_LOCK Lock;
+    RED_BLACK_TREE EntryTree;
+    LIST_ENTRY ReadyList;
+    PIO_OBJECT_STATE IoState;
+    ULONG EntryCount;
+} POLL_SET, *PPOLL_SET;
+
+/*++
+
+Structure Description:
+
+    This structure defines the registration of an I/O handle in a poll set.
+
+Members:
+
+    TreeNode - Stores the node in the poll set's entry tree.
+
+    ReadyListEntry - Stores pointers to the next and previous entries on the
+        poll set's ready list. The next pointer is NULL if the entry is not on
+        the ready list.
+
+    WatchListEntry - Stores pointers to the next and previous entries watching
+        the same I/O object state.
+
+    PollSet - Stores a pointer to the poll set that owns the entry.
+
+    IoHandle - Stores a pointer to the I/O handle being watched. No reference
+        is held; the entry is removed when the handle is closed.
+
+    IoState - Stores a pointer to the I/O object state being watched.
+
+    Descriptor - Stores the user mode handle the entry was registered with.
+
+    Events - Stores the mask of events being watched, plus any
+        POLL_SET_EVENT_* flags.
+
+    Flags - Stores a bitmask of flags. See POLL_SET_ENTRY_FLAG_* definitions.
+
+    Data - Stores the opaque value returned along with the entry's events.
+
+--*/
+
+typedef struct _POLL_SET_ENTRY {
+    RED_BLACK_TREE_NODE TreeNode;
+    LIST_ENTRY ReadyListEntry;
+    LIST_ENTRY WatchListEntry;
+    PPOLL_SET PollSet;
+    PIO_HANDLE IoHandle;
+    PIO_OBJECT_STATE IoState;
+    HANDLE Descriptor;
+    ULONG Events;
+    ULONG Flags;
+    ULONGLONG Data;
+} POLL_SET_ENTRY, *PPOLL_SET_ENTRY;
+
+/*++
+
+Structure Description:
+
+    This structure defines the poll set state of an I/O object, which hangs
+    off of the I/O object state once the object has been added to a poll set.
+
+Members:
+
+    EntryList - Stores the head of the list of poll set entries watching the
+        object.
+
+    Lock - Stores a pointer to the lock protecting the entry list.
+
+--*/
+
+struct _IO_POLL_STATE {
+    LIST_ENTRY EntryList;
+    PQUEUED_LOCK Lock;
+};
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+VOID
+IopDestroyPollSet (
+    PVOID Object
+    );
+
+PIO_POLL_STATE
+IopGetPollState (
+    PIO_OBJECT_STATE IoState
+    );
+
+KSTATUS
+IopAddPollSetEntry (
+    PPOLL_SET PollSet,
+    HANDLE Descriptor,
+    PIO_HANDLE IoHandle,
+    PPOLL_SET_EVENT Event
+    );
+
+KSTATUS
+IopModifyPollSetEntry (
+    PPOLL_SET PollSet,
+    HANDLE Descriptor,
+    PIO_HANDLE IoHandle,
+    PPOLL_SET_EVENT Event
+    );
+
+PPOLL_SET_ENTRY
+IopFindPollSetEntry (
+    PPOLL_SET PollSet,
+    HANDLE Descriptor,
+    PIO_HANDLE IoHandle
+    );
+
+VOID
+IopRemovePollSetEntry (
+    PPOLL_SET_ENTRY Entry
+    );
+
+VOID
+IopUnlinkPollSetEntry (
+    PPOLL_SET_ENTRY Entry
+    );
+
+VOID
+IopQueuePollSetEntry (
+    PPOLL_SET_ENTRY Entry
+    );
+
+ULONG
+IopCollectPollSetEvents (
+    PPOLL_SET PollSet,
+    PPOLL_SET_EVENT Events,
+    ULONG EventCount
+    );
+
+COMPARISON_RESULT
+IopComparePollSetEntries (
+    PRED_BLACK_TREE Tree,
+    PRED_BLACK_TREE_NODE FirstNode,
+    PRED_BLACK_TREE_NODE SecondNode
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// Store a pointer to the poll set directory.
+//
+
+POBJECT_HEADER IoPollSetDirectory;
+
+//
+// Store the lock that serializes adding and removing poll set entries. This
+// is only needed for changes in membership, never for event delivery or
+// waits. It is always acquired before any I/O object's poll state lock,
+// which is always acquired before any poll set's lock.
+//
+
+PQUEUED_LOCK IoPollSetLock;
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+INTN
+IoSysCreatePollSet (
+    PVOID SystemCallParameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine implements the user mode system call for creating a poll set.
+
+Arguments:
+
+    SystemCallParameter - Supplies a pointer to the parameters supplied with
+        the system call. This structure will be a stack-local copy of the
+        actual parameters passed from user-mode.
+
+Return Value:
+
+    STATUS_SUCCESS or positive integer on success.
+
+    Error status code on failure.
+
+--*/
+
+{
+
+    ULONG HandleFlags;
+    PIO_HANDLE IoHandle;
+    PSYSTEM_CALL_CREATE_POLL_SET Parameters;
+    PKPROCESS Process;
+    KSTATUS Status;
+
+    IoHandle = NULL;
+    Parameters = (PSYSTEM_CALL_CREATE_POLL_SET)SystemCallParameter;
+    Parameters->Handle = INVALID_HANDLE;
+    Process = PsGetCurrentProcess();
+    if ((Parameters->OpenFlags & ~SYS_OPEN_FLAG_CLOSE_ON_EXECUTE) != 0) {
+        Status = STATUS_INVALID_PARAMETER;
+        goto SysCreatePollSetEnd;
+    }
+
+    Status = IopOpen(FALSE,
+                     NULL,
+                     NULL,
+                     0,
+                     IO_ACCESS_READ,
+                     OPEN_FLAG_CREATE,
+                     IoObjectPollSet,
+                     NULL,
+                     FILE_PERMISSION_USER_READ | FILE_PERMISSION_USER_WRITE,
+                     &IoHandle);
+
+    if (!KSUCCESS(Status)) {
+        goto SysCreatePollSetEnd;
+    }
+
+    HandleFlags = 0;
+    if ((Parameters->OpenFlags & SYS_OPEN_FLAG_CLOSE_ON_EXECUTE) != 0) {
+        HandleFlags |= FILE_DESCRIPTOR_CLOSE_ON_EXECUTE;
+    }
+
+    Status = ObCreateHandle(Process->HandleTable,
+                            IoHandle,
+                            HandleFlags,
+                            &(Parameters->Handle));
+
+    if (!KSUCCESS(Status)) {
+        goto SysCreatePollSetEnd;
+    }
+
+    IoHandle = NULL;
+
+SysCreatePollSetEnd:
+    if (IoHandle != NULL) {
+        IoClose(IoHandle);
+    }
+
+    return Status;
+}
+
+INTN
+IoSysControlPollSet (
+    PVOID SystemCallParameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine implements the user mode system call for adding, modifying,
+    or removing an I/O handle in a poll set.
+
+Arguments:
+
+    SystemCallParameter - Supplies a pointer to the parameters supplied with
+        the system call. This structure will be a stack-local copy of the
+        actual parameters passed from user-mode.
+
+Return Value:
+
+    STATUS_SUCCESS or positive integer on success.
+
+    Error status code on failure.
+
+--*/
+
+{
+
+    PPOLL_SET_ENTRY Entry;
+    PIO_HANDLE IoHandle;
+    PSYSTEM_CALL_CONTROL_POLL_SET Parameters;
+    PPOLL_SET PollSet;
+    PIO_HANDLE PollSetHandle;
+    PKPROCESS Process;
+    KSTATUS Status;
+
+    IoHandle = NULL;
+    Parameters = (PSYSTEM_CALL_CONTROL_POLL_SET)SystemCallParameter;
+    Process = PsGetCurrentProcess();
+    PollSetHandle = ObGetHandleValue(Process->HandleTable,
+                                     Parameters->PollSet,
+                                     NULL);
+
+    if (PollSetHandle == NULL) {
+        Status = STATUS_INVALID_HANDLE;
+        goto SysControlPollSetEnd;
+    }
+
+    if (PollSetHandle->FileObject->Properties.Type != IoObjectPollSet) {
+        Status = STATUS_INVALID_PARAMETER;
+        goto SysControlPollSetEnd;
+    }
+
+    PollSet = PollSetHandle->FileObject->SpecialIo;
+    IoHandle = ObGetHandleValue(Process->HandleTable,
+                                Parameters->Descriptor,
+                                NULL);
+
+    if (IoHandle == NULL) {
+        Status = STATUS_INVALID_HANDLE;
+        goto SysControlPollSetEnd;
+    }
+
+    switch (Parameters->Operation) {
+    case PollSetOperationAdd:
+
+        //
+        // Poll sets cannot watch other poll sets. Allowing that would make it
+        // possible to build loops, and would nest poll set locks.
+        //
+
+        if (IoHandle->FileObject->Properties.Type == IoObjectPollSet) {
+            Status = STATUS_INVALID_PARAMETER;
+            break;
+        }
+
+        //
+        // Regular files and directories are always ready, and have no I/O
+        // object state to watch.
+        //
+
+        if (IoHandle->FileObject->IoState == NULL) {
+            Status = STATUS_NOT_SUPPORTED;
+            break;
+        }
+
+        KeAcquireQueuedLock(IoPollSetLock);
+        Status = IopAddPollSetEntry(PollSet,
+                                    Parameters->Descriptor,
+                                    IoHandle,
+                                    &(Parameters->Event));
+
+        KeReleaseQueuedLock(IoPollSetLock);
+        break;
+
+    case PollSetOperationModify:
+        Status = IopModifyPollSetEntry(PollSet,
+                                       Parameters->Descriptor,
+                                       IoHandle,
+                                       &(Parameters->Event));
+
+        break;
+
+    case PollSetOperationDelete:
+        KeAcquireQueuedLock(IoPollSetLock);
+        KeAcquireQueuedLock(PollSet->Lock);
+        Entry = IopFindPollSetEntry(PollSet, Parameters->Descriptor, IoHandle);
+        KeReleaseQueuedLock(PollSet->Lock);
+        if (Entry == NULL) {
+            Status = STATUS_NOT_FOUND;
+
+        } else {
+            IopRemovePollSetEntry(Entry);
+            Status = STATUS_SUCCESS;
+        }
+
+        KeReleaseQueuedLock(IoPollSetLock);
+        break;
+
+    default:
+        Status = STATUS_INVALID_PARAMETER;
+        break;
+    }
+
+SysControlPollSetEnd:
+    if (IoHandle != NULL) {
+        IoIoHandleReleaseReference(IoHandle);
+    }
+
+    if (PollSetHandle != NULL) {
+        IoIoHandleReleaseReference(PollSetHandle);
+    }
+
+    return Status;
+}
+
+INTN
+IoSysWaitForPollSet (
+    PVOID SystemCallParameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine implements the user mode system call for waiting on a poll
+    set.
+
+Arguments:
+
+    SystemCallParameter - Supplies a pointer to the parameters supplied with
+        the system call. This structure will be a stack-local copy of the
+        actual parameters passed from user-mode.
+
+Return Value:
+
+    Returns the number of events returned (a positive integer) on success.
+
+    Error status code (a negative integer) on failure.
+
+--*/
+
+{
+
+    ULONGLONG CurrentTime;
+    ULONGLONG EndTime;
+    ULONG EventCount;
+    PPOLL_SET_EVENT Events;
+    ULONG Found;
+    ULONGLONG Frequency;
+    SIGNAL_SET OldSignalSet;
+    PSYSTEM_CALL_WAIT_FOR_POLL_SET Parameters;
+    PPOLL_SET PollSet;
+    PIO_HANDLE PollSetHandle;
+    BOOL RestoreSignalMask;
+    INTN Result;
+    SIGNAL_SET SignalMask;
+    KSTATUS Status;
+    PKTHREAD Thread;
+    ULONG Timeout;
+
+    Events = NULL;
+    Found = 0;
+    Parameters = (PSYSTEM_CALL_WAIT_FOR_POLL_SET)SystemCallParameter;
+    RestoreSignalMask = FALSE;
+    Thread = KeGetCurrentThread();
+    PollSetHandle = ObGetHandleValue(Thread->OwningProcess->HandleTable,
+                                     Parameters->PollSet,
+                                     NULL);
+
+    if (PollSetHandle == NULL) {
+        Status = STATUS_INVALID_HANDLE;
+        goto SysWaitForPollSetEnd;
+    }
+
+    if ((PollSetHandle->FileObject->Properties.Type != IoObjectPollSet) ||
+        (Parameters->EventCount <= 0)) {
+
+        Status = STATUS_INVALID_PARAMETER;
+        goto SysWaitForPollSetEnd;
+    }
+
+    PollSet = PollSetHandle->FileObject->SpecialIo;
+
+    //
+    // Set the signal mask if supplied.
+    //
+
+    if (Parameters->SignalMask != NULL) {
+        Status = MmCopyFromUserMode(&SignalMask,
+                                    Parameters->SignalMask,
+                                    sizeof(SIGNAL_SET));
+
+        if (!KSUCCESS(Status)) {
+            goto SysWaitForPollSetEnd;
+        }
+
+        PsSetSignalMask(&SignalMask, &OldSignalSet);
+        RestoreSignalMask = TRUE;
+    }
+
+    EventCount = Parameters->EventCount;
+    if (EventCount > POLL_SET_MAX_WAIT_EVENTS) {
+        EventCount = POLL_SET_MAX_WAIT_EVENTS;
+    }
+
+    Events = MmAllocatePagedPool(EventCount * sizeof(POLL_SET_EVENT),
+                                 POLL_SET_ALLOCATION_TAG);
+
+    if (Events == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto SysWaitForPollSetEnd;
+    }
+
+    Timeout = Parameters->TimeoutInMilliseconds;
+    EndTime = 0;
+    Frequency = 0;
+    if ((Timeout != 0) && (Timeout != WAIT_TIME_INDEFINITE)) {
+        Frequency = HlQueryTimeCounterFrequency();
+        EndTime = KeGetRecentTimeCounter() +
+                  KeConvertMicrosecondsToTimeTicks(
+                                  (ULONGLONG)Timeout *
+                                  MICROSECONDS_PER_MILLISECOND);
+    }
+
+    //
+    // Collect whatever is ready, and wait for the set to become readable if
+    // nothing is. Another waiter may steal the events that woke this one, so
+    // loop until something is collected or the time runs out.
+    //
+
+    while (TRUE) {
+        KeAcquireQueuedLock(PollSet->Lock);
+        Found = IopCollectPollSetEvents(PollSet, Events, EventCount);
+        KeReleaseQueuedLock(PollSet->Lock);
+        if (Found != 0) {
+            Status = STATUS_SUCCESS;
+            break;
+        }
+
+        if (Timeout == 0) {
+            Status = STATUS_TIMEOUT;
+            break;
+        }
+
+        Status = IoWaitForIoObjectState(PollSet->IoState,
+                                        POLL_EVENT_IN,
+                                        TRUE,
+                                        Timeout,
+                                        NULL);
+
+        if (!KSUCCESS(Status)) {
+            break;
+        }
+
+        if (Timeout != WAIT_TIME_INDEFINITE) {
+            CurrentTime = KeGetRecentTimeCounter();
+            if (CurrentTime >= EndTime) {
+                Timeout = 0;
+
+            } else {
+                Timeout = ((EndTime - CurrentTime) *
+                           MILLISECONDS_PER_SECOND) / Frequency;
+            }
+        }
+    }
+
+    if (Found != 0) {
+        Status = MmCopyToUserMode(Parameters->Events,
+                                  Events,
+                                  Found * sizeof(POLL_SET_EVENT));
+    }
+
+SysWaitForPollSetEnd:
+    if (RestoreSignalMask != FALSE) {
+
+        //
+        // If a signal arrived during the wait, then do not restore the blocked
+        // mask until it gets a chance to be dispatched. Save the old signal
+        // set to be restored during signal dispatch.
+        //
+
+        PsCheckRuntimeTimers(Thread);
+        if (Thread->SignalPending == ThreadSignalPending) {
+            Thread->RestoreSignals = OldSignalSet;
+            Thread->Flags |= THREAD_FLAG_RESTORE_SIGNALS;
+
+        } else {
+            PsSetSignalMask(&OldSignalSet, NULL);
+        }
+    }
+
+    if (Events != NULL) {
+        MmFreePagedPool(Events);
+    }
+
+    if (PollSetHandle != NULL) {
+        IoIoHandleReleaseReference(PollSetHandle);
+    }
+
+    Result = Status;
+    if (KSUCCESS(Status)) {
+        Result = Found;
+    }
+
+    return Result;
+}
+
+KSTATUS
+IopCreatePollSet (
+    FILE_PERMISSIONS Permissions,
+    PFILE_OBJECT *FileObject
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates a new poll set and the file object that represents
+    it.
+
+Arguments:
+
+    Permissions - Supplies the permissions to give to the file object.
+
+    FileObject - Supplies a pointer where a pointer to the new poll set file
+        object will be returned on success.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    BOOL Created;
+    FILE_PROPERTIES FileProperties;
+    PFILE_OBJECT NewFileObject;
+    PPOLL_SET PollSet;
+    KSTATUS Status;
+    PKTHREAD Thread;
+
+    ASSERT(*FileObject == NULL);
+
+    NewFileObject = NULL;
+    PollSet = ObCreateObject(ObjectPollSet,
+                             IoPollSetDirectory,
+                             NULL,
+                             0,
+                             sizeof(POLL_SET),
+                             IopDestroyPollSet,
+                             0,
+                             POLL_SET_ALLOCATION_TAG);
+
+    if (PollSet == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto CreatePollSetEnd;
+    }
+
+    RtlRedBlackTreeInitialize(&(PollSet->EntryTree),
+                              0,
+                              IopComparePollSetEntries);
+
+    INITIALIZE_LIST_HEAD(&(PollSet->ReadyList));
+    PollSet->Lock = KeCreateQueuedLock();
+    if (PollSet->Lock == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto CreatePollSetEnd;
+    }
+
+    Thread = KeGetCurrentThread();
+    IopFillOutFilePropertiesForObject(&FileProperties, &(PollSet->Header));
+    FileProperties.Permissions = Permissions;
+    FileProperties.Type = IoObjectPollSet;
+    FileProperties.UserId = Thread->Identity.EffectiveUserId;
+    FileProperties.GroupId = Thread->Identity.EffectiveGroupId;
+    Status = IopCreateOrLookupFileObject(&FileProperties,
+                                         ObGetRootObject(),
+                                         0,
+                                         &NewFileObject,
+                                         &Created);
+
+    if (!KSUCCESS(Status)) {
+
+        //
+        // Release the reference added by filling out the file properties.
+        //
+
+        ObReleaseReference(PollSet);
+        goto CreatePollSetEnd;
+    }
+
+    ASSERT((Created != FALSE) && (NewFileObject->IoState != NULL));
+
+    //
+    // The poll set borrows the file object's I/O state to signal readiness.
+    // The reference on the poll set is transferred to the file object.
+    //
+
+    PollSet->IoState = NewFileObject->IoState;
+    NewFileObject->SpecialIo = PollSet;
+    PollSet = NULL;
+    *FileObject = NewFileObject;
+    Status = STATUS_SUCCESS;
+
+CreatePollSetEnd:
+
+    //
+    // On both success and failure, the file object's ready event needs to be
+    // signaled. Other threads may be waiting on the event.
+    //
+
+    if (NewFileObject != NULL) {
+        KeSignalEvent(NewFileObject->ReadyEvent, SignalOptionSignalAll);
+    }
+
+    if (!KSUCCESS(Status)) {
+        if (NewFileObject != NULL) {
+            IopFileObjectReleaseReference(NewFileObject);
+        }
+
+        *FileObject = NULL;
+    }
+
+    if (PollSet != NULL) {
+        ObReleaseReference(PollSet);
+    }
+
+    return Status;
+}
+
+KSTATUS
+IopClosePollSet (
+    PIO_HANDLE IoHandle
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is called when a poll set handle is closed. It removes every
+    entry from the set.
+
+Arguments:
+
+    IoHandle - Supplies a pointer to the I/O handle being closed.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    PPOLL_SET_ENTRY Entry;
+    PRED_BLACK_TREE_NODE Node;
+    PPOLL_SET PollSet;
+
+    PollSet = IoHandle->FileObject->SpecialIo;
+    if (PollSet == NULL) {
+        return STATUS_SUCCESS;
+    }
+
+    KeAcquireQueuedLock(IoPollSetLock);
+    while (TRUE) {
+        KeAcquireQueuedLock(PollSet->Lock);
+        Node = RtlRedBlackTreeGetLowestNode(&(PollSet->EntryTree));
+        KeReleaseQueuedLock(PollSet->Lock);
+        if (Node == NULL) {
+            break;
+        }
+
+        Entry = RED_BLACK_TREE_VALUE(Node, POLL_SET_ENTRY, TreeNode);
+        IopRemovePollSetEntry(Entry);
+    }
+
+    KeReleaseQueuedLock(IoPollSetLock);
+    return STATUS_SUCCESS;
+}
+
+VOID
+IopRemovePollSetEntries (
+    PIO_HANDLE IoHandle
+    )
+
+/*++
+
+Routine Description:
+
+    This routine removes an I/O handle from every poll set it was added to.
+    It is called when the handle is closed.
+
+Arguments:
+
+    IoHandle - Supplies a pointer to the I/O handle being closed.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PLIST_ENTRY CurrentEntry;
+    PPOLL_SET_ENTRY Entry;
+    PIO_POLL_STATE PollState;
+    LIST_ENTRY RemoveList;
+
+    PollState = IoHandle->FileObject->IoState->Poll;
+
+    ASSERT(PollState != NULL);
+
+    INITIALIZE_LIST_HEAD(&RemoveList);
+    KeAcquireQueuedLock(IoPollSetLock);
+    KeAcquireQueuedLock(PollState->Lock);
+    CurrentEntry = PollState->EntryList.Next;
+    while (CurrentEntry != &(PollState->EntryList)) {
+        Entry = LIST_VALUE(CurrentEntry, POLL_SET_ENTRY, WatchListEntry);
+        CurrentEntry = CurrentEntry->Next;
+        if (Entry->IoHandle == IoHandle) {
+            LIST_REMOVE(&(Entry->WatchListEntry));
+            INSERT_BEFORE(&(Entry->WatchListEntry), &RemoveList);
+        }
+    }
+
+    KeReleaseQueuedLock(PollState->Lock);
+    while (!LIST_EMPTY(&RemoveList)) {
+        Entry = LIST_VALUE(RemoveList.Next, POLL_SET_ENTRY, WatchListEntry);
+        LIST_REMOVE(&(Entry->WatchListEntry));
+        IopUnlinkPollSetEntry(Entry);
+    }
+
+    KeReleaseQueuedLock(IoPollSetLock);
+    return;
+}
+
+VOID
+IopNotifyPollSets (
+    PIO_OBJECT_STATE IoState,
+    ULONG Events
+    )
+
+/*++
+
+Routine Description:
+
+    This routine queues every poll set entry interested in the given events
+    onto its poll set's ready list. It is called whenever events are set on
+    an I/O object state that has been added to a poll set.
+
+Arguments:
+
+    IoState - Supplies a pointer to the I/O object state whose events were
+        just set.
+
+    Events - Supplies the mask of events that were set.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PLIST_ENTRY CurrentEntry;
+    PPOLL_SET_ENTRY Entry;
+    ULONG Mask;
+    PIO_POLL_STATE PollState;
+
+    PollState = IoState->Poll;
+    KeAcquireQueuedLock(PollState->Lock);
+    CurrentEntry = PollState->EntryList.Next;
+    while (CurrentEntry != &(PollState->EntryList)) {
+        Entry = LIST_VALUE(CurrentEntry, POLL_SET_ENTRY, WatchListEntry);
+        CurrentEntry = CurrentEntry->Next;
+        Mask = (Entry->Events & ~POLL_SET_EVENT_FLAGS) |
+               POLL_NONMASKABLE_EVENTS;
+
+        if ((Events & Mask) != 0) {
+            KeAcquireQueuedLock(Entry->PollSet->Lock);
+            IopQueuePollSetEntry(Entry);
+            KeReleaseQueuedLock(Entry->PollSet->Lock);
+        }
+    }
+
+    KeReleaseQueuedLock(PollState->Lock);
+    return;
+}
+
+VOID
+IopDestroyPollState (
+    PIO_POLL_STATE PollState
+    )
+
+/*++
+
+Routine Description:
+
+    This routine destroys the poll set state of an I/O object state.
+
+Arguments:
+
+    PollState - Supplies a pointer to the poll state to destroy.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ASSERT(LIST_EMPTY(&(PollState->EntryList)));
+
+    if (PollState->Lock != NULL) {
+        KeDestroyQueuedLock(PollState->Lock);
+    }
+
+    MmFreePagedPool(PollState);
+    return;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+VOID
+IopDestroyPollSet (
+    PVOID Object
+    )
+
+/*++
+
+Routine Description:
+
+    This routine destroys all resources associated with a poll set.
+
+Arguments:
+
+    Object - Supplies a pointer to the poll set being destroyed.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PPOLL_SET PollSet;
+
+    PollSet = (PPOLL_SET)Object;
+
+    ASSERT((PollSet->EntryCount == 0) &&
+           (RED_BLACK_TREE_EMPTY(&(PollSet->EntryTree))));
+
+    if (PollSet->Lock != NULL) {
+        KeDestroyQueuedLock(PollSet->Lock);
+    }
+
+    return;
+}
+
+PIO_POLL_STATE
+IopGetPollState (
+    PIO_OBJECT_STATE IoState
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns or attempts to create the poll set state for an I/O
+    object state.
+
+Arguments:
+
+    IoState - Supplies a pointer to the I/O object state.
+
+Return Value:
+
+    Returns a pointer to the poll state on success. This may have just been
+    created.
+
+    NULL if no poll state exists and none could be created.
+
+--*/
+
+{
+
+    PIO_POLL_STATE OldValue;
+    PIO_POLL_STATE PollState;
+
+    if (IoState->Poll != NULL) {
+        return IoState->Poll;
+    }
+
+    PollState = MmAllocatePagedPool(sizeof(IO_POLL_STATE),
+                                    POLL_SET_ALLOCATION_TAG);
+
+    if (PollState == NULL) {
+        return NULL;
+    }
+
+    INITIALIZE_LIST_HEAD(&(PollState->EntryList));
+    PollState->Lock = KeCreateQueuedLock();
+    if (PollState->Lock == NULL) {
+        goto GetPollStateEnd;
+    }
+
+    //
+    // Try to atomically set the poll state. Someone else may race and win.
+    //
+
+    OldValue = (PIO_POLL_STATE)RtlAtomicCompareExchange(
+                                                     (PUINTN)&(IoState->Poll),
+                                                     (UINTN)PollState,
+                                                     (UINTN)NULL);
+
+    if (OldValue == NULL) {
+        PollState = NULL;
+    }
+
+GetPollStateEnd:
+    if (PollState != NULL) {
+        IopDestroyPollState(PollState);
+    }
+
+    return IoState->Poll;
+}
+
+KSTATUS
+IopAddPollSetEntry (
+    PPOLL_SET PollSet,
+    HANDLE Descriptor,
+    PIO_HANDLE IoHandle,
+    PPOLL_SET_EVENT Event
+    )
+
+/*++
+
+Routine Description:
+
+    This routine adds an I/O handle to a poll set. The global poll set lock
+    must be held.
+
+Arguments:
+
+    PollSet - Supplies a pointer to the poll set.
+
+    Descriptor - Supplies the user mode handle being added.
+
+    IoHandle - Supplies a pointer to the I/O handle the descriptor refers to.
+
+    Event - Supplies a pointer to the events to watch for and the data to
+        return.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_FILE_EXISTS if the handle is already in the poll set.
+
+    STATUS_INSUFFICIENT_RESOURCES on allocation failure.
+
+--*/
+
+{
+
+    PPOLL_SET_ENTRY Entry;
+    PIO_OBJECT_STATE IoState;
+    ULONG Mask;
+    PIO_POLL_STATE PollState;
+
+    ASSERT(KeIsQueuedLockHeld(IoPollSetLock) != FALSE);
+
+    KeAcquireQueuedLock(PollSet->Lock);
+    Entry = IopFindPollSetEntry(PollSet, Descriptor, IoHandle);
+    KeReleaseQueuedLock(PollSet->Lock);
+    if (Entry != NULL) {
+        return STATUS_FILE_EXISTS;
+    }
+
+    IoState = IoHandle->FileObject->IoState;
+    PollState = IopGetPollState(IoState);
+    if (PollState == NULL) {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    Entry = MmAllocatePagedPool(sizeof(POLL_SET_ENTRY),
+                                POLL_SET_ALLOCATION_TAG);
+
+    if (Entry == NULL) {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    RtlZeroMemory(Entry, sizeof(POLL_SET_ENTRY));
+    Entry->PollSet = PollSet;
+    Entry->IoHandle = IoHandle;
+    Entry->IoState = IoState;
+    Entry->Descriptor = Descriptor;
+    Entry->Events = Event->Events;
+    Entry->Data = Event->Data;
+
+    //
+    // Add the entry to the watch list before checking the current events.
+    // Anyone setting events after the check will find the entry on the list.
+    //
+
+    KeAcquireQueuedLock(PollState->Lock);
+    INSERT_BEFORE(&(Entry->WatchListEntry), &(PollState->EntryList));
+    KeAcquireQueuedLock(PollSet->Lock);
+    RtlRedBlackTreeInsert(&(PollSet->EntryTree), &(Entry->TreeNode));
+    PollSet->EntryCount += 1;
+    Mask = (Entry->Events & ~POLL_SET_EVENT_FLAGS) | POLL_NONMASKABLE_EVENTS;
+    if ((IoState->Events & Mask) != 0) {
+        IopQueuePollSetEntry(Entry);
+    }
+
+    KeReleaseQueuedLock(PollSet->Lock);
+    KeReleaseQueuedLock(PollState->Lock);
+    return STATUS_SUCCESS;
+}
+
+KSTATUS
+IopModifyPollSetEntry (
+    PPOLL_SET PollSet,
+    HANDLE Descriptor,
+    PIO_HANDLE IoHandle,
+    PPOLL_SET_EVENT Event
+    )
+
+/*++
+
+Routine Description:
+
+    This routine changes the events watched for and the data returned for an
+    entry in a poll set. This also re-arms a one-shot entry.
+
+Arguments:
+
+    PollSet - Supplies a pointer to the poll set.
+
+    Descriptor - Supplies the user mode handle of the entry.
+
+    IoHandle - Supplies a pointer to the I/O handle the descriptor refers to.
+
+    Event - Supplies a pointer to the new events and data.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_NOT_FOUND if the handle is not in the poll set.
+
+--*/
+
+{
+
+    PPOLL_SET_ENTRY Entry;
+    ULONG Mask;
+    KSTATUS Status;
+
+    KeAcquireQueuedLock(PollSet->Lock);
+    Entry = IopFindPollSetEntry(PollSet, Descriptor, IoHandle);
+    if (Entry == NULL) {
+        Status = STATUS_NOT_FOUND;
+        goto ModifyPollSetEntryEnd;
+    }
+
+    Entry->Events = Event->Events;
+    Entry->Data = Event->Data;
+    Entry->Flags &= ~POLL_SET_ENTRY_FLAG_DISABLED;
+    Mask = (Entry->Events & ~POLL_SET_EVENT_FLAGS) | POLL_NONMASKABLE_EVENTS;
+    if ((Entry->IoState->Events & Mask) != 0) {
+        IopQueuePollSetEntry(Entry);
+    }
+
+    Status = STATUS_SUCCESS;
+
+ModifyPollSetEntryEnd:
+    KeReleaseQueuedLock(PollSet->Lock);
+    return Status;
+}
+
+PPOLL_SET_ENTRY
+IopFindPollSetEntry (
+    PPOLL_SET PollSet,
+    HANDLE Descriptor,
+    PIO_HANDLE IoHandle
+    )
+
+/*++
+
+Routine Description:
+
+    This routine looks up an entry in a poll set. The poll set lock must be
+    held.
+
+Arguments:
+
+    PollSet - Supplies a pointer to the poll set.
+
+    Descriptor - Supplies the user mode handle of the entry.
+
+    IoHandle - Supplies a pointer to the I/O handle the descriptor refers to.
+
+Return Value:
+
+    Returns a pointer to the entry on success.
+
+    NULL if no such entry exists.
+
+--*/
+
+{
+
+    PRED_BLACK_TREE_NODE FoundNode;
+    POLL_SET_ENTRY SearchEntry;
+
+    SearchEntry.Descriptor = Descriptor;
+    SearchEntry.IoHandle = IoHandle;
+    FoundNode = RtlRedBlackTreeSearch(&(PollSet->EntryTree),
+                                      &(SearchEntry.TreeNode));
+
+    if (FoundNode == NULL) {
+        return NULL;
+    }
+
+    return RED_BLACK_TREE_VALUE(FoundNode, POLL_SET_ENTRY, TreeNode);
+}
+
+VOID
+IopRemovePollSetEntry (
+    PPOLL_SET_ENTRY Entry
+    )
+
+/*++
+
+Routine Description:
+
+    This routine removes an entry from both the I/O object it watches and its
+    poll set, and destroys it. The global poll set lock must be held.
+
+Arguments:
+
+    Entry - Supplies a pointer to the entry to remove.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PIO_POLL_STATE PollState;
+
+    ASSERT(KeIsQueuedLockHeld(IoPollSetLock) != FALSE);
+
+    PollState = Entry->IoState->Poll;
+    KeAcquireQueuedLock(PollState->Lock);
+    LIST_REMOVE(&(Entry->WatchListEntry));
+    KeReleaseQueuedLock(PollState->Lock);
+    IopUnlinkPollSetEntry(Entry);
+    return;
+}
+
+VOID
+IopUnlinkPollSetEntry (
+    PPOLL_SET_ENTRY Entry
+    )
+
+/*++
+
+Routine Description:
+
+    This routine removes an entry that is no longer on its I/O object's watch
+    list from its poll set, and destroys it. The global poll set lock must be
+    held.
+
+Arguments:
+
+    Entry - Supplies a pointer to the entry to remove.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PPOLL_SET PollSet;
+
+    PollSet = Entry->PollSet;
+    KeAcquireQueuedLock(PollSet->Lock);
+    RtlRedBlackTreeRemove(&(PollSet->EntryTree), &(Entry->TreeNode));
+    PollSet->EntryCount -= 1;
+    if (Entry->ReadyListEntry.Next != NULL) {
+        LIST_REMOVE(&(Entry->ReadyListEntry));
+        if (LIST_EMPTY(&(PollSet->ReadyList))) {
+            IoSetIoObjectState(PollSet->IoState, POLL_EVENT_IN, FALSE);
+        }
+    }
+
+    KeReleaseQueuedLock(PollSet->Lock);
+    MmFreePagedPool(Entry);
+    return;
+}
+
+VOID
+IopQueuePollSetEntry (
+    PPOLL_SET_ENTRY Entry
+    )
+
+/*++
+
+Routine Description:
+
+    This routine puts a poll set entry on its poll set's ready list if it is
+    not already there, and makes the poll set readable. The poll set lock must
+    be held.
+
+Arguments:
+
+    Entry - Supplies a pointer to the entry to queue.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PPOLL_SET PollSet;
+
+    if ((Entry->ReadyListEntry.Next != NULL) ||
+        ((Entry->Flags & POLL_SET_ENTRY_FLAG_DISABLED) != 0)) {
+
+        return;
+    }
+
+    PollSet = Entry->PollSet;
+    if (LIST_EMPTY(&(PollSet->ReadyList))) {
+        IoSetIoObjectState(PollSet->IoState, POLL_EVENT_IN, TRUE);
+    }
+
+    INSERT_BEFORE(&(Entry->ReadyListEntry), &(PollSet->ReadyList));
+    return;
+}
+
+ULONG
+IopCollectPollSetEvents (
+    PPOLL_SET PollSet,
+    PPOLL_SET_EVENT Events,
+    ULONG EventCount
+    )
+
+/*++
+
+Routine Description:
+
+    This routine pulls ready entries off of a poll set's ready list. Entries
+    whose events have all been cleared since they were queued are dropped.
+    Level-triggered entries that are still ready go back on the end of the
+    list so that they are reported again and so that other entries get a
+    turn. The poll set lock must be held.
+
+Arguments:
+
+    PollSet - Supplies a pointer to the poll set.
+
+    Events - Supplies a pointer to an array where the ready events will be
+        returned.
+
+    EventCount - Supplies the number of elements in the events array.
+
+Return Value:
+
+    Returns the number of events returned.
+
+--*/
+
+{
+
+    ULONG Count;
+    PPOLL_SET_ENTRY Entry;
+    ULONG Mask;
+    LIST_ENTRY RequeueList;
+    ULONG Signaled;
+
+    Count = 0;
+    INITIALIZE_LIST_HEAD(&RequeueList);
+    while ((Count < EventCount) && (!LIST_EMPTY(&(PollSet->ReadyList)))) {
+        Entry = LIST_VALUE(PollSet->ReadyList.Next,
+                           POLL_SET_ENTRY,
+                           ReadyListEntry);
+
+        LIST_REMOVE(&(Entry->ReadyListEntry));
+        Entry->ReadyListEntry.Next = NULL;
+        if ((Entry->Flags & POLL_SET_ENTRY_FLAG_DISABLED) != 0) {
+            continue;
+        }
+
+        Mask = (Entry->Events & ~POLL_SET_EVENT_FLAGS) |
+               POLL_NONMASKABLE_EVENTS;
+
+        Signaled = Entry->IoState->Events & Mask;
+        if (Signaled == 0) {
+            continue;
+        }
+
+        Events[Count].Events = Signaled;
+        Events[Count].Data = Entry->Data;
+        Count += 1;
+        if ((Entry->Events & POLL_SET_EVENT_ONE_SHOT) != 0) {
+            Entry->Flags |= POLL_SET_ENTRY_FLAG_DISABLED;
+
+        } else if ((Entry->Events & POLL_SET_EVENT_EDGE_TRIGGERED) == 0) {
+            INSERT_BEFORE(&(Entry->ReadyListEntry), &RequeueList);
+        }
+    }
+
+    if (!LIST_EMPTY(&RequeueList)) {
+        APPEND_LIST(&RequeueList, &(PollSet->ReadyList));
+    }
+
+    if (LIST_EMPTY(&(PollSet->ReadyList))) {
+        IoSetIoObjectState(PollSet->IoState, POLL_EVENT_IN, FALSE);
+    }
+
+    return Count;
+}
+
+COMPARISON_RESULT
+IopComparePollSetEntries (
+    PRED_BLACK_TREE Tree,
+    PRED_BLACK_TREE_NODE FirstNode,
+    PRED_BLACK_TREE_NODE SecondNode
+    )
+
+/*++
+
+Routine Description:
+
+    This routine compares two Red-Black tree nodes contained inside poll set
+    entries.
+
+Arguments:
+
+    Tree - Supplies a pointer to the Red-Black tree that owns both nodes.
+
+    FirstNode - Supplies a pointer to the left side of the comparison.
+
+    SecondNode - Supplies a pointer to the second side of the comparison.
+
+Return Value:
+
+    Same if the two nodes have the same value.
+
+    Ascending if the first node is less than the second node.
+
+    Descending if the second node is less than the first node.
+
+--*/
+
+{
+
+    PPOLL_SET_ENTRY FirstEntry;
+    PPOLL_SET_ENTRY SecondEntry;
+
+    FirstEntry = RED_BLACK_TREE_VALUE(FirstNode, POLL_SET_ENTRY, TreeNode);
+    SecondEntry = RED_BLACK_TREE_VALUE(SecondNode, POLL_SET_ENTRY, TreeNode);
+    if (FirstEntry->Descriptor > SecondEntry->Descriptor) {
+        return ComparisonResultDescending;
+    }
+
+    if (FirstEntry->Descriptor < SecondEntry->Descriptor) {
+        return ComparisonResultAscending;
+    }
+
+    //
+    // A descriptor may have been closed and reused while the old I/O handle
+    // stayed open through a duplicate, so also compare the handles.
+    //
+
+    if (FirstEntry->IoHandle > SecondEntry->IoHandle) {
+        return ComparisonResultDescending;
+    }
+
+    if (FirstEntry->IoHandle < SecondEntry->IoHandle) {
+        return ComparisonResultAscending;
+    }
+
+    return ComparisonResultSame;
+}
+
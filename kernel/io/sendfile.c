@@ -0,0 +1,620 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    sendfile.c
+
+Abstract:
+
+    This module implements support for moving data from one I/O handle to
+    another entirely within the kernel. When a cached file is sent to a socket,
+    the page cache pages themselves are handed to the protocol, which holds on
+    to them until the data has been acknowledged.
+
+Author:
+
+    agent 16-Oct-2026
+
+Environment:
+
+    Kernel
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <minoca/kernel/kernel.h>
+#include "iop.h"
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+//
+// Define the maximum number of bytes moved per round. Each round is one read
+// from the source and one write to the destination.
+//
+
+#define IO_SEND_FILE_CHUNK_SIZE 0x10000
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+KSTATUS
+IopSendFile (
+    PIO_HANDLE Destination,
+    PIO_HANDLE Source,
+    IO_OFFSET SourceOffset,
+    IO_OFFSET DestinationOffset,
+    UINTN Size,
+    PUINTN BytesCompleted
+    );
+
+KSTATUS
+IopSendCachedFileToSocket (
+    PIO_HANDLE Destination,
+    PIO_HANDLE Source,
+    IO_OFFSET SourceOffset,
+    UINTN Size,
+    ULONG Timeout,
+    PUINTN BytesCompleted
+    );
+
+KSTATUS
+IopSendFileCopy (
+    PIO_HANDLE Destination,
+    PIO_HANDLE Source,
+    IO_OFFSET SourceOffset,
+    IO_OFFSET DestinationOffset,
+    UINTN Size,
+    ULONG Timeout,
+    PUINTN BytesCompleted
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+INTN
+IoSysSendFile (
+    PVOID SystemCallParameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine implements the user mode system call for transferring data
+    from one I/O handle to another without copying it through user mode.
+
+Arguments:
+
+    SystemCallParameter - Supplies a pointer to the parameters supplied with
+        the system call. This structure will be a stack-local copy of the
+        actual parameters passed from user-mode.
+
+Return Value:
+
+    Returns the number of bytes transferred (a positive integer) on success.
+
+    Error status code (a negative integer) on failure.
+
+--*/
+
+{
+
+    UINTN BytesCompleted;
+    PKPROCESS CurrentProcess;
+    PIO_HANDLE Destination;
+    PSYSTEM_CALL_SEND_FILE Parameters;
+    INTN Result;
+    PIO_HANDLE Source;
+    KSTATUS Status;
+
+    CurrentProcess = PsGetCurrentProcess();
+
+    ASSERT(CurrentProcess != PsGetKernelProcess());
+
+    Parameters = (PSYSTEM_CALL_SEND_FILE)SystemCallParameter;
+    BytesCompleted = 0;
+    Source = NULL;
+    Destination = ObGetHandleValue(CurrentProcess->HandleTable,
+                                   Parameters->Destination,
+                                   NULL);
+
+    if (Destination == NULL) {
+        Status = STATUS_INVALID_HANDLE;
+        goto SysSendFileEnd;
+    }
+
+    Source = ObGetHandleValue(CurrentProcess->HandleTable,
+                              Parameters->Source,
+                              NULL);
+
+    if (Source == NULL) {
+        Status = STATUS_INVALID_HANDLE;
+        goto SysSendFileEnd;
+    }
+
+    //
+    // Offsets are either none, meaning the handle's current position, or a
+    // real offset. Any other negative value is invalid.
+    //
+
+    if (((Parameters->SourceOffset < 0) &&
+         (Parameters->SourceOffset != IO_OFFSET_NONE)) ||
+        ((Parameters->DestinationOffset < 0) &&
+         (Parameters->DestinationOffset != IO_OFFSET_NONE))) {
+
+        Status = STATUS_INVALID_PARAMETER;
+        goto SysSendFileEnd;
+    }
+
+    //
+    // The proper system call interface doesn't pass negative values, but
+    // treat them the same as zero if they find a way through.
+    //
+
+    if (Parameters->Size <= 0) {
+        Status = STATUS_SUCCESS;
+        goto SysSendFileEnd;
+    }
+
+    Status = IopSendFile(Destination,
+                         Source,
+                         Parameters->SourceOffset,
+                         Parameters->DestinationOffset,
+                         Parameters->Size,
+                         &BytesCompleted);
+
+    if (Status == STATUS_BROKEN_PIPE) {
+        PsSignalProcess(CurrentProcess, SIGNAL_BROKEN_PIPE, NULL);
+    }
+
+SysSendFileEnd:
+    if (Destination != NULL) {
+        IoIoHandleReleaseReference(Destination);
+    }
+
+    if (Source != NULL) {
+        IoIoHandleReleaseReference(Source);
+    }
+
+    //
+    // If the transfer got interrupted and no bytes were moved, then the system
+    // call can be restarted if the signal handler allows. If bytes were moved,
+    // report them.
+    //
+
+    if (Status == STATUS_INTERRUPTED) {
+        if (BytesCompleted == 0) {
+            Status = STATUS_RESTART_AFTER_SIGNAL;
+
+        } else {
+            Status = STATUS_SUCCESS;
+        }
+    }
+
+    Result = Status;
+    if ((KSUCCESS(Status)) || (BytesCompleted != 0)) {
+
+        ASSERT(BytesCompleted <= (UINTN)MAX_INTN);
+
+        Result = (INTN)BytesCompleted;
+    }
+
+    return Result;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+KSTATUS
+IopSendFile (
+    PIO_HANDLE Destination,
+    PIO_HANDLE Source,
+    IO_OFFSET SourceOffset,
+    IO_OFFSET DestinationOffset,
+    UINTN Size,
+    PUINTN BytesCompleted
+    )
+
+/*++
+
+Routine Description:
+
+    This routine transfers data from one I/O handle to another.
+
+Arguments:
+
+    Destination - Supplies a pointer to the I/O handle to write to.
+
+    Source - Supplies a pointer to the I/O handle to read from.
+
+    SourceOffset - Supplies the offset in the source to start reading from.
+        Supply IO_OFFSET_NONE to use and advance the source's current file
+        position.
+
+    DestinationOffset - Supplies the offset in the destination to start
+        writing to. Supply IO_OFFSET_NONE to use the destination's current file
+        position. This must be IO_OFFSET_NONE for sockets.
+
+    Size - Supplies the number of bytes to transfer.
+
+    BytesCompleted - Supplies a pointer where the number of bytes written to
+        the destination will be returned.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    BOOL DestinationIsSocket;
+    IO_OFFSET NewOffset;
+    IO_OFFSET Offset;
+    PFILE_OBJECT SourceFileObject;
+    KSTATUS Status;
+    ULONG Timeout;
+    BOOL UpdatePosition;
+
+    *BytesCompleted = 0;
+    DestinationIsSocket = FALSE;
+    if (Destination->FileObject->Properties.Type == IoObjectSocket) {
+        DestinationIsSocket = TRUE;
+        if (DestinationOffset != IO_OFFSET_NONE) {
+            return STATUS_INVALID_PARAMETER;
+        }
+    }
+
+    Timeout = WAIT_TIME_INDEFINITE;
+    if ((Destination->OpenFlags & OPEN_FLAG_NON_BLOCKING) != 0) {
+        Timeout = 0;
+    }
+
+    //
+    // If the source is seekable, work with explicit offsets internally and
+    // only advance the source's file position by the number of bytes that
+    // actually made it to the destination.
+    //
+
+    Offset = SourceOffset;
+    UpdatePosition = FALSE;
+    if (SourceOffset == IO_OFFSET_NONE) {
+        Status = IoSeek(Source, SeekCommandNop, 0, &Offset);
+        if (KSUCCESS(Status)) {
+            UpdatePosition = TRUE;
+
+        } else {
+            Offset = IO_OFFSET_NONE;
+        }
+    }
+
+    SourceFileObject = Source->FileObject;
+    if ((DestinationIsSocket != FALSE) &&
+        (Offset != IO_OFFSET_NONE) &&
+        (SourceFileObject->Properties.Type == IoObjectRegularFile) &&
+        (IO_IS_FILE_OBJECT_CACHEABLE(SourceFileObject) != FALSE)) {
+
+        Status = IopSendCachedFileToSocket(Destination,
+                                           Source,
+                                           Offset,
+                                           Size,
+                                           Timeout,
+                                           BytesCompleted);
+
+    } else {
+        Status = IopSendFileCopy(Destination,
+                                 Source,
+                                 Offset,
+                                 DestinationOffset,
+                                 Size,
+                                 Timeout,
+                                 BytesCompleted);
+    }
+
+    if ((UpdatePosition != FALSE) && (*BytesCompleted != 0)) {
+        IoSeek(Source,
+               SeekCommandFromBeginning,
+               Offset + *BytesCompleted,
+               &NewOffset);
+    }
+
+    return Status;
+}
+
+KSTATUS
+IopSendCachedFileToSocket (
+    PIO_HANDLE Destination,
+    PIO_HANDLE Source,
+    IO_OFFSET SourceOffset,
+    UINTN Size,
+    ULONG Timeout,
+    PUINTN BytesCompleted
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sends a cached file to a socket without copying the data.
+    Each round reads a page aligned range of the file into an empty I/O
+    buffer, which the page cache fills with references to its own pages. That
+    buffer is then donated to the socket. A protocol that keeps it frees it
+    once the data is acknowledged, which releases the page cache pages.
+
+Arguments:
+
+    Destination - Supplies a pointer to the socket handle to send to.
+
+    Source - Supplies a pointer to the cacheable file handle to read from.
+
+    SourceOffset - Supplies the offset in the file to start sending from.
+
+    Size - Supplies the number of bytes to send.
+
+    Timeout - Supplies the send timeout in milliseconds.
+
+    BytesCompleted - Supplies a pointer where the number of bytes sent will be
+        returned.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    UINTN AlignedSize;
+    UINTN BytesRead;
+    UINTN BytesRemaining;
+    UINTN BytesThisRound;
+    PIO_BUFFER IoBuffer;
+    IO_OFFSET Offset;
+    UINTN PageOffset;
+    ULONG PageSize;
+    SOCKET_IO_PARAMETERS Parameters;
+    KSTATUS Status;
+
+    BytesRemaining = Size;
+    Offset = SourceOffset;
+    PageSize = MmPageSize();
+    Status = STATUS_SUCCESS;
+    while (BytesRemaining != 0) {
+        PageOffset = REMAINDER(Offset, PageSize);
+        BytesThisRound = IO_SEND_FILE_CHUNK_SIZE - PageOffset;
+        if (BytesThisRound > BytesRemaining) {
+            BytesThisRound = BytesRemaining;
+        }
+
+        AlignedSize = ALIGN_RANGE_UP(PageOffset + BytesThisRound, PageSize);
+        IoBuffer = MmAllocateUninitializedIoBuffer(AlignedSize, 0);
+        if (IoBuffer == NULL) {
+            Status = STATUS_INSUFFICIENT_RESOURCES;
+            break;
+        }
+
+        //
+        // Reading whole pages into an empty buffer lets the page cache append
+        // its pages to the buffer rather than copying out of them.
+        //
+
+        BytesRead = 0;
+        Status = IoReadAtOffset(Source,
+                                IoBuffer,
+                                Offset - PageOffset,
+                                AlignedSize,
+                                0,
+                                WAIT_TIME_INDEFINITE,
+                                &BytesRead,
+                                NULL);
+
+        if (Status == STATUS_END_OF_FILE) {
+            Status = STATUS_SUCCESS;
+        }
+
+        if ((!KSUCCESS(Status)) || (BytesRead <= PageOffset)) {
+            MmFreeIoBuffer(IoBuffer);
+            break;
+        }
+
+        //
+        // If the read came up short the end of the file was reached, so this
+        // is the last round.
+        //
+
+        if (BytesRead - PageOffset < BytesThisRound) {
+            BytesThisRound = BytesRead - PageOffset;
+            BytesRemaining = BytesThisRound;
+        }
+
+        MmIoBufferIncrementOffset(IoBuffer, PageOffset);
+        RtlZeroMemory(&Parameters, sizeof(SOCKET_IO_PARAMETERS));
+        Parameters.Size = BytesThisRound;
+        Parameters.IoFlags = SYS_IO_FLAG_WRITE;
+        Parameters.SocketIoFlags = SOCKET_IO_DONATE_BUFFER;
+        Parameters.TimeoutInMilliseconds = Timeout;
+        Status = IoSocketSendData(TRUE, Destination, &Parameters, IoBuffer);
+
+        //
+        // Protocols that do not take donated buffers just copy the data out,
+        // in which case the buffer is still owned here.
+        //
+
+        if ((Parameters.SocketIoFlags & SOCKET_IO_BUFFER_RETAINED) == 0) {
+            MmFreeIoBuffer(IoBuffer);
+        }
+
+        *BytesCompleted += Parameters.BytesCompleted;
+        Offset += Parameters.BytesCompleted;
+        BytesRemaining -= Parameters.BytesCompleted;
+        if ((!KSUCCESS(Status)) ||
+            (Parameters.BytesCompleted != BytesThisRound)) {
+
+            break;
+        }
+    }
+
+    return Status;
+}
+
+KSTATUS
+IopSendFileCopy (
+    PIO_HANDLE Destination,
+    PIO_HANDLE Source,
+    IO_OFFSET SourceOffset,
+    IO_OFFSET DestinationOffset,
+    UINTN Size,
+    ULONG Timeout,
+    PUINTN BytesCompleted
+    )
+
+/*++
+
+Routine Description:
+
+    This routine transfers data from one handle to another through an
+    intermediate kernel buffer. This is used for anything other than a cached
+    file going to a socket.
+
+Arguments:
+
+    Destination - Supplies a pointer to the I/O handle to write to.
+
+    Source - Supplies a pointer to the I/O handle to read from.
+
+    SourceOffset - Supplies the offset in the source to read from, or
+        IO_OFFSET_NONE if the source is not seekable.
+
+    DestinationOffset - Supplies the offset in the destination to write to, or
+        IO_OFFSET_NONE to use the destination's current file position.
+
+    Size - Supplies the number of bytes to transfer.
+
+    Timeout - Supplies the write timeout in milliseconds.
+
+    BytesCompleted - Supplies a pointer where the number of bytes written will
+        be returned.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    UINTN BytesRead;
+    UINTN BytesRemaining;
+    UINTN BytesThisRound;
+    UINTN BytesWritten;
+    PIO_BUFFER IoBuffer;
+    SOCKET_IO_PARAMETERS Parameters;
+    KSTATUS Status;
+
+    BytesThisRound = IO_SEND_FILE_CHUNK_SIZE;
+    if (BytesThisRound > Size) {
+        BytesThisRound = Size;
+    }
+
+    IoBuffer = MmAllocatePagedIoBuffer(BytesThisRound, 0);
+    if (IoBuffer == NULL) {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    BytesRemaining = Size;
+    Status = STATUS_SUCCESS;
+    while (BytesRemaining != 0) {
+        BytesThisRound = IO_SEND_FILE_CHUNK_SIZE;
+        if (BytesThisRound > BytesRemaining) {
+            BytesThisRound = BytesRemaining;
+        }
+
+        BytesRead = 0;
+        Status = IoReadAtOffset(Source,
+                                IoBuffer,
+                                SourceOffset,
+                                BytesThisRound,
+                                0,
+                                WAIT_TIME_INDEFINITE,
+                                &BytesRead,
+                                NULL);
+
+        if (Status == STATUS_END_OF_FILE) {
+            Status = STATUS_SUCCESS;
+        }
+
+        if ((!KSUCCESS(Status)) || (BytesRead == 0)) {
+            break;
+        }
+
+        //
+        // A non-seekable source cannot be rewound, so anything read but not
+        // written here is lost. This matches what a read and write loop in
+        // user mode would do.
+        //
+
+        BytesWritten = 0;
+        if (Destination->FileObject->Properties.Type == IoObjectSocket) {
+            RtlZeroMemory(&Parameters, sizeof(SOCKET_IO_PARAMETERS));
+            Parameters.Size = BytesRead;
+            Parameters.IoFlags = SYS_IO_FLAG_WRITE;
+            Parameters.TimeoutInMilliseconds = Timeout;
+            Status = IoSocketSendData(TRUE, Destination, &Parameters, IoBuffer);
+            BytesWritten = Parameters.BytesCompleted;
+
+        } else {
+            Status = IoWriteAtOffset(Destination,
+                                     IoBuffer,
+                                     DestinationOffset,
+                                     BytesRead,
+                                     0,
+                                     Timeout,
+                                     &BytesWritten,
+                                     NULL);
+
+            if (DestinationOffset != IO_OFFSET_NONE) {
+                DestinationOffset += BytesWritten;
+            }
+        }
+
+        if (SourceOffset != IO_OFFSET_NONE) {
+            SourceOffset += BytesWritten;
+        }
+
+        *BytesCompleted += BytesWritten;
+        BytesRemaining -= BytesWritten;
+        if ((!KSUCCESS(Status)) ||
+            (BytesWritten != BytesRead) ||
+            (BytesRead != BytesThisRound)) {
+
+            break;
+        }
+    }
+
+    MmFreeIoBuffer(IoBuffer);
+    return Status;
+}
+
@@ -1626,6 +1626,7 @@ Return Value:
     ParametersCopied = TRUE;
     IoParameters.BytesCompleted = 0;
     IoParameters.IoFlags &= SYS_IO_FLAG_MASK;
+    IoParameters.SocketIoFlags &= ~SOCKET_IO_KERNEL_FLAGS;
     Status = MmInitializeIoBuffer(&IoBuffer,
                                   Parameters->Buffer,
                                   INVALID_PHYSICAL_ADDRESS,
@@ -1761,6 +1762,7 @@ Return Value:
     ParametersCopied = TRUE;
     IoParameters.BytesCompleted = 0;
     IoParameters.IoFlags &= SYS_IO_FLAG_MASK;
+    IoParameters.SocketIoFlags &= ~SOCKET_IO_KERNEL_FLAGS;
     Status = MmCreateIoBufferFromVector(Parameters->VectorArray,
                                         FALSE,
                                         Parameters->VectorCount,
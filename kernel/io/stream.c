@@ -38,6 +38,14 @@ Module Name:
 
 #define DEFAULT_STREAM_BUFFER_SIZE 8192
 
+//
+// Define the minimum amount that a blocking write must overflow the ring
+// buffer by before the overflow is handed to readers as locked pages to copy
+// out of directly.
+//
+
+#define STREAM_BUFFER_DIRECT_THRESHOLD (16 * 1024)
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -71,6 +79,19 @@ Structure Description:
 
     IoState - Stores a pointer to the I/O object state.
 
+    DirectIoBuffer - Stores an optional pointer to a writer's locked and mapped
+        I/O buffer. Once the ring buffer is drained, readers copy straight out
+        of this buffer rather than having the writer copy into the ring first.
+
+    DirectOffset - Stores the offset into the direct I/O buffer of the next
+        byte to be read.
+
+    DirectSize - Stores the number of bytes the writer offered in the direct
+        I/O buffer.
+
+    DirectEvent - Stores a pointer to the event signaled when readers have
+        consumed the entire direct I/O buffer.
+
 --*/
 
 struct _STREAM_BUFFER {
@@ -82,12 +103,35 @@ struct _STREAM_BUFFER {
     ULONG AtomicWriteSize;
     PQUEUED_LOCK Lock;
     PIO_OBJECT_STATE IoState;
+    PIO_BUFFER DirectIoBuffer;
+    UINTN DirectOffset;
+    UINTN DirectSize;
+    PKEVENT DirectEvent;
 };
 
 //
 // ----------------------------------------------- Internal Function Prototypes
 //
 
+KSTATUS
+IopWriteStreamBufferDirect (
+    PSTREAM_BUFFER StreamBuffer,
+    PIO_BUFFER IoBuffer,
+    UINTN ByteCount,
+    ULONG TimeoutInMilliseconds,
+    PUINTN BytesWritten
+    );
+
+KSTATUS
+IopReadStreamBufferDirect (
+    PSTREAM_BUFFER StreamBuffer,
+    PIO_BUFFER IoBuffer,
+    UINTN IoBufferOffset,
+    UINTN ByteCount,
+    ULONG ReturnedEvents,
+    PUINTN BytesRead
+    );
+
 //
 // -------------------------------------------------------------------- Globals
 //
@@ -190,6 +234,12 @@ Return Value:
         goto CreateStreamBufferEnd;
     }
 
+    StreamBuffer->DirectEvent = KeCreateEvent(NULL);
+    if (StreamBuffer->DirectEvent == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto CreateStreamBufferEnd;
+    }
+
     //
     // Use the given I/O object state or create one.
     //
@@ -212,6 +262,10 @@ Return Value:
                 MmFreePagedPool(StreamBuffer->Buffer);
             }
 
+            if (StreamBuffer->DirectEvent != NULL) {
+                KeDestroyEvent(StreamBuffer->DirectEvent);
+            }
+
             MmFreePagedPool(StreamBuffer);
             StreamBuffer = NULL;
         }
@@ -244,6 +298,8 @@ Return Value:
 
 {
 
+    ASSERT(StreamBuffer->DirectIoBuffer == NULL);
+
     if (StreamBuffer->Lock != NULL) {
         KeDestroyQueuedLock(StreamBuffer->Lock);
     }
@@ -254,6 +310,11 @@ Return Value:
         StreamBuffer->Buffer = NULL;
     }
 
+    if (StreamBuffer->DirectEvent != NULL) {
+        KeDestroyEvent(StreamBuffer->DirectEvent);
+        StreamBuffer->DirectEvent = NULL;
+    }
+
     MmFreePagedPool(StreamBuffer);
     return;
 }
@@ -306,6 +367,7 @@ Return Value:
     ULONG BytesAvailable;
     ULONG BytesReadHere;
     ULONG BytesToRead;
+    UINTN DirectBytesRead;
     ULONG EventsMask;
     ULONG NextWriteOffset;
     ULONG ReturnedEvents;
@@ -354,7 +416,8 @@ Return Value:
         // Start over if there's nothing to read.
         //
 
-        if (StreamBuffer->NextReadOffset == StreamBuffer->NextWriteOffset) {
+        if ((StreamBuffer->NextReadOffset == StreamBuffer->NextWriteOffset) &&
+            (StreamBuffer->DirectIoBuffer == NULL)) {
 
             //
             // If the IN flag is set, then that would mean this routine is
@@ -393,6 +456,30 @@ Return Value:
             }
         }
 
+        //
+        // Data in the ring was written before any direct transfer was offered,
+        // so only copy out of a writer's buffer once the ring is empty.
+        //
+
+        if (StreamBuffer->NextReadOffset == StreamBuffer->NextWriteOffset) {
+            Status = IopReadStreamBufferDirect(StreamBuffer,
+                                               IoBuffer,
+                                               *BytesRead,
+                                               ByteCount,
+                                               ReturnedEvents,
+                                               &DirectBytesRead);
+
+            KeReleaseQueuedLock(StreamBuffer->Lock);
+            if (!KSUCCESS(Status)) {
+                return Status;
+            }
+
+            *BytesRead += DirectBytesRead;
+            BytesReadHere += DirectBytesRead;
+            ByteCount -= DirectBytesRead;
+            continue;
+        }
+
         //
         // Now read the buffer, at least going to the end of the buffer.
         // Wraparounds will be handled later on.
@@ -493,7 +580,10 @@ Return Value:
 
         if ((ReturnedEvents & POLL_ERROR_EVENTS) == 0) {
             IoSetIoObjectState(StreamBuffer->IoState, POLL_EVENT_OUT, TRUE);
-            if (StreamBuffer->NextReadOffset != StreamBuffer->NextWriteOffset) {
+            if ((StreamBuffer->NextReadOffset !=
+                 StreamBuffer->NextWriteOffset) ||
+                (StreamBuffer->DirectIoBuffer != NULL)) {
+
                 IoSetIoObjectState(StreamBuffer->IoState, POLL_EVENT_IN, TRUE);
 
             } else {
@@ -562,9 +652,13 @@ Return Value:
 
     ULONG BytesAvailable;
     ULONG BytesToWrite;
+    ULONGLONG CurrentTime;
+    ULONGLONG EndTime;
     ULONG EventsMask;
+    ULONGLONG Frequency;
     ULONG NextReadOffset;
     ULONG ReturnedEvents;
+    ULONG RingCapacity;
     KSTATUS Status;
     ULONG TotalBytesAvailable;
 
@@ -573,6 +667,61 @@ Return Value:
 
     ASSERT(KeGetRunLevel() == RunLevelLow);
 
+    //
+    // A blocking write too big for the ring has to wait on readers anyway.
+    // Let readers copy the part that does not fit straight out of the
+    // writer's pages, then put the rest in the ring as usual so the write
+    // still completes once the remainder is buffered. Only one direct write
+    // can be offered at a time; others just use the ring.
+    //
+
+    RingCapacity = StreamBuffer->Size - 1;
+    if ((NonBlocking == FALSE) &&
+        (ByteCount >= RingCapacity + STREAM_BUFFER_DIRECT_THRESHOLD) &&
+        (StreamBuffer->DirectIoBuffer == NULL)) {
+
+        EndTime = 0;
+        Frequency = 0;
+        if ((TimeoutInMilliseconds != 0) &&
+            (TimeoutInMilliseconds != WAIT_TIME_INDEFINITE)) {
+
+            Frequency = HlQueryTimeCounterFrequency();
+            EndTime = KeGetRecentTimeCounter() +
+                      KeConvertMicrosecondsToTimeTicks(
+                                  (ULONGLONG)TimeoutInMilliseconds *
+                                  MICROSECONDS_PER_MILLISECOND);
+        }
+
+        Status = IopWriteStreamBufferDirect(StreamBuffer,
+                                            IoBuffer,
+                                            ByteCount - RingCapacity,
+                                            TimeoutInMilliseconds,
+                                            BytesWritten);
+
+        if (Status != STATUS_RESOURCE_IN_USE) {
+            if (!KSUCCESS(Status)) {
+                return Status;
+            }
+
+            ByteCount -= *BytesWritten;
+        }
+
+        //
+        // The ring only gets whatever time the direct write left over.
+        //
+
+        if (EndTime != 0) {
+            CurrentTime = KeGetRecentTimeCounter();
+            if (CurrentTime >= EndTime) {
+                TimeoutInMilliseconds = 0;
+
+            } else {
+                TimeoutInMilliseconds = ((EndTime - CurrentTime) *
+                                         MILLISECONDS_PER_SECOND) / Frequency;
+            }
+        }
+    }
+
     Status = STATUS_SUCCESS;
     while (ByteCount != 0) {
         if (NonBlocking == FALSE) {
@@ -846,7 +995,9 @@ Return Value:
     // Signal the read event if there's data in there.
     //
 
-    if (TotalBytesAvailable != StreamBuffer->Size - 1) {
+    if ((TotalBytesAvailable != StreamBuffer->Size - 1) ||
+        (StreamBuffer->DirectIoBuffer != NULL)) {
+
         IoSetIoObjectState(StreamBuffer->IoState, POLL_EVENT_IN, TRUE);
 
     } else {
@@ -887,3 +1038,244 @@ Return Value:
 // --------------------------------------------------------- Internal Functions
 //
 
+KSTATUS
+IopWriteStreamBufferDirect (
+    PSTREAM_BUFFER StreamBuffer,
+    PIO_BUFFER IoBuffer,
+    UINTN ByteCount,
+    ULONG TimeoutInMilliseconds,
+    PUINTN BytesWritten
+    )
+
+/*++
+
+Routine Description:
+
+    This routine writes to a stream buffer by locking the writer's pages and
+    offering them to readers, who copy directly out of them into their own
+    buffers. This saves a copy through the ring buffer for large transfers.
+    The routine does not return until the data is consumed, the wait times out
+    or is interrupted, or the stream is broken.
+
+Arguments:
+
+    StreamBuffer - Supplies a pointer to the stream buffer to write to.
+
+    IoBuffer - Supplies a pointer to the I/O buffer containing the data to
+        write to the stream buffer.
+
+    ByteCount - Supplies the number of bytes to write.
+
+    TimeoutInMilliseconds - Supplies the number of milliseconds to wait for
+        readers to consume the data. Use WAIT_TIME_INDEFINITE to wait forever.
+
+    BytesWritten - Supplies a pointer where the number of bytes consumed by
+        readers will be returned.
+
+Return Value:
+
+    STATUS_RESOURCE_IN_USE if another direct write is already in progress, in
+    which case the caller should fall back to the ring buffer.
+
+    Other status codes. If a failing status code is returned, then check the
+    number of bytes written to see if any data was consumed.
+
+--*/
+
+{
+
+    UINTN BytesConsumed;
+    BOOL LockedCopy;
+    PIO_BUFFER LockedIoBuffer;
+    KSTATUS Status;
+    PVOID WaitObjectArray[2];
+
+    BytesConsumed = 0;
+    LockedCopy = FALSE;
+
+    //
+    // Pin the writer's pages and map them into kernel space so that reader
+    // threads in other processes can copy out of them.
+    //
+
+    LockedIoBuffer = IoBuffer;
+    Status = MmValidateIoBuffer(0,
+                                MAX_ULONGLONG,
+                                0,
+                                ByteCount,
+                                FALSE,
+                                &LockedIoBuffer,
+                                &LockedCopy);
+
+    if (!KSUCCESS(Status)) {
+        goto WriteStreamBufferDirectEnd;
+    }
+
+    ASSERT((LockedIoBuffer == IoBuffer) || (LockedCopy != FALSE));
+
+    Status = MmMapIoBuffer(LockedIoBuffer, FALSE, FALSE, FALSE);
+    if (!KSUCCESS(Status)) {
+        goto WriteStreamBufferDirectEnd;
+    }
+
+    //
+    // Offer the buffer to readers, unless someone else beat this writer to
+    // it or the stream is broken.
+    //
+
+    KeAcquireQueuedLock(StreamBuffer->Lock);
+    if (StreamBuffer->DirectIoBuffer != NULL) {
+        KeReleaseQueuedLock(StreamBuffer->Lock);
+        Status = STATUS_RESOURCE_IN_USE;
+        goto WriteStreamBufferDirectEnd;
+    }
+
+    if ((StreamBuffer->IoState->Events & POLL_ERROR_EVENTS) != 0) {
+        KeReleaseQueuedLock(StreamBuffer->Lock);
+        Status = STATUS_BROKEN_PIPE;
+        goto WriteStreamBufferDirectEnd;
+    }
+
+    StreamBuffer->DirectIoBuffer = LockedIoBuffer;
+    StreamBuffer->DirectOffset = 0;
+    StreamBuffer->DirectSize = ByteCount;
+    KeSignalEvent(StreamBuffer->DirectEvent, SignalOptionUnsignal);
+    IoSetIoObjectState(StreamBuffer->IoState, POLL_EVENT_IN, TRUE);
+    KeReleaseQueuedLock(StreamBuffer->Lock);
+
+    //
+    // Wait for readers to drain the buffer, or for the other side to go away.
+    //
+
+    WaitObjectArray[0] = StreamBuffer->IoState->ErrorEvent;
+    WaitObjectArray[1] = StreamBuffer->DirectEvent;
+    Status = ObWaitOnObjects(WaitObjectArray,
+                             2,
+                             WAIT_FLAG_INTERRUPTIBLE,
+                             TimeoutInMilliseconds,
+                             NULL,
+                             NULL);
+
+    //
+    // Take the buffer back if readers have not finished with it. Readers only
+    // clear the direct buffer once it is fully consumed, and no one else can
+    // offer a buffer until then.
+    //
+
+    KeAcquireQueuedLock(StreamBuffer->Lock);
+    if (StreamBuffer->DirectIoBuffer == LockedIoBuffer) {
+        BytesConsumed = StreamBuffer->DirectOffset;
+        StreamBuffer->DirectIoBuffer = NULL;
+        StreamBuffer->DirectOffset = 0;
+        StreamBuffer->DirectSize = 0;
+        if ((StreamBuffer->NextReadOffset == StreamBuffer->NextWriteOffset) &&
+            ((StreamBuffer->IoState->Events & POLL_ERROR_EVENTS) == 0)) {
+
+            IoSetIoObjectState(StreamBuffer->IoState, POLL_EVENT_IN, FALSE);
+        }
+
+        if (KSUCCESS(Status)) {
+            Status = STATUS_BROKEN_PIPE;
+        }
+
+    } else {
+        BytesConsumed = ByteCount;
+        Status = STATUS_SUCCESS;
+    }
+
+    KeReleaseQueuedLock(StreamBuffer->Lock);
+
+WriteStreamBufferDirectEnd:
+    if (LockedCopy != FALSE) {
+        MmFreeIoBuffer(LockedIoBuffer);
+    }
+
+    *BytesWritten = BytesConsumed;
+    return Status;
+}
+
+KSTATUS
+IopReadStreamBufferDirect (
+    PSTREAM_BUFFER StreamBuffer,
+    PIO_BUFFER IoBuffer,
+    UINTN IoBufferOffset,
+    UINTN ByteCount,
+    ULONG ReturnedEvents,
+    PUINTN BytesRead
+    )
+
+/*++
+
+Routine Description:
+
+    This routine copies data out of a writer's direct I/O buffer. It assumes
+    the stream buffer lock is held, the ring buffer is empty, and a direct
+    I/O buffer is present.
+
+Arguments:
+
+    StreamBuffer - Supplies a pointer to the stream buffer to read from.
+
+    IoBuffer - Supplies a pointer to the I/O buffer where the read data will be
+        returned.
+
+    IoBufferOffset - Supplies the offset into the I/O buffer to copy to.
+
+    ByteCount - Supplies the maximum number of bytes to read.
+
+    ReturnedEvents - Supplies the I/O object state events observed when the
+        reader woke up.
+
+    BytesRead - Supplies a pointer where the number of bytes read will be
+        returned.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    UINTN BytesToRead;
+    KSTATUS Status;
+
+    ASSERT(StreamBuffer->NextReadOffset == StreamBuffer->NextWriteOffset);
+    ASSERT(StreamBuffer->DirectIoBuffer != NULL);
+
+    *BytesRead = 0;
+    BytesToRead = StreamBuffer->DirectSize - StreamBuffer->DirectOffset;
+    if (ByteCount < BytesToRead) {
+        BytesToRead = ByteCount;
+    }
+
+    Status = MmCopyIoBuffer(IoBuffer,
+                            IoBufferOffset,
+                            StreamBuffer->DirectIoBuffer,
+                            StreamBuffer->DirectOffset,
+                            BytesToRead);
+
+    if (!KSUCCESS(Status)) {
+        return Status;
+    }
+
+    StreamBuffer->DirectOffset += BytesToRead;
+    *BytesRead = BytesToRead;
+
+    //
+    // Once the whole buffer is consumed, hand it back to the writer.
+    //
+
+    if (StreamBuffer->DirectOffset == StreamBuffer->DirectSize) {
+        StreamBuffer->DirectIoBuffer = NULL;
+        StreamBuffer->DirectOffset = 0;
+        StreamBuffer->DirectSize = 0;
+        KeSignalEvent(StreamBuffer->DirectEvent, SignalOptionSignalAll);
+        if ((ReturnedEvents & POLL_ERROR_EVENTS) == 0) {
+            IoSetIoObjectState(StreamBuffer->IoState, POLL_EVENT_IN, FALSE);
+        }
+    }
+
+    return STATUS_SUCCESS;
+}
+
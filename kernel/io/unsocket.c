@@ -45,6 +45,13 @@ Module Name:
 
 #define UNIX_SOCKET_DEFAULT_SEND_MAX 131072
 
+//
+// Define the packet size at or above which a blocking send queues a reference
+// to the sender's locked pages rather than a copy of the data.
+//
+
+#define UNIX_SOCKET_DIRECT_THRESHOLD (16 * 1024)
+
 //
 // Define the maximum number of file descriptors that can be passed in a
 // rights control message.
@@ -140,6 +147,17 @@ Structure Description:
     HandleCount - Stores the number of file handles being passed in this
         message.
 
+    IoBuffer - Stores an optional pointer to the sender's locked I/O buffer.
+        If set, the data lives in the sender's pages and the receiver copies
+        straight out of them. Data is NULL in this case.
+
+    IoBufferOffset - Stores the offset into the sender's I/O buffer where this
+        packet's data begins.
+
+    DoneEvent - Stores an optional pointer to the sender's event, which is
+        signaled when the packet is destroyed. This is set whenever the I/O
+        buffer is, and the packet holds a reference on it.
+
 --*/
 
 typedef struct _UNIX_SOCKET_PACKET {
@@ -151,6 +169,9 @@ typedef struct _UNIX_SOCKET_PACKET {
     UNIX_SOCKET_CREDENTIALS Credentials;
     PIO_HANDLE *Handles;
     UINTN HandleCount;
+    PIO_BUFFER IoBuffer;
+    UINTN IoBufferOffset;
+    PKEVENT DoneEvent;
 } UNIX_SOCKET_PACKET, *PUNIX_SOCKET_PACKET;
 
 /*++
@@ -243,6 +264,7 @@ IopUnixSocketCreatePacket (
     PIO_BUFFER IoBuffer,
     UINTN Offset,
     UINTN DataSize,
+    PKEVENT DoneEvent,
     PUNIX_SOCKET_PACKET *NewPacket
     );
 
@@ -251,6 +273,17 @@ IopUnixSocketDestroyPacket (
     PUNIX_SOCKET_PACKET Packet
     );
 
+KSTATUS
+IopUnixSocketWaitForPacket (
+    PUNIX_SOCKET Sender,
+    PUNIX_SOCKET Receiver,
+    PUNIX_SOCKET_PACKET Packet,
+    PKEVENT DoneEvent,
+    UINTN PacketSize,
+    ULONG TimeoutInMilliseconds,
+    PUINTN BytesConsumed
+    );
+
 KSTATUS
 IopUnixSocketSendControlData (
     BOOL FromKernelMode,
@@ -1348,9 +1381,13 @@ Return Value:
     UINTN BytesCompleted;
     PNETWORK_ADDRESS Destination;
     NETWORK_ADDRESS DestinationLocal;
+    PKEVENT DoneEvent;
     PFILE_OBJECT FileObject;
+    BOOL LockedCopy;
+    PIO_BUFFER LockedIoBuffer;
     ULONG OpenFlags;
     PUNIX_SOCKET_PACKET Packet;
+    PKEVENT PacketEvent;
     UINTN PacketSize;
     PATH_POINT PathPoint;
     PKPROCESS Process;
@@ -1368,10 +1405,53 @@ Return Value:
     UINTN WalkedPathSize;
 
     BytesCompleted = 0;
+    DoneEvent = NULL;
+    LockedCopy = FALSE;
+    LockedIoBuffer = IoBuffer;
     Packet = NULL;
     IO_INITIALIZE_PATH_POINT(&PathPoint);
     RemoteCopy = NULL;
     UnixSocket = (PUNIX_SOCKET)Socket;
+    UnixSocketLockHeld = FALSE;
+    OpenFlags = IoGetIoHandleOpenFlags(Socket->IoHandle);
+
+    //
+    // Large blocking stream sends may have to wait for the receiver anyway.
+    // Lock down the sender's pages so that whatever does not fit in the send
+    // buffer can be queued as a reference to them, saving the copy into an
+    // intermediate packet.
+    //
+
+    if ((Socket->Type == NetSocketStream) &&
+        ((OpenFlags & OPEN_FLAG_NON_BLOCKING) == 0) &&
+        (Parameters->Size >= UNIX_SOCKET_DIRECT_THRESHOLD)) {
+
+        Status = MmValidateIoBuffer(0,
+                                    MAX_ULONGLONG,
+                                    0,
+                                    Parameters->Size,
+                                    FALSE,
+                                    &LockedIoBuffer,
+                                    &LockedCopy);
+
+        if (!KSUCCESS(Status)) {
+            goto UnixSocketSendDataEnd;
+        }
+
+        ASSERT((LockedIoBuffer == IoBuffer) || (LockedCopy != FALSE));
+
+        Status = MmMapIoBuffer(LockedIoBuffer, FALSE, FALSE, FALSE);
+        if (!KSUCCESS(Status)) {
+            goto UnixSocketSendDataEnd;
+        }
+
+        DoneEvent = KeCreateEvent(NULL);
+        if (DoneEvent == NULL) {
+            Status = STATUS_INSUFFICIENT_RESOURCES;
+            goto UnixSocketSendDataEnd;
+        }
+    }
+
     KeAcquireQueuedLock(UnixSocket->Lock);
     UnixSocketLockHeld = TRUE;
 
@@ -1465,7 +1545,8 @@ Return Value:
 
         FileObject = PathPoint.PathEntry->FileObject;
         if (FileObject->Properties.Type != IoObjectSocket) {
-            return STATUS_NOT_A_SOCKET;
+            Status = STATUS_NOT_A_SOCKET;
+            goto UnixSocketSendDataEnd;
         }
 
         ASSERT((UINTN)(FileObject->Properties.DeviceId) ==
@@ -1483,8 +1564,6 @@ Return Value:
         goto UnixSocketSendDataEnd;
     }
 
-    OpenFlags = IoGetIoHandleOpenFlags(Socket->IoHandle);
-
     //
     // Loop while there's data to send.
     //
@@ -1530,6 +1609,8 @@ Return Value:
             PacketSize = Size;
         }
 
+        PacketEvent = NULL;
+
         //
         // If the whole packet needs to be sent in one go, block to wait for
         // more space to free up, and try again.
@@ -1543,12 +1624,25 @@ Return Value:
             }
 
         //
-        // Streams can send multiple packets at a time.
+        // Streams can send multiple packets at a time. If the rest of the data
+        // does not fit, send the part that would have to wait as a reference
+        // to the sender's pages. Those packets take no pool memory, so they
+        // are allowed to go over the send limit. They are still charged
+        // against it like any other packet, so later writes wait for the
+        // receiver to catch up. The part that fits is buffered as usual once
+        // the receiver is done.
         //
 
         } else {
 
             ASSERT(Socket->Type == NetSocketStream);
+
+            if ((DoneEvent != NULL) &&
+                ((Size - PacketSize) >= UNIX_SOCKET_DIRECT_THRESHOLD)) {
+
+                PacketSize = Size - PacketSize;
+                PacketEvent = DoneEvent;
+            }
         }
 
         //
@@ -1559,9 +1653,10 @@ Return Value:
         if (PacketSize != 0) {
             Packet = NULL;
             Status = IopUnixSocketCreatePacket(UnixSocket,
-                                               IoBuffer,
+                                               LockedIoBuffer,
                                                BytesCompleted,
                                                PacketSize,
+                                               PacketEvent,
                                                &Packet);
 
             if (!KSUCCESS(Status)) {
@@ -1683,6 +1778,30 @@ Return Value:
         }
 
         KeReleaseQueuedLock(RemoteUnixSocket->Lock);
+
+        //
+        // If the packet references the sender's pages, wait for the receiver
+        // to finish with it. The receiver may destroy the packet at any point
+        // now, so only the local copy of the event can be used.
+        //
+
+        if (PacketEvent != NULL) {
+            Status = IopUnixSocketWaitForPacket(
+                                             UnixSocket,
+                                             RemoteUnixSocket,
+                                             Packet,
+                                             PacketEvent,
+                                             PacketSize,
+                                             Parameters->TimeoutInMilliseconds,
+                                             &PacketSize);
+
+            if (!KSUCCESS(Status)) {
+                Packet = NULL;
+                BytesCompleted += PacketSize;
+                goto UnixSocketSendDataEnd;
+            }
+        }
+
         Packet = NULL;
         BytesCompleted += PacketSize;
         Size -= PacketSize;
@@ -1724,6 +1843,19 @@ Return Value:
         IO_PATH_POINT_RELEASE_REFERENCE(&PathPoint);
     }
 
+    //
+    // No packets reference the sender's pages anymore, as every one was
+    // either waited on or destroyed above.
+    //
+
+    if (DoneEvent != NULL) {
+        KeDestroyEvent(DoneEvent);
+    }
+
+    if (LockedCopy != FALSE) {
+        MmFreeIoBuffer(LockedIoBuffer);
+    }
+
     Parameters->BytesCompleted = BytesCompleted;
     return Status;
 }
@@ -1884,11 +2016,20 @@ Return Value:
                 ByteCount = Size;
             }
 
-            Status = MmCopyIoBufferData(IoBuffer,
-                                        Packet->Data + Packet->Offset,
+            if (Packet->IoBuffer != NULL) {
+                Status = MmCopyIoBuffer(IoBuffer,
                                         BytesReceived,
-                                        ByteCount,
-                                        TRUE);
+                                        Packet->IoBuffer,
+                                        Packet->IoBufferOffset + Packet->Offset,
+                                        ByteCount);
+
+            } else {
+                Status = MmCopyIoBufferData(IoBuffer,
+                                            Packet->Data + Packet->Offset,
+                                            BytesReceived,
+                                            ByteCount,
+                                            TRUE);
+            }
 
             if (!KSUCCESS(Status)) {
                 goto UnixSocketReceiveDataEnd;
@@ -1972,6 +2113,7 @@ Return Value:
                 (Socket->Type == NetSocketDatagram)) {
 
                 LIST_REMOVE(&(Packet->ListEntry));
+                Packet->ListEntry.Next = NULL;
                 if (LIST_EMPTY(&(UnixSocket->ReceiveList)) != FALSE) {
                     IoSetIoObjectState(Socket->IoState, POLL_EVENT_IN, FALSE);
                 }
@@ -2646,6 +2788,7 @@ Return Value:
                             ListEntry);
 
         LIST_REMOVE(&(Packet->ListEntry));
+        Packet->ListEntry.Next = NULL;
         KeAcquireQueuedLock(Packet->Sender->Lock);
 
         ASSERT(Packet->Sender->SendListSize >= Packet->Length);
@@ -2668,6 +2811,7 @@ IopUnixSocketCreatePacket (
     PIO_BUFFER IoBuffer,
     UINTN Offset,
     UINTN DataSize,
+    PKEVENT DoneEvent,
     PUNIX_SOCKET_PACKET *NewPacket
     )
 
@@ -2683,12 +2827,17 @@ Routine Description:
     Sender - Supplies a pointer to the socket sending the data.
 
     IoBuffer - Supplies a pointer to the I/O buffer to base the data on. A
-        copy of this data will be made.
+        copy of this data will be made unless a done event is supplied.
 
     Offset - Supplies the offset from the start of the I/O buffer to copy from.
 
     DataSize - Supplies the number of bytes to send.
 
+    DoneEvent - Supplies an optional pointer to an event to signal when the
+        packet is destroyed. If supplied, the packet references the I/O buffer
+        rather than copying it, so the I/O buffer must be locked and mapped and
+        must stay around until the event is signaled.
+
     NewPacket - Supplies a pointer where a pointer to a newly allocated packet
         will be returned on success.
 
@@ -2704,7 +2853,11 @@ Return Value:
     PUNIX_SOCKET_PACKET Packet;
     KSTATUS Status;
 
-    AllocationSize = sizeof(UNIX_SOCKET_PACKET) + DataSize;
+    AllocationSize = sizeof(UNIX_SOCKET_PACKET);
+    if (DoneEvent == NULL) {
+        AllocationSize += DataSize;
+    }
+
     Packet = MmAllocatePagedPool(AllocationSize, UNIX_SOCKET_ALLOCATION_TAG);
     if (Packet == NULL) {
         return STATUS_INSUFFICIENT_RESOURCES;
@@ -2719,7 +2872,17 @@ Return Value:
     Packet->Credentials.GroupId = -1;
     Packet->Handles = NULL;
     Packet->HandleCount = 0;
-    if (DataSize != 0) {
+    Packet->IoBuffer = NULL;
+    Packet->IoBufferOffset = 0;
+    Packet->DoneEvent = DoneEvent;
+    if (DoneEvent != NULL) {
+        Packet->Data = NULL;
+        Packet->IoBuffer = IoBuffer;
+        Packet->IoBufferOffset = Offset;
+        KeSignalEvent(DoneEvent, SignalOptionUnsignal);
+        ObAddReference(DoneEvent);
+
+    } else if (DataSize != 0) {
         Status = MmCopyIoBufferData(IoBuffer,
                                     Packet->Data,
                                     Offset,
@@ -2776,11 +2939,134 @@ Return Value:
         MmFreePagedPool(IoHandleArray);
     }
 
+    //
+    // Let a sender waiting on its pages know the receiver is done with them.
+    // The sender does not touch the packet once this is signaled, and may
+    // destroy the event, so the packet holds its own reference.
+    //
+
+    if (Packet->DoneEvent != NULL) {
+        KeSignalEvent(Packet->DoneEvent, SignalOptionSignalAll);
+        ObReleaseReference(Packet->DoneEvent);
+    }
+
     IoSocketReleaseReference(&(Packet->Sender->KernelSocket));
     MmFreePagedPool(Packet);
     return;
 }
 
+KSTATUS
+IopUnixSocketWaitForPacket (
+    PUNIX_SOCKET Sender,
+    PUNIX_SOCKET Receiver,
+    PUNIX_SOCKET_PACKET Packet,
+    PKEVENT DoneEvent,
+    UINTN PacketSize,
+    ULONG TimeoutInMilliseconds,
+    PUINTN BytesConsumed
+    )
+
+/*++
+
+Routine Description:
+
+    This routine waits for the receiver to finish with a queued packet that
+    references the sender's pages. If the wait times out or is interrupted,
+    the packet is pulled back off the receive list. This routine assumes
+    neither socket lock is held.
+
+Arguments:
+
+    Sender - Supplies a pointer to the sending socket.
+
+    Receiver - Supplies a pointer to the socket the packet was queued on.
+
+    Packet - Supplies a pointer to the queued packet. This may already be
+        destroyed.
+
+    DoneEvent - Supplies a pointer to the event the packet signals when it is
+        destroyed.
+
+    PacketSize - Supplies the number of bytes in the packet.
+
+    TimeoutInMilliseconds - Supplies the number of milliseconds to wait. Use
+        WAIT_TIME_INDEFINITE to wait forever.
+
+    BytesConsumed - Supplies a pointer where the number of bytes of the packet
+        the receiver consumed will be returned.
+
+Return Value:
+
+    Status code. If a failing status code is returned, the packet has been
+    destroyed, and some of its data may still have been received.
+
+--*/
+
+{
+
+    PLIST_ENTRY CurrentEntry;
+    BOOL Queued;
+    KSTATUS Status;
+
+    *BytesConsumed = PacketSize;
+    Status = KeWaitForEvent(DoneEvent, TRUE, TimeoutInMilliseconds);
+    if (KSUCCESS(Status)) {
+        return Status;
+    }
+
+    //
+    // The packet is only guaranteed to be around while it is on the receive
+    // list. Once a receiver pulls it off, it may be destroyed at any time, so
+    // look for the pointer on the list rather than dereferencing it.
+    //
+
+    Queued = FALSE;
+    KeAcquireQueuedLock(Receiver->Lock);
+    CurrentEntry = Receiver->ReceiveList.Next;
+    while (CurrentEntry != &(Receiver->ReceiveList)) {
+        if (CurrentEntry == &(Packet->ListEntry)) {
+            Queued = TRUE;
+            break;
+        }
+
+        CurrentEntry = CurrentEntry->Next;
+    }
+
+    if (Queued != FALSE) {
+        LIST_REMOVE(&(Packet->ListEntry));
+        Packet->ListEntry.Next = NULL;
+        if (LIST_EMPTY(&(Receiver->ReceiveList)) != FALSE) {
+            IoSetIoObjectState(Receiver->KernelSocket.IoState,
+                               POLL_EVENT_IN,
+                               FALSE);
+        }
+
+        *BytesConsumed = Packet->Offset;
+    }
+
+    KeReleaseQueuedLock(Receiver->Lock);
+
+    //
+    // If the receiver already took the packet, it is about to destroy it. Wait
+    // for that so the sender's pages can be released.
+    //
+
+    if (Queued == FALSE) {
+        KeWaitForEvent(DoneEvent, FALSE, WAIT_TIME_INDEFINITE);
+        return STATUS_SUCCESS;
+    }
+
+    KeAcquireQueuedLock(Sender->Lock);
+
+    ASSERT(Sender->SendListSize >= Packet->Length);
+
+    IoSetIoObjectState(Sender->KernelSocket.IoState, POLL_EVENT_OUT, TRUE);
+    Sender->SendListSize -= Packet->Length;
+    KeReleaseQueuedLock(Sender->Lock);
+    IopUnixSocketDestroyPacket(Packet);
+    return Status;
+}
+
 KSTATUS
 IopUnixSocketSendControlData (
     BOOL FromKernelMode,
@@ -2264,6 +2264,28 @@ Return Value:
 
         break;
 
+    //
+    // Record how the caller expects to access the file, or start reading a
+    // region it will need soon.
+    //
+
+    case FileControlCommandSetAdvice:
+        if (FileControl->Parameters == NULL) {
+            Status = STATUS_INVALID_PARAMETER;
+            goto SysFileControlEnd;
+        }
+
+        Status = MmCopyFromUserMode(&LocalParameters,
+                                    FileControl->Parameters,
+                                    sizeof(FILE_ADVICE));
+
+        if (!KSUCCESS(Status)) {
+            goto SysFileControlEnd;
+        }
+
+        Status = IopSetHandleAdvice(IoHandle, &(LocalParameters.Advice));
+        break;
+
     default:
         Status = STATUS_INVALID_PARAMETER;
         break;
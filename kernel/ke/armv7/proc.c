@@ -196,6 +196,41 @@ Return Value:
     return Thread;
 }
 
+ULONG
+KepArchGetProcessorDomain (
+    ULONGLONG PhysicalId
+    )
+
+/*++
+
+Routine Description:
+
+    This routine determines which scheduling domain (physical package) a
+    processor belongs to. Processors in the same domain share caches, so
+    moving threads between them is cheaper than moving threads across domains.
+
+Arguments:
+
+    PhysicalId - Supplies the physical identifier of the processor, as
+        enumerated by the firmware tables.
+
+Return Value:
+
+    Returns the scheduling domain identifier for the processor.
+
+--*/
+
+{
+
+    //
+    // The physical ID on ARM is the interrupt controller's CPU interface
+    // number, which carries no cluster information. Treat all processors as
+    // sharing a single domain.
+    //
+
+    return 0;
+}
+
 //
 // --------------------------------------------------------- Internal Functions
 //
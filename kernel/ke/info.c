@@ -568,6 +568,14 @@ Return Value:
         Status = KepGetKernelCommandLine(Data, DataSize, Set);
         break;
 
+    case KeInformationQueuedLockStatistics:
+        Status = KepGetQueuedLockStatistics(Data, DataSize, Set);
+        break;
+
+    case KeInformationSpinLockStatistics:
+        Status = KepGetSetSpinLockStatistics(Data, DataSize, Set);
+        break;
+
     default:
         Status = STATUS_INVALID_PARAMETER;
         *DataSize = 0;
@@ -312,6 +312,12 @@ Return Value:
 
         ASSERT(Phase == 3);
 
+        //
+        // All processors are up now, so figure out which ones share caches.
+        //
+
+        KepInitializeSchedulerTopology();
+
         Status = KepInitializeEntropy();
         if (!KSUCCESS(Status)) {
             goto InitializeEnd;
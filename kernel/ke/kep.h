@@ -129,6 +129,30 @@ Return Value:
 
 --*/
 
+ULONG
+KepArchGetProcessorDomain (
+    ULONGLONG PhysicalId
+    );
+
+/*++
+
+Routine Description:
+
+    This routine determines which scheduling domain (physical package) a
+    processor belongs to. Processors in the same domain share caches, so
+    moving threads between them is cheaper than moving threads across domains.
+
+Arguments:
+
+    PhysicalId - Supplies the physical identifier of the processor, as
+        enumerated by the firmware tables.
+
+Return Value:
+
+    Returns the scheduling domain identifier for the processor.
+
+--*/
+
 VOID
 KepContextSwap (
     PVOID *SavedStackLocation,
@@ -513,6 +537,100 @@ Return Value:
 
 --*/
 
+VOID
+KepInitializeSchedulerTopology (
+    VOID
+    );
+
+/*++
+
+Routine Description:
+
+    This routine determines the scheduling domain of each active processor,
+    which the load balancer uses to keep threads near their caches. This must
+    be called once all processors have been started.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    None.
+
+--*/
+
+VOID
+KepSchedulerClockTick (
+    PPROCESSOR_BLOCK Processor
+    );
+
+/*++
+
+Routine Description:
+
+    This routine is called from the clock interrupt to update the scheduler's
+    load average for the current processor, and to periodically request a
+    load balance. This routine runs at clock level.
+
+Arguments:
+
+    Processor - Supplies a pointer to the processor block of the current
+        processor.
+
+Return Value:
+
+    None.
+
+--*/
+
+VOID
+KepBalanceScheduler (
+    BOOL Idle
+    );
+
+/*++
+
+Routine Description:
+
+    This routine evens out the load between the current processor and the
+    other processors in the system, pulling a batch of threads from the
+    busiest processor or pushing threads to the least busy one.
+
+Arguments:
+
+    Idle - Supplies a boolean indicating whether the current processor is
+        about to go idle (TRUE) or is balancing periodically (FALSE).
+
+Return Value:
+
+    None.
+
+--*/
+
+VOID
+KepEnforceThreadAffinity (
+    PKTHREAD Thread
+    );
+
+/*++
+
+Routine Description:
+
+    This routine moves a ready thread off of a processor its affinity no
+    longer allows it to run on. This routine must be called at dispatch level
+    or with interrupts disabled.
+
+Arguments:
+
+    Thread - Supplies a pointer to the thread to move.
+
+Return Value:
+
+    None.
+
+--*/
+
 KSTATUS
 KepWriteCrashDump (
     ULONG CrashCode,
@@ -545,3 +663,77 @@ Return Value:
     Status code.
 
 --*/
+
+KSTATUS
+KepGetQueuedLockStatistics (
+    PVOID Data,
+    PUINTN DataSize,
+    BOOL Set
+    );
+
+/*++
+
+Routine Description:
+
+    This routine gets contention statistics for all queued locks in the
+    system. Only locks that have been contended get an entry.
+
+Arguments:
+
+    Data - Supplies a pointer to the data buffer where the data is either
+        returned for a get operation or given for a set operation.
+
+    DataSize - Supplies a pointer that on input contains the size of the
+        data buffer. On output, contains the required size of the data buffer.
+
+    Set - Supplies a boolean indicating if this is a get operation (FALSE) or
+        a set operation (TRUE).
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_BUFFER_TOO_SMALL if not all entries fit. The totals and as many
+    entries as fit are still returned.
+
+    Other status codes on failure.
+
+--*/
+
+KSTATUS
+KepGetSetSpinLockStatistics (
+    PVOID Data,
+    PUINTN DataSize,
+    BOOL Set
+    );
+
+/*++
+
+Routine Description:
+
+    This routine gets spin lock contention statistics, or turns spin lock
+    contention profiling on or off. Turning profiling on clears any previously
+    collected statistics.
+
+Arguments:
+
+    Data - Supplies a pointer to the data buffer where the data is either
+        returned for a get operation or given for a set operation.
+
+    DataSize - Supplies a pointer that on input contains the size of the
+        data buffer. On output, contains the required size of the data buffer.
+
+    Set - Supplies a boolean indicating if this is a get operation (FALSE) or
+        a set operation (TRUE).
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_BUFFER_TOO_SMALL if not all entries fit. The header and as many
+    entries as fit are still returned.
+
+    Other status codes on failure.
+
+--*/
+
@@ -30,6 +30,7 @@ Module Name:
 //
 
 #include <minoca/kernel/kernel.h>
+#include "kep.h"
 
 //
 // ---------------------------------------------------------------- Definitions
@@ -46,10 +47,56 @@ Module Name:
 #define SHARED_EXCLUSIVE_LOCK_EXCLUSIVE ((ULONG)-1)
 #define SHARED_EXCLUSIVE_LOCK_MAX_WAITERS ((ULONG)-2)
 
+//
+// Define queued lock state bits. The lowest bit indicates the lock is held,
+// and the rest of the word counts the waiters.
+//
+
+#define QUEUED_LOCK_HELD 0x00000001
+#define QUEUED_LOCK_WAITER 0x00000002
+
+//
+// Define the maximum number of times to spin waiting for a running owner to
+// release a queued lock before blocking.
+//
+
+#define QUEUED_LOCK_SPIN_MAXIMUM 1000
+
+//
+// Define the number of profile table slots to probe looking for a spin lock
+// before giving up and counting the contention as dropped.
+//
+
+#define SPIN_LOCK_PROFILE_PROBE_COUNT 16
+
 //
 // ----------------------------------------------- Internal Function Prototypes
 //
 
+KSTATUS
+KepAcquireQueuedLockContended (
+    PQUEUED_LOCK Lock,
+    ULONG TimeoutInMilliseconds
+    );
+
+BOOL
+KepSpinOnQueuedLock (
+    PQUEUED_LOCK Lock
+    );
+
+VOID
+KepWaitForSpinLockTicket (
+    PKSPIN_LOCK Lock,
+    ULONG Ticket
+    );
+
+VOID
+KepProfileSpinLockContention (
+    PKSPIN_LOCK Lock,
+    ULONG Waiters,
+    ULONG SpinCount
+    );
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -65,6 +112,17 @@ Module Name:
 
 POBJECT_HEADER KeQueuedLockDirectory = NULL;
 
+//
+// Spin lock contention profiling state. This is off by default, and can be
+// turned on with a system information set request or from the debugger. The
+// entry count is a variable so the debugger can find the table size.
+//
+
+volatile BOOL KeSpinLockProfilingEnabled = FALSE;
+SPIN_LOCK_STATISTICS_ENTRY KeSpinLockProfile[SPIN_LOCK_PROFILE_ENTRY_COUNT];
+ULONG KeSpinLockProfileEntryCount = SPIN_LOCK_PROFILE_ENTRY_COUNT;
+volatile ULONGLONG KeSpinLockProfileDroppedCount;
+
 //
 // ------------------------------------------------------------------ Functions
 //
@@ -108,17 +166,12 @@ Return Value:
                                0,
                                QUEUED_LOCK_TAG);
 
-    NewLock = (PQUEUED_LOCK)NewObject;
-    if (NewLock != NULL) {
-
-        //
-        // Initialize the lock to signal one thread so the first wait acquires
-        // it.
-        //
-
-        ObSignalObject(NewObject, SignalOptionSignalOne);
-    }
+    //
+    // The lock starts out free. The object's wait queue starts out not
+    // signaled, as it is only used to put contending threads to sleep.
+    //
 
+    NewLock = (PQUEUED_LOCK)NewObject;
     return NewLock;
 }
 
@@ -225,12 +278,21 @@ Return Value:
     ASSERT(KeGetRunLevel() <= RunLevelDispatch);
     ASSERT((Lock->OwningThread != Thread) || (Thread == NULL));
 
-    Status = ObWaitOnObject(&(Lock->Header), 0, TimeoutInMilliseconds);
-    if (KSUCCESS(Status)) {
-        Lock->OwningThread = Thread;
+    //
+    // Take the fast path if the lock is free.
+    //
+
+    if (RtlAtomicCompareExchange32(&(Lock->State), QUEUED_LOCK_HELD, 0) != 0) {
+        Status = KepAcquireQueuedLockContended(Lock, TimeoutInMilliseconds);
+        if (!KSUCCESS(Status)) {
+            return Status;
+        }
     }
 
-    return Status;
+    Lock->OwningThread = Thread;
+    Lock->OwningProcessor = KeGetCurrentProcessorNumber();
+    Lock->AcquireCount += 1;
+    return STATUS_SUCCESS;
 }
 
 KERNEL_API
@@ -257,10 +319,23 @@ Return Value:
 
 {
 
+    ULONG OldState;
+
     ASSERT(KeGetRunLevel() <= RunLevelDispatch);
+    ASSERT((Lock->State & QUEUED_LOCK_HELD) != 0);
 
     Lock->OwningThread = NULL;
-    ObSignalObject(&(Lock->Header), SignalOptionSignalOne);
+    OldState = RtlAtomicAnd32(&(Lock->State), ~QUEUED_LOCK_HELD);
+
+    //
+    // Only go to the wait queue if someone is sleeping (or about to sleep) on
+    // it. The woken thread competes for the lock like everyone else.
+    //
+
+    if (OldState != QUEUED_LOCK_HELD) {
+        ObSignalObject(&(Lock->Header), SignalOptionSignalOne);
+    }
+
     return;
 }
 
@@ -289,17 +364,26 @@ Return Value:
 
 {
 
-    KSTATUS Status;
+    ULONG State;
 
     ASSERT(KeGetRunLevel() <= RunLevelDispatch);
 
-    Status = ObWaitOnObject(&(Lock->Header), 0, 0);
-    if (!KSUCCESS(Status)) {
-        return FALSE;
+    State = Lock->State;
+    while ((State & QUEUED_LOCK_HELD) == 0) {
+        if (RtlAtomicCompareExchange32(&(Lock->State),
+                                       State | QUEUED_LOCK_HELD,
+                                       State) == State) {
+
+            Lock->OwningThread = KeGetCurrentThread();
+            Lock->OwningProcessor = KeGetCurrentProcessorNumber();
+            Lock->AcquireCount += 1;
+            return TRUE;
+        }
+
+        State = Lock->State;
     }
 
-    Lock->OwningThread = KeGetCurrentThread();
-    return TRUE;
+    return FALSE;
 }
 
 KERNEL_API
@@ -328,7 +412,7 @@ Return Value:
 
 {
 
-    if (Lock->Header.WaitQueue.State == SignaledForOne) {
+    if ((Lock->State & QUEUED_LOCK_HELD) == 0) {
         return FALSE;
     }
 
@@ -359,7 +443,8 @@ Return Value:
 
 {
 
-    Lock->LockHeld = 0;
+    Lock->NextTicket = 0;
+    Lock->NowServing = 0;
     Lock->OwningThread = NULL;
 
     //
@@ -367,7 +452,7 @@ Return Value:
     // instruction.
     //
 
-    RtlAtomicExchange32(&(Lock->LockHeld), 0);
+    RtlAtomicExchange32(&(Lock->NowServing), 0);
     return;
 }
 
@@ -382,7 +467,8 @@ KeAcquireSpinLock (
 Routine Description:
 
     This routine acquires a kernel spinlock. It must be acquired at or below
-    dispatch level. This routine may yield the processor.
+    dispatch level. This routine may yield the processor. Waiters are granted
+    the lock in the order they arrived.
 
 Arguments:
 
@@ -396,15 +482,11 @@ Return Value:
 
 {
 
-    ULONG LockValue;
-
-    while (TRUE) {
-        LockValue = RtlAtomicCompareExchange32(&(Lock->LockHeld), 1, 0);
-        if (LockValue == 0) {
-            break;
-        }
+    ULONG Ticket;
 
-        ArProcessorYield();
+    Ticket = RtlAtomicAdd32(&(Lock->NextTicket), 1);
+    if (Lock->NowServing != Ticket) {
+        KepWaitForSpinLockTicket(Lock, Ticket);
     }
 
     Lock->OwningThread = KeGetCurrentThread();
@@ -435,22 +517,19 @@ Return Value:
 
 {
 
-    ULONG LockValue;
-
     //
-    // The interlocked version is a serializing instruction, so this avoids
-    // unsafe processor and compiler reordering. Simply setting the lock to
-    // FALSE is not safe.
+    // Assert if the lock was not held.
     //
 
-    LockValue = RtlAtomicExchange32(&(Lock->LockHeld), 0);
+    ASSERT(Lock->NowServing != Lock->NextTicket);
 
     //
-    // Assert if the lock was not held.
+    // The interlocked version is a serializing instruction, so this avoids
+    // unsafe processor and compiler reordering. Only the holder ever changes
+    // the now serving value, but a plain increment is not safe.
     //
 
-    ASSERT(LockValue != 0);
-
+    RtlAtomicAdd32(&(Lock->NowServing), 1);
     return;
 }
 
@@ -480,10 +559,17 @@ Return Value:
 
 {
 
-    ULONG LockValue;
+    ULONG NowServing;
+
+    //
+    // Only take a ticket if it would be served immediately.
+    //
+
+    NowServing = Lock->NowServing;
+    if (RtlAtomicCompareExchange32(&(Lock->NextTicket),
+                                   NowServing + 1,
+                                   NowServing) == NowServing) {
 
-    LockValue = RtlAtomicCompareExchange32(&(Lock->LockHeld), 1, 0);
-    if (LockValue == 0) {
         Lock->OwningThread = KeGetCurrentThread();
         return TRUE;
     }
@@ -517,10 +603,10 @@ Return Value:
 
 {
 
-    ULONG Held;
+    ULONG NowServing;
 
-    Held = RtlAtomicOr32(&(Lock->LockHeld), 0);
-    if (Held != 0) {
+    NowServing = RtlAtomicOr32(&(Lock->NowServing), 0);
+    if (NowServing != Lock->NextTicket) {
         return TRUE;
     }
 
@@ -1205,7 +1291,632 @@ Return Value:
     return FALSE;
 }
 
+KSTATUS
+KepGetQueuedLockStatistics (
+    PVOID Data,
+    PUINTN DataSize,
+    BOOL Set
+    )
+
+/*++
+
+Routine Description:
+
+    This routine gets contention statistics for all queued locks in the
+    system. Only locks that have been contended get an entry.
+
+Arguments:
+
+    Data - Supplies a pointer to the data buffer where the data is either
+        returned for a get operation or given for a set operation.
+
+    DataSize - Supplies a pointer that on input contains the size of the
+        data buffer. On output, contains the required size of the data buffer.
+
+    Set - Supplies a boolean indicating if this is a get operation (FALSE) or
+        a set operation (TRUE).
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_BUFFER_TOO_SMALL if not all entries fit. The totals and as many
+    entries as fit are still returned.
+
+    Other status codes on failure.
+
+--*/
+
+{
+
+    UINTN Capacity;
+    PLIST_ENTRY CurrentEntry;
+    POBJECT_HEADER Directory;
+    PQUEUED_LOCK_STATISTICS_ENTRY Entries;
+    PQUEUED_LOCK_STATISTICS_ENTRY Entry;
+    UINTN EntryCount;
+    PQUEUED_LOCK Lock;
+    ULONG LockCount;
+    POBJECT_HEADER Object;
+    RUNLEVEL OldRunLevel;
+    UINTN RequiredSize;
+    PQUEUED_LOCK_STATISTICS Statistics;
+    KSTATUS Status;
+
+    if (Set != FALSE) {
+        return STATUS_ACCESS_DENIED;
+    }
+
+    Status = PsCheckPermission(PERMISSION_RESOURCES);
+    if (!KSUCCESS(Status)) {
+        return Status;
+    }
+
+    if (*DataSize < sizeof(QUEUED_LOCK_STATISTICS)) {
+        *DataSize = sizeof(QUEUED_LOCK_STATISTICS);
+        return STATUS_BUFFER_TOO_SMALL;
+    }
+
+    Statistics = Data;
+    if (Statistics->Version < QUEUED_LOCK_STATISTICS_VERSION) {
+        return STATUS_VERSION_MISMATCH;
+    }
+
+    Directory = KeQueuedLockDirectory;
+    if (Directory == NULL) {
+        return STATUS_NOT_READY;
+    }
+
+    //
+    // The caller's buffer may be pageable, so gather the entries into a
+    // non-paged buffer while the directory is locked.
+    //
+
+    Capacity = (*DataSize - sizeof(QUEUED_LOCK_STATISTICS)) /
+               sizeof(QUEUED_LOCK_STATISTICS_ENTRY);
+
+    Entries = NULL;
+    if (Capacity != 0) {
+        Entries = MmAllocateNonPagedPool(
+                                Capacity * sizeof(QUEUED_LOCK_STATISTICS_ENTRY),
+                                KE_INFORMATION_ALLOCATION_TAG);
+
+        if (Entries == NULL) {
+            return STATUS_INSUFFICIENT_RESOURCES;
+        }
+    }
+
+    Statistics->LockCount = 0;
+    Statistics->EntryCount = 0;
+    Statistics->TimeCounterFrequency = HlQueryTimeCounterFrequency();
+    Statistics->AcquireCount = 0;
+    Statistics->ContendedCount = 0;
+    Statistics->SpinAcquireCount = 0;
+    Statistics->WaitTime = 0;
+    EntryCount = 0;
+    LockCount = 0;
+    OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+    KeAcquireSpinLock(&(Directory->WaitQueue.Lock));
+    CurrentEntry = Directory->ChildListHead.Next;
+    while (CurrentEntry != &(Directory->ChildListHead)) {
+        Object = LIST_VALUE(CurrentEntry, OBJECT_HEADER, SiblingEntry);
+        CurrentEntry = CurrentEntry->Next;
+        if (Object->Type != ObjectQueuedLock) {
+            continue;
+        }
+
+        Lock = (PQUEUED_LOCK)Object;
+        LockCount += 1;
+        Statistics->AcquireCount += Lock->AcquireCount;
+        if (Lock->ContendedCount == 0) {
+            continue;
+        }
+
+        Statistics->ContendedCount += Lock->ContendedCount;
+        Statistics->SpinAcquireCount += Lock->SpinAcquireCount;
+        Statistics->WaitTime += Lock->WaitTime;
+        if (EntryCount < Capacity) {
+            Entry = &(Entries[EntryCount]);
+            Entry->Lock = (UINTN)Lock;
+            Entry->AcquireCount = Lock->AcquireCount;
+            Entry->ContendedCount = Lock->ContendedCount;
+            Entry->SpinAcquireCount = Lock->SpinAcquireCount;
+            Entry->WaitTime = Lock->WaitTime;
+        }
+
+        EntryCount += 1;
+    }
+
+    KeReleaseSpinLock(&(Directory->WaitQueue.Lock));
+    KeLowerRunLevel(OldRunLevel);
+    Statistics->LockCount = LockCount;
+    RequiredSize = sizeof(QUEUED_LOCK_STATISTICS) +
+                   (EntryCount * sizeof(QUEUED_LOCK_STATISTICS_ENTRY));
+
+    if (EntryCount > Capacity) {
+        EntryCount = Capacity;
+        Status = STATUS_BUFFER_TOO_SMALL;
+    }
+
+    Statistics->EntryCount = EntryCount;
+    if (EntryCount != 0) {
+        RtlCopyMemory(Statistics + 1,
+                      Entries,
+                      EntryCount * sizeof(QUEUED_LOCK_STATISTICS_ENTRY));
+    }
+
+    if (Entries != NULL) {
+        MmFreeNonPagedPool(Entries);
+    }
+
+    *DataSize = RequiredSize;
+    return Status;
+}
+
+KSTATUS
+KepGetSetSpinLockStatistics (
+    PVOID Data,
+    PUINTN DataSize,
+    BOOL Set
+    )
+
+/*++
+
+Routine Description:
+
+    This routine gets spin lock contention statistics, or turns spin lock
+    contention profiling on or off. Turning profiling on clears any previously
+    collected statistics.
+
+Arguments:
+
+    Data - Supplies a pointer to the data buffer where the data is either
+        returned for a get operation or given for a set operation.
+
+    DataSize - Supplies a pointer that on input contains the size of the
+        data buffer. On output, contains the required size of the data buffer.
+
+    Set - Supplies a boolean indicating if this is a get operation (FALSE) or
+        a set operation (TRUE).
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_BUFFER_TOO_SMALL if not all entries fit. The header and as many
+    entries as fit are still returned.
+
+    Other status codes on failure.
+
+--*/
+
+{
+
+    UINTN Capacity;
+    PSPIN_LOCK_STATISTICS_ENTRY Entries;
+    PSPIN_LOCK_STATISTICS_ENTRY Entry;
+    UINTN EntryCount;
+    ULONG Index;
+    PSPIN_LOCK_STATISTICS Statistics;
+    KSTATUS Status;
+
+    Status = PsCheckPermission(PERMISSION_RESOURCES);
+    if (!KSUCCESS(Status)) {
+        return Status;
+    }
+
+    if (*DataSize < sizeof(SPIN_LOCK_STATISTICS)) {
+        *DataSize = sizeof(SPIN_LOCK_STATISTICS);
+        return STATUS_BUFFER_TOO_SMALL;
+    }
+
+    Statistics = Data;
+    if (Statistics->Version < SPIN_LOCK_STATISTICS_VERSION) {
+        return STATUS_VERSION_MISMATCH;
+    }
+
+    if (Set != FALSE) {
+        *DataSize = sizeof(SPIN_LOCK_STATISTICS);
+        if (Statistics->Enabled == FALSE) {
+            KeSpinLockProfilingEnabled = FALSE;
+            return STATUS_SUCCESS;
+        }
+
+        //
+        // Clear the table before turning profiling on. Contention recorded
+        // by processors still finishing up from a previous session may leak
+        // into the new one, which is harmless.
+        //
+
+        KeSpinLockProfilingEnabled = FALSE;
+        RtlZeroMemory((PVOID)KeSpinLockProfile, sizeof(KeSpinLockProfile));
+        KeSpinLockProfileDroppedCount = 0;
+        RtlMemoryBarrier();
+        KeSpinLockProfilingEnabled = TRUE;
+        return STATUS_SUCCESS;
+    }
+
+    //
+    // The profile table lives in non-paged memory and is only ever updated
+    // atomically, so it can be copied out without any locks held.
+    //
+
+    Capacity = (*DataSize - sizeof(SPIN_LOCK_STATISTICS)) /
+               sizeof(SPIN_LOCK_STATISTICS_ENTRY);
+
+    Entries = (PSPIN_LOCK_STATISTICS_ENTRY)(Statistics + 1);
+    EntryCount = 0;
+    for (Index = 0; Index < SPIN_LOCK_PROFILE_ENTRY_COUNT; Index += 1) {
+        if (KeSpinLockProfile[Index].Lock == 0) {
+            continue;
+        }
+
+        if (EntryCount < Capacity) {
+            Entry = &(Entries[EntryCount]);
+            Entry->Lock = KeSpinLockProfile[Index].Lock;
+            Entry->ContendedCount = KeSpinLockProfile[Index].ContendedCount;
+            Entry->SpinCount = KeSpinLockProfile[Index].SpinCount;
+            Entry->MaximumWaiters = KeSpinLockProfile[Index].MaximumWaiters;
+        }
+
+        EntryCount += 1;
+    }
+
+    Statistics->Enabled = KeSpinLockProfilingEnabled;
+    Statistics->DroppedCount = KeSpinLockProfileDroppedCount;
+    *DataSize = sizeof(SPIN_LOCK_STATISTICS) +
+                (EntryCount * sizeof(SPIN_LOCK_STATISTICS_ENTRY));
+
+    if (EntryCount > Capacity) {
+        EntryCount = Capacity;
+        Status = STATUS_BUFFER_TOO_SMALL;
+    }
+
+    Statistics->EntryCount = EntryCount;
+    return Status;
+}
+
 //
 // --------------------------------------------------------- Internal Functions
 //
 
+KSTATUS
+KepAcquireQueuedLockContended (
+    PQUEUED_LOCK Lock,
+    ULONG TimeoutInMilliseconds
+    )
+
+/*++
+
+Routine Description:
+
+    This routine acquires a queued lock that was found to be held. It spins
+    for a bit if the owner is running on another processor, and otherwise
+    blocks on the lock's wait queue.
+
+Arguments:
+
+    Lock - Supplies a pointer to the queued lock to acquire.
+
+    TimeoutInMilliseconds - Supplies the number of milliseconds to wait for the
+        lock before timing out, or WAIT_TIME_INDEFINITE to wait forever.
+
+Return Value:
+
+    STATUS_SUCCESS on success. The caller is responsible for setting the
+    owner and bumping the acquire count.
+
+    STATUS_TIMEOUT if the specified amount of time expired and the lock could
+    not be acquired.
+
+--*/
+
+{
+
+    ULONGLONG CurrentTime;
+    ULONGLONG EndTime;
+    ULONG NewState;
+    ULONGLONG StartTime;
+    ULONG State;
+    KSTATUS Status;
+    ULONG Timeout;
+
+    StartTime = HlQueryTimeCounter();
+    if ((TimeoutInMilliseconds != 0) && (KepSpinOnQueuedLock(Lock) != FALSE)) {
+        Lock->SpinAcquireCount += 1;
+        Status = STATUS_SUCCESS;
+        goto AcquireQueuedLockContendedEnd;
+    }
+
+    EndTime = 0;
+    if ((TimeoutInMilliseconds != 0) &&
+        (TimeoutInMilliseconds != WAIT_TIME_INDEFINITE)) {
+
+        EndTime = StartTime +
+                  KeConvertMicrosecondsToTimeTicks(
+                         TimeoutInMilliseconds * MICROSECONDS_PER_MILLISECOND);
+    }
+
+    //
+    // Register as a waiter so that the releasing thread knows to signal the
+    // wait queue. Then loop trying to grab the lock, and sleeping if it's
+    // still held. A release between the attempt and the wait leaves the
+    // queue signaled, so the wakeup is never lost.
+    //
+
+    Timeout = TimeoutInMilliseconds;
+    RtlAtomicAdd32(&(Lock->State), QUEUED_LOCK_WAITER);
+    while (TRUE) {
+        State = Lock->State;
+        if ((State & QUEUED_LOCK_HELD) == 0) {
+            NewState = (State - QUEUED_LOCK_WAITER) | QUEUED_LOCK_HELD;
+            if (RtlAtomicCompareExchange32(&(Lock->State),
+                                           NewState,
+                                           State) == State) {
+
+                Status = STATUS_SUCCESS;
+                break;
+            }
+
+            continue;
+        }
+
+        if (Timeout == 0) {
+            Status = STATUS_TIMEOUT;
+
+        } else {
+            Status = ObWaitOnObject(&(Lock->Header), 0, Timeout);
+        }
+
+        //
+        // On timeout, stop waiting. If a release signaled the queue in the
+        // meantime, the next waiter will consume that and retry.
+        //
+
+        if (!KSUCCESS(Status)) {
+            RtlAtomicAdd32(&(Lock->State), (ULONG)-QUEUED_LOCK_WAITER);
+            return Status;
+        }
+
+        if (EndTime != 0) {
+            CurrentTime = HlQueryTimeCounter();
+            if (CurrentTime >= EndTime) {
+                Timeout = 0;
+
+            } else {
+                Timeout = ((EndTime - CurrentTime) * MILLISECONDS_PER_SECOND) /
+                          HlQueryTimeCounterFrequency();
+
+                if (Timeout == 0) {
+                    Timeout = 1;
+                }
+            }
+        }
+    }
+
+AcquireQueuedLockContendedEnd:
+    Lock->ContendedCount += 1;
+    Lock->WaitTime += HlQueryTimeCounter() - StartTime;
+    return Status;
+}
+
+BOOL
+KepSpinOnQueuedLock (
+    PQUEUED_LOCK Lock
+    )
+
+/*++
+
+Routine Description:
+
+    This routine spins trying to acquire a queued lock for as long as the lock
+    owner is running on another processor, up to a limit. Spinning while the
+    owner is not running would be wasted time, since it cannot release the
+    lock until it gets scheduled again.
+
+Arguments:
+
+    Lock - Supplies a pointer to the queued lock to acquire.
+
+Return Value:
+
+    TRUE if the lock was acquired.
+
+    FALSE if the caller should block.
+
+--*/
+
+{
+
+    PKTHREAD Owner;
+    ULONG OwnerProcessor;
+    ULONG Spin;
+    ULONG State;
+
+    if (KeGetActiveProcessorCount() == 1) {
+        return FALSE;
+    }
+
+    for (Spin = 0; Spin < QUEUED_LOCK_SPIN_MAXIMUM; Spin += 1) {
+        State = Lock->State;
+        if ((State & QUEUED_LOCK_HELD) == 0) {
+            if (RtlAtomicCompareExchange32(&(Lock->State),
+                                           State | QUEUED_LOCK_HELD,
+                                           State) == State) {
+
+                return TRUE;
+            }
+
+            continue;
+        }
+
+        //
+        // Stop spinning if the owner is no longer running where it acquired
+        // the lock. The owner is only ever compared, never dereferenced, as
+        // it may exit at any time. A NULL owner means the lock is in the
+        // middle of changing hands.
+        //
+
+        Owner = Lock->OwningThread;
+        OwnerProcessor = Lock->OwningProcessor;
+        if ((Owner != NULL) &&
+            ((OwnerProcessor >= KeGetActiveProcessorCount()) ||
+             (KeProcessorBlocks[OwnerProcessor]->RunningThread != Owner))) {
+
+            break;
+        }
+
+        //
+        // Waiters are blocked, so barging in ahead of them by spinning would
+        // be unfair. Join the queue instead.
+        //
+
+        if ((State & ~QUEUED_LOCK_HELD) != 0) {
+            break;
+        }
+
+        ArProcessorYield();
+    }
+
+    return FALSE;
+}
+
+VOID
+KepWaitForSpinLockTicket (
+    PKSPIN_LOCK Lock,
+    ULONG Ticket
+    )
+
+/*++
+
+Routine Description:
+
+    This routine waits for the given ticket to be served on a contended spin
+    lock. Processors further back in line back off proportionally longer
+    between polls, which keeps traffic on the lock's cache line down.
+
+Arguments:
+
+    Lock - Supplies a pointer to the lock being acquired.
+
+    Ticket - Supplies the ticket the caller drew.
+
+Return Value:
+
+    None. The lock is held on return.
+
+--*/
+
+{
+
+    ULONG Delay;
+    ULONG NowServing;
+    ULONG SpinCount;
+    ULONG Waiters;
+
+    SpinCount = 0;
+    Waiters = Ticket - Lock->NowServing;
+    while (TRUE) {
+        NowServing = Lock->NowServing;
+        if (NowServing == Ticket) {
+            break;
+        }
+
+        Delay = Ticket - NowServing;
+        while (Delay != 0) {
+            ArProcessorYield();
+            Delay -= 1;
+        }
+
+        SpinCount += 1;
+    }
+
+    //
+    // Make sure nothing from the critical section gets hoisted above the
+    // acquire.
+    //
+
+    RtlMemoryBarrier();
+    if (KeSpinLockProfilingEnabled != FALSE) {
+        KepProfileSpinLockContention(Lock, Waiters, SpinCount);
+    }
+
+    return;
+}
+
+VOID
+KepProfileSpinLockContention (
+    PKSPIN_LOCK Lock,
+    ULONG Waiters,
+    ULONG SpinCount
+    )
+
+/*++
+
+Routine Description:
+
+    This routine records a contended spin lock acquire in the profile table.
+    The table is keyed by lock address and updated with atomics only, since
+    this may run at any run level, including from inside the lock code of
+    other profiling paths.
+
+Arguments:
+
+    Lock - Supplies a pointer to the contended lock.
+
+    Waiters - Supplies the number of processors that were ahead in line when
+        the caller arrived.
+
+    SpinCount - Supplies the number of times the caller polled the lock.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PSPIN_LOCK_STATISTICS_ENTRY Entry;
+    ULONG Index;
+    ULONGLONG Key;
+    ULONG Maximum;
+    ULONG Probe;
+
+    Key = (UINTN)Lock;
+    Index = (ULONG)(Key >> 3) % SPIN_LOCK_PROFILE_ENTRY_COUNT;
+    Entry = NULL;
+    for (Probe = 0; Probe < SPIN_LOCK_PROFILE_PROBE_COUNT; Probe += 1) {
+        Entry = &(KeSpinLockProfile[Index]);
+        if (Entry->Lock == Key) {
+            break;
+        }
+
+        if ((Entry->Lock == 0) &&
+            ((RtlAtomicCompareExchange64(&(Entry->Lock), Key, 0) == 0) ||
+             (Entry->Lock == Key))) {
+
+            break;
+        }
+
+        Entry = NULL;
+        Index = (Index + 1) % SPIN_LOCK_PROFILE_ENTRY_COUNT;
+    }
+
+    if (Entry == NULL) {
+        RtlAtomicAdd64(&KeSpinLockProfileDroppedCount, 1);
+        return;
+    }
+
+    RtlAtomicAdd64(&(Entry->ContendedCount), 1);
+    RtlAtomicAdd64(&(Entry->SpinCount), SpinCount);
+    Maximum = Entry->MaximumWaiters;
+    while (Waiters > Maximum) {
+        Maximum = RtlAtomicCompareExchange32(&(Entry->MaximumWaiters),
+                                             Waiters,
+                                             Maximum);
+    }
+
+    return;
+}
+
@@ -43,6 +43,71 @@ Module Name:
 
 #define SCHEDULER_REBALANCE_MINIMUM_THREADS 2
 
+//
+// Define the fixed point shift of the per-processor load average, and the
+// divisor applied to each new sample. A larger divisor smooths out bursts.
+//
+
+#define SCHEDULER_LOAD_SHIFT 10
+#define SCHEDULER_LOAD_DECAY 4
+
+//
+// Define how many clock interrupts go by between periodic load balances.
+//
+
+#define SCHEDULER_BALANCE_INTERVAL 4
+
+//
+// Define the maximum number of threads moved in a single load balance.
+//
+
+#define SCHEDULER_BALANCE_BATCH_MAXIMUM 8
+
+//
+// Define how much busier, in fixed point threads, a processor must be before
+// threads are moved away from it periodically. Moving threads to another
+// domain loses their cache contents, so a larger imbalance is required.
+//
+
+#define SCHEDULER_IMBALANCE_THRESHOLD (1 << SCHEDULER_LOAD_SHIFT)
+#define SCHEDULER_DOMAIN_IMBALANCE_THRESHOLD (2 << SCHEDULER_LOAD_SHIFT)
+
+//
+// Define the weight of a scheduler entry with the default nice value. Virtual
+// runtime advances at real time for entries of this weight, faster for
+// lighter entries, and slower for heavier ones.
+//
+
+#define SCHEDULER_WEIGHT_DEFAULT 1024
+
+//
+// Define the target scheduling latency and the wakeup granularity, in
+// microseconds. A waking thread is credited with up to half the latency so
+// that it runs ahead of CPU-bound threads, and preempts the running thread
+// if it is ahead by more than the granularity.
+//
+
+#define SCHEDULER_LATENCY_MICROSECONDS 6000
+#define SCHEDULER_WAKEUP_GRANULARITY_MICROSECONDS 1000
+
+//
+// Define flags passed when enqueuing a scheduler entry.
+//
+
+//
+// This flag is set if the entry is being enqueued because it woke up or is
+// running for the first time.
+//
+
+#define SCHEDULER_ENQUEUE_WAKEUP 0x00000001
+
+//
+// This flag is set if the entry's virtual runtime was made relative to its
+// previous group entry, and should be rebased onto the new group entry.
+//
+
+#define SCHEDULER_ENQUEUE_MIGRATING 0x00000002
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -56,15 +121,57 @@ KepIdle (
     PPROCESSOR_BLOCK Processor
     );
 
+PPROCESSOR_BLOCK
+KepFindBusiestProcessor (
+    PPROCESSOR_BLOCK Current,
+    ULONG LocalLoad,
+    BOOL Idle
+    );
+
+PPROCESSOR_BLOCK
+KepFindIdlestProcessor (
+    PPROCESSOR_BLOCK Current,
+    ULONG LocalLoad
+    );
+
+ULONG
+KepMigrateThreads (
+    PPROCESSOR_BLOCK Source,
+    PPROCESSOR_BLOCK Destination,
+    ULONG Count
+    );
+
+ULONG
+KepGetSchedulerLoad (
+    PSCHEDULER_DATA Scheduler
+    );
+
+PPROCESSOR_BLOCK
+KepSelectAffinityProcessor (
+    PKTHREAD Thread
+    );
+
+PSCHEDULER_GROUP_ENTRY
+KepGetDestinationGroupEntry (
+    PSCHEDULER_GROUP_ENTRY Source,
+    PPROCESSOR_BLOCK Destination
+    );
+
+PSCHEDULER_GROUP_ENTRY
+KepAcquireThreadScheduler (
+    PKTHREAD Thread
+    );
+
 VOID
-KepBalanceIdleScheduler (
-    VOID
+KepPokeProcessor (
+    PPROCESSOR_BLOCK Processor
     );
 
 BOOL
 KepEnqueueSchedulerEntry (
     PSCHEDULER_ENTRY Entry,
-    BOOL LockHeld
+    BOOL LockHeld,
+    ULONG Flags
     );
 
 VOID
@@ -76,7 +183,43 @@ KepDequeueSchedulerEntry (
 PKTHREAD
 KepGetNextThread (
     PSCHEDULER_DATA Scheduler,
-    BOOL SkipRunning
+    BOOL SkipRunning,
+    ULONG ProcessorNumber
+    );
+
+VOID
+KepChargeSchedulerEntry (
+    PSCHEDULER_ENTRY Entry,
+    ULONGLONG CurrentTime
+    );
+
+VOID
+KepRequeueSchedulerEntry (
+    PSCHEDULER_GROUP_ENTRY GroupEntry,
+    PSCHEDULER_ENTRY Entry
+    );
+
+VOID
+KepUpdateMinimumRuntime (
+    PSCHEDULER_GROUP_ENTRY GroupEntry
+    );
+
+BOOL
+KepShouldPreempt (
+    PSCHEDULER_DATA Scheduler,
+    PSCHEDULER_ENTRY Entry
+    );
+
+VOID
+KepInitializeSchedulerTunables (
+    VOID
+    );
+
+COMPARISON_RESULT
+KepCompareSchedulerEntries (
+    PRED_BLACK_TREE Tree,
+    PRED_BLACK_TREE_NODE FirstNode,
+    PRED_BLACK_TREE_NODE SecondNode
     );
 
 KSTATUS
@@ -111,6 +254,30 @@ KSPIN_LOCK KeSchedulerGroupLock;
 
 BOOL KeSchedulerStealReadyThreads = FALSE;
 
+//
+// Store the wakeup credit and wakeup granularity, in processor counter ticks.
+// These are computed once the processor counter frequency is known.
+//
+
+ULONGLONG KeSchedulerWakeupCredit;
+ULONGLONG KeSchedulerWakeupGranularity;
+
+//
+// Store the table converting nice values to scheduling weights. Each step in
+// nice value changes the share of the processor by roughly ten percent.
+//
+
+const ULONG KeSchedulerNiceWeights[] = {
+    88761, 71755, 56483, 46273, 36291,
+    29154, 23254, 18705, 14949, 11916,
+    9548, 7620, 6100, 4904, 3906,
+    3121, 2501, 1991, 1586, 1277,
+    1024, 820, 655, 526, 423,
+    335, 272, 215, 172, 137,
+    110, 87, 70, 56, 45,
+    36, 29, 23, 18, 15
+};
+
 //
 // ------------------------------------------------------------------ Functions
 //
@@ -174,8 +341,12 @@ Return Value:
 
 {
 
+    ULONGLONG CurrentTime;
     BOOL Enabled;
     BOOL FirstTime;
+    PSCHEDULER_GROUP_ENTRY GroupEntry;
+    PRED_BLACK_TREE_NODE NextNode;
+    PSCHEDULER_ENTRY Sibling;
     PKTHREAD NextThread;
     PVOID NextThreadStack;
     THREAD_STATE NextThreadState;
@@ -208,28 +379,61 @@ Return Value:
 
     OldThread = Processor->RunningThread;
     KeAcquireSpinLock(&(Processor->Scheduler.Lock));
+    CurrentTime = HlQueryProcessorCounter();
 
     //
-    // Remove the old thread from the scheduler. Immediately put it back if
-    // it's not blocking.
+    // Charge the old thread and its groups for the time it just ran, which
+    // moves it back in the run queue. Remove it from the scheduler entirely if
+    // it's blocking.
     //
 
     if (OldThread != Processor->IdleThread) {
-        KepDequeueSchedulerEntry(&(OldThread->SchedulerEntry), TRUE);
-        if ((Reason != SchedulerReasonThreadBlocking) &&
-            (Reason != SchedulerReasonThreadSuspending) &&
-            (Reason != SchedulerReasonThreadExiting)) {
+        KepChargeSchedulerEntry(&(OldThread->SchedulerEntry), CurrentTime);
+        if ((Reason == SchedulerReasonThreadBlocking) ||
+            (Reason == SchedulerReasonThreadSuspending) ||
+            (Reason == SchedulerReasonThreadExiting)) {
+
+            KepDequeueSchedulerEntry(&(OldThread->SchedulerEntry), TRUE);
+
+        //
+        // A yielding thread goes behind its next sibling, so that it does not
+        // immediately get picked again just because it is furthest behind.
+        //
+
+        } else if (Reason == SchedulerReasonThreadYielding) {
+            GroupEntry = PARENT_STRUCTURE(OldThread->SchedulerEntry.Parent,
+                                          SCHEDULER_GROUP_ENTRY,
+                                          Entry);
+
+            NextNode = RtlRedBlackTreeGetNextNode(
+                                       &(GroupEntry->Children),
+                                       FALSE,
+                                       &(OldThread->SchedulerEntry.TreeNode));
+
+            if (NextNode != NULL) {
+                Sibling = RED_BLACK_TREE_VALUE(NextNode,
+                                               SCHEDULER_ENTRY,
+                                               TreeNode);
+
+                OldThread->SchedulerEntry.VirtualRuntime =
+                                                       Sibling->VirtualRuntime;
 
-            KepEnqueueSchedulerEntry(&(OldThread->SchedulerEntry), TRUE);
+                KepRequeueSchedulerEntry(GroupEntry,
+                                         &(OldThread->SchedulerEntry));
+            }
         }
     }
 
     //
     // Now that the old thread has accounted for its time, get the next thread
-    // to run. This might be the old thread again.
+    // to run. This might be the old thread again, unless its affinity no
+    // longer allows it on this processor. In that case it is moved once it
+    // has been switched out.
     //
 
-    NextThread = KepGetNextThread(&(Processor->Scheduler), FALSE);
+    NextThread = KepGetNextThread(&(Processor->Scheduler),
+                                  FALSE,
+                                  Processor->ProcessorNumber);
 
     //
     // If there are no threads to run, run the idle thread.
@@ -237,6 +441,7 @@ Return Value:
 
     if (NextThread == NULL) {
         NextThread = Processor->IdleThread;
+        Processor->Scheduler.RunningEntry = NULL;
 
         //
         // This had better not be the idle thread blocking.
@@ -246,6 +451,10 @@ Return Value:
                ((Reason != SchedulerReasonThreadBlocking) &&
                 (Reason != SchedulerReasonThreadSuspending) &&
                 (Reason != SchedulerReasonThreadExiting)));
+
+    } else {
+        NextThread->SchedulerEntry.RunStart = CurrentTime;
+        Processor->Scheduler.RunningEntry = &(NextThread->SchedulerEntry);
     }
 
     //
@@ -456,11 +665,12 @@ Return Value:
 
 {
 
-    BOOL FirstThread;
-    PSCHEDULER_GROUP Group;
+    PPROCESSOR_BLOCK CurrentProcessor;
+    PPROCESSOR_BLOCK Destination;
     PSCHEDULER_GROUP_ENTRY GroupEntry;
     PSCHEDULER_GROUP_ENTRY NewGroupEntry;
     RUNLEVEL OldRunLevel;
+    BOOL Preempt;
     PPROCESSOR_BLOCK ProcessorBlock;
 
     ASSERT((Thread->State == ThreadStateWaking) ||
@@ -481,24 +691,48 @@ Return Value:
     //
     // If the configuration option is set, steal the thread to run on the
     // current processor. This is bad for cache locality, but doesn't need an
-    // IPI.
+    // IPI. Otherwise the thread goes back to the processor it was previously
+    // on, unless its affinity no longer allows that.
     //
 
+    ProcessorBlock = PARENT_STRUCTURE(GroupEntry->Scheduler,
+                                      PROCESSOR_BLOCK,
+                                      Scheduler);
+
+    Destination = NULL;
     if (KeSchedulerStealReadyThreads != FALSE) {
-        ProcessorBlock = KeGetCurrentProcessorBlock();
-        Group = GroupEntry->Group;
-        if (Group == &KeRootSchedulerGroup) {
-            NewGroupEntry = &(ProcessorBlock->Scheduler.Group);
+        CurrentProcessor = KeGetCurrentProcessorBlock();
+        if (PROCESSOR_AFFINITY_CONTAINS(&(Thread->Affinity),
+                                        CurrentProcessor->ProcessorNumber)) {
 
-        } else {
+            Destination = CurrentProcessor;
+        }
+    }
 
-            ASSERT(Group->EntryCount > ProcessorBlock->ProcessorNumber);
+    if ((Destination == NULL) &&
+        (!PROCESSOR_AFFINITY_CONTAINS(&(Thread->Affinity),
+                                      ProcessorBlock->ProcessorNumber))) {
 
-            NewGroupEntry = &(Group->Entries[ProcessorBlock->ProcessorNumber]);
-        }
+        Destination = KepSelectAffinityProcessor(Thread);
+    }
+
+    if ((Destination != NULL) && (Destination != ProcessorBlock)) {
+        NewGroupEntry = KepGetDestinationGroupEntry(GroupEntry, Destination);
+
+        //
+        // Make the virtual runtime relative to the old group entry so it can
+        // be rebased onto the new one. The minimum is read without the old
+        // scheduler's lock, which is fine since it is only a placement hint.
+        //
 
+        Thread->SchedulerEntry.VirtualRuntime -= GroupEntry->MinimumRuntime;
         Thread->SchedulerEntry.Parent = &(NewGroupEntry->Entry);
-        KepEnqueueSchedulerEntry(&(Thread->SchedulerEntry), FALSE);
+        Preempt = KepEnqueueSchedulerEntry(&(Thread->SchedulerEntry),
+                                           FALSE,
+                                           (SCHEDULER_ENQUEUE_WAKEUP |
+                                            SCHEDULER_ENQUEUE_MIGRATING));
+
+        ProcessorBlock = Destination;
 
     //
     // Enqueue the thread on the processor it was previously on. This may
@@ -506,21 +740,21 @@ Return Value:
     //
 
     } else {
-        FirstThread = KepEnqueueSchedulerEntry(&(Thread->SchedulerEntry),
-                                               FALSE);
-
-        //
-        // If this is the first thread being scheduled on the processor, then
-        // make sure the clock is running (or wake it up).
-        //
+        Preempt = KepEnqueueSchedulerEntry(&(Thread->SchedulerEntry),
+                                           FALSE,
+                                           SCHEDULER_ENQUEUE_WAKEUP);
+    }
 
-        if (FirstThread != FALSE) {
-            ProcessorBlock = PARENT_STRUCTURE(GroupEntry->Scheduler,
-                                              PROCESSOR_BLOCK,
-                                              Scheduler);
+    //
+    // If this is the first thread being scheduled on the processor, then make
+    // sure the clock is running (or wake it up). If the woken thread should
+    // preempt what's running, also poke the processor so that it reschedules.
+    // A remote processor gets a clock interrupt, which always runs the
+    // scheduler on its way out.
+    //
 
-            KepSetClockToPeriodic(ProcessorBlock);
-        }
+    if (Preempt != FALSE) {
+        KepPokeProcessor(ProcessorBlock);
     }
 
     KeLowerRunLevel(OldRunLevel);
@@ -559,6 +793,139 @@ Return Value:
     return;
 }
 
+VOID
+KeSetThreadNiceValue (
+    PKTHREAD Thread,
+    LONG NiceValue
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sets the nice value of the given thread, which determines its
+    scheduling weight relative to other threads. The new weight takes effect
+    the next time the thread's run time is charged.
+
+Arguments:
+
+    Thread - Supplies a pointer to the thread to modify.
+
+    NiceValue - Supplies the new nice value, between SCHEDULER_NICE_MINIMUM
+        and SCHEDULER_NICE_MAXIMUM. Values outside this range are clipped.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    if (NiceValue < SCHEDULER_NICE_MINIMUM) {
+        NiceValue = SCHEDULER_NICE_MINIMUM;
+
+    } else if (NiceValue > SCHEDULER_NICE_MAXIMUM) {
+        NiceValue = SCHEDULER_NICE_MAXIMUM;
+    }
+
+    //
+    // The weight is only read under the scheduler lock when charging the
+    // thread, and a single aligned write is atomic, so no lock is needed here.
+    //
+
+    Thread->SchedulerEntry.NiceValue = NiceValue;
+    Thread->SchedulerEntry.Weight =
+                   KeSchedulerNiceWeights[NiceValue - SCHEDULER_NICE_MINIMUM];
+
+    return;
+}
+
+KERNEL_API
+KSTATUS
+KeSetThreadAffinity (
+    PKTHREAD Thread,
+    PPROCESSOR_AFFINITY Affinity
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sets the set of processors the given thread is allowed to
+    run on. If the thread is currently queued or running on a processor that
+    is no longer allowed, it is moved. This routine must be called at or
+    below dispatch level.
+
+Arguments:
+
+    Thread - Supplies a pointer to the thread to modify.
+
+    Affinity - Supplies a pointer to the new processor affinity mask.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_INVALID_PARAMETER if the mask does not contain any active
+    processors.
+
+--*/
+
+{
+
+    BOOL Allowed;
+    ULONG Count;
+    PSCHEDULER_GROUP_ENTRY GroupEntry;
+    ULONG Number;
+    RUNLEVEL OldRunLevel;
+    PPROCESSOR_BLOCK ProcessorBlock;
+    THREAD_STATE State;
+
+    Count = KeGetActiveProcessorCount();
+    for (Number = 0; Number < Count; Number += 1) {
+        if (PROCESSOR_AFFINITY_CONTAINS(Affinity, Number)) {
+            break;
+        }
+    }
+
+    if (Number == Count) {
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+    GroupEntry = KepAcquireThreadScheduler(Thread);
+    RtlCopyMemory(&(Thread->Affinity), Affinity, sizeof(PROCESSOR_AFFINITY));
+    ProcessorBlock = PARENT_STRUCTURE(GroupEntry->Scheduler,
+                                      PROCESSOR_BLOCK,
+                                      Scheduler);
+
+    Allowed = PROCESSOR_AFFINITY_CONTAINS(Affinity,
+                                          ProcessorBlock->ProcessorNumber);
+
+    State = Thread->State;
+    KeReleaseSpinLock(&(GroupEntry->Scheduler->Lock));
+
+    //
+    // A ready thread on the wrong processor can be moved right away. A
+    // running thread is moved once its processor reschedules, which skips
+    // threads not allowed there. Blocked threads are placed correctly when
+    // they wake.
+    //
+
+    if (Allowed == FALSE) {
+        if (State == ThreadStateReady) {
+            KepEnforceThreadAffinity(Thread);
+
+        } else if (State == ThreadStateRunning) {
+            KepPokeProcessor(ProcessorBlock);
+        }
+    }
+
+    KeLowerRunLevel(OldRunLevel);
+    return STATUS_SUCCESS;
+}
+
 VOID
 KeUnlinkSchedulerEntry (
     PSCHEDULER_ENTRY Entry
@@ -595,7 +962,8 @@ Return Value:
 
         if (Entry->Type == SchedulerEntryThread) {
 
-            ASSERT(Entry->ListEntry.Next == NULL);
+            ASSERT((Entry->ListEntry.Next == NULL) &&
+                   (Entry->TreeNode.Parent == NULL));
 
             OldCount = RtlAtomicAdd(&(ParentGroupEntry->Group->ThreadCount),
                                     -1);
@@ -613,12 +981,14 @@ Return Value:
             //
 
             if ((GroupEntry->Group->ThreadCount == 0) &&
-                (LIST_EMPTY(&(GroupEntry->Children)) != FALSE)) {
+                (LIST_EMPTY(&(GroupEntry->Group->Children)) != FALSE)) {
 
                 Group = GroupEntry->Group;
-                for (Index = 0; Index < Group->EntryCount; Group += 1) {
+                for (Index = 0; Index < Group->EntryCount; Index += 1) {
                     GroupEntry = &(Group->Entries[Index]);
-                    if (LIST_EMPTY(&(GroupEntry->Children)) == FALSE) {
+                    if (RED_BLACK_TREE_EMPTY(&(GroupEntry->Children)) ==
+                        FALSE) {
+
                         break;
                     }
                 }
@@ -674,7 +1044,7 @@ Return Value:
             continue;
         }
 
-        KepBalanceIdleScheduler();
+        KepBalanceScheduler(TRUE);
 
         //
         // Disable interrupts to commit to going down for idle. Without this
@@ -728,6 +1098,10 @@ Return Value:
     KeInitializeSpinLock(&KeSchedulerGroupLock);
     INITIALIZE_LIST_HEAD(&(KeRootSchedulerGroup.Children));
     KeInitializeSpinLock(&(ProcessorBlock->Scheduler.Lock));
+    ProcessorBlock->Scheduler.RunningEntry = NULL;
+    ProcessorBlock->Scheduler.Load = 0;
+    ProcessorBlock->Scheduler.Domain = 0;
+    ProcessorBlock->Scheduler.BalancePending = FALSE;
     KepInitializeSchedulerGroupEntry(&(ProcessorBlock->Scheduler.Group),
                                      &(ProcessorBlock->Scheduler),
                                      &KeRootSchedulerGroup,
@@ -736,12 +1110,55 @@ Return Value:
     return;
 }
 
-//
-// --------------------------------------------------------- Internal Functions
-//
+VOID
+KepInitializeSchedulerTopology (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine determines the scheduling domain of each active processor,
+    which the load balancer uses to keep threads near their caches. This must
+    be called once all processors have been started.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG Count;
+    ULONG Number;
+    ULONGLONG PhysicalId;
+    PPROCESSOR_BLOCK ProcessorBlock;
+    KSTATUS Status;
+
+    Count = KeGetActiveProcessorCount();
+    for (Number = 0; Number < Count; Number += 1) {
+        ProcessorBlock = KeProcessorBlocks[Number];
+        Status = HlGetProcessorPhysicalId(Number, &PhysicalId);
+        if (!KSUCCESS(Status)) {
+            ProcessorBlock->Scheduler.Domain = 0;
+            continue;
+        }
+
+        ProcessorBlock->Scheduler.Domain =
+                                         KepArchGetProcessorDomain(PhysicalId);
+    }
+
+    return;
+}
 
 VOID
-KepIdle (
+KepSchedulerClockTick (
     PPROCESSOR_BLOCK Processor
     )
 
@@ -749,8 +1166,9 @@ KepIdle (
 
 Routine Description:
 
-    This routine is called when a processor has nothing to run. This routine is
-    called with interrupts disabled, and returns with interrupts enabled.
+    This routine is called from the clock interrupt to update the scheduler's
+    load average for the current processor, and to periodically request a
+    load balance. This routine runs at clock level.
 
 Arguments:
 
@@ -765,34 +1183,46 @@ Return Value:
 
 {
 
-    KepClockIdle(Processor);
+    LONG Delta;
+    PSCHEDULER_DATA Scheduler;
+    ULONG Sample;
+
+    Scheduler = &(Processor->Scheduler);
+    Sample = Scheduler->Group.ReadyThreadCount << SCHEDULER_LOAD_SHIFT;
+    Delta = (LONG)(Sample - Scheduler->Load);
+    Scheduler->Load += Delta / SCHEDULER_LOAD_DECAY;
 
     //
-    // Begin counting this time as idle time. There's no need to put it back
-    // to its previous setting at the end because the next thing this thread
-    // will do is yield, and the scheduler will set the new period.
+    // Stagger the balance requests across processors so they don't all fight
+    // over the same scheduler locks on the same tick.
     //
 
-    KeBeginCycleAccounting(CycleAccountIdle);
-    PmIdle(Processor);
+    if (((Processor->Clock.InterruptCount + Processor->ProcessorNumber) %
+         SCHEDULER_BALANCE_INTERVAL) == 0) {
+
+        Scheduler->BalancePending = TRUE;
+    }
+
     return;
 }
 
 VOID
-KepBalanceIdleScheduler (
-    VOID
+KepBalanceScheduler (
+    BOOL Idle
     )
 
 /*++
 
 Routine Description:
 
-    This routine is called when the processor is idle. It tries to steal
-    threads from a busier processor.
+    This routine evens out the load between the current processor and the
+    other processors in the system, pulling a batch of threads from the
+    busiest processor or pushing threads to the least busy one.
 
 Arguments:
 
-    None.
+    Idle - Supplies a boolean indicating whether the current processor is
+        about to go idle (TRUE) or is balancing periodically (FALSE).
 
 Return Value:
 
@@ -802,243 +1232,1216 @@ Return Value:
 
 {
 
-    ULONG ActiveCount;
-    ULONG CurrentNumber;
-    PSCHEDULER_GROUP_ENTRY DestinationGroupEntry;
-    BOOL FirstThread;
-    PSCHEDULER_GROUP Group;
-    ULONG Number;
+    ULONG Count;
+    PPROCESSOR_BLOCK Current;
+    PPROCESSOR_BLOCK Destination;
+    ULONG Imbalance;
+    ULONG LocalLoad;
     RUNLEVEL OldRunLevel;
-    PPROCESSOR_BLOCK ProcessorBlock;
-    PSCHEDULER_GROUP_ENTRY SourceGroupEntry;
-    PSCHEDULER_DATA VictimScheduler;
-    PKTHREAD VictimThread;
+    PPROCESSOR_BLOCK Source;
 
-    ActiveCount = KeGetActiveProcessorCount();
-    if (ActiveCount == 1) {
+    if (KeGetActiveProcessorCount() == 1) {
         return;
     }
 
     OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+    Current = KeGetCurrentProcessorBlock();
+    LocalLoad = 0;
+    if (Idle == FALSE) {
+        LocalLoad = KepGetSchedulerLoad(&(Current->Scheduler));
+    }
 
-    ASSERT(OldRunLevel == RunLevelLow);
-
-    CurrentNumber = KeGetCurrentProcessorNumber();
-    VictimThread = NULL;
+    //
+    // Prefer pulling work from the busiest processor onto this one.
+    //
+
+    Source = KepFindBusiestProcessor(Current, LocalLoad, Idle);
+    if (Source != NULL) {
+        Destination = Current;
+        Imbalance = KepGetSchedulerLoad(&(Source->Scheduler)) - LocalLoad;
+
+    //
+    // If nobody is busier, and threads are waiting here, push some of them
+    // to the least loaded processor. This is how work reaches processors
+    // whose clocks are off because they are idle.
+    //
+
+    } else {
+        if ((Idle != FALSE) ||
+            (Current->Scheduler.Group.ReadyThreadCount <
+             SCHEDULER_REBALANCE_MINIMUM_THREADS)) {
+
+            goto BalanceSchedulerEnd;
+        }
+
+        Destination = KepFindIdlestProcessor(Current, LocalLoad);
+        if (Destination == NULL) {
+            goto BalanceSchedulerEnd;
+        }
+
+        Source = Current;
+        Imbalance = LocalLoad - KepGetSchedulerLoad(&(Destination->Scheduler));
+    }
+
+    //
+    // Move half the difference so that both processors end up with about the
+    // same load.
+    //
+
+    Count = (Imbalance / 2) >> SCHEDULER_LOAD_SHIFT;
+    if (Count == 0) {
+        Count = 1;
+
+    } else if (Count > SCHEDULER_BALANCE_BATCH_MAXIMUM) {
+        Count = SCHEDULER_BALANCE_BATCH_MAXIMUM;
+    }
+
+    KepMigrateThreads(Source, Destination, Count);
+
+BalanceSchedulerEnd:
+    KeLowerRunLevel(OldRunLevel);
+    return;
+}
+
+VOID
+KepEnforceThreadAffinity (
+    PKTHREAD Thread
+    )
+
+/*++
+
+Routine Description:
+
+    This routine moves a ready thread off of a processor its affinity no
+    longer allows it to run on. This routine must be called at dispatch level
+    or with interrupts disabled.
+
+Arguments:
+
+    Thread - Supplies a pointer to the thread to move.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PPROCESSOR_BLOCK Destination;
+    PSCHEDULER_GROUP_ENTRY GroupEntry;
+    PSCHEDULER_GROUP_ENTRY NewGroupEntry;
+    PPROCESSOR_BLOCK Source;
+
+    GroupEntry = KepAcquireThreadScheduler(Thread);
+    Source = PARENT_STRUCTURE(GroupEntry->Scheduler,
+                              PROCESSOR_BLOCK,
+                              Scheduler);
+
+    //
+    // Leave the thread alone if it already moved somewhere it is allowed, if
+    // it's no longer queued, or if it started running again.
+    //
+
+    Destination = NULL;
+    if ((Thread->State == ThreadStateReady) &&
+        (Thread->SchedulerEntry.TreeNode.Parent != NULL) &&
+        (!PROCESSOR_AFFINITY_CONTAINS(&(Thread->Affinity),
+                                      Source->ProcessorNumber))) {
+
+        Destination = KepSelectAffinityProcessor(Thread);
+    }
+
+    if (Destination == NULL) {
+        KeReleaseSpinLock(&(GroupEntry->Scheduler->Lock));
+        return;
+    }
+
+    KepDequeueSchedulerEntry(&(Thread->SchedulerEntry), TRUE);
+    Thread->SchedulerEntry.VirtualRuntime -= GroupEntry->MinimumRuntime;
+    KeReleaseSpinLock(&(GroupEntry->Scheduler->Lock));
+    NewGroupEntry = KepGetDestinationGroupEntry(GroupEntry, Destination);
+    Thread->SchedulerEntry.Parent = &(NewGroupEntry->Entry);
+    if (KepEnqueueSchedulerEntry(&(Thread->SchedulerEntry),
+                                 FALSE,
+                                 SCHEDULER_ENQUEUE_MIGRATING) != FALSE) {
+
+        KepPokeProcessor(Destination);
+    }
+
+    return;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+VOID
+KepIdle (
+    PPROCESSOR_BLOCK Processor
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is called when a processor has nothing to run. This routine is
+    called with interrupts disabled, and returns with interrupts enabled.
+
+Arguments:
+
+    Processor - Supplies a pointer to the processor block of the current
+        processor.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    KepClockIdle(Processor);
+
+    //
+    // The clock interrupt stops while idle, so the load average would go
+    // stale. Reset it so the load balancer sees this processor as empty.
+    //
+
+    Processor->Scheduler.Load = 0;
+
+    //
+    // Begin counting this time as idle time. There's no need to put it back
+    // to its previous setting at the end because the next thing this thread
+    // will do is yield, and the scheduler will set the new period.
+    //
+
+    KeBeginCycleAccounting(CycleAccountIdle);
+    PmIdle(Processor);
+    return;
+}
+
+PPROCESSOR_BLOCK
+KepFindBusiestProcessor (
+    PPROCESSOR_BLOCK Current,
+    ULONG LocalLoad,
+    BOOL Idle
+    )
+
+/*++
+
+Routine Description:
+
+    This routine finds the processor with the most load that threads could be
+    pulled from. Processors in the same scheduling domain as the current
+    processor are preferred.
+
+Arguments:
+
+    Current - Supplies a pointer to the processor block of the current
+        processor.
+
+    LocalLoad - Supplies the load of the current processor.
+
+    Idle - Supplies a boolean indicating if the current processor is going
+        idle, in which case any processor with waiting threads is a
+        candidate.
+
+Return Value:
+
+    Returns a pointer to the processor block of the busiest processor.
+
+    NULL if no processor is sufficiently busier than the current one.
+
+--*/
+
+{
+
+    ULONG ActiveCount;
+    PPROCESSOR_BLOCK Busiest;
+    ULONG BusiestLoad;
+    PPROCESSOR_BLOCK BusiestRemote;
+    ULONG BusiestRemoteLoad;
+    ULONG Load;
+    ULONG Number;
+    PPROCESSOR_BLOCK ProcessorBlock;
+    PSCHEDULER_DATA Scheduler;
+
+    ActiveCount = KeGetActiveProcessorCount();
+    Busiest = NULL;
+    BusiestLoad = 0;
+    BusiestRemote = NULL;
+    BusiestRemoteLoad = 0;
+    for (Number = 0; Number < ActiveCount; Number += 1) {
+        if (Number == Current->ProcessorNumber) {
+            continue;
+        }
+
+        ProcessorBlock = KeProcessorBlocks[Number];
+        Scheduler = &(ProcessorBlock->Scheduler);
+        if (Scheduler->Group.ReadyThreadCount <
+            SCHEDULER_REBALANCE_MINIMUM_THREADS) {
+
+            continue;
+        }
+
+        Load = KepGetSchedulerLoad(Scheduler);
+        if (Scheduler->Domain == Current->Scheduler.Domain) {
+            if ((Idle == FALSE) &&
+                (Load <= LocalLoad + SCHEDULER_IMBALANCE_THRESHOLD)) {
+
+                continue;
+            }
+
+            if (Load > BusiestLoad) {
+                Busiest = ProcessorBlock;
+                BusiestLoad = Load;
+            }
+
+        } else {
+            if ((Idle == FALSE) &&
+                (Load <= LocalLoad + SCHEDULER_DOMAIN_IMBALANCE_THRESHOLD)) {
+
+                continue;
+            }
+
+            if (Load > BusiestRemoteLoad) {
+                BusiestRemote = ProcessorBlock;
+                BusiestRemoteLoad = Load;
+            }
+        }
+    }
+
+    if (Busiest == NULL) {
+        Busiest = BusiestRemote;
+    }
+
+    return Busiest;
+}
+
+PPROCESSOR_BLOCK
+KepFindIdlestProcessor (
+    PPROCESSOR_BLOCK Current,
+    ULONG LocalLoad
+    )
+
+/*++
+
+Routine Description:
+
+    This routine finds the processor with the least load that threads could be
+    pushed to. Processors in the same scheduling domain as the current
+    processor are preferred.
+
+Arguments:
+
+    Current - Supplies a pointer to the processor block of the current
+        processor.
+
+    LocalLoad - Supplies the load of the current processor.
+
+Return Value:
+
+    Returns a pointer to the processor block of the least busy processor.
+
+    NULL if no processor is sufficiently less busy than the current one.
+
+--*/
+
+{
+
+    ULONG ActiveCount;
+    PPROCESSOR_BLOCK Idlest;
+    ULONG IdlestLoad;
+    PPROCESSOR_BLOCK IdlestRemote;
+    ULONG IdlestRemoteLoad;
+    ULONG Load;
+    ULONG Number;
+    PPROCESSOR_BLOCK ProcessorBlock;
+    PSCHEDULER_DATA Scheduler;
+
+    ActiveCount = KeGetActiveProcessorCount();
+    Idlest = NULL;
+    IdlestLoad = MAX_ULONG;
+    IdlestRemote = NULL;
+    IdlestRemoteLoad = MAX_ULONG;
+    for (Number = 0; Number < ActiveCount; Number += 1) {
+        if (Number == Current->ProcessorNumber) {
+            continue;
+        }
+
+        ProcessorBlock = KeProcessorBlocks[Number];
+        Scheduler = &(ProcessorBlock->Scheduler);
+        Load = KepGetSchedulerLoad(Scheduler);
+        if (Scheduler->Domain == Current->Scheduler.Domain) {
+            if (Load + SCHEDULER_IMBALANCE_THRESHOLD >= LocalLoad) {
+                continue;
+            }
+
+            if (Load < IdlestLoad) {
+                Idlest = ProcessorBlock;
+                IdlestLoad = Load;
+            }
+
+        } else {
+            if (Load + SCHEDULER_DOMAIN_IMBALANCE_THRESHOLD >= LocalLoad) {
+                continue;
+            }
+
+            if (Load < IdlestRemoteLoad) {
+                IdlestRemote = ProcessorBlock;
+                IdlestRemoteLoad = Load;
+            }
+        }
+    }
+
+    if (Idlest == NULL) {
+        Idlest = IdlestRemote;
+    }
+
+    return Idlest;
+}
+
+ULONG
+KepMigrateThreads (
+    PPROCESSOR_BLOCK Source,
+    PPROCESSOR_BLOCK Destination,
+    ULONG Count
+    )
+
+/*++
+
+Routine Description:
+
+    This routine moves a batch of ready threads from one processor's run
+    queue to another's. This routine must be called at dispatch level.
+
+Arguments:
+
+    Source - Supplies a pointer to the processor block to take threads from.
+
+    Destination - Supplies a pointer to the processor block to give the
+        threads to.
+
+    Count - Supplies the maximum number of threads to move.
+
+Return Value:
+
+    Returns the number of threads moved.
+
+--*/
+
+{
+
+    PSCHEDULER_GROUP_ENTRY DestinationGroupEntry;
+    ULONG Index;
+    ULONG Moved;
+    BOOL Poke;
+    PSCHEDULER_GROUP_ENTRY SourceGroupEntry;
+    PKTHREAD Thread;
+    PKTHREAD Threads[SCHEDULER_BALANCE_BATCH_MAXIMUM];
+
+    ASSERT(KeGetRunLevel() == RunLevelDispatch);
+    ASSERT(Count <= SCHEDULER_BALANCE_BATCH_MAXIMUM);
+
+    //
+    // Pull the threads out of the source's run queue, and make their virtual
+    // runtimes relative to the group entries they were in. Always leave the
+    // source with at least one thread.
+    //
+
+    Moved = 0;
+    KeAcquireSpinLock(&(Source->Scheduler.Lock));
+    while ((Moved < Count) &&
+           (Source->Scheduler.Group.ReadyThreadCount >=
+            SCHEDULER_REBALANCE_MINIMUM_THREADS)) {
+
+        Thread = KepGetNextThread(&(Source->Scheduler),
+                                  TRUE,
+                                  Destination->ProcessorNumber);
+        if (Thread == NULL) {
+            break;
+        }
+
+        ASSERT((Thread->State == ThreadStateReady) ||
+               (Thread->State == ThreadStateFirstTime));
+
+        KepDequeueSchedulerEntry(&(Thread->SchedulerEntry), TRUE);
+        SourceGroupEntry = PARENT_STRUCTURE(Thread->SchedulerEntry.Parent,
+                                            SCHEDULER_GROUP_ENTRY,
+                                            Entry);
+
+        Thread->SchedulerEntry.VirtualRuntime -=
+                                              SourceGroupEntry->MinimumRuntime;
+
+        Threads[Moved] = Thread;
+        Moved += 1;
+    }
+
+    KeReleaseSpinLock(&(Source->Scheduler.Lock));
+
+    //
+    // Enqueue the threads on the destination, in the same group they were in
+    // on the source.
+    //
+
+    Poke = FALSE;
+    for (Index = 0; Index < Moved; Index += 1) {
+        Thread = Threads[Index];
+        SourceGroupEntry = PARENT_STRUCTURE(Thread->SchedulerEntry.Parent,
+                                            SCHEDULER_GROUP_ENTRY,
+                                            Entry);
+
+        DestinationGroupEntry = KepGetDestinationGroupEntry(SourceGroupEntry,
+                                                            Destination);
+
+        Thread->SchedulerEntry.Parent = &(DestinationGroupEntry->Entry);
+        if (KepEnqueueSchedulerEntry(&(Thread->SchedulerEntry),
+                                     FALSE,
+                                     SCHEDULER_ENQUEUE_MIGRATING) != FALSE) {
+
+            Poke = TRUE;
+        }
+    }
+
+    if (Moved != 0) {
+        RtlAtomicAdd64(&(Destination->Migrations), Moved);
+
+        //
+        // Wake up the destination if it was idle, or let it know a thread
+        // should preempt the one it's running.
+        //
+
+        if (Poke != FALSE) {
+            KepPokeProcessor(Destination);
+        }
+    }
+
+    return Moved;
+}
+
+ULONG
+KepGetSchedulerLoad (
+    PSCHEDULER_DATA Scheduler
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the load of the given scheduler, which is the larger
+    of its load average and its current number of ready threads. The current
+    count covers processors that just got busy and whose average has not
+    caught up yet.
+
+Arguments:
+
+    Scheduler - Supplies a pointer to the scheduler to query.
+
+Return Value:
+
+    Returns the scheduler load, in fixed point threads.
+
+--*/
+
+{
+
+    ULONG Current;
+    ULONG Load;
+
+    Load = Scheduler->Load;
+    Current = Scheduler->Group.ReadyThreadCount << SCHEDULER_LOAD_SHIFT;
+    if (Current > Load) {
+        Load = Current;
+    }
+
+    return Load;
+}
+
+PPROCESSOR_BLOCK
+KepSelectAffinityProcessor (
+    PKTHREAD Thread
+    )
+
+/*++
+
+Routine Description:
+
+    This routine picks the least loaded active processor that the given
+    thread's affinity allows it to run on.
+
+Arguments:
+
+    Thread - Supplies a pointer to the thread being placed.
+
+Return Value:
+
+    Returns a pointer to the processor block of the chosen processor.
+
+    NULL if the thread's affinity does not contain any active processors.
+
+--*/
+
+{
+
+    ULONG ActiveCount;
+    PPROCESSOR_BLOCK Best;
+    ULONG BestLoad;
+    ULONG Load;
+    ULONG Number;
+    PPROCESSOR_BLOCK ProcessorBlock;
+
+    ActiveCount = KeGetActiveProcessorCount();
+    Best = NULL;
+    BestLoad = MAX_ULONG;
+    for (Number = 0; Number < ActiveCount; Number += 1) {
+        if (!PROCESSOR_AFFINITY_CONTAINS(&(Thread->Affinity), Number)) {
+            continue;
+        }
+
+        ProcessorBlock = KeProcessorBlocks[Number];
+        Load = KepGetSchedulerLoad(&(ProcessorBlock->Scheduler));
+        if ((Best == NULL) || (Load < BestLoad)) {
+            Best = ProcessorBlock;
+            BestLoad = Load;
+        }
+    }
+
+    return Best;
+}
+
+PSCHEDULER_GROUP_ENTRY
+KepGetDestinationGroupEntry (
+    PSCHEDULER_GROUP_ENTRY Source,
+    PPROCESSOR_BLOCK Destination
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the group entry on the destination processor that
+    corresponds to the given group entry, for moving a thread between
+    processors while keeping it in the same scheduling group.
+
+Arguments:
+
+    Source - Supplies a pointer to the group entry the thread is leaving.
+
+    Destination - Supplies a pointer to the processor block the thread is
+        moving to.
+
+Return Value:
+
+    Returns a pointer to the group entry on the destination processor.
+
+--*/
+
+{
+
+    PSCHEDULER_GROUP Group;
+
+    Group = Source->Group;
+    if (Group == &KeRootSchedulerGroup) {
+        return &(Destination->Scheduler.Group);
+    }
+
+    ASSERT(Group->EntryCount > Destination->ProcessorNumber);
+
+    return &(Group->Entries[Destination->ProcessorNumber]);
+}
+
+PSCHEDULER_GROUP_ENTRY
+KepAcquireThreadScheduler (
+    PKTHREAD Thread
+    )
+
+/*++
+
+Routine Description:
+
+    This routine acquires the scheduler lock of the processor the given thread
+    belongs to, chasing the thread if it moves in the meantime. This routine
+    must be called at dispatch level.
+
+Arguments:
+
+    Thread - Supplies a pointer to the thread.
+
+Return Value:
+
+    Returns a pointer to the group entry the thread belongs to. The caller is
+    responsible for releasing the lock of that group entry's scheduler.
+
+--*/
+
+{
+
+    PSCHEDULER_GROUP_ENTRY GroupEntry;
+
+    while (TRUE) {
+        GroupEntry = PARENT_STRUCTURE(Thread->SchedulerEntry.Parent,
+                                      SCHEDULER_GROUP_ENTRY,
+                                      Entry);
+
+        KeAcquireSpinLock(&(GroupEntry->Scheduler->Lock));
+        if (Thread->SchedulerEntry.Parent == &(GroupEntry->Entry)) {
+            break;
+        }
+
+        KeReleaseSpinLock(&(GroupEntry->Scheduler->Lock));
+    }
+
+    return GroupEntry;
+}
+
+VOID
+KepPokeProcessor (
+    PPROCESSOR_BLOCK Processor
+    )
+
+/*++
+
+Routine Description:
+
+    This routine makes sure the given processor runs its scheduler soon,
+    either because it just got its first thread or because a newly queued
+    thread should preempt the one it's running. A remote processor gets a
+    clock interrupt, which always runs the scheduler on its way out.
+
+Arguments:
+
+    Processor - Supplies a pointer to the processor block to poke.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    KepSetClockToPeriodic(Processor);
+    if (Processor == KeGetCurrentProcessorBlock()) {
+        Processor->PendingDispatchInterrupt = TRUE;
+    }
+
+    return;
+}
+
+BOOL
+KepEnqueueSchedulerEntry (
+    PSCHEDULER_ENTRY Entry,
+    BOOL LockHeld,
+    ULONG Flags
+    )
+
+/*++
+
+Routine Description:
+
+    This routine adds the given thread entry to the active scheduler. This
+    routine assumes the current runlevel is at dispatch, or interrupts are
+    disabled.
+
+Arguments:
+
+    Entry - Supplies a pointer to the thread entry to add.
+
+    LockHeld - Supplies a boolean indicating whether or not the caller has the
+        scheduler lock already held.
+
+    Flags - Supplies a bitfield of flags governing how the entry is placed in
+        the run queue. See SCHEDULER_ENQUEUE_* definitions.
+
+Return Value:
+
+    TRUE if this was the first thread scheduled on the top level group, or if
+    the entry should preempt the thread currently running. This indicates to
+    callers that the processor should be poked.
+
+    FALSE if the processor does not need to be poked.
+
+--*/
+
+{
+
+    ULONGLONG Floor;
+    BOOL Poke;
+    PSCHEDULER_GROUP_ENTRY GroupEntry;
+    PSCHEDULER_GROUP_ENTRY ParentGroupEntry;
+    PSCHEDULER_DATA Scheduler;
+    PKTHREAD Thread;
+
+    ASSERT((KeGetRunLevel() == RunLevelDispatch) ||
+           (ArAreInterruptsEnabled() == FALSE));
+
+    ASSERT(Entry->Type == SchedulerEntryThread);
+
+    if (KeSchedulerWakeupGranularity == 0) {
+        KepInitializeSchedulerTunables();
+    }
+
+    Poke = FALSE;
+    if (LockHeld != FALSE) {
+        GroupEntry = PARENT_STRUCTURE(Entry->Parent,
+                                      SCHEDULER_GROUP_ENTRY,
+                                      Entry);
+
+        Scheduler = GroupEntry->Scheduler;
+
+    } else {
+
+        //
+        // Chase the entity around as it bounces from group entry to group
+        // entry.
+        //
+
+        while (TRUE) {
+            GroupEntry = PARENT_STRUCTURE(Entry->Parent,
+                                          SCHEDULER_GROUP_ENTRY,
+                                          Entry);
+
+            Scheduler = GroupEntry->Scheduler;
+            KeAcquireSpinLock(&(Scheduler->Lock));
+            if (Entry->Parent == &(GroupEntry->Entry)) {
+                break;
+            }
+
+            KeReleaseSpinLock(&(Scheduler->Lock));
+        }
+    }
+
+    //
+    // Place the entry's virtual runtime. A migrating entry carries a runtime
+    // relative to its old group entry. A new thread starts at the group's
+    // minimum so it cannot monopolize the processor, and a thread that slept
+    // gets a bounded credit so that it runs soon without being able to bank
+    // its sleep time.
+    //
+
+    if ((Flags & SCHEDULER_ENQUEUE_MIGRATING) != 0) {
+        Entry->VirtualRuntime += GroupEntry->MinimumRuntime;
+    }
+
+    if ((Flags & SCHEDULER_ENQUEUE_WAKEUP) != 0) {
+        Thread = PARENT_STRUCTURE(Entry, KTHREAD, SchedulerEntry);
+        Floor = GroupEntry->MinimumRuntime;
+        if (Thread->State != ThreadStateFirstTime) {
+            Floor -= KeSchedulerWakeupCredit;
+        }
+
+        if ((LONGLONG)(Entry->VirtualRuntime - Floor) < 0) {
+            Entry->VirtualRuntime = Floor;
+        }
+    }
+
+    //
+    // Add the entry to the run queue.
+    //
+
+    ASSERT((Entry->ListEntry.Next == NULL) && (Entry->TreeNode.Parent == NULL));
+
+    RtlRedBlackTreeInsert(&(GroupEntry->Children), &(Entry->TreeNode));
 
     //
-    // Try to steal from another processor, starting with the next neighbor.
+    // Propagate the ready thread up through all levels. Group entries that
+    // just got their first ready thread join their parent's run queue.
     //
 
-    Number = CurrentNumber + 1;
     while (TRUE) {
-        if (Number == ActiveCount) {
-            Number = 0;
+        GroupEntry->ReadyThreadCount += 1;
+        KepUpdateMinimumRuntime(GroupEntry);
+        if (GroupEntry->Entry.Parent == NULL) {
+
+            //
+            // Remember if this is the first thread to become ready on the
+            // top level group.
+            //
+
+            if (GroupEntry->ReadyThreadCount == 1) {
+                Poke = TRUE;
+            }
+
+            break;
+        }
+
+        ParentGroupEntry = PARENT_STRUCTURE(GroupEntry->Entry.Parent,
+                                            SCHEDULER_GROUP_ENTRY,
+                                            Entry);
+
+        if (GroupEntry->ReadyThreadCount == 1) {
+
+            ASSERT(GroupEntry->Entry.TreeNode.Parent == NULL);
+
+            Floor = ParentGroupEntry->MinimumRuntime;
+            if ((LONGLONG)(GroupEntry->Entry.VirtualRuntime - Floor) < 0) {
+                GroupEntry->Entry.VirtualRuntime = Floor;
+            }
+
+            RtlRedBlackTreeInsert(&(ParentGroupEntry->Children),
+                                  &(GroupEntry->Entry.TreeNode));
+        }
+
+        GroupEntry = ParentGroupEntry;
+    }
+
+    if ((Poke == FALSE) && ((Flags & SCHEDULER_ENQUEUE_WAKEUP) != 0)) {
+        Poke = KepShouldPreempt(Scheduler, Entry);
+    }
+
+    if (LockHeld == FALSE) {
+        KeReleaseSpinLock(&(Scheduler->Lock));
+    }
+
+    return Poke;
+}
+
+VOID
+KepDequeueSchedulerEntry (
+    PSCHEDULER_ENTRY Entry,
+    BOOL LockHeld
+    )
+
+/*++
+
+Routine Description:
+
+    This routine removes the given thread entry from the active scheduler. This
+    routine assumes the current runlevel is at dispatch, or interrupts are
+    disabled.
+
+Arguments:
+
+    Entry - Supplies a pointer to the thread entry to remove.
+
+    LockHeld - Supplies a boolean indicating whether or not the caller has the
+        scheduler lock already held.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PSCHEDULER_GROUP_ENTRY GroupEntry;
+    PSCHEDULER_GROUP_ENTRY ParentGroupEntry;
+    PSCHEDULER_DATA Scheduler;
+
+    ASSERT((KeGetRunLevel() == RunLevelDispatch) ||
+           (ArAreInterruptsEnabled() == FALSE));
+
+    ASSERT(Entry->Type == SchedulerEntryThread);
+
+    if (LockHeld != FALSE) {
+        GroupEntry = PARENT_STRUCTURE(Entry->Parent,
+                                      SCHEDULER_GROUP_ENTRY,
+                                      Entry);
+
+        Scheduler = GroupEntry->Scheduler;
+
+    } else {
+
+        //
+        // Chase the entity around as it bounces from group entry to group
+        // entry.
+        //
+
+        while (TRUE) {
+            GroupEntry = PARENT_STRUCTURE(Entry->Parent,
+                                          SCHEDULER_GROUP_ENTRY,
+                                          Entry);
+
+            Scheduler = GroupEntry->Scheduler;
+            KeAcquireSpinLock(&(Scheduler->Lock));
+            if (Entry->Parent == &(GroupEntry->Entry)) {
+                break;
+            }
+
+            KeReleaseSpinLock(&(Scheduler->Lock));
         }
+    }
 
-        if (Number == CurrentNumber) {
+    //
+    // Remove the entry from the run queue.
+    //
+
+    ASSERT(Entry->TreeNode.Parent != NULL);
+
+    RtlRedBlackTreeRemove(&(GroupEntry->Children), &(Entry->TreeNode));
+    Entry->TreeNode.Parent = NULL;
+
+    //
+    // Propagate the no-longer-ready thread up through all levels. Group
+    // entries with no more ready threads leave their parent's run queue.
+    //
+
+    while (TRUE) {
+        GroupEntry->ReadyThreadCount -= 1;
+        KepUpdateMinimumRuntime(GroupEntry);
+        if (GroupEntry->Entry.Parent == NULL) {
             break;
         }
 
-        ProcessorBlock = KeProcessorBlocks[Number];
-        VictimScheduler = &(ProcessorBlock->Scheduler);
-        if (VictimScheduler->Group.ReadyThreadCount >=
-            SCHEDULER_REBALANCE_MINIMUM_THREADS) {
+        ParentGroupEntry = PARENT_STRUCTURE(GroupEntry->Entry.Parent,
+                                            SCHEDULER_GROUP_ENTRY,
+                                            Entry);
 
-            KeAcquireSpinLock(&(VictimScheduler->Lock));
-            VictimThread = KepGetNextThread(VictimScheduler, TRUE);
-            if (VictimThread != NULL) {
+        if (GroupEntry->ReadyThreadCount == 0) {
+            RtlRedBlackTreeRemove(&(ParentGroupEntry->Children),
+                                  &(GroupEntry->Entry.TreeNode));
 
-                ASSERT((VictimThread->State == ThreadStateReady) ||
-                       (VictimThread->State == ThreadStateFirstTime));
+            GroupEntry->Entry.TreeNode.Parent = NULL;
+        }
 
-                //
-                // Pull the thread out of the ready queue.
-                //
+        GroupEntry = ParentGroupEntry;
+    }
+
+    if (LockHeld == FALSE) {
+        KeReleaseSpinLock(&(Scheduler->Lock));
+    }
+
+    return;
+}
+
+PKTHREAD
+KepGetNextThread (
+    PSCHEDULER_DATA Scheduler,
+    BOOL SkipRunning,
+    ULONG ProcessorNumber
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the next thread to run in the scheduler, which is the
+    thread found by descending through the entries with the lowest virtual
+    runtime at each level. This routine assumes the scheduler lock is already
+    held.
+
+Arguments:
+
+    Scheduler - Supplies a pointer to the scheduler to work on.
+
+    SkipRunning - Supplies a boolean indicating whether to ignore the first
+        thread on the queue if it's marked as running. This is used when trying
+        to steal threads from another scheduler.
+
+    ProcessorNumber - Supplies the number of the processor the thread is going
+        to run on. Threads whose affinity does not include this processor are
+        skipped.
+
+Return Value:
+
+    Returns a pointer to the next thread to run.
+
+    NULL if no threads are ready to run.
+
+--*/
+
+{
+
+    PSCHEDULER_GROUP_ENTRY ChildGroupEntry;
+    PSCHEDULER_ENTRY Entry;
+    PSCHEDULER_GROUP_ENTRY GroupEntry;
+    PRED_BLACK_TREE_NODE Node;
+    PSCHEDULER_GROUP_ENTRY ParentGroupEntry;
+    PKTHREAD Thread;
+
+    GroupEntry = &(Scheduler->Group);
+    if (GroupEntry->ReadyThreadCount == 0) {
+        return NULL;
+    }
 
-                KepDequeueSchedulerEntry(&(VictimThread->SchedulerEntry), TRUE);
+    Node = RtlRedBlackTreeGetLowestNode(&(GroupEntry->Children));
+    while (TRUE) {
+
+        //
+        // If the end of this group's run queue was hit, pop back up to the
+        // parent group and continue after this group's entry.
+        //
+
+        if (Node == NULL) {
+            if (GroupEntry->Entry.Parent == NULL) {
+                break;
             }
 
-            KeReleaseSpinLock(&(VictimScheduler->Lock));
-            if (VictimThread != NULL) {
+            ParentGroupEntry = PARENT_STRUCTURE(GroupEntry->Entry.Parent,
+                                                SCHEDULER_GROUP_ENTRY,
+                                                Entry);
+
+            Node = RtlRedBlackTreeGetNextNode(&(ParentGroupEntry->Children),
+                                              FALSE,
+                                              &(GroupEntry->Entry.TreeNode));
 
-                //
-                // Move the entry to this processor's queue.
-                //
+            GroupEntry = ParentGroupEntry;
+            continue;
+        }
 
-                SourceGroupEntry = PARENT_STRUCTURE(
-                                           VictimThread->SchedulerEntry.Parent,
-                                           SCHEDULER_GROUP_ENTRY,
-                                           Entry);
+        //
+        // Get the next child of the group. If it's a thread, return it.
+        //
 
-                Group = SourceGroupEntry->Group;
-                if (Group == &KeRootSchedulerGroup) {
-                    DestinationGroupEntry =
-                          &(KeProcessorBlocks[CurrentNumber]->Scheduler.Group);
+        Entry = RED_BLACK_TREE_VALUE(Node, SCHEDULER_ENTRY, TreeNode);
+        if (Entry->Type == SchedulerEntryThread) {
+            Thread = PARENT_STRUCTURE(Entry, KTHREAD, SchedulerEntry);
+            if (((SkipRunning == FALSE) ||
+                 (Thread->State != ThreadStateRunning)) &&
+                (PROCESSOR_AFFINITY_CONTAINS(&(Thread->Affinity),
+                                             ProcessorNumber))) {
 
-                } else {
+                return Thread;
+            }
 
-                    ASSERT(Group->EntryCount > CurrentNumber);
+            //
+            // This thread was not acceptable. Try the next entry.
+            //
 
-                    DestinationGroupEntry = &(Group->Entries[CurrentNumber]);
-                }
+            Node = RtlRedBlackTreeGetNextNode(&(GroupEntry->Children),
+                                              FALSE,
+                                              Node);
 
-                VictimThread->SchedulerEntry.Parent =
-                                               &(DestinationGroupEntry->Entry);
+            continue;
+        }
 
-                //
-                // Enqueue the thread on this processor.
-                //
+        //
+        // The child is a group, which is only queued if it has ready threads
+        // somewhere down there. Descend into it.
+        //
 
-                FirstThread =
-                      KepEnqueueSchedulerEntry(&(VictimThread->SchedulerEntry),
-                                               FALSE);
+        ASSERT(Entry->Type == SchedulerEntryGroup);
 
-                if (FirstThread != FALSE) {
-                    KepSetClockToPeriodic(KeProcessorBlocks[CurrentNumber]);
-                }
+        ChildGroupEntry = PARENT_STRUCTURE(Entry, SCHEDULER_GROUP_ENTRY, Entry);
 
-                break;
-            }
-        }
+        ASSERT(ChildGroupEntry->ReadyThreadCount != 0);
 
-        Number += 1;
+        GroupEntry = ChildGroupEntry;
+        Node = RtlRedBlackTreeGetLowestNode(&(GroupEntry->Children));
     }
 
-    KeLowerRunLevel(OldRunLevel);
-    return;
+    //
+    // The end of the group was hit without finding a thread.
+    //
+
+    return NULL;
 }
 
-BOOL
-KepEnqueueSchedulerEntry (
+VOID
+KepChargeSchedulerEntry (
     PSCHEDULER_ENTRY Entry,
-    BOOL LockHeld
+    ULONGLONG CurrentTime
     )
 
 /*++
 
 Routine Description:
 
-    This routine adds the given entry to the active scheduler. This routine
-    assumes the current runlevel is at dispatch, or interrupts are disabled.
+    This routine charges the running thread entry and each of its parent
+    group entries for the time the thread has run since it was last charged,
+    scaled by each entry's weight. This routine assumes the scheduler lock is
+    already held.
 
 Arguments:
 
-    Entry - Supplies a pointer to the entry to add.
+    Entry - Supplies a pointer to the running thread's scheduler entry.
 
-    LockHeld - Supplies a boolean indicating whether or not the caller has the
-        scheduler lock already held.
+    CurrentTime - Supplies the current processor counter value.
 
 Return Value:
 
-    TRUE if this was the first thread scheduled on the top level group. This
-    may indicate to callers that the processor may be out and idle.
-
-    FALSE if this was not the first thread scheduled, or the entry being
-    scheduled was not a thread.
+    None.
 
 --*/
 
 {
 
-    BOOL FirstThread;
+    ULONGLONG Delta;
     PSCHEDULER_GROUP_ENTRY GroupEntry;
-    PSCHEDULER_DATA Scheduler;
 
-    ASSERT((KeGetRunLevel() == RunLevelDispatch) ||
-           (ArAreInterruptsEnabled() == FALSE));
+    ASSERT(Entry->Type == SchedulerEntryThread);
 
-    FirstThread = FALSE;
-    if (LockHeld != FALSE) {
+    Delta = 0;
+    if ((Entry->RunStart != 0) && (CurrentTime > Entry->RunStart)) {
+        Delta = CurrentTime - Entry->RunStart;
+    }
+
+    Entry->RunStart = CurrentTime;
+    while (Entry->Parent != NULL) {
         GroupEntry = PARENT_STRUCTURE(Entry->Parent,
                                       SCHEDULER_GROUP_ENTRY,
                                       Entry);
 
-        Scheduler = GroupEntry->Scheduler;
+        ASSERT(Entry->Weight != 0);
 
-    } else {
+        Entry->VirtualRuntime += (Delta * SCHEDULER_WEIGHT_DEFAULT) /
+                                 Entry->Weight;
 
-        //
-        // Chase the entity around as it bounces from group entry to group
-        // entry.
-        //
+        if (Entry->TreeNode.Parent != NULL) {
+            KepRequeueSchedulerEntry(GroupEntry, Entry);
+        }
 
-        while (TRUE) {
-            GroupEntry = PARENT_STRUCTURE(Entry->Parent,
-                                          SCHEDULER_GROUP_ENTRY,
-                                          Entry);
+        KepUpdateMinimumRuntime(GroupEntry);
+        Entry = &(GroupEntry->Entry);
+    }
 
-            Scheduler = GroupEntry->Scheduler;
-            KeAcquireSpinLock(&(Scheduler->Lock));
-            if (Entry->Parent == &(GroupEntry->Entry)) {
-                break;
-            }
+    return;
+}
 
-            KeReleaseSpinLock(&(Scheduler->Lock));
-        }
-    }
+VOID
+KepRequeueSchedulerEntry (
+    PSCHEDULER_GROUP_ENTRY GroupEntry,
+    PSCHEDULER_ENTRY Entry
+    )
 
-    //
-    // Add the entry to the list.
-    //
+/*++
 
-    ASSERT(Entry->ListEntry.Next == NULL);
+Routine Description:
 
-    INSERT_BEFORE(&(Entry->ListEntry), &(GroupEntry->Children));
+    This routine moves a queued entry to its proper place in its group entry's
+    run queue after its virtual runtime changed. This routine assumes the
+    scheduler lock is already held.
 
-    //
-    // Propagate the ready thread up through all levels.
-    //
+Arguments:
 
-    if (Entry->Type == SchedulerEntryThread) {
-        while (TRUE) {
-            GroupEntry->ReadyThreadCount += 1;
-            if (GroupEntry->Entry.Parent == NULL) {
+    GroupEntry - Supplies a pointer to the group entry whose run queue holds
+        the entry.
 
-                //
-                // Remember if this is the first thread to become ready on the
-                // top level group.
-                //
+    Entry - Supplies a pointer to the entry to move.
 
-                if (GroupEntry->ReadyThreadCount == 1) {
-                    FirstThread = TRUE;
-                }
+Return Value:
 
-                break;
-            }
+    None.
 
-            GroupEntry = PARENT_STRUCTURE(GroupEntry->Entry.Parent,
-                                          SCHEDULER_GROUP_ENTRY,
-                                          Entry);
-        }
-    }
+--*/
 
-    if (LockHeld == FALSE) {
-        KeReleaseSpinLock(&(Scheduler->Lock));
-    }
+{
+
+    ASSERT(Entry->TreeNode.Parent != NULL);
 
-    return FirstThread;
+    RtlRedBlackTreeRemove(&(GroupEntry->Children), &(Entry->TreeNode));
+    RtlRedBlackTreeInsert(&(GroupEntry->Children), &(Entry->TreeNode));
+    return;
 }
 
 VOID
-KepDequeueSchedulerEntry (
-    PSCHEDULER_ENTRY Entry,
-    BOOL LockHeld
+KepUpdateMinimumRuntime (
+    PSCHEDULER_GROUP_ENTRY GroupEntry
     )
 
 /*++
 
 Routine Description:
 
-    This routine removes the given entry to the active scheduler. This routine
-    assumes the current runlevel is at dispatch, or interrupts are disabled.
+    This routine advances the minimum virtual runtime of a group entry to the
+    lowest runtime in its run queue. The minimum never moves backwards. This
+    routine assumes the scheduler lock is already held.
 
 Arguments:
 
-    Entry - Supplies a pointer to the entry to remove.
-
-    LockHeld - Supplies a boolean indicating whether or not the caller has the
-        scheduler lock already held.
+    GroupEntry - Supplies a pointer to the group entry to update.
 
 Return Value:
 
@@ -1048,199 +2451,210 @@ Return Value:
 
 {
 
-    PSCHEDULER_GROUP_ENTRY GroupEntry;
-    PSCHEDULER_GROUP_ENTRY ParentGroupEntry;
-    PSCHEDULER_DATA Scheduler;
+    PSCHEDULER_ENTRY Lowest;
+    PRED_BLACK_TREE_NODE Node;
 
-    ASSERT((KeGetRunLevel() == RunLevelDispatch) ||
-           (ArAreInterruptsEnabled() == FALSE));
+    Node = RtlRedBlackTreeGetLowestNode(&(GroupEntry->Children));
+    if (Node == NULL) {
+        return;
+    }
 
-    if (LockHeld != FALSE) {
-        GroupEntry = PARENT_STRUCTURE(Entry->Parent,
-                                      SCHEDULER_GROUP_ENTRY,
-                                      Entry);
+    Lowest = RED_BLACK_TREE_VALUE(Node, SCHEDULER_ENTRY, TreeNode);
+    if ((LONGLONG)(Lowest->VirtualRuntime - GroupEntry->MinimumRuntime) > 0) {
+        GroupEntry->MinimumRuntime = Lowest->VirtualRuntime;
+    }
 
-        Scheduler = GroupEntry->Scheduler;
+    return;
+}
 
-    } else {
+BOOL
+KepShouldPreempt (
+    PSCHEDULER_DATA Scheduler,
+    PSCHEDULER_ENTRY Entry
+    )
 
-        //
-        // Chase the entity around as it bounces from group entry to group
-        // entry.
-        //
+/*++
 
-        while (TRUE) {
-            GroupEntry = PARENT_STRUCTURE(Entry->Parent,
-                                          SCHEDULER_GROUP_ENTRY,
-                                          Entry);
+Routine Description:
 
-            Scheduler = GroupEntry->Scheduler;
-            KeAcquireSpinLock(&(Scheduler->Lock));
-            if (Entry->Parent == &(GroupEntry->Entry)) {
-                break;
-            }
+    This routine determines whether a newly woken entry should preempt the
+    thread running on the given scheduler. The two are compared at the level
+    of their closest common group, so that a thread never preempts a thread in
+    a group that is owed more time. This routine assumes the scheduler lock is
+    already held.
 
-            KeReleaseSpinLock(&(Scheduler->Lock));
-        }
-    }
+Arguments:
+
+    Scheduler - Supplies a pointer to the scheduler the entry was queued on.
+
+    Entry - Supplies a pointer to the newly queued thread entry.
+
+Return Value:
+
+    TRUE if the running thread should be preempted.
+
+    FALSE if the running thread should continue.
+
+--*/
+
+{
+
+    PSCHEDULER_ENTRY Current;
+    ULONG CurrentDepth;
+    PSCHEDULER_ENTRY Running;
+    ULONG RunningDepth;
+    PSCHEDULER_ENTRY Search;
+
+    Running = Scheduler->RunningEntry;
 
     //
-    // Remove the entry from the list.
+    // If the processor is idle, poke it so it picks up the new thread.
     //
 
-    ASSERT(Entry->ListEntry.Next != NULL);
+    if (Running == NULL) {
+        return TRUE;
+    }
 
-    LIST_REMOVE(&(Entry->ListEntry));
-    Entry->ListEntry.Next = NULL;
+    if (Running == Entry) {
+        return FALSE;
+    }
 
     //
-    // Propagate the no-longer-ready thread up through all levels.
+    // Bring both entries up to the same depth, then walk up until they are
+    // siblings in the same run queue.
     //
 
-    if (Entry->Type == SchedulerEntryThread) {
-        while (TRUE) {
-            GroupEntry->ReadyThreadCount -= 1;
-            if (GroupEntry->Entry.Parent == NULL) {
-                break;
-            }
-
-            ParentGroupEntry = PARENT_STRUCTURE(GroupEntry->Entry.Parent,
-                                                SCHEDULER_GROUP_ENTRY,
-                                                Entry);
+    CurrentDepth = 0;
+    for (Search = Entry->Parent; Search != NULL; Search = Search->Parent) {
+        CurrentDepth += 1;
+    }
 
-            //
-            // Rotate the groups so others at higher levels get a chance to run.
-            //
+    RunningDepth = 0;
+    for (Search = Running->Parent; Search != NULL; Search = Search->Parent) {
+        RunningDepth += 1;
+    }
 
-            LIST_REMOVE(&(GroupEntry->Entry.ListEntry));
-            INSERT_BEFORE(&(GroupEntry->Entry.ListEntry),
-                          &(ParentGroupEntry->Children));
+    Current = Entry;
+    while (CurrentDepth > RunningDepth) {
+        Current = Current->Parent;
+        CurrentDepth -= 1;
+    }
 
-            GroupEntry = ParentGroupEntry;
-        }
+    while (RunningDepth > CurrentDepth) {
+        Running = Running->Parent;
+        RunningDepth -= 1;
+    }
 
-    } else {
-        GroupEntry = PARENT_STRUCTURE(Entry, SCHEDULER_GROUP_ENTRY, Entry);
+    while (Current->Parent != Running->Parent) {
+        Current = Current->Parent;
+        Running = Running->Parent;
+    }
 
-        ASSERT(GroupEntry->ReadyThreadCount == 0);
+    if (Current == Running) {
+        return FALSE;
     }
 
-    if (LockHeld == FALSE) {
-        KeReleaseSpinLock(&(Scheduler->Lock));
+    if ((LONGLONG)(Running->VirtualRuntime - Current->VirtualRuntime) >
+        (LONGLONG)KeSchedulerWakeupGranularity) {
+
+        return TRUE;
     }
 
-    return;
+    return FALSE;
 }
 
-PKTHREAD
-KepGetNextThread (
-    PSCHEDULER_DATA Scheduler,
-    BOOL SkipRunning
+VOID
+KepInitializeSchedulerTunables (
+    VOID
     )
 
 /*++
 
 Routine Description:
 
-    This routine returns the next thread to run in the scheduler. This routine
-    assumes the scheduler lock is already held.
+    This routine converts the scheduler latency targets into processor counter
+    ticks. It does nothing if the processor counter frequency is not yet known.
 
 Arguments:
 
-    Scheduler - Supplies a pointer to the scheduler to work on.
-
-    SkipRunning - Supplies a boolean indicating whether to ignore the first
-        thread on the queue if it's marked as running. This is used when trying
-        to steal threads from another scheduler.
+    None.
 
 Return Value:
 
-    Returns a pointer to the next thread to run.
-
-    NULL if no threads are ready to run.
+    None.
 
 --*/
 
 {
 
-    PSCHEDULER_GROUP_ENTRY ChildGroupEntry;
-    PLIST_ENTRY CurrentEntry;
-    PSCHEDULER_ENTRY Entry;
-    PSCHEDULER_GROUP_ENTRY GroupEntry;
-    PKTHREAD Thread;
+    ULONGLONG Frequency;
 
-    GroupEntry = &(Scheduler->Group);
-    if (GroupEntry->ReadyThreadCount == 0) {
-        return NULL;
+    Frequency = HlQueryProcessorCounterFrequency();
+    if (Frequency == 0) {
+        return;
     }
 
-    CurrentEntry = GroupEntry->Children.Next;
-    while (CurrentEntry != &(GroupEntry->Children)) {
+    KeSchedulerWakeupCredit = (Frequency * SCHEDULER_LATENCY_MICROSECONDS) /
+                              (MICROSECONDS_PER_SECOND * 2);
 
-        //
-        // Get the next child of the group. If it's a thread, return it.
-        //
+    KeSchedulerWakeupGranularity =
+                   (Frequency * SCHEDULER_WAKEUP_GRANULARITY_MICROSECONDS) /
+                   MICROSECONDS_PER_SECOND;
 
-        Entry = LIST_VALUE(CurrentEntry, SCHEDULER_ENTRY, ListEntry);
-        if (Entry->Type == SchedulerEntryThread) {
-            Thread = PARENT_STRUCTURE(Entry, KTHREAD, SchedulerEntry);
-            if ((SkipRunning == FALSE) ||
-                (Thread->State != ThreadStateRunning)) {
+    return;
+}
 
-                return Thread;
-            }
+COMPARISON_RESULT
+KepCompareSchedulerEntries (
+    PRED_BLACK_TREE Tree,
+    PRED_BLACK_TREE_NODE FirstNode,
+    PRED_BLACK_TREE_NODE SecondNode
+    )
 
-            //
-            // This thread was not acceptable. Try to continue to the next
-            // entry in the list, or pop back up to the parent group.
-            //
+/*++
 
-            while (TRUE) {
-                if (CurrentEntry->Next != &(GroupEntry->Children)) {
-                    CurrentEntry = CurrentEntry->Next;
-                    break;
-                }
+Routine Description:
 
-                if (GroupEntry->Entry.Parent == NULL) {
-                    CurrentEntry = CurrentEntry->Next;
-                    break;
-                }
+    This routine compares two scheduler entries by virtual runtime. The
+    comparison tolerates the runtimes wrapping around.
 
-                CurrentEntry = &(GroupEntry->Entry.ListEntry);
-                GroupEntry = PARENT_STRUCTURE(GroupEntry->Entry.Parent,
-                                              SCHEDULER_GROUP_ENTRY,
-                                              Entry);
-            }
+Arguments:
 
-            continue;
-        }
+    Tree - Supplies a pointer to the run queue being operated on.
 
-        //
-        // The child is a group. If it has no children, continue to the sibling.
-        //
+    FirstNode - Supplies a pointer to the left side of the comparison.
 
-        ASSERT(Entry->Type == SchedulerEntryGroup);
+    SecondNode - Supplies a pointer to the second side of the comparison.
 
-        ChildGroupEntry = PARENT_STRUCTURE(Entry, SCHEDULER_GROUP_ENTRY, Entry);
-        if (ChildGroupEntry->ReadyThreadCount == 0) {
-            CurrentEntry = CurrentEntry->Next;
+Return Value:
 
-        //
-        // The child group has ready threads somewhere down there. Descend into
-        // it.
-        //
+    Same if the two entries have the same virtual runtime.
 
-        } else {
-            GroupEntry = ChildGroupEntry;
-            CurrentEntry = GroupEntry->Children.Next;
-        }
-    }
+    Ascending if the first entry has run less than the second.
 
-    //
-    // The end of the group was hit without finding a thread.
-    //
+    Descending if the second entry has run less than the first.
 
-    return NULL;
+--*/
+
+{
+
+    LONGLONG Difference;
+    PSCHEDULER_ENTRY FirstEntry;
+    PSCHEDULER_ENTRY SecondEntry;
+
+    FirstEntry = RED_BLACK_TREE_VALUE(FirstNode, SCHEDULER_ENTRY, TreeNode);
+    SecondEntry = RED_BLACK_TREE_VALUE(SecondNode, SCHEDULER_ENTRY, TreeNode);
+    Difference = (LONGLONG)(FirstEntry->VirtualRuntime -
+                            SecondEntry->VirtualRuntime);
+
+    if (Difference < 0) {
+        return ComparisonResultAscending;
+
+    } else if (Difference > 0) {
+        return ComparisonResultDescending;
+    }
+
+    return ComparisonResultSame;
 }
 
 KSTATUS
@@ -1338,16 +2752,15 @@ Return Value:
             ParentGroupEntry = &(ParentGroup->Entries[Index]);
         }
 
+        //
+        // The group entry joins the parent's run queue once it has a ready
+        // thread.
+        //
+
         KepInitializeSchedulerGroupEntry(&(Group->Entries[Index]),
                                          &(KeProcessorBlocks[Index]->Scheduler),
                                          Group,
                                          ParentGroupEntry);
-
-        //
-        // Add the scheduler group entry to the parent scheduler group entry.
-        //
-
-        KepEnqueueSchedulerEntry(&(Group->Entries[Index].Entry), FALSE);
     }
 
     *NewGroup = Group;
@@ -1384,13 +2797,17 @@ Return Value:
     ASSERT(Group != &KeRootSchedulerGroup);
     ASSERT(Group->ThreadCount == 0);
 
+    //
+    // Group entries without ready threads are not in their parent's run
+    // queue, so there is nothing to unlink from the schedulers.
+    //
+
     for (Index = 0; Index < Group->EntryCount; Index += 1) {
         GroupEntry = &(Group->Entries[Index]);
 
         ASSERT((GroupEntry->ReadyThreadCount == 0) &&
-               (LIST_EMPTY(&(GroupEntry->Children)) != FALSE));
-
-        KepDequeueSchedulerEntry(&(GroupEntry->Entry), FALSE);
+               (RED_BLACK_TREE_EMPTY(&(GroupEntry->Children)) != FALSE) &&
+               (GroupEntry->Entry.TreeNode.Parent == NULL));
     }
 
     OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
@@ -1443,8 +2860,17 @@ Return Value:
         GroupEntry->Entry.Parent = &(ParentEntry->Entry);
     }
 
-    INITIALIZE_LIST_HEAD(&(GroupEntry->Children));
+    GroupEntry->Entry.TreeNode.Parent = NULL;
+    GroupEntry->Entry.VirtualRuntime = 0;
+    GroupEntry->Entry.RunStart = 0;
+    GroupEntry->Entry.Weight = SCHEDULER_WEIGHT_DEFAULT;
+    GroupEntry->Entry.NiceValue = SCHEDULER_NICE_DEFAULT;
+    RtlRedBlackTreeInitialize(&(GroupEntry->Children),
+                              0,
+                              KepCompareSchedulerEntries);
+
     GroupEntry->ReadyThreadCount = 0;
+    GroupEntry->MinimumRuntime = 0;
     GroupEntry->Group = Group;
     GroupEntry->Scheduler = Scheduler;
     return;
@@ -224,6 +224,20 @@ SYSTEM_CALL_TABLE_ENTRY KeSystemCallTable[SystemCallCount] = {
     {MmSysSetBreak,
         sizeof(SYSTEM_CALL_SET_BREAK),
         sizeof(SYSTEM_CALL_SET_BREAK)},
+    {PsSysSetPriority,
+        sizeof(SYSTEM_CALL_SET_PRIORITY),
+        sizeof(SYSTEM_CALL_SET_PRIORITY)},
+    {PsSysSetAffinity, sizeof(SYSTEM_CALL_SET_AFFINITY), 0},
+    {MmSysSetMemoryAdvice, sizeof(SYSTEM_CALL_SET_MEMORY_ADVICE), 0},
+    {IoSysCreatePollSet,
+        sizeof(SYSTEM_CALL_CREATE_POLL_SET),
+        sizeof(SYSTEM_CALL_CREATE_POLL_SET)},
+    {IoSysControlPollSet, sizeof(SYSTEM_CALL_CONTROL_POLL_SET), 0},
+    {IoSysWaitForPollSet, sizeof(SYSTEM_CALL_WAIT_FOR_POLL_SET), 0},
+    {IoSysSendFile, sizeof(SYSTEM_CALL_SEND_FILE), 0},
+    {PsSysSpawnProcess,
+        sizeof(SYSTEM_CALL_SPAWN_PROCESS),
+        sizeof(SYSTEM_CALL_SPAWN_PROCESS)},
 };
 
 //
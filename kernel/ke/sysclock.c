@@ -498,16 +498,19 @@ Return Value:
         Accounting->KernelCycles = ProcessorBlock->KernelCycles;
         Accounting->InterruptCycles = ProcessorBlock->InterruptCycles;
         Accounting->IdleCycles = ProcessorBlock->IdleCycles;
+        Accounting->Migrations = ProcessorBlock->Migrations;
         RtlMemoryBarrier();
         Copy.UserCycles = ProcessorBlock->UserCycles;
         Copy.KernelCycles = ProcessorBlock->KernelCycles;
         Copy.InterruptCycles = ProcessorBlock->InterruptCycles;
         Copy.IdleCycles = ProcessorBlock->IdleCycles;
+        Copy.Migrations = ProcessorBlock->Migrations;
 
     } while ((Copy.UserCycles != Accounting->UserCycles) ||
              (Copy.KernelCycles != Accounting->KernelCycles) ||
              (Copy.InterruptCycles != Accounting->InterruptCycles) ||
-             (Copy.IdleCycles != Accounting->IdleCycles));
+             (Copy.IdleCycles != Accounting->IdleCycles) ||
+             (Copy.Migrations != Accounting->Migrations));
 
     return STATUS_SUCCESS;
 }
@@ -558,6 +561,7 @@ Return Value:
         Accounting->KernelCycles += ProcessorAccounting.KernelCycles;
         Accounting->InterruptCycles += ProcessorAccounting.InterruptCycles;
         Accounting->IdleCycles += ProcessorAccounting.IdleCycles;
+        Accounting->Migrations += ProcessorAccounting.Migrations;
     }
 
     return;
@@ -726,6 +730,13 @@ Return Value:
 
     KepMaintainClock(ProcessorBlock);
 
+    //
+    // Update the scheduler's load average, which may request a periodic load
+    // balance when the dispatch interrupt runs.
+    //
+
+    KepSchedulerClockTick(ProcessorBlock);
+
     //
     // Queue a dispatch interrupt to run the scheduler.
     //
@@ -864,6 +875,18 @@ Return Value:
         //
 
         KepDispatchTimers(TimeCounter);
+
+        //
+        // Even out the load between processors if the clock interrupt asked
+        // for it. This is done before running the scheduler so that any
+        // threads pulled onto this processor can be picked right away.
+        //
+
+        if (ProcessorBlock->Scheduler.BalancePending != FALSE) {
+            ProcessorBlock->Scheduler.BalancePending = FALSE;
+            KepBalanceScheduler(FALSE);
+        }
+
         KeSchedulerEntry(SchedulerReasonDispatchInterrupt);
         ArDisableInterrupts();
 
@@ -1024,6 +1047,19 @@ Return Value:
 
         case ThreadStateRunning:
             PreviousThread->State = ThreadStateReady;
+
+            //
+            // If the thread's affinity changed while it was running, it was
+            // switched out to go elsewhere. Move it now that it's off this
+            // processor.
+            //
+
+            if (!PROCESSOR_AFFINITY_CONTAINS(&(PreviousThread->Affinity),
+                                             Processor->ProcessorNumber)) {
+
+                KepEnforceThreadAffinity(PreviousThread);
+            }
+
             break;
 
         //
@@ -207,6 +207,69 @@ Return Value:
     return (PKTHREAD)Thread;
 }
 
+ULONG
+KepArchGetProcessorDomain (
+    ULONGLONG PhysicalId
+    )
+
+/*++
+
+Routine Description:
+
+    This routine determines which scheduling domain (physical package) a
+    processor belongs to. Processors in the same domain share caches, so
+    moving threads between them is cheaper than moving threads across domains.
+
+Arguments:
+
+    PhysicalId - Supplies the physical identifier of the processor, as
+        enumerated by the firmware tables.
+
+Return Value:
+
+    Returns the scheduling domain identifier for the processor.
+
+--*/
+
+{
+
+    ULONG Eax;
+    ULONG Ebx;
+    ULONG Ecx;
+    ULONG Edx;
+    ULONG LogicalCount;
+    ULONG Shift;
+
+    //
+    // The physical ID is the local APIC ID from the MADT. The low bits of the
+    // APIC ID select the logical processor within a package, and CPUID
+    // reports how many logical processors a package holds. This assumes all
+    // packages in the system are the same shape.
+    //
+
+    Eax = X86_CPUID_IDENTIFICATION;
+    ArCpuid(&Eax, &Ebx, &Ecx, &Edx);
+    if (Eax < X86_CPUID_BASIC_INFORMATION) {
+        return 0;
+    }
+
+    Eax = X86_CPUID_BASIC_INFORMATION;
+    ArCpuid(&Eax, &Ebx, &Ecx, &Edx);
+    if ((Edx & X86_CPUID_BASIC_EDX_HYPER_THREADING) == 0) {
+        return (ULONG)PhysicalId;
+    }
+
+    LogicalCount = (Ebx & X86_CPUID_BASIC_EBX_LOGICAL_PROCESSORS_MASK) >>
+                   X86_CPUID_BASIC_EBX_LOGICAL_PROCESSORS_SHIFT;
+
+    Shift = 0;
+    while ((Shift < 8) && ((1 << Shift) < LogicalCount)) {
+        Shift += 1;
+    }
+
+    return (ULONG)(PhysicalId >> Shift);
+}
+
 //
 // --------------------------------------------------------- Internal Functions
 //
@@ -2926,6 +2926,140 @@ Return Value:
     return STATUS_SUCCESS;
 }
 
+KSTATUS
+MmpShareSectionMappings (
+    PADDRESS_SPACE Destination,
+    PADDRESS_SPACE Source,
+    PVOID SectionAddress,
+    UINTN SectionSize,
+    PVOID VirtualAddress,
+    UINTN Size
+    )
+
+/*++
+
+Routine Description:
+
+    This routine makes the mappings of the given virtual address region
+    available read-only to another process during fork. Wherever the
+    architecture allows it, whole page tables that lie entirely within the
+    section are shared between the two address spaces and only copied when
+    one side first changes them. The remainder of the region is handed to
+    the copy and change routine.
+
+Arguments:
+
+    Destination - Supplies a pointer to the destination address space.
+
+    Source - Supplies a pointer to the source address space, which must be
+        the current address space.
+
+    SectionAddress - Supplies the starting virtual address of the image
+        section that owns the region.
+
+    SectionSize - Supplies the size of the image section, in bytes.
+
+    VirtualAddress - Supplies the starting virtual address of the memory range.
+
+    Size - Supplies the size of the virtual address region, in bytes.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    //
+    // First level descriptors on ARM have no access permission bits, so
+    // there is no way to write protect a whole page table at once. Always
+    // copy the mappings.
+    //
+
+    return MmpCopyAndChangeSectionMappings(Destination,
+                                           Source,
+                                           VirtualAddress,
+                                           Size);
+}
+
+VOID
+MmpUnsharePageTable (
+    PADDRESS_SPACE AddressSpace,
+    PVOID VirtualAddress
+    )
+
+/*++
+
+Routine Description:
+
+    This routine ensures that the page table servicing the given user mode
+    virtual address is private to the given address space, copying it if it
+    is currently shared with another process.
+
+Arguments:
+
+    AddressSpace - Supplies a pointer to the address space.
+
+    VirtualAddress - Supplies the virtual address whose page table should be
+        made private.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    //
+    // Page tables are never shared on ARM.
+    //
+
+    return;
+}
+
+BOOL
+MmpCheckAndClearAccessedBit (
+    PADDRESS_SPACE AddressSpace,
+    PVOID VirtualAddress
+    )
+
+/*++
+
+Routine Description:
+
+    This routine determines whether the page at the given virtual address in
+    the given address space has been touched since the last time this routine
+    was called on it, and clears the page table entry's accessed bit so the
+    next reference can be observed.
+
+Arguments:
+
+    AddressSpace - Supplies a pointer to the address space that owns the
+        mapping.
+
+    VirtualAddress - Supplies the virtual address of the page to check.
+
+Return Value:
+
+    TRUE if the page was accessed since the bit was last cleared.
+
+    FALSE if the page was not accessed or is not mapped.
+
+--*/
+
+{
+
+    //
+    // ARMv7 page tables are not set up with a hardware access flag, so there
+    // is nothing to sample. Report every page as unreferenced, which leaves
+    // reclaim aging pages through the inactive state in scan order.
+    //
+
+    return FALSE;
+}
+
 VOID
 MmpCreatePageTables (
     PVOID VirtualAddress,
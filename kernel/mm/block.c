@@ -60,6 +60,14 @@ Module Name:
 
 #define BLOCK_ALLOCATOR_TRIM_DIVISOR 4
 
+//
+// Define the number of different starting offsets that colored block
+// allocators rotate through for new segments. Each color shifts the segment's
+// first block by the allocator's alignment.
+//
+
+#define BLOCK_ALLOCATOR_COLOR_COUNT 8
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -139,6 +147,9 @@ Structure Description:
     Tag - Stores an identifier to associate with the block allocations, useful
         for debugging and leak detection.
 
+    NextColor - Stores the offset in bytes that the first block of the next
+        segment will start at, for allocators created with the color flag.
+
 --*/
 
 struct _BLOCK_ALLOCATOR {
@@ -155,6 +166,7 @@ struct _BLOCK_ALLOCATOR {
     UINTN FreeBlocks;
     ULONG Alignment;
     ULONG Tag;
+    ULONG NextColor;
 };
 
 //
@@ -828,6 +840,58 @@ Return Value:
     return;
 }
 
+VOID
+MmpGetBlockAllocatorUsage (
+    PBLOCK_ALLOCATOR Allocator,
+    PUINTN SegmentCount,
+    PUINTN TotalBlocks,
+    PUINTN FreeBlocks
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns a snapshot of how much memory a block allocator is
+    holding. This routine must be called at low level.
+
+Arguments:
+
+    Allocator - Supplies a pointer to the block allocator to query.
+
+    SegmentCount - Supplies a pointer where the number of segments in the
+        allocator will be returned.
+
+    TotalBlocks - Supplies a pointer where the number of blocks in all
+        segments will be returned.
+
+    FreeBlocks - Supplies a pointer where the number of blocks not currently
+        allocated will be returned.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    UINTN Index;
+    UINTN Total;
+
+    Total = 0;
+    KeAcquireQueuedLock(Allocator->Lock);
+    for (Index = 0; Index < Allocator->SegmentCount; Index += 1) {
+        Total += Allocator->Segments[Index]->TotalBlocks;
+    }
+
+    *SegmentCount = Allocator->SegmentCount;
+    *TotalBlocks = Total;
+    *FreeBlocks = Allocator->FreeBlocks;
+    KeReleaseQueuedLock(Allocator->Lock);
+    return;
+}
+
 //
 // --------------------------------------------------------- Internal Functions
 //
@@ -938,6 +1002,7 @@ Return Value:
     ULONG BitmapSize;
     ULONG BlockSize;
     ULONG BlocksPerPage;
+    ULONG Color;
     UINTN LastBitmapBit;
     UINTN LastBitmapIndex;
     UINTN LastBitmapMask;
@@ -987,6 +1052,7 @@ Return Value:
     Segment = NULL;
     SegmentSize = 0;
     PhysicalRunSize = 0;
+    Color = 0;
 
     //
     // Physically contiguous blocks cannot use pool, so carefully calculate
@@ -1128,6 +1194,26 @@ Return Value:
     //
 
     } else {
+
+        //
+        // Colored allocators start each new segment's blocks at a different
+        // offset so that the same block in different segments does not
+        // always land in the same cache lines. The color is only a placement
+        // hint, so it is fine that the lock is not held to advance it.
+        //
+
+        if ((Allocator->Flags & BLOCK_ALLOCATOR_FLAG_COLOR) != 0) {
+            Color = Allocator->NextColor;
+            Allocator->NextColor += Allocator->Alignment;
+            if (Allocator->NextColor >=
+                (Allocator->Alignment * BLOCK_ALLOCATOR_COLOR_COUNT)) {
+
+                Allocator->NextColor = 0;
+            }
+
+            AllocationSize += Color;
+        }
+
         if (NonPaged != FALSE) {
             Segment = MmAllocateNonPagedPool(AllocationSize + SegmentSize,
                                              Allocator->Tag);
@@ -1150,6 +1236,8 @@ Return Value:
         VirtualAddress = (PVOID)(UINTN)ALIGN_RANGE_UP((UINTN)VirtualAddress,
                                                       Allocator->Alignment);
 
+        VirtualAddress = (PVOID)((UINTN)VirtualAddress + Color);
+
         ASSERT(((UINTN)VirtualAddress + SegmentSize) <=
                ((UINTN)Segment + AllocationSize + SegmentSize));
 
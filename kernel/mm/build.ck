@@ -41,6 +41,7 @@ function build() {
         "paging.c",
         "physical.c",
         "kpools.c",
+        "slab.c",
         "virtual.c",
         "fault.c"
     ];
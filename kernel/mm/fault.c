@@ -280,6 +280,14 @@ Return Value:
             //
 
             } else {
+
+                //
+                // Page tables lent out by fork are copied the first time
+                // either process writes to the region they cover. Take the
+                // private copy before breaking the page's inheritance.
+                //
+
+                MmpUnsharePageTable(Process->AddressSpace, FaultingAddress);
                 Status = MmpIsolateImageSection(ImageSection, PageOffset);
 
                 //
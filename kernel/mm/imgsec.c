@@ -680,6 +680,240 @@ Return Value:
     return Status;
 }
 
+KSTATUS
+MmSetImageSectionRegionAdvice (
+    PVOID Address,
+    UINTN Size,
+    IO_ADVICE Advice
+    )
+
+/*++
+
+Routine Description:
+
+    This routine applies access pattern advice to the image sections of the
+    current process that cover the given address range. Sequential and random
+    advice are recorded on the sections and steer read-ahead when their pages
+    are faulted in from the backing file. Will-need advice starts reading the
+    backing file for the range in the background. Fault around advice lets
+    anonymous sections fault in whole aligned blocks of memory at once.
+
+Arguments:
+
+    Address - Supplies the starting address of the region.
+
+    Size - Supplies the size of the region.
+
+    Advice - Supplies the expected access pattern for the region.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_INVALID_ADDRESS_RANGE if some of the range is not mapped. No
+    advice is applied in this case.
+
+    Other error codes if a section could not be split.
+
+--*/
+
+{
+
+    PADDRESS_SPACE AddressSpace;
+    HANDLE BackingHandle;
+    IO_OFFSET BackingOffset;
+    PLIST_ENTRY CurrentEntry;
+    PVOID End;
+    ULONG ChangeMask;
+    PVOID MappedEnd;
+    ULONG NewFlags;
+    UINTN PageSize;
+    PKPROCESS Process;
+    PVOID RegionEnd;
+    PVOID RegionStart;
+    PIMAGE_SECTION Section;
+    PVOID SectionEnd;
+    KSTATUS Status;
+
+    PageSize = MmPageSize();
+
+    ASSERT(IS_ALIGNED((UINTN)Address | Size, PageSize));
+
+    ChangeMask = IMAGE_SECTION_ACCESS_ADVICE_MASK;
+    NewFlags = 0;
+    if (Advice == IoAdviceSequential) {
+        NewFlags = IMAGE_SECTION_SEQUENTIAL;
+
+    } else if (Advice == IoAdviceRandom) {
+        NewFlags = IMAGE_SECTION_RANDOM;
+
+    } else if (Advice == IoAdviceFaultAround) {
+        ChangeMask = IMAGE_SECTION_FAULT_AROUND;
+        NewFlags = IMAGE_SECTION_FAULT_AROUND;
+
+    } else if (Advice == IoAdviceNoFaultAround) {
+        ChangeMask = IMAGE_SECTION_FAULT_AROUND;
+
+    } else if (Advice != IoAdviceNormal) {
+        ChangeMask = 0;
+    }
+
+    Process = PsGetCurrentProcess();
+    AddressSpace = Process->AddressSpace;
+    MmAcquireAddressSpaceLock(AddressSpace);
+    Status = STATUS_SUCCESS;
+    End = Address + Size;
+
+    //
+    // Make sure the whole range is mapped by sections that can take the
+    // advice before changing anything, so that failed advice is not left
+    // half applied.
+    //
+
+    MappedEnd = Address;
+    CurrentEntry = AddressSpace->SectionListHead.Next;
+    while (CurrentEntry != &(AddressSpace->SectionListHead)) {
+        Section = LIST_VALUE(CurrentEntry, IMAGE_SECTION, AddressListEntry);
+        if ((Section->VirtualAddress >= End) ||
+            (Section->VirtualAddress > MappedEnd)) {
+
+            break;
+        }
+
+        CurrentEntry = CurrentEntry->Next;
+        SectionEnd = Section->VirtualAddress + Section->Size;
+        if (SectionEnd <= MappedEnd) {
+            continue;
+        }
+
+        //
+        // Kernel sections are never advised.
+        //
+
+        if ((Advice != IoAdviceWillNeed) &&
+            (Section->AddressSpace == MmKernelAddressSpace)) {
+
+            Status = STATUS_NOT_SUPPORTED;
+            goto SetImageSectionRegionAdviceEnd;
+        }
+
+        MappedEnd = SectionEnd;
+    }
+
+    if (MappedEnd < End) {
+        Status = STATUS_INVALID_ADDRESS_RANGE;
+        goto SetImageSectionRegionAdviceEnd;
+    }
+
+    CurrentEntry = AddressSpace->SectionListHead.Next;
+    while (CurrentEntry != &(AddressSpace->SectionListHead)) {
+        Section = LIST_VALUE(CurrentEntry, IMAGE_SECTION, AddressListEntry);
+        if (Section->VirtualAddress >= End) {
+            break;
+        }
+
+        CurrentEntry = CurrentEntry->Next;
+        SectionEnd = Section->VirtualAddress + Section->Size;
+        if (SectionEnd <= Address) {
+            continue;
+        }
+
+        RegionStart = Section->VirtualAddress;
+        if (RegionStart < Address) {
+            RegionStart = Address;
+        }
+
+        RegionEnd = SectionEnd;
+        if (RegionEnd > End) {
+            RegionEnd = End;
+        }
+
+        //
+        // Will-need advice kicks off asynchronous reads of the backing file.
+        // Anonymous sections have nothing to read ahead.
+        //
+
+        if (Advice == IoAdviceWillNeed) {
+            BackingHandle = INVALID_HANDLE;
+            BackingOffset = 0;
+            KeAcquireQueuedLock(Section->Lock);
+            if (((Section->Flags & IMAGE_SECTION_NO_IMAGE_BACKING) == 0) &&
+                (Section->ImageBacking.DeviceHandle != INVALID_HANDLE)) {
+
+                MmpImageSectionAddImageBackingReference(Section);
+                BackingHandle = Section->ImageBacking.DeviceHandle;
+                BackingOffset = Section->ImageBacking.Offset +
+                                (RegionStart - Section->VirtualAddress);
+            }
+
+            KeReleaseQueuedLock(Section->Lock);
+            if (BackingHandle != INVALID_HANDLE) {
+                IoReadAhead(BackingHandle,
+                            BackingOffset,
+                            RegionEnd - RegionStart);
+
+                MmpImageSectionReleaseImageBackingReference(Section);
+            }
+
+            continue;
+        }
+
+        //
+        // The remaining advice only changes how faults are serviced, so skip
+        // sections that already agree.
+        //
+
+        if ((Section->Flags & ChangeMask) == NewFlags) {
+            continue;
+        }
+
+        //
+        // Split off the parts of the section outside of the region, as is done
+        // when changing access.
+        //
+
+        if (Section->VirtualAddress < Address) {
+            Status = MmpClipImageSection(&(AddressSpace->SectionListHead),
+                                         Address,
+                                         0,
+                                         Section);
+
+            if (!KSUCCESS(Status)) {
+                break;
+            }
+
+            ASSERT(Section->VirtualAddress + Section->Size == Address);
+
+            CurrentEntry = Section->AddressListEntry.Next;
+            continue;
+        }
+
+        if (SectionEnd > End) {
+            Status = MmpClipImageSection(&(AddressSpace->SectionListHead),
+                                         End,
+                                         0,
+                                         Section);
+
+            if (!KSUCCESS(Status)) {
+                break;
+            }
+
+            ASSERT(Section->VirtualAddress + Section->Size == End);
+
+            CurrentEntry = Section->AddressListEntry.Next;
+        }
+
+        KeAcquireQueuedLock(Section->Lock);
+        Section->Flags &= ~ChangeMask;
+        Section->Flags |= NewFlags;
+        KeReleaseQueuedLock(Section->Lock);
+    }
+
+SetImageSectionRegionAdviceEnd:
+    MmReleaseAddressSpaceLock(AddressSpace);
+    return Status;
+}
+
 PVOID
 MmGetObjectForAddress (
     PVOID Address,
@@ -761,6 +995,46 @@ Return Value:
     return Section;
 }
 
+VOID
+MmAddObjectReference (
+    PVOID Object,
+    BOOL Shared
+    )
+
+/*++
+
+Routine Description:
+
+    This routine adds another reference to an object returned when getting
+    the object for a user mode address. Each reference must be released with
+    a call to release the object reference.
+
+Arguments:
+
+    Object - Supplies a pointer to the object returned when the address was
+        looked up.
+
+    Shared - Supplies the shared boolean that was returned when the address was
+        looked up.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    if (Shared != FALSE) {
+        IoFileObjectAddReference(Object);
+
+    } else {
+        MmpImageSectionAddReference(Object);
+    }
+
+    return;
+}
+
 VOID
 MmReleaseObjectReference (
     PVOID Object,
@@ -1393,14 +1667,18 @@ Return Value:
     INSERT_BEFORE(&(NewSection->CopyListEntry), &(SectionToCopy->ChildList));
 
     //
-    // Convert the mapping to read-only and copy the mappings to the
-    // destination in one skillful maneuver.
+    // Make the mappings read-only to the destination. Page tables that lie
+    // entirely within this section are lent to the child rather than copied,
+    // so fork time does not grow with the size of the section. The child's
+    // inherit bitmap above already accounts for every page either way.
     //
 
     if (SectionToCopy->MinTouched < SectionToCopy->MaxTouched) {
-        Status = MmpCopyAndChangeSectionMappings(
+        Status = MmpShareSectionMappings(
                         DestinationAddressSpace,
                         SectionToCopy->AddressSpace,
+                        SectionToCopy->VirtualAddress,
+                        SectionToCopy->Size,
                         SectionToCopy->MinTouched,
                         SectionToCopy->MaxTouched - SectionToCopy->MinTouched);
 
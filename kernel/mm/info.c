@@ -31,6 +31,7 @@ Module Name:
 //
 
 #include <minoca/kernel/kernel.h>
+#include "mmp.h"
 
 //
 // ---------------------------------------------------------------- Definitions
@@ -106,6 +107,10 @@ Return Value:
         Status = MmpGetSetSystemMemoryInformation(Data, DataSize, Set);
         break;
 
+    case MmInformationObjectCacheStatistics:
+        Status = MmpGetObjectCacheStatistics(Data, DataSize, Set);
+        break;
+
     default:
         Status = STATUS_INVALID_PARAMETER;
         *DataSize = 0;
@@ -327,6 +327,11 @@ Return Value:
             goto InitializeEnd;
         }
 
+        Status = MmpInitializeObjectCaches(Phase);
+        if (!KSUCCESS(Status)) {
+            goto InitializeEnd;
+        }
+
         Status = MmpArchInitialize(Parameters, 2);
         if (!KSUCCESS(Status)) {
             goto InitializeEnd;
@@ -357,6 +362,26 @@ Return Value:
         if (MmPhysicalPageZeroAvailable != FALSE) {
             MmpAddPageZeroDescriptorsToMdl(&MmKernelVirtualSpace);
         }
+
+        //
+        // Now that work items and threads can run, turn on the per-processor
+        // pool and physical page caches and object cache reclaim.
+        //
+
+        Status = MmpInitializePoolCaches();
+        if (!KSUCCESS(Status)) {
+            goto InitializeEnd;
+        }
+
+        Status = MmpInitializePhysicalPageCaches();
+        if (!KSUCCESS(Status)) {
+            goto InitializeEnd;
+        }
+
+        Status = MmpInitializeObjectCaches(Phase);
+        if (!KSUCCESS(Status)) {
+            goto InitializeEnd;
+        }
     }
 
 InitializeEnd:
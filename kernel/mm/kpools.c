@@ -52,6 +52,20 @@ Module Name:
 
 #define KERNEL_STACK_CACHE_SIZE 10
 
+//
+// Define how far above the largest size class an allocation's usable size
+// can be and still be cached in that class. The heap sometimes hands out a
+// little more than was asked for rather than leave an unusable sliver.
+//
+
+#define POOL_CACHE_SLACK 64
+
+//
+// Define how often the pool caches are trimmed, in microseconds.
+//
+
+#define POOL_CACHE_TRIM_INTERVAL MICROSECONDS_PER_SECOND
+
 //
 // Do not collect pool tag statistics on non-debug builds.
 //
@@ -115,6 +129,41 @@ MmpHandlePoolCorruption (
     PVOID Parameter
     );
 
+PVOID
+MmpAllocateFromPoolCache (
+    POOL_TYPE PoolType,
+    PUINTN Size,
+    ULONG Tag
+    );
+
+BOOL
+MmpFreeToPoolCache (
+    POOL_TYPE PoolType,
+    PVOID Allocation
+    );
+
+VOID
+MmpReleasePoolCacheEntries (
+    POOL_TYPE PoolType,
+    PMM_POOL_CACHE_ENTRY Entries,
+    ULONG Count
+    );
+
+VOID
+MmpTrimPoolCaches (
+    BOOL Drain
+    );
+
+VOID
+MmpPoolCacheTrimDpcRoutine (
+    PDPC Dpc
+    );
+
+VOID
+MmpPoolCacheTrimWorkRoutine (
+    PVOID Parameter
+    );
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -144,6 +193,21 @@ KSPIN_LOCK MmFreeKernelStackLock;
 LIST_ENTRY MmFreeKernelStackList;
 ULONG MmFreeKernelStackCount;
 
+//
+// Small allocations are served out of per-processor caches of recently freed
+// allocations, which are bucketed into these size classes. The caches are
+// trimmed periodically so memory does not sit idle in them.
+//
+
+const USHORT MmPoolCacheClassSizes[MM_POOL_CACHE_CLASS_COUNT] = {
+    32, 64, 96, 128, 192, 256, 384, 512
+};
+
+BOOL MmPoolCachesEnabled = FALSE;
+PKTIMER MmPoolCacheTrimTimer;
+PDPC MmPoolCacheTrimDpc;
+PWORK_ITEM MmPoolCacheTrimWorkItem;
+
 //
 // ------------------------------------------------------------------ Functions
 //
@@ -194,6 +258,15 @@ Return Value:
 
     ASSERT((Size != 0) && (Tag != 0) && (Tag != 0xFFFFFFFF));
 
+    if ((MmPoolCachesEnabled != FALSE) &&
+        (Size <= MM_POOL_CACHE_MAXIMUM_SIZE)) {
+
+        Allocation = MmpAllocateFromPoolCache(PoolType, &Size, Tag);
+        if (Allocation != NULL) {
+            return Allocation;
+        }
+    }
+
     if (PoolType == PoolTypeNonPaged) {
         OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
         KeAcquireSpinLock(&MmNonPagedPoolLock);
@@ -336,6 +409,12 @@ Return Value:
 
     RUNLEVEL OldRunLevel;
 
+    if ((MmPoolCachesEnabled != FALSE) && (Allocation != NULL)) {
+        if (MmpFreeToPoolCache(PoolType, Allocation) != FALSE) {
+            return;
+        }
+    }
+
     if (PoolType == PoolTypeNonPaged) {
         OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
         KeAcquireSpinLock(&MmNonPagedPoolLock);
@@ -420,6 +499,15 @@ Return Value:
     PagedPoolLockHeld = FALSE;
     TotalBuffer = NULL;
 
+    //
+    // Allocations sitting in the processor caches still count against the
+    // tag that last used them. Empty the caches so the numbers are exact.
+    //
+
+    if (MmPoolCachesEnabled != FALSE) {
+        MmpTrimPoolCaches(TRUE);
+    }
+
     //
     // Lock non-paged pool in order to collect the current statistics.
     //
@@ -599,6 +687,10 @@ Return Value:
 
     ASSERT(KeGetRunLevel() == RunLevelLow);
 
+    if (MmPoolCachesEnabled != FALSE) {
+        MmpTrimPoolCaches(TRUE);
+    }
+
     OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
     KeAcquireSpinLock(&MmNonPagedPoolLock);
     RtlDebugPrint("Non-Paged Pool:\n");
@@ -1007,6 +1099,94 @@ Return Value:
     return;
 }
 
+KSTATUS
+MmpInitializePoolCaches (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine turns on the per-processor pool caches and starts the timer
+    that periodically trims them. This must be called once the system work
+    queue is available.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    ULONGLONG DueTime;
+    ULONGLONG Period;
+    KSTATUS Status;
+
+    MmPoolCacheTrimTimer = KeCreateTimer(MM_ALLOCATION_TAG);
+    if (MmPoolCacheTrimTimer == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto InitializePoolCachesEnd;
+    }
+
+    MmPoolCacheTrimDpc = KeCreateDpc(MmpPoolCacheTrimDpcRoutine, NULL);
+    if (MmPoolCacheTrimDpc == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto InitializePoolCachesEnd;
+    }
+
+    MmPoolCacheTrimWorkItem = KeCreateWorkItem(NULL,
+                                               WorkPriorityNormal,
+                                               MmpPoolCacheTrimWorkRoutine,
+                                               NULL,
+                                               MM_ALLOCATION_TAG);
+
+    if (MmPoolCacheTrimWorkItem == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto InitializePoolCachesEnd;
+    }
+
+    Period = KeConvertMicrosecondsToTimeTicks(POOL_CACHE_TRIM_INTERVAL);
+    DueTime = KeGetRecentTimeCounter() + Period;
+    Status = KeQueueTimer(MmPoolCacheTrimTimer,
+                          TimerQueueSoftWake,
+                          DueTime,
+                          Period,
+                          0,
+                          MmPoolCacheTrimDpc);
+
+    if (!KSUCCESS(Status)) {
+        goto InitializePoolCachesEnd;
+    }
+
+    MmPoolCachesEnabled = TRUE;
+
+InitializePoolCachesEnd:
+    if (!KSUCCESS(Status)) {
+        if (MmPoolCacheTrimWorkItem != NULL) {
+            KeDestroyWorkItem(MmPoolCacheTrimWorkItem);
+            MmPoolCacheTrimWorkItem = NULL;
+        }
+
+        if (MmPoolCacheTrimDpc != NULL) {
+            KeDestroyDpc(MmPoolCacheTrimDpc);
+            MmPoolCacheTrimDpc = NULL;
+        }
+
+        if (MmPoolCacheTrimTimer != NULL) {
+            KeDestroyTimer(MmPoolCacheTrimTimer);
+            MmPoolCacheTrimTimer = NULL;
+        }
+    }
+
+    return Status;
+}
+
 //
 // --------------------------------------------------------- Internal Functions
 //
@@ -1384,3 +1564,435 @@ Return Value:
     return;
 }
 
+PVOID
+MmpAllocateFromPoolCache (
+    POOL_TYPE PoolType,
+    PUINTN Size,
+    ULONG Tag
+    )
+
+/*++
+
+Routine Description:
+
+    This routine attempts to satisfy a small pool allocation out of the
+    current processor's pool cache.
+
+Arguments:
+
+    PoolType - Supplies the type of pool to allocate from.
+
+    Size - Supplies a pointer to the size of the allocation request, in bytes.
+        On output, this is rounded up to the size class the allocation
+        belongs to, which is what should be allocated from the pool if the
+        cache comes up empty.
+
+    Tag - Supplies the identifier to associate with the allocation.
+
+Return Value:
+
+    Returns a cached allocation on success.
+
+    NULL if the cache had nothing suitable.
+
+--*/
+
+{
+
+    PVOID Allocation;
+    PMM_POOL_CACHE Cache;
+    ULONG Class;
+    PMEMORY_HEAP Heap;
+    ULONG Index;
+    PMM_POOL_CACHE_MAGAZINE Magazine;
+    BOOL MatchTag;
+    RUNLEVEL OldRunLevel;
+
+    if (PoolType == PoolTypeNonPaged) {
+        Heap = &MmNonPagedPool;
+
+    } else if (PoolType == PoolTypePaged) {
+
+        ASSERT(KeGetRunLevel() == RunLevelLow);
+
+        Heap = &MmPagedPool;
+
+    } else {
+        return NULL;
+    }
+
+    for (Class = 0; Class < MM_POOL_CACHE_CLASS_COUNT; Class += 1) {
+        if (*Size <= MmPoolCacheClassSizes[Class]) {
+            break;
+        }
+    }
+
+    ASSERT(Class < MM_POOL_CACHE_CLASS_COUNT);
+
+    *Size = MmPoolCacheClassSizes[Class];
+
+    //
+    // If the pool is keeping per-tag statistics, only reuse an allocation
+    // made under the same tag. That way handing it back out leaves the
+    // statistics exactly as a real free and allocate would.
+    //
+
+    MatchTag = FALSE;
+    if ((Heap->Flags & MEMORY_HEAP_FLAG_COLLECT_TAG_STATISTICS) != 0) {
+        MatchTag = TRUE;
+    }
+
+    Allocation = NULL;
+    OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+    Cache = &(KeGetCurrentProcessorBlock()->PoolCaches[PoolType - 1]);
+    KeAcquireSpinLock(&(Cache->Lock));
+    Magazine = &(Cache->Magazines[Class]);
+    Index = Magazine->Count;
+    while (Index != 0) {
+        Index -= 1;
+        if ((MatchTag != FALSE) && (Magazine->Entries[Index].Tag != Tag)) {
+            continue;
+        }
+
+        Allocation = Magazine->Entries[Index].Allocation;
+        Magazine->Count -= 1;
+        Magazine->Entries[Index].Allocation =
+                                 Magazine->Entries[Magazine->Count].Allocation;
+
+        Magazine->Entries[Index].Tag = Magazine->Entries[Magazine->Count].Tag;
+        if (Magazine->Count < Magazine->LowWater) {
+            Magazine->LowWater = Magazine->Count;
+        }
+
+        break;
+    }
+
+    KeReleaseSpinLock(&(Cache->Lock));
+    KeLowerRunLevel(OldRunLevel);
+    return Allocation;
+}
+
+BOOL
+MmpFreeToPoolCache (
+    POOL_TYPE PoolType,
+    PVOID Allocation
+    )
+
+/*++
+
+Routine Description:
+
+    This routine attempts to park a freed pool allocation in the current
+    processor's pool cache. If the cache for the allocation's size class is
+    full, the older half of it is released back to the pool.
+
+Arguments:
+
+    PoolType - Supplies the type of pool the memory was allocated from.
+
+    Allocation - Supplies a pointer to the allocation being freed.
+
+Return Value:
+
+    TRUE if the allocation was taken by the cache.
+
+    FALSE if the allocation is not cacheable and should be freed to the pool.
+
+--*/
+
+{
+
+    PMM_POOL_CACHE Cache;
+    ULONG Class;
+    MM_POOL_CACHE_ENTRY Flush[MM_POOL_CACHE_DEPTH / 2];
+    ULONG FlushCount;
+    PMEMORY_HEAP Heap;
+    ULONG Index;
+    PMM_POOL_CACHE_MAGAZINE Magazine;
+    RUNLEVEL OldRunLevel;
+    UINTN Size;
+    UINTN Tag;
+
+    if (PoolType == PoolTypeNonPaged) {
+        Heap = &MmNonPagedPool;
+
+    } else if (PoolType == PoolTypePaged) {
+
+        ASSERT(KeGetRunLevel() == RunLevelLow);
+
+        Heap = &MmPagedPool;
+
+    } else {
+        return FALSE;
+    }
+
+    //
+    // Look at the allocation before raising the run level, as the header of
+    // a paged pool allocation may be paged out.
+    //
+
+    RtlHeapQueryAllocation(Heap, Allocation, &Size, &Tag);
+    if ((Size < MmPoolCacheClassSizes[0]) ||
+        (Size > MM_POOL_CACHE_MAXIMUM_SIZE + POOL_CACHE_SLACK)) {
+
+        return FALSE;
+    }
+
+    Class = MM_POOL_CACHE_CLASS_COUNT - 1;
+    while (MmPoolCacheClassSizes[Class] > Size) {
+        Class -= 1;
+    }
+
+    FlushCount = 0;
+    OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+    Cache = &(KeGetCurrentProcessorBlock()->PoolCaches[PoolType - 1]);
+    KeAcquireSpinLock(&(Cache->Lock));
+    Magazine = &(Cache->Magazines[Class]);
+    if (Magazine->Count == MM_POOL_CACHE_DEPTH) {
+        FlushCount = MM_POOL_CACHE_DEPTH / 2;
+        for (Index = 0; Index < MM_POOL_CACHE_DEPTH; Index += 1) {
+            if (Index < FlushCount) {
+                Flush[Index].Allocation = Magazine->Entries[Index].Allocation;
+                Flush[Index].Tag = Magazine->Entries[Index].Tag;
+
+            } else {
+                Magazine->Entries[Index - FlushCount].Allocation =
+                                           Magazine->Entries[Index].Allocation;
+
+                Magazine->Entries[Index - FlushCount].Tag =
+                                                  Magazine->Entries[Index].Tag;
+            }
+        }
+
+        Magazine->Count -= FlushCount;
+        if (Magazine->LowWater > Magazine->Count) {
+            Magazine->LowWater = Magazine->Count;
+        }
+    }
+
+    Magazine->Entries[Magazine->Count].Allocation = Allocation;
+    Magazine->Entries[Magazine->Count].Tag = Tag;
+    Magazine->Count += 1;
+    KeReleaseSpinLock(&(Cache->Lock));
+    KeLowerRunLevel(OldRunLevel);
+    if (FlushCount != 0) {
+        MmpReleasePoolCacheEntries(PoolType, Flush, FlushCount);
+    }
+
+    return TRUE;
+}
+
+VOID
+MmpReleasePoolCacheEntries (
+    POOL_TYPE PoolType,
+    PMM_POOL_CACHE_ENTRY Entries,
+    ULONG Count
+    )
+
+/*++
+
+Routine Description:
+
+    This routine frees a batch of cached allocations back to their pool,
+    acquiring the pool lock only once.
+
+Arguments:
+
+    PoolType - Supplies the type of pool the allocations came from.
+
+    Entries - Supplies an array of cached allocations to free.
+
+    Count - Supplies the number of elements in the array.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG Index;
+    RUNLEVEL OldRunLevel;
+
+    if (PoolType == PoolTypeNonPaged) {
+        OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+        KeAcquireSpinLock(&MmNonPagedPoolLock);
+        for (Index = 0; Index < Count; Index += 1) {
+            RtlHeapFree(&MmNonPagedPool, Entries[Index].Allocation);
+        }
+
+        KeReleaseSpinLock(&MmNonPagedPoolLock);
+        KeLowerRunLevel(OldRunLevel);
+
+    } else {
+
+        ASSERT(PoolType == PoolTypePaged);
+        ASSERT(KeGetRunLevel() == RunLevelLow);
+
+        KeAcquireQueuedLock(MmPagedPoolLock);
+        for (Index = 0; Index < Count; Index += 1) {
+            RtlHeapFree(&MmPagedPool, Entries[Index].Allocation);
+        }
+
+        KeReleaseQueuedLock(MmPagedPoolLock);
+    }
+
+    return;
+}
+
+VOID
+MmpTrimPoolCaches (
+    BOOL Drain
+    )
+
+/*++
+
+Routine Description:
+
+    This routine releases cached allocations from every processor's pool
+    caches back to the pools. This routine must be called at low level.
+
+Arguments:
+
+    Drain - Supplies a boolean indicating whether to release everything
+        (TRUE) or only the allocations that went unused since the last trim
+        (FALSE).
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PMM_POOL_CACHE Cache;
+    ULONG Class;
+    ULONG Count;
+    MM_POOL_CACHE_ENTRY Entries[MM_POOL_CACHE_DEPTH];
+    ULONG Index;
+    PMM_POOL_CACHE_MAGAZINE Magazine;
+    RUNLEVEL OldRunLevel;
+    PPROCESSOR_BLOCK ProcessorBlock;
+    ULONG ProcessorCount;
+    ULONG ProcessorNumber;
+    POOL_TYPE PoolType;
+
+    ASSERT(KeGetRunLevel() == RunLevelLow);
+
+    ProcessorCount = KeGetActiveProcessorCount();
+    for (ProcessorNumber = 0;
+         ProcessorNumber < ProcessorCount;
+         ProcessorNumber += 1) {
+
+        ProcessorBlock = KeGetProcessorBlock(ProcessorNumber);
+        for (PoolType = PoolTypeNonPaged;
+             PoolType < PoolTypeCount;
+             PoolType += 1) {
+
+            Cache = &(ProcessorBlock->PoolCaches[PoolType - 1]);
+            for (Class = 0; Class < MM_POOL_CACHE_CLASS_COUNT; Class += 1) {
+                OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+                KeAcquireSpinLock(&(Cache->Lock));
+                Magazine = &(Cache->Magazines[Class]);
+                Count = Magazine->LowWater;
+                if (Drain != FALSE) {
+                    Count = Magazine->Count;
+                }
+
+                ASSERT(Count <= Magazine->Count);
+
+                //
+                // The oldest entries are at the bottom of the stack.
+                //
+
+                for (Index = 0; Index < Magazine->Count; Index += 1) {
+                    if (Index < Count) {
+                        Entries[Index].Allocation =
+                                           Magazine->Entries[Index].Allocation;
+
+                        Entries[Index].Tag = Magazine->Entries[Index].Tag;
+
+                    } else {
+                        Magazine->Entries[Index - Count].Allocation =
+                                           Magazine->Entries[Index].Allocation;
+
+                        Magazine->Entries[Index - Count].Tag =
+                                                  Magazine->Entries[Index].Tag;
+                    }
+                }
+
+                Magazine->Count -= Count;
+                Magazine->LowWater = Magazine->Count;
+                KeReleaseSpinLock(&(Cache->Lock));
+                KeLowerRunLevel(OldRunLevel);
+                if (Count != 0) {
+                    MmpReleasePoolCacheEntries(PoolType, Entries, Count);
+                }
+            }
+        }
+    }
+
+    return;
+}
+
+VOID
+MmpPoolCacheTrimDpcRoutine (
+    PDPC Dpc
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is called when the pool cache trim timer fires. It kicks the
+    trim work out to low level, since paged pool can only be freed there.
+
+Arguments:
+
+    Dpc - Supplies a pointer to the DPC.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    //
+    // If the previous trim is still queued, there's no need for another.
+    //
+
+    KeQueueWorkItem(MmPoolCacheTrimWorkItem);
+    return;
+}
+
+VOID
+MmpPoolCacheTrimWorkRoutine (
+    PVOID Parameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine periodically trims the per-processor pool caches.
+
+Arguments:
+
+    Parameter - Supplies an unused parameter.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    MmpTrimPoolCaches(FALSE);
+    return;
+}
+
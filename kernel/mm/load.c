@@ -814,6 +814,98 @@ Return Value:
     return Status;
 }
 
+INTN
+MmSysSetMemoryAdvice (
+    PVOID SystemCallParameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine responds to system calls from user mode giving advice about
+    how a region of memory is going to be accessed.
+
+Arguments:
+
+    SystemCallParameter - Supplies a pointer to the parameters supplied with
+        the system call. This structure will be a stack-local copy of the
+        actual parameters passed from user-mode.
+
+Return Value:
+
+    STATUS_SUCCESS or positive integer on success.
+
+    Error status code on failure.
+
+--*/
+
+{
+
+    UINTN PageSize;
+    PSYSTEM_CALL_SET_MEMORY_ADVICE Parameters;
+    KSTATUS Status;
+
+    Parameters = SystemCallParameter;
+    PageSize = MmPageSize();
+
+    //
+    // The range must be page aligned, must not go into kernel space, and must
+    // not overflow. An empty range is allowed and does nothing.
+    //
+
+    if ((IS_ALIGNED((UINTN)Parameters->Address, PageSize) == FALSE) ||
+        (Parameters->Size > MAX_UINTN - PageSize)) {
+        Status = STATUS_INVALID_PARAMETER;
+        goto SysSetMemoryAdviceEnd;
+    }
+
+    Parameters->Size = ALIGN_RANGE_UP(Parameters->Size, PageSize);
+    if ((Parameters->Size != 0) &&
+        ((Parameters->Address == NULL) ||
+         ((Parameters->Address + Parameters->Size) >= KERNEL_VA_START) ||
+         ((Parameters->Address + Parameters->Size) <= Parameters->Address))) {
+
+        Status = STATUS_INVALID_PARAMETER;
+        goto SysSetMemoryAdviceEnd;
+    }
+
+    //
+    // Dropping pages is not supported. Anonymous memory would have to come
+    // back zeroed, which is not advice the caller can safely have ignored.
+    //
+
+    switch (Parameters->Advice) {
+    case IoAdviceNormal:
+    case IoAdviceSequential:
+    case IoAdviceRandom:
+    case IoAdviceWillNeed:
+    case IoAdviceFaultAround:
+    case IoAdviceNoFaultAround:
+        break;
+
+    case IoAdviceDontNeed:
+        Status = STATUS_NOT_SUPPORTED;
+        goto SysSetMemoryAdviceEnd;
+
+    default:
+        Status = STATUS_INVALID_PARAMETER;
+        goto SysSetMemoryAdviceEnd;
+    }
+
+    if (Parameters->Size == 0) {
+        Status = STATUS_SUCCESS;
+        goto SysSetMemoryAdviceEnd;
+    }
+
+    Status = MmSetImageSectionRegionAdvice(Parameters->Address,
+                                           Parameters->Size,
+                                           Parameters->Advice);
+
+SysSetMemoryAdviceEnd:
+    return Status;
+}
+
 INTN
 MmSysFlushMemory (
     PVOID SystemCallParameter
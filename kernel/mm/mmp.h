@@ -44,6 +44,7 @@ Module Name:
 
 #define PAGING_ENTRY_FLAG_PAGING_OUT 0x0001
 #define PAGING_ENTRY_FLAG_FREED      0x0002
+#define PAGING_ENTRY_FLAG_ACTIVE     0x0004
 
 //
 // Define flags for flushing image sections.
@@ -267,7 +268,9 @@ Structure Description:
 
     Flags - Stores a bitmask of flags for the paging entry. See
         PAGING_ENTRY_FLAG_* for definitions. This is only modified by the
-        paging thread.
+        paging thread, except for the active flag, which is set when the page
+        first becomes pagable. The active flag is protected by the physical
+        page lock.
 
     ListEntry - Stores a pointer to the next and previous paging entries in
         a list of paging entries ready for destruction.
@@ -488,6 +491,89 @@ Return Value:
 
 --*/
 
+PHYSICAL_ADDRESS
+MmpTryAllocatePhysicalPages (
+    UINTN PageCount,
+    UINTN Alignment,
+    UINTN Reserve
+    );
+
+/*++
+
+Routine Description:
+
+    This routine attempts to allocate a run of contiguous physical pages
+    without ever waiting for memory to be paged out. It is meant for
+    opportunistic allocations, such as large aligned blocks, that have a
+    cheaper fallback if physical memory is fragmented or tight. The pages
+    start out as non-paged.
+
+Arguments:
+
+    PageCount - Supplies the number of consecutive physical pages required.
+
+    Alignment - Supplies the alignment requirement of the allocation, in pages.
+        Valid values are powers of 2. Values of 1 or 0 indicate no alignment
+        requirement.
+
+    Reserve - Supplies the number of free pages that must remain after the
+        allocation for it to succeed.
+
+Return Value:
+
+    Returns the physical address of the first page of allocated memory on
+    success, or INVALID_PHYSICAL_ADDRESS if no suitable run was free.
+
+--*/
+
+PHYSICAL_ADDRESS
+MmpAllocateZeroedPhysicalPage (
+    VOID
+    );
+
+/*++
+
+Routine Description:
+
+    This routine allocates a single physical page whose contents are zero. The
+    page comes from the pool of pages zeroed ahead of time if one is
+    available, otherwise a page is allocated and zeroed synchronously. Like
+    any other physical allocation, the page starts out as non-paged. This
+    routine must be called at low level.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Returns the physical address of the zeroed page.
+
+--*/
+
+KSTATUS
+MmpInitializePhysicalPageCaches (
+    VOID
+    );
+
+/*++
+
+Routine Description:
+
+    This routine turns on the per-processor physical page caches and starts
+    the thread that keeps the zeroed page pool filled. This must be called
+    once all processors have been started.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Status code.
+
+--*/
+
 PHYSICAL_ADDRESS
 MmpAllocateIdentityMappablePhysicalPages (
     UINTN PageCount,
@@ -668,6 +754,32 @@ Return Value:
 
 --*/
 
+BOOL
+MmpAgePhysicalPage (
+    PHYSICAL_ADDRESS PhysicalAddress
+    );
+
+/*++
+
+Routine Description:
+
+    This routine ages the pagable page at the given physical address and
+    reports whether it is a good candidate for eviction. This is used to
+    decide whether a neighboring page can join a batched page out. The
+    section lock of the image section owning the page must be held.
+
+Arguments:
+
+    PhysicalAddress - Supplies the address of the physical page to check.
+
+Return Value:
+
+    TRUE if the page is inactive and was not referenced.
+
+    FALSE if the page is in use and should stay resident.
+
+--*/
+
 VOID
 MmpMigratePagingEntries (
     PIMAGE_SECTION OldSection,
@@ -1085,6 +1197,106 @@ Return Value:
 
 --*/
 
+KSTATUS
+MmpShareSectionMappings (
+    PADDRESS_SPACE Destination,
+    PADDRESS_SPACE Source,
+    PVOID SectionAddress,
+    UINTN SectionSize,
+    PVOID VirtualAddress,
+    UINTN Size
+    );
+
+/*++
+
+Routine Description:
+
+    This routine makes the mappings of the given virtual address region
+    available read-only to another process during fork. Wherever the
+    architecture allows it, whole page tables that lie entirely within the
+    section are shared between the two address spaces and only copied when
+    one side first changes them. The remainder of the region is handed to
+    the copy and change routine.
+
+Arguments:
+
+    Destination - Supplies a pointer to the destination address space.
+
+    Source - Supplies a pointer to the source address space, which must be
+        the current address space.
+
+    SectionAddress - Supplies the starting virtual address of the image
+        section that owns the region.
+
+    SectionSize - Supplies the size of the image section, in bytes.
+
+    VirtualAddress - Supplies the starting virtual address of the memory range.
+
+    Size - Supplies the size of the virtual address region, in bytes.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+VOID
+MmpUnsharePageTable (
+    PADDRESS_SPACE AddressSpace,
+    PVOID VirtualAddress
+    );
+
+/*++
+
+Routine Description:
+
+    This routine ensures that the page table servicing the given user mode
+    virtual address is private to the given address space, copying it if it
+    is currently shared with another process.
+
+Arguments:
+
+    AddressSpace - Supplies a pointer to the address space.
+
+    VirtualAddress - Supplies the virtual address whose page table should be
+        made private.
+
+Return Value:
+
+    None.
+
+--*/
+
+BOOL
+MmpCheckAndClearAccessedBit (
+    PADDRESS_SPACE AddressSpace,
+    PVOID VirtualAddress
+    );
+
+/*++
+
+Routine Description:
+
+    This routine determines whether the page at the given virtual address in
+    the given address space has been touched since the last time this routine
+    was called on it, and clears the page table entry's accessed bit so the
+    next reference can be observed.
+
+Arguments:
+
+    AddressSpace - Supplies a pointer to the address space that owns the
+        mapping.
+
+    VirtualAddress - Supplies the virtual address of the page to check.
+
+Return Value:
+
+    TRUE if the page was accessed since the bit was last cleared.
+
+    FALSE if the page was not accessed or is not mapped.
+
+--*/
+
 VOID
 MmpCreatePageTables (
     PVOID VirtualAddress,
@@ -2050,6 +2262,144 @@ Return Value:
 
 --*/
 
+KSTATUS
+MmpInitializePoolCaches (
+    VOID
+    );
+
+/*++
+
+Routine Description:
+
+    This routine turns on the per-processor pool caches and starts the timer
+    that periodically trims them. This must be called once the system work
+    queue is available.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+VOID
+MmpGetBlockAllocatorUsage (
+    PBLOCK_ALLOCATOR Allocator,
+    PUINTN SegmentCount,
+    PUINTN TotalBlocks,
+    PUINTN FreeBlocks
+    );
+
+/*++
+
+Routine Description:
+
+    This routine returns a snapshot of how much memory a block allocator is
+    holding. This routine must be called at low level.
+
+Arguments:
+
+    Allocator - Supplies a pointer to the block allocator to query.
+
+    SegmentCount - Supplies a pointer where the number of segments in the
+        allocator will be returned.
+
+    TotalBlocks - Supplies a pointer where the number of blocks in all
+        segments will be returned.
+
+    FreeBlocks - Supplies a pointer where the number of blocks not currently
+        allocated will be returned.
+
+Return Value:
+
+    None.
+
+--*/
+
+KSTATUS
+MmpInitializeObjectCaches (
+    ULONG Phase
+    );
+
+/*++
+
+Routine Description:
+
+    This routine initializes object cache support. Phase 2 sets up the list
+    of caches so that caches can be created. Phase 3 sets up memory pressure
+    reclaim, which needs the system work queue.
+
+Arguments:
+
+    Phase - Supplies the memory manager initialization phase.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+VOID
+MmpRequestObjectCacheReclaim (
+    VOID
+    );
+
+/*++
+
+Routine Description:
+
+    This routine asks all object caches to give back the free objects they
+    are holding. The reclaim happens on a work item, so this routine is safe
+    to call from the paging thread.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    None.
+
+--*/
+
+KSTATUS
+MmpGetObjectCacheStatistics (
+    PVOID Data,
+    PUINTN DataSize,
+    BOOL Set
+    );
+
+/*++
+
+Routine Description:
+
+    This routine gets usage statistics for every object cache in the system.
+
+Arguments:
+
+    Data - Supplies a pointer to the data buffer where the data is either
+        returned for a get operation or given for a set operation.
+
+    DataSize - Supplies a pointer that on input contains the size of the
+        data buffer. On output, contains the required size of the data buffer.
+
+    Set - Supplies a boolean indicating if this is a get operation (FALSE) or
+        a set operation (TRUE).
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_BUFFER_TOO_SMALL if not all entries fit. As many entries as fit are
+    still returned.
+
+    Other status codes on failure.
+
+--*/
+
 VOID
 MmpSendTlbInvalidateIpi (
     PADDRESS_SPACE AddressSpace,
@@ -2260,6 +2610,37 @@ Return Value:
 
 --*/
 
+BOOL
+MmpCheckAndClearSectionAccessedBit (
+    PIMAGE_SECTION OwningSection,
+    UINTN PageOffset
+    );
+
+/*++
+
+Routine Description:
+
+    This routine determines whether a page has been referenced through any
+    of its mappings since the last time this routine was called on it. The
+    page is checked in the owning section and in every child that inherits
+    it, and the accessed bit is cleared in each of them. The section lock
+    must be held.
+
+Arguments:
+
+    OwningSection - Supplies a pointer to the section that owns the page.
+
+    PageOffset - Supplies the offset in pages from the beginning of the section
+        where the page belongs.
+
+Return Value:
+
+    TRUE if the page was referenced in any section mapping it.
+
+    FALSE if the page was not referenced.
+
+--*/
+
 PPAGING_ENTRY
 MmpCreatePagingEntry (
     PIMAGE_SECTION ImageSection,
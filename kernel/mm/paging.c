@@ -75,6 +75,16 @@ Module Name:
 #define PAGE_IN_CONTEXT_FLAG_ALLOCATE_IRP        0x00000002
 #define PAGE_IN_CONTEXT_FLAG_ALLOCATE_SWAP_SPACE 0x00000004
 #define PAGE_IN_CONTEXT_FLAG_ALLOCATE_MASK       0x00000007
+#define PAGE_IN_CONTEXT_FLAG_ZERO_PAGE           0x00000008
+#define PAGE_IN_CONTEXT_FLAG_PAGE_ZEROED         0x00000010
+
+//
+// Define the size of the aligned blocks that anonymous sections advised to
+// fault around populate all at once. This is an order 9 physical allocation
+// with 4KB pages, mapped with individual page table entries.
+//
+
+#define FAULT_AROUND_BLOCK_SIZE (2 * _1MB)
 
 //
 // ------------------------------------------------------ Data Type Definitions
@@ -204,6 +214,18 @@ MmpPageInAnonymousSection (
     PIO_BUFFER LockedIoBuffer
     );
 
+BOOL
+MmpCanFaultAroundBlock (
+    PIMAGE_SECTION Section,
+    PVOID BlockAddress
+    );
+
+KSTATUS
+MmpFaultAroundBlock (
+    PIMAGE_SECTION Section,
+    PVOID BlockAddress
+    );
+
 KSTATUS
 MmpPageInSharedSection (
     PIMAGE_SECTION ImageSection,
@@ -1343,6 +1365,16 @@ Return Value:
             if (PhysicalAddress == INVALID_PHYSICAL_ADDRESS) {
                 break;
             }
+
+            //
+            // Also stop at pages that are active or were referenced since
+            // they were last looked at, so that batching the write does not
+            // evict a working set along with the cold page that started it.
+            //
+
+            if (MmpAgePhysicalPage(PhysicalAddress) == FALSE) {
+                break;
+            }
         }
 
         //
@@ -1790,6 +1822,137 @@ Return Value:
     return;
 }
 
+BOOL
+MmpCheckAndClearSectionAccessedBit (
+    PIMAGE_SECTION OwningSection,
+    UINTN PageOffset
+    )
+
+/*++
+
+Routine Description:
+
+    This routine determines whether a page has been referenced through any
+    of its mappings since the last time this routine was called on it. The
+    page is checked in the owning section and in every child that inherits
+    it, and the accessed bit is cleared in each of them. The section lock
+    must be held.
+
+Arguments:
+
+    OwningSection - Supplies a pointer to the section that owns the page.
+
+    PageOffset - Supplies the offset in pages from the beginning of the section
+        where the page belongs.
+
+Return Value:
+
+    TRUE if the page was referenced in any section mapping it.
+
+    FALSE if the page was not referenced.
+
+--*/
+
+{
+
+    BOOL Accessed;
+    UINTN BitmapIndex;
+    ULONG BitmapMask;
+    PIMAGE_SECTION CurrentSection;
+    PIMAGE_SECTION PreviousSection;
+    PIMAGE_SECTION PreviousSibling;
+    BOOL TraverseChildren;
+    PVOID VirtualAddress;
+
+    ASSERT(KeIsQueuedLockHeld(OwningSection->Lock) != FALSE);
+
+    Accessed = FALSE;
+    BitmapIndex = IMAGE_SECTION_BITMAP_INDEX(PageOffset);
+    BitmapMask = IMAGE_SECTION_BITMAP_MASK(PageOffset);
+    CurrentSection = OwningSection;
+    PreviousSection = CurrentSection->Parent;
+    VirtualAddress = OwningSection->VirtualAddress +
+                     (PageOffset << MmPageShift());
+
+    //
+    // Walk the same tree of sections that modifying the page's mappings
+    // does. Sample every section rather than stopping at the first hit so
+    // that all of the accessed bits get cleared.
+    //
+
+    while (CurrentSection != NULL) {
+        PreviousSibling = LIST_VALUE(CurrentSection->CopyListEntry.Previous,
+                                     IMAGE_SECTION,
+                                     CopyListEntry);
+
+        if ((PreviousSection == CurrentSection->Parent) ||
+            ((CurrentSection->CopyListEntry.Previous != NULL) &&
+             (PreviousSection == PreviousSibling))) {
+
+            TraverseChildren = TRUE;
+            if ((CurrentSection != OwningSection) &&
+                ((CurrentSection->InheritPageBitmap[BitmapIndex] &
+                                                           BitmapMask) == 0)) {
+
+                TraverseChildren = FALSE;
+            }
+
+            if ((TraverseChildren != FALSE) &&
+                (MmpCheckAndClearAccessedBit(CurrentSection->AddressSpace,
+                                             VirtualAddress) != FALSE)) {
+
+                Accessed = TRUE;
+            }
+
+            PreviousSection = CurrentSection;
+            if ((TraverseChildren != FALSE) &&
+                (LIST_EMPTY(&(CurrentSection->ChildList)) == FALSE)) {
+
+                CurrentSection = LIST_VALUE(CurrentSection->ChildList.Next,
+                                            IMAGE_SECTION,
+                                            CopyListEntry);
+
+            } else if ((CurrentSection != OwningSection) &&
+                       (CurrentSection->CopyListEntry.Next !=
+                        &(CurrentSection->Parent->ChildList))) {
+
+                CurrentSection = LIST_VALUE(CurrentSection->CopyListEntry.Next,
+                                            IMAGE_SECTION,
+                                            CopyListEntry);
+
+            } else if (CurrentSection == OwningSection) {
+                CurrentSection = NULL;
+
+            } else {
+                CurrentSection = CurrentSection->Parent;
+            }
+
+        //
+        // If the node is popping up from the previous, attempt to move to
+        // the next sibling, or up the tree.
+        //
+
+        } else {
+            PreviousSection = CurrentSection;
+            if (CurrentSection == OwningSection) {
+                CurrentSection = NULL;
+
+            } else if (CurrentSection->CopyListEntry.Next !=
+                       &(CurrentSection->Parent->ChildList)) {
+
+                CurrentSection = LIST_VALUE(CurrentSection->CopyListEntry.Next,
+                                            IMAGE_SECTION,
+                                            CopyListEntry);
+
+            } else {
+                CurrentSection = CurrentSection->Parent;
+            }
+        }
+    }
+
+    return Accessed;
+}
+
 PPAGING_ENTRY
 MmpCreatePagingEntry (
     PIMAGE_SECTION ImageSection,
@@ -2529,6 +2692,14 @@ Return Value:
 
         KeSignalEvent(MmPagingEvent, SignalOptionUnsignal);
 
+        //
+        // Ask the object caches to give back the free objects they are
+        // holding. This happens on a work item, since releasing objects may
+        // touch paged pool.
+        //
+
+        MmpRequestObjectCacheReclaim();
+
         //
         // If paging is not enabled, act like something was released and go
         // back to sleep.
@@ -2593,6 +2764,7 @@ Return Value:
     BOOL Dirty;
     PHYSICAL_ADDRESS ExistingPhysicalAddress;
     ULONG IoBufferFlags;
+    PVOID BlockAddress;
     BOOL LockHeld;
     BOOL LockPage;
     BOOL NonPaged;
@@ -2601,6 +2773,7 @@ Return Value:
     ULONG PageSize;
     PIMAGE_SECTION RootSection;
     KSTATUS Status;
+    BOOL TryFaultAround;
     PVOID VirtualAddress;
 
     ASSERT(KeGetRunLevel() == RunLevelLow);
@@ -2619,6 +2792,11 @@ Return Value:
     PageSize = MmPageSize();
     RootSection = NULL;
     VirtualAddress = ImageSection->VirtualAddress + (PageOffset << PageShift);
+    BlockAddress = ALIGN_POINTER_DOWN(VirtualAddress, FAULT_AROUND_BLOCK_SIZE);
+    TryFaultAround = FALSE;
+    if ((ImageSection->Flags & IMAGE_SECTION_FAULT_AROUND) != 0) {
+        TryFaultAround = TRUE;
+    }
 
     //
     // Loop trying to page into the section.
@@ -2710,6 +2888,11 @@ Return Value:
             //
 
             if (Context.PhysicalAddress == INVALID_PHYSICAL_ADDRESS) {
+                if (TryFaultAround != FALSE) {
+                    TryFaultAround = MmpCanFaultAroundBlock(ImageSection,
+                                                            BlockAddress);
+                }
+
                 KeReleaseQueuedLock(ImageSection->Lock);
                 MmpImageSectionReleaseReference(OwningSection);
                 if (RootSection != NULL) {
@@ -2718,16 +2901,38 @@ Return Value:
                 }
 
                 OwningSection = NULL;
-                Context.Flags |= PAGE_IN_CONTEXT_FLAG_ALLOCATE_PAGE;
                 LockHeld = FALSE;
+
+                //
+                // Try to fault in the whole aligned block around the page from
+                // one contiguous physical run. Only try once, and fall back to
+                // a single page if it does not work out.
+                //
+
+                if (TryFaultAround != FALSE) {
+                    TryFaultAround = FALSE;
+                    Status = MmpFaultAroundBlock(ImageSection, BlockAddress);
+                    if (KSUCCESS(Status)) {
+                        continue;
+                    }
+                }
+
+                Context.Flags |= PAGE_IN_CONTEXT_FLAG_ALLOCATE_PAGE;
+                if (VirtualAddress < KERNEL_VA_START) {
+                    Context.Flags |= PAGE_IN_CONTEXT_FLAG_ZERO_PAGE;
+                }
+
                 continue;
             }
 
             //
-            // Zero the contents if the page is getting mapped to user mode.
+            // Zero the contents if the page is getting mapped to user mode,
+            // unless it came out of the zeroed page pool already clean.
             //
 
-            if (VirtualAddress < KERNEL_VA_START) {
+            if ((VirtualAddress < KERNEL_VA_START) &&
+                ((Context.Flags & PAGE_IN_CONTEXT_FLAG_PAGE_ZEROED) == 0)) {
+
                 MmpZeroPage(Context.PhysicalAddress);
             }
 
@@ -2928,6 +3133,238 @@ Return Value:
     return Status;
 }
 
+BOOL
+MmpCanFaultAroundBlock (
+    PIMAGE_SECTION Section,
+    PVOID BlockAddress
+    )
+
+/*++
+
+Routine Description:
+
+    This routine determines whether or not the given aligned block of an
+    anonymous section can be faulted in all at once from a contiguous physical
+    run. The block must be entirely within a private user mode section that
+    neither inherits from nor shares with any other section, and every page in
+    it must be unmapped and never have been written out to the page file. This
+    routine assumes the section lock is held.
+
+Arguments:
+
+    Section - Supplies a pointer to the image section.
+
+    BlockAddress - Supplies the virtual address of the block, which is aligned
+        to the fault around block size.
+
+Return Value:
+
+    TRUE if the block can be faulted in all at once.
+
+    FALSE if pages must be faulted in one at a time.
+
+--*/
+
+{
+
+    UINTN BitmapIndex;
+    ULONG BitmapMask;
+    UINTN PageCount;
+    UINTN PageIndex;
+    UINTN PageOffset;
+    ULONG PageShift;
+    PHYSICAL_ADDRESS PhysicalAddress;
+
+    ASSERT(KeIsQueuedLockHeld(Section->Lock) != FALSE);
+
+    if (((Section->Flags & IMAGE_SECTION_FAULT_AROUND) == 0) ||
+        ((Section->Flags & IMAGE_SECTION_NO_IMAGE_BACKING) == 0) ||
+        ((Section->Flags &
+          (IMAGE_SECTION_NON_PAGED | IMAGE_SECTION_SHARED |
+           IMAGE_SECTION_DESTROYED)) != 0)) {
+
+        return FALSE;
+    }
+
+    if ((Section->Parent != NULL) ||
+        (LIST_EMPTY(&(Section->ChildList)) == FALSE)) {
+
+        return FALSE;
+    }
+
+    if ((BlockAddress < Section->VirtualAddress) ||
+        (BlockAddress + FAULT_AROUND_BLOCK_SIZE >
+         Section->VirtualAddress + Section->Size) ||
+        (BlockAddress + FAULT_AROUND_BLOCK_SIZE > KERNEL_VA_START)) {
+
+        return FALSE;
+    }
+
+    PageShift = MmPageShift();
+    PageCount = FAULT_AROUND_BLOCK_SIZE >> PageShift;
+    PageOffset = (BlockAddress - Section->VirtualAddress) >> PageShift;
+    for (PageIndex = 0; PageIndex < PageCount; PageIndex += 1) {
+        if (Section->DirtyPageBitmap != NULL) {
+            BitmapIndex = IMAGE_SECTION_BITMAP_INDEX(PageOffset + PageIndex);
+            BitmapMask = IMAGE_SECTION_BITMAP_MASK(PageOffset + PageIndex);
+            if ((Section->DirtyPageBitmap[BitmapIndex] & BitmapMask) != 0) {
+                return FALSE;
+            }
+        }
+
+        PhysicalAddress = MmpVirtualToPhysical(
+                                    BlockAddress + (PageIndex << PageShift),
+                                    NULL);
+
+        if (PhysicalAddress != INVALID_PHYSICAL_ADDRESS) {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+KSTATUS
+MmpFaultAroundBlock (
+    PIMAGE_SECTION Section,
+    PVOID BlockAddress
+    )
+
+/*++
+
+Routine Description:
+
+    This routine faults in an entire aligned block of an anonymous section
+    advised to fault around. The block is backed by a single naturally aligned
+    run of physical memory, zeroed, and mapped all at once, so touching the
+    rest of the block takes no further page faults. Each page is mapped and
+    paged individually, so partial unmaps and protection changes within the
+    block need no special handling. This routine must be called at low level
+    without the section lock held.
+
+Arguments:
+
+    Section - Supplies a pointer to the image section.
+
+    BlockAddress - Supplies the virtual address of the block, which is aligned
+        to the fault around block size.
+
+Return Value:
+
+    STATUS_SUCCESS if the whole block was mapped.
+
+    STATUS_INSUFFICIENT_RESOURCES if no contiguous physical run was free or
+    the paging entries could not be allocated.
+
+    STATUS_TRY_AGAIN if the block was partially faulted in or the section
+    changed while the lock was released.
+
+--*/
+
+{
+
+    UINTN AllocationSize;
+    UINTN PageCount;
+    UINTN PageIndex;
+    UINTN PageOffset;
+    ULONG PageShift;
+    PPAGING_ENTRY *PagingEntries;
+    PHYSICAL_ADDRESS PhysicalAddress;
+    KSTATUS Status;
+
+    ASSERT(KeGetRunLevel() == RunLevelLow);
+
+    PageShift = MmPageShift();
+    PageCount = FAULT_AROUND_BLOCK_SIZE >> PageShift;
+    PhysicalAddress = INVALID_PHYSICAL_ADDRESS;
+    AllocationSize = PageCount * sizeof(PPAGING_ENTRY);
+    PagingEntries = MmAllocateNonPagedPool(AllocationSize, MM_ALLOCATION_TAG);
+    if (PagingEntries == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto FaultAroundBlockEnd;
+    }
+
+    RtlZeroMemory(PagingEntries, AllocationSize);
+
+    //
+    // Take a naturally aligned order 9 run straight off the free lists. Never
+    // wait for paging to make room for it, as falling back to single pages is
+    // always better than pushing other memory out.
+    //
+
+    PhysicalAddress = MmpTryAllocatePhysicalPages(PageCount,
+                                                  PageCount,
+                                                  MmMinimumFreePhysicalPages);
+
+    if (PhysicalAddress == INVALID_PHYSICAL_ADDRESS) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto FaultAroundBlockEnd;
+    }
+
+    for (PageIndex = 0; PageIndex < PageCount; PageIndex += 1) {
+        PagingEntries[PageIndex] = MmpCreatePagingEntry(NULL, 0);
+        if (PagingEntries[PageIndex] == NULL) {
+            Status = STATUS_INSUFFICIENT_RESOURCES;
+            goto FaultAroundBlockEnd;
+        }
+
+        MmpZeroPage(PhysicalAddress + (PageIndex << PageShift));
+    }
+
+    //
+    // Make sure nothing else faulted in part of the block or reshaped the
+    // section while the lock was released.
+    //
+
+    KeAcquireQueuedLock(Section->Lock);
+    if (MmpCanFaultAroundBlock(Section, BlockAddress) == FALSE) {
+        KeReleaseQueuedLock(Section->Lock);
+        Status = STATUS_TRY_AGAIN;
+        goto FaultAroundBlockEnd;
+    }
+
+    PageOffset = (BlockAddress - Section->VirtualAddress) >> PageShift;
+    for (PageIndex = 0; PageIndex < PageCount; PageIndex += 1) {
+        MmpModifySectionMapping(Section,
+                                PageOffset + PageIndex,
+                                PhysicalAddress + (PageIndex << PageShift),
+                                TRUE,
+                                NULL,
+                                FALSE);
+
+        MmpInitializePagingEntry(PagingEntries[PageIndex],
+                                 Section,
+                                 PageOffset + PageIndex);
+    }
+
+    MmpEnablePagingOnPhysicalAddress(PhysicalAddress,
+                                     PageCount,
+                                     PagingEntries,
+                                     FALSE);
+
+    KeReleaseQueuedLock(Section->Lock);
+    PhysicalAddress = INVALID_PHYSICAL_ADDRESS;
+    RtlZeroMemory(PagingEntries, AllocationSize);
+    Status = STATUS_SUCCESS;
+
+FaultAroundBlockEnd:
+    if (PhysicalAddress != INVALID_PHYSICAL_ADDRESS) {
+        MmFreePhysicalPages(PhysicalAddress, PageCount);
+    }
+
+    if (PagingEntries != NULL) {
+        for (PageIndex = 0; PageIndex < PageCount; PageIndex += 1) {
+            if (PagingEntries[PageIndex] != NULL) {
+                MmpDestroyPagingEntry(PagingEntries[PageIndex]);
+            }
+        }
+
+        MmFreeNonPagedPool(PagingEntries);
+    }
+
+    return Status;
+}
+
 KSTATUS
 MmpPageInSharedSection (
     PIMAGE_SECTION ImageSection,
@@ -4873,6 +5310,7 @@ Return Value:
 {
 
     UINTN BytesRead;
+    ULONG IoFlags;
     ULONG PageShift;
     ULONG PageSize;
     IO_OFFSET ReadOffset;
@@ -4902,6 +5340,19 @@ Return Value:
         ReadSize = PageSize;
     }
 
+    //
+    // Pass along any access pattern advice so the read-ahead on the backing
+    // image follows it.
+    //
+
+    IoFlags = IO_FLAG_SERVICING_FAULT;
+    if ((Section->Flags & IMAGE_SECTION_SEQUENTIAL) != 0) {
+        IoFlags |= IO_FLAG_SEQUENTIAL_ACCESS;
+
+    } else if ((Section->Flags & IMAGE_SECTION_RANDOM) != 0) {
+        IoFlags |= IO_FLAG_RANDOM_ACCESS;
+    }
+
     //
     // Read from the backing image.
     //
@@ -4910,7 +5361,7 @@ Return Value:
                             IoBuffer,
                             ReadOffset,
                             ReadSize,
-                            IO_FLAG_SERVICING_FAULT,
+                            IoFlags,
                             WAIT_TIME_INDEFINITE,
                             &BytesRead,
                             NULL);
@@ -5036,7 +5487,18 @@ Return Value:
         ASSERT(Context->PhysicalAddress == INVALID_PHYSICAL_ADDRESS);
         ASSERT(Context->PagingEntry == NULL);
 
-        Context->PhysicalAddress = MmpAllocatePhysicalPages(1, 1);
+        //
+        // Demand zero pages are taken pre-zeroed when possible.
+        //
+
+        if ((Context->Flags & PAGE_IN_CONTEXT_FLAG_ZERO_PAGE) != 0) {
+            Context->PhysicalAddress = MmpAllocateZeroedPhysicalPage();
+            Context->Flags |= PAGE_IN_CONTEXT_FLAG_PAGE_ZEROED;
+
+        } else {
+            Context->PhysicalAddress = MmpAllocatePhysicalPages(1, 1);
+        }
+
         if (Context->PhysicalAddress == INVALID_PHYSICAL_ADDRESS) {
             Status = STATUS_NO_MEMORY;
             goto AllocatePageInStructuresEnd;
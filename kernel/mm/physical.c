@@ -56,6 +56,44 @@ Module Name:
 
 #define PHYSICAL_PAGE_FREE 0
 
+//
+// Define the flag set in the first page of a block of free pages that sits on
+// one of its segment's free lists. The order of the block is stored above
+// the flags. The remaining pages of a free block are set to the free value.
+//
+
+#define PHYSICAL_PAGE_FLAG_FREE_BLOCK 0x2
+#define PHYSICAL_PAGE_ORDER_SHIFT 2
+
+//
+// Define the largest order of free block the physical allocator tracks. A
+// block of order N is 2^N pages long and starts on a 2^N page boundary.
+//
+
+#define PHYSICAL_PAGE_MAX_ORDER 10
+#define PHYSICAL_PAGE_ORDER_COUNT (PHYSICAL_PAGE_MAX_ORDER + 1)
+
+//
+// Define the value that terminates a free list.
+//
+
+#define PHYSICAL_PAGE_LIST_END MAX_ULONG
+
+//
+// Define how many pages a processor's page cache takes from the free lists
+// when it runs dry, and how many it gives back when it fills up.
+//
+
+#define PHYSICAL_PAGE_CACHE_BATCH (MM_PHYSICAL_PAGE_CACHE_DEPTH / 2)
+
+//
+// Define the most pages kept zeroed ahead of time, and the fraction of
+// physical memory they are allowed to take up.
+//
+
+#define ZEROED_PAGE_POOL_MAXIMUM 256
+#define ZEROED_PAGE_POOL_DIVISOR 128
+
 //
 // Define the percentage of physical pages that should remain free.
 //
@@ -92,6 +130,14 @@ Module Name:
 
 #define PHYSICAL_MEMORY_MAX_PAGE_OUT_FAILURE_COUNT 10
 
+//
+// Define the number of times the pager will sweep the physical page database
+// looking for a victim before giving up. The first sweep may do nothing but
+// move active pages to the inactive state.
+//
+
+#define PHYSICAL_MEMORY_PAGE_OUT_SWEEP_COUNT 2
+
 //
 // Define how many pages must be paged out before the paging event is
 // signaled and all threads trying to allocate are re-woken. Too few pages and
@@ -120,6 +166,24 @@ Module Name:
      ((_Type) == MemoryTypeFirmwareTemporary) ||                \
      ((_Type) == MemoryTypeBootPageTables))
 
+//
+// This macro evaluates to non-zero if the given physical page is free, either
+// as the first page of a free block or as one of the pages within it.
+//
+
+#define IS_PHYSICAL_PAGE_FREE(_Page)                            \
+    (((_Page)->U.Free == PHYSICAL_PAGE_FREE) ||                 \
+     (((_Page)->U.Flags & PHYSICAL_PAGE_FLAG_FREE_BLOCK) != 0))
+
+//
+// This macro returns the value stored in the first page of a free block of
+// the given order.
+//
+
+#define PHYSICAL_PAGE_FREE_BLOCK(_Order)                        \
+    (PHYSICAL_PAGE_FLAG_FREE_BLOCK |                            \
+     ((UINTN)(_Order) << PHYSICAL_PAGE_ORDER_SHIFT))
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -139,15 +203,23 @@ Structure Description:
 
 Members:
 
-    Free - Stores PHYSICAL_PAGE_FREE if the page is free.
+    Free - Stores PHYSICAL_PAGE_FREE if the page is free and is not the first
+        page of a free block.
 
     Flags - Stores a bitmask of flags for the physical page. See
-        PHYSICAL_PAGE_FLAG_* for definitions.
+        PHYSICAL_PAGE_FLAG_* for definitions. The first page of a free block
+        also stores the order of the block here.
 
     PagingEntry - Stores a pointer to a paging entry.
 
     PageCacheEntry - Stores a pointer to page cache entry.
 
+    Next - Stores the segment page offset of the next free block of the same
+        order. This is only valid in the first page of a free block.
+
+    Previous - Stores the segment page offset of the previous free block of
+        the same order. This is only valid in the first page of a free block.
+
 --*/
 
 typedef struct _PHYSICAL_PAGE {
@@ -158,6 +230,8 @@ typedef struct _PHYSICAL_PAGE {
         PPAGE_CACHE_ENTRY PageCacheEntry;
     } U;
 
+    ULONG Next;
+    ULONG Previous;
 } PHYSICAL_PAGE, *PPHYSICAL_PAGE;
 
 /*++
@@ -177,6 +251,10 @@ Structure Description:
 
     FreePages - Stores the number of unallocated pages in the segment.
 
+    FreeLists - Stores the segment page offset of the first free block of each
+        order, or PHYSICAL_PAGE_LIST_END if there are no free blocks of that
+        order.
+
 --*/
 
 typedef struct _PHYSICAL_MEMORY_SEGMENT {
@@ -184,6 +262,7 @@ typedef struct _PHYSICAL_MEMORY_SEGMENT {
     PHYSICAL_ADDRESS StartAddress;
     PHYSICAL_ADDRESS EndAddress;
     UINTN FreePages;
+    ULONG FreeLists[PHYSICAL_PAGE_ORDER_COUNT];
 } PHYSICAL_MEMORY_SEGMENT, *PPHYSICAL_MEMORY_SEGMENT;
 
 /*++
@@ -249,6 +328,98 @@ MmpUpdatePhysicalMemoryStatistics (
     BOOL Allocation
     );
 
+PPHYSICAL_MEMORY_SEGMENT
+MmpGetPhysicalMemorySegment (
+    PHYSICAL_ADDRESS PhysicalAddress,
+    PUINTN SegmentOffset
+    );
+
+PPHYSICAL_MEMORY_SEGMENT
+MmpAllocateFreeBlock (
+    UINTN PageCount,
+    UINTN PageAlignment,
+    PUINTN SelectedPageOffset
+    );
+
+VOID
+MmpInsertFreeRange (
+    PPHYSICAL_MEMORY_SEGMENT Segment,
+    UINTN Offset,
+    UINTN PageCount
+    );
+
+VOID
+MmpRemoveFreeRange (
+    PPHYSICAL_MEMORY_SEGMENT Segment,
+    UINTN Offset,
+    UINTN PageCount
+    );
+
+VOID
+MmpInsertFreeBlock (
+    PPHYSICAL_MEMORY_SEGMENT Segment,
+    UINTN Offset,
+    ULONG Order
+    );
+
+VOID
+MmpLinkFreeBlock (
+    PPHYSICAL_MEMORY_SEGMENT Segment,
+    UINTN Offset,
+    ULONG Order
+    );
+
+VOID
+MmpUnlinkFreeBlock (
+    PPHYSICAL_MEMORY_SEGMENT Segment,
+    UINTN Offset,
+    ULONG Order
+    );
+
+UINTN
+MmpTakeFreePhysicalPages (
+    PPHYSICAL_ADDRESS Pages,
+    UINTN PageCount,
+    UINTN Reserve
+    );
+
+VOID
+MmpReleasePhysicalPageBatch (
+    PPHYSICAL_ADDRESS Pages,
+    UINTN PageCount
+    );
+
+PHYSICAL_ADDRESS
+MmpAllocateCachedPhysicalPage (
+    VOID
+    );
+
+BOOL
+MmpFreeCachedPhysicalPage (
+    PHYSICAL_ADDRESS PhysicalAddress
+    );
+
+UINTN
+MmpDrainPhysicalPageCaches (
+    VOID
+    );
+
+VOID
+MmpZeroPageThread (
+    PVOID Parameter
+    );
+
+BOOL
+MmpAgePagingEntry (
+    PPAGING_ENTRY PagingEntry,
+    BOOL SectionLockHeld
+    );
+
+VOID
+MmpDeactivatePagingEntry (
+    PPAGING_ENTRY PagingEntry
+    );
+
 //
 // -------------------------------------------------------------------- Globals
 //
@@ -285,6 +456,15 @@ UINTN MmMinimumFreePhysicalPages;
 
 UINTN MmNonPagedPhysicalPages;
 
+//
+// Stores the number of pagable physical pages that have been referenced
+// recently, and the number that have not. These are protected by the physical
+// page lock.
+//
+
+UINTN MmActivePhysicalPages;
+UINTN MmInactivePhysicalPages;
+
 //
 // Store the maximum physical address that can be reached. This should be
 // removed when PAE is supported.
@@ -368,6 +548,27 @@ UINTN MmPhysicalMemoryFreeCount;
 
 BOOL MmPhysicalPageZeroAvailable = FALSE;
 
+//
+// Single page allocations and frees go through per-processor caches of free
+// pages once they are enabled. Pages sitting in these caches are accounted
+// as allocated non-paged pages.
+//
+
+BOOL MmPhysicalPageCachesEnabled = FALSE;
+
+//
+// Store the pool of pages that have been zeroed ahead of time, which demand
+// zero faults use to skip clearing a page synchronously. The pool is refilled
+// by a background thread whenever it drops to half full. These pages are also
+// accounted as allocated non-paged pages.
+//
+
+KSPIN_LOCK MmZeroedPageLock;
+PPHYSICAL_ADDRESS MmZeroedPages;
+UINTN MmZeroedPageCount;
+UINTN MmZeroedPageTarget;
+PKEVENT MmZeroedPageEvent;
+
 //
 // ------------------------------------------------------------------ Functions
 //
@@ -456,6 +657,33 @@ Return Value:
     return MmTotalPhysicalPages;
 }
 
+UINTN
+MmGetInactivePhysicalPages (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the number of pagable physical pages that have not
+    been referenced recently. These are the pages the pager will evict first.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Returns the number of inactive pagable physical pages.
+
+--*/
+
+{
+
+    return MmInactivePhysicalPages;
+}
+
 UINTN
 MmGetTotalFreePhysicalPages (
     VOID
@@ -479,7 +707,35 @@ Return Value:
 
 {
 
-    return MmTotalPhysicalPages - MmTotalAllocatedPhysicalPages;
+    UINTN Count;
+    UINTN FreePages;
+    ULONG ProcessorCount;
+    ULONG ProcessorNumber;
+    PPROCESSOR_BLOCK ProcessorBlock;
+
+    FreePages = MmTotalPhysicalPages - MmTotalAllocatedPhysicalPages;
+
+    //
+    // Pages sitting in the processor caches and the zeroed page pool are
+    // counted as allocated, but are really free. The counts are read without
+    // their locks, which is fine for an estimate.
+    //
+
+    if (MmPhysicalPageCachesEnabled != FALSE) {
+        ProcessorCount = KeGetActiveProcessorCount();
+        for (ProcessorNumber = 0;
+             ProcessorNumber < ProcessorCount;
+             ProcessorNumber += 1) {
+
+            ProcessorBlock = KeGetProcessorBlock(ProcessorNumber);
+            Count = ProcessorBlock->PhysicalPageCache.Count;
+            FreePages += Count;
+        }
+
+        FreePages += MmZeroedPageCount;
+    }
+
+    return FreePages;
 }
 
 VOID
@@ -522,6 +778,18 @@ Return Value:
 
     ASSERT(KeGetRunLevel() == RunLevelLow);
 
+    //
+    // Single non-paged pages can usually be parked in the current processor's
+    // page cache without touching the physical page lock.
+    //
+
+    if ((PageCount == 1) &&
+        (MmPhysicalPageCachesEnabled != FALSE) &&
+        (MmpFreeCachedPhysicalPage(PhysicalAddress) != FALSE)) {
+
+        return;
+    }
+
     PageShift = MmPageShift();
     PagingEntry = NULL;
     INITIALIZE_LIST_HEAD(&PagingEntryList);
@@ -562,7 +830,7 @@ Return Value:
 
         for (Index = 0; Index < PageCount; Index += 1) {
 
-            ASSERT(PhysicalPage->U.Free != PHYSICAL_PAGE_FREE);
+            ASSERT(!IS_PHYSICAL_PAGE_FREE(PhysicalPage));
 
             //
             // Directly mark non-paged physical pages as free.
@@ -570,6 +838,7 @@ Return Value:
 
             if ((PhysicalPage->U.Flags & PHYSICAL_PAGE_FLAG_NON_PAGED) != 0) {
                 PhysicalPage->U.Free = PHYSICAL_PAGE_FREE;
+                MmpInsertFreeRange(Segment, Offset + Index, 1);
                 MmNonPagedPhysicalPages -= 1;
                 ReleasedCount += 1;
 
@@ -587,8 +856,17 @@ Return Value:
                 if ((PagingEntry->U.Flags &
                      PAGING_ENTRY_FLAG_PAGING_OUT) == 0) {
 
+                    //
+                    // Take the page out of the working set now while the
+                    // section is known to be alive, even if the page itself
+                    // is not released until it is unlocked.
+                    //
+
+                    MmpDeactivatePagingEntry(PagingEntry);
                     if (PagingEntry->U.LockCount == 0) {
+                        MmInactivePhysicalPages -= 1;
                         PhysicalPage->U.Free = PHYSICAL_PAGE_FREE;
+                        MmpInsertFreeRange(Segment, Offset + Index, 1);
                         ReleasedCount += 1;
                         INSERT_BEFORE(&(PagingEntry->U.ListEntry),
                                       &PagingEntryList);
@@ -715,7 +993,9 @@ Return Value:
         //
 
         ASSERT((PhysicalPage->U.Flags & PHYSICAL_PAGE_FLAG_NON_PAGED) != 0);
-        ASSERT(((UINTN)PageCacheEntry & PHYSICAL_PAGE_FLAG_NON_PAGED) == 0);
+        ASSERT(((UINTN)PageCacheEntry &
+                (PHYSICAL_PAGE_FLAG_NON_PAGED |
+                 PHYSICAL_PAGE_FLAG_FREE_BLOCK)) == 0);
 
         PageCacheEntry = (PVOID)((UINTN)PageCacheEntry |
                                  PHYSICAL_PAGE_FLAG_NON_PAGED);
@@ -779,10 +1059,17 @@ Return Value:
     ULONG AllocationSize;
     INIT_PHYSICAL_MEMORY_ITERATOR Context;
     UINTN Count;
+    PLIST_ENTRY CurrentEntry;
     ULONG LastBitIndex;
     ULONG LeadingZeros;
+    UINTN Offset;
+    ULONG Order;
     ULONG PageShift;
+    PPHYSICAL_PAGE PhysicalPage;
     PUCHAR RawBuffer;
+    UINTN RunStart;
+    PPHYSICAL_MEMORY_SEGMENT Segment;
+    UINTN SegmentPageCount;
     KSTATUS Status;
 
     PageShift = MmPageShift();
@@ -847,6 +1134,42 @@ Return Value:
         MmMaximumPhysicalAddress = Context.LastEnd;
     }
 
+    //
+    // Sort each run of free pages into the free lists of its segment.
+    //
+
+    CurrentEntry = MmPhysicalSegmentListHead.Next;
+    while (CurrentEntry != &MmPhysicalSegmentListHead) {
+        Segment = LIST_VALUE(CurrentEntry, PHYSICAL_MEMORY_SEGMENT, ListEntry);
+        CurrentEntry = CurrentEntry->Next;
+        for (Order = 0; Order < PHYSICAL_PAGE_ORDER_COUNT; Order += 1) {
+            Segment->FreeLists[Order] = PHYSICAL_PAGE_LIST_END;
+        }
+
+        SegmentPageCount = (UINTN)((Segment->EndAddress -
+                                    Segment->StartAddress) >> PageShift);
+
+        ASSERT(SegmentPageCount < PHYSICAL_PAGE_LIST_END);
+
+        PhysicalPage = (PPHYSICAL_PAGE)(Segment + 1);
+        Offset = 0;
+        while (Offset < SegmentPageCount) {
+            if (PhysicalPage[Offset].U.Free != PHYSICAL_PAGE_FREE) {
+                Offset += 1;
+                continue;
+            }
+
+            RunStart = Offset;
+            while ((Offset < SegmentPageCount) &&
+                   (PhysicalPage[Offset].U.Free == PHYSICAL_PAGE_FREE)) {
+
+                Offset += 1;
+            }
+
+            MmpInsertFreeRange(Segment, RunStart, Offset - RunStart);
+        }
+    }
+
     MmLastAllocatedSegment = LIST_VALUE(MmPhysicalSegmentListHead.Next,
                                         PHYSICAL_MEMORY_SEGMENT,
                                         ListEntry);
@@ -923,6 +1246,8 @@ Return Value:
     Statistics->PhysicalPages = MmTotalPhysicalPages;
     Statistics->AllocatedPhysicalPages = MmTotalAllocatedPhysicalPages;
     Statistics->NonPagedPhysicalPages = MmNonPagedPhysicalPages;
+    Statistics->ActivePhysicalPages = MmActivePhysicalPages;
+    Statistics->InactivePhysicalPages = MmInactivePhysicalPages;
     return;
 }
 
@@ -981,6 +1306,20 @@ Return Value:
         Alignment = 1;
     }
 
+    //
+    // Try the current processor's page cache for single pages.
+    //
+
+    if ((PageCount == 1) &&
+        (Alignment == 1) &&
+        (MmPhysicalPageCachesEnabled != FALSE)) {
+
+        WorkingAllocation = MmpAllocateCachedPhysicalPage();
+        if (WorkingAllocation != INVALID_PHYSICAL_ADDRESS) {
+            return WorkingAllocation;
+        }
+    }
+
     //
     // Loop continuously looking for free pages.
     //
@@ -993,14 +1332,10 @@ Return Value:
         }
 
         //
-        // Attempt to find some free pages.
+        // Attempt to take some free pages off the free lists.
         //
 
-        Segment = MmpFindPhysicalPages(PageCount,
-                                       Alignment,
-                                       PhysicalMemoryFindFree,
-                                       &SegmentOffset,
-                                       NULL);
+        Segment = MmpAllocateFreeBlock(PageCount, Alignment, &SegmentOffset);
 
         //
         // If a section of free memory was available, grab it up!
@@ -1040,6 +1375,18 @@ Return Value:
             LockHeld = FALSE;
         }
 
+        //
+        // Before paging anything out, pull back the free pages parked in the
+        // processor caches and the zeroed page pool, and try again if that
+        // turned anything up.
+        //
+
+        if ((MmPhysicalPageCachesEnabled != FALSE) &&
+            (MmpDrainPhysicalPageCaches() != 0)) {
+
+            continue;
+        }
+
         //
         // Not enough free memory could be found laying around. Schedule the
         // paging worker to notify it that memory is a little tight. If it gets
@@ -1099,6 +1446,98 @@ Return Value:
     return WorkingAllocation;
 }
 
+PHYSICAL_ADDRESS
+MmpTryAllocatePhysicalPages (
+    UINTN PageCount,
+    UINTN Alignment,
+    UINTN Reserve
+    )
+
+/*++
+
+Routine Description:
+
+    This routine attempts to allocate a run of contiguous physical pages
+    without ever waiting for memory to be paged out. It is meant for
+    opportunistic allocations, such as large aligned blocks, that have a
+    cheaper fallback if physical memory is fragmented or tight. The pages
+    start out as non-paged.
+
+Arguments:
+
+    PageCount - Supplies the number of consecutive physical pages required.
+
+    Alignment - Supplies the alignment requirement of the allocation, in pages.
+        Valid values are powers of 2. Values of 1 or 0 indicate no alignment
+        requirement.
+
+    Reserve - Supplies the number of free pages that must remain after the
+        allocation for it to succeed.
+
+Return Value:
+
+    Returns the physical address of the first page of allocated memory on
+    success, or INVALID_PHYSICAL_ADDRESS if no suitable run was free.
+
+--*/
+
+{
+
+    UINTN PageIndex;
+    ULONG PageShift;
+    PPHYSICAL_PAGE PhysicalPage;
+    PPHYSICAL_MEMORY_SEGMENT Segment;
+    UINTN SegmentOffset;
+    BOOL SignalEvent;
+    PHYSICAL_ADDRESS WorkingAllocation;
+
+    ASSERT(KeGetRunLevel() == RunLevelLow);
+
+    PageShift = MmPageShift();
+    SignalEvent = FALSE;
+    WorkingAllocation = INVALID_PHYSICAL_ADDRESS;
+    if (Alignment == 0) {
+        Alignment = 1;
+    }
+
+    KeAcquireQueuedLock(MmPhysicalPageLock);
+    if ((MmTotalPhysicalPages - MmTotalAllocatedPhysicalPages) <
+        (Reserve + PageCount)) {
+
+        goto TryAllocatePhysicalPagesEnd;
+    }
+
+    Segment = MmpAllocateFreeBlock(PageCount, Alignment, &SegmentOffset);
+    if (Segment == NULL) {
+        goto TryAllocatePhysicalPagesEnd;
+    }
+
+    WorkingAllocation = Segment->StartAddress + (SegmentOffset << PageShift);
+    PhysicalPage = (PPHYSICAL_PAGE)(Segment + 1);
+    PhysicalPage += SegmentOffset;
+    for (PageIndex = 0; PageIndex < PageCount; PageIndex += 1) {
+
+        ASSERT(PhysicalPage->U.Free == PHYSICAL_PAGE_FREE);
+
+        PhysicalPage->U.Flags = PHYSICAL_PAGE_FLAG_NON_PAGED;
+        PhysicalPage += 1;
+    }
+
+    Segment->FreePages -= PageCount;
+    SignalEvent = MmpUpdatePhysicalMemoryStatistics(PageCount, TRUE);
+
+TryAllocatePhysicalPagesEnd:
+    KeReleaseQueuedLock(MmPhysicalPageLock);
+    if (SignalEvent != FALSE) {
+
+        ASSERT(MmPhysicalMemoryWarningEvent != NULL);
+
+        KeSignalEvent(MmPhysicalMemoryWarningEvent, SignalOptionPulse);
+    }
+
+    return WorkingAllocation;
+}
+
 PHYSICAL_ADDRESS
 MmpAllocateIdentityMappablePhysicalPages (
     UINTN PageCount,
@@ -1163,6 +1602,7 @@ Return Value:
     }
 
     if (WorkingAllocation != INVALID_PHYSICAL_ADDRESS) {
+        MmpRemoveFreeRange(Segment, SegmentOffset, PageCount);
         PhysicalPage = (PPHYSICAL_PAGE)(Segment + 1);
         PhysicalPage += SegmentOffset;
         for (PageIndex = 0; PageIndex < PageCount; PageIndex += 1) {
@@ -1308,6 +1748,7 @@ Return Value:
 
 {
 
+    PADDRESS_SPACE AddressSpace;
     PLIST_ENTRY CurrentEntry;
     UINTN PageIndex;
     UINTN PageOffset;
@@ -1353,7 +1794,8 @@ Return Value:
 
             ASSERT(PhysicalPage->U.Flags == PHYSICAL_PAGE_FLAG_NON_PAGED);
             ASSERT(((UINTN)PagingEntries[PageIndex] &
-                    PHYSICAL_PAGE_FLAG_NON_PAGED) == 0);
+                    (PHYSICAL_PAGE_FLAG_NON_PAGED |
+                     PHYSICAL_PAGE_FLAG_FREE_BLOCK)) == 0);
 
             PhysicalPage->U.PagingEntry = PagingEntries[PageIndex];
 
@@ -1361,7 +1803,22 @@ Return Value:
             ASSERT((PagingEntries[PageIndex]->Section->Flags &
                     IMAGE_SECTION_DESTROYED) == 0);
 
-            if (LockPages != FALSE) {
+            //
+            // The page was just faulted in, so it starts out active.
+            //
+
+            ASSERT((PagingEntries[PageIndex]->U.Flags &
+                    PAGING_ENTRY_FLAG_ACTIVE) == 0);
+
+            PagingEntries[PageIndex]->U.Flags |= PAGING_ENTRY_FLAG_ACTIVE;
+            AddressSpace = PagingEntries[PageIndex]->Section->AddressSpace;
+            if (AddressSpace != NULL) {
+                AddressSpace->WorkingSet += 1;
+            }
+
+            MmActivePhysicalPages += 1;
+
+            if (LockPages != FALSE) {
 
                 ASSERT(PhysicalPage->U.PagingEntry->U.LockCount == 0);
 
@@ -1458,7 +1915,7 @@ Return Value:
         for (PageIndex = 0; PageIndex < PageCount; PageIndex += 1) {
 
             ASSERT((Offset + PageIndex) < MaxOffset);
-            ASSERT(PhysicalPage[PageIndex].U.Free != PHYSICAL_PAGE_FREE);
+            ASSERT(!IS_PHYSICAL_PAGE_FREE(&(PhysicalPage[PageIndex])));
 
             //
             // If there is no paging entry and this is just a non-paged
@@ -1603,7 +2060,7 @@ Return Value:
         for (PageIndex = 0; PageIndex < PageCount; PageIndex += 1) {
 
             ASSERT((Offset + PageIndex) < MaxOffset);
-            ASSERT(PhysicalPage[PageIndex].U.Free != PHYSICAL_PAGE_FREE);
+            ASSERT(!IS_PHYSICAL_PAGE_FREE(&(PhysicalPage[PageIndex])));
 
             //
             // If this is a non-paged physical page, then skip it.
@@ -1623,7 +2080,13 @@ Return Value:
             if (PagingEntry->U.LockCount == 0) {
                 MmNonPagedPhysicalPages -= 1;
                 if ((PagingEntry->U.Flags & PAGING_ENTRY_FLAG_FREED) != 0) {
+
+                    ASSERT((PagingEntry->U.Flags &
+                            PAGING_ENTRY_FLAG_ACTIVE) == 0);
+
+                    MmInactivePhysicalPages -= 1;
                     PhysicalPage[PageIndex].U.Free = PHYSICAL_PAGE_FREE;
+                    MmpInsertFreeRange(Segment, Offset + PageIndex, 1);
                     ReleasedCount += 1;
                     INSERT_BEFORE(&(PagingEntry->U.ListEntry),
                                   &PagingEntryList);
@@ -1748,6 +2211,64 @@ Return Value:
     return PageCacheEntry;
 }
 
+BOOL
+MmpAgePhysicalPage (
+    PHYSICAL_ADDRESS PhysicalAddress
+    )
+
+/*++
+
+Routine Description:
+
+    This routine ages the pagable page at the given physical address and
+    reports whether it is a good candidate for eviction. This is used to
+    decide whether a neighboring page can join a batched page out. The
+    section lock of the image section owning the page must be held.
+
+Arguments:
+
+    PhysicalAddress - Supplies the address of the physical page to check.
+
+Return Value:
+
+    TRUE if the page is inactive and was not referenced.
+
+    FALSE if the page is in use and should stay resident.
+
+--*/
+
+{
+
+    BOOL Candidate;
+    UINTN Offset;
+    PPAGING_ENTRY PagingEntry;
+    PPHYSICAL_PAGE PhysicalPage;
+    PPHYSICAL_MEMORY_SEGMENT Segment;
+
+    ASSERT(KeGetRunLevel() == RunLevelLow);
+
+    Segment = MmpGetPhysicalMemorySegment(PhysicalAddress, &Offset);
+    if (Segment == NULL) {
+        return FALSE;
+    }
+
+    Candidate = FALSE;
+    PhysicalPage = (PPHYSICAL_PAGE)(Segment + 1);
+    PhysicalPage += Offset;
+    KeAcquireQueuedLock(MmPhysicalPageLock);
+    if ((IS_PHYSICAL_PAGE_FREE(PhysicalPage) == FALSE) &&
+        ((PhysicalPage->U.Flags & PHYSICAL_PAGE_FLAG_NON_PAGED) == 0)) {
+
+        PagingEntry = PhysicalPage->U.PagingEntry;
+        if (PagingEntry->U.LockCount == 0) {
+            Candidate = MmpAgePagingEntry(PagingEntry, TRUE);
+        }
+    }
+
+    KeReleaseQueuedLock(MmPhysicalPageLock);
+    return Candidate;
+}
+
 VOID
 MmpMigratePagingEntries (
     PIMAGE_SECTION OldSection,
@@ -1857,7 +2378,7 @@ Return Value:
 
             PhysicalPage += SegmentOffset;
 
-            ASSERT(PhysicalPage->U.Flags != PHYSICAL_PAGE_FREE);
+            ASSERT(!IS_PHYSICAL_PAGE_FREE(PhysicalPage));
 
             //
             // If it's a page cache entry, just leave it alone. Otherwise, it
@@ -1933,19 +2454,23 @@ Return Value:
     PPHYSICAL_MEMORY_SEGMENT Segment;
     UINTN SegmentOffset;
     KSTATUS Status;
+    ULONG SweepCount;
     UINTN TotalPagesPaged;
 
     LockHeld = FALSE;
     PageShift = MmPageShift();
 
     //
-    // Now attempt to swap pages out to the backing store. This algorithm can
-    // get more intelligent with time, but for now just round robin the
-    // evictions.
+    // Now attempt to swap pages out to the backing store. The search sweeps
+    // around the physical page database like a clock hand. Pages that have
+    // been referenced since the hand last passed stay (or become) active,
+    // active pages that have not been referenced are moved to the inactive
+    // state, and only inactive pages that are still unreferenced are evicted.
     //
 
     FailureCount = 0;
     PageCountSinceEvent = 0;
+    SweepCount = 0;
     TotalPagesPaged = 0;
     while (TRUE) {
         if (MmPhysicalPageLock != NULL) {
@@ -1987,12 +2512,29 @@ Return Value:
                                        &SegmentOffset,
                                        &PagesFound);
 
+        //
+        // A sweep that finds nothing may still have deactivated pages that
+        // the next sweep can evict, so go around again a limited number of
+        // times.
+        //
+
         if (Segment == NULL) {
-            break;
+            SweepCount += 1;
+            if (SweepCount >= PHYSICAL_MEMORY_PAGE_OUT_SWEEP_COUNT) {
+                break;
+            }
+
+            if (LockHeld != FALSE) {
+                KeReleaseQueuedLock(MmPhysicalPageLock);
+                LockHeld = FALSE;
+            }
+
+            continue;
         }
 
         ASSERT(PagesFound == 1);
 
+        SweepCount = 0;
         Failure = FALSE;
         PagesPaged = 0;
         PhysicalAddress = Segment->StartAddress + (SegmentOffset << PageShift);
@@ -2074,6 +2616,170 @@ Return Value:
     return TotalPagesPaged;
 }
 
+PHYSICAL_ADDRESS
+MmpAllocateZeroedPhysicalPage (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine allocates a single physical page whose contents are zero. The
+    page comes from the pool of pages zeroed ahead of time if one is
+    available, otherwise a page is allocated and zeroed synchronously. Like
+    any other physical allocation, the page starts out as non-paged. This
+    routine must be called at low level.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Returns the physical address of the zeroed page.
+
+--*/
+
+{
+
+    RUNLEVEL OldRunLevel;
+    PHYSICAL_ADDRESS PhysicalAddress;
+    BOOL Refill;
+
+    ASSERT(KeGetRunLevel() == RunLevelLow);
+
+    PhysicalAddress = INVALID_PHYSICAL_ADDRESS;
+    if (MmZeroedPages != NULL) {
+        Refill = FALSE;
+        OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+        KeAcquireSpinLock(&MmZeroedPageLock);
+        if (MmZeroedPageCount != 0) {
+            MmZeroedPageCount -= 1;
+            PhysicalAddress = MmZeroedPages[MmZeroedPageCount];
+        }
+
+        if (MmZeroedPageCount <= (MmZeroedPageTarget / 2)) {
+            Refill = TRUE;
+        }
+
+        KeReleaseSpinLock(&MmZeroedPageLock);
+        KeLowerRunLevel(OldRunLevel);
+
+        //
+        // Wake the zeroing thread once the pool is half gone.
+        //
+
+        if (Refill != FALSE) {
+            KeSignalEvent(MmZeroedPageEvent, SignalOptionSignalAll);
+        }
+    }
+
+    if (PhysicalAddress == INVALID_PHYSICAL_ADDRESS) {
+        PhysicalAddress = MmpAllocatePhysicalPages(1, 1);
+        MmpZeroPage(PhysicalAddress);
+    }
+
+    return PhysicalAddress;
+}
+
+KSTATUS
+MmpInitializePhysicalPageCaches (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine turns on the per-processor physical page caches and starts
+    the thread that keeps the zeroed page pool filled. This must be called
+    once all processors have been started.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    UINTN AllocationSize;
+    PMM_PHYSICAL_PAGE_CACHE Cache;
+    ULONG ProcessorCount;
+    ULONG ProcessorNumber;
+    KSTATUS Status;
+
+    ProcessorCount = KeGetActiveProcessorCount();
+    for (ProcessorNumber = 0;
+         ProcessorNumber < ProcessorCount;
+         ProcessorNumber += 1) {
+
+        Cache = &(KeGetProcessorBlock(ProcessorNumber)->PhysicalPageCache);
+        KeInitializeSpinLock(&(Cache->Lock));
+        Cache->Count = 0;
+    }
+
+    MmPhysicalPageCachesEnabled = TRUE;
+
+    //
+    // Size the zeroed page pool. Tiny systems go without one.
+    //
+
+    MmZeroedPageTarget = MmTotalPhysicalPages / ZEROED_PAGE_POOL_DIVISOR;
+    if (MmZeroedPageTarget > ZEROED_PAGE_POOL_MAXIMUM) {
+        MmZeroedPageTarget = ZEROED_PAGE_POOL_MAXIMUM;
+    }
+
+    if (MmZeroedPageTarget == 0) {
+        Status = STATUS_SUCCESS;
+        goto InitializePhysicalPageCachesEnd;
+    }
+
+    KeInitializeSpinLock(&MmZeroedPageLock);
+    MmZeroedPageEvent = KeCreateEvent(NULL);
+    if (MmZeroedPageEvent == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto InitializePhysicalPageCachesEnd;
+    }
+
+    AllocationSize = MmZeroedPageTarget * sizeof(PHYSICAL_ADDRESS);
+    MmZeroedPages = MmAllocateNonPagedPool(AllocationSize, MM_ALLOCATION_TAG);
+    if (MmZeroedPages == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto InitializePhysicalPageCachesEnd;
+    }
+
+    MmZeroedPageCount = 0;
+    KeSignalEvent(MmZeroedPageEvent, SignalOptionSignalAll);
+    Status = PsCreateKernelThread(MmpZeroPageThread,
+                                  NULL,
+                                  "MmpZeroPageThread");
+
+    if (!KSUCCESS(Status)) {
+        goto InitializePhysicalPageCachesEnd;
+    }
+
+InitializePhysicalPageCachesEnd:
+    if (!KSUCCESS(Status)) {
+        if (MmZeroedPages != NULL) {
+            MmFreeNonPagedPool(MmZeroedPages);
+            MmZeroedPages = NULL;
+        }
+
+        if (MmZeroedPageEvent != NULL) {
+            KeDestroyEvent(MmZeroedPageEvent);
+            MmZeroedPageEvent = NULL;
+        }
+    }
+
+    return Status;
+}
+
 //
 // --------------------------------------------------------- Internal Functions
 //
@@ -2279,7 +2985,7 @@ Return Value:
                 // The page isn't suitable if it's allocated.
                 //
 
-                if (PhysicalPage->U.Free != PHYSICAL_PAGE_FREE) {
+                if (!IS_PHYSICAL_PAGE_FREE(PhysicalPage)) {
                     ExitCheck = TRUE;
                 }
 
@@ -2292,7 +2998,7 @@ Return Value:
                 // Free or non-pagable pages cannot be paged out.
                 //
 
-                if ((PhysicalPage->U.Free == PHYSICAL_PAGE_FREE) ||
+                if ((IS_PHYSICAL_PAGE_FREE(PhysicalPage) != FALSE) ||
                     ((Flags & PHYSICAL_PAGE_FLAG_NON_PAGED) != 0)) {
 
                     ExitCheck = TRUE;
@@ -2305,9 +3011,12 @@ Return Value:
 
                     //
                     // If the paging entry is locked, it cannot be paged out.
+                    // Pages that have been used recently get passed over too.
                     //
 
-                    if (PagingEntry->U.LockCount != 0) {
+                    if ((PagingEntry->U.LockCount != 0) ||
+                        (MmpAgePagingEntry(PagingEntry, FALSE) == FALSE)) {
+
                         ExitCheck = TRUE;
 
                     //
@@ -2331,7 +3040,7 @@ Return Value:
             //
 
             case PhysicalMemoryFindIdentityMappable:
-                if (PhysicalPage->U.Free != PHYSICAL_PAGE_FREE) {
+                if (!IS_PHYSICAL_PAGE_FREE(PhysicalPage)) {
                     ExitCheck = TRUE;
 
                 } else {
@@ -2878,3 +3587,1150 @@ Return Value:
     return SignalEvent;
 }
 
+PPHYSICAL_MEMORY_SEGMENT
+MmpGetPhysicalMemorySegment (
+    PHYSICAL_ADDRESS PhysicalAddress,
+    PUINTN SegmentOffset
+    )
+
+/*++
+
+Routine Description:
+
+    This routine finds the physical memory segment containing the given
+    physical address. The segment list does not change after initialization,
+    so this routine does not need the physical page lock.
+
+Arguments:
+
+    PhysicalAddress - Supplies the physical address to look up.
+
+    SegmentOffset - Supplies a pointer where the page offset of the address
+        within the segment will be returned.
+
+Return Value:
+
+    Returns a pointer to the segment containing the address.
+
+    NULL if the address does not belong to any segment.
+
+--*/
+
+{
+
+    PLIST_ENTRY CurrentEntry;
+    PPHYSICAL_MEMORY_SEGMENT Segment;
+
+    CurrentEntry = MmPhysicalSegmentListHead.Next;
+    while (CurrentEntry != &MmPhysicalSegmentListHead) {
+        Segment = LIST_VALUE(CurrentEntry, PHYSICAL_MEMORY_SEGMENT, ListEntry);
+        if ((PhysicalAddress >= Segment->StartAddress) &&
+            (PhysicalAddress < Segment->EndAddress)) {
+
+            *SegmentOffset = (UINTN)((PhysicalAddress -
+                                      Segment->StartAddress) >>
+                                     MmPageShift());
+
+            return Segment;
+        }
+
+        CurrentEntry = CurrentEntry->Next;
+    }
+
+    return NULL;
+}
+
+PPHYSICAL_MEMORY_SEGMENT
+MmpAllocateFreeBlock (
+    UINTN PageCount,
+    UINTN PageAlignment,
+    PUINTN SelectedPageOffset
+    )
+
+/*++
+
+Routine Description:
+
+    This routine takes a run of free pages off of the free lists. The pages
+    are left set to the free value, and it is up to the caller to mark them
+    allocated and update the segment's free page count. The caller must hold
+    the physical page lock if it exists.
+
+Arguments:
+
+    PageCount - Supplies the number of consecutive pages needed.
+
+    PageAlignment - Supplies the alignment of the allocation, in pages. This
+        must be a power of two.
+
+    SelectedPageOffset - Supplies a pointer where the page offset of the run
+        within the returned segment will be returned on success.
+
+Return Value:
+
+    Returns a pointer to the memory segment the pages were taken from.
+
+    NULL if there is not enough contiguous free memory to satisfy the request.
+
+--*/
+
+{
+
+    UINTN BlockPages;
+    PLIST_ENTRY CurrentEntry;
+    UINTN Offset;
+    ULONG Order;
+    ULONG SearchOrder;
+    PPHYSICAL_MEMORY_SEGMENT Segment;
+
+    ASSERT((MmPhysicalPageLock == NULL) ||
+           (KeIsQueuedLockHeld(MmPhysicalPageLock) != FALSE));
+
+    ASSERT((PageCount != 0) && (POWER_OF_2(PageAlignment) != FALSE));
+
+    //
+    // Blocks are naturally aligned, so a block big enough for both the size
+    // and the alignment satisfies the request.
+    //
+
+    BlockPages = 1;
+    Order = 0;
+    while ((BlockPages < PageCount) || (BlockPages < PageAlignment)) {
+        BlockPages <<= 1;
+        Order += 1;
+    }
+
+    if (Order <= PHYSICAL_PAGE_MAX_ORDER) {
+        CurrentEntry = MmPhysicalSegmentListHead.Next;
+        while (CurrentEntry != &MmPhysicalSegmentListHead) {
+            Segment = LIST_VALUE(CurrentEntry,
+                                 PHYSICAL_MEMORY_SEGMENT,
+                                 ListEntry);
+
+            CurrentEntry = CurrentEntry->Next;
+            if (Segment->FreePages < BlockPages) {
+                continue;
+            }
+
+            for (SearchOrder = Order;
+                 SearchOrder <= PHYSICAL_PAGE_MAX_ORDER;
+                 SearchOrder += 1) {
+
+                if (Segment->FreeLists[SearchOrder] !=
+                    PHYSICAL_PAGE_LIST_END) {
+
+                    break;
+                }
+            }
+
+            if (SearchOrder > PHYSICAL_PAGE_MAX_ORDER) {
+                continue;
+            }
+
+            //
+            // Split the block down to the needed size, putting the upper
+            // halves back. Then give back whatever is past the end of the
+            // request.
+            //
+
+            Offset = Segment->FreeLists[SearchOrder];
+            MmpUnlinkFreeBlock(Segment, Offset, SearchOrder);
+            while (SearchOrder > Order) {
+                SearchOrder -= 1;
+                MmpLinkFreeBlock(Segment,
+                                 Offset + ((UINTN)1 << SearchOrder),
+                                 SearchOrder);
+            }
+
+            if (BlockPages > PageCount) {
+                MmpInsertFreeRange(Segment,
+                                   Offset + PageCount,
+                                   BlockPages - PageCount);
+            }
+
+            *SelectedPageOffset = Offset;
+            return Segment;
+        }
+
+        //
+        // A single page is always a block of its own, so there is nothing
+        // more to find.
+        //
+
+        if (PageCount == 1) {
+            return NULL;
+        }
+    }
+
+    //
+    // Big requests, and runs that straddle block boundaries, fall back to
+    // scanning the page database.
+    //
+
+    Segment = MmpFindPhysicalPages(PageCount,
+                                   PageAlignment,
+                                   PhysicalMemoryFindFree,
+                                   &Offset,
+                                   NULL);
+
+    if (Segment != NULL) {
+        MmpRemoveFreeRange(Segment, Offset, PageCount);
+        *SelectedPageOffset = Offset;
+    }
+
+    return Segment;
+}
+
+VOID
+MmpInsertFreeRange (
+    PPHYSICAL_MEMORY_SEGMENT Segment,
+    UINTN Offset,
+    UINTN PageCount
+    )
+
+/*++
+
+Routine Description:
+
+    This routine puts a run of pages onto the free lists of their segment,
+    carving it up into naturally aligned blocks. The pages must already be
+    set to the free value. The caller must hold the physical page lock if it
+    exists.
+
+Arguments:
+
+    Segment - Supplies a pointer to the segment owning the pages.
+
+    Offset - Supplies the page offset of the start of the run in the segment.
+
+    PageCount - Supplies the number of pages in the run.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    UINTN BasePage;
+    ULONG Order;
+
+    ASSERT((MmPhysicalPageLock == NULL) ||
+           (KeIsQueuedLockHeld(MmPhysicalPageLock) != FALSE));
+
+    BasePage = (UINTN)(Segment->StartAddress >> MmPageShift());
+    while (PageCount != 0) {
+        Order = 0;
+        while ((Order < PHYSICAL_PAGE_MAX_ORDER) &&
+               (((UINTN)2 << Order) <= PageCount) &&
+               (((BasePage + Offset) & (((UINTN)2 << Order) - 1)) == 0)) {
+
+            Order += 1;
+        }
+
+        MmpInsertFreeBlock(Segment, Offset, Order);
+        Offset += (UINTN)1 << Order;
+        PageCount -= (UINTN)1 << Order;
+    }
+
+    return;
+}
+
+VOID
+MmpRemoveFreeRange (
+    PPHYSICAL_MEMORY_SEGMENT Segment,
+    UINTN Offset,
+    UINTN PageCount
+    )
+
+/*++
+
+Routine Description:
+
+    This routine takes a run of free pages off of the free lists of their
+    segment, giving back the parts of any blocks that hang off the ends of
+    the run. On return the pages in the run are set to the free value but
+    belong to no free block. The caller must hold the physical page lock if it
+    exists.
+
+Arguments:
+
+    Segment - Supplies a pointer to the segment owning the pages.
+
+    Offset - Supplies the page offset of the start of the run in the segment.
+
+    PageCount - Supplies the number of pages in the run. Every one of them
+        must be free.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    UINTN BasePage;
+    UINTN BlockEnd;
+    UINTN BlockStart;
+    UINTN Current;
+    UINTN End;
+    ULONG Order;
+    PPHYSICAL_PAGE PhysicalPage;
+
+    ASSERT((MmPhysicalPageLock == NULL) ||
+           (KeIsQueuedLockHeld(MmPhysicalPageLock) != FALSE));
+
+    BasePage = (UINTN)(Segment->StartAddress >> MmPageShift());
+    PhysicalPage = (PPHYSICAL_PAGE)(Segment + 1);
+    Current = Offset;
+    End = Offset + PageCount;
+    while (Current < End) {
+
+        //
+        // Find the free block containing the current page. It starts at the
+        // current page rounded down to the block's size.
+        //
+
+        BlockStart = 0;
+        for (Order = 0; Order <= PHYSICAL_PAGE_MAX_ORDER; Order += 1) {
+            if (((BasePage + Current) & ~(((UINTN)1 << Order) - 1)) <
+                BasePage) {
+
+                Order = PHYSICAL_PAGE_ORDER_COUNT;
+                break;
+            }
+
+            BlockStart = ((BasePage + Current) &
+                          ~(((UINTN)1 << Order) - 1)) - BasePage;
+
+            if (PhysicalPage[BlockStart].U.Flags ==
+                PHYSICAL_PAGE_FREE_BLOCK(Order)) {
+
+                break;
+            }
+        }
+
+        ASSERT(Order <= PHYSICAL_PAGE_MAX_ORDER);
+
+        if (Order > PHYSICAL_PAGE_MAX_ORDER) {
+            break;
+        }
+
+        MmpUnlinkFreeBlock(Segment, BlockStart, Order);
+        BlockEnd = BlockStart + ((UINTN)1 << Order);
+        if (BlockStart < Current) {
+            MmpInsertFreeRange(Segment, BlockStart, Current - BlockStart);
+        }
+
+        if (BlockEnd > End) {
+            MmpInsertFreeRange(Segment, End, BlockEnd - End);
+        }
+
+        Current = BlockEnd;
+    }
+
+    return;
+}
+
+VOID
+MmpInsertFreeBlock (
+    PPHYSICAL_MEMORY_SEGMENT Segment,
+    UINTN Offset,
+    ULONG Order
+    )
+
+/*++
+
+Routine Description:
+
+    This routine puts a naturally aligned block of free pages onto the free
+    lists, merging it with its buddy for as long as the buddy is also free.
+    The caller must hold the physical page lock if it exists.
+
+Arguments:
+
+    Segment - Supplies a pointer to the segment owning the block.
+
+    Offset - Supplies the page offset of the start of the block.
+
+    Order - Supplies the order of the block.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    UINTN BasePage;
+    UINTN BuddyOffset;
+    UINTN BuddyPage;
+    PPHYSICAL_PAGE PhysicalPage;
+    UINTN SegmentPageCount;
+
+    BasePage = (UINTN)(Segment->StartAddress >> MmPageShift());
+    SegmentPageCount = (UINTN)((Segment->EndAddress - Segment->StartAddress) >>
+                               MmPageShift());
+
+    PhysicalPage = (PPHYSICAL_PAGE)(Segment + 1);
+
+    ASSERT(PhysicalPage[Offset].U.Free == PHYSICAL_PAGE_FREE);
+
+    while (Order < PHYSICAL_PAGE_MAX_ORDER) {
+
+        //
+        // The buddy has to lie entirely within the segment and be the start
+        // of a free block of the same size.
+        //
+
+        BuddyPage = (BasePage + Offset) ^ ((UINTN)1 << Order);
+        if (BuddyPage < BasePage) {
+            break;
+        }
+
+        BuddyOffset = BuddyPage - BasePage;
+        if ((BuddyOffset + ((UINTN)1 << Order)) > SegmentPageCount) {
+            break;
+        }
+
+        if (PhysicalPage[BuddyOffset].U.Flags !=
+            PHYSICAL_PAGE_FREE_BLOCK(Order)) {
+
+            break;
+        }
+
+        MmpUnlinkFreeBlock(Segment, BuddyOffset, Order);
+        if (BuddyOffset < Offset) {
+            Offset = BuddyOffset;
+        }
+
+        Order += 1;
+    }
+
+    MmpLinkFreeBlock(Segment, Offset, Order);
+    return;
+}
+
+VOID
+MmpLinkFreeBlock (
+    PPHYSICAL_MEMORY_SEGMENT Segment,
+    UINTN Offset,
+    ULONG Order
+    )
+
+/*++
+
+Routine Description:
+
+    This routine marks the given pages as a free block and pushes it onto the
+    free list for its order, without attempting to merge it.
+
+Arguments:
+
+    Segment - Supplies a pointer to the segment owning the block.
+
+    Offset - Supplies the page offset of the start of the block.
+
+    Order - Supplies the order of the block.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG Next;
+    PPHYSICAL_PAGE PhysicalPage;
+
+    PhysicalPage = (PPHYSICAL_PAGE)(Segment + 1);
+    Next = Segment->FreeLists[Order];
+    PhysicalPage[Offset].U.Flags = PHYSICAL_PAGE_FREE_BLOCK(Order);
+    PhysicalPage[Offset].Next = Next;
+    PhysicalPage[Offset].Previous = PHYSICAL_PAGE_LIST_END;
+    if (Next != PHYSICAL_PAGE_LIST_END) {
+        PhysicalPage[Next].Previous = (ULONG)Offset;
+    }
+
+    Segment->FreeLists[Order] = (ULONG)Offset;
+    return;
+}
+
+VOID
+MmpUnlinkFreeBlock (
+    PPHYSICAL_MEMORY_SEGMENT Segment,
+    UINTN Offset,
+    ULONG Order
+    )
+
+/*++
+
+Routine Description:
+
+    This routine removes a free block from the free list for its order. The
+    first page of the block is reset to the plain free value.
+
+Arguments:
+
+    Segment - Supplies a pointer to the segment owning the block.
+
+    Offset - Supplies the page offset of the start of the block.
+
+    Order - Supplies the order of the block.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG Next;
+    PPHYSICAL_PAGE PhysicalPage;
+    ULONG Previous;
+
+    PhysicalPage = (PPHYSICAL_PAGE)(Segment + 1);
+
+    ASSERT(PhysicalPage[Offset].U.Flags == PHYSICAL_PAGE_FREE_BLOCK(Order));
+
+    Next = PhysicalPage[Offset].Next;
+    Previous = PhysicalPage[Offset].Previous;
+    if (Previous == PHYSICAL_PAGE_LIST_END) {
+
+        ASSERT(Segment->FreeLists[Order] == Offset);
+
+        Segment->FreeLists[Order] = Next;
+
+    } else {
+        PhysicalPage[Previous].Next = Next;
+    }
+
+    if (Next != PHYSICAL_PAGE_LIST_END) {
+        PhysicalPage[Next].Previous = Previous;
+    }
+
+    PhysicalPage[Offset].U.Free = PHYSICAL_PAGE_FREE;
+    return;
+}
+
+UINTN
+MmpTakeFreePhysicalPages (
+    PPHYSICAL_ADDRESS Pages,
+    UINTN PageCount,
+    UINTN Reserve
+    )
+
+/*++
+
+Routine Description:
+
+    This routine allocates up to the given number of single physical pages
+    without ever waiting for memory to be paged out. The pages are accounted
+    as allocated non-paged pages.
+
+Arguments:
+
+    Pages - Supplies a pointer to an array where the physical addresses of the
+        allocated pages will be returned.
+
+    PageCount - Supplies the most pages to allocate.
+
+    Reserve - Supplies the number of free pages to leave alone. Allocation
+        stops once the system gets down to this many free pages.
+
+Return Value:
+
+    Returns the number of pages allocated, which may be zero.
+
+--*/
+
+{
+
+    UINTN Offset;
+    ULONG PageShift;
+    PPHYSICAL_PAGE PhysicalPage;
+    PPHYSICAL_MEMORY_SEGMENT Segment;
+    BOOL SignalEvent;
+    UINTN Taken;
+
+    ASSERT(KeGetRunLevel() == RunLevelLow);
+
+    PageShift = MmPageShift();
+    SignalEvent = FALSE;
+    Taken = 0;
+    KeAcquireQueuedLock(MmPhysicalPageLock);
+    while (Taken < PageCount) {
+        if ((MmTotalPhysicalPages - MmTotalAllocatedPhysicalPages) <= Reserve) {
+            break;
+        }
+
+        Segment = MmpAllocateFreeBlock(1, 1, &Offset);
+        if (Segment == NULL) {
+            break;
+        }
+
+        PhysicalPage = (PPHYSICAL_PAGE)(Segment + 1);
+        PhysicalPage[Offset].U.Flags = PHYSICAL_PAGE_FLAG_NON_PAGED;
+        Segment->FreePages -= 1;
+        Pages[Taken] = Segment->StartAddress + (Offset << PageShift);
+        Taken += 1;
+    }
+
+    if (Taken != 0) {
+        SignalEvent = MmpUpdatePhysicalMemoryStatistics(Taken, TRUE);
+    }
+
+    KeReleaseQueuedLock(MmPhysicalPageLock);
+    if (SignalEvent != FALSE) {
+
+        ASSERT(MmPhysicalMemoryWarningEvent != NULL);
+
+        KeSignalEvent(MmPhysicalMemoryWarningEvent, SignalOptionPulse);
+    }
+
+    return Taken;
+}
+
+VOID
+MmpReleasePhysicalPageBatch (
+    PPHYSICAL_ADDRESS Pages,
+    UINTN PageCount
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns a set of non-paged single pages, such as those held
+    in the page caches, to the free lists under one acquisition of the
+    physical page lock.
+
+Arguments:
+
+    Pages - Supplies a pointer to the array of physical addresses to free.
+
+    PageCount - Supplies the number of elements in the array.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    UINTN Index;
+    UINTN Offset;
+    PPHYSICAL_PAGE PhysicalPage;
+    PPHYSICAL_MEMORY_SEGMENT Segment;
+    BOOL SignalEvent;
+
+    ASSERT(KeGetRunLevel() == RunLevelLow);
+
+    if (PageCount == 0) {
+        return;
+    }
+
+    KeAcquireQueuedLock(MmPhysicalPageLock);
+    for (Index = 0; Index < PageCount; Index += 1) {
+        Segment = MmpGetPhysicalMemorySegment(Pages[Index], &Offset);
+
+        ASSERT(Segment != NULL);
+
+        PhysicalPage = (PPHYSICAL_PAGE)(Segment + 1);
+
+        ASSERT(PhysicalPage[Offset].U.Flags == PHYSICAL_PAGE_FLAG_NON_PAGED);
+
+        PhysicalPage[Offset].U.Free = PHYSICAL_PAGE_FREE;
+        MmpInsertFreeRange(Segment, Offset, 1);
+        Segment->FreePages += 1;
+    }
+
+    MmNonPagedPhysicalPages -= PageCount;
+    SignalEvent = MmpUpdatePhysicalMemoryStatistics(PageCount, FALSE);
+    KeReleaseQueuedLock(MmPhysicalPageLock);
+    if (SignalEvent != FALSE) {
+
+        ASSERT(MmPhysicalMemoryWarningEvent != NULL);
+
+        KeSignalEvent(MmPhysicalMemoryWarningEvent, SignalOptionPulse);
+    }
+
+    return;
+}
+
+PHYSICAL_ADDRESS
+MmpAllocateCachedPhysicalPage (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine attempts to allocate a single physical page out of the
+    current processor's page cache, refilling the cache from the free lists
+    if it is empty.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Returns the physical address of the allocated page.
+
+    INVALID_PHYSICAL_ADDRESS if the cache was empty and could not be refilled
+    without dipping into the minimum free page reserve.
+
+--*/
+
+{
+
+    PMM_PHYSICAL_PAGE_CACHE Cache;
+    RUNLEVEL OldRunLevel;
+    PHYSICAL_ADDRESS PhysicalAddress;
+    PHYSICAL_ADDRESS Refill[PHYSICAL_PAGE_CACHE_BATCH];
+    UINTN RefillCount;
+
+    PhysicalAddress = INVALID_PHYSICAL_ADDRESS;
+    OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+    Cache = &(KeGetCurrentProcessorBlock()->PhysicalPageCache);
+    KeAcquireSpinLock(&(Cache->Lock));
+    if (Cache->Count != 0) {
+        Cache->Count -= 1;
+        PhysicalAddress = Cache->Pages[Cache->Count];
+    }
+
+    KeReleaseSpinLock(&(Cache->Lock));
+    KeLowerRunLevel(OldRunLevel);
+    if (PhysicalAddress != INVALID_PHYSICAL_ADDRESS) {
+        return PhysicalAddress;
+    }
+
+    //
+    // Grab a batch of pages from the free lists, hand one back, and stash the
+    // rest. The thread may have moved to another processor by now, which is
+    // fine.
+    //
+
+    RefillCount = MmpTakeFreePhysicalPages(Refill,
+                                           PHYSICAL_PAGE_CACHE_BATCH,
+                                           MmMinimumFreePhysicalPages);
+
+    if (RefillCount == 0) {
+        return INVALID_PHYSICAL_ADDRESS;
+    }
+
+    RefillCount -= 1;
+    PhysicalAddress = Refill[RefillCount];
+    OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+    Cache = &(KeGetCurrentProcessorBlock()->PhysicalPageCache);
+    KeAcquireSpinLock(&(Cache->Lock));
+    while ((RefillCount != 0) &&
+           (Cache->Count < MM_PHYSICAL_PAGE_CACHE_DEPTH)) {
+
+        RefillCount -= 1;
+        Cache->Pages[Cache->Count] = Refill[RefillCount];
+        Cache->Count += 1;
+    }
+
+    KeReleaseSpinLock(&(Cache->Lock));
+    KeLowerRunLevel(OldRunLevel);
+
+    //
+    // If something else filled the cache in the meantime, give back the
+    // leftovers.
+    //
+
+    if (RefillCount != 0) {
+        MmpReleasePhysicalPageBatch(Refill, RefillCount);
+    }
+
+    return PhysicalAddress;
+}
+
+BOOL
+MmpFreeCachedPhysicalPage (
+    PHYSICAL_ADDRESS PhysicalAddress
+    )
+
+/*++
+
+Routine Description:
+
+    This routine attempts to park a freed physical page in the current
+    processor's page cache. If the cache is full, the older half of it is
+    returned to the free lists.
+
+Arguments:
+
+    PhysicalAddress - Supplies the physical address of the page being freed.
+
+Return Value:
+
+    TRUE if the page was taken by the cache.
+
+    FALSE if the page is not cacheable and must be freed normally.
+
+--*/
+
+{
+
+    PMM_PHYSICAL_PAGE_CACHE Cache;
+    PHYSICAL_ADDRESS Flush[PHYSICAL_PAGE_CACHE_BATCH];
+    UINTN FlushCount;
+    UINTN Index;
+    UINTN Offset;
+    RUNLEVEL OldRunLevel;
+    PPHYSICAL_PAGE PhysicalPage;
+    PPHYSICAL_MEMORY_SEGMENT Segment;
+
+    Segment = MmpGetPhysicalMemorySegment(PhysicalAddress, &Offset);
+    if (Segment == NULL) {
+        return FALSE;
+    }
+
+    //
+    // Only non-paged pages can be cached. Pagable pages need their paging
+    // entries torn down under the physical page lock. The caller owns the
+    // page, so its state cannot change underneath this check. Drop any page
+    // cache entry association it had.
+    //
+
+    PhysicalPage = (PPHYSICAL_PAGE)(Segment + 1);
+    PhysicalPage += Offset;
+
+    ASSERT(!IS_PHYSICAL_PAGE_FREE(PhysicalPage));
+
+    if ((PhysicalPage->U.Flags & PHYSICAL_PAGE_FLAG_NON_PAGED) == 0) {
+        return FALSE;
+    }
+
+    PhysicalPage->U.Flags = PHYSICAL_PAGE_FLAG_NON_PAGED;
+    FlushCount = 0;
+    OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+    Cache = &(KeGetCurrentProcessorBlock()->PhysicalPageCache);
+    KeAcquireSpinLock(&(Cache->Lock));
+    if (Cache->Count == MM_PHYSICAL_PAGE_CACHE_DEPTH) {
+        FlushCount = PHYSICAL_PAGE_CACHE_BATCH;
+        for (Index = 0; Index < MM_PHYSICAL_PAGE_CACHE_DEPTH; Index += 1) {
+            if (Index < FlushCount) {
+                Flush[Index] = Cache->Pages[Index];
+
+            } else {
+                Cache->Pages[Index - FlushCount] = Cache->Pages[Index];
+            }
+        }
+
+        Cache->Count -= FlushCount;
+    }
+
+    Cache->Pages[Cache->Count] = PhysicalAddress;
+    Cache->Count += 1;
+    KeReleaseSpinLock(&(Cache->Lock));
+    KeLowerRunLevel(OldRunLevel);
+    if (FlushCount != 0) {
+        MmpReleasePhysicalPageBatch(Flush, FlushCount);
+    }
+
+    return TRUE;
+}
+
+UINTN
+MmpDrainPhysicalPageCaches (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns every page sitting in the processor page caches and
+    the zeroed page pool back to the free lists. This is used when memory gets
+    tight, before resorting to paging.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Returns the number of pages returned to the free lists.
+
+--*/
+
+{
+
+    PMM_PHYSICAL_PAGE_CACHE Cache;
+    UINTN Count;
+    PHYSICAL_ADDRESS Flush[MM_PHYSICAL_PAGE_CACHE_DEPTH];
+    RUNLEVEL OldRunLevel;
+    ULONG ProcessorCount;
+    ULONG ProcessorNumber;
+    UINTN Total;
+
+    ASSERT(KeGetRunLevel() == RunLevelLow);
+
+    Total = 0;
+    ProcessorCount = KeGetActiveProcessorCount();
+    for (ProcessorNumber = 0;
+         ProcessorNumber < ProcessorCount;
+         ProcessorNumber += 1) {
+
+        Cache = &(KeGetProcessorBlock(ProcessorNumber)->PhysicalPageCache);
+        OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+        KeAcquireSpinLock(&(Cache->Lock));
+        Count = Cache->Count;
+        RtlCopyMemory(Flush, Cache->Pages, Count * sizeof(PHYSICAL_ADDRESS));
+        Cache->Count = 0;
+        KeReleaseSpinLock(&(Cache->Lock));
+        KeLowerRunLevel(OldRunLevel);
+        MmpReleasePhysicalPageBatch(Flush, Count);
+        Total += Count;
+    }
+
+    if (MmZeroedPages != NULL) {
+        do {
+            OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+            KeAcquireSpinLock(&MmZeroedPageLock);
+            Count = MmZeroedPageCount;
+            if (Count > MM_PHYSICAL_PAGE_CACHE_DEPTH) {
+                Count = MM_PHYSICAL_PAGE_CACHE_DEPTH;
+            }
+
+            MmZeroedPageCount -= Count;
+            RtlCopyMemory(Flush,
+                          &(MmZeroedPages[MmZeroedPageCount]),
+                          Count * sizeof(PHYSICAL_ADDRESS));
+
+            KeReleaseSpinLock(&MmZeroedPageLock);
+            KeLowerRunLevel(OldRunLevel);
+            MmpReleasePhysicalPageBatch(Flush, Count);
+            Total += Count;
+
+        } while (Count != 0);
+    }
+
+    return Total;
+}
+
+VOID
+MmpZeroPageThread (
+    PVOID Parameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine keeps the zeroed page pool topped up. It wakes up whenever
+    the pool drops to half full, and zeroes pages one at a time, yielding in
+    between so that it only really gets to run when nothing else wants the
+    processor. It never dips into memory that the rest of the system might
+    need.
+
+Arguments:
+
+    Parameter - Supplies a pointer supplied by the creator of the thread. This
+        parameter is not used.
+
+Return Value:
+
+    None. This thread never exits.
+
+--*/
+
+{
+
+    BOOL Added;
+    RUNLEVEL OldRunLevel;
+    PHYSICAL_ADDRESS PhysicalAddress;
+
+    while (TRUE) {
+        KeWaitForEvent(MmZeroedPageEvent, FALSE, WAIT_TIME_INDEFINITE);
+        KeSignalEvent(MmZeroedPageEvent, SignalOptionUnsignal);
+        while (MmZeroedPageCount < MmZeroedPageTarget) {
+            if (MmpTakeFreePhysicalPages(&PhysicalAddress,
+                                         1,
+                                         MmMinimumFreePhysicalPages * 2) == 0) {
+
+                break;
+            }
+
+            MmpZeroPage(PhysicalAddress);
+            Added = FALSE;
+            OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+            KeAcquireSpinLock(&MmZeroedPageLock);
+            if (MmZeroedPageCount < MmZeroedPageTarget) {
+                MmZeroedPages[MmZeroedPageCount] = PhysicalAddress;
+                MmZeroedPageCount += 1;
+                Added = TRUE;
+            }
+
+            KeReleaseSpinLock(&MmZeroedPageLock);
+            KeLowerRunLevel(OldRunLevel);
+            if (Added == FALSE) {
+                MmpReleasePhysicalPageBatch(&PhysicalAddress, 1);
+                break;
+            }
+
+            KeYield();
+        }
+    }
+
+    return;
+}
+
+BOOL
+MmpAgePagingEntry (
+    PPAGING_ENTRY PagingEntry,
+    BOOL SectionLockHeld
+    )
+
+/*++
+
+Routine Description:
+
+    This routine samples whether the given pagable page has been referenced
+    since it was last looked at and moves it between the active and inactive
+    states accordingly. Referenced pages are promoted to (or kept in) the
+    active state, giving inactive pages a second chance. Active pages that
+    were not referenced are moved to the inactive state. The physical page
+    lock must be held.
+
+Arguments:
+
+    PagingEntry - Supplies a pointer to the paging entry of the page.
+
+    SectionLockHeld - Supplies a boolean indicating whether the caller already
+        holds the lock of the page's image section.
+
+Return Value:
+
+    TRUE if the page is inactive and was not referenced, making it a good
+    candidate for eviction.
+
+    FALSE if the page should stay resident for now.
+
+--*/
+
+{
+
+    BOOL Accessed;
+    PADDRESS_SPACE AddressSpace;
+    PIMAGE_SECTION Section;
+    PVOID VirtualAddress;
+
+    ASSERT((MmPhysicalPageLock == NULL) ||
+           (KeIsQueuedLockHeld(MmPhysicalPageLock) != FALSE));
+
+    Section = PagingEntry->Section;
+    AddressSpace = Section->AddressSpace;
+    VirtualAddress = Section->VirtualAddress +
+                     (PagingEntry->U.SectionOffset << MmPageShift());
+
+    //
+    // Children that inherit the page after a fork map it too, and a reference
+    // through any of them counts. Walking the children needs the section
+    // lock, which is ordered before the physical page lock, so only try to
+    // get it here. If someone else has it, pass over the page this time
+    // rather than judge it by the owner's mapping alone.
+    //
+
+    if (SectionLockHeld != FALSE) {
+        Accessed = MmpCheckAndClearSectionAccessedBit(
+                                                 Section,
+                                                 PagingEntry->U.SectionOffset);
+
+    } else if (LIST_EMPTY(&(Section->ChildList)) == FALSE) {
+        if (KeTryToAcquireQueuedLock(Section->Lock) == FALSE) {
+            return FALSE;
+        }
+
+        Accessed = MmpCheckAndClearSectionAccessedBit(
+                                                 Section,
+                                                 PagingEntry->U.SectionOffset);
+
+        KeReleaseQueuedLock(Section->Lock);
+
+    } else {
+        Accessed = MmpCheckAndClearAccessedBit(AddressSpace, VirtualAddress);
+    }
+
+    if ((PagingEntry->U.Flags & PAGING_ENTRY_FLAG_ACTIVE) != 0) {
+        if (Accessed == FALSE) {
+            MmpDeactivatePagingEntry(PagingEntry);
+        }
+
+        return FALSE;
+    }
+
+    if (Accessed != FALSE) {
+        PagingEntry->U.Flags |= PAGING_ENTRY_FLAG_ACTIVE;
+        MmInactivePhysicalPages -= 1;
+        MmActivePhysicalPages += 1;
+        if (AddressSpace != NULL) {
+            AddressSpace->WorkingSet += 1;
+        }
+
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+VOID
+MmpDeactivatePagingEntry (
+    PPAGING_ENTRY PagingEntry
+    )
+
+/*++
+
+Routine Description:
+
+    This routine moves a pagable page to the inactive state and removes it
+    from its address space's working set. The physical page lock must be
+    held, and the page's image section must not yet be destroyed.
+
+Arguments:
+
+    PagingEntry - Supplies a pointer to the paging entry of the page.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PADDRESS_SPACE AddressSpace;
+
+    ASSERT((MmPhysicalPageLock == NULL) ||
+           (KeIsQueuedLockHeld(MmPhysicalPageLock) != FALSE));
+
+    if ((PagingEntry->U.Flags & PAGING_ENTRY_FLAG_ACTIVE) == 0) {
+        return;
+    }
+
+    ASSERT((PagingEntry->Section->Flags & IMAGE_SECTION_DESTROYED) == 0);
+
+    PagingEntry->U.Flags &= ~PAGING_ENTRY_FLAG_ACTIVE;
+    MmActivePhysicalPages -= 1;
+    MmInactivePhysicalPages += 1;
+    AddressSpace = PagingEntry->Section->AddressSpace;
+    if (AddressSpace != NULL) {
+
+        ASSERT(AddressSpace->WorkingSet != 0);
+
+        AddressSpace->WorkingSet -= 1;
+    }
+
+    return;
+}
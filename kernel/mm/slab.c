@@ -0,0 +1,1064 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    slab.c
+
+Abstract:
+
+    This module implements object caches, which hand out fixed size objects
+    carved from block allocator segments. Freed objects stay constructed and
+    sit on per-processor free lists until they are allocated again or the
+    system needs the memory back.
+
+Author:
+
+    agent 16-Oct-2026
+
+Environment:
+
+    Kernel
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <minoca/kernel/kernel.h>
+#include "mmp.h"
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+//
+// Define the object cache allocation tag: MmSl
+//
+
+#define OBJECT_CACHE_ALLOCATION_TAG 0x6C536D4D
+
+//
+// Define the number of free objects each processor's list can hold.
+//
+
+#define OBJECT_CACHE_DEPTH 16
+
+//
+// Define the number of objects moved off of a full processor list at once.
+//
+
+#define OBJECT_CACHE_FLUSH_COUNT (OBJECT_CACHE_DEPTH / 2)
+
+//
+// This macro returns a pointer to the hidden link used to chain a free
+// non-paged object into the depot.
+//
+
+#define OBJECT_CACHE_LINK(_Cache, _Object) \
+    ((PVOID *)((PUCHAR)(_Object) + (_Cache)->LinkOffset))
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+/*++
+
+Structure Description:
+
+    This structure defines an object cache's free list for one processor.
+
+Members:
+
+    Lock - Stores the spin lock protecting the list. This is only ever
+        contended when reclaim is emptying the list.
+
+    Count - Stores the number of objects in the list.
+
+    HitCount - Stores the number of allocations satisfied by this list.
+
+    FreeCount - Stores the number of objects freed on this processor.
+
+    Objects - Stores the free objects. The most recently freed object is at
+        the end.
+
+--*/
+
+typedef struct _OBJECT_CACHE_PROCESSOR {
+    KSPIN_LOCK Lock;
+    ULONG Count;
+    ULONGLONG HitCount;
+    ULONGLONG FreeCount;
+    PVOID Objects[OBJECT_CACHE_DEPTH];
+} OBJECT_CACHE_PROCESSOR, *POBJECT_CACHE_PROCESSOR;
+
+/*++
+
+Structure Description:
+
+    This structure defines an object cache.
+
+Members:
+
+    ListEntry - Stores pointers to the next and previous caches in the global
+        list.
+
+    Name - Stores the name of the cache.
+
+    Flags - Stores a bitmask of flags. See MM_OBJECT_CACHE_FLAG_* definitions.
+
+    ObjectSize - Stores the size of an object as requested by the creator.
+
+    ObjectStride - Stores the size of each block in the backing allocator.
+
+    LinkOffset - Stores the offset within each object of the pointer used to
+        chain it into the depot. Only non-paged caches have one.
+
+    Tag - Stores the allocation tag for the cache's memory.
+
+    Constructor - Stores an optional pointer to the object constructor.
+
+    Destructor - Stores an optional pointer to the object destructor.
+
+    Context - Stores the context pointer passed to the constructor and
+        destructor.
+
+    Allocator - Stores a pointer to the block allocator backing the cache.
+
+    Processors - Stores a pointer to the array of per-processor free lists.
+
+    ProcessorCount - Stores the number of elements in the processor array.
+
+    ProcessorStride - Stores the size of each processor array element, which
+        is padded out so that no two processors share a cache line.
+
+    DepotLock - Stores the spin lock protecting the depot.
+
+    Depot - Stores the head of the list of objects freed above low level
+        when the processor's list was full. Non-paged caches only.
+
+    DepotCount - Stores the number of objects in the depot.
+
+    ObjectCount - Stores the number of constructed objects, whether they are
+        allocated or sitting in the cache.
+
+    MissCount - Stores the number of allocations not satisfied by a processor
+        list.
+
+    ReclaimCount - Stores the number of objects released by reclaim.
+
+--*/
+
+struct _MM_OBJECT_CACHE {
+    LIST_ENTRY ListEntry;
+    CHAR Name[MM_OBJECT_CACHE_NAME_SIZE];
+    ULONG Flags;
+    ULONG ObjectSize;
+    ULONG ObjectStride;
+    ULONG LinkOffset;
+    ULONG Tag;
+    PMM_OBJECT_CONSTRUCTOR Constructor;
+    PMM_OBJECT_DESTRUCTOR Destructor;
+    PVOID Context;
+    PBLOCK_ALLOCATOR Allocator;
+    PVOID Processors;
+    ULONG ProcessorCount;
+    ULONG ProcessorStride;
+    KSPIN_LOCK DepotLock;
+    PVOID Depot;
+    UINTN DepotCount;
+    volatile UINTN ObjectCount;
+    volatile ULONGLONG MissCount;
+    volatile ULONGLONG ReclaimCount;
+};
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+POBJECT_CACHE_PROCESSOR
+MmpGetObjectCacheProcessor (
+    PMM_OBJECT_CACHE Cache,
+    ULONG Number
+    );
+
+VOID
+MmpReleaseObjects (
+    PMM_OBJECT_CACHE Cache,
+    PVOID *Objects,
+    ULONG Count
+    );
+
+UINTN
+MmpReclaimObjectCache (
+    PMM_OBJECT_CACHE Cache
+    );
+
+VOID
+MmpObjectCacheReclaimWorkRoutine (
+    PVOID Parameter
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// Store the list of all object caches, and the lock that protects it.
+//
+
+LIST_ENTRY MmObjectCacheList;
+PQUEUED_LOCK MmObjectCacheListLock;
+
+//
+// Store the work item that reclaims cached objects under memory pressure, and
+// whether or not it is already queued.
+//
+
+PWORK_ITEM MmObjectCacheReclaimWorkItem;
+volatile ULONG MmObjectCacheReclaimQueued;
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+KERNEL_API
+PMM_OBJECT_CACHE
+MmCreateObjectCache (
+    PCSTR Name,
+    ULONG ObjectSize,
+    ULONG Alignment,
+    PMM_OBJECT_CONSTRUCTOR Constructor,
+    PMM_OBJECT_DESTRUCTOR Destructor,
+    PVOID Context,
+    ULONG Flags,
+    ULONG Tag
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates a cache of fixed size objects. Objects are laid out
+    on cache line boundaries in block allocator segments, and freed objects
+    are kept constructed on per-processor free lists so that they can be
+    handed back out quickly. This routine must be called at low level.
+
+Arguments:
+
+    Name - Supplies the name of the cache, used for statistics. The name is
+        copied and truncated if needed.
+
+    ObjectSize - Supplies the size of each object, in bytes.
+
+    Alignment - Supplies the required alignment of each object, in bytes.
+        This must be a power of two or zero. Objects are always aligned to at
+        least a cache line.
+
+    Constructor - Supplies an optional pointer to a routine called to set up
+        each object when it is first carved out of memory.
+
+    Destructor - Supplies an optional pointer to a routine called to tear
+        down each object before its memory is given back.
+
+    Context - Supplies an optional context pointer passed to the constructor
+        and destructor.
+
+    Flags - Supplies a bitmask of flags governing the cache. See
+        MM_OBJECT_CACHE_FLAG_* definitions.
+
+    Tag - Supplies an identifier to associate with the cache's memory, useful
+        for debugging and leak detection.
+
+Return Value:
+
+    Returns a pointer to the new object cache on success.
+
+    NULL on failure.
+
+--*/
+
+{
+
+    ULONG AllocationSize;
+    ULONG BlockFlags;
+    PMM_OBJECT_CACHE Cache;
+    ULONG ExpansionCount;
+    ULONG Index;
+    ULONG LineSize;
+    POBJECT_CACHE_PROCESSOR Processor;
+    ULONG ProcessorCount;
+    ULONG ProcessorStride;
+
+    ASSERT(KeGetRunLevel() == RunLevelLow);
+    ASSERT(MmObjectCacheListLock != NULL);
+
+    if ((ObjectSize == 0) || (!POWER_OF_2(Alignment))) {
+        return NULL;
+    }
+
+    LineSize = HlGetDataCacheLineSize();
+    if (LineSize < sizeof(PVOID)) {
+        LineSize = sizeof(PVOID);
+    }
+
+    if (Alignment < LineSize) {
+        Alignment = LineSize;
+    }
+
+    //
+    // Each processor's free list gets its own cache lines so that processors
+    // do not fight over them.
+    //
+
+    ProcessorCount = KeGetActiveProcessorCount();
+    ProcessorStride = ALIGN_RANGE_UP(sizeof(OBJECT_CACHE_PROCESSOR), LineSize);
+    AllocationSize = sizeof(MM_OBJECT_CACHE) + LineSize +
+                     (ProcessorStride * ProcessorCount);
+
+    Cache = MmAllocateNonPagedPool(AllocationSize, OBJECT_CACHE_ALLOCATION_TAG);
+    if (Cache == NULL) {
+        return NULL;
+    }
+
+    RtlZeroMemory(Cache, AllocationSize);
+    RtlStringCopy(Cache->Name, Name, MM_OBJECT_CACHE_NAME_SIZE);
+    Cache->Flags = Flags;
+    Cache->ObjectSize = ObjectSize;
+    Cache->Tag = Tag;
+    Cache->Constructor = Constructor;
+    Cache->Destructor = Destructor;
+    Cache->Context = Context;
+    Cache->Processors = (PVOID)(UINTN)ALIGN_RANGE_UP((UINTN)(Cache + 1),
+                                                     LineSize);
+    Cache->ProcessorCount = ProcessorCount;
+    Cache->ProcessorStride = ProcessorStride;
+    KeInitializeSpinLock(&(Cache->DepotLock));
+    for (Index = 0; Index < ProcessorCount; Index += 1) {
+        Processor = MmpGetObjectCacheProcessor(Cache, Index);
+        KeInitializeSpinLock(&(Processor->Lock));
+    }
+
+    //
+    // Non-paged objects can be freed at dispatch level, where the block
+    // allocator cannot be used. Give each one a hidden link after the object
+    // so it can be parked in the depot without disturbing its constructed
+    // state.
+    //
+
+    Cache->ObjectStride = ObjectSize;
+    BlockFlags = BLOCK_ALLOCATOR_FLAG_TRIM | BLOCK_ALLOCATOR_FLAG_COLOR;
+    if ((Flags & MM_OBJECT_CACHE_FLAG_NON_PAGED) != 0) {
+        BlockFlags |= BLOCK_ALLOCATOR_FLAG_NON_PAGED;
+        Cache->LinkOffset = ALIGN_RANGE_UP(ObjectSize, sizeof(PVOID));
+        Cache->ObjectStride = Cache->LinkOffset + sizeof(PVOID);
+    }
+
+    Cache->ObjectStride = ALIGN_RANGE_UP(Cache->ObjectStride, Alignment);
+    ExpansionCount = MmPageSize() / Cache->ObjectStride;
+    if (ExpansionCount == 0) {
+        ExpansionCount = 1;
+    }
+
+    Cache->Allocator = MmCreateBlockAllocator(Cache->ObjectStride,
+                                              Alignment,
+                                              ExpansionCount,
+                                              BlockFlags,
+                                              Tag);
+
+    if (Cache->Allocator == NULL) {
+        MmFreeNonPagedPool(Cache);
+        return NULL;
+    }
+
+    KeAcquireQueuedLock(MmObjectCacheListLock);
+    INSERT_BEFORE(&(Cache->ListEntry), &MmObjectCacheList);
+    KeReleaseQueuedLock(MmObjectCacheListLock);
+    return Cache;
+}
+
+KERNEL_API
+VOID
+MmDestroyObjectCache (
+    PMM_OBJECT_CACHE Cache
+    )
+
+/*++
+
+Routine Description:
+
+    This routine destroys an object cache. All objects must have been freed
+    back to the cache. This routine must be called at low level.
+
+Arguments:
+
+    Cache - Supplies a pointer to the cache to destroy.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ASSERT(KeGetRunLevel() == RunLevelLow);
+
+    KeAcquireQueuedLock(MmObjectCacheListLock);
+    LIST_REMOVE(&(Cache->ListEntry));
+    KeReleaseQueuedLock(MmObjectCacheListLock);
+    MmpReclaimObjectCache(Cache);
+
+    ASSERT(Cache->ObjectCount == 0);
+
+    MmDestroyBlockAllocator(Cache->Allocator);
+    MmFreeNonPagedPool(Cache);
+    return;
+}
+
+KERNEL_API
+PVOID
+MmAllocateObject (
+    PMM_OBJECT_CACHE Cache
+    )
+
+/*++
+
+Routine Description:
+
+    This routine allocates a constructed object from an object cache. Paged
+    caches must be used at low level. Non-paged caches can be used at
+    dispatch level, but there the allocation can only be satisfied by objects
+    the cache is already holding.
+
+Arguments:
+
+    Cache - Supplies a pointer to the cache to allocate from.
+
+Return Value:
+
+    Returns a pointer to the object on success.
+
+    NULL on failure.
+
+--*/
+
+{
+
+    PVOID Object;
+    RUNLEVEL OldRunLevel;
+    POBJECT_CACHE_PROCESSOR Processor;
+    KSTATUS Status;
+
+    ASSERT(KeGetRunLevel() <= RunLevelDispatch);
+    ASSERT(((Cache->Flags & MM_OBJECT_CACHE_FLAG_NON_PAGED) != 0) ||
+           (KeGetRunLevel() == RunLevelLow));
+
+    Object = NULL;
+    OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+    Processor = MmpGetObjectCacheProcessor(Cache,
+                                           KeGetCurrentProcessorNumber());
+
+    if (Processor != NULL) {
+        KeAcquireSpinLock(&(Processor->Lock));
+        if (Processor->Count != 0) {
+            Processor->Count -= 1;
+            Object = Processor->Objects[Processor->Count];
+            Processor->HitCount += 1;
+        }
+
+        KeReleaseSpinLock(&(Processor->Lock));
+        if (Object != NULL) {
+            KeLowerRunLevel(OldRunLevel);
+            return Object;
+        }
+    }
+
+    //
+    // Try the depot, which holds objects freed at dispatch level.
+    //
+
+    if (Cache->DepotCount != 0) {
+        KeAcquireSpinLock(&(Cache->DepotLock));
+        Object = Cache->Depot;
+        if (Object != NULL) {
+            Cache->Depot = *OBJECT_CACHE_LINK(Cache, Object);
+            Cache->DepotCount -= 1;
+        }
+
+        KeReleaseSpinLock(&(Cache->DepotLock));
+    }
+
+    KeLowerRunLevel(OldRunLevel);
+
+    //
+    // Carve a new object out of the block allocator if possible.
+    //
+
+    if ((Object == NULL) && (OldRunLevel == RunLevelLow)) {
+        Object = MmAllocateBlock(Cache->Allocator, NULL);
+        if (Object == NULL) {
+            return NULL;
+        }
+
+        if (Cache->Constructor != NULL) {
+            Status = Cache->Constructor(Object, Cache->Context);
+            if (!KSUCCESS(Status)) {
+                MmFreeBlock(Cache->Allocator, Object);
+                return NULL;
+            }
+        }
+
+        RtlAtomicAdd(&(Cache->ObjectCount), 1);
+    }
+
+    if (Object != NULL) {
+        RtlAtomicAdd64(&(Cache->MissCount), 1);
+    }
+
+    return Object;
+}
+
+KERNEL_API
+VOID
+MmFreeObject (
+    PMM_OBJECT_CACHE Cache,
+    PVOID Object
+    )
+
+/*++
+
+Routine Description:
+
+    This routine frees an object back to its object cache. The object should
+    be returned in its constructed state. Paged caches must be used at low
+    level, non-paged caches at or below dispatch level.
+
+Arguments:
+
+    Cache - Supplies a pointer to the cache the object came from.
+
+    Object - Supplies a pointer to the object to free.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PVOID Flush[OBJECT_CACHE_FLUSH_COUNT + 1];
+    ULONG FlushCount;
+    ULONG Index;
+    RUNLEVEL OldRunLevel;
+    POBJECT_CACHE_PROCESSOR Processor;
+
+    ASSERT(KeGetRunLevel() <= RunLevelDispatch);
+    ASSERT(((Cache->Flags & MM_OBJECT_CACHE_FLAG_NON_PAGED) != 0) ||
+           (KeGetRunLevel() == RunLevelLow));
+
+    FlushCount = 0;
+    OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+    Processor = MmpGetObjectCacheProcessor(Cache,
+                                           KeGetCurrentProcessorNumber());
+
+    if (Processor != NULL) {
+        KeAcquireSpinLock(&(Processor->Lock));
+        Processor->FreeCount += 1;
+
+        //
+        // If the list is full and the block allocator can be used, move the
+        // oldest objects off the list to make room.
+        //
+
+        if ((Processor->Count == OBJECT_CACHE_DEPTH) &&
+            (OldRunLevel == RunLevelLow)) {
+
+            FlushCount = OBJECT_CACHE_FLUSH_COUNT;
+            RtlCopyMemory(Flush,
+                          Processor->Objects,
+                          FlushCount * sizeof(PVOID));
+
+            Processor->Count -= FlushCount;
+            for (Index = 0; Index < Processor->Count; Index += 1) {
+                Processor->Objects[Index] =
+                                      Processor->Objects[Index + FlushCount];
+            }
+        }
+
+        if (Processor->Count < OBJECT_CACHE_DEPTH) {
+            Processor->Objects[Processor->Count] = Object;
+            Processor->Count += 1;
+            Object = NULL;
+        }
+
+        KeReleaseSpinLock(&(Processor->Lock));
+    }
+
+    //
+    // If the object did not fit, park it in the depot if at dispatch, or
+    // release it directly at low level.
+    //
+
+    if (Object != NULL) {
+        if (OldRunLevel == RunLevelLow) {
+            Flush[FlushCount] = Object;
+            FlushCount += 1;
+
+        } else {
+
+            ASSERT((Cache->Flags & MM_OBJECT_CACHE_FLAG_NON_PAGED) != 0);
+
+            KeAcquireSpinLock(&(Cache->DepotLock));
+            *OBJECT_CACHE_LINK(Cache, Object) = Cache->Depot;
+            Cache->Depot = Object;
+            Cache->DepotCount += 1;
+            KeReleaseSpinLock(&(Cache->DepotLock));
+        }
+    }
+
+    KeLowerRunLevel(OldRunLevel);
+    if (FlushCount != 0) {
+        MmpReleaseObjects(Cache, Flush, FlushCount);
+    }
+
+    return;
+}
+
+KSTATUS
+MmpInitializeObjectCaches (
+    ULONG Phase
+    )
+
+/*++
+
+Routine Description:
+
+    This routine initializes object cache support. Phase 2 sets up the list
+    of caches so that caches can be created. Phase 3 sets up memory pressure
+    reclaim, which needs the system work queue.
+
+Arguments:
+
+    Phase - Supplies the memory manager initialization phase.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    if (Phase == 2) {
+        INITIALIZE_LIST_HEAD(&MmObjectCacheList);
+        MmObjectCacheListLock = KeCreateQueuedLock();
+        if (MmObjectCacheListLock == NULL) {
+            return STATUS_INSUFFICIENT_RESOURCES;
+        }
+
+    } else {
+
+        ASSERT(Phase == 3);
+
+        MmObjectCacheReclaimWorkItem = KeCreateWorkItem(
+                                            NULL,
+                                            WorkPriorityNormal,
+                                            MmpObjectCacheReclaimWorkRoutine,
+                                            NULL,
+                                            OBJECT_CACHE_ALLOCATION_TAG);
+
+        if (MmObjectCacheReclaimWorkItem == NULL) {
+            return STATUS_INSUFFICIENT_RESOURCES;
+        }
+    }
+
+    return STATUS_SUCCESS;
+}
+
+VOID
+MmpRequestObjectCacheReclaim (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine asks all object caches to give back the free objects they
+    are holding. The reclaim happens on a work item, so this routine is safe
+    to call from the paging thread.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    KSTATUS Status;
+
+    if (MmObjectCacheReclaimWorkItem == NULL) {
+        return;
+    }
+
+    if (RtlAtomicCompareExchange32(&MmObjectCacheReclaimQueued, TRUE, FALSE) ==
+        FALSE) {
+
+        Status = KeQueueWorkItem(MmObjectCacheReclaimWorkItem);
+        if (!KSUCCESS(Status)) {
+            MmObjectCacheReclaimQueued = FALSE;
+        }
+    }
+
+    return;
+}
+
+KSTATUS
+MmpGetObjectCacheStatistics (
+    PVOID Data,
+    PUINTN DataSize,
+    BOOL Set
+    )
+
+/*++
+
+Routine Description:
+
+    This routine gets usage statistics for every object cache in the system.
+
+Arguments:
+
+    Data - Supplies a pointer to the data buffer where the data is either
+        returned for a get operation or given for a set operation.
+
+    DataSize - Supplies a pointer that on input contains the size of the
+        data buffer. On output, contains the required size of the data buffer.
+
+    Set - Supplies a boolean indicating if this is a get operation (FALSE) or
+        a set operation (TRUE).
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_BUFFER_TOO_SMALL if not all entries fit. As many entries as fit are
+    still returned.
+
+    Other status codes on failure.
+
+--*/
+
+{
+
+    PMM_OBJECT_CACHE Cache;
+    UINTN Cached;
+    UINTN Capacity;
+    ULONG CacheCount;
+    PLIST_ENTRY CurrentEntry;
+    PMM_OBJECT_CACHE_STATISTICS_ENTRY Entry;
+    UINTN FreeBlocks;
+    ULONGLONG Hits;
+    ULONG Index;
+    PMM_OBJECT_CACHE_STATISTICS Statistics;
+    POBJECT_CACHE_PROCESSOR Processor;
+    UINTN RequiredSize;
+    KSTATUS Status;
+
+    if (Set != FALSE) {
+        *DataSize = 0;
+        return STATUS_ACCESS_DENIED;
+    }
+
+    if (*DataSize < sizeof(MM_OBJECT_CACHE_STATISTICS)) {
+        *DataSize = sizeof(MM_OBJECT_CACHE_STATISTICS);
+        return STATUS_BUFFER_TOO_SMALL;
+    }
+
+    Statistics = Data;
+    if (Statistics->Version < MM_OBJECT_CACHE_STATISTICS_VERSION) {
+        return STATUS_VERSION_MISMATCH;
+    }
+
+    Capacity = (*DataSize - sizeof(MM_OBJECT_CACHE_STATISTICS)) /
+               sizeof(MM_OBJECT_CACHE_STATISTICS_ENTRY);
+
+    Entry = (PMM_OBJECT_CACHE_STATISTICS_ENTRY)(Statistics + 1);
+    CacheCount = 0;
+    KeAcquireQueuedLock(MmObjectCacheListLock);
+    CurrentEntry = MmObjectCacheList.Next;
+    while (CurrentEntry != &MmObjectCacheList) {
+        Cache = LIST_VALUE(CurrentEntry, MM_OBJECT_CACHE, ListEntry);
+        CurrentEntry = CurrentEntry->Next;
+        if (CacheCount >= Capacity) {
+            CacheCount += 1;
+            continue;
+        }
+
+        //
+        // The counts are read without the processor locks, so they are only
+        // a snapshot.
+        //
+
+        Cached = Cache->DepotCount;
+        Hits = 0;
+        Entry->FreeCount = 0;
+        for (Index = 0; Index < Cache->ProcessorCount; Index += 1) {
+            Processor = MmpGetObjectCacheProcessor(Cache, Index);
+            Cached += Processor->Count;
+            Hits += Processor->HitCount;
+            Entry->FreeCount += Processor->FreeCount;
+        }
+
+        RtlCopyMemory(Entry->Name, Cache->Name, MM_OBJECT_CACHE_NAME_SIZE);
+        Entry->Flags = Cache->Flags;
+        Entry->ObjectSize = Cache->ObjectSize;
+        Entry->ObjectStride = Cache->ObjectStride;
+        Entry->CachedObjects = Cached;
+        Entry->ActiveObjects = 0;
+        if (Cache->ObjectCount > Cached) {
+            Entry->ActiveObjects = Cache->ObjectCount - Cached;
+        }
+
+        MmpGetBlockAllocatorUsage(Cache->Allocator,
+                                  &(Entry->SlabCount),
+                                  &(Entry->SlabObjects),
+                                  &FreeBlocks);
+
+        Entry->MissCount = Cache->MissCount;
+        Entry->AllocationCount = Hits + Entry->MissCount;
+        Entry->ReclaimCount = Cache->ReclaimCount;
+        Entry += 1;
+        CacheCount += 1;
+    }
+
+    KeReleaseQueuedLock(MmObjectCacheListLock);
+    RequiredSize = sizeof(MM_OBJECT_CACHE_STATISTICS) +
+                   (CacheCount * sizeof(MM_OBJECT_CACHE_STATISTICS_ENTRY));
+
+    Status = STATUS_SUCCESS;
+    if (CacheCount > Capacity) {
+        CacheCount = Capacity;
+        Status = STATUS_BUFFER_TOO_SMALL;
+    }
+
+    Statistics->CacheCount = CacheCount;
+    *DataSize = RequiredSize;
+    return Status;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+POBJECT_CACHE_PROCESSOR
+MmpGetObjectCacheProcessor (
+    PMM_OBJECT_CACHE Cache,
+    ULONG Number
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the free list for the given processor.
+
+Arguments:
+
+    Cache - Supplies a pointer to the object cache.
+
+    Number - Supplies the processor number.
+
+Return Value:
+
+    Returns a pointer to the processor's free list.
+
+    NULL if the processor came online after the cache was created, in which
+    case it has no free list.
+
+--*/
+
+{
+
+    if (Number >= Cache->ProcessorCount) {
+        return NULL;
+    }
+
+    return (PVOID)((PUCHAR)(Cache->Processors) +
+                   (Number * Cache->ProcessorStride));
+}
+
+VOID
+MmpReleaseObjects (
+    PMM_OBJECT_CACHE Cache,
+    PVOID *Objects,
+    ULONG Count
+    )
+
+/*++
+
+Routine Description:
+
+    This routine destructs objects and gives their memory back to the block
+    allocator. This routine must be called at low level.
+
+Arguments:
+
+    Cache - Supplies a pointer to the object cache.
+
+    Objects - Supplies an array of objects to release.
+
+    Count - Supplies the number of elements in the array.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG Index;
+
+    ASSERT(KeGetRunLevel() == RunLevelLow);
+
+    for (Index = 0; Index < Count; Index += 1) {
+        if (Cache->Destructor != NULL) {
+            Cache->Destructor(Objects[Index], Cache->Context);
+        }
+
+        MmFreeBlock(Cache->Allocator, Objects[Index]);
+    }
+
+    RtlAtomicAdd(&(Cache->ObjectCount), -Count);
+    return;
+}
+
+UINTN
+MmpReclaimObjectCache (
+    PMM_OBJECT_CACHE Cache
+    )
+
+/*++
+
+Routine Description:
+
+    This routine releases every free object an object cache is holding. This
+    routine must be called at low level.
+
+Arguments:
+
+    Cache - Supplies a pointer to the object cache.
+
+Return Value:
+
+    Returns the number of objects released.
+
+--*/
+
+{
+
+    ULONG Count;
+    PVOID Depot;
+    ULONG Index;
+    PVOID Object;
+    PVOID Objects[OBJECT_CACHE_DEPTH];
+    RUNLEVEL OldRunLevel;
+    POBJECT_CACHE_PROCESSOR Processor;
+    UINTN Released;
+
+    Released = 0;
+    for (Index = 0; Index < Cache->ProcessorCount; Index += 1) {
+        Processor = MmpGetObjectCacheProcessor(Cache, Index);
+        if (Processor->Count == 0) {
+            continue;
+        }
+
+        OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+        KeAcquireSpinLock(&(Processor->Lock));
+        Count = Processor->Count;
+        RtlCopyMemory(Objects, Processor->Objects, Count * sizeof(PVOID));
+        Processor->Count = 0;
+        KeReleaseSpinLock(&(Processor->Lock));
+        KeLowerRunLevel(OldRunLevel);
+        MmpReleaseObjects(Cache, Objects, Count);
+        Released += Count;
+    }
+
+    OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+    KeAcquireSpinLock(&(Cache->DepotLock));
+    Depot = Cache->Depot;
+    Cache->Depot = NULL;
+    Cache->DepotCount = 0;
+    KeReleaseSpinLock(&(Cache->DepotLock));
+    KeLowerRunLevel(OldRunLevel);
+    while (Depot != NULL) {
+        Object = Depot;
+        Depot = *OBJECT_CACHE_LINK(Cache, Object);
+        MmpReleaseObjects(Cache, &Object, 1);
+        Released += 1;
+    }
+
+    RtlAtomicAdd64(&(Cache->ReclaimCount), Released);
+    return Released;
+}
+
+VOID
+MmpObjectCacheReclaimWorkRoutine (
+    PVOID Parameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine releases the free objects held by every object cache, giving
+    memory back to the system when it is under pressure.
+
+Arguments:
+
+    Parameter - Supplies an unused parameter.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PMM_OBJECT_CACHE Cache;
+    PLIST_ENTRY CurrentEntry;
+
+    //
+    // Clear the queued flag first so that pressure arriving during the
+    // reclaim queues another pass.
+    //
+
+    MmObjectCacheReclaimQueued = FALSE;
+    RtlMemoryBarrier();
+    KeAcquireQueuedLock(MmObjectCacheListLock);
+    CurrentEntry = MmObjectCacheList.Next;
+    while (CurrentEntry != &MmObjectCacheList) {
+        Cache = LIST_VALUE(CurrentEntry, MM_OBJECT_CACHE, ListEntry);
+        CurrentEntry = CurrentEntry->Next;
+        MmpReclaimObjectCache(Cache);
+    }
+
+    KeReleaseQueuedLock(MmObjectCacheListLock);
+    return;
+}
+
@@ -486,7 +486,8 @@ Return Value:
 
 {
 
-    Lock->LockHeld = 0;
+    Lock->NextTicket = 0;
+    Lock->NowServing = 0;
     Lock->OwningThread = NULL;
     return;
 }
@@ -1861,16 +1862,13 @@ Return Value:
 
 {
 
-    ULONG LockValue;
+    ULONG Ticket;
 
-    do {
-        LockValue = 1;
-        if (Lock->LockHeld == 0) {
-            LockValue = 0;
-            Lock->LockHeld = 1;
-        }
-
-    } while (LockValue != 0);
+    Ticket = Lock->NextTicket;
+    Lock->NextTicket += 1;
+    while (Lock->NowServing != Ticket) {
+        NOTHING;
+    }
 
     return;
 }
@@ -1898,9 +1896,9 @@ Return Value:
 
 {
 
-    ASSERT(Lock->LockHeld != 0);
+    ASSERT(Lock->NowServing != Lock->NextTicket);
 
-    Lock->LockHeld = 0;
+    Lock->NowServing += 1;
     return;
 }
 
@@ -2240,6 +2238,44 @@ Return Value:
     return STATUS_NOT_IMPLEMENTED;
 }
 
+KERNEL_API
+KSTATUS
+IoReadAhead (
+    PIO_HANDLE Handle,
+    IO_OFFSET Offset,
+    ULONGLONG Size
+    )
+
+/*++
+
+Routine Description:
+
+    This routine starts reading the given region of a file or block device
+    into the page cache in the background. It does not wait for the reads to
+    complete.
+
+Arguments:
+
+    Handle - Supplies the open I/O handle.
+
+    Offset - Supplies the offset from the beginning of the file or device where
+        the region starts.
+
+    Size - Supplies the size of the region in bytes. Supply zero to read ahead
+        to the end of the file.
+
+Return Value:
+
+    Status code. Objects that are not backed by the page cache succeed without
+    doing anything.
+
+--*/
+
+{
+
+    return STATUS_SUCCESS;
+}
+
 KERNEL_API
 KSTATUS
 IoReadAtOffset (
@@ -3042,6 +3078,33 @@ Return Value:
     return NULL;
 }
 
+VOID
+IoFileObjectAddReference (
+    PVOID FileObject
+    )
+
+/*++
+
+Routine Description:
+
+    This routine adds an external reference to a file object previously
+    returned by referencing the file object for a handle.
+
+Arguments:
+
+    FileObject - Supplies the opaque pointer to the file object.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    return;
+}
+
 VOID
 IoFileObjectReleaseReference (
     PVOID FileObject
@@ -3304,3 +3367,406 @@ Return Value:
     return NULL;
 }
 
+KERNEL_API
+PKTIMER
+KeCreateTimer (
+    ULONG AllocationTag
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates a new timer object. Once created, this timer needs to
+    be initialized before it can be queued. This routine must be called at or
+    below dispatch level.
+
+Arguments:
+
+    AllocationTag - Supplies a pointer to an identifier to use for the
+        allocation that uniquely identifies the driver or module allocating the
+        timer.
+
+Return Value:
+
+    Returns a pointer to the timer on success.
+
+    NULL on resource allocation failure.
+
+--*/
+
+{
+
+    ASSERT(FALSE);
+
+    return NULL;
+}
+
+KERNEL_API
+VOID
+KeDestroyTimer (
+    PKTIMER Timer
+    )
+
+/*++
+
+Routine Description:
+
+    This routine destroys a timer object. If the timer is currently queued, this
+    routine cancels the timer and then destroys it. This routine must be called
+    at or below dispatch level.
+
+Arguments:
+
+    Timer - Supplies a pointer to the timer to destroy.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ASSERT(FALSE);
+
+    return;
+}
+
+KERNEL_API
+KSTATUS
+KeQueueTimer (
+    PKTIMER Timer,
+    TIMER_QUEUE_TYPE QueueType,
+    ULONGLONG DueTime,
+    ULONGLONG Period,
+    ULONG Flags,
+    PDPC Dpc
+    )
+
+/*++
+
+Routine Description:
+
+    This routine configures and queues a timer object. The timer must not
+    already be queued, otherwise the system will crash. This routine must be
+    called at or below dispatch level.
+
+Arguments:
+
+    Timer - Supplies a pointer to the timer to configure and queue.
+
+    QueueType - Supplies the queue the timer should reside on. Valid values are:
+
+        TimerQueueSoft - The timer will be expired at the first applicable
+            clock interrupt, but a clock interrupt will not be scheduled solely
+            for this timer. This timer type has the best power management
+            profile, but may cause the expiration of the timer to be fairly
+            late, as the system will not come out of idle to service this timer.
+            The DPC for this timer may run on any processor.
+
+        TimerQueueSoftWake - The timer will be expired at the first applicable
+            clock interrupt. If the system was otherwise idle, a clock
+            interrupt will be scheduled for this timer. This is a balanced
+            choice for timers that can have some slack in their expiration, but
+            need to run approximately when scheduled, even if the system is
+            idle. The DPC will run on the processor where the timer was queued.
+
+        TimerQueueHard - A clock interrupt will be scheduled for exactly the
+            specified deadline. This is the best choice for high performance
+            timers that need to expire as close to their deadlines as possible.
+            It is the most taxing on power management, as it pulls the system
+            out of idle, schedules an extra clock interrupt, and requires
+            programming hardware. The DPC will run on the processor where the
+            timer was queued.
+
+    DueTime - Supplies the value of the time tick counter when this timer
+        should expire (an absolute value in time counter ticks). If this value
+        is 0, then an automatic due time of the current time plus the given
+        period will be computed.
+
+    Period - Supplies an optional period, in time counter ticks, for periodic
+        timers. If this value is non-zero, the period will be added to the
+        original due time and the timer will be automatically rearmed.
+
+    Flags - Supplies an optional bitfield of flags. See KTIMER_FLAG_*
+        definitions.
+
+    Dpc - Supplies an optional pointer to a DPC that will be queued when this
+        timer expires.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    ASSERT(FALSE);
+
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+KERNEL_API
+PDPC
+KeCreateDpc (
+    PDPC_ROUTINE DpcRoutine,
+    PVOID UserData
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates a new DPC with the given routine and context data.
+
+Arguments:
+
+    DpcRoutine - Supplies a pointer to the routine to call when the DPC fires.
+
+    UserData - Supplies a context pointer that can be passed to the routine via
+        the DPC when it is called.
+
+Return Value:
+
+    Returns a pointer to the allocated and initialized (but not queued) DPC.
+
+--*/
+
+{
+
+    ASSERT(FALSE);
+
+    return NULL;
+}
+
+KERNEL_API
+VOID
+KeDestroyDpc (
+    PDPC Dpc
+    )
+
+/*++
+
+Routine Description:
+
+    This routine destroys a DPC. It will cancel the DPC if it is queued, and
+    wait for it to finish if it is running. This routine must be called from
+    low level.
+
+Arguments:
+
+    Dpc - Supplies a pointer to the DPC to destroy.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ASSERT(FALSE);
+
+    return;
+}
+
+KERNEL_API
+PWORK_ITEM
+KeCreateWorkItem (
+    PWORK_QUEUE WorkQueue,
+    WORK_PRIORITY Priority,
+    PWORK_ITEM_ROUTINE WorkRoutine,
+    PVOID Parameter,
+    ULONG AllocationTag
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates a new reusable work item.
+
+Arguments:
+
+    WorkQueue - Supplies a pointer to the queue this work item will
+        eventually be queued to. Supply NULL to use the system work queue.
+
+    Priority - Supplies the work priority.
+
+    WorkRoutine - Supplies the routine to execute to does the work. This
+        routine should be prepared to take one parameter.
+
+    Parameter - Supplies an optional parameter to pass to the worker routine.
+
+    AllocationTag - Supplies an allocation tag to associate with the work item.
+
+Return Value:
+
+    Returns a pointer to the new work item on success.
+
+    NULL on failure.
+
+--*/
+
+{
+
+    ASSERT(FALSE);
+
+    return NULL;
+}
+
+KERNEL_API
+VOID
+KeDestroyWorkItem (
+    PWORK_ITEM WorkItem
+    )
+
+/*++
+
+Routine Description:
+
+    This routine destroys a reusable work item. If this is a work item that
+    can re-queue itself, then the caller needs to make sure that that can no
+    longer happen before trying to destroy the work item.
+
+Arguments:
+
+    WorkItem - Supplies a pointer to the work item.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ASSERT(FALSE);
+
+    return;
+}
+
+KERNEL_API
+KSTATUS
+KeQueueWorkItem (
+    PWORK_ITEM WorkItem
+    )
+
+/*++
+
+Routine Description:
+
+    This routine queues a work item onto the work queue for execution as soon
+    as possible. This routine must be called from dispatch level or below.
+
+Arguments:
+
+    WorkItem - Supplies a pointer to the work item to queue.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_RESOURCE_IN_USE if the work item is already queued.
+
+--*/
+
+{
+
+    ASSERT(FALSE);
+
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+PPROCESSOR_BLOCK
+KeGetProcessorBlock (
+    ULONG ProcessorNumber
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the processor block for the given processor number.
+
+Arguments:
+
+    ProcessorNumber - Supplies the number of the processor.
+
+Return Value:
+
+    Returns the processor block for the given processor.
+
+    NULL if the input was not a valid processor number.
+
+--*/
+
+{
+
+    ASSERT(FALSE);
+
+    return NULL;
+}
+
+KERNEL_API
+ULONGLONG
+KeConvertMicrosecondsToTimeTicks (
+    ULONGLONG Microseconds
+    )
+
+/*++
+
+Routine Description:
+
+    This routine converts the given number of microseconds into time counter
+    ticks.
+
+Arguments:
+
+    Microseconds - Supplies the microsecond count.
+
+Return Value:
+
+    Returns the number of time ticks that correspond to the given number of
+    microseconds.
+
+--*/
+
+{
+
+    ASSERT(FALSE);
+
+    return 0;
+}
+
+KERNEL_API
+VOID
+KeYield (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine yields the current thread's execution. The thread remains in
+    the ready state, and may not actually be scheduled out if no other threads
+    are ready.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    return;
+}
+
@@ -46,6 +46,22 @@ Module Name:
 #define GET_PAGE_TABLE(_DirectoryIndex) \
     (PPTE)((PVOID)MmKernelPageTables + (PAGE_SIZE * _DirectoryIndex))
 
+//
+// This macro determines whether the given page directory entry points at a
+// page table that is shared between address spaces after a fork, either as
+// the owner or as a borrower.
+//
+
+#define IS_PAGE_TABLE_SHARED(_Directory, _DirectoryIndex)         \
+    ((*((PULONG)&((_Directory)[(_DirectoryIndex)])) &             \
+      (PTE_FLAG_SHARED | PTE_FLAG_BORROWED)) != 0)
+
+//
+// Define the number of page directory entries that cover user mode.
+//
+
+#define USER_PAGE_TABLE_COUNT ((UINTN)KERNEL_VA_START >> PAGE_DIRECTORY_SHIFT)
+
 //
 // ----------------------------------------------- Internal Function Prototypes
 //
@@ -67,6 +83,53 @@ MmpCreatePageTable (
     PVOID VirtualAddress
     );
 
+KSTATUS
+MmpInitializeSharedPageTableWindow (
+    VOID
+    );
+
+VOID
+MmpCreateSharedPageTables (
+    PADDRESS_SPACE_X86 AddressSpace
+    );
+
+VOID
+MmpDestroySharedPageTables (
+    PADDRESS_SPACE_X86 AddressSpace
+    );
+
+BOOL
+MmpSharePageTable (
+    PADDRESS_SPACE_X86 Destination,
+    PADDRESS_SPACE_X86 Source,
+    ULONG DirectoryIndex,
+    PINTN MappedCount
+    );
+
+VOID
+MmpBreakPageTableShare (
+    PADDRESS_SPACE_X86 AddressSpace,
+    ULONG DirectoryIndex
+    );
+
+VOID
+MmpDetachSharedPageTable (
+    PSHARED_PAGE_TABLE Borrower,
+    BOOL CopyPageTable
+    );
+
+ULONG
+MmpDropBorrowedPageTable (
+    PADDRESS_SPACE_X86 AddressSpace,
+    ULONG DirectoryIndex
+    );
+
+PPTE
+MmpMapSharedPageTableWindow (
+    ULONG Slot,
+    PHYSICAL_ADDRESS PageTable
+    );
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -99,6 +162,20 @@ PQUEUED_LOCK MmPageTableLock;
 
 PBLOCK_ALLOCATOR MmPageDirectoryBlockAllocator;
 
+//
+// Synchronizes lending user mode page tables between forked address spaces
+// and taking them back.
+//
+
+KSPIN_LOCK MmSharedPageTableLock;
+
+//
+// Stores two pages of kernel VA space used to map the page tables of any
+// address space while the shared page table lock is held.
+//
+
+PVOID MmSharedPageTableWindow;
+
 //
 // ------------------------------------------------------------------ Functions
 //
@@ -719,7 +796,10 @@ Return Value:
         }
 
         MmPageDirectoryBlockAllocator = BlockAllocator;
-        Status = STATUS_SUCCESS;
+        Status = MmpInitializeSharedPageTableWindow();
+        if (!KSUCCESS(Status)) {
+            goto ArchInitializeEnd;
+        }
 
     //
     // Phase 3 runs once after the scheduler is active.
@@ -950,6 +1030,30 @@ Return Value:
     CurrentProcess = PsGetCurrentProcess();
     AddressSpace = (PADDRESS_SPACE_X86)(CurrentProcess->AddressSpace);
     CurrentPageDirectory = AddressSpace->PageDirectory;
+
+    //
+    // A write through the self map to a user mode page table can race with
+    // another processor taking back a page table that was shared by fork. If
+    // the directory entry is writable now, the faulting translation was just
+    // stale.
+    //
+
+    if ((FaultingAddress >= (PVOID)MmKernelPageTables) &&
+        (FaultingAddress < (PVOID)GET_PAGE_TABLE(USER_PAGE_TABLE_COUNT))) {
+
+        DirectoryIndex = ((UINTN)FaultingAddress -
+                          (UINTN)MmKernelPageTables) >> PAGE_SHIFT;
+
+        if ((CurrentPageDirectory[DirectoryIndex].Present != 0) &&
+            (CurrentPageDirectory[DirectoryIndex].Writable != 0)) {
+
+            ArInvalidateTlbEntry(FaultingAddress);
+            return TRUE;
+        }
+
+        return FALSE;
+    }
+
     DirectoryIndex = (UINTN)FaultingAddress >> PAGE_DIRECTORY_SHIFT;
 
     //
@@ -1050,6 +1154,16 @@ Return Value:
 
     if (Directory[DirectoryIndex].Present == 0) {
         MmpCreatePageTable(AddressSpace, Directory, VirtualAddress);
+
+    //
+    // If the page table is shared with another process from a fork, take a
+    // private copy before changing it.
+    //
+
+    } else if ((VirtualAddress < KERNEL_VA_START) &&
+               (IS_PAGE_TABLE_SHARED(Directory, DirectoryIndex))) {
+
+        MmpBreakPageTableShare(AddressSpace, DirectoryIndex);
     }
 
     ASSERT(Directory[DirectoryIndex].Present != 0);
@@ -1217,6 +1331,21 @@ Return Value:
             Directory[DirectoryIndex] = MmKernelPageDirectory[DirectoryIndex];
         }
 
+        //
+        // A dying process does not need a private copy of a page table it
+        // borrowed in order to tear it down. Just hand it back, which leaves
+        // nothing there for the rest of this loop.
+        //
+
+        if ((InvalidateTlb == FALSE) &&
+            (CurrentVirtual < KERNEL_VA_START) &&
+            (Directory[DirectoryIndex].Borrowed != 0) &&
+            ((UnmapFlags & UNMAP_FLAG_FREE_PHYSICAL_PAGES) == 0)) {
+
+            MappedCount += MmpDropBorrowedPageTable(AddressSpace,
+                                                    DirectoryIndex);
+        }
+
         //
         // Skip it if there's still no page table there.
         //
@@ -1231,10 +1360,17 @@ Return Value:
 
         //
         // If the page was not present or physical pages aren't being freed,
-        // just wipe the whole PTE out.
+        // just wipe the whole PTE out. Page tables shared by a fork need to
+        // be made private first.
         //
 
         if (PageTable[TableIndex].Entry != 0) {
+            if ((CurrentVirtual < KERNEL_VA_START) &&
+                (IS_PAGE_TABLE_SHARED(Directory, DirectoryIndex))) {
+
+                MmpBreakPageTableShare(AddressSpace, DirectoryIndex);
+            }
+
             PageWasPresent = FALSE;
             if (PageTable[TableIndex].Present != 0) {
                 ChangedSomething = TRUE;
@@ -1460,6 +1596,21 @@ Return Value:
         if (PageTable[TableIndex].Dirty != 0) {
             *Attributes |= MAP_FLAG_DIRTY;
         }
+
+        //
+        // A page table shared by fork is write protected at the directory
+        // level. The dirty bits in a borrowed page table belong to the owner.
+        //
+
+        if (VirtualAddress < KERNEL_VA_START) {
+            if (Directory[DirectoryIndex].Writable == 0) {
+                *Attributes |= MAP_FLAG_READ_ONLY;
+            }
+
+            if (Directory[DirectoryIndex].Borrowed != 0) {
+                *Attributes &= ~MAP_FLAG_DIRTY;
+            }
+        }
     }
 
     return PhysicalAddress;
@@ -1623,6 +1774,10 @@ Return Value:
         goto UnmapPageInOtherProcessEnd;
     }
 
+    if (IS_PAGE_TABLE_SHARED(Directory, DirectoryIndex)) {
+        MmpBreakPageTableShare(Space, DirectoryIndex);
+    }
+
     PageTablePhysical = (UINTN)(Directory[DirectoryIndex].Entry << PAGE_SHIFT);
     PageTableIndex = ((UINTN)VirtualAddress & PTE_INDEX_MASK) >> PAGE_SHIFT;
 
@@ -1756,6 +1911,9 @@ Return Value:
 
     if (Directory[DirectoryIndex].Present == 0) {
         MmpCreatePageTable(Space, Directory, VirtualAddress);
+
+    } else if (IS_PAGE_TABLE_SHARED(Directory, DirectoryIndex)) {
+        MmpBreakPageTableShare(Space, DirectoryIndex);
     }
 
     PageTablePhysical = (UINTN)(Directory[DirectoryIndex].Entry << PAGE_SHIFT);
@@ -1958,6 +2116,12 @@ Return Value:
             continue;
         }
 
+        if ((CurrentVirtual < KERNEL_VA_START) &&
+            (IS_PAGE_TABLE_SHARED(Directory, DirectoryIndex))) {
+
+            MmpBreakPageTableShare(AddressSpace, DirectoryIndex);
+        }
+
         //
         // Set the new attributes.
         //
@@ -2061,6 +2225,14 @@ Return Value:
     SourceSpace = (PADDRESS_SPACE_X86)SourceAddressSpace;
     Destination = DestinationSpace->PageDirectory;
     Source = SourceSpace->PageDirectory;
+
+    //
+    // Set up the state needed to lend page tables to the destination. If this
+    // fails, the copy simply falls back to duplicating every page table.
+    //
+
+    MmpCreateSharedPageTables(SourceSpace);
+    MmpCreateSharedPageTables(DestinationSpace);
     Total = 0;
     for (DirectoryIndex = 0;
          DirectoryIndex < ((UINTN)KERNEL_VA_START >> PAGE_DIRECTORY_SHIFT);
@@ -2209,6 +2381,18 @@ Return Value:
             continue;
         }
 
+        //
+        // The source entries are about to be write protected, so make sure
+        // the source is not still lending this page table out or borrowing
+        // it from a previous fork.
+        //
+
+        if (IS_PAGE_TABLE_SHARED(SourceDirectory, DirectoryIndex)) {
+            MmpBreakPageTableShare(SourceSpace, DirectoryIndex);
+        }
+
+        ASSERT(DestinationDirectory[DirectoryIndex].Borrowed == 0);
+
         TableIndexEnd = ((UINTN)CurrentVirtual & PTE_INDEX_MASK) >>
                         PAGE_SHIFT;
 
@@ -2336,8 +2520,12 @@ Return Value:
     return STATUS_SUCCESS;
 }
 
-VOID
-MmpCreatePageTables (
+KSTATUS
+MmpShareSectionMappings (
+    PADDRESS_SPACE Destination,
+    PADDRESS_SPACE Source,
+    PVOID SectionAddress,
+    UINTN SectionSize,
     PVOID VirtualAddress,
     UINTN Size
     )
@@ -2346,159 +2534,432 @@ MmpCreatePageTables (
 
 Routine Description:
 
-    This routine ensures that all page tables are present for the given virtual
-    address range.
+    This routine makes the mappings of the given virtual address region
+    available read-only to another process during fork. Wherever the
+    architecture allows it, whole page tables that lie entirely within the
+    section are shared between the two address spaces and only copied when
+    one side first changes them. The remainder of the region is handed to
+    the copy and change routine.
 
 Arguments:
 
+    Destination - Supplies a pointer to the destination address space.
+
+    Source - Supplies a pointer to the source address space, which must be
+        the current address space.
+
+    SectionAddress - Supplies the starting virtual address of the image
+        section that owns the region.
+
+    SectionSize - Supplies the size of the image section, in bytes.
+
     VirtualAddress - Supplies the starting virtual address of the memory range.
 
     Size - Supplies the size of the virtual address region, in bytes.
 
 Return Value:
 
-    None.
+    Status code.
 
 --*/
 
 {
 
-    PADDRESS_SPACE_X86 AddressSpace;
-    PKTHREAD CurrentThread;
-    volatile PTE *Directory;
-    ULONG DirectoryEndIndex;
-    UINTN DirectoryIndex;
+    PVOID CopyStart;
+    PVOID CurrentVirtual;
+    PADDRESS_SPACE_X86 DestinationSpace;
+    ULONG DirectoryIndex;
+    INTN MappedCount;
+    PVOID SectionEnd;
+    BOOL Shared;
+    PADDRESS_SPACE_X86 SourceSpace;
+    KSTATUS Status;
+    PVOID TableEnd;
+    PVOID TableStart;
+    PVOID VirtualEnd;
 
-    CurrentThread = KeGetCurrentThread();
-    if (CurrentThread == NULL) {
-        Directory = MmKernelPageDirectory;
-        if (Directory == NULL) {
-            return;
+    DestinationSpace = (PADDRESS_SPACE_X86)Destination;
+    SourceSpace = (PADDRESS_SPACE_X86)Source;
+    SectionEnd = SectionAddress + SectionSize;
+    VirtualEnd = VirtualAddress + Size;
+
+    ASSERT(VirtualEnd > VirtualAddress);
+    ASSERT(VirtualEnd <= KERNEL_VA_START);
+    ASSERT(Source == PsGetCurrentProcess()->AddressSpace);
+
+    //
+    // Walk the region a page table at a time, lending out the page tables
+    // that are entirely covered by the section and batching up everything
+    // else to be copied the old fashioned way.
+    //
+
+    MappedCount = 0;
+    Status = STATUS_SUCCESS;
+    CopyStart = VirtualAddress;
+    CurrentVirtual = VirtualAddress;
+    while (CurrentVirtual < VirtualEnd) {
+        DirectoryIndex = (UINTN)CurrentVirtual >> PAGE_DIRECTORY_SHIFT;
+        TableStart = (PVOID)(DirectoryIndex << PAGE_DIRECTORY_SHIFT);
+        TableEnd = TableStart + (1 << PAGE_DIRECTORY_SHIFT);
+        Shared = FALSE;
+        if ((TableStart >= SectionAddress) && (TableEnd <= SectionEnd)) {
+            Shared = MmpSharePageTable(DestinationSpace,
+                                       SourceSpace,
+                                       DirectoryIndex,
+                                       &MappedCount);
         }
 
-        AddressSpace = NULL;
+        if (TableEnd > VirtualEnd) {
+            TableEnd = VirtualEnd;
+        }
 
-    } else {
-        AddressSpace =
-              (PADDRESS_SPACE_X86)(CurrentThread->OwningProcess->AddressSpace);
+        if (Shared != FALSE) {
+            if (CopyStart < CurrentVirtual) {
+                Status = MmpCopyAndChangeSectionMappings(
+                                                 Destination,
+                                                 Source,
+                                                 CopyStart,
+                                                 CurrentVirtual - CopyStart);
 
-        Directory = AddressSpace->PageDirectory;
-    }
+                if (!KSUCCESS(Status)) {
+                    goto ShareSectionMappingsEnd;
+                }
+            }
 
-    DirectoryIndex = (UINTN)VirtualAddress >> PAGE_DIRECTORY_SHIFT;
-    DirectoryEndIndex = ((UINTN)VirtualAddress + Size - 1) >>
-                        PAGE_DIRECTORY_SHIFT;
+            CopyStart = TableEnd;
+        }
 
-    ASSERT(DirectoryIndex <= DirectoryEndIndex);
+        CurrentVirtual = TableEnd;
+    }
 
-    while (DirectoryIndex <= DirectoryEndIndex) {
-        if (Directory[DirectoryIndex].Present == 0) {
-            MmpCreatePageTable(AddressSpace,
-                               Directory,
-                               (PVOID)(DirectoryIndex << PAGE_DIRECTORY_SHIFT));
+    if (CopyStart < VirtualEnd) {
+        Status = MmpCopyAndChangeSectionMappings(Destination,
+                                                 Source,
+                                                 CopyStart,
+                                                 VirtualEnd - CopyStart);
+
+        if (!KSUCCESS(Status)) {
+            goto ShareSectionMappingsEnd;
         }
+    }
 
-        DirectoryIndex += 1;
+ShareSectionMappingsEnd:
+    if (MappedCount != 0) {
+        MmpUpdateResidentSetCounter(&(DestinationSpace->Common), MappedCount);
     }
 
-    return;
+    return Status;
 }
 
-//
-// --------------------------------------------------------- Internal Functions
-//
-
-KSTATUS
-MmpCreatePageDirectory (
-    PADDRESS_SPACE_X86 AddressSpace
+VOID
+MmpUnsharePageTable (
+    PADDRESS_SPACE AddressSpace,
+    PVOID VirtualAddress
     )
 
 /*++
 
 Routine Description:
 
-    This routine creates a new page directory for a new address space, and
-    initializes it with kernel address space.
+    This routine ensures that the page table servicing the given user mode
+    virtual address is private to the given address space, copying it if it
+    is currently shared with another process.
 
 Arguments:
 
-    AddressSpace - Supplies a pointer to the address space to create a page
-        directory for.
+    AddressSpace - Supplies a pointer to the address space.
 
-Return Value:
+    VirtualAddress - Supplies the virtual address whose page table should be
+        made private.
 
-    STATUS_SUCCESS on success.
+Return Value:
 
-    STATUS_NO_MEMORY if memory could not be allocated for the page table.
+    None.
 
 --*/
 
 {
 
-    PBLOCK_ALLOCATOR Allocator;
-    ULONG CopySize;
     ULONG DirectoryIndex;
-    ULONG KernelIndex;
-    PPTE PageDirectory;
-    PHYSICAL_ADDRESS PhysicalAddress;
-    KSTATUS Status;
-    ULONG ZeroSize;
+    PADDRESS_SPACE_X86 Space;
 
-    Allocator = MmPageDirectoryBlockAllocator;
+    if (VirtualAddress >= KERNEL_VA_START) {
+        return;
+    }
 
-    //
-    // This must be the kernel if there is no page directory block allocator
-    // yet.
-    //
+    Space = (PADDRESS_SPACE_X86)AddressSpace;
+    DirectoryIndex = (UINTN)VirtualAddress >> PAGE_DIRECTORY_SHIFT;
+    if ((Space->PageDirectory[DirectoryIndex].Present != 0) &&
+        (IS_PAGE_TABLE_SHARED(Space->PageDirectory, DirectoryIndex))) {
 
-    if (Allocator == NULL) {
+        MmpBreakPageTableShare(Space, DirectoryIndex);
+    }
 
-        ASSERT(MmPageTableLock == NULL);
+    return;
+}
 
-        AddressSpace->PageDirectory = (PPTE)MmKernelPageDirectory;
-        AddressSpace->PageDirectoryPhysical =
-                       MmpVirtualToPhysical(AddressSpace->PageDirectory, NULL);
+BOOL
+MmpCheckAndClearAccessedBit (
+    PADDRESS_SPACE AddressSpace,
+    PVOID VirtualAddress
+    )
 
-        return STATUS_SUCCESS;
-    }
+/*++
 
-    PageDirectory = MmAllocateBlock(Allocator, &PhysicalAddress);
-    if (PageDirectory == NULL) {
-        Status = STATUS_INSUFFICIENT_RESOURCES;
-        goto CreatePageDirectoryEnd;
-    }
+Routine Description:
 
-    //
-    // Zero the user mode portion and copy the kernel portion from the kernel
-    // page directory.
-    //
+    This routine determines whether the page at the given virtual address in
+    the given address space has been touched since the last time this routine
+    was called on it, and clears the page table entry's accessed bit so the
+    next reference can be observed. The TLB is deliberately not flushed, so a
+    processor with a cached translation may not report a reference until the
+    entry is evicted. This is fine for aging purposes.
 
-    KernelIndex = (UINTN)KERNEL_VA_START >> PAGE_DIRECTORY_SHIFT;
-    ZeroSize = KernelIndex * sizeof(PTE);
-    CopySize = PAGE_SIZE - ZeroSize;
-    RtlZeroMemory((PVOID)PageDirectory, ZeroSize);
-    RtlCopyMemory((PVOID)&(PageDirectory[KernelIndex]),
-                  (PVOID)&(MmKernelPageDirectory[KernelIndex]),
-                  CopySize);
+Arguments:
 
-    //
-    // Make the self mappings point to this page directory.
-    //
+    AddressSpace - Supplies a pointer to the address space that owns the
+        mapping.
 
-    DirectoryIndex = (UINTN)MmKernelPageTables >> PAGE_DIRECTORY_SHIFT;
-    PageDirectory[DirectoryIndex].Entry = (ULONG)PhysicalAddress >> PAGE_SHIFT;
-    PageDirectory[DirectoryIndex].Writable = 1;
-    PageDirectory[DirectoryIndex].Present = 1;
-    AddressSpace->PageDirectoryPhysical = PhysicalAddress;
-    Status = STATUS_SUCCESS;
+    VirtualAddress - Supplies the virtual address of the page to check.
 
-CreatePageDirectoryEnd:
-    if (!KSUCCESS(Status)) {
-        if (PageDirectory != NULL) {
-            MmFreeBlock(Allocator, (PVOID)PageDirectory);
-            PageDirectory = NULL;
-        }
-    }
+Return Value:
+
+    TRUE if the page was accessed since the bit was last cleared.
+
+    FALSE if the page was not accessed or is not mapped.
+
+--*/
+
+{
+
+    BOOL Accessed;
+    volatile PTE *Directory;
+    ULONG DirectoryIndex;
+    RUNLEVEL OldRunLevel;
+    volatile PTE *PageTable;
+    ULONG PageTableIndex;
+    PPROCESSOR_BLOCK ProcessorBlock;
+    BOOL SharedLockHeld;
+    PADDRESS_SPACE_X86 Space;
+
+    Space = (PADDRESS_SPACE_X86)AddressSpace;
+    DirectoryIndex = (UINTN)VirtualAddress >> PAGE_DIRECTORY_SHIFT;
+    if ((VirtualAddress >= KERNEL_VA_START) || (Space == NULL)) {
+        Directory = MmKernelPageDirectory;
+
+    } else {
+        Directory = Space->PageDirectory;
+    }
+
+    Accessed = FALSE;
+    SharedLockHeld = FALSE;
+    PageTableIndex = ((UINTN)VirtualAddress & PTE_INDEX_MASK) >> PAGE_SHIFT;
+    OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+
+    //
+    // A page table shared after a fork can be copied or handed back while
+    // it is being looked at. Hold the shared page table lock to keep it in
+    // place. A reference through either process counts as a reference.
+    //
+
+    if (IS_PAGE_TABLE_SHARED(Directory, DirectoryIndex)) {
+        KeAcquireSpinLock(&MmSharedPageTableLock);
+        SharedLockHeld = TRUE;
+    }
+
+    if (Directory[DirectoryIndex].Present == 0) {
+        goto CheckAndClearAccessedBitEnd;
+    }
+
+    ProcessorBlock = KeGetCurrentProcessorBlock();
+    MmpMapPage((ULONG)(Directory[DirectoryIndex].Entry << PAGE_SHIFT),
+               ProcessorBlock->SwapPage,
+               MAP_FLAG_PRESENT | MAP_FLAG_GLOBAL);
+
+    PageTable = (volatile PTE *)(ProcessorBlock->SwapPage);
+    if ((PageTable[PageTableIndex].Present != 0) &&
+        (PageTable[PageTableIndex].Accessed != 0)) {
+
+        RtlAtomicAnd32((volatile ULONG *)&(PageTable[PageTableIndex]),
+                       ~PTE_FLAG_ACCESSED);
+
+        Accessed = TRUE;
+    }
+
+    MmpUnmapPages(ProcessorBlock->SwapPage, 1, 0, NULL);
+
+CheckAndClearAccessedBitEnd:
+    if (SharedLockHeld != FALSE) {
+        KeReleaseSpinLock(&MmSharedPageTableLock);
+    }
+
+    KeLowerRunLevel(OldRunLevel);
+    return Accessed;
+}
+
+VOID
+MmpCreatePageTables (
+    PVOID VirtualAddress,
+    UINTN Size
+    )
+
+/*++
+
+Routine Description:
+
+    This routine ensures that all page tables are present for the given virtual
+    address range.
+
+Arguments:
+
+    VirtualAddress - Supplies the starting virtual address of the memory range.
+
+    Size - Supplies the size of the virtual address region, in bytes.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PADDRESS_SPACE_X86 AddressSpace;
+    PKTHREAD CurrentThread;
+    volatile PTE *Directory;
+    ULONG DirectoryEndIndex;
+    UINTN DirectoryIndex;
+
+    CurrentThread = KeGetCurrentThread();
+    if (CurrentThread == NULL) {
+        Directory = MmKernelPageDirectory;
+        if (Directory == NULL) {
+            return;
+        }
+
+        AddressSpace = NULL;
+
+    } else {
+        AddressSpace =
+              (PADDRESS_SPACE_X86)(CurrentThread->OwningProcess->AddressSpace);
+
+        Directory = AddressSpace->PageDirectory;
+    }
+
+    DirectoryIndex = (UINTN)VirtualAddress >> PAGE_DIRECTORY_SHIFT;
+    DirectoryEndIndex = ((UINTN)VirtualAddress + Size - 1) >>
+                        PAGE_DIRECTORY_SHIFT;
+
+    ASSERT(DirectoryIndex <= DirectoryEndIndex);
+
+    while (DirectoryIndex <= DirectoryEndIndex) {
+        if (Directory[DirectoryIndex].Present == 0) {
+            MmpCreatePageTable(AddressSpace,
+                               Directory,
+                               (PVOID)(DirectoryIndex << PAGE_DIRECTORY_SHIFT));
+        }
+
+        DirectoryIndex += 1;
+    }
+
+    return;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+KSTATUS
+MmpCreatePageDirectory (
+    PADDRESS_SPACE_X86 AddressSpace
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates a new page directory for a new address space, and
+    initializes it with kernel address space.
+
+Arguments:
+
+    AddressSpace - Supplies a pointer to the address space to create a page
+        directory for.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_NO_MEMORY if memory could not be allocated for the page table.
+
+--*/
+
+{
+
+    PBLOCK_ALLOCATOR Allocator;
+    ULONG CopySize;
+    ULONG DirectoryIndex;
+    ULONG KernelIndex;
+    PPTE PageDirectory;
+    PHYSICAL_ADDRESS PhysicalAddress;
+    KSTATUS Status;
+    ULONG ZeroSize;
+
+    Allocator = MmPageDirectoryBlockAllocator;
+
+    //
+    // This must be the kernel if there is no page directory block allocator
+    // yet.
+    //
+
+    if (Allocator == NULL) {
+
+        ASSERT(MmPageTableLock == NULL);
+
+        AddressSpace->PageDirectory = (PPTE)MmKernelPageDirectory;
+        AddressSpace->PageDirectoryPhysical =
+                       MmpVirtualToPhysical(AddressSpace->PageDirectory, NULL);
+
+        return STATUS_SUCCESS;
+    }
+
+    PageDirectory = MmAllocateBlock(Allocator, &PhysicalAddress);
+    if (PageDirectory == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto CreatePageDirectoryEnd;
+    }
+
+    //
+    // Zero the user mode portion and copy the kernel portion from the kernel
+    // page directory.
+    //
+
+    KernelIndex = (UINTN)KERNEL_VA_START >> PAGE_DIRECTORY_SHIFT;
+    ZeroSize = KernelIndex * sizeof(PTE);
+    CopySize = PAGE_SIZE - ZeroSize;
+    RtlZeroMemory((PVOID)PageDirectory, ZeroSize);
+    RtlCopyMemory((PVOID)&(PageDirectory[KernelIndex]),
+                  (PVOID)&(MmKernelPageDirectory[KernelIndex]),
+                  CopySize);
+
+    //
+    // Make the self mappings point to this page directory.
+    //
+
+    DirectoryIndex = (UINTN)MmKernelPageTables >> PAGE_DIRECTORY_SHIFT;
+    PageDirectory[DirectoryIndex].Entry = (ULONG)PhysicalAddress >> PAGE_SHIFT;
+    PageDirectory[DirectoryIndex].Writable = 1;
+    PageDirectory[DirectoryIndex].Present = 1;
+    AddressSpace->PageDirectoryPhysical = PhysicalAddress;
+    Status = STATUS_SUCCESS;
+
+CreatePageDirectoryEnd:
+    if (!KSUCCESS(Status)) {
+        if (PageDirectory != NULL) {
+            MmFreeBlock(Allocator, (PVOID)PageDirectory);
+            PageDirectory = NULL;
+        }
+    }
 
     AddressSpace->PageDirectory = PageDirectory;
     return Status;
@@ -2546,6 +3007,16 @@ Return Value:
         return;
     }
 
+    //
+    // Hand back any page tables borrowed from another process and push any
+    // borrowers off of page tables this process owns, leaving only private
+    // page tables in the directory.
+    //
+
+    if (AddressSpace->SharedPageTables != NULL) {
+        MmpDestroySharedPageTables(AddressSpace);
+    }
+
     for (DirectoryIndex = 0;
          DirectoryIndex < ((UINTN)KERNEL_VA_START >> PAGE_DIRECTORY_SHIFT);
          DirectoryIndex += 1) {
@@ -2770,3 +3241,558 @@ Return Value:
     return;
 }
 
+KSTATUS
+MmpInitializeSharedPageTableWindow (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine reserves the window used to copy page tables that are shared
+    after a fork. It makes sure the window's page table exists now so that
+    mapping it never needs to allocate.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    KSTATUS Status;
+    VM_ALLOCATION_PARAMETERS VaRequest;
+
+    KeInitializeSpinLock(&MmSharedPageTableLock);
+    VaRequest.Address = NULL;
+    VaRequest.Alignment = PAGE_SIZE;
+    VaRequest.Size = PAGE_SIZE * 2;
+    VaRequest.Min = 0;
+    VaRequest.Max = MAX_ADDRESS;
+    VaRequest.MemoryType = MemoryTypeReserved;
+    VaRequest.Strategy = AllocationStrategyAnyAddress;
+    Status = MmpAllocateAddressRange(&MmKernelVirtualSpace, &VaRequest, FALSE);
+    if (!KSUCCESS(Status)) {
+        return Status;
+    }
+
+    MmpCreatePageTables(VaRequest.Address, VaRequest.Size);
+    MmSharedPageTableWindow = VaRequest.Address;
+    return STATUS_SUCCESS;
+}
+
+VOID
+MmpCreateSharedPageTables (
+    PADDRESS_SPACE_X86 AddressSpace
+    )
+
+/*++
+
+Routine Description:
+
+    This routine allocates the page table sharing state for an address space
+    if it does not already have it. Failure is not fatal, it just means page
+    tables get copied rather than shared.
+
+Arguments:
+
+    AddressSpace - Supplies a pointer to the address space.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG DirectoryIndex;
+    PSHARED_PAGE_TABLE SharedPageTables;
+    UINTN Size;
+
+    if (AddressSpace->SharedPageTables != NULL) {
+        return;
+    }
+
+    Size = USER_PAGE_TABLE_COUNT * sizeof(SHARED_PAGE_TABLE);
+    SharedPageTables = MmAllocateNonPagedPool(Size,
+                                              MM_ADDRESS_SPACE_ALLOCATION_TAG);
+
+    if (SharedPageTables == NULL) {
+        return;
+    }
+
+    RtlZeroMemory(SharedPageTables, Size);
+    for (DirectoryIndex = 0;
+         DirectoryIndex < USER_PAGE_TABLE_COUNT;
+         DirectoryIndex += 1) {
+
+        SharedPageTables[DirectoryIndex].AddressSpace = AddressSpace;
+    }
+
+    AddressSpace->SharedPageTables = SharedPageTables;
+    return;
+}
+
+VOID
+MmpDestroySharedPageTables (
+    PADDRESS_SPACE_X86 AddressSpace
+    )
+
+/*++
+
+Routine Description:
+
+    This routine ends all page table sharing for an address space that is
+    being destroyed and frees its sharing state. Borrowed page tables are
+    replaced with their reserve pages so that they get freed along with the
+    rest of the page tables.
+
+Arguments:
+
+    AddressSpace - Supplies a pointer to the address space being torn down.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PSHARED_PAGE_TABLE Borrower;
+    PPTE Directory;
+    ULONG DirectoryIndex;
+    PSHARED_PAGE_TABLE Entry;
+    RUNLEVEL OldRunLevel;
+
+    Directory = AddressSpace->PageDirectory;
+    for (DirectoryIndex = 0;
+         DirectoryIndex < USER_PAGE_TABLE_COUNT;
+         DirectoryIndex += 1) {
+
+        if (!IS_PAGE_TABLE_SHARED(Directory, DirectoryIndex)) {
+            continue;
+        }
+
+        //
+        // The owner may be pushing this address space off of a borrowed page
+        // table at the same time, so check again with the lock held.
+        //
+
+        Entry = &(AddressSpace->SharedPageTables[DirectoryIndex]);
+        OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+        KeAcquireSpinLock(&MmSharedPageTableLock);
+        if (Directory[DirectoryIndex].Borrowed != 0) {
+            MmpDetachSharedPageTable(Entry, FALSE);
+
+        } else if (Directory[DirectoryIndex].Shared != 0) {
+            while (LIST_EMPTY(&(Entry->ListEntry)) == FALSE) {
+                Borrower = LIST_VALUE(Entry->ListEntry.Next,
+                                      SHARED_PAGE_TABLE,
+                                      ListEntry);
+
+                MmpDetachSharedPageTable(Borrower, TRUE);
+            }
+
+            Directory[DirectoryIndex].Shared = 0;
+        }
+
+        KeReleaseSpinLock(&MmSharedPageTableLock);
+        KeLowerRunLevel(OldRunLevel);
+    }
+
+    MmFreeNonPagedPool(AddressSpace->SharedPageTables);
+    AddressSpace->SharedPageTables = NULL;
+    return;
+}
+
+BOOL
+MmpSharePageTable (
+    PADDRESS_SPACE_X86 Destination,
+    PADDRESS_SPACE_X86 Source,
+    ULONG DirectoryIndex,
+    PINTN MappedCount
+    )
+
+/*++
+
+Routine Description:
+
+    This routine lends one of the current address space's user mode page
+    tables to a new child. The source's directory entry is write protected so
+    that every mapping in the table becomes read-only in both processes
+    without touching the table itself. The child's preallocated page table is
+    held in reserve for when it needs a private copy.
+
+Arguments:
+
+    Destination - Supplies a pointer to the address space being forked into.
+
+    Source - Supplies a pointer to the current address space.
+
+    DirectoryIndex - Supplies the page directory index of the page table to
+        share.
+
+    MappedCount - Supplies a pointer that is incremented by the number of
+        mappings the destination inherits if the page table is shared.
+
+Return Value:
+
+    TRUE if the page table is now shared with the destination.
+
+    FALSE if the page table needs to be copied instead.
+
+--*/
+
+{
+
+    PSHARED_PAGE_TABLE Borrower;
+    ULONG Count;
+    PPTE DestinationDirectory;
+    RUNLEVEL OldRunLevel;
+    PSHARED_PAGE_TABLE Owner;
+    PPTE PageTable;
+    PPTE SourceDirectory;
+    ULONG TableIndex;
+
+    if ((Destination->SharedPageTables == NULL) ||
+        (Source->SharedPageTables == NULL)) {
+
+        return FALSE;
+    }
+
+    //
+    // Only share page tables the source owns, and only into a destination
+    // slot that has a preallocated page table to fall back on.
+    //
+
+    DestinationDirectory = Destination->PageDirectory;
+    SourceDirectory = Source->PageDirectory;
+    if ((SourceDirectory[DirectoryIndex].Present == 0) ||
+        (SourceDirectory[DirectoryIndex].Borrowed != 0) ||
+        (DestinationDirectory[DirectoryIndex].Present != 0) ||
+        (DestinationDirectory[DirectoryIndex].Entry == 0)) {
+
+        return FALSE;
+    }
+
+    Count = 0;
+    PageTable = GET_PAGE_TABLE(DirectoryIndex);
+    for (TableIndex = 0;
+         TableIndex < PAGE_SIZE / sizeof(PTE);
+         TableIndex += 1) {
+
+        if (PageTable[TableIndex].Entry != 0) {
+            Count += 1;
+        }
+    }
+
+    OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+    KeAcquireSpinLock(&MmSharedPageTableLock);
+    Owner = &(Source->SharedPageTables[DirectoryIndex]);
+    if (SourceDirectory[DirectoryIndex].Shared == 0) {
+        INITIALIZE_LIST_HEAD(&(Owner->ListEntry));
+        *((PULONG)&(SourceDirectory[DirectoryIndex])) =
+               (*((PULONG)&(SourceDirectory[DirectoryIndex])) &
+                ~PTE_FLAG_WRITABLE) | PTE_FLAG_SHARED;
+    }
+
+    Borrower = &(Destination->SharedPageTables[DirectoryIndex]);
+    Borrower->Owner = Source;
+    Borrower->Reserve = (ULONG)(DestinationDirectory[DirectoryIndex].Entry <<
+                                PAGE_SHIFT);
+
+    INSERT_BEFORE(&(Borrower->ListEntry), &(Owner->ListEntry));
+    *((PULONG)&(DestinationDirectory[DirectoryIndex])) =
+                   (*((PULONG)&(SourceDirectory[DirectoryIndex])) &
+                    PTE_FLAG_ENTRY_MASK) |
+                   PTE_FLAG_PRESENT | PTE_FLAG_USER_MODE | PTE_FLAG_BORROWED;
+
+    KeReleaseSpinLock(&MmSharedPageTableLock);
+    KeLowerRunLevel(OldRunLevel);
+    *MappedCount += Count;
+    return TRUE;
+}
+
+VOID
+MmpBreakPageTableShare (
+    PADDRESS_SPACE_X86 AddressSpace,
+    ULONG DirectoryIndex
+    )
+
+/*++
+
+Routine Description:
+
+    This routine makes a shared user mode page table private to the given
+    address space so that its entries can be changed. A borrower takes a
+    private copy of the table. An owner moves all of its borrowers onto
+    private copies and then takes back write access. This routine never
+    allocates, and can be called at dispatch level.
+
+Arguments:
+
+    AddressSpace - Supplies a pointer to the address space that is about to
+        change the page table.
+
+    DirectoryIndex - Supplies the page directory index of the page table.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PSHARED_PAGE_TABLE Borrower;
+    PPTE Directory;
+    PSHARED_PAGE_TABLE Entry;
+    RUNLEVEL OldRunLevel;
+    PPTE PageTable;
+    ULONG TableIndex;
+
+    Directory = AddressSpace->PageDirectory;
+    Entry = &(AddressSpace->SharedPageTables[DirectoryIndex]);
+    OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+    KeAcquireSpinLock(&MmSharedPageTableLock);
+    if (Directory[DirectoryIndex].Borrowed != 0) {
+        MmpDetachSharedPageTable(Entry, TRUE);
+
+    } else if (Directory[DirectoryIndex].Shared != 0) {
+        while (LIST_EMPTY(&(Entry->ListEntry)) == FALSE) {
+            Borrower = LIST_VALUE(Entry->ListEntry.Next,
+                                  SHARED_PAGE_TABLE,
+                                  ListEntry);
+
+            MmpDetachSharedPageTable(Borrower, TRUE);
+        }
+
+        //
+        // The entries were only read-only by virtue of the directory entry.
+        // Write protect them individually before opening the directory entry
+        // back up so that copy-on-write faults still happen.
+        //
+
+        PageTable = MmpMapSharedPageTableWindow(
+                       0,
+                       (ULONG)(Directory[DirectoryIndex].Entry << PAGE_SHIFT));
+
+        for (TableIndex = 0;
+             TableIndex < PAGE_SIZE / sizeof(PTE);
+             TableIndex += 1) {
+
+            *((PULONG)&(PageTable[TableIndex])) &= ~PTE_FLAG_WRITABLE;
+        }
+
+        MmpUnmapPages(PageTable, 1, 0, NULL);
+        *((PULONG)&(Directory[DirectoryIndex])) =
+                     (*((PULONG)&(Directory[DirectoryIndex])) &
+                      ~PTE_FLAG_SHARED) | PTE_FLAG_WRITABLE;
+    }
+
+    KeReleaseSpinLock(&MmSharedPageTableLock);
+    KeLowerRunLevel(OldRunLevel);
+    return;
+}
+
+VOID
+MmpDetachSharedPageTable (
+    PSHARED_PAGE_TABLE Borrower,
+    BOOL CopyPageTable
+    )
+
+/*++
+
+Routine Description:
+
+    This routine stops an address space from borrowing another address
+    space's page table. The shared page table lock must be held.
+
+Arguments:
+
+    Borrower - Supplies a pointer to the borrower's sharing state.
+
+    CopyPageTable - Supplies a boolean indicating whether to switch the
+        borrower over to a private copy of the page table (TRUE) or to just
+        leave the reserve page in the directory entry, not present, for an
+        address space that is being destroyed (FALSE).
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PPTE Destination;
+    PPTE Directory;
+    ULONG DirectoryIndex;
+    PPTE Source;
+    PADDRESS_SPACE_X86 Space;
+    ULONG TableIndex;
+
+    ASSERT(KeIsSpinLockHeld(&MmSharedPageTableLock) != FALSE);
+    ASSERT((Borrower->Owner != NULL) && (Borrower->Reserve != 0));
+
+    Space = Borrower->AddressSpace;
+    DirectoryIndex = Borrower - Space->SharedPageTables;
+    Directory = Space->PageDirectory;
+
+    ASSERT(Directory[DirectoryIndex].Borrowed != 0);
+
+    LIST_REMOVE(&(Borrower->ListEntry));
+    if (CopyPageTable != FALSE) {
+        Source = MmpMapSharedPageTableWindow(
+                       0,
+                       (ULONG)(Directory[DirectoryIndex].Entry << PAGE_SHIFT));
+
+        Destination = MmpMapSharedPageTableWindow(1, Borrower->Reserve);
+        for (TableIndex = 0;
+             TableIndex < PAGE_SIZE / sizeof(PTE);
+             TableIndex += 1) {
+
+            *((PULONG)&(Destination[TableIndex])) =
+                                   *((PULONG)&(Source[TableIndex])) &
+                                   ~(PTE_FLAG_WRITABLE | PTE_FLAG_DIRTY);
+        }
+
+        MmpUnmapPages(MmSharedPageTableWindow, 2, 0, NULL);
+        *((PULONG)&(Directory[DirectoryIndex])) = Borrower->Reserve |
+                                                  PTE_FLAG_PRESENT |
+                                                  PTE_FLAG_USER_MODE |
+                                                  PTE_FLAG_WRITABLE;
+
+        //
+        // The user mode translations are unchanged, but the self map entry
+        // for this page table still points at the owner's copy on any
+        // processor running in this address space.
+        //
+
+        MmpSendTlbInvalidateIpi(&(Space->Common),
+                                GET_PAGE_TABLE(DirectoryIndex),
+                                1);
+
+    } else {
+        *((PULONG)&(Directory[DirectoryIndex])) = Borrower->Reserve;
+    }
+
+    Borrower->Owner = NULL;
+    Borrower->Reserve = 0;
+    return;
+}
+
+ULONG
+MmpDropBorrowedPageTable (
+    PADDRESS_SPACE_X86 AddressSpace,
+    ULONG DirectoryIndex
+    )
+
+/*++
+
+Routine Description:
+
+    This routine stops the current address space from borrowing a page table
+    without taking a copy of it. The directory entry is left not present,
+    pointing at the reserve page, which is exactly how the page table would
+    look if it had been preallocated and never used.
+
+Arguments:
+
+    AddressSpace - Supplies a pointer to the current address space.
+
+    DirectoryIndex - Supplies the page directory index of the borrowed page
+        table.
+
+Return Value:
+
+    Returns the number of mappings that disappeared along with the page
+    table.
+
+--*/
+
+{
+
+    ULONG Count;
+    RUNLEVEL OldRunLevel;
+    PPTE PageTable;
+    ULONG TableIndex;
+
+    ASSERT(&(AddressSpace->Common) == PsGetCurrentProcess()->AddressSpace);
+
+    Count = 0;
+    OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+    KeAcquireSpinLock(&MmSharedPageTableLock);
+    if (AddressSpace->PageDirectory[DirectoryIndex].Borrowed != 0) {
+        PageTable = GET_PAGE_TABLE(DirectoryIndex);
+        for (TableIndex = 0;
+             TableIndex < PAGE_SIZE / sizeof(PTE);
+             TableIndex += 1) {
+
+            if (PageTable[TableIndex].Entry != 0) {
+                Count += 1;
+            }
+        }
+
+        MmpDetachSharedPageTable(
+                             &(AddressSpace->SharedPageTables[DirectoryIndex]),
+                             FALSE);
+
+        ArInvalidateTlbEntry(PageTable);
+    }
+
+    KeReleaseSpinLock(&MmSharedPageTableLock);
+    KeLowerRunLevel(OldRunLevel);
+    return Count;
+}
+
+PPTE
+MmpMapSharedPageTableWindow (
+    ULONG Slot,
+    PHYSICAL_ADDRESS PageTable
+    )
+
+/*++
+
+Routine Description:
+
+    This routine maps a page table into the shared page table window. The
+    shared page table lock must be held.
+
+Arguments:
+
+    Slot - Supplies the page of the window to use, zero or one.
+
+    PageTable - Supplies the physical address of the page table to map.
+
+Return Value:
+
+    Returns the virtual address of the mapped page table.
+
+--*/
+
+{
+
+    PVOID Address;
+
+    ASSERT(Slot < 2);
+
+    Address = MmSharedPageTableWindow + (Slot << PAGE_SHIFT);
+    MmpMapPage(PageTable, Address, MAP_FLAG_PRESENT | MAP_FLAG_GLOBAL);
+
+    //
+    // Unmapping the window only invalidates the processor that used it last,
+    // so this processor may have picked up a stale translation speculatively.
+    //
+
+    ArInvalidateTlbEntry(Address);
+    return Address;
+}
@@ -254,7 +254,10 @@ Return Value:
                               SystemDirectorySize);
             }
 
-            PspInitializeUserLocking();
+            Status = PspInitializeUserLocking();
+            if (!KSUCCESS(Status)) {
+                goto InitializeEnd;
+            }
 
         } else {
             KernelProcess = PsKernelProcess;
@@ -630,6 +633,8 @@ Return Value:
     CurrentThread->State = ThreadStateRunning;
     CurrentThread->SchedulerEntry.Type = SchedulerEntryThread;
     CurrentThread->SchedulerEntry.Parent = &(Processor->Scheduler.Group.Entry);
+    KeSetThreadNiceValue(CurrentThread, SCHEDULER_NICE_DEFAULT);
+    PROCESSOR_AFFINITY_SET_ALL(&(CurrentThread->Affinity));
     CurrentThread->ThreadPointer = PsInitialThreadPointer;
     CurrentThread->BuiltinWaitBlock = ObCreateWaitBlock(0);
     if (CurrentThread->BuiltinWaitBlock == NULL) {
@@ -58,6 +58,13 @@ Module Name:
 
 #define MAX_PROCESS_NAME_LENGTH 11
 
+//
+// Define the exit status of a spawned child that failed to start its image.
+// This matches the status used by shells for commands that cannot be run.
+//
+
+#define SPAWN_FAILURE_EXIT_STATUS 127
+
 //
 // ----------------------------------------------- Internal Function Prototypes
 //
@@ -72,11 +79,29 @@ PspProcessChildrenOfTerminatingProcess (
     PKPROCESS Process
     );
 
+KSTATUS
+PspCreateChildProcess (
+    PKPROCESS Process,
+    PPROCESS_ENVIRONMENT Environment,
+    PKPROCESS *CreatedProcess
+    );
+
 VOID
 PspLoaderThread (
     PVOID Context
     );
 
+VOID
+PspSpawnLoaderThread (
+    PVOID Parameter
+    );
+
+KSTATUS
+PspPerformSpawnFileAction (
+    PKPROCESS Process,
+    PSPAWN_FILE_ACTION Action
+    );
+
 KSTATUS
 PspLoadExecutable (
     PSTR BinaryName,
@@ -166,6 +191,41 @@ PspReadResourceUsage (
 // ------------------------------------------------------ Data Type Definitions
 //
 
+/*++
+
+Structure Description:
+
+    This structure stores the state handed from a spawning parent to the
+    loader thread of its new child.
+
+Members:
+
+    FileActions - Stores the kernel copy of the file actions to perform in the
+        child.
+
+    FileActionCount - Stores the number of elements in the file actions array.
+
+    Attributes - Stores the attributes to apply to the child.
+
+    BlockedSignals - Stores the signal mask to give the child's main thread.
+
+    Event - Stores a pointer to the event the parent waits on. The loader
+        thread signals it once the image is running or has failed to load.
+
+    Status - Stores the final status of the spawn, filled in by the loader
+        thread before it signals the event.
+
+--*/
+
+typedef struct _SPAWN_CONTEXT {
+    PSPAWN_FILE_ACTION FileActions;
+    ULONG FileActionCount;
+    SPAWN_ATTRIBUTES Attributes;
+    SIGNAL_SET BlockedSignals;
+    PKEVENT Event;
+    KSTATUS Status;
+} SPAWN_CONTEXT, *PSPAWN_CONTEXT;
+
 //
 // -------------------------------------------------------------------- Globals
 //
@@ -679,6 +739,253 @@ Return Value:
     return ReturnValue;
 }
 
+INTN
+PsSysSpawnProcess (
+    PVOID SystemCallParameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates a new child process running the given image without
+    copying the address space of the caller. File actions and attributes are
+    applied in the child before the image is loaded.
+
+Arguments:
+
+    SystemCallParameter - Supplies a pointer to the parameters supplied with
+        the system call. This structure will be a stack-local copy of the
+        actual parameters passed from user-mode.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    Error status code on failure.
+
+--*/
+
+{
+
+    PSPAWN_FILE_ACTION Action;
+    ULONG ActionIndex;
+    UINTN AllocationSize;
+    SPAWN_CONTEXT Context;
+    PKTHREAD CurrentThread;
+    PROCESS_ENVIRONMENT Environment;
+    PPROCESS_ENVIRONMENT NewEnvironment;
+    PKPROCESS NewProcess;
+    PSYSTEM_CALL_SPAWN_PROCESS Parameters;
+    PSTR Path;
+    PKPROCESS Process;
+    KSTATUS Status;
+    THREAD_CREATION_PARAMETERS ThreadParameters;
+
+    CurrentThread = KeGetCurrentThread();
+    Process = CurrentThread->OwningProcess;
+    Parameters = (PSYSTEM_CALL_SPAWN_PROCESS)SystemCallParameter;
+    Parameters->ProcessId = -1;
+    RtlZeroMemory(&Context, sizeof(SPAWN_CONTEXT));
+    NewEnvironment = NULL;
+    NewProcess = NULL;
+
+    ASSERT(Process != PsGetKernelProcess());
+
+    //
+    // Create the new environment in kernel mode.
+    //
+
+    Status = MmCopyFromUserMode(&Environment,
+                                Parameters->Environment,
+                                sizeof(PROCESS_ENVIRONMENT));
+
+    if (!KSUCCESS(Status)) {
+        goto SysSpawnProcessEnd;
+    }
+
+    Status = PsCopyEnvironment(&Environment, &NewEnvironment, TRUE, NULL);
+    if (!KSUCCESS(Status)) {
+        goto SysSpawnProcessEnd;
+    }
+
+    if (Parameters->Attributes != NULL) {
+        Status = MmCopyFromUserMode(&(Context.Attributes),
+                                    Parameters->Attributes,
+                                    sizeof(SPAWN_ATTRIBUTES));
+
+        if (!KSUCCESS(Status)) {
+            goto SysSpawnProcessEnd;
+        }
+
+        if ((Context.Attributes.Flags & ~SPAWN_ATTRIBUTE_MASK) != 0) {
+            Status = STATUS_INVALID_PARAMETER;
+            goto SysSpawnProcessEnd;
+        }
+    }
+
+    //
+    // Copy the file actions and any paths they refer to, as the child cannot
+    // see the memory of this process.
+    //
+
+    if (Parameters->FileActionCount != 0) {
+        if (Parameters->FileActionCount > SPAWN_MAX_FILE_ACTIONS) {
+            Status = STATUS_INVALID_PARAMETER;
+            goto SysSpawnProcessEnd;
+        }
+
+        AllocationSize = sizeof(SPAWN_FILE_ACTION) *
+                         Parameters->FileActionCount;
+
+        Context.FileActions = MmAllocatePagedPool(AllocationSize,
+                                                  PS_ALLOCATION_TAG);
+
+        if (Context.FileActions == NULL) {
+            Status = STATUS_INSUFFICIENT_RESOURCES;
+            goto SysSpawnProcessEnd;
+        }
+
+        Status = MmCopyFromUserMode(Context.FileActions,
+                                    Parameters->FileActions,
+                                    AllocationSize);
+
+        if (!KSUCCESS(Status)) {
+            goto SysSpawnProcessEnd;
+        }
+
+        for (ActionIndex = 0;
+             ActionIndex < Parameters->FileActionCount;
+             ActionIndex += 1) {
+
+            Action = &(Context.FileActions[ActionIndex]);
+            Path = Action->Path;
+            Action->Path = NULL;
+            Context.FileActionCount += 1;
+            switch (Action->Type) {
+            case SpawnFileActionOpen:
+                Status = MmCreateCopyOfUserModeString(Path,
+                                                      Action->PathBufferLength,
+                                                      PS_ALLOCATION_TAG,
+                                                      &(Action->Path));
+
+                if (!KSUCCESS(Status)) {
+                    goto SysSpawnProcessEnd;
+                }
+
+                break;
+
+            case SpawnFileActionDuplicate:
+            case SpawnFileActionClose:
+                break;
+
+            default:
+                Status = STATUS_INVALID_PARAMETER;
+                goto SysSpawnProcessEnd;
+            }
+        }
+    }
+
+    Context.Event = KeCreateEvent(NULL);
+    if (Context.Event == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto SysSpawnProcessEnd;
+    }
+
+    //
+    // Create the child with this process' handles, but with an empty address
+    // space. Handled signals are reset to the default as they would be by an
+    // exec, as the handlers live in this process' image.
+    //
+
+    Status = PspCreateChildProcess(Process, NewEnvironment, &NewProcess);
+    if (!KSUCCESS(Status)) {
+        goto SysSpawnProcessEnd;
+    }
+
+    KeAcquireQueuedLock(NewProcess->QueuedLock);
+    NewProcess->SignalHandlerRoutine = NULL;
+    INITIALIZE_SIGNAL_SET(NewProcess->HandledSignals);
+    if ((Context.Attributes.Flags & SPAWN_ATTRIBUTE_SET_SIGNAL_DEFAULT) != 0) {
+        REMOVE_SIGNALS_FROM_SET(NewProcess->IgnoredSignals,
+                                Context.Attributes.DefaultSignals);
+    }
+
+    KeReleaseQueuedLock(NewProcess->QueuedLock);
+    if ((Context.Attributes.Flags & SPAWN_ATTRIBUTE_SET_SIGNAL_MASK) != 0) {
+        Context.BlockedSignals = Context.Attributes.SignalMask;
+
+    } else {
+        Context.BlockedSignals = CurrentThread->BlockedSignals;
+    }
+
+    //
+    // Kick off the loader thread in the child, which holds its own reference
+    // on the event.
+    //
+
+    ObAddReference(Context.Event);
+    RtlZeroMemory(&ThreadParameters, sizeof(THREAD_CREATION_PARAMETERS));
+    ThreadParameters.Process = NewProcess;
+    ThreadParameters.Name = "PspSpawnLoaderThread";
+    ThreadParameters.NameSize = sizeof("PspSpawnLoaderThread");
+    ThreadParameters.ThreadRoutine = PspSpawnLoaderThread;
+    ThreadParameters.Parameter = &Context;
+    Status = PsCreateThread(&ThreadParameters);
+    if (!KSUCCESS(Status)) {
+        ObReleaseReference(Context.Event);
+
+        //
+        // A thread was never launched, so nothing will clean up the new
+        // process. "Terminate" it now.
+        //
+
+        PspProcessTermination(NewProcess);
+        goto SysSpawnProcessEnd;
+    }
+
+    //
+    // Like vfork, wait until the child is either running its new image or
+    // has given up. This keeps the context alive for the loader thread and
+    // lets the caller see errors from the file actions and the image load.
+    // If the child failed, it exits with a well known status and must still
+    // be reaped by the caller.
+    //
+
+    Parameters->ProcessId = NewProcess->Identifiers.ProcessId;
+    KeWaitForEvent(Context.Event, FALSE, WAIT_TIME_INDEFINITE);
+    Status = Context.Status;
+
+SysSpawnProcessEnd:
+    if (Context.Event != NULL) {
+        KeDestroyEvent(Context.Event);
+    }
+
+    if (Context.FileActions != NULL) {
+        for (ActionIndex = 0;
+             ActionIndex < Context.FileActionCount;
+             ActionIndex += 1) {
+
+            Action = &(Context.FileActions[ActionIndex]);
+            if (Action->Path != NULL) {
+                MmFreePagedPool(Action->Path);
+            }
+        }
+
+        MmFreePagedPool(Context.FileActions);
+    }
+
+    if (NewProcess != NULL) {
+        ObReleaseReference(NewProcess);
+    }
+
+    if (NewEnvironment != NULL) {
+        PsDestroyEnvironment(NewEnvironment);
+    }
+
+    return Status;
+}
+
 INTN
 PsSysGetSetProcessId (
     PVOID SystemCallParameter
@@ -1703,180 +2010,68 @@ Return Value:
 
 {
 
-    PPATH_POINT CurrentDirectory;
-    PATH_POINT CurrentDirectoryCopy;
     PKTHREAD NewMainThread;
     PKPROCESS NewProcess;
-    PPATH_POINT RootDirectory;
-    PATH_POINT RootDirectoryCopy;
-    PPATH_POINT SharedMemoryDirectory;
-    PATH_POINT SharedMemoryDirectoryCopy;
     KSTATUS Status;
 
     ASSERT(KeGetRunLevel() == RunLevelLow);
 
-    CurrentDirectory = NULL;
-    RootDirectory = NULL;
-    SharedMemoryDirectory = NULL;
+    Status = PspCreateChildProcess(Process, NULL, &NewProcess);
+    if (!KSUCCESS(Status)) {
+        goto CopyProcessEnd;
+    }
 
     //
-    // Get the processes root and current directories. Add references in case a
-    // pending change directory is coming in, which would release the
-    // references held inherently by this process.
+    // Copy the process address space.
     //
 
-    KeAcquireQueuedLock(Process->Paths.Lock);
-    if (Process->Paths.CurrentDirectory.PathEntry != NULL) {
-        IO_COPY_PATH_POINT(&CurrentDirectoryCopy,
-                           &(Process->Paths.CurrentDirectory));
-
-        IO_PATH_POINT_ADD_REFERENCE(&CurrentDirectoryCopy);
-        CurrentDirectory = &CurrentDirectoryCopy;
-    }
+    Status = MmCloneAddressSpace(Process->AddressSpace,
+                                 NewProcess->AddressSpace);
 
-    if (Process->Paths.Root.PathEntry != NULL) {
-        IO_COPY_PATH_POINT(&RootDirectoryCopy, &(Process->Paths.Root));
-        IO_PATH_POINT_ADD_REFERENCE(&RootDirectoryCopy);
-        RootDirectory = &RootDirectoryCopy;
+    if (!KSUCCESS(Status)) {
+        goto CopyProcessEnd;
     }
 
-    if (Process->Paths.SharedMemoryDirectory.PathEntry != NULL) {
-        IO_COPY_PATH_POINT(&SharedMemoryDirectoryCopy,
-                           &(Process->Paths.SharedMemoryDirectory));
+    //
+    // Copy the image list.
+    //
 
-        IO_PATH_POINT_ADD_REFERENCE(&SharedMemoryDirectoryCopy);
-        SharedMemoryDirectory = &SharedMemoryDirectoryCopy;
+    Status = PspImCloneProcessImages(Process, NewProcess);
+    if (!KSUCCESS(Status)) {
+        goto CopyProcessEnd;
     }
 
-    KeReleaseQueuedLock(Process->Paths.Lock);
-    NewProcess = PspCreateProcess(Process->BinaryName,
-                                  Process->BinaryNameSize,
-                                  Process->Environment,
-                                  &(Process->Identifiers),
-                                  Process->ControllingTerminal,
-                                  RootDirectory,
-                                  CurrentDirectory,
-                                  SharedMemoryDirectory);
+    //
+    // Clone the main thread, which will kick off the new process.
+    //
 
-    if (CurrentDirectory != NULL) {
-        IO_PATH_POINT_RELEASE_REFERENCE(CurrentDirectory);
+    NewMainThread = PspCloneThread(NewProcess, MainThread, TrapFrame);
+    if (NewMainThread == NULL) {
+        Status = STATUS_UNSUCCESSFUL;
+        goto CopyProcessEnd;
     }
 
-    if (RootDirectory != NULL) {
-        IO_PATH_POINT_RELEASE_REFERENCE(RootDirectory);
-    }
+CopyProcessEnd:
+    if (!KSUCCESS(Status)) {
+        if (NewProcess != NULL) {
 
-    if (SharedMemoryDirectory != NULL) {
-        IO_PATH_POINT_RELEASE_REFERENCE(SharedMemoryDirectory);
+            //
+            // If the routine failed, then a thread was never launched. As such,
+            // nothing will clean up the new process. "Terminate" it now.
+            //
+
+            PspProcessTermination(NewProcess);
+            ObReleaseReference(NewProcess);
+            NewProcess = NULL;
+        }
     }
 
-    if (NewProcess == NULL) {
-        Status = STATUS_UNSUCCESSFUL;
-        goto CopyProcessEnd;
+    if (CreatedProcess != NULL) {
+        *CreatedProcess = NewProcess;
     }
 
-    //
-    // Set the parent, join the parent's children and then the parent's process
-    // group. The new process must be on the parent's list of children before
-    // joining the process group in case there is a race to change the parent's
-    // process group (perhaps a request from the grandparent). Changing a
-    // process group requires notifying all the children with non-null process
-    // groups.
-    //
-
-    NewProcess->Parent = Process;
-    KeAcquireQueuedLock(Process->QueuedLock);
-    NewProcess->SignalHandlerRoutine = Process->SignalHandlerRoutine;
-    NewProcess->HandledSignals = Process->HandledSignals;
-    NewProcess->IgnoredSignals = Process->IgnoredSignals;
-    NewProcess->Umask = Process->Umask;
-    INSERT_BEFORE(&(NewProcess->SiblingListEntry), &(Process->ChildListHead));
-    KeReleaseQueuedLock(Process->QueuedLock);
-    PspAddProcessToParentProcessGroup(NewProcess);
-
-    //
-    // If this process' controlling terminal was cleared during the process
-    // creation, clear out the new child as well, as the clearing may have
-    // happened before the new child was added to the global list.
-    //
-
-    if (Process->ControllingTerminal == NULL) {
-        NewProcess->ControllingTerminal = NULL;
-    }
-
-    //
-    // Add the tracing process if needed.
-    //
-
-    if ((Process->DebugData != NULL) &&
-        (Process->DebugData->TracingProcess != NULL)) {
-
-        Status = PspDebugEnable(NewProcess, Process->DebugData->TracingProcess);
-        if (!KSUCCESS(Status)) {
-            goto CopyProcessEnd;
-        }
-    }
-
-    //
-    // Copy the process handle table.
-    //
-
-    Status = IoCopyProcessHandles(Process, NewProcess);
-    if (!KSUCCESS(Status)) {
-        goto CopyProcessEnd;
-    }
-
-    //
-    // Copy the process address space.
-    //
-
-    Status = MmCloneAddressSpace(Process->AddressSpace,
-                                 NewProcess->AddressSpace);
-
-    if (!KSUCCESS(Status)) {
-        goto CopyProcessEnd;
-    }
-
-    //
-    // Copy the image list.
-    //
-
-    Status = PspImCloneProcessImages(Process, NewProcess);
-    if (!KSUCCESS(Status)) {
-        goto CopyProcessEnd;
-    }
-
-    //
-    // Clone the main thread, which will kick off the new process.
-    //
-
-    NewMainThread = PspCloneThread(NewProcess, MainThread, TrapFrame);
-    if (NewMainThread == NULL) {
-        Status = STATUS_UNSUCCESSFUL;
-        goto CopyProcessEnd;
-    }
-
-CopyProcessEnd:
-    if (!KSUCCESS(Status)) {
-        if (NewProcess != NULL) {
-
-            //
-            // If the routine failed, then a thread was never launched. As such,
-            // nothing will clean up the new process. "Terminate" it now.
-            //
-
-            PspProcessTermination(NewProcess);
-            ObReleaseReference(NewProcess);
-            NewProcess = NULL;
-        }
-    }
-
-    if (CreatedProcess != NULL) {
-        *CreatedProcess = NewProcess;
-    }
-
-    return Status;
-}
+    return Status;
+}
 
 PKPROCESS
 PspCreateProcess (
@@ -3319,6 +3514,189 @@ Return Value:
     return;
 }
 
+KSTATUS
+PspCreateChildProcess (
+    PKPROCESS Process,
+    PPROCESS_ENVIRONMENT Environment,
+    PKPROCESS *CreatedProcess
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates a new child of the given process with no threads and
+    an empty address space. The child inherits the parent's identifiers,
+    directories, signal dispositions, umask, and open handles. This routine
+    must only be called at low level.
+
+Arguments:
+
+    Process - Supplies a pointer to the parent process.
+
+    Environment - Supplies an optional pointer to the environment to give the
+        child. Supply NULL to copy the parent's environment.
+
+    CreatedProcess - Supplies a pointer where a pointer to the new process will
+        be returned on success. The caller is responsible for releasing the
+        reference on it, and for terminating it if no thread is ever
+        launched.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    PSTR CommandLine;
+    ULONG CommandLineSize;
+    PPATH_POINT CurrentDirectory;
+    PATH_POINT CurrentDirectoryCopy;
+    PKPROCESS NewProcess;
+    PPATH_POINT RootDirectory;
+    PATH_POINT RootDirectoryCopy;
+    PPATH_POINT SharedMemoryDirectory;
+    PATH_POINT SharedMemoryDirectoryCopy;
+    KSTATUS Status;
+
+    ASSERT(KeGetRunLevel() == RunLevelLow);
+
+    CurrentDirectory = NULL;
+    RootDirectory = NULL;
+    SharedMemoryDirectory = NULL;
+
+    //
+    // Get the processes root and current directories. Add references in case a
+    // pending change directory is coming in, which would release the
+    // references held inherently by this process.
+    //
+
+    KeAcquireQueuedLock(Process->Paths.Lock);
+    if (Process->Paths.CurrentDirectory.PathEntry != NULL) {
+        IO_COPY_PATH_POINT(&CurrentDirectoryCopy,
+                           &(Process->Paths.CurrentDirectory));
+
+        IO_PATH_POINT_ADD_REFERENCE(&CurrentDirectoryCopy);
+        CurrentDirectory = &CurrentDirectoryCopy;
+    }
+
+    if (Process->Paths.Root.PathEntry != NULL) {
+        IO_COPY_PATH_POINT(&RootDirectoryCopy, &(Process->Paths.Root));
+        IO_PATH_POINT_ADD_REFERENCE(&RootDirectoryCopy);
+        RootDirectory = &RootDirectoryCopy;
+    }
+
+    if (Process->Paths.SharedMemoryDirectory.PathEntry != NULL) {
+        IO_COPY_PATH_POINT(&SharedMemoryDirectoryCopy,
+                           &(Process->Paths.SharedMemoryDirectory));
+
+        IO_PATH_POINT_ADD_REFERENCE(&SharedMemoryDirectoryCopy);
+        SharedMemoryDirectory = &SharedMemoryDirectoryCopy;
+    }
+
+    KeReleaseQueuedLock(Process->Paths.Lock);
+    if (Environment == NULL) {
+        Environment = Process->Environment;
+        CommandLine = Process->BinaryName;
+        CommandLineSize = Process->BinaryNameSize;
+
+    } else {
+        CommandLine = Environment->ImageName;
+        CommandLineSize = Environment->ImageNameLength;
+    }
+
+    NewProcess = PspCreateProcess(CommandLine,
+                                  CommandLineSize,
+                                  Environment,
+                                  &(Process->Identifiers),
+                                  Process->ControllingTerminal,
+                                  RootDirectory,
+                                  CurrentDirectory,
+                                  SharedMemoryDirectory);
+
+    if (CurrentDirectory != NULL) {
+        IO_PATH_POINT_RELEASE_REFERENCE(CurrentDirectory);
+    }
+
+    if (RootDirectory != NULL) {
+        IO_PATH_POINT_RELEASE_REFERENCE(RootDirectory);
+    }
+
+    if (SharedMemoryDirectory != NULL) {
+        IO_PATH_POINT_RELEASE_REFERENCE(SharedMemoryDirectory);
+    }
+
+    if (NewProcess == NULL) {
+        Status = STATUS_UNSUCCESSFUL;
+        goto CreateChildProcessEnd;
+    }
+
+    //
+    // Set the parent, join the parent's children and then the parent's process
+    // group. The new process must be on the parent's list of children before
+    // joining the process group in case there is a race to change the parent's
+    // process group (perhaps a request from the grandparent). Changing a
+    // process group requires notifying all the children with non-null process
+    // groups.
+    //
+
+    NewProcess->Parent = Process;
+    KeAcquireQueuedLock(Process->QueuedLock);
+    NewProcess->SignalHandlerRoutine = Process->SignalHandlerRoutine;
+    NewProcess->HandledSignals = Process->HandledSignals;
+    NewProcess->IgnoredSignals = Process->IgnoredSignals;
+    NewProcess->Umask = Process->Umask;
+    INSERT_BEFORE(&(NewProcess->SiblingListEntry), &(Process->ChildListHead));
+    KeReleaseQueuedLock(Process->QueuedLock);
+    PspAddProcessToParentProcessGroup(NewProcess);
+
+    //
+    // If this process' controlling terminal was cleared during the process
+    // creation, clear out the new child as well, as the clearing may have
+    // happened before the new child was added to the global list.
+    //
+
+    if (Process->ControllingTerminal == NULL) {
+        NewProcess->ControllingTerminal = NULL;
+    }
+
+    //
+    // Add the tracing process if needed.
+    //
+
+    if ((Process->DebugData != NULL) &&
+        (Process->DebugData->TracingProcess != NULL)) {
+
+        Status = PspDebugEnable(NewProcess, Process->DebugData->TracingProcess);
+        if (!KSUCCESS(Status)) {
+            goto CreateChildProcessEnd;
+        }
+    }
+
+    //
+    // Copy the process handle table.
+    //
+
+    Status = IoCopyProcessHandles(Process, NewProcess);
+    if (!KSUCCESS(Status)) {
+        goto CreateChildProcessEnd;
+    }
+
+CreateChildProcessEnd:
+    if (!KSUCCESS(Status)) {
+        if (NewProcess != NULL) {
+            PspProcessTermination(NewProcess);
+            ObReleaseReference(NewProcess);
+            NewProcess = NULL;
+        }
+    }
+
+    *CreatedProcess = NewProcess;
+    return Status;
+}
+
 VOID
 PspLoaderThread (
     PVOID Context
@@ -3418,6 +3796,320 @@ Return Value:
     return;
 }
 
+VOID
+PspSpawnLoaderThread (
+    PVOID Parameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine starts a spawned process. It runs in the context of the new
+    child, applies the requested attributes and file actions, loads the image,
+    and launches the main thread. It then reports back to the waiting parent.
+
+Arguments:
+
+    Parameter - Supplies a pointer to the spawn context, which lives on the
+        parent's stack until the event within it is signaled.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG ActionIndex;
+    PSPAWN_ATTRIBUTES Attributes;
+    IMAGE_BUFFER Buffer;
+    PSPAWN_CONTEXT Context;
+    PKEVENT Event;
+    IMAGE_FILE_INFORMATION File;
+    IMAGE_FORMAT Format;
+    PKPROCESS Process;
+    PROCESS_GROUP_ID ProcessGroupId;
+    PROCESS_START_DATA StartData;
+    KSTATUS Status;
+    PKTHREAD Thread;
+    THREAD_CREATION_PARAMETERS ThreadParameters;
+
+    Context = Parameter;
+    Attributes = &(Context->Attributes);
+    RtlZeroMemory(&Buffer, sizeof(IMAGE_BUFFER));
+    File.Handle = INVALID_HANDLE;
+    Thread = KeGetCurrentThread();
+    Process = Thread->OwningProcess;
+
+    //
+    // Apply the attributes. This thread's credentials and signal mask are
+    // handed down to the main thread when it is created.
+    //
+
+    if ((Attributes->Flags & SPAWN_ATTRIBUTE_SET_PROCESS_GROUP) != 0) {
+        ProcessGroupId = Attributes->ProcessGroup;
+        if (ProcessGroupId == 0) {
+            ProcessGroupId = Process->Identifiers.ProcessId;
+        }
+
+        Status = PspJoinProcessGroup(Process, ProcessGroupId, FALSE);
+        if (!KSUCCESS(Status)) {
+            goto SpawnLoaderThreadEnd;
+        }
+    }
+
+    if ((Attributes->Flags & SPAWN_ATTRIBUTE_RESET_IDS) != 0) {
+        Thread->Identity.EffectiveUserId = Thread->Identity.RealUserId;
+        Thread->Identity.EffectiveGroupId = Thread->Identity.RealGroupId;
+    }
+
+    Thread->BlockedSignals = Context->BlockedSignals;
+
+    //
+    // Perform the file actions in order, then close everything marked for
+    // "close on execute".
+    //
+
+    for (ActionIndex = 0;
+         ActionIndex < Context->FileActionCount;
+         ActionIndex += 1) {
+
+        Status = PspPerformSpawnFileAction(Process,
+                                           &(Context->FileActions[ActionIndex]));
+
+        if (!KSUCCESS(Status)) {
+            goto SpawnLoaderThreadEnd;
+        }
+    }
+
+    Status = IoCloseHandlesOnExecute(Process);
+    if (!KSUCCESS(Status)) {
+        goto SpawnLoaderThreadEnd;
+    }
+
+    //
+    // Set up the address space as the regular loader thread would.
+    //
+
+    Status = MmMapUserSharedData(Process->AddressSpace);
+    if (!KSUCCESS(Status)) {
+        goto SpawnLoaderThreadEnd;
+    }
+
+    Process->AddressSpace->MaxMemoryMap = MAX_USER_ADDRESS -
+                                  (Thread->Limits[ResourceLimitStack].Current +
+                                   USER_STACK_HEADROOM) + 1;
+
+    //
+    // Check the image and perform any security context changes it calls for
+    // before loading it.
+    //
+
+    Status = ImGetExecutableFormat(Process->Environment->ImageName,
+                                   Process,
+                                   &File,
+                                   &Buffer,
+                                   &Format);
+
+    if (!KSUCCESS(Status)) {
+        goto SpawnLoaderThreadEnd;
+    }
+
+    PspPerformExecutePermissionChanges(File.Handle);
+    Status = PspLoadExecutable(Process->Environment->ImageName,
+                               &File,
+                               &Buffer,
+                               &StartData);
+
+    if (!KSUCCESS(Status)) {
+        goto SpawnLoaderThreadEnd;
+    }
+
+    File.Handle = INVALID_HANDLE;
+
+    //
+    // Mark that the process has executed an image, which prevents the parent
+    // from changing its process group from here on.
+    //
+
+    KeAcquireQueuedLock(Process->QueuedLock);
+    Process->Flags |= PROCESS_FLAG_EXECUTED_IMAGE;
+    KeReleaseQueuedLock(Process->QueuedLock);
+
+    //
+    // Kick off the primary usermode thread.
+    //
+
+    Process->Environment->StartData = &StartData;
+    RtlZeroMemory(&ThreadParameters, sizeof(THREAD_CREATION_PARAMETERS));
+    ThreadParameters.Name = "MainThread";
+    ThreadParameters.NameSize = sizeof("MainThread");
+    ThreadParameters.ThreadRoutine = StartData.EntryPoint;
+    ThreadParameters.Environment = Process->Environment;
+    ThreadParameters.Flags = THREAD_FLAG_USER_MODE;
+    Status = PsCreateThread(&ThreadParameters);
+    Process->Environment->StartData = NULL;
+    if (!KSUCCESS(Status)) {
+        goto SpawnLoaderThreadEnd;
+    }
+
+    Status = STATUS_SUCCESS;
+
+SpawnLoaderThreadEnd:
+    if (File.Handle != INVALID_HANDLE) {
+        IoClose(File.Handle);
+    }
+
+    if (!KSUCCESS(Status)) {
+        PspSetProcessExitStatus(Process,
+                                CHILD_SIGNAL_REASON_EXITED,
+                                SPAWN_FAILURE_EXIT_STATUS);
+    }
+
+    //
+    // Report back to the parent. The context is gone as soon as the event is
+    // signaled, so grab the event first. This thread's reference keeps the
+    // event alive through the signal.
+    //
+
+    Event = Context->Event;
+    Context->Status = Status;
+    KeSignalEvent(Event, SignalOptionSignalAll);
+    ObReleaseReference(Event);
+    return;
+}
+
+KSTATUS
+PspPerformSpawnFileAction (
+    PKPROCESS Process,
+    PSPAWN_FILE_ACTION Action
+    )
+
+/*++
+
+Routine Description:
+
+    This routine performs a single spawn file action in the current process,
+    which is the newly spawned child.
+
+Arguments:
+
+    Process - Supplies a pointer to the current process.
+
+    Action - Supplies a pointer to the file action to perform. Any path in the
+        action has already been copied into kernel mode.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    ULONG Access;
+    SYSTEM_CALL_DUPLICATE_HANDLE Duplicate;
+    ULONG Flags;
+    HANDLE Handle;
+    ULONG HandleFlags;
+    PIO_HANDLE IoHandle;
+    ULONG OpenFlags;
+    KSTATUS Status;
+
+    switch (Action->Type) {
+
+    //
+    // Open the file into a new handle, and then move it over to the requested
+    // descriptor if it did not land there already.
+    //
+
+    case SpawnFileActionOpen:
+        Access = (Action->Flags >> SYS_OPEN_ACCESS_SHIFT) & IO_ACCESS_MASK;
+        OpenFlags = Action->Flags & SYS_OPEN_FLAG_MASK;
+        Status = IoOpen(FALSE,
+                        NULL,
+                        Action->Path,
+                        RtlStringLength(Action->Path) + 1,
+                        Access,
+                        OpenFlags,
+                        Action->CreatePermissions,
+                        &IoHandle);
+
+        if (!KSUCCESS(Status)) {
+            break;
+        }
+
+        HandleFlags = 0;
+        if ((Action->Flags & SYS_OPEN_FLAG_CLOSE_ON_EXECUTE) != 0) {
+            HandleFlags |= FILE_DESCRIPTOR_CLOSE_ON_EXECUTE;
+        }
+
+        Status = ObCreateHandle(Process->HandleTable,
+                                IoHandle,
+                                HandleFlags,
+                                &Handle);
+
+        if (!KSUCCESS(Status)) {
+            IoClose(IoHandle);
+            break;
+        }
+
+        if (Handle != Action->Handle) {
+            Duplicate.OldHandle = Handle;
+            Duplicate.NewHandle = Action->Handle;
+            Duplicate.OpenFlags = Action->Flags &
+                                  SYS_OPEN_FLAG_CLOSE_ON_EXECUTE;
+
+            Status = (KSTATUS)IoSysDuplicateHandle(&Duplicate);
+            IoSysClose(Handle);
+        }
+
+        break;
+
+    //
+    // Duplicate the handle, leaving the new handle open across the exec even
+    // if it is a duplicate of itself.
+    //
+
+    case SpawnFileActionDuplicate:
+        if (Action->Handle == Action->NewHandle) {
+            Flags = 0;
+            Status = ObGetSetHandleFlags(Process->HandleTable,
+                                         Action->Handle,
+                                         TRUE,
+                                         &Flags);
+
+        } else {
+            Duplicate.OldHandle = Action->Handle;
+            Duplicate.NewHandle = Action->NewHandle;
+            Duplicate.OpenFlags = 0;
+            Status = (KSTATUS)IoSysDuplicateHandle(&Duplicate);
+        }
+
+        break;
+
+    //
+    // Failing to close a handle that is not open is not an error.
+    //
+
+    case SpawnFileActionClose:
+        IoSysClose(Action->Handle);
+        Status = STATUS_SUCCESS;
+        break;
+
+    default:
+
+        ASSERT(FALSE);
+
+        Status = STATUS_INVALID_PARAMETER;
+        break;
+    }
+
+    return Status;
+}
+
 KSTATUS
 PspLoadExecutable (
     PSTR BinaryName,
@@ -4700,6 +5392,14 @@ Return Value:
                                    &(Buffer->ChildResourceUsage));
 
         Buffer->Frequency = HlQueryProcessorCounterFrequency();
+        if (Process->AddressSpace != NULL) {
+            Buffer->ResidentSet = Process->AddressSpace->ResidentSet;
+            Buffer->WorkingSet = Process->AddressSpace->WorkingSet;
+
+        } else {
+            Buffer->ResidentSet = 0;
+            Buffer->WorkingSet = 0;
+        }
 
         //
         // Get the size of the first image on the process's image list. This
@@ -1385,7 +1385,7 @@ Return Value:
 
 --*/
 
-VOID
+KSTATUS
 PspInitializeUserLocking (
     VOID
     );
@@ -1402,7 +1402,7 @@ Routine Description:
 
 Return Value:
 
-    None.
+    Status code.
 
 --*/
 
@@ -1427,3 +1427,30 @@ Return Value:
 
 --*/
 
+VOID
+PspSetThreadBaseNiceValue (
+    PKTHREAD Thread,
+    LONG NiceValue
+    );
+
+/*++
+
+Routine Description:
+
+    This routine sets the nice value of a thread on behalf of user mode. If the
+    thread is currently running at a priority inherited through a user lock,
+    the new value is recorded as the one to return to once the boost ends, and
+    only takes effect now if it is less nice than the boost.
+
+Arguments:
+
+    Thread - Supplies a pointer to the thread to modify.
+
+    NiceValue - Supplies the new nice value.
+
+Return Value:
+
+    None.
+
+--*/
+
@@ -70,6 +70,51 @@ Module Name:
 
 #define THREAD_CREATE_REAP_COUNT 2
 
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+/*++
+
+Structure Description:
+
+    This structure stores the context for getting or setting the nice value of
+    a set of processes.
+
+Members:
+
+    CurrentThread - Stores a pointer to the calling thread.
+
+    Set - Stores a boolean indicating whether to set the nice value (TRUE) or
+        just get it (FALSE).
+
+    MatchUser - Stores a boolean indicating whether or not only processes
+        whose real user ID matches the user ID member should be operated on.
+
+    UserId - Stores the user ID to match if the match user flag is set.
+
+    NiceValue - Stores the new nice value to set.
+
+    PreviousNiceValue - Stores the lowest nice value of all matching threads
+        seen so far.
+
+    MatchCount - Stores the number of processes operated on.
+
+    Status - Stores the first failing status code encountered.
+
+--*/
+
+typedef struct _SET_PRIORITY_ITERATOR_CONTEXT {
+    PKTHREAD CurrentThread;
+    BOOL Set;
+    BOOL MatchUser;
+    USER_ID UserId;
+    LONG NiceValue;
+    LONG PreviousNiceValue;
+    ULONG MatchCount;
+    KSTATUS Status;
+} SET_PRIORITY_ITERATOR_CONTEXT, *PSET_PRIORITY_ITERATOR_CONTEXT;
+
 //
 // ----------------------------------------------- Internal Function Prototypes
 //
@@ -99,6 +144,25 @@ PspDestroyThread (
     PVOID ThreadObject
     );
 
+BOOL
+PspSetPriorityIterator (
+    PVOID Context,
+    PKPROCESS Process
+    );
+
+KSTATUS
+PspSetProcessPriority (
+    PSET_PRIORITY_ITERATOR_CONTEXT Context,
+    PKPROCESS Process
+    );
+
+KSTATUS
+PspSetProcessAffinity (
+    PKPROCESS Process,
+    BOOL Set,
+    PPROCESSOR_AFFINITY Affinity
+    );
+
 KSTATUS
 PspGetThreadList (
     PROCESS_ID ProcessId,
@@ -775,6 +839,287 @@ Return Value:
     return STATUS_SUCCESS;
 }
 
+INTN
+PsSysSetPriority (
+    PVOID SystemCallParameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine implements the system call that gets or sets the scheduling
+    nice value of a thread, process, process group, or user.
+
+Arguments:
+
+    SystemCallParameter - Supplies a pointer to the parameters supplied with
+        the system call. This structure will be a stack-local copy of the
+        actual parameters passed from user-mode.
+
+Return Value:
+
+    STATUS_SUCCESS or positive integer on success.
+
+    Error status code on failure.
+
+--*/
+
+{
+
+    SET_PRIORITY_ITERATOR_CONTEXT Context;
+    PKPROCESS CurrentProcess;
+    PKTHREAD CurrentThread;
+    PROCESS_ID_TYPE MatchType;
+    PSYSTEM_CALL_SET_PRIORITY Parameters;
+    PKPROCESS Process;
+    KSTATUS Status;
+    PROCESS_ID TargetId;
+    PKTHREAD Thread;
+
+    ASSERT(KeGetRunLevel() == RunLevelLow);
+
+    Parameters = (PSYSTEM_CALL_SET_PRIORITY)SystemCallParameter;
+    CurrentThread = KeGetCurrentThread();
+    CurrentProcess = CurrentThread->OwningProcess;
+    RtlZeroMemory(&Context, sizeof(SET_PRIORITY_ITERATOR_CONTEXT));
+    Context.CurrentThread = CurrentThread;
+    Context.Set = Parameters->Set;
+    Context.NiceValue = Parameters->NiceValue;
+    if (Context.NiceValue < SCHEDULER_NICE_MINIMUM) {
+        Context.NiceValue = SCHEDULER_NICE_MINIMUM;
+
+    } else if (Context.NiceValue > SCHEDULER_NICE_MAXIMUM) {
+        Context.NiceValue = SCHEDULER_NICE_MAXIMUM;
+    }
+
+    Context.PreviousNiceValue = SCHEDULER_NICE_MAXIMUM;
+    Context.Status = STATUS_SUCCESS;
+    TargetId = Parameters->TargetId;
+    switch (Parameters->TargetType) {
+    case PriorityTargetThread:
+        if (TargetId == -1) {
+            Thread = CurrentThread;
+            ObAddReference(Thread);
+
+        } else {
+            Thread = PspGetThreadById(CurrentProcess, TargetId);
+        }
+
+        if (Thread == NULL) {
+            Status = STATUS_NO_SUCH_THREAD;
+            goto SysSetPriorityEnd;
+        }
+
+        Context.PreviousNiceValue = Thread->SchedulerEntry.NiceValue;
+        Status = STATUS_SUCCESS;
+        if (Context.Set != FALSE) {
+
+            //
+            // Making a thread less nice requires the scheduling permission.
+            //
+
+            if (Context.NiceValue < Thread->SchedulerEntry.NiceValue) {
+                Status = PsCheckPermission(PERMISSION_SCHEDULING);
+            }
+
+            if (KSUCCESS(Status)) {
+                PspSetThreadBaseNiceValue(Thread, Context.NiceValue);
+            }
+        }
+
+        ObReleaseReference(Thread);
+        break;
+
+    case PriorityTargetProcess:
+        if ((TargetId == -1) ||
+            (TargetId == CurrentProcess->Identifiers.ProcessId)) {
+
+            Process = CurrentProcess;
+            ObAddReference(Process);
+
+        } else {
+            Process = PspGetProcessById(TargetId);
+            if (Process == NULL) {
+                Status = STATUS_NO_SUCH_PROCESS;
+                goto SysSetPriorityEnd;
+            }
+
+            if (Process == PsGetKernelProcess()) {
+                ObReleaseReference(Process);
+                Status = STATUS_ACCESS_DENIED;
+                goto SysSetPriorityEnd;
+            }
+        }
+
+        Status = PspSetProcessPriority(&Context, Process);
+        ObReleaseReference(Process);
+        break;
+
+    case PriorityTargetProcessGroup:
+    case PriorityTargetUser:
+        if (Parameters->TargetType == PriorityTargetProcessGroup) {
+            MatchType = ProcessIdProcessGroup;
+            if (TargetId == -1) {
+                TargetId = CurrentProcess->Identifiers.ProcessGroupId;
+            }
+
+        } else {
+            MatchType = ProcessIdProcess;
+            Context.MatchUser = TRUE;
+            Context.UserId = (USER_ID)TargetId;
+            if (TargetId == -1) {
+                Context.UserId = CurrentThread->Identity.RealUserId;
+            }
+
+            TargetId = -1;
+        }
+
+        PsIterateProcess(MatchType, TargetId, PspSetPriorityIterator, &Context);
+        Status = Context.Status;
+        if ((KSUCCESS(Status)) && (Context.MatchCount == 0)) {
+            Status = STATUS_NO_SUCH_PROCESS;
+        }
+
+        break;
+
+    default:
+        Status = STATUS_INVALID_PARAMETER;
+        goto SysSetPriorityEnd;
+    }
+
+    Parameters->NiceValue = Context.PreviousNiceValue;
+
+SysSetPriorityEnd:
+    return Status;
+}
+
+INTN
+PsSysSetAffinity (
+    PVOID SystemCallParameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine implements the system call that gets or sets the processor
+    affinity of a thread or of all threads in a process.
+
+Arguments:
+
+    SystemCallParameter - Supplies a pointer to the parameters supplied with
+        the system call. This structure will be a stack-local copy of the
+        actual parameters passed from user-mode.
+
+Return Value:
+
+    STATUS_SUCCESS or positive integer on success.
+
+    Error status code on failure.
+
+--*/
+
+{
+
+    PROCESSOR_AFFINITY Affinity;
+    UINTN CopySize;
+    PKPROCESS CurrentProcess;
+    PKTHREAD CurrentThread;
+    PSYSTEM_CALL_SET_AFFINITY Parameters;
+    PKPROCESS Process;
+    KSTATUS Status;
+    PKTHREAD Thread;
+
+    ASSERT(KeGetRunLevel() == RunLevelLow);
+
+    Parameters = (PSYSTEM_CALL_SET_AFFINITY)SystemCallParameter;
+    CurrentThread = KeGetCurrentThread();
+    CurrentProcess = CurrentThread->OwningProcess;
+    CopySize = Parameters->MaskSize;
+    if (CopySize > sizeof(PROCESSOR_AFFINITY)) {
+        CopySize = sizeof(PROCESSOR_AFFINITY);
+    }
+
+    //
+    // Processors beyond the end of the supplied mask are not allowed.
+    //
+
+    RtlZeroMemory(&Affinity, sizeof(PROCESSOR_AFFINITY));
+    if (Parameters->Set != FALSE) {
+        Status = MmCopyFromUserMode(&Affinity, Parameters->Mask, CopySize);
+        if (!KSUCCESS(Status)) {
+            goto SysSetAffinityEnd;
+        }
+    }
+
+    switch (Parameters->TargetType) {
+    case PriorityTargetThread:
+        if (Parameters->TargetId == -1) {
+            Thread = CurrentThread;
+            ObAddReference(Thread);
+
+        } else {
+            Thread = PspGetThreadById(CurrentProcess, Parameters->TargetId);
+        }
+
+        if (Thread == NULL) {
+            Status = STATUS_NO_SUCH_THREAD;
+            goto SysSetAffinityEnd;
+        }
+
+        if (Parameters->Set != FALSE) {
+            Status = KeSetThreadAffinity(Thread, &Affinity);
+
+        } else {
+            RtlCopyMemory(&Affinity,
+                          &(Thread->Affinity),
+                          sizeof(PROCESSOR_AFFINITY));
+
+            Status = STATUS_SUCCESS;
+        }
+
+        ObReleaseReference(Thread);
+        break;
+
+    case PriorityTargetProcess:
+        if ((Parameters->TargetId == -1) ||
+            (Parameters->TargetId == CurrentProcess->Identifiers.ProcessId)) {
+
+            Process = CurrentProcess;
+            ObAddReference(Process);
+
+        } else {
+            Process = PspGetProcessById(Parameters->TargetId);
+            if (Process == NULL) {
+                Status = STATUS_NO_SUCH_PROCESS;
+                goto SysSetAffinityEnd;
+            }
+
+            if (Process == PsGetKernelProcess()) {
+                ObReleaseReference(Process);
+                Status = STATUS_ACCESS_DENIED;
+                goto SysSetAffinityEnd;
+            }
+        }
+
+        Status = PspSetProcessAffinity(Process, Parameters->Set, &Affinity);
+        ObReleaseReference(Process);
+        break;
+
+    default:
+        Status = STATUS_INVALID_PARAMETER;
+        goto SysSetAffinityEnd;
+    }
+
+    if ((KSUCCESS(Status)) && (Parameters->Set == FALSE)) {
+        Status = MmCopyToUserMode(Parameters->Mask, &Affinity, CopySize);
+    }
+
+SysSetAffinityEnd:
+    return Status;
+}
+
 VOID
 PsQueueThreadCleanup (
     PKTHREAD Thread
@@ -1485,6 +1830,7 @@ Return Value:
     PKTHREAD CurrentThread;
     ULONG NameLength;
     PKTHREAD NewThread;
+    LONG NiceValue;
     ULONG ObjectFlags;
     KSTATUS Status;
     BOOL UserMode;
@@ -1557,6 +1903,31 @@ Return Value:
     NewThread->SignalPending = ThreadNoSignalPending;
     NewThread->SchedulerEntry.Type = SchedulerEntryThread;
     NewThread->SchedulerEntry.Parent = CurrentThread->SchedulerEntry.Parent;
+
+    //
+    // User mode threads inherit the nice value and processor affinity of
+    // their creator. Kernel threads always start at the default and can run
+    // anywhere. A priority the creator inherited through a user lock is not
+    // passed on.
+    //
+
+    if (UserMode != FALSE) {
+        NiceValue = CurrentThread->SchedulerEntry.NiceValue;
+        if (CurrentThread->PriorityBoosted != FALSE) {
+            NiceValue = CurrentThread->BaseNiceValue;
+        }
+
+        KeSetThreadNiceValue(NewThread, NiceValue);
+
+        RtlCopyMemory(&(NewThread->Affinity),
+                      &(CurrentThread->Affinity),
+                      sizeof(PROCESSOR_AFFINITY));
+
+    } else {
+        KeSetThreadNiceValue(NewThread, SCHEDULER_NICE_DEFAULT);
+        PROCESSOR_AFFINITY_SET_ALL(&(NewThread->Affinity));
+    }
+
     NewThread->ThreadPointer = PsInitialThreadPointer;
 
     //
@@ -2128,3 +2499,243 @@ Return Value:
     return Status;
 }
 
+BOOL
+PspSetPriorityIterator (
+    PVOID Context,
+    PKPROCESS Process
+    )
+
+/*++
+
+Routine Description:
+
+    This routine describes the iteration callback used to get or set the nice
+    value of each process in a process group or belonging to a user.
+
+Arguments:
+
+    Context - Supplies a pointer's worth of context passed into the iterate
+        routine. This is a set priority iterator context.
+
+    Process - Supplies the process to examine.
+
+Return Value:
+
+    FALSE always to indicate the iteration should continue.
+
+--*/
+
+{
+
+    PSET_PRIORITY_ITERATOR_CONTEXT Iterator;
+    KSTATUS Status;
+
+    Iterator = Context;
+    if (Process == PsGetKernelProcess()) {
+        return FALSE;
+    }
+
+    //
+    // Processes that are on their way out are skipped silently.
+    //
+
+    Status = PspSetProcessPriority(Iterator, Process);
+    if ((!KSUCCESS(Status)) &&
+        (Status != STATUS_NO_SUCH_PROCESS) &&
+        (KSUCCESS(Iterator->Status))) {
+
+        Iterator->Status = Status;
+    }
+
+    return FALSE;
+}
+
+KSTATUS
+PspSetProcessPriority (
+    PSET_PRIORITY_ITERATOR_CONTEXT Context,
+    PKPROCESS Process
+    )
+
+/*++
+
+Routine Description:
+
+    This routine gets or sets the nice value of every thread in the given
+    process. Setting the nice value of another user's process, or lowering a
+    nice value, requires the scheduling permission.
+
+Arguments:
+
+    Context - Supplies a pointer to the set priority context. The lowest nice
+        value and match count are updated on success.
+
+    Process - Supplies a pointer to the process to operate on.
+
+Return Value:
+
+    STATUS_SUCCESS if the process was operated on or did not match the user.
+
+    STATUS_NO_SUCH_PROCESS if the process has no threads left.
+
+    STATUS_PERMISSION_DENIED if the caller is not allowed to change the
+    process' nice value.
+
+--*/
+
+{
+
+    PLIST_ENTRY CurrentEntry;
+    PTHREAD_IDENTITY CurrentIdentity;
+    THREAD_IDENTITY Identity;
+    LONG Lowest;
+    KSTATUS Status;
+    PKTHREAD Thread;
+
+    Status = PspGetProcessIdentity(Process, &Identity);
+    if (!KSUCCESS(Status)) {
+        return Status;
+    }
+
+    if ((Context->MatchUser != FALSE) &&
+        (Identity.RealUserId != Context->UserId)) {
+
+        return STATUS_SUCCESS;
+    }
+
+    Lowest = SCHEDULER_NICE_MAXIMUM;
+    KeAcquireQueuedLock(Process->QueuedLock);
+    CurrentEntry = Process->ThreadListHead.Next;
+    while (CurrentEntry != &(Process->ThreadListHead)) {
+        Thread = LIST_VALUE(CurrentEntry, KTHREAD, ProcessEntry);
+        CurrentEntry = CurrentEntry->Next;
+        if (Thread->SchedulerEntry.NiceValue < Lowest) {
+            Lowest = Thread->SchedulerEntry.NiceValue;
+        }
+    }
+
+    KeReleaseQueuedLock(Process->QueuedLock);
+    Context->MatchCount += 1;
+    if ((Context->MatchCount == 1) || (Lowest < Context->PreviousNiceValue)) {
+        Context->PreviousNiceValue = Lowest;
+    }
+
+    if (Context->Set == FALSE) {
+        return STATUS_SUCCESS;
+    }
+
+    CurrentIdentity = &(Context->CurrentThread->Identity);
+    if (((CurrentIdentity->EffectiveUserId != Identity.RealUserId) &&
+         (CurrentIdentity->EffectiveUserId != Identity.EffectiveUserId)) ||
+        (Context->NiceValue < Lowest)) {
+
+        Status = PsCheckPermission(PERMISSION_SCHEDULING);
+        if (!KSUCCESS(Status)) {
+            return Status;
+        }
+    }
+
+    KeAcquireQueuedLock(Process->QueuedLock);
+    CurrentEntry = Process->ThreadListHead.Next;
+    while (CurrentEntry != &(Process->ThreadListHead)) {
+        Thread = LIST_VALUE(CurrentEntry, KTHREAD, ProcessEntry);
+        CurrentEntry = CurrentEntry->Next;
+        PspSetThreadBaseNiceValue(Thread, Context->NiceValue);
+    }
+
+    KeReleaseQueuedLock(Process->QueuedLock);
+    return STATUS_SUCCESS;
+}
+
+KSTATUS
+PspSetProcessAffinity (
+    PKPROCESS Process,
+    BOOL Set,
+    PPROCESSOR_AFFINITY Affinity
+    )
+
+/*++
+
+Routine Description:
+
+    This routine gets or sets the processor affinity of every thread in the
+    given process. Setting the affinity of another user's process requires
+    the scheduling permission.
+
+Arguments:
+
+    Process - Supplies a pointer to the process to operate on.
+
+    Set - Supplies a boolean indicating whether to get the affinity (FALSE) or
+        set it (TRUE).
+
+    Affinity - Supplies a pointer to the new affinity for set operations. For
+        get operations, this returns the union of the affinities of all
+        threads in the process.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_NO_SUCH_PROCESS if the process has no threads left.
+
+    STATUS_PERMISSION_DENIED if the caller is not allowed to change the
+    process' affinity.
+
+    STATUS_INVALID_PARAMETER if the new mask contains no active processors.
+
+--*/
+
+{
+
+    PLIST_ENTRY CurrentEntry;
+    PTHREAD_IDENTITY CurrentIdentity;
+    THREAD_IDENTITY Identity;
+    KSTATUS Status;
+    PKTHREAD Thread;
+    ULONG Word;
+
+    Status = PspGetProcessIdentity(Process, &Identity);
+    if (!KSUCCESS(Status)) {
+        return Status;
+    }
+
+    if (Set == FALSE) {
+        KeAcquireQueuedLock(Process->QueuedLock);
+        CurrentEntry = Process->ThreadListHead.Next;
+        while (CurrentEntry != &(Process->ThreadListHead)) {
+            Thread = LIST_VALUE(CurrentEntry, KTHREAD, ProcessEntry);
+            CurrentEntry = CurrentEntry->Next;
+            for (Word = 0; Word < PROCESSOR_AFFINITY_WORDS; Word += 1) {
+                Affinity->Mask[Word] |= Thread->Affinity.Mask[Word];
+            }
+        }
+
+        KeReleaseQueuedLock(Process->QueuedLock);
+        return STATUS_SUCCESS;
+    }
+
+    CurrentIdentity = &(KeGetCurrentThread()->Identity);
+    if ((CurrentIdentity->EffectiveUserId != Identity.RealUserId) &&
+        (CurrentIdentity->EffectiveUserId != Identity.EffectiveUserId)) {
+
+        Status = PsCheckPermission(PERMISSION_SCHEDULING);
+        if (!KSUCCESS(Status)) {
+            return Status;
+        }
+    }
+
+    KeAcquireQueuedLock(Process->QueuedLock);
+    CurrentEntry = Process->ThreadListHead.Next;
+    while (CurrentEntry != &(Process->ThreadListHead)) {
+        Thread = LIST_VALUE(CurrentEntry, KTHREAD, ProcessEntry);
+        CurrentEntry = CurrentEntry->Next;
+        Status = KeSetThreadAffinity(Thread, Affinity);
+        if (!KSUCCESS(Status)) {
+            break;
+        }
+    }
+
+    KeReleaseQueuedLock(Process->QueuedLock);
+    return Status;
+}
+
@@ -36,6 +36,21 @@ Module Name:
 // ---------------------------------------------------------------- Definitions
 //
 
+//
+// Define the number of hash buckets waiting user locks are spread across.
+// This must be a power of two.
+//
+
+#define USER_LOCK_HASH_BITS 8
+#define USER_LOCK_BUCKET_COUNT (1 << USER_LOCK_HASH_BITS)
+
+//
+// Define the multiplier used to scatter lock keys across the buckets. This is
+// the 32-bit golden ratio.
+//
+
+#define USER_LOCK_HASH_MULTIPLIER 0x9E3779B1
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -51,14 +66,11 @@ typedef enum _USER_LOCK_TYPE {
 
 Structure Description:
 
-    This structure defines a user mode lock, which is basically just a wait
-    queue that can be looked up.
+    This structure defines the identity of a user mode lock, which is the
+    object backing the lock's memory and the offset of the lock within it.
 
 Members:
 
-    TreeNode - Stores the accounting structure for keeping the entry in a
-        Red-Black tree.
-
     Object - Stores a pointer to the object this lock is tied to. This is a
         process for a process local lock, an image section for a lock in a
         private memory region, or a file object in a shared memory region.
@@ -67,19 +79,73 @@ Structure Description:
         into the image section, or 3) the user mode address in the process
         address space, depending on the type of lock.
 
-    ReferenceCount - Stores the reference count of the object.
-
     Type - Stores the object type, used when trying to release the lock.
 
-    WaitQueue - Stores the wait queue itself.
-
 --*/
 
-typedef struct _USER_LOCK {
-    RED_BLACK_TREE_NODE TreeNode;
+typedef struct _USER_LOCK_KEY {
     PVOID Object;
     UINTN Offset;
     USER_LOCK_TYPE Type;
+} USER_LOCK_KEY, *PUSER_LOCK_KEY;
+
+/*++
+
+Structure Description:
+
+    This structure defines a bucket in the user lock hash table.
+
+Members:
+
+    Lock - Stores a pointer to the lock protecting the bucket. This is a
+        queued lock because user memory is accessed (and may fault) while it
+        is held.
+
+    WaiterList - Stores the head of the list of threads waiting on any of the
+        locks that hash to this bucket, in the order they arrived.
+
+--*/
+
+typedef struct _USER_LOCK_BUCKET {
+    PQUEUED_LOCK Lock;
+    LIST_ENTRY WaiterList;
+} USER_LOCK_BUCKET, *PUSER_LOCK_BUCKET;
+
+/*++
+
+Structure Description:
+
+    This structure defines a thread waiting on a user mode lock, which is
+    basically just a wait queue that can be looked up.
+
+Members:
+
+    ListEntry - Stores pointers to the next and previous waiters in the
+        bucket. The next pointer is set to NULL once the waiter is off the
+        list.
+
+    Key - Stores the identity of the lock being waited on. This changes if
+        the waiter is requeued onto another lock.
+
+    Bucket - Stores a pointer to the bucket the waiter is currently queued
+        in. This is only changed with the bucket lock held.
+
+    Thread - Stores a pointer to the waiting thread.
+
+    PriorityInheritance - Stores a boolean indicating whether this is a waiter
+        on a priority inheritance lock, which is handed ownership directly
+        when the lock is released.
+
+    WaitQueue - Stores the wait queue itself.
+
+--*/
+
+typedef struct _USER_LOCK {
+    LIST_ENTRY ListEntry;
+    USER_LOCK_KEY Key;
+    PUSER_LOCK_BUCKET volatile Bucket;
+    PKTHREAD Thread;
+    BOOL PriorityInheritance;
     WAIT_QUEUE WaitQueue;
 } USER_LOCK, *PUSER_LOCK;
 
@@ -93,35 +159,149 @@ PspUserLockWait (
     );
 
 KSTATUS
-PspUserLockWake (
+PspUserLockRequeue (
     PSYSTEM_CALL_USER_LOCK Parameters
     );
 
 KSTATUS
-PspInitializeUserLock (
-    PVOID Address,
-    BOOL Private,
+PspUserLockWakeOperation (
+    PSYSTEM_CALL_USER_LOCK Parameters
+    );
+
+KSTATUS
+PspUserLockPiLock (
+    PSYSTEM_CALL_USER_LOCK Parameters
+    );
+
+KSTATUS
+PspUserLockPiUnlock (
+    PSYSTEM_CALL_USER_LOCK Parameters
+    );
+
+VOID
+PspInitializeUserLockWaiter (
+    PUSER_LOCK Lock,
+    BOOL PriorityInheritance
+    );
+
+KSTATUS
+PspWaitOnUserLock (
+    PUSER_LOCK Lock,
+    PSYSTEM_CALL_USER_LOCK Parameters
+    );
+
+BOOL
+PspDequeueUserLockWaiter (
     PUSER_LOCK Lock
     );
 
+ULONG
+PspWakeUserLockWaiters (
+    PUSER_LOCK_BUCKET Bucket,
+    PUSER_LOCK_KEY Key,
+    ULONG Count
+    );
+
 VOID
-PspReleaseUserLockObject (
+PspSignalUserLockWaiter (
     PUSER_LOCK Lock
     );
 
-COMPARISON_RESULT
-PspCompareUserLocks (
-    PRED_BLACK_TREE Tree,
-    PRED_BLACK_TREE_NODE FirstNode,
-    PRED_BLACK_TREE_NODE SecondNode
+PUSER_LOCK
+PspFindUserLockWaiter (
+    PUSER_LOCK_BUCKET Bucket,
+    PUSER_LOCK_KEY Key,
+    PLIST_ENTRY StartEntry
+    );
+
+KSTATUS
+PspPerformUserLockWakeOperation (
+    PULONG Address,
+    ULONG Operation,
+    PULONG OriginalValue
+    );
+
+BOOL
+PspEvaluateUserLockWakeComparison (
+    ULONG Value,
+    ULONG Operation
+    );
+
+VOID
+PspBoostUserLockOwner (
+    PUSER_LOCK_KEY Key,
+    ULONG LockValue,
+    LONG NiceValue
+    );
+
+VOID
+PspBoostThreadPriority (
+    PKTHREAD Thread,
+    LONG NiceValue
+    );
+
+VOID
+PspRestoreThreadPriority (
+    PKTHREAD Thread
+    );
+
+PUSER_LOCK_BUCKET
+PspGetUserLockBucket (
+    PUSER_LOCK_KEY Key
+    );
+
+VOID
+PspAcquireUserLockBuckets (
+    PUSER_LOCK_BUCKET FirstBucket,
+    PUSER_LOCK_BUCKET SecondBucket
+    );
+
+VOID
+PspReleaseUserLockBuckets (
+    PUSER_LOCK_BUCKET FirstBucket,
+    PUSER_LOCK_BUCKET SecondBucket
+    );
+
+KSTATUS
+PspInitializeUserLockKey (
+    PVOID Address,
+    BOOL Private,
+    PUSER_LOCK_KEY Key
+    );
+
+VOID
+PspAddUserLockKeyReference (
+    PUSER_LOCK_KEY Key
+    );
+
+VOID
+PspReleaseUserLockKey (
+    PUSER_LOCK_KEY Key
+    );
+
+BOOL
+PspAreUserLockKeysEqual (
+    PUSER_LOCK_KEY FirstKey,
+    PUSER_LOCK_KEY SecondKey
     );
 
 //
 // -------------------------------------------------------------------- Globals
 //
 
-PQUEUED_LOCK PsUserLockLock;
-RED_BLACK_TREE PsUserLockTree;
+//
+// Store the user lock hash table. Each bucket has its own lock, so unrelated
+// user locks do not contend with each other in the kernel.
+//
+
+PUSER_LOCK_BUCKET PsUserLockBuckets;
+
+//
+// Store the lock that serializes changes to the priority boost of threads
+// that own priority inheritance user locks.
+//
+
+PQUEUED_LOCK PsUserLockBoostLock;
 
 //
 // ------------------------------------------------------------------ Functions
@@ -169,6 +349,22 @@ Return Value:
         Status = PspUserLockWake(Parameters);
         break;
 
+    case UserLockRequeue:
+        Status = PspUserLockRequeue(Parameters);
+        break;
+
+    case UserLockWakeOperation:
+        Status = PspUserLockWakeOperation(Parameters);
+        break;
+
+    case UserLockPiLock:
+        Status = PspUserLockPiLock(Parameters);
+        break;
+
+    case UserLockPiUnlock:
+        Status = PspUserLockPiUnlock(Parameters);
+        break;
+
     default:
         Status = STATUS_INVALID_PARAMETER;
         break;
@@ -177,7 +373,7 @@ Return Value:
     return Status;
 }
 
-VOID
+KSTATUS
 PspInitializeUserLocking (
     VOID
     )
@@ -194,18 +390,38 @@ Routine Description:
 
 Return Value:
 
-    None.
+    Status code.
 
 --*/
 
 {
 
-    PsUserLockLock = KeCreateQueuedLock();
+    PUSER_LOCK_BUCKET Bucket;
+    ULONG Index;
 
-    ASSERT(PsUserLockLock != NULL);
+    PsUserLockBoostLock = KeCreateQueuedLock();
+    if (PsUserLockBoostLock == NULL) {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
 
-    RtlRedBlackTreeInitialize(&PsUserLockTree, 0, PspCompareUserLocks);
-    return;
+    PsUserLockBuckets = MmAllocateNonPagedPool(
+                              sizeof(USER_LOCK_BUCKET) * USER_LOCK_BUCKET_COUNT,
+                              PS_ALLOCATION_TAG);
+
+    if (PsUserLockBuckets == NULL) {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    for (Index = 0; Index < USER_LOCK_BUCKET_COUNT; Index += 1) {
+        Bucket = &(PsUserLockBuckets[Index]);
+        INITIALIZE_LIST_HEAD(&(Bucket->WaiterList));
+        Bucket->Lock = KeCreateQueuedLock();
+        if (Bucket->Lock == NULL) {
+            return STATUS_INSUFFICIENT_RESOURCES;
+        }
+    }
+
+    return STATUS_SUCCESS;
 }
 
 KSTATUS
@@ -231,9 +447,8 @@ Return Value:
 
 {
 
-    PUSER_LOCK FoundLock;
-    PRED_BLACK_TREE_NODE FoundNode;
-    USER_LOCK Lock;
+    PUSER_LOCK_BUCKET Bucket;
+    USER_LOCK_KEY Key;
     BOOL Private;
     ULONG ProcessesReleased;
     KSTATUS Status;
@@ -243,7 +458,7 @@ Return Value:
         Private = TRUE;
     }
 
-    Status = PspInitializeUserLock(Parameters->Address, Private, &Lock);
+    Status = PspInitializeUserLockKey(Parameters->Address, Private, &Key);
     if (!KSUCCESS(Status)) {
         return Status;
     }
@@ -252,40 +467,60 @@ Return Value:
     // Release the specified number of processes.
     //
 
-    ProcessesReleased = 0;
-    KeAcquireQueuedLock(PsUserLockLock);
-    while (Parameters->Value != 0) {
-        FoundNode = RtlRedBlackTreeSearch(&PsUserLockTree, &(Lock.TreeNode));
-        if (FoundNode == NULL) {
-            break;
-        }
+    Bucket = PspGetUserLockBucket(&Key);
+    KeAcquireQueuedLock(Bucket->Lock);
+    ProcessesReleased = PspWakeUserLockWaiters(Bucket,
+                                               &Key,
+                                               Parameters->Value);
 
-        //
-        // Remove it from the tree first. The locks are stack allocated, so as
-        // soon as the thread is made ready the memory could go invalid.
-        //
+    KeReleaseQueuedLock(Bucket->Lock);
+    PspReleaseUserLockKey(&Key);
+    Parameters->Value = ProcessesReleased;
+    return STATUS_SUCCESS;
+}
 
-        FoundLock = RED_BLACK_TREE_VALUE(FoundNode, USER_LOCK, TreeNode);
-        RtlRedBlackTreeRemove(&PsUserLockTree, FoundNode);
-        ObSignalQueue(&(FoundLock->WaitQueue), SignalOptionSignalAll);
+VOID
+PspSetThreadBaseNiceValue (
+    PKTHREAD Thread,
+    LONG NiceValue
+    )
 
-        //
-        // The object can go away as soon as it's known to be removed from the
-        // tree. Make sure this thread is done touching the object before
-        // indicating to the woken thread that it can destroy this memory.
-        //
+/*++
+
+Routine Description:
 
-        FoundNode->Parent = NULL;
-        ProcessesReleased += 1;
-        if (Parameters->Value != MAX_ULONG) {
-            Parameters->Value -= 1;
+    This routine sets the nice value of a thread on behalf of user mode. If the
+    thread is currently running at a priority inherited through a user lock,
+    the new value is recorded as the one to return to once the boost ends, and
+    only takes effect now if it is less nice than the boost.
+
+Arguments:
+
+    Thread - Supplies a pointer to the thread to modify.
+
+    NiceValue - Supplies the new nice value.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    KeAcquireQueuedLock(PsUserLockBoostLock);
+    if (Thread->PriorityBoosted != FALSE) {
+        Thread->BaseNiceValue = NiceValue;
+        if (NiceValue < Thread->SchedulerEntry.NiceValue) {
+            KeSetThreadNiceValue(Thread, NiceValue);
         }
+
+    } else {
+        KeSetThreadNiceValue(Thread, NiceValue);
     }
 
-    KeReleaseQueuedLock(PsUserLockLock);
-    PspReleaseUserLockObject(&Lock);
-    Parameters->Value = ProcessesReleased;
-    return STATUS_SUCCESS;
+    KeReleaseQueuedLock(PsUserLockBoostLock);
+    return;
 }
 
 //
@@ -315,12 +550,9 @@ Return Value:
 
 {
 
-    ULONGLONG ElapsedTimeInMilliseconds;
-    ULONGLONG EndTime;
-    ULONGLONG Frequency;
+    PUSER_LOCK_BUCKET Bucket;
     USER_LOCK Lock;
     BOOL Private;
-    ULONGLONG StartTime;
     KSTATUS Status;
     ULONG UserValue;
 
@@ -329,13 +561,17 @@ Return Value:
         Private = TRUE;
     }
 
-    Status = PspInitializeUserLock(Parameters->Address, Private, &Lock);
+    Status = PspInitializeUserLockKey(Parameters->Address,
+                                      Private,
+                                      &(Lock.Key));
+
     if (!KSUCCESS(Status)) {
         return Status;
     }
 
-    ObInitializeWaitQueue(&(Lock.WaitQueue), NotSignaled);
-    KeAcquireQueuedLock(PsUserLockLock);
+    PspInitializeUserLockWaiter(&Lock, FALSE);
+    Bucket = PspGetUserLockBucket(&(Lock.Key));
+    KeAcquireQueuedLock(Bucket->Lock);
 
     //
     // If the read failed, then bail out.
@@ -360,146 +596,1358 @@ Return Value:
 
         } else {
             Status = STATUS_SUCCESS;
-            RtlRedBlackTreeInsert(&PsUserLockTree, &(Lock.TreeNode));
+            Lock.Bucket = Bucket;
+            INSERT_BEFORE(&(Lock.ListEntry), &(Bucket->WaiterList));
         }
     }
 
-    KeReleaseQueuedLock(PsUserLockLock);
+    KeReleaseQueuedLock(Bucket->Lock);
     if (!KSUCCESS(Status)) {
         goto UserLockWaitEnd;
     }
 
-    //
-    // Wait for somebody to wake this thread (or a signal, or a timeout).
-    //
-
-    ASSERT(SYS_WAIT_TIME_INDEFINITE == WAIT_TIME_INDEFINITE);
-
-    StartTime = 0;
-    if (Parameters->TimeoutInMilliseconds != SYS_WAIT_TIME_INDEFINITE) {
-        StartTime = KeGetRecentTimeCounter();
-    }
-
-    Status = ObWaitOnQueue(&(Lock.WaitQueue),
-                           WAIT_FLAG_INTERRUPTIBLE,
-                           Parameters->TimeoutInMilliseconds);
-
-    //
-    // If a user lock wait is interrupted by a signal, allow it to restart
-    // after the signal is applied if the handler allows restarts. Update the
-    // timeout, so the next round doesn't wait too long.
-    //
-
-    if (Status == STATUS_INTERRUPTED) {
-        if (Parameters->TimeoutInMilliseconds != SYS_WAIT_TIME_INDEFINITE) {
-            EndTime = KeGetRecentTimeCounter();
-            Frequency = HlQueryTimeCounterFrequency();
-            ElapsedTimeInMilliseconds = ((EndTime - StartTime) *
-                                         MILLISECONDS_PER_SECOND) /
-                                        Frequency;
-
-            if (ElapsedTimeInMilliseconds < Parameters->TimeoutInMilliseconds) {
-                Parameters->TimeoutInMilliseconds -= ElapsedTimeInMilliseconds;
-
-            } else {
-                Parameters->TimeoutInMilliseconds = 0;
-            }
-        }
+    Status = PspWaitOnUserLock(&Lock, Parameters);
 
-        Status = STATUS_RESTART_AFTER_SIGNAL;
-    }
+UserLockWaitEnd:
 
     //
-    // Remove the object from the tree, racing with the parent who may
-    // have already done it to save the extra lock acquire.
+    // Release the key the lock ended up on, which may not be the original one
+    // if the waiter was requeued.
     //
 
-    if (Lock.TreeNode.Parent != NULL) {
-        KeAcquireQueuedLock(PsUserLockLock);
-        if (Lock.TreeNode.Parent != NULL) {
-            RtlRedBlackTreeRemove(&PsUserLockTree, &(Lock.TreeNode));
-            Lock.TreeNode.Parent = NULL;
-        }
-
-        KeReleaseQueuedLock(PsUserLockLock);
-    }
-
-UserLockWaitEnd:
-    PspReleaseUserLockObject(&Lock);
+    PspReleaseUserLockKey(&(Lock.Key));
     return Status;
 }
 
 KSTATUS
-PspInitializeUserLock (
-    PVOID Address,
-    BOOL Private,
-    PUSER_LOCK Lock
+PspUserLockRequeue (
+    PSYSTEM_CALL_USER_LOCK Parameters
     )
 
 /*++
 
 Routine Description:
 
-    This routine initializes the user lock state.
+    This routine wakes some of the threads blocked on the first address and
+    moves the rest onto the second address without waking them. This lets a
+    condition variable broadcast hand its waiters to the mutex one at a time
+    rather than waking them all to fight over it.
 
 Arguments:
 
-    Address - Supplies a pointer to the usermode address to contend on.
+    Parameters - Supplies a pointer to the requeue parameters.
 
-    Private - Supplies a boolean indicating whether or not the lock is
-        private to the process (TRUE) or potentially shared between multiple
-        processes (FALSE).
+Return Value:
 
-    Lock - Supplies a pointer where the initialized lock structure will be
-        returned on success.
+    STATUS_SUCCESS on success.
 
-Return Value:
+    STATUS_TRY_AGAIN if the first address no longer contains the expected
+    value.
 
-    Status code.
+    Other error codes on failure.
 
 --*/
 
 {
 
-    BOOL Shared;
+    PUSER_LOCK_BUCKET Bucket;
+    PLIST_ENTRY CurrentEntry;
+    USER_LOCK_KEY Key;
+    BOOL Private;
+    ULONG Requeued;
+    USER_LOCK_KEY SecondKey;
+    PUSER_LOCK_BUCKET SecondBucket;
+    KSTATUS Status;
+    ULONG UserValue;
+    PUSER_LOCK Waiter;
+    ULONG Woken;
 
-    if (Private != FALSE) {
-        Lock->Object = PsGetCurrentProcess();
-        Lock->Offset = (UINTN)Address;
-        Lock->Type = UserLockTypeProcess;
+    Private = FALSE;
+    if ((Parameters->Operation & USER_LOCK_PRIVATE) != 0) {
+        Private = TRUE;
+    }
 
-    } else {
-        Lock->Object = MmGetObjectForAddress(Address, &(Lock->Offset), &Shared);
-        if (Lock->Object == NULL) {
-            return STATUS_ACCESS_VIOLATION;
-        }
+    Requeued = 0;
+    Woken = 0;
+    Status = PspInitializeUserLockKey(Parameters->Address, Private, &Key);
+    if (!KSUCCESS(Status)) {
+        return Status;
+    }
 
-        if (Shared != FALSE) {
-            Lock->Type = UserLockTypeFileObject;
+    Status = PspInitializeUserLockKey(Parameters->SecondAddress,
+                                      Private,
+                                      &SecondKey);
 
-        } else {
-            Lock->Type = UserLockTypeImageSection;
-        }
+    if (!KSUCCESS(Status)) {
+        PspReleaseUserLockKey(&Key);
+        return Status;
     }
 
-    return STATUS_SUCCESS;
-}
+    Bucket = PspGetUserLockBucket(&Key);
+    SecondBucket = PspGetUserLockBucket(&SecondKey);
+    PspAcquireUserLockBuckets(Bucket, SecondBucket);
+    if (MmUserRead32(Parameters->Address, &UserValue) == FALSE) {
+        Status = STATUS_ACCESS_VIOLATION;
+        goto UserLockRequeueEnd;
+    }
 
-VOID
-PspReleaseUserLockObject (
-    PUSER_LOCK Lock
-    )
+    if (UserValue != Parameters->Argument) {
+        Status = STATUS_TRY_AGAIN;
+        goto UserLockRequeueEnd;
+    }
 
-/*++
+    CurrentEntry = Bucket->WaiterList.Next;
+    while (CurrentEntry != &(Bucket->WaiterList)) {
+        Waiter = LIST_VALUE(CurrentEntry, USER_LOCK, ListEntry);
+        CurrentEntry = CurrentEntry->Next;
+        if ((Waiter->PriorityInheritance != FALSE) ||
+            (PspAreUserLockKeysEqual(&(Waiter->Key), &Key) == FALSE)) {
 
-Routine Description:
+            continue;
+        }
 
-    This routine releases the reference on a user lock backing object, which
-    is either a process, image section, or file object.
+        if (Woken < Parameters->Value) {
+            PspSignalUserLockWaiter(Waiter);
+            Woken += 1;
+            continue;
+        }
+
+        if (Requeued >= Parameters->SecondValue) {
+            break;
+        }
+
+        //
+        // Move the waiter over to the second lock. It takes its own reference
+        // on the new key, and the reference on the old key can be dropped
+        // since this thread holds one too.
+        //
+
+        PspAddUserLockKeyReference(&SecondKey);
+        PspReleaseUserLockKey(&(Waiter->Key));
+        Waiter->Key = SecondKey;
+        if (SecondBucket != Bucket) {
+            LIST_REMOVE(&(Waiter->ListEntry));
+            INSERT_BEFORE(&(Waiter->ListEntry), &(SecondBucket->WaiterList));
+            Waiter->Bucket = SecondBucket;
+        }
+
+        Requeued += 1;
+    }
+
+    Status = STATUS_SUCCESS;
+
+UserLockRequeueEnd:
+    PspReleaseUserLockBuckets(Bucket, SecondBucket);
+    PspReleaseUserLockKey(&SecondKey);
+    PspReleaseUserLockKey(&Key);
+    Parameters->Value = Woken;
+    Parameters->SecondValue = Requeued;
+    return Status;
+}
+
+KSTATUS
+PspUserLockWakeOperation (
+    PSYSTEM_CALL_USER_LOCK Parameters
+    )
+
+/*++
+
+Routine Description:
+
+    This routine atomically modifies the value at the second address, wakes
+    threads blocked on the first address, and then wakes threads blocked on
+    the second address if the original value at the second address passes
+    the encoded comparison. This lets user mode release one lock and signal
+    another with a single trip into the kernel.
+
+Arguments:
+
+    Parameters - Supplies a pointer to the wake parameters.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    PUSER_LOCK_BUCKET Bucket;
+    USER_LOCK_KEY Key;
+    ULONG OriginalValue;
+    BOOL Private;
+    PUSER_LOCK_BUCKET SecondBucket;
+    USER_LOCK_KEY SecondKey;
+    ULONG SecondWoken;
+    KSTATUS Status;
+    ULONG Woken;
+
+    Private = FALSE;
+    if ((Parameters->Operation & USER_LOCK_PRIVATE) != 0) {
+        Private = TRUE;
+    }
+
+    SecondWoken = 0;
+    Woken = 0;
+    Status = PspInitializeUserLockKey(Parameters->Address, Private, &Key);
+    if (!KSUCCESS(Status)) {
+        return Status;
+    }
+
+    Status = PspInitializeUserLockKey(Parameters->SecondAddress,
+                                      Private,
+                                      &SecondKey);
+
+    if (!KSUCCESS(Status)) {
+        PspReleaseUserLockKey(&Key);
+        return Status;
+    }
+
+    Bucket = PspGetUserLockBucket(&Key);
+    SecondBucket = PspGetUserLockBucket(&SecondKey);
+    PspAcquireUserLockBuckets(Bucket, SecondBucket);
+    Status = PspPerformUserLockWakeOperation(Parameters->SecondAddress,
+                                             Parameters->Argument,
+                                             &OriginalValue);
+
+    if (!KSUCCESS(Status)) {
+        goto UserLockWakeOperationEnd;
+    }
+
+    Woken = PspWakeUserLockWaiters(Bucket, &Key, Parameters->Value);
+    if (PspEvaluateUserLockWakeComparison(OriginalValue,
+                                          Parameters->Argument) != FALSE) {
+
+        SecondWoken = PspWakeUserLockWaiters(SecondBucket,
+                                             &SecondKey,
+                                             Parameters->SecondValue);
+    }
+
+UserLockWakeOperationEnd:
+    PspReleaseUserLockBuckets(Bucket, SecondBucket);
+    PspReleaseUserLockKey(&SecondKey);
+    PspReleaseUserLockKey(&Key);
+    Parameters->Value = Woken;
+    Parameters->SecondValue = SecondWoken;
+    return Status;
+}
+
+KSTATUS
+PspUserLockPiLock (
+    PSYSTEM_CALL_USER_LOCK Parameters
+    )
+
+/*++
+
+Routine Description:
+
+    This routine acquires a priority inheritance user lock, blocking if it is
+    owned by another thread. While blocked, the owner runs with at least the
+    priority of the waiting thread.
+
+Arguments:
+
+    Parameters - Supplies a pointer to the lock parameters.
+
+Return Value:
+
+    STATUS_SUCCESS if the lock was acquired.
+
+    STATUS_DEADLOCK if the calling thread already owns the lock.
+
+    STATUS_TIMEOUT if the lock could not be acquired in time.
+
+    Other error codes on failure.
+
+--*/
+
+{
+
+    PUSER_LOCK_BUCKET Bucket;
+    USER_LOCK Lock;
+    ULONG NewValue;
+    ULONG OriginalValue;
+    BOOL Private;
+    BOOL Queued;
+    KSTATUS Status;
+    PKTHREAD Thread;
+    ULONG UserValue;
+
+    Private = FALSE;
+    if ((Parameters->Operation & USER_LOCK_PRIVATE) != 0) {
+        Private = TRUE;
+    }
+
+    Queued = FALSE;
+    Thread = KeGetCurrentThread();
+    if ((Thread->ThreadId & ~USER_LOCK_PI_OWNER_MASK) != 0) {
+        return STATUS_NOT_SUPPORTED;
+    }
+
+    Status = PspInitializeUserLockKey(Parameters->Address,
+                                      Private,
+                                      &(Lock.Key));
+
+    if (!KSUCCESS(Status)) {
+        return Status;
+    }
+
+    PspInitializeUserLockWaiter(&Lock, TRUE);
+    Bucket = PspGetUserLockBucket(&(Lock.Key));
+    KeAcquireQueuedLock(Bucket->Lock);
+    while (TRUE) {
+        if (MmUserRead32(Parameters->Address, &UserValue) == FALSE) {
+            Status = STATUS_ACCESS_VIOLATION;
+            break;
+        }
+
+        //
+        // If the lock is free, take it. Keep the waiters bit set if anyone
+        // else is still queued so that this thread comes back in to hand it
+        // off.
+        //
+
+        if ((UserValue & USER_LOCK_PI_OWNER_MASK) == 0) {
+            NewValue = Thread->ThreadId;
+            if (PspFindUserLockWaiter(Bucket, &(Lock.Key), NULL) != NULL) {
+                NewValue |= USER_LOCK_PI_WAITERS;
+            }
+
+            if (MmUserCompareExchange32(Parameters->Address,
+                                        NewValue,
+                                        UserValue,
+                                        &OriginalValue) == FALSE) {
+
+                Status = STATUS_ACCESS_VIOLATION;
+                break;
+            }
+
+            if (OriginalValue != UserValue) {
+                continue;
+            }
+
+            Status = STATUS_SUCCESS;
+            break;
+        }
+
+        if ((UserValue & USER_LOCK_PI_OWNER_MASK) == Thread->ThreadId) {
+            Status = STATUS_DEADLOCK;
+            break;
+        }
+
+        //
+        // Set the waiters bit so that the owner's release comes into the
+        // kernel.
+        //
+
+        if ((UserValue & USER_LOCK_PI_WAITERS) == 0) {
+            if (MmUserCompareExchange32(Parameters->Address,
+                                        UserValue | USER_LOCK_PI_WAITERS,
+                                        UserValue,
+                                        &OriginalValue) == FALSE) {
+
+                Status = STATUS_ACCESS_VIOLATION;
+                break;
+            }
+
+            if (OriginalValue != UserValue) {
+                continue;
+            }
+        }
+
+        Lock.Bucket = Bucket;
+        INSERT_BEFORE(&(Lock.ListEntry), &(Bucket->WaiterList));
+        PspBoostUserLockOwner(&(Lock.Key),
+                              UserValue,
+                              Thread->SchedulerEntry.NiceValue);
+
+        Queued = TRUE;
+        break;
+    }
+
+    KeReleaseQueuedLock(Bucket->Lock);
+    if (Queued == FALSE) {
+        goto UserLockPiLockEnd;
+    }
+
+    //
+    // Ownership is handed directly to the waiter on release, so a successful
+    // wait means the lock is held.
+    //
+
+    Status = PspWaitOnUserLock(&Lock, Parameters);
+
+UserLockPiLockEnd:
+    PspReleaseUserLockKey(&(Lock.Key));
+    return Status;
+}
+
+KSTATUS
+PspUserLockPiUnlock (
+    PSYSTEM_CALL_USER_LOCK Parameters
+    )
+
+/*++
+
+Routine Description:
+
+    This routine releases a priority inheritance user lock owned by the
+    calling thread. If there are waiters, ownership is handed directly to the
+    first one, and any priority the caller inherited is dropped.
+
+Arguments:
+
+    Parameters - Supplies a pointer to the lock parameters.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_PERMISSION_DENIED if the calling thread does not own the lock.
+
+    Other error codes on failure.
+
+--*/
+
+{
+
+    PUSER_LOCK_BUCKET Bucket;
+    USER_LOCK_KEY Key;
+    PUSER_LOCK NextWaiter;
+    LONG NiceValue;
+    ULONG NewValue;
+    ULONG OriginalValue;
+    BOOL Private;
+    KSTATUS Status;
+    PKTHREAD Thread;
+    ULONG UserValue;
+    PUSER_LOCK Waiter;
+
+    Private = FALSE;
+    if ((Parameters->Operation & USER_LOCK_PRIVATE) != 0) {
+        Private = TRUE;
+    }
+
+    Thread = KeGetCurrentThread();
+    Status = PspInitializeUserLockKey(Parameters->Address, Private, &Key);
+    if (!KSUCCESS(Status)) {
+        return Status;
+    }
+
+    Bucket = PspGetUserLockBucket(&Key);
+    KeAcquireQueuedLock(Bucket->Lock);
+    while (TRUE) {
+        if (MmUserRead32(Parameters->Address, &UserValue) == FALSE) {
+            Status = STATUS_ACCESS_VIOLATION;
+            goto UserLockPiUnlockEnd;
+        }
+
+        if ((UserValue & USER_LOCK_PI_OWNER_MASK) != Thread->ThreadId) {
+            Status = STATUS_PERMISSION_DENIED;
+            goto UserLockPiUnlockEnd;
+        }
+
+        //
+        // Pass ownership to the first waiter, leaving the waiters bit set if
+        // there are more behind it.
+        //
+
+        NewValue = 0;
+        NextWaiter = NULL;
+        Waiter = PspFindUserLockWaiter(Bucket, &Key, NULL);
+        if (Waiter != NULL) {
+            NewValue = Waiter->Thread->ThreadId;
+            NextWaiter = PspFindUserLockWaiter(Bucket,
+                                               &Key,
+                                               &(Waiter->ListEntry));
+
+            if (NextWaiter != NULL) {
+                NewValue |= USER_LOCK_PI_WAITERS;
+            }
+        }
+
+        if (MmUserCompareExchange32(Parameters->Address,
+                                    NewValue,
+                                    UserValue,
+                                    &OriginalValue) == FALSE) {
+
+            Status = STATUS_ACCESS_VIOLATION;
+            goto UserLockPiUnlockEnd;
+        }
+
+        if (OriginalValue == UserValue) {
+            break;
+        }
+    }
+
+    if (Waiter != NULL) {
+
+        //
+        // The new owner inherits the priority of the best of the threads
+        // still waiting behind it.
+        //
+
+        if (NextWaiter != NULL) {
+            NiceValue = NextWaiter->Thread->SchedulerEntry.NiceValue;
+            while (NextWaiter != NULL) {
+                if (NextWaiter->Thread->SchedulerEntry.NiceValue < NiceValue) {
+                    NiceValue = NextWaiter->Thread->SchedulerEntry.NiceValue;
+                }
+
+                NextWaiter = PspFindUserLockWaiter(Bucket,
+                                                   &Key,
+                                                   &(NextWaiter->ListEntry));
+            }
+
+            PspBoostThreadPriority(Waiter->Thread, NiceValue);
+        }
+
+        PspSignalUserLockWaiter(Waiter);
+    }
+
+    Status = STATUS_SUCCESS;
+
+UserLockPiUnlockEnd:
+    KeReleaseQueuedLock(Bucket->Lock);
+    if (KSUCCESS(Status)) {
+        PspRestoreThreadPriority(Thread);
+    }
+
+    PspReleaseUserLockKey(&Key);
+    return Status;
+}
+
+VOID
+PspInitializeUserLockWaiter (
+    PUSER_LOCK Lock,
+    BOOL PriorityInheritance
+    )
+
+/*++
+
+Routine Description:
+
+    This routine initializes a user lock waiter for the current thread. The
+    key must already be filled in.
+
+Arguments:
+
+    Lock - Supplies a pointer to the waiter to initialize.
+
+    PriorityInheritance - Supplies a boolean indicating whether or not the
+        waiter is for a priority inheritance lock.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    Lock->ListEntry.Next = NULL;
+    Lock->Bucket = NULL;
+    Lock->Thread = KeGetCurrentThread();
+    Lock->PriorityInheritance = PriorityInheritance;
+    ObInitializeWaitQueue(&(Lock->WaitQueue), NotSignaled);
+    return;
+}
+
+KSTATUS
+PspWaitOnUserLock (
+    PUSER_LOCK Lock,
+    PSYSTEM_CALL_USER_LOCK Parameters
+    )
+
+/*++
+
+Routine Description:
+
+    This routine blocks on a user lock waiter that has already been queued,
+    and takes it back off the queue if nobody else did.
+
+Arguments:
+
+    Lock - Supplies a pointer to the queued waiter.
+
+    Parameters - Supplies a pointer to the system call parameters, whose
+        timeout is updated if the wait is interrupted.
+
+Return Value:
+
+    STATUS_SUCCESS if the waiter was woken.
+
+    STATUS_TIMEOUT if the wait timed out.
+
+    STATUS_RESTART_AFTER_SIGNAL if the wait was interrupted by a signal.
+
+--*/
+
+{
+
+    ULONGLONG ElapsedTimeInMilliseconds;
+    ULONGLONG EndTime;
+    ULONGLONG Frequency;
+    ULONGLONG StartTime;
+    KSTATUS Status;
+
+    //
+    // Wait for somebody to wake this thread (or a signal, or a timeout).
+    //
+
+    ASSERT(SYS_WAIT_TIME_INDEFINITE == WAIT_TIME_INDEFINITE);
+
+    StartTime = 0;
+    if (Parameters->TimeoutInMilliseconds != SYS_WAIT_TIME_INDEFINITE) {
+        StartTime = KeGetRecentTimeCounter();
+    }
+
+    Status = ObWaitOnQueue(&(Lock->WaitQueue),
+                           WAIT_FLAG_INTERRUPTIBLE,
+                           Parameters->TimeoutInMilliseconds);
+
+    //
+    // If a waker already pulled the waiter off the queue, the wake counts
+    // even if the wait itself timed out or was interrupted. Otherwise the
+    // wake would be lost, which matters for wakers that only wake one
+    // thread.
+    //
+
+    if (PspDequeueUserLockWaiter(Lock) == FALSE) {
+        return STATUS_SUCCESS;
+    }
+
+    //
+    // If a user lock wait is interrupted by a signal, allow it to restart
+    // after the signal is applied if the handler allows restarts. Update the
+    // timeout, so the next round doesn't wait too long.
+    //
+
+    if (Status == STATUS_INTERRUPTED) {
+        if (Parameters->TimeoutInMilliseconds != SYS_WAIT_TIME_INDEFINITE) {
+            EndTime = KeGetRecentTimeCounter();
+            Frequency = HlQueryTimeCounterFrequency();
+            ElapsedTimeInMilliseconds = ((EndTime - StartTime) *
+                                         MILLISECONDS_PER_SECOND) /
+                                        Frequency;
+
+            if (ElapsedTimeInMilliseconds < Parameters->TimeoutInMilliseconds) {
+                Parameters->TimeoutInMilliseconds -= ElapsedTimeInMilliseconds;
+
+            } else {
+                Parameters->TimeoutInMilliseconds = 0;
+            }
+        }
+
+        Status = STATUS_RESTART_AFTER_SIGNAL;
+    }
+
+    return Status;
+}
+
+BOOL
+PspDequeueUserLockWaiter (
+    PUSER_LOCK Lock
+    )
+
+/*++
+
+Routine Description:
+
+    This routine removes a waiter from its bucket, racing with wakers who may
+    have already done it. The waiter may also be moved between buckets by a
+    requeue while this routine runs.
+
+Arguments:
+
+    Lock - Supplies a pointer to the waiter to remove.
+
+Return Value:
+
+    TRUE if this routine removed the waiter.
+
+    FALSE if a waker had already removed it.
+
+--*/
+
+{
+
+    PUSER_LOCK_BUCKET Bucket;
+    BOOL Removed;
+
+    Removed = FALSE;
+    while (Lock->ListEntry.Next != NULL) {
+        Bucket = Lock->Bucket;
+        KeAcquireQueuedLock(Bucket->Lock);
+        if (Lock->Bucket != Bucket) {
+            KeReleaseQueuedLock(Bucket->Lock);
+            continue;
+        }
+
+        if (Lock->ListEntry.Next != NULL) {
+            LIST_REMOVE(&(Lock->ListEntry));
+            Lock->ListEntry.Next = NULL;
+            Removed = TRUE;
+        }
+
+        KeReleaseQueuedLock(Bucket->Lock);
+        break;
+    }
+
+    return Removed;
+}
+
+ULONG
+PspWakeUserLockWaiters (
+    PUSER_LOCK_BUCKET Bucket,
+    PUSER_LOCK_KEY Key,
+    ULONG Count
+    )
+
+/*++
+
+Routine Description:
+
+    This routine wakes threads waiting on the given user lock, oldest first.
+    Waiters on priority inheritance locks are skipped, since they can only be
+    woken by a release. The bucket lock must be held.
+
+Arguments:
+
+    Bucket - Supplies a pointer to the bucket the key hashes to.
+
+    Key - Supplies a pointer to the key of the lock to wake.
+
+    Count - Supplies the maximum number of threads to wake. Supply MAX_ULONG
+        to wake all of them.
+
+Return Value:
+
+    Returns the number of threads woken.
+
+--*/
+
+{
+
+    PLIST_ENTRY CurrentEntry;
+    PUSER_LOCK Waiter;
+    ULONG Woken;
+
+    Woken = 0;
+    CurrentEntry = Bucket->WaiterList.Next;
+    while ((Woken < Count) && (CurrentEntry != &(Bucket->WaiterList))) {
+        Waiter = LIST_VALUE(CurrentEntry, USER_LOCK, ListEntry);
+        CurrentEntry = CurrentEntry->Next;
+        if ((Waiter->PriorityInheritance == FALSE) &&
+            (PspAreUserLockKeysEqual(&(Waiter->Key), Key) != FALSE)) {
+
+            PspSignalUserLockWaiter(Waiter);
+            Woken += 1;
+        }
+    }
+
+    return Woken;
+}
+
+VOID
+PspSignalUserLockWaiter (
+    PUSER_LOCK Lock
+    )
+
+/*++
+
+Routine Description:
+
+    This routine removes a waiter from its bucket and wakes it. The bucket
+    lock must be held.
+
+Arguments:
+
+    Lock - Supplies a pointer to the waiter to wake.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    //
+    // Remove it from the list first. The waiters are stack allocated, so as
+    // soon as the thread is made ready the memory could go invalid.
+    //
+
+    LIST_REMOVE(&(Lock->ListEntry));
+    ObSignalQueue(&(Lock->WaitQueue), SignalOptionSignalAll);
+
+    //
+    // The waiter can go away as soon as it's known to be removed from the
+    // list. Make sure this thread is done touching the waiter before
+    // indicating to the woken thread that it can destroy this memory.
+    //
+
+    Lock->ListEntry.Next = NULL;
+    return;
+}
+
+PUSER_LOCK
+PspFindUserLockWaiter (
+    PUSER_LOCK_BUCKET Bucket,
+    PUSER_LOCK_KEY Key,
+    PLIST_ENTRY StartEntry
+    )
+
+/*++
+
+Routine Description:
+
+    This routine finds the next priority inheritance waiter on the given lock.
+    The bucket lock must be held.
+
+Arguments:
+
+    Bucket - Supplies a pointer to the bucket the key hashes to.
+
+    Key - Supplies a pointer to the key of the lock.
+
+    StartEntry - Supplies an optional pointer to the list entry to start
+        searching after. Supply NULL to start at the beginning of the bucket.
+
+Return Value:
+
+    Returns a pointer to the waiter on success.
+
+    NULL if there are no more waiters on the lock.
+
+--*/
+
+{
+
+    PLIST_ENTRY CurrentEntry;
+    PUSER_LOCK Waiter;
+
+    if (StartEntry == NULL) {
+        StartEntry = &(Bucket->WaiterList);
+    }
+
+    CurrentEntry = StartEntry->Next;
+    while (CurrentEntry != &(Bucket->WaiterList)) {
+        Waiter = LIST_VALUE(CurrentEntry, USER_LOCK, ListEntry);
+        if ((Waiter->PriorityInheritance != FALSE) &&
+            (PspAreUserLockKeysEqual(&(Waiter->Key), Key) != FALSE)) {
+
+            return Waiter;
+        }
+
+        CurrentEntry = CurrentEntry->Next;
+    }
+
+    return NULL;
+}
+
+KSTATUS
+PspPerformUserLockWakeOperation (
+    PULONG Address,
+    ULONG Operation,
+    PULONG OriginalValue
+    )
+
+/*++
+
+Routine Description:
+
+    This routine atomically applies the operation encoded in a wake operation
+    to the given user mode address.
+
+Arguments:
+
+    Address - Supplies the user mode address to modify.
+
+    Operation - Supplies the encoded wake operation.
+
+    OriginalValue - Supplies a pointer where the value at the address before
+        the operation will be returned.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_INVALID_PARAMETER if the operation is not valid.
+
+    STATUS_ACCESS_VIOLATION if the address could not be accessed.
+
+--*/
+
+{
+
+    ULONG Argument;
+    ULONG NewValue;
+    ULONG Value;
+
+    Argument = (Operation >> USER_LOCK_WAKE_OPERATION_ARGUMENT_SHIFT) &
+               USER_LOCK_WAKE_ARGUMENT_MASK;
+
+    if (MmUserRead32(Address, &Value) == FALSE) {
+        return STATUS_ACCESS_VIOLATION;
+    }
+
+    while (TRUE) {
+        switch (Operation >> USER_LOCK_WAKE_OPERATION_SHIFT) {
+        case USER_LOCK_WAKE_OPERATION_SET:
+            NewValue = Argument;
+            break;
+
+        case USER_LOCK_WAKE_OPERATION_ADD:
+            NewValue = Value + Argument;
+            break;
+
+        case USER_LOCK_WAKE_OPERATION_OR:
+            NewValue = Value | Argument;
+            break;
+
+        case USER_LOCK_WAKE_OPERATION_AND_NOT:
+            NewValue = Value & ~Argument;
+            break;
+
+        case USER_LOCK_WAKE_OPERATION_XOR:
+            NewValue = Value ^ Argument;
+            break;
+
+        default:
+            return STATUS_INVALID_PARAMETER;
+        }
+
+        if (MmUserCompareExchange32(Address,
+                                    NewValue,
+                                    Value,
+                                    OriginalValue) == FALSE) {
+
+            return STATUS_ACCESS_VIOLATION;
+        }
+
+        if (*OriginalValue == Value) {
+            break;
+        }
+
+        Value = *OriginalValue;
+    }
+
+    return STATUS_SUCCESS;
+}
+
+BOOL
+PspEvaluateUserLockWakeComparison (
+    ULONG Value,
+    ULONG Operation
+    )
+
+/*++
+
+Routine Description:
+
+    This routine evaluates the comparison encoded in a wake operation.
+
+Arguments:
+
+    Value - Supplies the original value of the second address.
+
+    Operation - Supplies the encoded wake operation.
+
+Return Value:
+
+    TRUE if the comparison holds and the second address should be woken.
+
+    FALSE if the comparison does not hold.
+
+--*/
+
+{
+
+    ULONG Argument;
+    ULONG Comparison;
+
+    Argument = Operation & USER_LOCK_WAKE_ARGUMENT_MASK;
+    Comparison = (Operation >> USER_LOCK_WAKE_COMPARISON_SHIFT) & 0xF;
+    switch (Comparison) {
+    case USER_LOCK_WAKE_COMPARE_EQUAL:
+        return (Value == Argument);
+
+    case USER_LOCK_WAKE_COMPARE_NOT_EQUAL:
+        return (Value != Argument);
+
+    case USER_LOCK_WAKE_COMPARE_LESS:
+        return ((LONG)Value < (LONG)Argument);
+
+    case USER_LOCK_WAKE_COMPARE_LESS_OR_EQUAL:
+        return ((LONG)Value <= (LONG)Argument);
+
+    case USER_LOCK_WAKE_COMPARE_GREATER:
+        return ((LONG)Value > (LONG)Argument);
+
+    case USER_LOCK_WAKE_COMPARE_GREATER_OR_EQUAL:
+        return ((LONG)Value >= (LONG)Argument);
+
+    default:
+        break;
+    }
+
+    return FALSE;
+}
+
+VOID
+PspBoostUserLockOwner (
+    PUSER_LOCK_KEY Key,
+    ULONG LockValue,
+    LONG NiceValue
+    )
+
+/*++
+
+Routine Description:
+
+    This routine lends the priority of a thread about to block on a priority
+    inheritance lock to the lock's owner. The bucket lock must be held, which
+    keeps the owner from releasing the lock (and dropping its boost) in the
+    meantime. Owners in other processes are not boosted.
+
+Arguments:
+
+    Key - Supplies a pointer to the key of the lock.
+
+    LockValue - Supplies the current value of the lock, which contains the
+        owner's thread ID.
+
+    NiceValue - Supplies the nice value of the waiting thread.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PKTHREAD Owner;
+    PKPROCESS Process;
+
+    Process = PsGetCurrentProcess();
+    Owner = PspGetThreadById(Process, LockValue & USER_LOCK_PI_OWNER_MASK);
+    if (Owner == NULL) {
+        return;
+    }
+
+    PspBoostThreadPriority(Owner, NiceValue);
+    ObReleaseReference(Owner);
+    return;
+}
+
+VOID
+PspBoostThreadPriority (
+    PKTHREAD Thread,
+    LONG NiceValue
+    )
+
+/*++
+
+Routine Description:
+
+    This routine raises a thread's priority to at least that of the given nice
+    value, remembering its original nice value the first time.
+
+Arguments:
+
+    Thread - Supplies a pointer to the thread to boost.
+
+    NiceValue - Supplies the nice value to inherit.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    KeAcquireQueuedLock(PsUserLockBoostLock);
+    if (NiceValue < Thread->SchedulerEntry.NiceValue) {
+        if (Thread->PriorityBoosted == FALSE) {
+            Thread->BaseNiceValue = Thread->SchedulerEntry.NiceValue;
+            Thread->PriorityBoosted = TRUE;
+        }
+
+        KeSetThreadNiceValue(Thread, NiceValue);
+    }
+
+    KeReleaseQueuedLock(PsUserLockBoostLock);
+    return;
+}
+
+VOID
+PspRestoreThreadPriority (
+    PKTHREAD Thread
+    )
+
+/*++
+
+Routine Description:
+
+    This routine drops any priority a thread inherited through priority
+    inheritance locks. A thread holding several contended locks at once drops
+    its boost when it releases the first of them.
+
+Arguments:
+
+    Thread - Supplies a pointer to the thread to restore.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    if (Thread->PriorityBoosted == FALSE) {
+        return;
+    }
+
+    KeAcquireQueuedLock(PsUserLockBoostLock);
+    if (Thread->PriorityBoosted != FALSE) {
+        KeSetThreadNiceValue(Thread, Thread->BaseNiceValue);
+        Thread->PriorityBoosted = FALSE;
+    }
+
+    KeReleaseQueuedLock(PsUserLockBoostLock);
+    return;
+}
+
+PUSER_LOCK_BUCKET
+PspGetUserLockBucket (
+    PUSER_LOCK_KEY Key
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the hash bucket for the given user lock.
+
+Arguments:
+
+    Key - Supplies a pointer to the key of the lock.
+
+Return Value:
+
+    Returns a pointer to the bucket.
+
+--*/
+
+{
+
+    ULONG Hash;
+
+    Hash = (ULONG)((UINTN)(Key->Object) >> 3) + (ULONG)(Key->Offset >> 2);
+    Hash *= USER_LOCK_HASH_MULTIPLIER;
+    return &(PsUserLockBuckets[Hash >> (32 - USER_LOCK_HASH_BITS)]);
+}
+
+VOID
+PspAcquireUserLockBuckets (
+    PUSER_LOCK_BUCKET FirstBucket,
+    PUSER_LOCK_BUCKET SecondBucket
+    )
+
+/*++
+
+Routine Description:
+
+    This routine acquires the locks for two buckets, in address order to avoid
+    deadlocking with another thread acquiring the same pair.
+
+Arguments:
+
+    FirstBucket - Supplies a pointer to the first bucket.
+
+    SecondBucket - Supplies a pointer to the second bucket, which may be the
+        same as the first.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    if (FirstBucket == SecondBucket) {
+        KeAcquireQueuedLock(FirstBucket->Lock);
+
+    } else if (FirstBucket < SecondBucket) {
+        KeAcquireQueuedLock(FirstBucket->Lock);
+        KeAcquireQueuedLock(SecondBucket->Lock);
+
+    } else {
+        KeAcquireQueuedLock(SecondBucket->Lock);
+        KeAcquireQueuedLock(FirstBucket->Lock);
+    }
+
+    return;
+}
+
+VOID
+PspReleaseUserLockBuckets (
+    PUSER_LOCK_BUCKET FirstBucket,
+    PUSER_LOCK_BUCKET SecondBucket
+    )
+
+/*++
+
+Routine Description:
+
+    This routine releases the locks for two buckets acquired together.
+
+Arguments:
+
+    FirstBucket - Supplies a pointer to the first bucket.
+
+    SecondBucket - Supplies a pointer to the second bucket, which may be the
+        same as the first.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    KeReleaseQueuedLock(FirstBucket->Lock);
+    if (SecondBucket != FirstBucket) {
+        KeReleaseQueuedLock(SecondBucket->Lock);
+    }
+
+    return;
+}
+
+KSTATUS
+PspInitializeUserLockKey (
+    PVOID Address,
+    BOOL Private,
+    PUSER_LOCK_KEY Key
+    )
+
+/*++
+
+Routine Description:
+
+    This routine looks up the identity of a user lock.
+
+Arguments:
+
+    Address - Supplies a pointer to the usermode address to contend on.
+
+    Private - Supplies a boolean indicating whether or not the lock is
+        private to the process (TRUE) or potentially shared between multiple
+        processes (FALSE).
+
+    Key - Supplies a pointer where the initialized key will be returned on
+        success. This holds a reference on the backing object that must be
+        released.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    BOOL Shared;
+
+    if (Private != FALSE) {
+        Key->Object = PsGetCurrentProcess();
+        Key->Offset = (UINTN)Address;
+        Key->Type = UserLockTypeProcess;
+
+    } else {
+        Key->Object = MmGetObjectForAddress(Address, &(Key->Offset), &Shared);
+        if (Key->Object == NULL) {
+            return STATUS_ACCESS_VIOLATION;
+        }
+
+        if (Shared != FALSE) {
+            Key->Type = UserLockTypeFileObject;
+
+        } else {
+            Key->Type = UserLockTypeImageSection;
+        }
+    }
+
+    return STATUS_SUCCESS;
+}
+
+VOID
+PspAddUserLockKeyReference (
+    PUSER_LOCK_KEY Key
+    )
+
+/*++
+
+Routine Description:
+
+    This routine adds a reference on a user lock backing object, which is
+    either a process, image section, or file object.
+
+Arguments:
+
+    Key - Supplies a pointer to the key to reference.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    switch (Key->Type) {
+    case UserLockTypeProcess:
+        break;
+
+    case UserLockTypeFileObject:
+        MmAddObjectReference(Key->Object, TRUE);
+        break;
+
+    case UserLockTypeImageSection:
+        MmAddObjectReference(Key->Object, FALSE);
+        break;
+
+    default:
+
+        ASSERT(FALSE);
+
+        break;
+    }
+
+    return;
+}
+
+VOID
+PspReleaseUserLockKey (
+    PUSER_LOCK_KEY Key
+    )
+
+/*++
+
+Routine Description:
+
+    This routine releases the reference on a user lock backing object, which
+    is either a process, image section, or file object.
 
 Arguments:
 
-    Lock - Supplies a pointer to the lock being torn down.
+    Key - Supplies a pointer to the key being torn down.
 
 Return Value:
 
@@ -512,7 +1960,7 @@ Return Value:
     BOOL Shared;
 
     Shared = FALSE;
-    switch (Lock->Type) {
+    switch (Key->Type) {
     case UserLockTypeProcess:
         break;
 
@@ -524,7 +1972,7 @@ Return Value:
         //
 
     case UserLockTypeImageSection:
-        MmReleaseObjectReference(Lock->Object, Shared);
+        MmReleaseObjectReference(Key->Object, Shared);
         break;
 
     default:
@@ -537,62 +1985,40 @@ Return Value:
     return;
 }
 
-COMPARISON_RESULT
-PspCompareUserLocks (
-    PRED_BLACK_TREE Tree,
-    PRED_BLACK_TREE_NODE FirstNode,
-    PRED_BLACK_TREE_NODE SecondNode
+BOOL
+PspAreUserLockKeysEqual (
+    PUSER_LOCK_KEY FirstKey,
+    PUSER_LOCK_KEY SecondKey
     )
 
 /*++
 
 Routine Description:
 
-    This routine compares two Red-Black tree nodes that in this case are user
-    mode lock objects.
+    This routine determines whether two user lock keys refer to the same lock.
 
 Arguments:
 
-    Tree - Supplies a pointer to the Red-Black tree that owns both nodes.
+    FirstKey - Supplies a pointer to the first key.
 
-    FirstNode - Supplies a pointer to the left side of the comparison.
-
-    SecondNode - Supplies a pointer to the second side of the comparison.
+    SecondKey - Supplies a pointer to the second key.
 
 Return Value:
 
-    Same if the two nodes have the same value.
-
-    Ascending if the first node is less than the second node.
+    TRUE if the keys are equal.
 
-    Descending if the second node is less than the first node.
+    FALSE if the keys refer to different locks.
 
 --*/
 
 {
 
-    PUSER_LOCK FirstLock;
-    PUSER_LOCK SecondLock;
-
-    //
-    // Compare raw pointers to the objects first.
-    //
-
-    FirstLock = RED_BLACK_TREE_VALUE(FirstNode, USER_LOCK, TreeNode);
-    SecondLock = RED_BLACK_TREE_VALUE(SecondNode, USER_LOCK, TreeNode);
-    if (FirstLock->Object < SecondLock->Object) {
-        return ComparisonResultAscending;
-
-    } else if (FirstLock->Object > SecondLock->Object) {
-        return ComparisonResultDescending;
-
-    } else if (FirstLock->Offset > SecondLock->Offset) {
-        return ComparisonResultDescending;
+    if ((FirstKey->Object == SecondKey->Object) &&
+        (FirstKey->Offset == SecondKey->Offset)) {
 
-    } else if (FirstLock->Offset < SecondLock->Offset) {
-        return ComparisonResultAscending;
+        return TRUE;
     }
 
-    return ComparisonResultSame;
+    return FALSE;
 }
 